@@ -0,0 +1,107 @@
+//
+// Derivatives by forward mode differentiation of a program against evaluating symbolic derivatives.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_autodiff.h"
+#include "../internals/fluxion_batch.h"
+#include "../internals/fluxion_diff.h"
+#include "../internals/fluxion_parser.h"
+
+#define POINTS 200000
+#define ORDER 6
+#define SOURCE "x * exp(-x) * sin(3 * x) + log(1 + x^2)"
+
+static bool close(double a, double b) {
+    return fabs(a - b) <= 1e-8 * (1 + fabs(b));
+}
+
+int main() {
+    NodePool *pool = initNodePool();
+    uint32_t x = internSymbol(pool, "x", 1);
+    const char *names[] = {"x"};
+    Parser *parser = parse(SOURCE);
+    NodeId function = nodeFromToken(pool, getTokens(parser)[0]);
+    Program *program = compileExpression(getTokens(parser)[0], names, 1);
+    double values[BUILTIN_SYMBOL_COUNT + 1] = {0}, derivatives[ORDER + 1];
+    double *points = (double *) malloc(sizeof(double) * POINTS);
+    double *symbolic = (double *) malloc(sizeof(double) * POINTS * (ORDER + 1)), *outputs[ORDER + 1];
+    const double *columns[] = {points};
+    bool agree = true;
+    int i, k, threadCount;
+    for (i = 0; i < POINTS; i++) {
+        points[i] = (i + 1) * (4.0 / POINTS);
+    }
+    for (k = 0; k <= ORDER; k++) {
+        outputs[k] = (double *) malloc(sizeof(double) * POINTS);
+    }
+
+    double begin = benchSeconds();
+    NodeId derivative = differentiateNode(pool, function, x);
+    for (i = 0; i < POINTS; i++) {
+        values[x] = points[i];
+        symbolic[2 * i] = evaluateNode(pool, function, values);
+        symbolic[2 * i + 1] = evaluateNode(pool, derivative, values);
+    }
+    benchReport("symbolic derivative, evaluated", benchSeconds() - begin, POINTS, "point");
+    begin = benchSeconds();
+    for (i = 0; i < POINTS; i++) {
+        double value = runProgramDual(program, points + i, 0, derivatives + 1);
+        agree = agree && close(value, symbolic[2 * i]) && close(derivatives[1], symbolic[2 * i + 1]);
+    }
+    benchReport("dual numbers", benchSeconds() - begin, POINTS, "point");
+    for (threadCount = 1; threadCount >= 0; threadCount--) {
+        begin = benchWallSeconds();
+        runProgramBatchDerivatives(program, columns, POINTS, 0, 1, outputs, threadCount);
+        benchReport(threadCount ? "batch dual, 1 thread" : "batch dual, all threads",
+                    benchWallSeconds() - begin, POINTS, "point");
+        for (i = 0; i < POINTS; i++) {
+            agree = agree && close(outputs[0][i], symbolic[2 * i]) && close(outputs[1][i], symbolic[2 * i + 1]);
+        }
+    }
+
+    begin = benchSeconds();
+    uint32_t before = pool->count;
+    derivative = function;
+    for (k = 0; k <= ORDER; k++) {
+        for (i = 0; i < POINTS; i += 100) {
+            values[x] = points[i];
+            symbolic[i / 100 * (ORDER + 1) + k] = evaluateNode(pool, derivative, values);
+        }
+        derivative = differentiateNode(pool, derivative, x);
+    }
+    benchReport("symbolic derivatives to order 6", benchSeconds() - begin, POINTS / 100, "point");
+    printf("%u nodes created\n", pool->count - before);
+    begin = benchSeconds();
+    for (i = 0; i < POINTS; i += 100) {
+        runProgramDerivatives(program, points + i, 0, ORDER, derivatives);
+        for (k = 0; k <= ORDER; k++) {
+            agree = agree && close(derivatives[k], symbolic[i / 100 * (ORDER + 1) + k]);
+        }
+    }
+    benchReport("Taylor series to order 6", benchSeconds() - begin, POINTS / 100, "point");
+    begin = benchWallSeconds();
+    runProgramBatchDerivatives(program, columns, POINTS, 0, ORDER, outputs, 0);
+    benchReport("batch Taylor series to order 6", benchWallSeconds() - begin, POINTS, "point");
+    for (i = 0; i < POINTS; i += 100) {
+        for (k = 0; k <= ORDER; k++) {
+            agree = agree && close(outputs[k][i], symbolic[i / 100 * (ORDER + 1) + k]);
+        }
+    }
+
+    for (k = 0; k <= ORDER; k++) {
+        free(outputs[k]);
+    }
+    free(symbolic);
+    free(points);
+    freeProgram(program);
+    freeParser(parser);
+    freeNodePool(pool);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
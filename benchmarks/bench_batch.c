@@ -0,0 +1,76 @@
+//
+// Batch evaluation over columns against a loop of single evaluations.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_parser.h"
+#include "../internals/fluxion_vm.h"
+#include "../internals/fluxion_batch.h"
+
+#define POINTS 4000000
+#define REPEATS 5
+
+/**
+ * Time an expression over POINTS values of x in (0, 8], a point at a time
+ * and then in batches, and check both agree.
+ * @return whether they agree.
+ */
+static bool benchExpression(const char *name, const char *source, double *x, double *scalar, double *batch) {
+    const char *names[] = {"x"};
+    const double *columns[] = {x};
+    char label[128];
+    int i, repeat, threadCount;
+    double best = 1e30, scalarTime;
+    Parser *parser = parse(source);
+    Program *program = compileExpression(getTokens(parser)[0], names, 1);
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchWallSeconds();
+        for (i = 0; i < POINTS; i++) {
+            scalar[i] = runProgram(program, x + i);
+        }
+        double elapsed = benchWallSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    snprintf(label, sizeof(label), "single %s", name);
+    benchReport(label, best, POINTS, "eval");
+    scalarTime = best;
+    for (threadCount = 1; threadCount >= 0; threadCount--) {
+        best = 1e30;
+        for (repeat = 0; repeat < REPEATS; repeat++) {
+            double begin = benchWallSeconds();
+            runProgramBatch(program, columns, POINTS, batch, threadCount);
+            double elapsed = benchWallSeconds() - begin;
+            best = elapsed < best ? elapsed : best;
+        }
+        snprintf(label, sizeof(label), "batch %s, %s", name, threadCount ? "1 thread" : "all threads");
+        benchReport(label, best, POINTS, "eval");
+        printf("speedup %.1fx\n", scalarTime / best);
+    }
+    freeProgram(program);
+    freeParser(parser);
+    for (i = 0; i < POINTS; i++) {
+        if (fabs(scalar[i] - batch[i]) > 1e-14 * (1 + fabs(scalar[i]))) {
+            printf("%s mismatch at x = %.17g, %.17g != %.17g\n", name, x[i], scalar[i], batch[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    int i;
+    double *x = (double *) malloc(sizeof(double) * POINTS);
+    double *scalar = (double *) malloc(sizeof(double) * POINTS);
+    double *batch = (double *) malloc(sizeof(double) * POINTS);
+    for (i = 0; i < POINTS; i++) {
+        x[i] = (i + 1) * (8.0 / POINTS);
+    }
+    bool agree = benchExpression("polynomial", "3*x^4 - 2*x^3 + x^2 - 5*x + 7", x, scalar, batch)
+                 && benchExpression("elementary", "sin(x) * exp(-x) + log(x)", x, scalar, batch);
+    free(batch);
+    free(scalar);
+    free(x);
+    return agree ? 0 : 1;
+}
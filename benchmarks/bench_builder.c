@@ -0,0 +1,57 @@
+//
+// Builder enumeration in batches against evaluating the constraint a candidate at a time.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_parser.h"
+#include "../internals/fluxion_builder.h"
+
+#define BOUND 4000000
+#define STREAM_CHUNK 4096
+
+int main() {
+    Parser *parser = parse("{x | x > 0 & x < 4000000 & sin(x) * exp(-x / 1000000) > 0.25}");
+    const Token *token = getTokens(parser)[0];
+    const BuilderToken *builder = (const BuilderToken *) (token->tokenType == EXPRESSION ?
+                                                          ((const ExpressionToken *) token)->root : token);
+    BuilderPredicate *predicate = initBuilderPredicate(builder);
+    int64_t first, last, *members = (int64_t *) malloc(sizeof(int64_t) * STREAM_CHUNK);
+    size_t count, found = 0, streamed = 0;
+    double value;
+    if (!builderIntegerRange(predicate, &first, &last) || first != 1 || last != BOUND - 1) {
+        printf("bounds not found\n");
+        return 1;
+    }
+
+    double begin = benchWallSeconds();
+    for (value = first; value <= last; value++) {
+        found += builderContains(predicate, value);
+    }
+    double elapsed = benchWallSeconds() - begin;
+    benchReport("membership a candidate at a time", elapsed, BOUND, "candidate");
+    double singleTime = elapsed;
+
+    int threadCount;
+    for (threadCount = 1; threadCount >= 0; threadCount--) {
+        BuilderStream stream;
+        streamed = 0;
+        begin = benchWallSeconds();
+        initBuilderStream(&stream, predicate, INT64_MIN, INT64_MAX, threadCount);
+        while ((count = streamBuilderMembers(&stream, members, STREAM_CHUNK)) > 0) {
+            streamed += count;
+        }
+        freeBuilderStream(&stream);
+        elapsed = benchWallSeconds() - begin;
+        benchReport(threadCount ? "stream, 1 thread" : "stream, all threads", elapsed, BOUND, "candidate");
+        printf("speedup %.1fx\n", singleTime / elapsed);
+    }
+    free(members);
+    freeBuilderPredicate(predicate);
+    freeParser(parser);
+    if (streamed != found) {
+        printf("mismatch, %zu != %zu\n", streamed, found);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+//
+// Prime swing factorials and binomials against repeated multiplication.
+//
+
+#include "bench_common.h"
+#include "../internals/fluxion_combinatorics.h"
+#include "../internals/fluxion_equal.h"
+
+#define N 100000
+#define NAIVE_N 25000 // Repeated multiplication takes seconds for N.
+#define BINOMIAL_N 20000 // And so does dividing (2N)! by N!^2.
+#define NEARBY 8 // Factorials just above N, extended from the cached one.
+#define MODULUS 1000000007
+
+static void multiplyUpTo(BigInt *result, uint64_t begin, uint64_t end) {
+    uint64_t i;
+    bigIntSetUint64(result, 1);
+    for (i = begin; i <= end; i++) {
+        bigIntMultiplyLimb(result, result, (Limb) i);
+    }
+}
+
+int main() {
+    BigInt naive, swing, divisor;
+    initBigInt(&naive);
+    initBigInt(&swing);
+    initBigInt(&divisor);
+    bool agree = true;
+    int i;
+
+    double begin = benchSeconds();
+    multiplyUpTo(&naive, 2, NAIVE_N);
+    benchReport("25000! by repeated multiplication", benchSeconds() - begin, 1, "factorial");
+    begin = benchSeconds();
+    bigIntFactorial(&swing, NAIVE_N, NULL);
+    benchReport("25000! by prime swing", benchSeconds() - begin, 1, "factorial");
+    agree = agree && bigIntCompare(&naive, &swing) == 0;
+    begin = benchSeconds();
+    bigIntFactorial(&swing, N, NULL);
+    benchReport("100000! by prime swing", benchSeconds() - begin, 1, "factorial");
+
+    FactorialCache *cache = initFactorialCache(NEARBY + 1);
+    bigIntFactorial(&swing, N, cache);
+    begin = benchSeconds();
+    for (i = 1; i <= NEARBY; i++) {
+        bigIntFactorial(&swing, N + 1000 * i, cache);
+    }
+    benchReport("factorials above 100000!, cached", benchSeconds() - begin, NEARBY, "factorial");
+    printf("%llu extended from the cache\n", (unsigned long long) cache->extensions);
+    freeFactorialCache(cache);
+
+    begin = benchSeconds();
+    bigIntFactorial(&naive, 2 * BINOMIAL_N, NULL);
+    bigIntFactorial(&divisor, BINOMIAL_N, NULL);
+    bigIntDivideExact(&naive, &naive, &divisor);
+    bigIntDivideExact(&naive, &naive, &divisor);
+    benchReport("binomial(40000, 20000) by factorials", benchSeconds() - begin, 1, "binomial");
+    begin = benchSeconds();
+    bigIntBinomial(&swing, 2 * BINOMIAL_N, BINOMIAL_N);
+    benchReport("binomial(40000, 20000) by primes", benchSeconds() - begin, 1, "binomial");
+    agree = agree && bigIntCompare(&naive, &swing) == 0;
+    begin = benchSeconds();
+    bigIntBinomial(&swing, 2 * N, N);
+    benchReport("binomial(200000, 100000) by primes", benchSeconds() - begin, 1, "binomial");
+
+    uint64_t residue;
+    begin = benchSeconds();
+    agree = agree && binomialModulo(2 * N, N, MODULUS, &residue) && residue == bigIntModWord(&swing, MODULUS);
+    benchReport("binomial(200000, 100000) mod p", benchSeconds() - begin, 1, "binomial");
+    // Small k for any n, the factors past 2^32 no longer fit a word.
+    bigIntSetUint64(&divisor, ((uint64_t) 1 << 40) - 1);
+    bigIntShiftLeft(&divisor, &divisor, 39);
+    agree = agree && bigIntBinomial(&swing, (uint64_t) 1 << 40, 2) && bigIntCompare(&swing, &divisor) == 0;
+    agree = agree && bigIntBinomial(&swing, UINT64_MAX, 40) && binomialModulo(UINT64_MAX, 40, MODULUS, &residue) &&
+            residue == bigIntModWord(&swing, MODULUS);
+
+    NodePool *pool = initNodePool();
+    NodeId factorial = nodeUnary(pool, 0, FACTORIAL, nodeExactNumber(pool, 0, numberFromSmall(N)));
+    NodeId other = nodeBinary(pool, 0, PLUS, factorial, nodeExactNumber(pool, 0, numberFromSmall(1)));
+    EqualityChecker *checker = initEqualityChecker(pool, NULL, 1);
+    begin = benchSeconds();
+    agree = agree && compareNodes(checker, factorial, other) == EQUALITY_DIFFERENT;
+    benchReport("100000! against 100000! + 1 by fingerprint", benchSeconds() - begin, 1, "comparison");
+    freeEqualityChecker(checker);
+    freeNodePool(pool);
+
+    freeBigInt(&divisor);
+    freeBigInt(&swing);
+    freeBigInt(&naive);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+//
+// Small helpers shared by the benchmarks.
+//
+
+#ifndef FLUXIONCORE_BENCH_COMMON_H
+#define FLUXIONCORE_BENCH_COMMON_H
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Seconds of processor time since an unspecified point.
+ */
+static inline double benchSeconds(void) {
+    return (double) clock() / CLOCKS_PER_SEC;
+}
+
+/**
+ * Seconds of wall clock time since an unspecified point, for benchmarks that use threads.
+ */
+static inline double benchWallSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Print a benchmark result line.
+ * @param name Name of the measurement.
+ * @param seconds Time taken.
+ * @param work Units of work done, e.g. bytes or evaluations.
+ * @param unit Name of the unit.
+ */
+static inline void benchReport(const char *name, double seconds, double work, const char *unit) {
+    printf("%-40s %10.3f ms %14.2f M%s/s\n", name, seconds * 1e3, seconds > 0 ? work / seconds / 1e6 : 0.0, unit);
+}
+
+#endif //FLUXIONCORE_BENCH_COMMON_H
@@ -0,0 +1,93 @@
+//
+// Hash-consed expression nodes against token trees holding repeated subtrees.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_node.h"
+
+#define DEPTH 25 // t_n = t_(n - 1) * t_(n - 2) + 1, a Fibonacci number of leaves.
+#define REPEATS 20
+
+/**
+ * The tree a parser builds, every occurrence of t_(n - 1) and t_(n - 2) is its own copy.
+ */
+static Token *buildTokens(Arena *arena, int depth) {
+    Token *previous = (Token *) initIdentifierToken(arena, 1, "y");
+    Token *current = (Token *) initIdentifierToken(arena, 1, "x");
+    int i;
+    for (i = 2; i <= depth; i++) {
+        Token *product = (Token *) initOperatorToken(arena, 1, MULTIPLY, copyToken(arena, current),
+                                                     copyToken(arena, previous));
+        Token *next = (Token *) initOperatorToken(arena, 1, PLUS, product, (Token *) initNumberToken(arena, 1, 1));
+        previous = current;
+        current = next;
+    }
+    return current;
+}
+
+static size_t countTokens(const Token *token) {
+    if (token->tokenType != OPERATOR) {
+        return 1;
+    }
+    const OperatorToken *operator = (const OperatorToken *) token;
+    return 1 + countTokens(operator->left) + countTokens(operator->right);
+}
+
+static NodeId buildNodes(NodePool *pool, int depth) {
+    NodeId previous = nodeSymbol(pool, 1, "y", 1), current = nodeSymbol(pool, 1, "x", 1);
+    int i;
+    for (i = 2; i <= depth; i++) {
+        NodeId next = nodeBinary(pool, 1, PLUS, nodeBinary(pool, 1, MULTIPLY, current, previous),
+                                 nodeNumber(pool, 1, 1));
+        previous = current;
+        current = next;
+    }
+    return current;
+}
+
+int main() {
+    Arena *arena = initArena(1 << 20);
+    double begin = benchSeconds();
+    Token *a = buildTokens(arena, DEPTH), *b = buildTokens(arena, DEPTH);
+    double treeTime = benchSeconds() - begin;
+    size_t tokens = countTokens(a);
+    benchReport("build token trees", treeTime, 2.0 * tokens, "token");
+    begin = benchSeconds();
+    bool agree = true;
+    int repeat;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        agree = agree && tokensEqual(a, b);
+    }
+    benchReport("tokensEqual", benchSeconds() - begin, (double) REPEATS * tokens, "token");
+    begin = benchSeconds();
+    Token *copy = copyToken(NULL, a);
+    benchReport("copy token tree to the heap", benchSeconds() - begin, (double) tokens, "token");
+    agree = agree && tokensEqual(copy, a);
+    begin = benchSeconds();
+    freeTokenTree(copy);
+    benchReport("free heap token tree", benchSeconds() - begin, (double) tokens, "token");
+
+    NodePool *pool = initNodePool();
+    begin = benchSeconds();
+    NodeId x = buildNodes(pool, DEPTH), y = buildNodes(pool, DEPTH);
+    benchReport("build shared nodes", benchSeconds() - begin, 2.0 * tokens, "token");
+    agree = agree && x == y; // Equality is comparing ids.
+    printf("%zu tokens a tree, %u nodes for both\n", tokens, pool->count);
+
+    NodePool *interned = initNodePool();
+    begin = benchSeconds();
+    NodeId z = nodeFromToken(interned, a);
+    benchReport("intern token tree", benchSeconds() - begin, (double) tokens, "token");
+    agree = agree && nodeFromToken(interned, b) == z && interned->count == pool->count &&
+            nodeHash(interned, z) == nodeHash(pool, x);
+
+    freeNodePool(interned);
+    freeNodePool(pool);
+    freeArena(arena);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+//
+// Memoised, simplifying differentiation against the textbook recursion.
+//
+
+#include <math.h>
+#include "bench_common.h"
+#include "../internals/fluxion_diff.h"
+
+#define NESTING 2000 // sin(cos(sin(... x))).
+#define SQUARINGS 22 // t_n = t_(n - 1) * t_(n - 1), shared.
+#define ORDER 10 // Derivatives of x x sin(x) exp(x).
+
+static long naiveVisits;
+
+/**
+ * The rules applied as written, every occurrence of a subterm is differentiated again.
+ */
+static NodeId naiveDerivative(NodePool *pool, NodeId node, uint32_t variable) {
+    naiveVisits++;
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER) {
+        return nodeNumber(pool, 1, 0);
+    }
+    if (tag == NODE_SYMBOL) {
+        return nodeNumber(pool, 1, nodeSymbolOf(pool, node) == variable);
+    }
+    if (tag == NODE_CALL) {
+        NodeId argument = nodeChild(pool, node, 1);
+        uint32_t function = nodeSymbolOf(pool, nodeChild(pool, node, 0));
+        NodeId derivative = node; // exp
+        if (function == SYMBOL_SIN) {
+            derivative = nodeCall(pool, 1, SYMBOL_COS, &argument, 1);
+        } else if (function == SYMBOL_COS) {
+            derivative = nodeUnary(pool, 1, MINUS, nodeCall(pool, 1, SYMBOL_SIN, &argument, 1));
+        }
+        return nodeBinary(pool, 1, MULTIPLY, derivative, naiveDerivative(pool, argument, variable));
+    }
+    NodeId a = nodeChild(pool, node, 0);
+    if (nodeChildCount(pool, node) == 1) { // Negation.
+        return nodeUnary(pool, 1, MINUS, naiveDerivative(pool, a, variable));
+    }
+    NodeId b = nodeChild(pool, node, 1);
+    NodeId da = naiveDerivative(pool, a, variable), db = naiveDerivative(pool, b, variable);
+    if (tag == PLUS) {
+        return nodeBinary(pool, 1, PLUS, da, db);
+    }
+    return nodeBinary(pool, 1, PLUS, nodeBinary(pool, 1, MULTIPLY, da, b), nodeBinary(pool, 1, MULTIPLY, a, db));
+}
+
+static double at(const NodePool *pool, NodeId node, uint32_t variable, double value) {
+    double values[BUILTIN_SYMBOL_COUNT + 1] = {0};
+    values[variable] = value;
+    return evaluateNode(pool, node, values);
+}
+
+int main() {
+    NodePool *pool = initNodePool();
+    uint32_t x = internSymbol(pool, "x", 1);
+    NodeId nested = nodeSymbol(pool, 1, "x", 1);
+    int i;
+    for (i = 0; i < NESTING; i++) {
+        nested = nodeCall(pool, 1, i % 2 ? SYMBOL_COS : SYMBOL_SIN, &nested, 1);
+    }
+    uint32_t before = pool->count;
+    double begin = benchSeconds();
+    NodeId derivative = differentiateNode(pool, nested, x);
+    benchReport("nested 2000 memoised", benchSeconds() - begin, NESTING, "node");
+    printf("%u nodes for the derivative\n", pool->count - before);
+    before = pool->count;
+    begin = benchSeconds();
+    naiveVisits = 0;
+    NodeId naive = naiveDerivative(pool, nested, x);
+    benchReport("nested 2000 naive", benchSeconds() - begin, NESTING, "node");
+    printf("%u nodes for the derivative\n", pool->count - before);
+    bool agree = fabs(at(pool, derivative, x, 0.3) - at(pool, naive, x, 0.3)) < 1e-9;
+
+    NodeId tower = nodeBinary(pool, 1, PLUS, nodeSymbol(pool, 1, "x", 1), nodeNumber(pool, 1, 1));
+    for (i = 0; i < SQUARINGS; i++) {
+        tower = nodeBinary(pool, 1, MULTIPLY, tower, tower);
+    }
+    begin = benchSeconds();
+    derivative = differentiateNode(pool, tower, x);
+    double memoTime = benchSeconds() - begin;
+    benchReport("squarings 22 memoised", memoTime, SQUARINGS, "node");
+    begin = benchSeconds();
+    naiveVisits = 0;
+    naive = naiveDerivative(pool, tower, x);
+    double naiveTime = benchSeconds() - begin;
+    benchReport("squarings 22 naive", naiveTime, (double) naiveVisits, "visit");
+    printf("%ld naive visits, speedup %.0fx\n", naiveVisits, naiveTime / memoTime);
+    double value = pow(2, SQUARINGS) * pow(1 + 1e-7, pow(2, SQUARINGS) - 1); // Derivative of (x + 1)^(2^n) at 1e-7.
+    agree = agree && fabs(at(pool, derivative, x, 1e-7) / value - 1) < 1e-6 && fabs(at(pool, naive, x, 1e-7) / value - 1) < 1e-6;
+
+    NodeId symbol = nodeSymbol(pool, 1, "x", 1);
+    NodeId x2 = nodeBinary(pool, 1, MULTIPLY, symbol, symbol);
+    NodeId sine = nodeCall(pool, 1, SYMBOL_SIN, &symbol, 1);
+    NodeId exponential = nodeCall(pool, 1, SYMBOL_EXP, &symbol, 1);
+    NodeId product = nodeBinary(pool, 1, MULTIPLY, nodeBinary(pool, 1, MULTIPLY, x2, sine), exponential);
+    NodeId current = product;
+    before = pool->count;
+    begin = benchSeconds();
+    for (i = 1; i <= ORDER; i++) {
+        current = differentiateNode(pool, current, x);
+    }
+    benchReport("10th derivative memoised", benchSeconds() - begin, ORDER, "derivative");
+    printf("%u nodes for all 10\n", pool->count - before);
+    NodeId slow = product;
+    before = pool->count;
+    begin = benchSeconds();
+    naiveVisits = 0;
+    for (i = 1; i <= ORDER; i++) {
+        slow = naiveDerivative(pool, slow, x);
+    }
+    benchReport("10th derivative naive", benchSeconds() - begin, ORDER, "derivative");
+    printf("%u nodes for all 10, %ld visits\n", pool->count - before, naiveVisits);
+    agree = agree && fabs(at(pool, current, x, 0.5) / at(pool, slow, x, 0.5) - 1) < 1e-9;
+
+    freeNodePool(pool);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
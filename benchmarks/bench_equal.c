@@ -0,0 +1,96 @@
+//
+// Deciding equality by fingerprints against comparing rational functions every time.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_equal.h"
+#include "../internals/fluxion_gcd.h"
+
+#define PAIRS 200
+#define FACTORS 6 // Linear factors in three variables of each product, expanded to 84 terms.
+#define REPEATS 100 // Comparisons of every pair once fingerprints are known.
+
+static NodeId smallNumber(NodePool *pool, int64_t value) {
+    return nodeExactNumber(pool, 0, numberFromSmall(value));
+}
+
+/**
+ * A product of random factors a x + b y + c z + d, and the same product expanded,
+ * plus one if it is to differ, as is the case for most pairs a lookup compares.
+ */
+static void randomPair(NodePool *pool, const NodeId *variables, bool differ, NodeId *product, NodeId *expanded) {
+    *product = NODE_NONE;
+    int i, v;
+    for (i = 0; i < FACTORS; i++) {
+        NodeId factor = smallNumber(pool, 1 + rand() % 9);
+        for (v = 0; v < 3; v++) {
+            NodeId term = nodeBinary(pool, 0, MULTIPLY, smallNumber(pool, 1 + rand() % 9), variables[v]);
+            factor = nodeBinary(pool, 0, PLUS, term, factor);
+        }
+        *product = *product == NODE_NONE ? factor : nodeBinary(pool, 0, MULTIPLY, *product, factor);
+    }
+    Polynomial *polynomial = polynomialFromNode(pool, *product);
+    *expanded = polynomialToNode(pool, polynomial, 0);
+    if (differ) {
+        *expanded = nodeBinary(pool, 0, PLUS, *expanded, smallNumber(pool, 1));
+    }
+    freePolynomial(polynomial);
+}
+
+static bool symbolicEqual(const NodePool *pool, NodeId a, NodeId b) {
+    RationalFunction *functionA = rationalFunctionFromNode(pool, a), *functionB = rationalFunctionFromNode(pool, b);
+    RationalFunction *difference = rationalFunctionSubtract(functionA, functionB);
+    bool equal = difference->numerator->count == 0;
+    freeRationalFunction(difference);
+    freeRationalFunction(functionB);
+    freeRationalFunction(functionA);
+    return equal;
+}
+
+int main() {
+    NodePool *pool = initNodePool();
+    NodeId variables[3] = {nodeSymbol(pool, 0, "x", 1), nodeSymbol(pool, 0, "y", 1), nodeSymbol(pool, 0, "z", 1)};
+    NodeId products[PAIRS], expansions[PAIRS];
+    bool differ[PAIRS], agree = true;
+    int i, r, differing = 0;
+    for (i = 0; i < PAIRS; i++) {
+        differ[i] = i % 10 != 0;
+        differing += differ[i];
+        randomPair(pool, variables, differ[i], products + i, expansions + i);
+    }
+
+    double begin = benchSeconds();
+    for (i = 0; i < PAIRS; i++) {
+        agree = agree && symbolicEqual(pool, products[i], expansions[i]) == !differ[i];
+    }
+    benchReport("rational functions", benchSeconds() - begin, PAIRS, "comparison");
+
+    EqualityChecker *checker = initEqualityChecker(pool, NULL, 1);
+    begin = benchSeconds();
+    for (i = 0; i < PAIRS; i++) {
+        Equality equality = compareNodes(checker, products[i], expansions[i]);
+        agree = agree && equality == (differ[i] ? EQUALITY_DIFFERENT : EQUALITY_EQUAL);
+    }
+    benchReport("fingerprints, first comparison", benchSeconds() - begin, PAIRS, "comparison");
+    begin = benchSeconds();
+    for (r = 0; r < REPEATS; r++) {
+        for (i = 0; i < PAIRS; i++) {
+            if (differ[i]) {
+                agree = agree && compareNodes(checker, products[i], expansions[i]) == EQUALITY_DIFFERENT;
+            }
+        }
+    }
+    benchReport("fingerprints, known", benchSeconds() - begin, REPEATS * (double) differing, "comparison");
+    printf("%llu comparisons, %llu rejected by fingerprint, %llu symbolic\n",
+           (unsigned long long) checker->comparisons, (unsigned long long) checker->rejections,
+           (unsigned long long) checker->symbolicComparisons);
+    freeEqualityChecker(checker);
+    freeNodePool(pool);
+
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
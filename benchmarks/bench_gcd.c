@@ -0,0 +1,193 @@
+//
+// Modular polynomial GCDs against Euclid's algorithm over the rationals, and rational functions.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_gcd.h"
+
+#define EUCLID_DEGREE 12 // Of the cofactors for the remainder sequence over the rationals.
+#define DEGREE 300 // Of the cofactors for the modular algorithm alone.
+#define SUM_TERMS 24 // 1 / (x + 1) + ... + 1 / (x + SUM_TERMS).
+
+static Polynomial *randomDense(uint32_t variable, size_t degree) {
+    BigInt *coefficients = (BigInt *) malloc(sizeof(BigInt) * (degree + 1));
+    size_t i;
+    for (i = 0; i <= degree; i++) {
+        initBigInt(coefficients + i);
+        bigIntSetInt64(coefficients + i, i == degree ? 1 + rand() % 99 : rand() % 199 - 99);
+    }
+    Polynomial *polynomial = polynomialFromDense(variable, coefficients, degree + 1);
+    for (i = 0; i <= degree; i++) {
+        freeBigInt(coefficients + i);
+    }
+    free(coefficients);
+    return polynomial;
+}
+
+/**
+ * A random polynomial in three variables of total degree at most degree.
+ */
+static Polynomial *randomTrivariate(const uint32_t *variables, int degree) {
+    Polynomial *sum = initPolynomial();
+    int i, j, k;
+    for (i = 0; i <= degree; i++) {
+        for (j = 0; i + j <= degree; j++) {
+            for (k = 0; i + j + k <= degree; k++) {
+                BigInt coefficients[2];
+                initBigInt(coefficients);
+                initBigInt(coefficients + 1);
+                bigIntSetInt64(coefficients + 1, rand() % 19 - 9);
+                Polynomial *term = polynomialFromDense(variables[0], coefficients + 1, 1);
+                uint32_t exponents[3] = {(uint32_t) i, (uint32_t) j, (uint32_t) k}, v, e;
+                bigIntSetInt64(coefficients + 1, 1);
+                for (v = 0; v < 3; v++) {
+                    Polynomial *variable = polynomialFromDense(variables[v], coefficients, 2);
+                    for (e = 0; e < exponents[v]; e++) {
+                        Polynomial *product = polynomialMultiply(term, variable);
+                        freePolynomial(term);
+                        term = product;
+                    }
+                    freePolynomial(variable);
+                }
+                Polynomial *next = polynomialAdd(sum, term);
+                freePolynomial(sum);
+                freePolynomial(term);
+                sum = next;
+                freeBigInt(coefficients);
+                freeBigInt(coefficients + 1);
+            }
+        }
+    }
+    return sum;
+}
+
+/**
+ * Degree of the gcd by the remainder sequence with fractions, whose
+ * coefficients grow far beyond those of the inputs and of the gcd.
+ */
+static int64_t euclidDegree(const Polynomial *a, const Polynomial *b) {
+    size_t aLength = (size_t) polynomialDegree(a, a->variables[0]) + 1;
+    size_t bLength = (size_t) polynomialDegree(b, b->variables[0]) + 1, total = aLength + bLength, i, k;
+    Number *block = (Number *) malloc(sizeof(Number) * total), *x = block, *y = block + aLength;
+    for (i = 0; i < total; i++) {
+        block[i] = numberFromSmall(0);
+    }
+    for (i = 0; i < a->count + b->count; i++) {
+        const Polynomial *p = i < a->count ? a : b;
+        size_t term = i < a->count ? i : i - a->count;
+        BigInt copy;
+        initBigInt(&copy);
+        bigIntCopy(&copy, p->coefficients + term);
+        (p == a ? x : y)[p->monomials[term]] = numberFromBigInt(&copy);
+    }
+    while (bLength > 0) {
+        while (aLength >= bLength) {
+            Number factor = numberDivide(x[aLength - 1], y[bLength - 1]);
+            for (k = 0; k < bLength; k++) {
+                Number product = numberMultiply(factor, y[k]);
+                Number difference = numberSubtract(x[aLength - bLength + k], product);
+                freeNumber(x[aLength - bLength + k]);
+                freeNumber(product);
+                x[aLength - bLength + k] = difference;
+            }
+            freeNumber(factor);
+            while (aLength > 0 && numberIsZero(x[aLength - 1])) {
+                aLength--;
+            }
+        }
+        Number *swap = x;
+        x = y;
+        y = swap;
+        size_t swapLength = aLength;
+        aLength = bLength;
+        bLength = swapLength;
+    }
+    for (i = 0; i < total; i++) {
+        freeNumber(block[i]);
+    }
+    free(block);
+    return (int64_t) aLength - 1;
+}
+
+/**
+ * Time the gcd of g a and g b, checking it is g up to a constant.
+ */
+static bool benchGcd(const char *name, const Polynomial *g, const Polynomial *a, const Polynomial *b,
+                     int threadCount, bool euclid) {
+    Polynomial *x = polynomialMultiply(g, a), *y = polynomialMultiply(g, b);
+    double begin = benchWallSeconds();
+    Polynomial *divisor = polynomialGcd(x, y, threadCount);
+    benchReport(name, benchWallSeconds() - begin, (double) (x->count + y->count), "term");
+    Polynomial *quotient = divisor != NULL ? polynomialDivideExact(divisor, g) : NULL;
+    bool agree = quotient != NULL && quotient->count == 1 && quotient->monomials[0] == 0;
+    if (euclid) {
+        begin = benchSeconds();
+        int64_t degree = euclidDegree(x, y);
+        benchReport("  euclid over the rationals", benchSeconds() - begin, (double) (x->count + y->count), "term");
+        agree = agree && degree == polynomialDegree(g, g->variables[0]);
+    }
+    freePolynomial(quotient);
+    freePolynomial(divisor);
+    freePolynomial(y);
+    freePolynomial(x);
+    return agree;
+}
+
+int main() {
+    bool agree = true;
+    NodePool *pool = initNodePool();
+    uint32_t x = internSymbol(pool, "x", 1), variables[3] = {x, internSymbol(pool, "y", 1), internSymbol(pool, "z", 1)};
+    Polynomial *g = randomDense(x, EUCLID_DEGREE), *a = randomDense(x, EUCLID_DEGREE);
+    Polynomial *b = randomDense(x, EUCLID_DEGREE);
+    agree = benchGcd("univariate, degree 24", g, a, b, 1, true) && agree;
+    freePolynomial(g);
+    freePolynomial(a);
+    freePolynomial(b);
+    g = randomDense(x, DEGREE);
+    a = randomDense(x, DEGREE);
+    b = randomDense(x, DEGREE);
+    agree = benchGcd("univariate, degree 600", g, a, b, 1, false) && agree;
+    freePolynomial(g);
+    freePolynomial(a);
+    freePolynomial(b);
+    g = randomTrivariate(variables, 6);
+    a = randomTrivariate(variables, 6);
+    b = randomTrivariate(variables, 6);
+    agree = benchGcd("trivariate, total degree 12, one thread", g, a, b, 1, false) && agree;
+    agree = benchGcd("trivariate, total degree 12, threads", g, a, b, 0, false) && agree;
+    freePolynomial(g);
+    freePolynomial(a);
+    freePolynomial(b);
+
+    // 1 / (x + 1) + ... + 1 / (x + n), the denominator is the product.
+    BigInt coefficients[2];
+    initBigInt(coefficients);
+    initBigInt(coefficients + 1);
+    bigIntSetInt64(coefficients + 1, 1);
+    RationalFunction *sum = initRationalFunction(initPolynomial(), polynomialFromDense(x, coefficients + 1, 1));
+    int i;
+    double begin = benchSeconds();
+    for (i = 1; i <= SUM_TERMS; i++) {
+        bigIntSetInt64(coefficients, i);
+        RationalFunction *term = initRationalFunction(polynomialFromDense(x, coefficients + 1, 1),
+                                                      polynomialFromDense(x, coefficients, 2));
+        RationalFunction *next = rationalFunctionAdd(sum, term);
+        freeRationalFunction(sum);
+        freeRationalFunction(term);
+        sum = next;
+    }
+    benchReport("sum of 1 / (x + i)", benchSeconds() - begin, SUM_TERMS, "term");
+    agree = agree && polynomialDegree(sum->denominator, x) == SUM_TERMS &&
+            polynomialDegree(sum->numerator, x) == SUM_TERMS - 1;
+    freeRationalFunction(sum);
+    freeBigInt(coefficients);
+    freeBigInt(coefficients + 1);
+    freeNodePool(pool);
+
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
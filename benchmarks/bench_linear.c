@@ -0,0 +1,121 @@
+//
+// Exact determinants and solves against Gaussian elimination over fractions.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_linear.h"
+
+#define NAIVE_SIZE 40
+#define SIZE 500
+
+static ExactMatrix *randomMatrix(size_t rows, size_t columns) {
+    ExactMatrix *matrix = initExactMatrix(rows, columns);
+    size_t i;
+    for (i = 0; i < rows * columns; i++) {
+        matrix->values[i] = numberFromSmall(rand() % 199 - 99);
+    }
+    return matrix;
+}
+
+/**
+ * The textbook determinant, eliminating with fractions.
+ */
+static Number naiveDeterminant(const ExactMatrix *matrix) {
+    size_t n = matrix->rows, i, j, k;
+    Number *m = (Number *) malloc(sizeof(Number) * n * n), determinant = numberFromSmall(1);
+    for (i = 0; i < n * n; i++) {
+        m[i] = copyNumber(matrix->values[i]);
+    }
+    for (k = 0; k < n; k++) {
+        for (i = k; i < n && numberIsZero(m[i * n + k]); i++);
+        if (i == n) {
+            freeNumber(determinant);
+            determinant = numberFromSmall(0);
+            break;
+        }
+        if (i != k) {
+            for (j = 0; j < n; j++) {
+                Number swap = m[i * n + j];
+                m[i * n + j] = m[k * n + j];
+                m[k * n + j] = swap;
+            }
+            Number negated = numberNegate(determinant);
+            freeNumber(determinant);
+            determinant = negated;
+        }
+        Number product = numberMultiply(determinant, m[k * n + k]);
+        freeNumber(determinant);
+        determinant = product;
+        for (i = k + 1; i < n; i++) {
+            Number factor = numberDivide(m[i * n + k], m[k * n + k]);
+            for (j = k + 1; j < n; j++) {
+                Number scaled = numberMultiply(factor, m[k * n + j]);
+                Number difference = numberSubtract(m[i * n + j], scaled);
+                freeNumber(scaled);
+                freeNumber(m[i * n + j]);
+                m[i * n + j] = difference;
+            }
+            freeNumber(factor);
+        }
+    }
+    for (i = 0; i < n * n; i++) {
+        freeNumber(m[i]);
+    }
+    free(m);
+    return determinant;
+}
+
+int main() {
+    ExactMatrix *small = randomMatrix(NAIVE_SIZE, NAIVE_SIZE);
+    double begin = benchWallSeconds();
+    Number expected = naiveDeterminant(small);
+    double naiveTime = benchWallSeconds() - begin;
+    benchReport("fraction determinant 40", naiveTime, 1, "matrix");
+    begin = benchWallSeconds();
+    Number determinant = exactMatrixDeterminant(small, 0);
+    double elapsed = benchWallSeconds() - begin;
+    benchReport("exact determinant 40", elapsed, 1, "matrix");
+    printf("speedup %.1fx\n", naiveTime / elapsed);
+    bool agree = numberCompare(expected, determinant) == 0;
+    freeNumber(determinant);
+    freeNumber(expected);
+
+    ExactMatrix *a = randomMatrix(SIZE, SIZE), *b = randomMatrix(SIZE, 1);
+    begin = benchWallSeconds();
+    determinant = exactMatrixDeterminant(a, 0);
+    benchReport("exact determinant 500", benchWallSeconds() - begin, 1, "matrix");
+    begin = benchWallSeconds();
+    size_t rank = exactMatrixRank(a, 0);
+    benchReport("exact rank 500", benchWallSeconds() - begin, 1, "matrix");
+    begin = benchWallSeconds();
+    ExactMatrix *x = exactMatrixSolve(a, b, 0);
+    benchReport("exact solve 500", benchWallSeconds() - begin, 1, "matrix");
+
+    // Check a x = b exactly on a few rows.
+    size_t i, j;
+    for (i = 0; i < SIZE && x != NULL; i += SIZE / 5) {
+        Number sum = numberFromSmall(0);
+        for (j = 0; j < SIZE; j++) {
+            Number product = numberMultiply(a->values[i * SIZE + j], x->values[j]);
+            Number next = numberAdd(sum, product);
+            freeNumber(product);
+            freeNumber(sum);
+            sum = next;
+        }
+        agree = agree && numberCompare(sum, b->values[i]) == 0;
+        freeNumber(sum);
+    }
+    agree = agree && x != NULL && rank == SIZE && !numberIsZero(determinant);
+
+    freeNumber(determinant);
+    freeExactMatrix(x);
+    freeExactMatrix(b);
+    freeExactMatrix(a);
+    freeExactMatrix(small);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
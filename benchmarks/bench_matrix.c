@@ -0,0 +1,138 @@
+//
+// Blocked dense matrix kernels against plain loops.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_matrix.h"
+
+#define SIZE 768
+#define REPEATS 3
+
+static DenseMatrix *randomMatrix(size_t rows, size_t columns) {
+    DenseMatrix *matrix = initDenseMatrix(rows, columns);
+    size_t i, j;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < columns; j++) {
+            denseMatrixSet(matrix, i, j, rand() / (double) RAND_MAX - 0.5);
+        }
+    }
+    return matrix;
+}
+
+/**
+ * The textbook product, a dot product per element.
+ */
+static DenseMatrix *naiveMultiply(const DenseMatrix *a, const DenseMatrix *b) {
+    DenseMatrix *product = initDenseMatrix(a->rows, b->columns);
+    size_t i, j, p;
+    for (i = 0; i < a->rows; i++) {
+        for (j = 0; j < b->columns; j++) {
+            double sum = 0;
+            for (p = 0; p < a->columns; p++) {
+                sum += denseMatrixGet(a, i, p) * denseMatrixGet(b, p, j);
+            }
+            denseMatrixSet(product, i, j, sum);
+        }
+    }
+    return product;
+}
+
+static DenseMatrix *naiveTranspose(const DenseMatrix *matrix) {
+    DenseMatrix *result = initDenseMatrix(matrix->columns, matrix->rows);
+    size_t i, j;
+    for (i = 0; i < matrix->rows; i++) {
+        for (j = 0; j < matrix->columns; j++) {
+            denseMatrixSet(result, j, i, denseMatrixGet(matrix, i, j));
+        }
+    }
+    return result;
+}
+
+int main() {
+    DenseMatrix *a = randomMatrix(SIZE, SIZE), *b = randomMatrix(SIZE, SIZE);
+    double flops = 2.0 * SIZE * SIZE * SIZE, best, naiveTime;
+    int repeat, threadCount;
+    size_t i, j;
+
+    double begin = benchWallSeconds();
+    DenseMatrix *expected = naiveMultiply(a, b);
+    naiveTime = benchWallSeconds() - begin;
+    benchReport("naive product 768", naiveTime, flops, "flop");
+    bool agree = true;
+    for (threadCount = 1; threadCount >= 0; threadCount--) {
+        DenseMatrix *product = NULL;
+        best = 1e30;
+        for (repeat = 0; repeat < REPEATS; repeat++) {
+            freeDenseMatrix(product);
+            begin = benchWallSeconds();
+            product = denseMatrixMultiply(a, b, threadCount);
+            double elapsed = benchWallSeconds() - begin;
+            best = elapsed < best ? elapsed : best;
+        }
+        benchReport(threadCount ? "blocked product 768, 1 thread" : "blocked product 768, all threads", best,
+                    flops, "flop");
+        printf("speedup %.1fx\n", naiveTime / best);
+        for (i = 0; i < SIZE; i++) {
+            for (j = 0; j < SIZE; j++) {
+                agree = agree && fabs(denseMatrixGet(product, i, j) - denseMatrixGet(expected, i, j)) < 1e-10;
+            }
+        }
+        freeDenseMatrix(product);
+    }
+
+    DenseMatrix *big = randomMatrix(4 * SIZE, 4 * SIZE);
+    begin = benchWallSeconds();
+    DenseMatrix *plain = naiveTranspose(big);
+    naiveTime = benchWallSeconds() - begin;
+    benchReport("naive transpose 3072", naiveTime, 16.0 * SIZE * SIZE, "element");
+    begin = benchWallSeconds();
+    DenseMatrix *blocked = denseMatrixTranspose(big);
+    double elapsed = benchWallSeconds() - begin;
+    benchReport("blocked transpose 3072", elapsed, 16.0 * SIZE * SIZE, "element");
+    printf("speedup %.1fx\n", naiveTime / elapsed);
+    for (i = 0; i < 4 * SIZE; i++) {
+        for (j = 0; j < 4 * SIZE; j++) {
+            agree = agree && denseMatrixGet(plain, i, j) == denseMatrixGet(blocked, i, j);
+        }
+    }
+    begin = benchWallSeconds();
+    DenseMatrix *sum = denseMatrixAdd(big, plain);
+    elapsed = benchWallSeconds() - begin;
+    benchReport("add 3072", elapsed, 16.0 * SIZE * SIZE, "element");
+
+    Arena *arena = initArena(1 << 20);
+    MatrixToken *token = initMatrixToken(arena, 1);
+    begin = benchWallSeconds();
+    for (i = 0; i < SIZE; i++) { // Cell by cell, as the parser fills a matrix literal.
+        for (j = 0; j < SIZE; j++) {
+            matrixAddMember(token, (int) i, (int) j, (Token *) initNumberToken(arena, 1, denseMatrixGet(a, i, j)));
+        }
+    }
+    elapsed = benchWallSeconds() - begin;
+    benchReport("fill matrix token 768", elapsed, (double) SIZE * SIZE, "member");
+    DenseMatrix *filled = denseMatrixFromToken(token);
+    for (i = 0; i < SIZE; i++) {
+        for (j = 0; j < SIZE; j++) {
+            agree = agree && denseMatrixGet(filled, i, j) == denseMatrixGet(a, i, j);
+        }
+    }
+    agree = agree && matrixGetMember(token, -1, 0) == NULL && matrixGetMember(token, 0, SIZE) == NULL;
+
+    freeDenseMatrix(filled);
+    freeArena(arena);
+
+    freeDenseMatrix(sum);
+    freeDenseMatrix(blocked);
+    freeDenseMatrix(plain);
+    freeDenseMatrix(big);
+    freeDenseMatrix(expected);
+    freeDenseMatrix(b);
+    freeDenseMatrix(a);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+//
+// The numeric tower against plain double, and big integer multiplication
+// against the schoolbook method it switches away from.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../internals/fluxion_number.h"
+
+#define SMALL_ITERATIONS 20000000
+#define FLOAT_ITERATIONS 1000000
+#define HARMONIC_TERMS 2000
+#define REPEATS 5
+
+/**
+ * Reference schoolbook product, result has na + nb limbs.
+ */
+static void schoolbook(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb) {
+    size_t i, j;
+    memset(result, 0, sizeof(Limb) * (na + nb));
+    for (i = 0; i < nb; i++) {
+        DoubleLimb carry = 0;
+        for (j = 0; j < na; j++) {
+            carry += (DoubleLimb) a[j] * b[i] + result[i + j];
+            result[i + j] = (Limb) carry;
+            carry >>= LIMB_BITS;
+        }
+        result[i + na] = (Limb) carry;
+    }
+}
+
+static void randomBigInt(BigInt *integer, size_t size, unsigned *seed) {
+    size_t i;
+    bigIntReserve(integer, size);
+    for (i = 0; i < size; i++) {
+        *seed = *seed * 1103515245u + 12345u;
+        integer->limbs[i] = *seed ^ (*seed << 16);
+    }
+    integer->limbs[size - 1] |= 1;
+    integer->size = (uint32_t) size;
+    integer->negative = false;
+}
+
+int main() {
+    int i, repeat;
+    double best, checksum = 0;
+
+    // Small integers, the immediate path has to stay close to double.
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds(), sum = 0;
+        for (i = 0; i < SMALL_ITERATIONS; i++) {
+            sum = sum + (double) (i & 1023) * 3.0;
+        }
+        double elapsed = benchSeconds() - begin;
+        checksum += sum;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("double multiply add", best, SMALL_ITERATIONS, "op");
+
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        Number sum = numberFromSmall(0), three = numberFromSmall(3);
+        for (i = 0; i < SMALL_ITERATIONS; i++) {
+            Number product = numberMultiply(numberFromSmall(i & 1023), three);
+            Number next = numberAdd(sum, product);
+            freeNumber(product);
+            freeNumber(sum);
+            sum = next;
+        }
+        double elapsed = benchSeconds() - begin;
+        checksum -= numberToDouble(sum);
+        freeNumber(sum);
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("Number multiply add (immediate)", best, SMALL_ITERATIONS, "op");
+    if (checksum != 0) {
+        printf("checksum mismatch, %.17g\n", checksum);
+        return 1;
+    }
+
+    // Floats at double precision.
+    best = 1e30;
+    double product = 1;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        product = 1;
+        for (i = 0; i < FLOAT_ITERATIONS; i++) {
+            product = product * 1.0000001 + 1e-9;
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("double float multiply add", best, FLOAT_ITERATIONS, "op");
+
+    best = 1e30;
+    Number factor = numberFromDouble(1.0000001), offset = numberFromDouble(1e-9);
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        Number accumulator = numberToFloat(numberFromSmall(1), 53);
+        for (i = 0; i < FLOAT_ITERATIONS; i++) {
+            Number scaled = numberMultiply(accumulator, factor);
+            freeNumber(accumulator);
+            accumulator = numberAdd(scaled, offset);
+            freeNumber(scaled);
+        }
+        double elapsed = benchSeconds() - begin;
+        if (numberToDouble(accumulator) != product) {
+            printf("float mismatch, %.17g != %.17g\n", numberToDouble(accumulator), product);
+            return 1;
+        }
+        freeNumber(accumulator);
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("Number float multiply add (53 bits)", best, FLOAT_ITERATIONS, "op");
+    freeNumber(factor);
+    freeNumber(offset);
+
+    // Exact rationals, which double cannot do at all.
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        Number harmonic = numberFromSmall(0);
+        for (i = 1; i <= HARMONIC_TERMS; i++) {
+            Number term = numberDivide(numberFromSmall(1), numberFromSmall(i));
+            Number next = numberAdd(harmonic, term);
+            freeNumber(term);
+            freeNumber(harmonic);
+            harmonic = next;
+        }
+        double elapsed = benchSeconds() - begin;
+        freeNumber(harmonic);
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("rational harmonic sum", best, HARMONIC_TERMS, "term");
+
+    // Big integer products by size.
+    unsigned seed = 7;
+    size_t size;
+    for (size = 16; size <= 8192; size *= 4) {
+        BigInt a, b, result;
+        initBigInt(&a);
+        initBigInt(&b);
+        initBigInt(&result);
+        randomBigInt(&a, size, &seed);
+        randomBigInt(&b, size, &seed);
+        int count = (int) (4000000 / (size * size)) + 1;
+        Limb *reference = (Limb *) malloc(sizeof(Limb) * 2 * size);
+        char name[64];
+
+        best = 1e30;
+        for (repeat = 0; repeat < REPEATS; repeat++) {
+            double begin = benchSeconds();
+            for (i = 0; i < count; i++) {
+                schoolbook(reference, a.limbs, size, b.limbs, size);
+            }
+            double elapsed = benchSeconds() - begin;
+            best = elapsed < best ? elapsed : best;
+        }
+        snprintf(name, sizeof(name), "schoolbook %zu x %zu limbs", size, size);
+        benchReport(name, best, count, "mul");
+
+        best = 1e30;
+        for (repeat = 0; repeat < REPEATS; repeat++) {
+            double begin = benchSeconds();
+            for (i = 0; i < count; i++) {
+                bigIntMultiply(&result, &a, &b);
+            }
+            double elapsed = benchSeconds() - begin;
+            best = elapsed < best ? elapsed : best;
+        }
+        snprintf(name, sizeof(name), "bigIntMultiply %zu x %zu limbs", size, size);
+        benchReport(name, best, count, "mul");
+        if (result.size != 2 * size || memcmp(result.limbs, reference, sizeof(Limb) * 2 * size) != 0) {
+            printf("product mismatch at %zu limbs\n", size);
+            return 1;
+        }
+        free(reference);
+        freeBigInt(&a);
+        freeBigInt(&b);
+        freeBigInt(&result);
+    }
+    limbPoolTrim();
+    return 0;
+}
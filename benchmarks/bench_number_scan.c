@@ -0,0 +1,143 @@
+//
+// Number literal scanning against copying each literal and calling strtod.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../internals/fluxion_number_scan.h"
+#include "../internals/fluxion_parser.h"
+
+#define LITERAL_COUNT 2000000
+#define ROW_SIZE 16 // Literals in each {...} row of the table.
+#define REPEATS 5
+
+/**
+ * The previous approach, copy the span and let strtod do the work.
+ */
+static double copyAndStrtod(const char *start, size_t length) {
+    char buffer[64];
+    memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    return strtod(buffer, NULL);
+}
+
+int main() {
+    // A data table of {...} rows, integers and decimals with up to 17 significant digits.
+    size_t capacity = (size_t) LITERAL_COUNT * 24;
+    char *source = (char *) malloc(capacity);
+    uint32_t *offsets = (uint32_t *) malloc(sizeof(uint32_t) * LITERAL_COUNT);
+    uint32_t *lengths = (uint32_t *) malloc(sizeof(uint32_t) * LITERAL_COUNT);
+    size_t length = 0;
+    unsigned seed = 42;
+    int i, repeat;
+    for (i = 0; i < LITERAL_COUNT; i++) {
+        seed = seed * 1103515245u + 12345u;
+        if (i % ROW_SIZE == 0) {
+            source[length++] = '{';
+        }
+        offsets[i] = (uint32_t) length;
+        if (seed & 0x10000) {
+            length += sprintf(source + length, "%u", seed >> 8);
+        } else {
+            length += sprintf(source + length, "%u.%06u", (seed >> 12) % 100000, seed % 1000000);
+        }
+        lengths[i] = (uint32_t) (length - offsets[i]);
+        length += sprintf(source + length, i % ROW_SIZE == ROW_SIZE - 1 ? "}\n" : ", ");
+    }
+    source[length] = '\0';
+
+    double best = 1e30, checksum = 0;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        for (i = 0; i < LITERAL_COUNT; i++) {
+            checksum += copyAndStrtod(source + offsets[i], lengths[i]);
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("copy + strtod", best, LITERAL_COUNT, "literal");
+
+    double scanned = 0;
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        for (i = 0; i < LITERAL_COUNT; i++) {
+            NumberLiteral literal;
+            scanNumberLiteral(source + offsets[i], lengths[i], &literal);
+            scanned += literal.value;
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("scanNumberLiteral", best, LITERAL_COUNT, "literal");
+    if (scanned != checksum) {
+        printf("checksum mismatch, %.17g != %.17g\n", scanned, checksum);
+        return 1;
+    }
+
+    double table = 0;
+    bool exact = true;
+    for (i = 0; i < LITERAL_COUNT; i++) { // The word reduction of decimals against the big integer one.
+        NumberLiteral literal;
+        scanNumberLiteral(source + offsets[i], lengths[i], &literal);
+        table += literal.value;
+        Number fast = numberFromLiteral(&literal), slow = numberFromDecimal(source + offsets[i], lengths[i]);
+        exact = exact && numberKind(fast) == numberKind(slow) && numberCompare(fast, slow) == 0 &&
+                numberToDouble(fast) == literal.value; // Number tokens hash by the double.
+        freeNumber(fast);
+        freeNumber(slow);
+    }
+    if (!exact) {
+        printf("exact literal mismatch\n");
+        return 1;
+    }
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        Arena *arena = initArena(0);
+        double tokens = 0, begin = benchSeconds();
+        for (i = 0; i < LITERAL_COUNT; i++) {
+            NumberLiteral literal;
+            scanNumberLiteral(source + offsets[i], lengths[i], &literal);
+            tokens += initNumberTokenLiteral(arena, 1, &literal)->value;
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+        freeArena(arena);
+        if (tokens != table) {
+            printf("number token mismatch\n");
+            return 1;
+        }
+    }
+    benchReport("scan into number tokens", best, LITERAL_COUNT, "literal");
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        Parser *parser = parse(source);
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+        // Every row is a set of ROW_SIZE numbers, summed in the order they were written.
+        bool valid = parser->errorCount == 0 && getTokenCount(parser) == LITERAL_COUNT / ROW_SIZE;
+        double parsed = 0;
+        int row, member;
+        for (row = 0; valid && row < getTokenCount(parser); row++) {
+            const FiniteToken *finite = (const FiniteToken *) ((ExpressionToken *) getTokens(parser)[row])->root;
+            valid = finite->token.tokenType == FINITE && finite->current == ROW_SIZE;
+            for (member = 0; valid && member < ROW_SIZE; member++) {
+                valid = finite->members[member]->tokenType == NUMBER;
+                parsed += valid ? ((const NumberToken *) finite->members[member])->value : 0;
+            }
+        }
+        freeParser(parser);
+        if (!valid || parsed != table) {
+            printf("parsed table mismatch\n");
+            return 1;
+        }
+    }
+    benchReport("parse numeric table", best, LITERAL_COUNT, "literal");
+
+    free(offsets);
+    free(lengths);
+    free(source);
+    return 0;
+}
@@ -0,0 +1,123 @@
+//
+// Dense polynomial products by schoolbook, Karatsuba and NTT, and sparse and multivariate products.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_poly.h"
+
+#define SCHOOLBOOK_LIMIT 10000 // Longer products are not timed by schoolbook.
+#define KARATSUBA_LIMIT 10000
+
+static const char *algorithmNames[] = {"auto", "schoolbook", "karatsuba", "ntt"};
+
+static BigInt *randomCoefficients(size_t count, uint32_t bits) {
+    BigInt *values = (BigInt *) malloc(sizeof(BigInt) * count);
+    size_t i;
+    uint32_t limb;
+    for (i = 0; i < count; i++) {
+        initBigInt(values + i);
+        bigIntSetInt64(values + i, rand() % 2001 - 1000);
+        for (limb = 0; limb < bits / 32; limb++) {
+            bigIntShiftLeft(values + i, values + i, 32);
+            bigIntAddLimb(values + i, values + i, (Limb) rand() * 2654435761u);
+        }
+    }
+    return values;
+}
+
+static void freeCoefficients(BigInt *values, size_t count) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        freeBigInt(values + i);
+    }
+    free(values);
+}
+
+/**
+ * Time every algorithm fast enough at a length, checking they agree.
+ */
+static bool benchDense(size_t length, uint32_t bits) {
+    BigInt *a = randomCoefficients(length, bits), *b = randomCoefficients(length, bits);
+    BigInt *results[4] = {NULL};
+    bool agree = true;
+    char name[64];
+    int algorithm;
+    size_t i;
+    for (algorithm = POLY_MULTIPLY_SCHOOLBOOK; algorithm <= POLY_MULTIPLY_NTT; algorithm++) {
+        if ((algorithm == POLY_MULTIPLY_SCHOOLBOOK && length > SCHOOLBOOK_LIMIT) ||
+            (algorithm == POLY_MULTIPLY_KARATSUBA && length > KARATSUBA_LIMIT)) {
+            continue;
+        }
+        results[algorithm] = (BigInt *) malloc(sizeof(BigInt) * (2 * length - 1));
+        for (i = 0; i < 2 * length - 1; i++) {
+            initBigInt(results[algorithm] + i);
+        }
+        double begin = benchSeconds();
+        polyMultiplyDense(results[algorithm], a, length, b, length, (PolyMultiplyAlgorithm) algorithm);
+        snprintf(name, sizeof(name), "%s length %zu, %u bits", algorithmNames[algorithm], length, bits);
+        benchReport(name, benchSeconds() - begin, (double) length, "coefficient");
+    }
+    for (algorithm = POLY_MULTIPLY_KARATSUBA; algorithm <= POLY_MULTIPLY_NTT; algorithm++) {
+        const BigInt *reference = results[algorithm - 1];
+        for (i = 0; results[algorithm] != NULL && reference != NULL && i < 2 * length - 1; i++) {
+            agree = agree && bigIntCompare(results[algorithm] + i, reference + i) == 0;
+        }
+    }
+    for (algorithm = POLY_MULTIPLY_SCHOOLBOOK; algorithm <= POLY_MULTIPLY_NTT; algorithm++) {
+        if (results[algorithm] != NULL) {
+            freeCoefficients(results[algorithm], 2 * length - 1);
+        }
+    }
+    freeCoefficients(b, length);
+    freeCoefficients(a, length);
+    return agree;
+}
+
+/**
+ * Time expanding an expression, checking the number of terms.
+ */
+static bool benchExpand(NodePool *pool, const char *name, NodeId node, size_t terms) {
+    double begin = benchSeconds();
+    Polynomial *polynomial = polynomialFromNode(pool, node);
+    benchReport(name, benchSeconds() - begin, polynomial ? (double) polynomial->count : 0, "term");
+    bool agree = polynomial != NULL && polynomial->count == terms;
+    freePolynomial(polynomial);
+    return agree;
+}
+
+int main() {
+    bool agree = true;
+    size_t length;
+    for (length = 100; length <= 100000; length *= 10) {
+        agree = benchDense(length, 0) && agree;
+    }
+    agree = benchDense(1000, 256) && agree;
+    agree = benchDense(300, 4096) && agree;
+
+    NodePool *pool = initNodePool();
+    NodeId x = nodeSymbol(pool, 1, "x", 1), y = nodeSymbol(pool, 1, "y", 1), z = nodeSymbol(pool, 1, "z", 1);
+    NodeId one = nodeNumber(pool, 1, 1);
+    NodeId binomial = nodeBinary(pool, 1, POWER, nodeBinary(pool, 1, PLUS, x, one), nodeNumber(pool, 1, 200));
+    agree = benchExpand(pool, "expand (x + 1)^200", binomial, 201) && agree;
+    NodeId sum = nodeBinary(pool, 1, PLUS, nodeBinary(pool, 1, PLUS, nodeBinary(pool, 1, PLUS, x, y), z), one);
+    NodeId dense = nodeBinary(pool, 1, POWER, sum, nodeNumber(pool, 1, 30));
+    agree = benchExpand(pool, "expand (x + y + z + 1)^30", dense, 5456) && agree; // C(33, 3) terms.
+    // 1 + x^1000 y + y^1000 z + z^1000 x, its powers are far too sparse for a dense product.
+    NodeId sparse = one, thousand = nodeNumber(pool, 1, 1000), variables[] = {x, y, z};
+    int v;
+    for (v = 0; v < 3; v++) {
+        NodeId power = nodeBinary(pool, 1, POWER, variables[v], thousand);
+        NodeId term = nodeBinary(pool, 1, MULTIPLY, power, variables[(v + 1) % 3]);
+        sparse = nodeBinary(pool, 1, PLUS, sparse, term);
+    }
+    NodeId sparsePower = nodeBinary(pool, 1, POWER, sparse, nodeNumber(pool, 1, 12));
+    agree = benchExpand(pool, "expand sparse ^12", sparsePower, 455) && agree; // C(15, 3) terms.
+    freeNodePool(pool);
+
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+//
+// Rule dispatch by discrimination tree against trying every rule at every node.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../internals/fluxion_rewrite.h"
+
+#define USER_RULES 300 // f_k(x, 0) = x and f_k(x, 1) = f_k(1, x).
+#define TERMS 20000
+#define SEED 7
+#define REPEATS 5000000 // A normalised rewrite is a lookup, it is repeated to be measurable.
+#define COUNTERS 8 // Rules whose counters are printed, --all-counters prints every one.
+
+static uint64_t naiveAttempts;
+
+static bool naiveMatch(const NodePool *pool, const RewriteRule *rule, NodeId pattern, NodeId term, NodeId *bindings) {
+    uint8_t tag = nodeTag(pool, pattern);
+    if (tag == NODE_SYMBOL && nodeSymbolOf(pool, pattern) >= BUILTIN_SYMBOL_COUNT) {
+        uint32_t slot = 0;
+        while (rule->variables[slot] != nodeSymbolOf(pool, pattern)) {
+            slot++;
+        }
+        if (bindings[slot] == NODE_NONE) {
+            bindings[slot] = term;
+        }
+        return bindings[slot] == term;
+    }
+    if (tag == NODE_NUMBER || tag == NODE_SYMBOL || nodeTag(pool, term) != tag ||
+        nodeChildCount(pool, pattern) != nodeChildCount(pool, term)) {
+        return pattern == term;
+    }
+    if (tag == NODE_CALL && nodeChild(pool, pattern, 0) != nodeChild(pool, term, 0)) {
+        return false;
+    }
+    uint32_t i;
+    for (i = tag == NODE_CALL; i < nodeChildCount(pool, pattern); i++) {
+        if (!naiveMatch(pool, rule, nodeChild(pool, pattern, i), nodeChild(pool, term, i), bindings)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Try every rule at every node of the expression, the dispatch an index replaces.
+ * @return the number of nodes some rule matches.
+ */
+static uint32_t naiveScan(const RewriteEngine *engine, NodeId node) {
+    const NodePool *pool = engine->pool;
+    uint32_t matches = 0, i;
+    uint8_t tag = nodeTag(pool, node);
+    if (tag != NODE_NUMBER && tag != NODE_SYMBOL) {
+        for (i = tag == NODE_CALL; i < nodeChildCount(pool, node); i++) {
+            matches += naiveScan(engine, nodeChild(pool, node, i));
+        }
+    }
+    for (i = 0; i < engine->ruleCount; i++) {
+        NodeId bindings[REWRITE_MAX_VARIABLES];
+        uint32_t j;
+        for (j = 0; j < REWRITE_MAX_VARIABLES; j++) {
+            bindings[j] = NODE_NONE;
+        }
+        naiveAttempts++;
+        if (naiveMatch(pool, engine->rules + i, engine->rules[i].left, node, bindings)) {
+            return matches + 1;
+        }
+    }
+    return matches;
+}
+
+/**
+ * A random sum of terms, each a product or a call of one of the user functions.
+ */
+static NodeId randomExpression(NodePool *pool, uint32_t *functions) {
+    NodeId sum = nodeNumber(pool, 1, 0);
+    char name[16];
+    int i;
+    for (i = 0; i < TERMS; i++) {
+        snprintf(name, sizeof(name), "v%d", rand() % 50);
+        NodeId variable = nodeSymbol(pool, 1, name, strlen(name)), term;
+        if (rand() % 2) {
+            NodeId args[2] = {variable, nodeNumber(pool, 1, rand() % 3)};
+            term = nodeCall(pool, 1, functions[rand() % USER_RULES], args, 2);
+        } else {
+            term = nodeBinary(pool, 1, MULTIPLY, variable, nodeNumber(pool, 1, rand() % 3));
+        }
+        sum = nodeBinary(pool, 1, PLUS, term, sum);
+    }
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    NodePool *pool = initNodePool();
+    RewriteEngine *engine = initRewriteEngine(pool);
+    uint32_t functions[USER_RULES];
+    char rule[64];
+    int i;
+    for (i = 0; i < USER_RULES; i++) {
+        snprintf(rule, sizeof(rule), "f%d(x, 0) = x\nf%d(x, 1) = f%d(1, x)", i, i, i);
+        addRewriteRules(engine, rule);
+        snprintf(rule, sizeof(rule), "f%d", i);
+        functions[i] = internSymbol(pool, rule, strlen(rule));
+    }
+    srand(SEED);
+    NodeId expression = randomExpression(pool, functions);
+    printf("%u rules, %u tree nodes, %u expression nodes\n", engine->ruleCount, engine->treeCount, pool->count);
+
+    double begin = benchSeconds();
+    uint32_t matches = naiveScan(engine, expression);
+    benchReport("try every rule, one pass", benchSeconds() - begin, (double) naiveAttempts, "attempt");
+    printf("%u nodes match, %llu attempts\n", matches, (unsigned long long) naiveAttempts);
+
+    begin = benchSeconds();
+    NodeId normal = rewriteNode(engine, expression);
+    benchReport("indexed rewrite to fixpoint", benchSeconds() - begin, (double) engine->visits, "node");
+    printf("%llu candidates for %llu nodes\n", (unsigned long long) engine->candidates,
+           (unsigned long long) engine->visits);
+    uint64_t visits = engine->visits;
+    bool agree = true;
+    begin = benchSeconds();
+    for (i = 0; i < REPEATS; i++) {
+        agree = agree && rewriteNode(engine, expression) == normal && rewriteNode(engine, normal) == normal;
+    }
+    benchReport("rewrite again, normalised", benchSeconds() - begin, 2.0 * REPEATS, "expression");
+    agree = agree && engine->visits == visits;
+    bool all = argc > 1 && strcmp(argv[1], "--all-counters") == 0;
+    printRewriteCounters(engine, stdout, all ? 0 : COUNTERS);
+
+    freeRewriteEngine(engine);
+    freeNodePool(pool);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
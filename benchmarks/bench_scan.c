@@ -0,0 +1,122 @@
+//
+// Throughput of the scanning kernels and of the lexer at every instruction set level.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../internals/fluxion_scan.h"
+#include "../internals/fluxion_lexer.h"
+
+#define SOURCE_SIZE (32 * 1024 * 1024)
+#define REPEATS 5
+
+static const char *levelNames[] = {"scalar", "sse2", "avx2"};
+
+/**
+ * Generate a source shaped like our generated libraries,
+ * long comments and long identifiers.
+ */
+static char *generateSource(size_t size) {
+    char *source = (char *) malloc(size + 1);
+    size_t length = 0;
+    unsigned seed = 12345;
+    while (length + 512 < size) {
+        seed = seed * 1103515245u + 12345u;
+        switch (seed >> 16 & 3) {
+            case 0:
+                length += sprintf(source + length,
+                                  ";; generated helper for the coefficient table, do not edit by hand %u\n", seed);
+                break;
+            case 1:
+                length += sprintf(source + length, ";* block comment describing the derivation of the terms\n"
+                                                   "   which spans multiple lines of prose %u *;\n", seed);
+                break;
+            default:
+                length += sprintf(source + length,
+                                  "coefficientTableEntryNumber%u := previousCoefficientValue%u * scale    + 1\n",
+                                  seed, seed >> 3);
+                break;
+        }
+    }
+    source[length] = '\0';
+    return source;
+}
+
+typedef const uint8_t *(*Kernel)(const uint8_t *, const uint8_t *);
+
+static void benchKernel(const char *name, Kernel kernel, const uint8_t *start, const uint8_t *end) {
+    double best = 1e30;
+    int repeat;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        const uint8_t *ch = start;
+        while (ch < end) {
+            ch = kernel(ch, end) + 1;
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport(name, best, (double) (end - start), "B");
+}
+
+int main() {
+    char *source = generateSource(SOURCE_SIZE);
+    size_t length = strlen(source);
+    const uint8_t *start = (const uint8_t *) source;
+    const uint8_t *end = start + length;
+
+    // Uniform inputs, each kernel runs to the end of its run.
+    char *spaces = (char *) malloc(length + 1);
+    char *letters = (char *) malloc(length + 1);
+    char *comment = (char *) malloc(length + 1);
+    memset(spaces, ' ', length);
+    memset(letters, 'q', length);
+    memset(comment, 'c', length);
+    size_t i;
+    for (i = 80; i < length; i += 81) {
+        comment[i] = '\n';
+    }
+    spaces[length] = letters[length] = comment[length] = '\0';
+
+    int level;
+    for (level = SCAN_SCALAR; level <= (int) scanBestLevel(); level++) {
+        scanSetLevel((ScanLevel) level);
+        char name[64];
+        printf("-- %s\n", levelNames[level]);
+        snprintf(name, sizeof(name), "newline (%s)", levelNames[level]);
+        benchKernel(name, scanNewline, start, end);
+        snprintf(name, sizeof(name), "whitespace run (%s)", levelNames[level]);
+        benchKernel(name, scanWhitespace, (const uint8_t *) spaces, (const uint8_t *) spaces + length);
+        snprintf(name, sizeof(name), "identifier run (%s)", levelNames[level]);
+        benchKernel(name, scanIdentifier, (const uint8_t *) letters, (const uint8_t *) letters + length);
+
+        double best = 1e30;
+        int repeat;
+        for (repeat = 0; repeat < REPEATS; repeat++) {
+            int newlines = 0;
+            double begin = benchSeconds();
+            scanCommentEnd((const uint8_t *) comment, (const uint8_t *) comment + length, &newlines);
+            double elapsed = benchSeconds() - begin;
+            best = elapsed < best ? elapsed : best;
+        }
+        snprintf(name, sizeof(name), "comment end (%s)", levelNames[level]);
+        benchReport(name, best, (double) length, "B");
+
+        best = 1e30;
+        for (repeat = 0; repeat < REPEATS; repeat++) {
+            double begin = benchSeconds();
+            LexBuffer *buffer = lexSource(source);
+            double elapsed = benchSeconds() - begin;
+            freeLexBuffer(buffer);
+            best = elapsed < best ? elapsed : best;
+        }
+        snprintf(name, sizeof(name), "lexSource (%s)", levelNames[level]);
+        benchReport(name, best, (double) length, "B");
+    }
+    free(spaces);
+    free(letters);
+    free(comment);
+    free(source);
+    return 0;
+}
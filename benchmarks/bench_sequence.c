@@ -0,0 +1,136 @@
+//
+// Sequence evaluation against recomputing the recurrence tree.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../internals/fluxion_parser.h"
+#include "../internals/fluxion_sequence.h"
+
+#define NAIVE_INDEX 30
+#define DOUBLE_TERMS 10002432 // A multiple of STREAM_CHUNK.
+#define STREAM_CHUNK 4096
+#define MODULUS 1000000007ull
+
+/**
+ * What x_n costs without memoization, every term recomputes the terms it refers to.
+ */
+static double naiveTerm(const SequenceToken *sequence, const Token *token, int index) {
+    if (token == NULL) {
+        return NAN;
+    }
+    switch (token->tokenType) {
+        case NUMBER:
+            return ((const NumberToken *) token)->value;
+        case EXPRESSION:
+            return naiveTerm(sequence, ((const ExpressionToken *) token)->root, index);
+        case IDENTIFIER:
+            return strcmp(((const IdentifierToken *) token)->name, sequence->numerical->name) == 0 ? index : NAN;
+        case OPERATOR: {
+            const OperatorToken *operator = (const OperatorToken *) token;
+            if (operator->operatorType == GET) { // x_{n - c}
+                const ExpressionToken *offset = (const ExpressionToken *) operator->right;
+                const OperatorToken *difference = (const OperatorToken *) (offset->token.tokenType == EXPRESSION ?
+                                                                          offset->root : operator->right);
+                int term = index - (int) ((const NumberToken *) difference->right)->value;
+                if (term < sequence->prelist->current) {
+                    return ((const NumberToken *) sequence->prelist->members[term])->value;
+                }
+                return naiveTerm(sequence, (const Token *) sequence->rule, term);
+            }
+            double a = naiveTerm(sequence, operator->left, index);
+            double b = naiveTerm(sequence, operator->right, index);
+            switch (operator->operatorType) {
+                case PLUS:
+                    return a + b;
+                case MINUS:
+                    return a - b;
+                case MULTIPLY:
+                    return a * b;
+                default:
+                    return NAN;
+            }
+        }
+        default:
+            return NAN;
+    }
+}
+
+int main() {
+    Parser *parser = parse("{0, 1} x_n -> x_{n - 1} + x_{n - 2}");
+    const SequenceToken *fibonacci = (const SequenceToken *) getTokens(parser)[0];
+    if (fibonacci->token.tokenType == EXPRESSION) {
+        fibonacci = (const SequenceToken *) ((const ExpressionToken *) fibonacci)->root;
+    }
+    SequenceEngine *engine = initSequenceEngine(fibonacci);
+    uint64_t i, term;
+
+    double begin = benchSeconds();
+    double naive = naiveTerm(fibonacci, (const Token *) fibonacci->rule, NAIVE_INDEX);
+    double elapsed = benchSeconds() - begin;
+    benchReport("naive recursion x_30", elapsed, 1, "term");
+    double naiveTime = elapsed;
+    begin = benchSeconds();
+    double memoized = sequenceTermDouble(engine, NAIVE_INDEX);
+    elapsed = benchSeconds() - begin;
+    benchReport("ring buffer x_30", elapsed, 1, "term");
+    printf("speedup %.0fx\n", naiveTime / (elapsed > 0 ? elapsed : 1e-9));
+    if (naive != memoized) {
+        printf("mismatch, %.17g != %.17g\n", naive, memoized);
+        return 1;
+    }
+
+    SequenceEngine *logistic;
+    Parser *logisticParser = parse("{0.5} x_n -> 3.9 * x_{n - 1} * (1 - x_{n - 1})");
+    const Token *token = getTokens(logisticParser)[0];
+    logistic = initSequenceEngine((const SequenceToken *) (token->tokenType == EXPRESSION ?
+                                                           ((const ExpressionToken *) token)->root : token));
+    double sum = 0;
+    begin = benchSeconds();
+    for (i = 0; i < DOUBLE_TERMS; i++) {
+        sum += sequenceTermDouble(logistic, i);
+    }
+    elapsed = benchSeconds() - begin;
+    benchReport("term by term logistic map", elapsed, DOUBLE_TERMS, "term");
+    double termTime = elapsed, streamSum = 0, *chunk = (double *) malloc(sizeof(double) * STREAM_CHUNK);
+    SequenceStream stream;
+    initSequenceStream(&stream, logistic, 0);
+    begin = benchSeconds();
+    for (i = 0; i < DOUBLE_TERMS; i += STREAM_CHUNK) {
+        size_t j, count = streamSequenceDoubles(&stream, chunk, STREAM_CHUNK);
+        for (j = 0; j < count; j++) {
+            streamSum += chunk[j];
+        }
+    }
+    elapsed = benchSeconds() - begin;
+    benchReport("streamed logistic map", elapsed, DOUBLE_TERMS, "term");
+    printf("speedup %.1fx\n", termTime / elapsed);
+    if (streamSum != sum) {
+        printf("stream mismatch, %.17g != %.17g\n", streamSum, sum);
+        return 1;
+    }
+    free(chunk);
+    freeSequenceEngine(logistic);
+    freeParser(logisticParser);
+
+    begin = benchSeconds();
+    Number exact = sequenceTerm(engine, 100000);
+    elapsed = benchSeconds() - begin;
+    benchReport("matrix power exact x_100000", elapsed, 1, "term");
+    printf("%zu digits\n", numberStringSize(exact) - 1);
+    freeNumber(exact);
+
+    begin = benchSeconds();
+    bool defined = sequenceTermModulo(engine, 1000000000ull, MODULUS, &term);
+    elapsed = benchSeconds() - begin;
+    benchReport("matrix power x_1000000000 mod p", elapsed, 1, "term");
+    if (!defined || term != 21) {
+        printf("modular mismatch, %llu != 21\n", (unsigned long long) term);
+        return 1;
+    }
+    freeSequenceEngine(engine);
+    freeParser(parser);
+    return 0;
+}
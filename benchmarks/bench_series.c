@@ -0,0 +1,81 @@
+//
+// Taylor coefficients from lazy power series against repeated differentiation, and limits.
+//
+
+#include <math.h>
+#include "bench_common.h"
+#include "../internals/fluxion_diff.h"
+#include "../internals/fluxion_series.h"
+#include "../internals/fluxion_parser.h"
+
+#define DIFF_ORDER 8 // Coefficients of exp(sin(x)) / (1 + x) by differentiating.
+#define SERIES_ORDER 300 // And by series, the exact coefficients grow to thousands of bits.
+#define LIMIT_REPEATS 200
+
+static NodeId parseNode(NodePool *pool, const char *source) {
+    Parser *parser = parse(source);
+    NodeId node = nodeFromToken(pool, getTokens(parser)[0]);
+    freeParser(parser);
+    return node;
+}
+
+int main() {
+    NodePool *pool = initNodePool();
+    uint32_t x = internSymbol(pool, "x", 1);
+    NodeId function = parseNode(pool, "exp(sin(x)) / (1 + x)");
+    double values[BUILTIN_SYMBOL_COUNT + 1] = {0}, byDerivative[DIFF_ORDER + 1], factorial = 1;
+    bool agree = true;
+    int k;
+
+    double begin = benchSeconds();
+    uint32_t before = pool->count;
+    NodeId derivative = function;
+    for (k = 0; k <= DIFF_ORDER; k++) {
+        factorial *= k > 0 ? k : 1;
+        byDerivative[k] = evaluateNode(pool, derivative, values) / factorial;
+        derivative = differentiateNode(pool, derivative, x);
+    }
+    benchReport("differentiating to order 8", benchSeconds() - begin, DIFF_ORDER, "coefficient");
+    printf("%u nodes created\n", pool->count - before);
+
+    Number zero = numberFromSmall(0);
+    begin = benchSeconds();
+    SeriesEngine *engine = initSeriesEngine();
+    SeriesId series = seriesFromNode(engine, pool, function, x, zero);
+    Number coefficient;
+    for (k = 0; k <= DIFF_ORDER; k++) {
+        agree = agree && seriesCoefficient(engine, series, k, &coefficient);
+        agree = agree && fabs(numberToDouble(coefficient) - byDerivative[k]) <= 1e-9 * (1 + fabs(byDerivative[k]));
+        freeNumber(coefficient);
+    }
+    benchReport("series to order 8", benchSeconds() - begin, DIFF_ORDER, "coefficient");
+    agree = agree && seriesCoefficient(engine, series, SERIES_ORDER, &coefficient);
+    freeNumber(coefficient);
+    benchReport("series to order 300", benchSeconds() - begin, SERIES_ORDER, "coefficient");
+    freeSeriesEngine(engine);
+
+    NodeId limit = parseNode(pool, "lim((sin(x) - x * cos(x)) / x^3, x -> 0)"), value = NODE_NONE;
+    begin = benchSeconds();
+    for (k = 0; k < LIMIT_REPEATS; k++) {
+        value = expandLimits(pool, limit);
+    }
+    benchReport("lim((sin(x) - x cos(x)) / x^3)", benchSeconds() - begin, LIMIT_REPEATS, "limit");
+    Number third = numberDivide(numberFromSmall(1), numberFromSmall(3));
+    agree = agree && value != NODE_NONE && nodeTag(pool, value) == NODE_NUMBER &&
+            numberCompare(nodeNumberOf(pool, value), third) == 0;
+    freeNumber(third);
+    // Even roots are of |x|, these have no limit or series at 0.
+    agree = agree && limitNode(pool, parseNode(pool, "sqrt(x^2) / x"), x, zero) == NODE_NONE;
+    agree = agree && limitNode(pool, parseNode(pool, "(sqrt(x^2) - x) / x"), x, zero) == NODE_NONE;
+    agree = agree && seriesNode(pool, parseNode(pool, "sqrt(x^2)"), x, zero, 2) == NODE_NONE;
+    agree = agree && seriesNode(pool, parseNode(pool, "(sqrt(x^2) - x) / x"), x, zero, 2) == NODE_NONE;
+    agree = agree && seriesNode(pool, parseNode(pool, "(x^2)^(3/2)"), x, zero, 4) == NODE_NONE;
+    agree = agree && seriesNode(pool, parseNode(pool, "sqrt(x^4)"), x, zero, 4) == parseNode(pool, "x^2");
+    freeNodePool(pool);
+
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
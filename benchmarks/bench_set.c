@@ -0,0 +1,118 @@
+//
+// Set membership and algebra on canonical sets against scanning plain lists.
+//
+
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_set.h"
+
+#define MEMBERS 1000000
+#define NAIVE_QUERIES 100
+#define SPARSE_RANGE ((int64_t) 1 << 40)
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t nextRandom(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+/**
+ * Make a list of count integers, value i is start + i * step, shuffled,
+ * or a random integer below SPARSE_RANGE when step is 0.
+ */
+static FiniteToken *makeList(Arena *arena, int count, int64_t start, int64_t step) {
+    FiniteToken *list = initFiniteToken(arena, 0);
+    int i;
+    finiteReserve(list, count);
+    for (i = 0; i < count; i++) {
+        int64_t value = step ? start + i * step : start + (int64_t) (nextRandom() % SPARSE_RANGE);
+        finiteAddElement(list, (Token *) initNumberTokenNumber(arena, 0, numberFromSmall(value)));
+    }
+    for (i = count - 1; i > 0; i--) {
+        int j = (int) (nextRandom() % (uint64_t) (i + 1));
+        Token *swap = list->members[i];
+        list->members[i] = list->members[j];
+        list->members[j] = swap;
+    }
+    return list;
+}
+
+/**
+ * Time membership of every member of queries in set.
+ * @return the number of queries found.
+ */
+static int benchContains(const char *name, const FiniteToken *set, const FiniteToken *queries, int count, double *seconds) {
+    int i, found = 0;
+    double begin = benchSeconds();
+    for (i = 0; i < count; i++) {
+        found += finiteContains(set, queries->members[i]);
+    }
+    *seconds = benchSeconds() - begin;
+    benchReport(name, *seconds, count, "probe");
+    return found;
+}
+
+static FiniteToken *benchOperation(const char *name, FiniteToken *(*operation)(Arena *, const FiniteToken *, const FiniteToken *),
+                                   Arena *arena, const FiniteToken *a, const FiniteToken *b) {
+    double begin = benchSeconds();
+    FiniteToken *result = operation(arena, a, b);
+    double elapsed = benchSeconds() - begin;
+    benchReport(name, elapsed, a->current + b->current, "member");
+    return result;
+}
+
+int main() {
+    Arena *arena = initArena(0);
+    double naiveTime, elapsed;
+    bool agree = true;
+    FiniteToken *all = makeList(arena, MEMBERS, 0, 1);
+    FiniteToken *even = makeList(arena, MEMBERS, 0, 2);
+    FiniteToken *sparse = makeList(arena, MEMBERS, 0, 0);
+    FiniteToken *sparseOther = makeList(arena, MEMBERS, SPARSE_RANGE / 2, 0);
+    FiniteToken *queries = makeList(arena, MEMBERS, MEMBERS / 2, 1);
+
+    int naiveFound = benchContains("scan list of 10^6 integers", all, queries, NAIVE_QUERIES, &naiveTime);
+    naiveTime /= NAIVE_QUERIES;
+    double begin = benchSeconds();
+    canonicaliseFiniteToken(all);
+    canonicaliseFiniteToken(even);
+    elapsed = benchSeconds() - begin;
+    benchReport("canonicalise dense sets", elapsed, 2.0 * MEMBERS, "member");
+    begin = benchSeconds();
+    canonicaliseFiniteToken(sparse);
+    canonicaliseFiniteToken(sparseOther);
+    elapsed = benchSeconds() - begin;
+    benchReport("canonicalise sparse sets", elapsed, 2.0 * MEMBERS, "member");
+    printf("dense sets are %s, sparse sets are %s\n", all->index->dense ? "bitsets" : "tables",
+           sparse->index->dense ? "bitsets" : "tables");
+
+    int found = benchContains("bitset of 10^6 integers", all, queries, NAIVE_QUERIES, &elapsed);
+    agree = agree && found == naiveFound;
+    found = benchContains("bitset of 10^6 integers, 10^6 probes", all, queries, MEMBERS, &elapsed);
+    printf("speedup %.0fx\n", naiveTime / (elapsed / MEMBERS));
+    agree = agree && found == MEMBERS / 2;
+    found = benchContains("table of 10^6 integers, 10^6 probes", sparse, sparse, MEMBERS, &elapsed);
+    printf("speedup %.0fx\n", naiveTime / (elapsed / MEMBERS));
+    agree = agree && found == sparse->current;
+
+    FiniteToken *result = benchOperation("bitset union", finiteUnion, arena, all, even);
+    agree = agree && result->current == MEMBERS + MEMBERS / 2;
+    result = benchOperation("bitset intersection", finiteIntersection, arena, all, even);
+    agree = agree && result->current == MEMBERS / 2;
+    result = benchOperation("bitset difference", finiteDifference, arena, all, even);
+    agree = agree && result->current == MEMBERS / 2;
+    FiniteToken *sparseUnion = benchOperation("table union", finiteUnion, arena, sparse, sparseOther);
+    result = benchOperation("table intersection", finiteIntersection, arena, sparse, sparseOther);
+    FiniteToken *difference = benchOperation("table difference", finiteDifference, arena, sparse, sparseOther);
+    agree = agree && sparseUnion->current == sparse->current + sparseOther->current - result->current &&
+            difference->current == sparse->current - result->current;
+    freeArena(arena);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
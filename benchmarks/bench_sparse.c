@@ -0,0 +1,157 @@
+//
+// Compressed sparse kernels against the dense ones on mostly zero matrices.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../internals/fluxion_sparse.h"
+
+#define GRID 400 // The Laplacian of a GRID by GRID grid, GRID^2 rows.
+#define DENSE_SIZE 1500
+#define DENSE_DENSITY 0.005
+#define REPEATS 20
+#define READS 100000
+
+typedef struct {
+    size_t *rows;
+    size_t *columns;
+    double *values;
+    size_t count;
+} Triplets;
+
+static void addTriplet(Triplets *triplets, size_t row, size_t column, double value) {
+    triplets->rows[triplets->count] = row;
+    triplets->columns[triplets->count] = column;
+    triplets->values[triplets->count++] = value;
+}
+
+/**
+ * The five point finite difference Laplacian, five non-zeros a row.
+ */
+static SparseMatrix *laplacian(size_t grid) {
+    size_t n = grid * grid, i, j;
+    Triplets triplets = {(size_t *) malloc(sizeof(size_t) * 5 * n), (size_t *) malloc(sizeof(size_t) * 5 * n),
+                         (double *) malloc(sizeof(double) * 5 * n), 0};
+    for (i = 0; i < grid; i++) {
+        for (j = 0; j < grid; j++) {
+            size_t cell = i * grid + j;
+            addTriplet(&triplets, cell, cell, 4);
+            if (i > 0) {
+                addTriplet(&triplets, cell, cell - grid, -1);
+            }
+            if (i + 1 < grid) {
+                addTriplet(&triplets, cell, cell + grid, -1);
+            }
+            if (j > 0) {
+                addTriplet(&triplets, cell, cell - 1, -1);
+            }
+            if (j + 1 < grid) {
+                addTriplet(&triplets, cell, cell + 1, -1);
+            }
+        }
+    }
+    SparseMatrix *matrix = sparseMatrixFromTriplets(SPARSE_ROWS, n, n, triplets.rows, triplets.columns,
+                                                    triplets.values, triplets.count);
+    free(triplets.values);
+    free(triplets.columns);
+    free(triplets.rows);
+    return matrix;
+}
+
+static DenseMatrix *randomDense(size_t rows, size_t columns, double density) {
+    DenseMatrix *matrix = initDenseMatrix(rows, columns);
+    size_t i, j;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < columns; j++) {
+            denseMatrixSet(matrix, i, j, rand() / (double) RAND_MAX < density ? rand() / (double) RAND_MAX : 0);
+        }
+    }
+    return matrix;
+}
+
+int main() {
+    SparseMatrix *grid = laplacian(GRID);
+    size_t n = grid->rows, i, j, repeat;
+    printf("laplacian %zu x %zu, %zu non-zeros, %.1f MB compressed, %.0f MB dense\n", n, n, grid->count,
+           (grid->count * (sizeof(double) + sizeof(uint32_t)) + (n + 1) * sizeof(size_t)) / 1e6,
+           (double) n * n * sizeof(double) / 1e6);
+    double *x = (double *) malloc(sizeof(double) * n), *y = (double *) malloc(sizeof(double) * n);
+    for (i = 0; i < n; i++) {
+        x[i] = 1;
+    }
+    double begin = benchSeconds();
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        sparseMatrixVector(grid, x, y);
+    }
+    benchReport("csr matrix vector 160000", benchSeconds() - begin, (double) REPEATS * grid->count, "entry");
+    SparseMatrix *columns = sparseMatrixConvert(grid, SPARSE_COLUMNS);
+    begin = benchSeconds();
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        sparseMatrixVector(columns, x, y);
+    }
+    benchReport("csc matrix vector 160000", benchSeconds() - begin, (double) REPEATS * grid->count, "entry");
+    begin = benchSeconds();
+    SparseMatrix *square = sparseMatrixMultiply(grid, grid);
+    benchReport("sparse square 160000", benchSeconds() - begin, (double) grid->count * 5, "multiply-add");
+    begin = benchSeconds();
+    SparseMatrix *transpose = sparseMatrixTranspose(grid);
+    benchReport("transpose 160000", benchSeconds() - begin, (double) grid->count, "entry");
+    bool agree = sparseMatrixEqual(transpose, grid); // Symmetric.
+    double *twice = (double *) malloc(sizeof(double) * n);
+    for (i = 0; i < n; i++) {
+        x[i] = rand() % 7;
+    }
+    sparseMatrixVector(grid, x, y);
+    sparseMatrixVector(grid, y, twice);
+    sparseMatrixVector(square, x, y);
+    for (i = 0; i < n; i++) {
+        agree = agree && y[i] == twice[i];
+    }
+    free(twice);
+
+    MatrixToken *token = initSparseMatrixToken(NULL, 0, copySparseMatrix(grid)); // 2.56e10 members expanded.
+    begin = benchSeconds();
+    for (repeat = 0; repeat < READS; repeat++) {
+        size_t row = (size_t) rand() % n, column = (row + (size_t) rand() % 3 + n - 1) % n;
+        const NumberToken *member = (const NumberToken *) matrixGetMember(token, (int) row, (int) column);
+        agree = agree && member->value == sparseMatrixGet(grid, row, column);
+    }
+    benchReport("read matrix token members", benchSeconds() - begin, READS, "member");
+    agree = agree && token->sparse != NULL;
+    freeMatrixToken(token);
+
+    DenseMatrix *a = randomDense(DENSE_SIZE, DENSE_SIZE, DENSE_DENSITY), *b = randomDense(DENSE_SIZE, DENSE_SIZE, 1);
+    SparseMatrix *sparse = sparseMatrixFromDense(a, SPARSE_ROWS);
+    begin = benchWallSeconds();
+    DenseMatrix *expected = denseMatrixMultiply(a, b, 1);
+    double denseTime = benchWallSeconds() - begin;
+    benchReport("dense product 1500, 0.5% full", denseTime, 2.0 * DENSE_SIZE * DENSE_SIZE * DENSE_SIZE, "flop");
+    begin = benchWallSeconds();
+    DenseMatrix *product = sparseMatrixMultiplyDense(sparse, b);
+    double sparseTime = benchWallSeconds() - begin;
+    benchReport("sparse dense product 1500", sparseTime, 2.0 * sparse->count * DENSE_SIZE, "flop");
+    printf("speedup %.1fx\n", denseTime / sparseTime);
+    for (i = 0; i < DENSE_SIZE; i++) {
+        for (j = 0; j < DENSE_SIZE; j++) {
+            agree = agree && fabs(denseMatrixGet(product, i, j) - denseMatrixGet(expected, i, j)) < 1e-9;
+        }
+    }
+
+    freeDenseMatrix(product);
+    freeDenseMatrix(expected);
+    freeSparseMatrix(sparse);
+    freeDenseMatrix(b);
+    freeDenseMatrix(a);
+    freeSparseMatrix(transpose);
+    freeSparseMatrix(square);
+    freeSparseMatrix(columns);
+    free(y);
+    free(x);
+    freeSparseMatrix(grid);
+    if (!agree) {
+        printf("mismatch\n");
+        return 1;
+    }
+    return 0;
+}
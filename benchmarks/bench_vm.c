@@ -0,0 +1,159 @@
+//
+// Compiled bytecode against a naive recursive walk of the token tree.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../internals/fluxion_parser.h"
+#include "../internals/fluxion_vm.h"
+
+#define POLYNOMIAL_POINTS 2000000
+#define RECURRENCE_STEPS 2000000
+#define REPEATS 5
+
+/**
+ * The evaluation a compiler replaces, names are looked up on every visit.
+ */
+static double walk(const Token *token, const char *const *names, const double *values, int count) {
+    int i;
+    switch (token->tokenType) {
+        case NUMBER:
+            return ((const NumberToken *) token)->value;
+        case EXPRESSION:
+            return walk(((const ExpressionToken *) token)->root, names, values, count);
+        case IDENTIFIER:
+            for (i = 0; i < count; i++) {
+                if (strcmp(names[i], ((const IdentifierToken *) token)->name) == 0) {
+                    return values[i];
+                }
+            }
+            return NAN;
+        case OPERATOR: {
+            const OperatorToken *operator = (const OperatorToken *) token;
+            if (operator->left == NULL) {
+                double operand = walk(operator->right, names, values, count);
+                return operator->operatorType == MINUS ? -operand : NAN;
+            }
+            double a = walk(operator->left, names, values, count);
+            double b = walk(operator->right, names, values, count);
+            switch (operator->operatorType) {
+                case PLUS:
+                    return a + b;
+                case MINUS:
+                    return a - b;
+                case MULTIPLY:
+                    return a * b;
+                case DIVIDE:
+                    return a / b;
+                case POWER:
+                    return pow(a, b);
+                default:
+                    return NAN;
+            }
+        }
+        default:
+            return NAN;
+    }
+}
+
+static const Token *parseOne(Parser **parser, const char *source) {
+    *parser = parse(source);
+    return getTokens(*parser)[0];
+}
+
+int main() {
+    int i, repeat;
+    double best, walkSum = 0, vmSum = 0;
+    Parser *parser;
+
+    // A polynomial over many points.
+    const char *xNames[] = {"x"};
+    const Token *polynomial = parseOne(&parser, "3*x^4 - 2*x^3 + x^2 - 5*x + 7");
+    Program *program = compileExpression(polynomial, xNames, 1);
+    double *registers = (double *) malloc(sizeof(double) * program->registerCount);
+    loadProgramConstants(program, registers);
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        walkSum = 0;
+        for (i = 0; i < POLYNOMIAL_POINTS; i++) {
+            double x = i * 1e-6;
+            walkSum += walk(polynomial, xNames, &x, 1);
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("tree walk polynomial", best, POLYNOMIAL_POINTS, "eval");
+    double walkTime = best;
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        vmSum = 0;
+        for (i = 0; i < POLYNOMIAL_POINTS; i++) {
+            registers[program->constantCount] = i * 1e-6;
+            vmSum += runProgramRegisters(program, registers);
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("bytecode polynomial", best, POLYNOMIAL_POINTS, "eval");
+    printf("speedup %.1fx\n", walkTime / best);
+    if (fabs(walkSum - vmSum) > 1e-12 * fabs(walkSum)) {
+        printf("polynomial mismatch, %.17g != %.17g\n", walkSum, vmSum);
+        return 1;
+    }
+    free(registers);
+    freeProgram(program);
+    freeParser(parser);
+
+    // The Henon map as a second order recurrence, each step feeds the last two values back in.
+    const char *recurrenceNames[] = {"a", "b", "x", "y"};
+    const Token *henon = parseOne(&parser, "1 - a * x * x + b * y");
+    program = compileExpression(henon, recurrenceNames, 4);
+    double walkState[4];
+    registers = (double *) malloc(sizeof(double) * program->registerCount);
+    double *vmState = registers + program->constantCount;
+    loadProgramConstants(program, registers);
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        walkState[0] = 1.4;
+        walkState[1] = 0.3;
+        walkState[2] = walkState[3] = 0;
+        for (i = 0; i < RECURRENCE_STEPS; i++) {
+            double next = walk(henon, recurrenceNames, walkState, 4);
+            walkState[3] = walkState[2];
+            walkState[2] = next;
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("tree walk recurrence", best, RECURRENCE_STEPS, "step");
+    walkTime = best;
+    best = 1e30;
+    for (repeat = 0; repeat < REPEATS; repeat++) {
+        double begin = benchSeconds();
+        vmState[0] = 1.4;
+        vmState[1] = 0.3;
+        vmState[2] = vmState[3] = 0;
+        for (i = 0; i < RECURRENCE_STEPS; i++) {
+            double next = runProgramRegisters(program, registers);
+            vmState[3] = vmState[2];
+            vmState[2] = next;
+        }
+        double elapsed = benchSeconds() - begin;
+        best = elapsed < best ? elapsed : best;
+    }
+    benchReport("bytecode recurrence", best, RECURRENCE_STEPS, "step");
+    printf("speedup %.1fx\n", walkTime / best);
+    if (walkState[2] != vmState[2]) {
+        printf("recurrence mismatch, %.17g != %.17g\n", walkState[2], vmState[2]);
+        return 1;
+    }
+    free(registers);
+    freeProgram(program);
+    freeParser(parser);
+    return 0;
+}
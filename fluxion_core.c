@@ -1,2 +1,40 @@
 #include "fluxion_core.h"
+#include "internals/fluxion_parser.h"
+#include "internals/fluxion_vm.h"
+#include "internals/fluxion_batch.h"
 
+struct CompiledExpression {
+    Program *program;
+};
+
+CompiledExpression *compileSource(const char *source, const char *const *variables, int variableCount) {
+    Parser *parser = parse(source);
+    Program *program = NULL;
+    if (getTokenCount(parser) > 0) {
+        program = compileExpression(getTokens(parser)[0], variables, variableCount);
+    }
+    freeParser(parser);
+    if (program == NULL) {
+        return NULL;
+    }
+    CompiledExpression *expression = (CompiledExpression *) malloc(sizeof(CompiledExpression));
+    expression->program = program;
+    return expression;
+}
+
+void freeCompiledExpression(CompiledExpression *expression) {
+    if (expression == NULL) {
+        return;
+    }
+    freeProgram(expression->program);
+    free(expression);
+}
+
+double evaluateCompiled(const CompiledExpression *expression, const double *arguments) {
+    return runProgram(expression->program, arguments);
+}
+
+void evaluateBatch(const CompiledExpression *expression, const double *const *columns, size_t count,
+                   double *output, int threadCount) {
+    runProgramBatch(expression->program, columns, count, output, threadCount);
+}
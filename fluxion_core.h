@@ -0,0 +1,42 @@
+//
+// Public interface of FluxionCore.
+//
+
+#ifndef FLUXIONCORE_FLUXION_CORE_H
+#define FLUXIONCORE_FLUXION_CORE_H
+#include <stddef.h>
+
+/**
+ * An expression compiled for numeric evaluation.
+ */
+typedef struct CompiledExpression CompiledExpression;
+
+/**
+ * Parse and compile the first expression of a source.
+ * @param source Source holding the expression.
+ * @param variables Names of the variables, in argument order.
+ * @param variableCount Number of variables.
+ * @return the compiled expression, NULL after issuing an error if it can not be evaluated numerically.
+ */
+CompiledExpression *compileSource(const char *source, const char *const *variables, int variableCount);
+void freeCompiledExpression(CompiledExpression *expression);
+/**
+ * Evaluate a compiled expression at a point.
+ * @param expression Expression to evaluate.
+ * @param arguments Values of the variables, in the order they were compiled with.
+ * @return the value, NaN where it is not defined.
+ */
+double evaluateCompiled(const CompiledExpression *expression, const double *arguments);
+/**
+ * Evaluate a compiled expression at many points, a chunk of points at a
+ * time with vector kernels and optionally on several threads.
+ * @param expression Expression to evaluate.
+ * @param columns columns[i] holds the count values of variable i.
+ * @param count Number of points.
+ * @param output Receives the count values.
+ * @param threadCount Most threads to use, 0 for one per processor.
+ */
+void evaluateBatch(const CompiledExpression *expression, const double *const *columns, size_t count,
+                   double *output, int threadCount);
+
+#endif //FLUXIONCORE_FLUXION_CORE_H
@@ -18,4 +18,12 @@ const char *getLiteralName (ErrorLiteral literal) {
 
 void issueError(Error *error) {
     fprintf(stderr, "%s: %s", getLiteralName(error->errorLiteral), error->errorMessage);
-}
\ No newline at end of file
+}
+
+const char *getOperatorSymbol(OperatorType operatorType) {
+    static const char *symbols[] = {
+            "::", ":=", "<", ">", "<=", ">=", "=", "\\=", "&", "|", "\\",
+            "'", "->", "in", "_", "+", "-", "*", "/", "^", "!"
+    };
+    return symbols[operatorType];
+}
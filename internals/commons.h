@@ -7,6 +7,15 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+
+#if defined(_MSC_VER)
+#define FLUXION_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define FLUXION_THREAD_LOCAL __thread
+#else
+#define FLUXION_THREAD_LOCAL
+#endif
+
 typedef enum {
     Function,
     Variable
@@ -54,4 +63,16 @@ typedef struct {
 } Error;
 
 void issueError(Error *error);
+/**
+ * Get the name of an error literal.
+ * @param literal Literal to get.
+ * @return the literal as it is written in Fluxion.
+ */
+const char *getLiteralName(ErrorLiteral literal);
+/**
+ * Get the source representation of an operator.
+ * @param operatorType Operator to get.
+ * @return the operator as it is written in Fluxion.
+ */
+const char *getOperatorSymbol(OperatorType operatorType);
 #endif //FLUXIONCORE_COMMONS_H
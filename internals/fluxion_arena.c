@@ -0,0 +1,123 @@
+//
+// Bump allocator used for all parse time allocations.
+//
+
+#include <string.h>
+#include "fluxion_arena.h"
+
+static size_t alignSize(size_t size) {
+    return (size + (ARENA_ALIGNMENT - 1)) & ~((size_t) ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock *initArenaBlock(size_t size) {
+    // Header and data share one allocation, data starts on an aligned offset.
+    size_t headerSize = alignSize(sizeof(ArenaBlock));
+    ArenaBlock *block = (ArenaBlock *) malloc(headerSize + size);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    block->data = (unsigned char *) block + headerSize;
+    return block;
+}
+
+Arena *initArena(size_t blockSize) {
+    Arena *arena = (Arena *) malloc(sizeof(Arena));
+    arena->blockSize = blockSize ? alignSize(blockSize) : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->head = initArenaBlock(arena->blockSize);
+    arena->cleanups = NULL;
+    arena->last = NULL;
+    return arena;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+    size = alignSize(size ? size : 1);
+    ArenaBlock *block = arena->head;
+    if (block->used + size > block->size) {
+        if (size > arena->blockSize / 4) {
+            // Large allocations get a block of their own, linked behind the head
+            // so the free space in the current block is not wasted.
+            ArenaBlock *large = initArenaBlock(size);
+            large->used = size;
+            large->next = block->next;
+            block->next = large;
+            return large->data;
+        }
+        block = initArenaBlock(arena->blockSize);
+        block->next = arena->head;
+        arena->head = block;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+void *arenaRealloc(Arena *arena, void *ptr, size_t oldSize, size_t newSize) {
+    if (ptr == NULL) {
+        return arenaAlloc(arena, newSize);
+    }
+    if (newSize <= oldSize) {
+        return ptr;
+    }
+    ArenaBlock *block = arena->head;
+    if (ptr == arena->last) { // Try to grow in place.
+        size_t offset = (unsigned char *) ptr - block->data;
+        size_t required = offset + alignSize(newSize);
+        if (required <= block->size) {
+            block->used = required;
+            return ptr;
+        }
+    }
+    void *newPtr = arenaAlloc(arena, newSize);
+    memcpy(newPtr, ptr, oldSize);
+    return newPtr;
+}
+
+char *arenaStrndup(Arena *arena, const char *str, size_t length) {
+    char *copy = (char *) arenaAlloc(arena, length + 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arenaAddCleanup(Arena *arena, void (*function)(void *), void *data) {
+    ArenaCleanup *cleanup = (ArenaCleanup *) arenaAlloc(arena, sizeof(ArenaCleanup));
+    cleanup->function = function;
+    cleanup->data = data;
+    cleanup->next = arena->cleanups;
+    arena->cleanups = cleanup;
+}
+
+static void runArenaCleanups(Arena *arena) {
+    ArenaCleanup *cleanup = arena->cleanups;
+    while (cleanup != NULL) {
+        cleanup->function(cleanup->data);
+        cleanup = cleanup->next;
+    }
+    arena->cleanups = NULL;
+}
+
+void resetArena(Arena *arena) {
+    runArenaCleanups(arena);
+    // Keep the head, which is always a regular sized one since large blocks are linked behind it.
+    ArenaBlock *block = arena->head->next;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->last = NULL;
+}
+
+void freeArena(Arena *arena) {
+    runArenaCleanups(arena);
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
@@ -0,0 +1,93 @@
+//
+// Bump allocator used for all parse time allocations.
+//
+
+#ifndef FLUXIONCORE_FLUXION_ARENA_H
+#define FLUXIONCORE_FLUXION_ARENA_H
+#include <stddef.h>
+#include "commons.h"
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+/**
+ * A single contiguous block of arena memory,
+ * blocks are chained from the newest to oldest.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size; // Usable bytes in data.
+    size_t used; // Bytes handed out so far.
+    unsigned char *data;
+} ArenaBlock;
+
+/**
+ * A cleanup registered to run when the arena is freed,
+ * for resources the arena memory points to but does not own.
+ */
+typedef struct ArenaCleanup {
+    struct ArenaCleanup *next;
+    void (*function)(void *);
+    void *data;
+} ArenaCleanup;
+
+/**
+ * A bump allocator, allocations are never freed individually
+ * the whole arena is released at once.
+ */
+typedef struct {
+    ArenaBlock *head;
+    ArenaCleanup *cleanups;
+    size_t blockSize;
+    void *last; // Last allocation, can be grown in place.
+} Arena;
+
+/**
+ * Initialise an arena.
+ * @param blockSize Size of each block, 0 for the default.
+ * @return the newly created arena.
+ */
+Arena *initArena(size_t blockSize);
+/**
+ * Allocate memory from the arena, memory is aligned to ARENA_ALIGNMENT.
+ * @param arena Arena to allocate from.
+ * @param size Size in bytes.
+ * @return pointer to the memory.
+ */
+void *arenaAlloc(Arena *arena, size_t size);
+/**
+ * Grow a previous allocation, in place if it was the last one.
+ * @param arena Arena the allocation came from.
+ * @param ptr Previous allocation, may be NULL.
+ * @param oldSize Size of the previous allocation.
+ * @param newSize Requested size.
+ * @return pointer to the (possibly moved) memory.
+ */
+void *arenaRealloc(Arena *arena, void *ptr, size_t oldSize, size_t newSize);
+/**
+ * Copy length bytes of str into the arena, null terminated.
+ * @param arena Arena to copy into.
+ * @param str String to copy.
+ * @param length Number of characters to copy.
+ * @return the copied string.
+ */
+char *arenaStrndup(Arena *arena, const char *str, size_t length);
+/**
+ * Register a cleanup to run when the arena is reset or freed.
+ * @param arena Arena to register to.
+ * @param function Function to call.
+ * @param data Argument of the function.
+ */
+void arenaAddCleanup(Arena *arena, void (*function)(void *), void *data);
+/**
+ * Release every allocation but keep the newest regular sized block for reuse.
+ * @param arena Arena to reset.
+ */
+void resetArena(Arena *arena);
+/**
+ * Free the arena and everything allocated from it.
+ * @param arena Arena to free.
+ */
+void freeArena(Arena *arena);
+
+#endif //FLUXIONCORE_FLUXION_ARENA_H
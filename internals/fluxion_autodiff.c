@@ -0,0 +1,723 @@
+//
+// Forward mode automatic differentiation of compiled expressions.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fluxion_autodiff.h"
+#include "fluxion_batch.h"
+
+#define LOCAL_REGISTERS 64
+#define LOCAL_COEFFICIENTS 512
+#define SCRATCH_SERIES 3 // Series past the registers that kernels write to before their result is copied.
+
+/*
+ * A truncated series of length points is order + 1 rows of coefficients,
+ * row k holding the coefficient of h^k of every point, stride apart.
+ * Kernels that read their operands after writing part of the result never
+ * get a target that is also an operand.
+ */
+#define ROW(series, k) ((series) + (size_t) (k) * stride)
+
+Program *compileDerivative(const Token *root, const char *const *variables, int variableCount, int *order) {
+    *order = 0;
+    while (root != NULL) {
+        if (root->tokenType == EXPRESSION) {
+            root = ((const ExpressionToken *) root)->root;
+        } else if (root->tokenType == OPERATOR && ((const OperatorToken *) root)->operatorType == DIFF) {
+            const OperatorToken *operator = (const OperatorToken *) root;
+            root = operator->left ? operator->left : operator->right;
+            ++*order;
+        } else {
+            break;
+        }
+    }
+    return compileExpression(root, variables, variableCount);
+}
+
+/**
+ * Value of an operation with no derivative, as runProgramRegisters computes it.
+ */
+static double flatValue(Opcode opcode, double a, double b) {
+    switch (opcode) {
+        case OP_NOT:
+            return !a;
+        case OP_FACTORIAL:
+            return tgamma(a + 1);
+        case OP_LESS:
+            return a < b;
+        case OP_GREATER:
+            return a > b;
+        case OP_LEQ:
+            return a <= b;
+        case OP_GEQ:
+            return a >= b;
+        case OP_EQUAL:
+            return a == b;
+        case OP_NEQ:
+            return a != b;
+        case OP_AND:
+            return a && b;
+        case OP_OR:
+            return a || b;
+        default:
+            return NAN;
+    }
+}
+
+/**
+ * Derivative of a function call, given the value v = f(a) and the derivative of a.
+ */
+static double dualCall(BuiltinFunction function, double a, double v, double derivative) {
+    switch (function) {
+        case BUILTIN_SIN:
+            return cos(a) * derivative;
+        case BUILTIN_COS:
+            return -sin(a) * derivative;
+        case BUILTIN_TAN:
+            return (1 + v * v) * derivative;
+        case BUILTIN_EXP:
+            return v * derivative;
+        case BUILTIN_LOG:
+            return derivative / a;
+        case BUILTIN_SQRT:
+            return derivative / (2 * v);
+        case BUILTIN_ABS: // No derivative where a vanishes, unless a does not depend on the variable.
+            return derivative == 0 ? 0 : a > 0 ? derivative : a < 0 ? -derivative : NAN;
+        default:
+            return NAN;
+    }
+}
+
+double evaluateDerivative(const ProgramDerivative *derivative, const double *arguments) {
+    double derivatives[AUTODIFF_MAX_ORDER + 1];
+    runProgramDerivatives(derivative->program, arguments, 0, derivative->order, derivatives);
+    return derivatives[derivative->order];
+}
+
+/**
+ * Whether a variable other than the first varies, the derivative of an
+ * OP_DERIVATIVE would then need mixed partial derivatives.
+ * @param seeds Rows of the variables past the value, rowCount of them per variable, stride apart.
+ */
+static bool othersVary(const Program *program, const double *seeds, size_t block, int rowCount, size_t stride,
+                       size_t point) {
+    int i, k;
+    for (i = 1; i < program->variableCount; i++) {
+        for (k = 0; k < rowCount; k++) {
+            if (seeds[block * i + stride * k + point] != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Value and tangent of an OP_DERIVATIVE, the derivative of order m has the
+ * one of order m + 1 times the tangent of the first variable as its own.
+ */
+static double dualDerivative(const Program *program, const ProgramDerivative *derivative, const double *values,
+                             const double *tangents, double *tangent) {
+    const double *arguments = values + program->constantCount, *seeds = tangents + program->constantCount;
+    double derivatives[AUTODIFF_MAX_ORDER + 2];
+    int order = derivative->order;
+    bool mixed = othersVary(program, seeds, 1, 1, 0, 0);
+    if (program->variableCount == 0 || (seeds[0] == 0 && !mixed)) {
+        *tangent = 0;
+        return evaluateDerivative(derivative, arguments);
+    }
+    if (mixed || order + 1 > AUTODIFF_MAX_ORDER) {
+        *tangent = NAN;
+        return evaluateDerivative(derivative, arguments);
+    }
+    runProgramDerivatives(derivative->program, arguments, 0, order + 1, derivatives);
+    *tangent = derivatives[order + 1] * seeds[0];
+    return derivatives[order];
+}
+
+static double runDual(const Program *program, double *values, double *tangents, double *derivative) {
+    const Instruction *ip;
+    for (ip = program->code; ip->opcode != OP_RETURN; ip++) {
+        bool registerA = opcodeUsesRegisterA(ip->opcode);
+        double a = registerA ? values[ip->a] : 0, da = registerA ? tangents[ip->a] : 0, v, d;
+        double b = opcodeUsesRegisterB(ip->opcode) ? values[ip->b] : 0;
+        double db = opcodeUsesRegisterB(ip->opcode) ? tangents[ip->b] : 0;
+        switch ((Opcode) ip->opcode) {
+            case OP_ADD:
+                v = a + b;
+                d = da + db;
+                break;
+            case OP_SUBTRACT:
+                v = a - b;
+                d = da - db;
+                break;
+            case OP_MULTIPLY:
+                v = a * b;
+                d = da * b + a * db;
+                break;
+            case OP_DIVIDE:
+                v = a / b;
+                d = (da - v * db) / b;
+                break;
+            case OP_POWER: // With a constant exponent, a may vanish or be negative.
+                v = pow(a, b);
+                d = db == 0 ? (da == 0 ? 0 : b * pow(a, b - 1) * da) : v * (db * log(a) + b * da / a);
+                break;
+            case OP_NEGATE:
+                v = -a;
+                d = -da;
+                break;
+            case OP_CALL:
+                v = callBuiltin((BuiltinFunction) ip->b, a);
+                d = dualCall((BuiltinFunction) ip->b, a, v, da);
+                break;
+            case OP_DERIVATIVE:
+                v = dualDerivative(program, program->derivatives + ip->a, values, tangents, &d);
+                break;
+            default:
+                v = flatValue((Opcode) ip->opcode, a, b);
+                d = da == 0 && db == 0 ? 0 : NAN;
+                break;
+        }
+        values[ip->target] = v;
+        tangents[ip->target] = d;
+    }
+    *derivative = tangents[ip->a];
+    return values[ip->a];
+}
+
+double runProgramDual(const Program *program, const double *arguments, int variable, double *derivative) {
+    double local[2 * LOCAL_REGISTERS];
+    size_t registerCount = program->registerCount;
+    double *values = registerCount <= LOCAL_REGISTERS ? local : (double *) malloc(sizeof(double) * 2 * registerCount);
+    double *tangents = values + registerCount;
+    loadProgramConstants(program, values);
+    memset(tangents, 0, sizeof(double) * registerCount);
+    if (program->variableCount > 0) {
+        memcpy(values + program->constantCount, arguments, sizeof(double) * program->variableCount);
+    }
+    if (variable >= 0 && variable < program->variableCount) {
+        tangents[program->constantCount + variable] = 1;
+    }
+    double value = runDual(program, values, tangents, derivative);
+    if (values != local) {
+        free(values);
+    }
+    return value;
+}
+
+/*
+ * Kernels over truncated series, from the recurrences obtained by
+ * differentiating the defining identity of each function, as in
+ * e' = a' e for e = exp(a). Each costs O(order^2) per point.
+ */
+
+static void taylorMultiply(double *t, const double *a, const double *b, int order, size_t stride, size_t length) {
+    int k, i;
+    size_t j;
+    for (k = 0; k <= order; k++) {
+        double *row = ROW(t, k);
+        memset(row, 0, sizeof(double) * length);
+        for (i = 0; i <= k; i++) {
+            const double *x = ROW(a, i), *y = ROW(b, k - i);
+            for (j = 0; j < length; j++) {
+                row[j] += x[j] * y[j];
+            }
+        }
+    }
+}
+
+static void taylorDivide(double *t, const double *a, const double *b, int order, size_t stride, size_t length) {
+    int k, i;
+    size_t j;
+    for (k = 0; k <= order; k++) {
+        double *row = ROW(t, k);
+        memcpy(row, ROW(a, k), sizeof(double) * length);
+        for (i = 1; i <= k; i++) {
+            const double *x = ROW(b, i), *y = ROW(t, k - i);
+            for (j = 0; j < length; j++) {
+                row[j] -= x[j] * y[j];
+            }
+        }
+        for (j = 0; j < length; j++) {
+            row[j] /= b[j];
+        }
+    }
+}
+
+static void taylorExp(double *t, const double *a, int order, size_t stride, size_t length) {
+    int k, i;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        t[j] = exp(a[j]);
+    }
+    for (k = 1; k <= order; k++) {
+        double *row = ROW(t, k);
+        memset(row, 0, sizeof(double) * length);
+        for (i = 1; i <= k; i++) {
+            const double *x = ROW(a, i), *y = ROW(t, k - i);
+            double scale = (double) i / k;
+            for (j = 0; j < length; j++) {
+                row[j] += scale * x[j] * y[j];
+            }
+        }
+    }
+}
+
+static void taylorLog(double *t, const double *a, int order, size_t stride, size_t length) {
+    int k, i;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        t[j] = log(a[j]);
+    }
+    for (k = 1; k <= order; k++) {
+        double *row = ROW(t, k);
+        memcpy(row, ROW(a, k), sizeof(double) * length);
+        for (i = 1; i < k; i++) {
+            const double *x = ROW(t, i), *y = ROW(a, k - i);
+            double scale = (double) i / k;
+            for (j = 0; j < length; j++) {
+                row[j] -= scale * x[j] * y[j];
+            }
+        }
+        for (j = 0; j < length; j++) {
+            row[j] /= a[j];
+        }
+    }
+}
+
+static void taylorSinCos(double *sine, double *cosine, const double *a, int order, size_t stride, size_t length) {
+    int k, i;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        sine[j] = sin(a[j]);
+        cosine[j] = cos(a[j]);
+    }
+    for (k = 1; k <= order; k++) {
+        double *s = ROW(sine, k), *c = ROW(cosine, k);
+        memset(s, 0, sizeof(double) * length);
+        memset(c, 0, sizeof(double) * length);
+        for (i = 1; i <= k; i++) {
+            const double *x = ROW(a, i), *y = ROW(cosine, k - i), *z = ROW(sine, k - i);
+            double scale = (double) i / k;
+            for (j = 0; j < length; j++) {
+                s[j] += scale * x[j] * y[j];
+                c[j] -= scale * x[j] * z[j];
+            }
+        }
+    }
+}
+
+static void taylorSqrt(double *t, const double *a, int order, size_t stride, size_t length) {
+    int k, i;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        t[j] = sqrt(a[j]);
+    }
+    for (k = 1; k <= order; k++) {
+        double *row = ROW(t, k);
+        memcpy(row, ROW(a, k), sizeof(double) * length);
+        for (i = 1; i < k; i++) {
+            const double *x = ROW(t, i), *y = ROW(t, k - i);
+            for (j = 0; j < length; j++) {
+                row[j] -= x[j] * y[j];
+            }
+        }
+        for (j = 0; j < length; j++) {
+            row[j] /= 2 * t[j];
+        }
+    }
+}
+
+/**
+ * a^p for an exponent p given by the first row of b, the others being zero,
+ * from a y' = p a' y. The base may not vanish.
+ */
+static void taylorPowerConstant(double *t, const double *a, const double *b, int order, size_t stride,
+                                size_t length) {
+    int k, i;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        t[j] = pow(a[j], b[j]);
+    }
+    for (k = 1; k <= order; k++) {
+        double *row = ROW(t, k);
+        memset(row, 0, sizeof(double) * length);
+        for (i = 1; i <= k; i++) {
+            const double *x = ROW(a, i), *y = ROW(t, k - i);
+            for (j = 0; j < length; j++) {
+                row[j] += (b[j] * i - (k - i)) * x[j] * y[j];
+            }
+        }
+        for (j = 0; j < length; j++) {
+            row[j] /= k * a[j];
+        }
+    }
+}
+
+static void setConstantSeries(double *t, double value, int order, size_t stride, size_t length) {
+    int k;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        t[j] = value;
+    }
+    for (k = 1; k <= order; k++) {
+        memset(ROW(t, k), 0, sizeof(double) * length);
+    }
+}
+
+static void copySeries(double *t, const double *a, int order, size_t stride, size_t length) {
+    int k;
+    for (k = 0; k <= order; k++) {
+        memcpy(ROW(t, k), ROW(a, k), sizeof(double) * length);
+    }
+}
+
+/**
+ * a^p for an integer p by squaring, so the base may vanish or be negative.
+ * @param scratch Three series, the result is left in the first.
+ */
+static void taylorPowerInteger(double *scratch, const double *a, double exponent, int order, size_t stride,
+                               size_t length) {
+    size_t block = (size_t) (order + 1) * stride;
+    double *result = scratch, *square = scratch + block, *product = square + block;
+    double remaining = fabs(exponent);
+    setConstantSeries(result, 1, order, stride, length);
+    copySeries(square, a, order, stride, length);
+    while (remaining > 0) {
+        if (fmod(remaining, 2) == 1) {
+            taylorMultiply(product, result, square, order, stride, length);
+            copySeries(result, product, order, stride, length);
+        }
+        remaining = floor(remaining / 2);
+        if (remaining > 0) {
+            taylorMultiply(product, square, square, order, stride, length);
+            copySeries(square, product, order, stride, length);
+        }
+    }
+    if (exponent < 0) {
+        setConstantSeries(square, 1, order, stride, length);
+        taylorDivide(product, square, result, order, stride, length);
+        copySeries(result, product, order, stride, length);
+    }
+}
+
+/**
+ * Whether a series is constant at every point.
+ */
+static bool isConstantSeries(const double *a, int order, size_t stride, size_t length) {
+    int k;
+    size_t j;
+    for (k = 1; k <= order; k++) {
+        const double *row = ROW(a, k);
+        for (j = 0; j < length; j++) {
+            if (row[j] != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void taylorPower(const Program *program, double *scratch, const double *a, const double *b, uint16_t exponent,
+                        int order, size_t stride, size_t length) {
+    size_t block = (size_t) (order + 1) * stride, j;
+    double *first = scratch + block, *second = first + block;
+    double constant = exponent < program->constantCount ? program->constants[exponent] : NAN;
+    if (constant == floor(constant) && fabs(constant) <= 0x1p53) {
+        taylorPowerInteger(scratch, a, constant, order, stride, length);
+    } else if (isConstantSeries(b, order, stride, length)) {
+        taylorPowerConstant(scratch, a, b, order, stride, length);
+    } else { // exp(b log(a)), defined for positive bases only.
+        taylorLog(first, a, order, stride, length);
+        taylorMultiply(second, b, first, order, stride, length);
+        taylorExp(scratch, second, order, stride, length);
+    }
+    for (j = 0; j < length; j++) { // The value as runProgramRegisters has it.
+        scratch[j] = pow(a[j], b[j]);
+    }
+}
+
+/**
+ * Rows past the first of an operation with no derivative. They are zero
+ * while both operands are constant, NaN from the first row where one of
+ * them is not, since every higher row depends on that one.
+ */
+static void undefinedRows(double *t, const double *a, const double *b, int order, size_t stride, size_t length) {
+    int k;
+    size_t j;
+    for (j = 0; j < length; j++) {
+        bool varies = false;
+        for (k = 1; k <= order; k++) {
+            varies = varies || ROW(a, k)[j] != 0 || ROW(b, k)[j] != 0;
+            ROW(t, k)[j] = varies ? NAN : 0;
+        }
+    }
+}
+
+/**
+ * Series of an OP_DERIVATIVE, f^(m)(x + c h) has coefficients f^(m + k)(x) c^k / k!
+ * for the first variable x. Rows past the first are NaN where another variable
+ * varies, or the first is not x + c h.
+ */
+static void taylorDerivative(const Program *program, const ProgramDerivative *derivative, double *t,
+                             const double *storage, int order, size_t stride, size_t length) {
+    size_t block = (size_t) (order + 1) * stride, j;
+    const double *variables = storage + block * program->constantCount;
+    double *arguments = (double *) malloc(sizeof(double) * (program->variableCount ? program->variableCount : 1));
+    double derivatives[AUTODIFF_MAX_ORDER + 1];
+    int m = derivative->order, i, k;
+    for (j = 0; j < length; j++) {
+        for (i = 0; i < program->variableCount; i++) {
+            arguments[i] = variables[block * i + j];
+        }
+        double scale = program->variableCount > 0 && order > 0 ? ROW(variables, 1)[j] : 0, power = 1, factorial = 1;
+        bool linear = true;
+        for (k = 2; k <= order && program->variableCount > 0; k++) {
+            linear = linear && ROW(variables, k)[j] == 0;
+        }
+        if (!linear || othersVary(program, variables + stride, block, order, stride, j) ||
+            (scale != 0 && m + order > AUTODIFF_MAX_ORDER)) {
+            t[j] = evaluateDerivative(derivative, arguments);
+            for (k = 1; k <= order; k++) {
+                ROW(t, k)[j] = NAN;
+            }
+            continue;
+        }
+        runProgramDerivatives(derivative->program, arguments, 0, scale != 0 ? m + order : m, derivatives);
+        t[j] = derivatives[m];
+        for (k = 1; k <= order; k++) {
+            power *= scale;
+            factorial *= k;
+            ROW(t, k)[j] = scale != 0 ? derivatives[m + k] * power / factorial : 0;
+        }
+    }
+    free(arguments);
+}
+
+/**
+ * Runs the code of a program over series whose constants and variables are
+ * loaded, with SCRATCH_SERIES more series after the registers.
+ * @return the series of the result.
+ */
+static const double *runTaylor(const Program *program, double *storage, int order, size_t stride, size_t length) {
+    size_t block = (size_t) (order + 1) * stride, j;
+    double *scratch = storage + block * program->registerCount, *first = scratch + block, *second = first + block;
+    const Instruction *ip;
+    int k;
+    for (ip = program->code; ip->opcode != OP_RETURN; ip++) {
+        double *t = storage + block * ip->target;
+        const double *a = opcodeUsesRegisterA(ip->opcode) ? storage + block * ip->a : NULL;
+        const double *b = opcodeUsesRegisterB(ip->opcode) ? storage + block * ip->b : a;
+        bool copy = true;
+        switch ((Opcode) ip->opcode) {
+            case OP_ADD:
+            case OP_SUBTRACT:
+                for (k = 0; k <= order; k++) {
+                    double *row = ROW(t, k);
+                    const double *x = ROW(a, k), *y = ROW(b, k);
+                    if (ip->opcode == OP_ADD) {
+                        for (j = 0; j < length; j++) {
+                            row[j] = x[j] + y[j];
+                        }
+                    } else {
+                        for (j = 0; j < length; j++) {
+                            row[j] = x[j] - y[j];
+                        }
+                    }
+                }
+                copy = false;
+                break;
+            case OP_NEGATE:
+                for (k = 0; k <= order; k++) {
+                    double *row = ROW(t, k);
+                    const double *x = ROW(a, k);
+                    for (j = 0; j < length; j++) {
+                        row[j] = -x[j];
+                    }
+                }
+                copy = false;
+                break;
+            case OP_MULTIPLY:
+                taylorMultiply(scratch, a, b, order, stride, length);
+                break;
+            case OP_DIVIDE:
+                taylorDivide(scratch, a, b, order, stride, length);
+                break;
+            case OP_POWER:
+                taylorPower(program, scratch, a, b, ip->b, order, stride, length);
+                break;
+            case OP_CALL:
+                switch ((BuiltinFunction) ip->b) {
+                    case BUILTIN_SIN:
+                        taylorSinCos(scratch, first, a, order, stride, length);
+                        break;
+                    case BUILTIN_COS:
+                        taylorSinCos(first, scratch, a, order, stride, length);
+                        break;
+                    case BUILTIN_TAN:
+                        taylorSinCos(first, second, a, order, stride, length);
+                        taylorDivide(scratch, first, second, order, stride, length);
+                        for (j = 0; j < length; j++) {
+                            scratch[j] = tan(a[j]);
+                        }
+                        break;
+                    case BUILTIN_EXP:
+                        taylorExp(scratch, a, order, stride, length);
+                        break;
+                    case BUILTIN_LOG:
+                        taylorLog(scratch, a, order, stride, length);
+                        break;
+                    case BUILTIN_SQRT:
+                        taylorSqrt(scratch, a, order, stride, length);
+                        break;
+                    case BUILTIN_ABS: // The sign of a times a, the first row last since t may be a.
+                        for (j = 0; j < length; j++) { // Where a vanishes, as undefinedRows has it.
+                            double sign = a[j] > 0 ? 1 : a[j] < 0 ? -1 : 0;
+                            bool varies = false;
+                            for (k = 1; k <= order; k++) {
+                                varies = varies || ROW(a, k)[j] != 0;
+                                ROW(t, k)[j] = sign != 0 ? (ROW(a, k)[j] == 0 ? 0 : sign * ROW(a, k)[j]) :
+                                               varies ? NAN : 0;
+                            }
+                        }
+                        for (j = 0; j < length; j++) {
+                            t[j] = fabs(a[j]);
+                        }
+                        copy = false;
+                        break;
+                    default:
+                        setConstantSeries(scratch, NAN, order, stride, length);
+                        break;
+                }
+                break;
+            case OP_DERIVATIVE: // Targets are temporaries, never the variables it reads.
+                taylorDerivative(program, program->derivatives + ip->a, t, storage, order, stride, length);
+                copy = false;
+                break;
+            default: // No derivative, the operands have to be constant.
+                undefinedRows(t, a, b, order, stride, length);
+                for (j = 0; j < length; j++) {
+                    t[j] = flatValue((Opcode) ip->opcode, a[j], b[j]);
+                }
+                copy = false;
+                break;
+        }
+        if (copy) {
+            copySeries(t, scratch, order, stride, length);
+        }
+    }
+    return storage + block * ip->a;
+}
+
+double runProgramTaylor(const Program *program, const double *arguments, int variable, int order,
+                        double *coefficients) {
+    if (order < 0 || order > AUTODIFF_MAX_ORDER) {
+        return NAN;
+    }
+    double local[LOCAL_COEFFICIENTS];
+    size_t block = (size_t) order + 1, size = block * (program->registerCount + SCRATCH_SERIES), i;
+    double *storage = size <= LOCAL_COEFFICIENTS ? local : (double *) malloc(sizeof(double) * size);
+    for (i = 0; i < program->constantCount; i++) {
+        setConstantSeries(storage + block * i, program->constants[i], order, 1, 1);
+    }
+    for (i = 0; i < program->variableCount; i++) {
+        double *series = storage + block * (program->constantCount + i);
+        setConstantSeries(series, arguments[i], order, 1, 1);
+        if ((int) i == variable && order > 0) {
+            series[1] = 1;
+        }
+    }
+    memcpy(coefficients, runTaylor(program, storage, order, 1, 1), sizeof(double) * block);
+    if (storage != local) {
+        free(storage);
+    }
+    return coefficients[0];
+}
+
+double runProgramDerivatives(const Program *program, const double *arguments, int variable, int order,
+                             double *derivatives) {
+    if (order == 1) {
+        derivatives[0] = runProgramDual(program, arguments, variable, derivatives + 1);
+        return derivatives[0];
+    }
+    double value = runProgramTaylor(program, arguments, variable, order, derivatives), factorial = 1;
+    int k;
+    for (k = 2; k <= order; k++) {
+        factorial *= k;
+        derivatives[k] *= factorial;
+    }
+    return value;
+}
+
+/**
+ * What runProgramBatchDerivatives shares between its threads.
+ */
+typedef struct {
+    const Program *program;
+    const double *const *columns;
+    int variable;
+    int order;
+    double *const *outputs;
+} DerivativeJob;
+
+static void runDerivativeSlice(void *context, size_t begin, size_t end) {
+    const DerivativeJob *job = (const DerivativeJob *) context;
+    const Program *program = job->program;
+    int order = job->order, k;
+    size_t stride = BATCH_CHUNK, block = (size_t) (order + 1) * stride, i, j, start;
+    double *storage = (double *) malloc(sizeof(double) * block * (program->registerCount + SCRATCH_SERIES));
+    for (i = 0; i < program->constantCount; i++) {
+        setConstantSeries(storage + block * i, program->constants[i], order, stride, stride);
+    }
+    for (i = 0; i < program->variableCount; i++) { // Only the values change from chunk to chunk.
+        double *series = storage + block * (program->constantCount + i);
+        setConstantSeries(series, 0, order, stride, stride);
+        if ((int) i == job->variable && order > 0) {
+            for (j = 0; j < stride; j++) {
+                series[stride + j] = 1;
+            }
+        }
+    }
+    for (start = begin; start < end; start += BATCH_CHUNK) {
+        size_t length = end - start < BATCH_CHUNK ? end - start : BATCH_CHUNK;
+        double factorial = 1;
+        for (i = 0; i < program->variableCount; i++) {
+            memcpy(storage + block * (program->constantCount + i), job->columns[i] + start, sizeof(double) * length);
+        }
+        const double *result = runTaylor(program, storage, order, stride, length);
+        for (k = 0; k <= order; k++) {
+            const double *row = ROW(result, k);
+            double *output = job->outputs[k] + start;
+            factorial *= k > 0 ? k : 1;
+            for (j = 0; j < length; j++) {
+                output[j] = row[j] * factorial;
+            }
+        }
+    }
+    free(storage);
+}
+
+void runProgramBatchDerivatives(const Program *program, const double *const *columns, size_t count,
+                                int variable, int order, double *const *outputs, int threadCount) {
+    if (order < 0 || order > AUTODIFF_MAX_ORDER) {
+        return;
+    }
+    DerivativeJob job = {program, columns, variable, order, outputs};
+    runBatchRanges(count, threadCount, runDerivativeSlice, &job);
+}
+
+void evaluateDerivativeColumns(const ProgramDerivative *derivative, const double *const *columns, size_t count,
+                               double *output) {
+    double *outputs[AUTODIFF_MAX_ORDER + 1];
+    double *lower = (double *) malloc(sizeof(double) * (count ? count : 1) * derivative->order);
+    int k;
+    for (k = 0; k < derivative->order; k++) { // The lower orders come with it and are dropped.
+        outputs[k] = lower + count * k;
+    }
+    outputs[derivative->order] = output;
+    runProgramBatchDerivatives(derivative->program, columns, count, 0, derivative->order, outputs, 1);
+    free(lower);
+}
@@ -0,0 +1,71 @@
+//
+// Forward mode automatic differentiation of compiled expressions.
+//
+
+#ifndef FLUXIONCORE_FLUXION_AUTODIFF_H
+#define FLUXIONCORE_FLUXION_AUTODIFF_H
+#include <stddef.h>
+#include "fluxion_vm.h"
+
+#define AUTODIFF_MAX_ORDER 64 // Highest derivative computed, the factorials past it overflow soon anyway.
+
+/**
+ * Compile an expression whose derivative is wanted, e'' is compiled as e
+ * with an order of 2. Only the primes around the whole expression are taken off,
+ * those inside it are left to compileExpression.
+ * @param order Set to the number of primes.
+ * @return the program of e, NULL after issuing an error if it can not be evaluated numerically.
+ */
+Program *compileDerivative(const Token *root, const char *const *variables, int variableCount, int *order);
+
+/**
+ * Evaluate a program and its derivative with respect to a variable in one
+ * pass over dual numbers, each register carrying a value and a derivative.
+ * Operations with no derivative, like comparisons or factorials, give a NaN
+ * derivative unless their operands do not depend on the variable.
+ * @param arguments Values of the variables, in the order they were compiled with.
+ * @param variable Index of the variable to differentiate with respect to.
+ * @param derivative Receives the derivative.
+ * @return the value, as runProgram would give it.
+ */
+double runProgramDual(const Program *program, const double *arguments, int variable, double *derivative);
+/**
+ * Evaluate a program over truncated Taylor series, the coefficients of
+ * f(x + h) in h for the variable x, in one pass. Each register carries
+ * order + 1 coefficients, products cost O(order^2) per instruction.
+ * @param order Highest coefficient, at most AUTODIFF_MAX_ORDER.
+ * @param coefficients Receives the order + 1 coefficients, the first is the value.
+ * @return the value, NaN without touching coefficients if the order is out of range.
+ */
+double runProgramTaylor(const Program *program, const double *arguments, int variable, int order,
+                        double *coefficients);
+/**
+ * The same as runProgramTaylor, with derivatives[k] the k-th derivative,
+ * through dual numbers when the order is 1.
+ */
+double runProgramDerivatives(const Program *program, const double *arguments, int variable, int order,
+                             double *derivatives);
+/**
+ * Value of the derivative an OP_DERIVATIVE instruction takes.
+ * @param arguments Values of the variables of the program the instruction is in.
+ * @return the value, NaN where it is not defined.
+ */
+double evaluateDerivative(const ProgramDerivative *derivative, const double *arguments);
+/**
+ * The same as evaluateDerivative at count points.
+ * @param columns columns[i] holds the count values of variable i.
+ * @param output Receives the count values.
+ */
+void evaluateDerivativeColumns(const ProgramDerivative *derivative, const double *const *columns, size_t count,
+                               double *output);
+/**
+ * Evaluate a program and its derivatives at count points, a chunk of points at
+ * a time with the Taylor coefficients of a register stored as columns.
+ * @param columns columns[i] holds the count values of variable i.
+ * @param outputs outputs[k] receives the count values of the k-th derivative, for k up to order.
+ * @param threadCount Most threads to split the points over, 0 for one per processor.
+ */
+void runProgramBatchDerivatives(const Program *program, const double *const *columns, size_t count,
+                                int variable, int order, double *const *outputs, int threadCount);
+
+#endif //FLUXIONCORE_FLUXION_AUTODIFF_H
@@ -0,0 +1,438 @@
+//
+// Evaluation of compiled expressions over columns of inputs.
+//
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "fluxion_autodiff.h"
+#include "fluxion_batch.h"
+
+#ifdef FLUXION_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BATCH_VECTOR 1
+#define LANES 4
+typedef double VectorDouble __attribute__((vector_size(32)));
+typedef int64_t VectorLong __attribute__((vector_size(32)));
+#define KERNEL static inline __attribute__((always_inline))
+#pragma GCC diagnostic ignored "-Wpsabi" // Vectors only cross inlined calls, the ABI never matters.
+#if defined(__x86_64__) || defined(__i386__)
+#define BATCH_HAS_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define LANES 1
+#endif
+
+/**
+ * Runs the program over length points, a multiple of LANES.
+ * registers[i] is the column of register i, with the constants
+ * and variables in place. Results go to output.
+ */
+typedef void (*ChunkRunner)(const Program *program, double *const *registers, size_t length, double *output);
+
+#ifdef BATCH_VECTOR
+/*
+ * Vector kernels, written with the GCC vector extensions so the same source
+ * compiles to SSE2 or NEON for the baseline and to AVX2 where the CPU has it.
+ * Lanes outside the range a kernel is accurate in are recomputed with libm.
+ */
+
+#define ROUND_MAGIC 6755399441055744.0 // 1.5 * 2^52, adding it rounds to an integer.
+#define LN2_HI 6.93147180369123816490e-01 // ln 2 with trailing zero bits, so k * LN2_HI is exact.
+#define LN2_LO 1.90821492927058770002e-10
+#define PIO2_1 1.57079632673412561417e+00 // pi / 2 in three parts of 33 bits.
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_3 2.02226624871116645580e-21
+#define TRIGONOMETRIC_LIMIT 1e5 // Larger arguments need a longer reduction.
+
+KERNEL VectorDouble loadVector(const double *pointer) {
+    VectorDouble vector;
+    memcpy(&vector, pointer, sizeof(VectorDouble));
+    return vector;
+}
+
+KERNEL void storeVector(double *pointer, VectorDouble vector) {
+    memcpy(pointer, &vector, sizeof(VectorDouble));
+}
+
+KERNEL VectorDouble broadcast(double value) {
+    VectorDouble vector = {value, value, value, value};
+    return vector;
+}
+
+KERNEL VectorDouble selectVector(VectorLong mask, VectorDouble a, VectorDouble b) {
+    return (VectorDouble) ((mask & (VectorLong) a) | (~mask & (VectorLong) b));
+}
+
+/**
+ * 1.0 where mask is set and 0.0 elsewhere.
+ */
+KERNEL VectorDouble maskToDouble(VectorLong mask) {
+    return (VectorDouble) (mask & (VectorLong) broadcast(1.0));
+}
+
+/**
+ * Recompute the lanes set in outside with a scalar function.
+ */
+KERNEL VectorDouble fixLanes(VectorLong outside, VectorDouble x, VectorDouble y, double (*function)(double)) {
+    int lane;
+    for (lane = 0; lane < LANES; lane++) {
+        if (outside[lane]) {
+            y[lane] = function(x[lane]);
+        }
+    }
+    return y;
+}
+
+KERNEL VectorDouble vectorExp(VectorDouble x) {
+    VectorDouble k = (x * 1.44269504088896338700 + ROUND_MAGIC) - ROUND_MAGIC;
+    VectorDouble r = (x - k * LN2_HI) - k * LN2_LO; // |r| <= ln(2) / 2
+    VectorDouble p = broadcast(1.0 / 6227020800.0); // Taylor series up to r^13.
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+    VectorLong n = __builtin_convertvector(k, VectorLong);
+    VectorDouble y = p * (VectorDouble) ((n + 1023) << 52);
+    VectorLong inside = (x > -708.0) & (x < 709.0); // Keeps 2^n normal, false for NaN.
+    return fixLanes(~inside, x, y, exp);
+}
+
+KERNEL VectorDouble vectorLog(VectorDouble x) {
+    VectorLong bits = (VectorLong) x;
+    VectorLong exponent = ((bits >> 52) & 0x7FF) - 1023;
+    VectorDouble m = (VectorDouble) ((bits & 0x000FFFFFFFFFFFFFLL) | 0x3FF0000000000000LL);
+    VectorLong high = m > 1.41421356237309504880; // Keep m in [sqrt(2) / 2, sqrt(2)).
+    m = selectVector(high, m * 0.5, m);
+    exponent -= high;
+    VectorDouble k = __builtin_convertvector(exponent, VectorDouble);
+    // log(1 + f) as in fdlibm, with s = f / (2 + f).
+    VectorDouble f = m - 1.0;
+    VectorDouble s = f / (f + 2.0);
+    VectorDouble z = s * s;
+    VectorDouble r = broadcast(1.479819860511658591e-01);
+    r = r * z + 1.531383769920937332e-01;
+    r = r * z + 1.818357216161805012e-01;
+    r = r * z + 2.222219843214978396e-01;
+    r = r * z + 2.857142874366239149e-01;
+    r = r * z + 3.999999999940941908e-01;
+    r = r * z + 6.666666666666735130e-01;
+    r = r * z;
+    VectorDouble halfSquare = 0.5 * f * f;
+    VectorDouble y = k * LN2_HI - ((halfSquare - (s * (halfSquare + r) + k * LN2_LO)) - f);
+    VectorLong inside = (x >= DBL_MIN) & (x <= DBL_MAX); // Normal and positive.
+    return fixLanes(~inside, x, y, log);
+}
+
+/**
+ * Sine and cosine together, they share the argument reduction.
+ */
+KERNEL void vectorSinCos(VectorDouble x, VectorDouble *sine, VectorDouble *cosine) {
+    VectorDouble k = (x * 6.36619772367581382433e-01 + ROUND_MAGIC) - ROUND_MAGIC;
+    VectorDouble r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3; // |r| <= pi / 4
+    VectorDouble z = r * r;
+    // The fdlibm kernels.
+    VectorDouble p = broadcast(1.58969099521155010221e-10);
+    p = p * z - 2.50507602534068634195e-08;
+    p = p * z + 2.75573137070700676789e-06;
+    p = p * z - 1.98412698298579493134e-04;
+    p = p * z + 8.33333333332248946124e-03;
+    VectorDouble s = r + z * r * (p * z - 1.66666666666666324348e-01);
+    VectorDouble q = broadcast(-1.13596475577881948265e-11);
+    q = q * z + 2.08757232129817482790e-09;
+    q = q * z - 2.75573143513906633035e-07;
+    q = q * z + 2.48015872894767294178e-05;
+    q = q * z - 1.38888888888741095749e-03;
+    q = q * z + 4.16666666666666019037e-02;
+    VectorDouble halfZ = 0.5 * z;
+    VectorDouble w = 1.0 - halfZ;
+    VectorDouble c = w + (((1.0 - w) - halfZ) + z * z * q);
+    // Quadrant k mod 4 swaps and negates.
+    VectorLong quadrant = __builtin_convertvector(k, VectorLong);
+    VectorLong swap = -(quadrant & 1);
+    VectorDouble sineResult = (VectorDouble) ((VectorLong) selectVector(swap, c, s) ^ ((quadrant & 2) << 62));
+    VectorDouble cosineResult = (VectorDouble) ((VectorLong) selectVector(swap, s, c) ^ (((quadrant + 1) & 2) << 62));
+    VectorLong outside = ~((x >= -TRIGONOMETRIC_LIMIT) & (x <= TRIGONOMETRIC_LIMIT));
+    if (sine) {
+        *sine = fixLanes(outside, x, sineResult, sin);
+    }
+    if (cosine) {
+        *cosine = fixLanes(outside, x, cosineResult, cos);
+    }
+}
+
+#define BINARY_LOOP(expression) \
+    for (j = 0; j < length; j += LANES) { \
+        VectorDouble x = loadVector(a + j), y = loadVector(b + j); \
+        storeVector(t + j, expression); \
+    } \
+    break
+
+#define UNARY_LOOP(expression) \
+    for (j = 0; j < length; j += LANES) { \
+        VectorDouble x = loadVector(a + j); \
+        storeVector(t + j, expression); \
+    } \
+    break
+
+#define SCALAR_LOOP(expression) \
+    for (j = 0; j < length; j++) { \
+        t[j] = expression; \
+    } \
+    break
+
+KERNEL void runCall(BuiltinFunction function, const double *a, double *t, size_t length) {
+    size_t j;
+    VectorDouble sine, cosine;
+    switch (function) {
+        case BUILTIN_SIN:
+            UNARY_LOOP((vectorSinCos(x, &sine, NULL), sine));
+        case BUILTIN_COS:
+            UNARY_LOOP((vectorSinCos(x, NULL, &cosine), cosine));
+        case BUILTIN_TAN:
+            UNARY_LOOP((vectorSinCos(x, &sine, &cosine), sine / cosine));
+        case BUILTIN_EXP:
+            UNARY_LOOP(vectorExp(x));
+        case BUILTIN_LOG:
+            UNARY_LOOP(vectorLog(x));
+        case BUILTIN_SQRT:
+            SCALAR_LOOP(sqrt(a[j]));
+        case BUILTIN_ABS:
+            UNARY_LOOP((VectorDouble) ((VectorLong) x & 0x7FFFFFFFFFFFFFFFLL));
+        default:
+            SCALAR_LOOP(NAN);
+    }
+}
+
+KERNEL void runChunkBody(const Program *program, double *const *registers, size_t length, double *output) {
+    const Instruction *ip;
+    size_t j;
+    for (ip = program->code; ip->opcode != OP_RETURN; ip++) {
+        double *t = registers[ip->target];
+        const double *a = opcodeUsesRegisterA(ip->opcode) ? registers[ip->a] : NULL;
+        const double *b = opcodeUsesRegisterB(ip->opcode) ? registers[ip->b] : a;
+        switch ((Opcode) ip->opcode) {
+            case OP_ADD:
+                BINARY_LOOP(x + y);
+            case OP_SUBTRACT:
+                BINARY_LOOP(x - y);
+            case OP_MULTIPLY:
+                BINARY_LOOP(x * y);
+            case OP_DIVIDE:
+                BINARY_LOOP(x / y);
+            case OP_POWER:
+                SCALAR_LOOP(pow(a[j], b[j]));
+            case OP_NEGATE:
+                UNARY_LOOP(-x);
+            case OP_NOT:
+                UNARY_LOOP(maskToDouble(x == 0.0));
+            case OP_FACTORIAL:
+                SCALAR_LOOP(tgamma(a[j] + 1));
+            case OP_LESS:
+                BINARY_LOOP(maskToDouble(x < y));
+            case OP_GREATER:
+                BINARY_LOOP(maskToDouble(x > y));
+            case OP_LEQ:
+                BINARY_LOOP(maskToDouble(x <= y));
+            case OP_GEQ:
+                BINARY_LOOP(maskToDouble(x >= y));
+            case OP_EQUAL:
+                BINARY_LOOP(maskToDouble(x == y));
+            case OP_NEQ:
+                BINARY_LOOP(maskToDouble(x != y));
+            case OP_AND:
+                BINARY_LOOP(maskToDouble((x != 0.0) & (y != 0.0)));
+            case OP_OR:
+                BINARY_LOOP(maskToDouble((x != 0.0) | (y != 0.0)));
+            case OP_CALL:
+                runCall((BuiltinFunction) ip->b, a, t, length);
+                break;
+            case OP_DERIVATIVE:
+                evaluateDerivativeColumns(program->derivatives + ip->a,
+                                          (const double *const *) registers + program->constantCount, length, t);
+                break;
+            default:
+                SCALAR_LOOP(NAN);
+        }
+    }
+    memcpy(output, registers[ip->a], sizeof(double) * length);
+}
+
+static void runChunkBaseline(const Program *program, double *const *registers, size_t length, double *output) {
+    runChunkBody(program, registers, length, output);
+}
+
+#ifdef BATCH_HAS_AVX2
+TARGET_AVX2 static void runChunkAvx2(const Program *program, double *const *registers, size_t length, double *output) {
+    runChunkBody(program, registers, length, output);
+}
+#endif
+
+#else
+/*
+ * Without the vector extensions every point runs through the interpreter.
+ */
+static void runChunkBaseline(const Program *program, double *const *registers, size_t length, double *output) {
+    double local[64];
+    double *frame = program->registerCount <= 64 ? local : (double *) malloc(sizeof(double) * program->registerCount);
+    size_t j, i, loaded = (size_t) program->constantCount + program->variableCount;
+    for (j = 0; j < length; j++) {
+        for (i = 0; i < loaded; i++) {
+            frame[i] = registers[i][j];
+        }
+        output[j] = runProgramRegisters(program, frame);
+    }
+    if (frame != local) {
+        free(frame);
+    }
+}
+#endif
+
+static ChunkRunner selectRunner(void) {
+#ifdef BATCH_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return runChunkAvx2;
+    }
+#endif
+    return runChunkBaseline;
+}
+
+/**
+ * What runProgramBatch shares between its threads.
+ */
+typedef struct {
+    const Program *program;
+    const double *const *columns;
+    double *output;
+    ChunkRunner runner;
+} BatchJob;
+
+static void runSlice(void *context, size_t begin, size_t end) {
+    const BatchJob *job = (const BatchJob *) context;
+    const Program *program = job->program;
+    size_t registerCount = program->registerCount;
+    size_t i, start;
+    // A column per register, plus one for the results of a partial chunk.
+    double *storage = (double *) malloc(sizeof(double) * BATCH_CHUNK * (registerCount + 1));
+    double **registers = (double **) malloc(sizeof(double *) * (registerCount ? registerCount : 1));
+    double *tail = storage + BATCH_CHUNK * registerCount;
+    for (i = 0; i < registerCount; i++) {
+        registers[i] = storage + BATCH_CHUNK * i;
+    }
+    for (i = 0; i < program->constantCount; i++) {
+        size_t j;
+        for (j = 0; j < BATCH_CHUNK; j++) {
+            registers[i][j] = program->constants[i];
+        }
+    }
+    for (start = begin; start < end; start += BATCH_CHUNK) {
+        size_t length = end - start < BATCH_CHUNK ? end - start : BATCH_CHUNK;
+        size_t padded = (length + LANES - 1) / LANES * LANES;
+        for (i = 0; i < program->variableCount; i++) {
+            size_t index = program->constantCount + i;
+            if (padded == length) { // Read the input in place.
+                registers[index] = (double *) (job->columns[i] + start);
+            } else {
+                registers[index] = storage + BATCH_CHUNK * index;
+                memcpy(registers[index], job->columns[i] + start, sizeof(double) * length);
+                memset(registers[index] + length, 0, sizeof(double) * (padded - length));
+            }
+        }
+        if (padded == length) {
+            job->runner(program, registers, length, job->output + start);
+        } else {
+            job->runner(program, registers, padded, tail);
+            memcpy(job->output + start, tail, sizeof(double) * length);
+        }
+    }
+    free(registers);
+    free(storage);
+}
+
+/**
+ * Points a thread evaluates.
+ */
+typedef struct {
+    BatchRangeRunner run;
+    void *context;
+    size_t begin;
+    size_t end;
+} BatchSlice;
+
+#ifdef FLUXION_THREADS
+static void *runSliceThread(void *slice) {
+    BatchSlice *range = (BatchSlice *) slice;
+    range->run(range->context, range->begin, range->end);
+    limbPoolTrim(); // The thread ends, its cached limbs would be lost.
+    return NULL;
+}
+#endif
+
+void runBatchRanges(size_t count, int threadCount, BatchRangeRunner run, void *context) {
+#ifdef FLUXION_THREADS
+    if (threadCount <= 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? (int) processors : 1;
+    }
+    size_t useful = count / BATCH_POINTS_PER_THREAD;
+    if ((size_t) threadCount > useful) {
+        threadCount = useful > 1 ? (int) useful : 1;
+    }
+    if (threadCount > 1) {
+        BatchSlice *slices = (BatchSlice *) malloc(sizeof(BatchSlice) * threadCount);
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * threadCount);
+        size_t chunks = (count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+        int i, started = 0;
+        for (i = 0; i < threadCount; i++) { // Whole chunks per thread, so only the last one is partial.
+            slices[i].run = run;
+            slices[i].context = context;
+            slices[i].begin = chunks * i / threadCount * BATCH_CHUNK;
+            slices[i].end = i == threadCount - 1 ? count : chunks * (i + 1) / threadCount * BATCH_CHUNK;
+        }
+        for (i = 1; i < threadCount; i++) {
+            if (pthread_create(threads + i, NULL, runSliceThread, slices + i) != 0) {
+                break;
+            }
+            started = i;
+        }
+        run(context, slices[0].begin, slices[0].end);
+        for (i = started + 1; i < threadCount; i++) { // Threads that could not start run here.
+            run(context, slices[i].begin, slices[i].end);
+        }
+        for (i = 1; i <= started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(slices);
+        return;
+    }
+#else
+    (void) threadCount;
+#endif
+    run(context, 0, count);
+}
+
+void runProgramBatch(const Program *program, const double *const *columns, size_t count,
+                     double *output, int threadCount) {
+    static ChunkRunner runner = NULL;
+    if (runner == NULL) {
+        runner = selectRunner();
+    }
+    BatchJob job = {program, columns, output, runner};
+    runBatchRanges(count, threadCount, runSlice, &job);
+}
@@ -0,0 +1,40 @@
+//
+// Evaluation of compiled expressions over columns of inputs.
+//
+
+#ifndef FLUXIONCORE_FLUXION_BATCH_H
+#define FLUXIONCORE_FLUXION_BATCH_H
+#include <stddef.h>
+#include "fluxion_vm.h"
+
+#define BATCH_CHUNK 256 // Points evaluated together, a column of them per register stays in cache.
+#define BATCH_POINTS_PER_THREAD 65536 // Fewer points than this per thread are not worth the thread.
+
+/**
+ * Evaluate a program at count points, an instruction at a time over
+ * a chunk of points with vector kernels.
+ * Results can differ from runProgram in the last bit for elementary functions.
+ * @param program Program to evaluate.
+ * @param columns columns[i] holds the count values of variable i.
+ * @param count Number of points.
+ * @param output Receives the count values.
+ * @param threadCount Most threads to split the points over, 0 for one per processor.
+ */
+void runProgramBatch(const Program *program, const double *const *columns, size_t count,
+                     double *output, int threadCount);
+
+/**
+ * Evaluates the points in [begin, end) of a batch.
+ */
+typedef void (*BatchRangeRunner)(void *context, size_t begin, size_t end);
+
+/**
+ * Split count points into ranges of whole chunks and run them on threads.
+ * @param threadCount Most threads to split the points over, 0 for one per processor,
+ * fewer are used when a thread would get less than BATCH_POINTS_PER_THREAD points.
+ * @param run Called once per range, concurrently from different threads.
+ * @param context Passed to run.
+ */
+void runBatchRanges(size_t count, int threadCount, BatchRangeRunner run, void *context);
+
+#endif //FLUXIONCORE_FLUXION_BATCH_H
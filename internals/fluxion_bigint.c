@@ -0,0 +1,948 @@
+//
+// Arbitrary precision integers on pooled limb storage.
+//
+
+#include <string.h>
+#include <math.h>
+#include "fluxion_bigint.h"
+
+#define LIMB_POOL_MIN_SHIFT 2 // Smallest size class, 4 limbs.
+#define LIMB_POOL_CLASSES 14 // Largest pooled class, 32K limbs.
+#define LIMB_POOL_DEPTH 32 // Blocks cached per class.
+#define KARATSUBA_THRESHOLD 32 // Limbs, below this schoolbook is faster.
+
+/**
+ * Free blocks of one size class.
+ */
+typedef struct {
+    Limb *blocks[LIMB_POOL_DEPTH];
+    int count;
+} LimbFreeList;
+
+static FLUXION_THREAD_LOCAL LimbFreeList limbPool[LIMB_POOL_CLASSES];
+
+static int sizeClass(size_t count) {
+    int shift = LIMB_POOL_MIN_SHIFT;
+    while (((size_t) 1 << shift) < count) {
+        shift++;
+    }
+    return shift - LIMB_POOL_MIN_SHIFT;
+}
+
+Limb *limbAlloc(size_t count, uint32_t *capacity) {
+    int sizeIndex = sizeClass(count);
+    if (sizeIndex >= LIMB_POOL_CLASSES) {
+        *capacity = (uint32_t) count;
+        return (Limb *) malloc(sizeof(Limb) * count);
+    }
+    *capacity = (uint32_t) 1 << (sizeIndex + LIMB_POOL_MIN_SHIFT);
+    LimbFreeList *list = &limbPool[sizeIndex];
+    if (list->count > 0) {
+        return list->blocks[--list->count];
+    }
+    return (Limb *) malloc(sizeof(Limb) * *capacity);
+}
+
+void limbFree(Limb *limbs, uint32_t capacity) {
+    if (limbs == NULL) {
+        return;
+    }
+    int sizeIndex = sizeClass(capacity);
+    // Blocks that are not a whole size class came straight from malloc.
+    if (sizeIndex < LIMB_POOL_CLASSES && capacity == (uint32_t) 1 << (sizeIndex + LIMB_POOL_MIN_SHIFT)) {
+        LimbFreeList *list = &limbPool[sizeIndex];
+        if (list->count < LIMB_POOL_DEPTH) {
+            list->blocks[list->count++] = limbs;
+            return;
+        }
+    }
+    free(limbs);
+}
+
+void limbPoolTrim(void) {
+    int i;
+    for (i = 0; i < LIMB_POOL_CLASSES; i++) {
+        while (limbPool[i].count > 0) {
+            free(limbPool[i].blocks[--limbPool[i].count]);
+        }
+    }
+}
+
+/*
+ * Limb vector primitives, vectors are little endian and lengths may be zero.
+ */
+
+static int countLeadingZeros(Limb value) {
+#if defined(__GNUC__)
+    return __builtin_clz(value);
+#else
+    int count = 0;
+    while (!(value & 0x80000000u)) {
+        value <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static int countTrailingZeros(Limb value) {
+#if defined(__GNUC__)
+    return __builtin_ctz(value);
+#else
+    int count = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static size_t trimLength(const Limb *limbs, size_t length) {
+    while (length > 0 && limbs[length - 1] == 0) {
+        length--;
+    }
+    return length;
+}
+
+static int compareLimbs(const Limb *a, size_t na, const Limb *b, size_t nb) {
+    if (na != nb) {
+        return na < nb ? -1 : 1;
+    }
+    while (na-- > 0) {
+        if (a[na] != b[na]) {
+            return a[na] < b[na] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * result = a + b where na >= nb, result may alias a or b.
+ * @return the carry out of limb na.
+ */
+static Limb addLimbs(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb) {
+    DoubleLimb carry = 0;
+    size_t i;
+    for (i = 0; i < nb; i++) {
+        carry += (DoubleLimb) a[i] + b[i];
+        result[i] = (Limb) carry;
+        carry >>= LIMB_BITS;
+    }
+    for (; i < na; i++) {
+        carry += a[i];
+        result[i] = (Limb) carry;
+        carry >>= LIMB_BITS;
+    }
+    return (Limb) carry;
+}
+
+/**
+ * result = a - b where a >= b and na >= nb, result may alias a or b.
+ * @return the borrow out of limb na, zero when a >= b.
+ */
+static Limb subtractLimbs(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb) {
+    Limb borrow = 0;
+    size_t i;
+    for (i = 0; i < nb; i++) {
+        DoubleLimb difference = (DoubleLimb) a[i] - b[i] - borrow;
+        result[i] = (Limb) difference;
+        borrow = (Limb) (difference >> LIMB_BITS) & 1;
+    }
+    for (; i < na; i++) {
+        DoubleLimb difference = (DoubleLimb) a[i] - borrow;
+        result[i] = (Limb) difference;
+        borrow = (Limb) (difference >> LIMB_BITS) & 1;
+    }
+    return borrow;
+}
+
+/**
+ * Add b into result, propagating the carry through the rest of result.
+ */
+static void addInto(Limb *result, size_t length, const Limb *b, size_t nb) {
+    if (addLimbs(result, result, nb, b, nb)) {
+        size_t i;
+        for (i = nb; i < length && ++result[i] == 0; i++);
+    }
+}
+
+/**
+ * result[0, n) += a * multiplier.
+ * @return the carry out.
+ */
+static Limb multiplyAddLimb(Limb *result, const Limb *a, size_t n, Limb multiplier) {
+    DoubleLimb carry = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        carry += (DoubleLimb) a[i] * multiplier + result[i];
+        result[i] = (Limb) carry;
+        carry >>= LIMB_BITS;
+    }
+    return (Limb) carry;
+}
+
+/**
+ * result = a * b in na + nb limbs, result does not alias the operands.
+ */
+static void schoolbookMultiply(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb) {
+    size_t i;
+    memset(result, 0, sizeof(Limb) * (na + nb));
+    for (i = 0; i < nb; i++) {
+        result[i + na] = multiplyAddLimb(result + i, a, na, b[i]);
+    }
+}
+
+static void multiplyLimbs(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb);
+
+/**
+ * Karatsuba on operands of comparable length, na >= nb > na / 2.
+ * With a = a1 B^h + a0 and b = b1 B^h + b0 the middle product
+ * a0 b1 + a1 b0 is (a0 + a1)(b0 + b1) - a0 b0 - a1 b1.
+ */
+static void karatsubaMultiply(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb) {
+    size_t h = (na + 1) / 2;
+    size_t na1 = na - h, nb1 = nb - h;
+    uint32_t capacity;
+    Limb *scratch = limbAlloc(4 * h + 4, &capacity);
+    Limb *sumA = scratch, *sumB = scratch + h + 1, *middle = scratch + 2 * h + 2;
+
+    multiplyLimbs(result, a, h, b, h);
+    memset(result + 2 * h, 0, sizeof(Limb) * (na + nb - 2 * h));
+    size_t nz2 = trimLength(a + h, na1) && trimLength(b + h, nb1) ? na1 + nb1 : 0;
+    if (nz2) {
+        multiplyLimbs(result + 2 * h, a + h, na1, b + h, nb1);
+    }
+
+    sumA[h] = addLimbs(sumA, a, h, a + h, na1);
+    sumB[h] = addLimbs(sumB, b, h, b + h, nb1);
+    size_t nsa = trimLength(sumA, h + 1), nsb = trimLength(sumB, h + 1);
+    memset(middle, 0, sizeof(Limb) * (2 * h + 2));
+    if (nsa && nsb) {
+        multiplyLimbs(middle, sumA, nsa, sumB, nsb);
+    }
+    subtractLimbs(middle, middle, 2 * h + 2, result, 2 * h);
+    if (nz2) {
+        subtractLimbs(middle, middle, 2 * h + 2, result + 2 * h, nz2);
+    }
+    addInto(result + h, na + nb - h, middle, trimLength(middle, 2 * h + 2));
+    limbFree(scratch, capacity);
+}
+
+/**
+ * result = a * b in na + nb limbs, result does not alias the operands.
+ * Operands may be in any order and have leading zeros.
+ */
+static void multiplyLimbs(Limb *result, const Limb *a, size_t na, const Limb *b, size_t nb) {
+    if (na < nb) {
+        const Limb *swap = a;
+        a = b;
+        b = swap;
+        size_t swapLength = na;
+        na = nb;
+        nb = swapLength;
+    }
+    if (nb < KARATSUBA_THRESHOLD) {
+        schoolbookMultiply(result, a, na, b, nb);
+        return;
+    }
+    if (2 * nb > na + 1) {
+        karatsubaMultiply(result, a, na, b, nb);
+        return;
+    }
+    // Unbalanced, multiply b by slices of a as long as b.
+    uint32_t capacity;
+    Limb *slice = limbAlloc(2 * nb, &capacity);
+    size_t offset;
+    memset(result, 0, sizeof(Limb) * (na + nb));
+    for (offset = 0; offset < na; offset += nb) {
+        size_t length = na - offset < nb ? na - offset : nb;
+        multiplyLimbs(slice, a + offset, length, b, nb);
+        addInto(result + offset, na + nb - offset, slice, length + nb);
+    }
+    limbFree(slice, capacity);
+}
+
+/**
+ * Divide a by a limb.
+ * @return the remainder.
+ */
+static Limb divideLimbsByLimb(Limb *quotient, const Limb *a, size_t n, Limb divisor) {
+    DoubleLimb remainder = 0;
+    while (n-- > 0) {
+        DoubleLimb current = remainder << LIMB_BITS | a[n];
+        if (quotient != NULL) {
+            quotient[n] = (Limb) (current / divisor);
+        }
+        remainder = current % divisor;
+    }
+    return (Limb) remainder;
+}
+
+/**
+ * Knuth's algorithm D, divide u of m limbs by v of n limbs,
+ * m >= n >= 2 and v[n - 1] != 0. The quotient has m - n + 1 limbs,
+ * the remainder n limbs, either may be NULL.
+ */
+static void divideLimbs(Limb *quotient, Limb *remainder, const Limb *u, size_t m, const Limb *v, size_t n) {
+    uint32_t capacity;
+    Limb *scratch = limbAlloc(m + n + 1, &capacity);
+    Limb *un = scratch, *vn = scratch + m + 1;
+    int shift = countLeadingZeros(v[n - 1]);
+    size_t i, j;
+    // Normalise so the top bit of the divisor is set.
+    for (i = n - 1; i > 0; i--) {
+        vn[i] = (Limb) (v[i] << shift | (DoubleLimb) v[i - 1] >> (LIMB_BITS - shift));
+    }
+    vn[0] = v[0] << shift;
+    un[m] = (Limb) ((DoubleLimb) u[m - 1] >> (LIMB_BITS - shift));
+    for (i = m - 1; i > 0; i--) {
+        un[i] = (Limb) (u[i] << shift | (DoubleLimb) u[i - 1] >> (LIMB_BITS - shift));
+    }
+    un[0] = u[0] << shift;
+
+    for (j = m - n + 1; j-- > 0;) {
+        DoubleLimb numerator = (DoubleLimb) un[j + n] << LIMB_BITS | un[j + n - 1];
+        DoubleLimb estimate = numerator / vn[n - 1];
+        DoubleLimb rest = numerator % vn[n - 1];
+        while (estimate >> LIMB_BITS || estimate * vn[n - 2] > (rest << LIMB_BITS | un[j + n - 2])) {
+            estimate--;
+            rest += vn[n - 1];
+            if (rest >> LIMB_BITS) {
+                break;
+            }
+        }
+        // Multiply and subtract.
+        int64_t borrow = 0, difference;
+        for (i = 0; i < n; i++) {
+            DoubleLimb product = estimate * vn[i];
+            difference = (int64_t) un[i + j] - borrow - (int64_t) (product & 0xFFFFFFFFu);
+            un[i + j] = (Limb) difference;
+            borrow = (int64_t) (product >> LIMB_BITS) - (difference >> LIMB_BITS);
+        }
+        difference = (int64_t) un[j + n] - borrow;
+        un[j + n] = (Limb) difference;
+        if (difference < 0) { // The estimate was one too large, add back.
+            estimate--;
+            un[j + n] += addLimbs(un + j, un + j, n, vn, n);
+        }
+        if (quotient != NULL) {
+            quotient[j] = (Limb) estimate;
+        }
+    }
+    if (remainder != NULL) {
+        for (i = 0; i < n - 1; i++) {
+            remainder[i] = (Limb) (un[i] >> shift | (DoubleLimb) un[i + 1] << (LIMB_BITS - shift));
+        }
+        remainder[n - 1] = un[n - 1] >> shift;
+    }
+    limbFree(scratch, capacity);
+}
+
+/*
+ * BigInt.
+ */
+
+void initBigInt(BigInt *integer) {
+    integer->limbs = NULL;
+    integer->size = 0;
+    integer->capacity = 0;
+    integer->negative = false;
+}
+
+void freeBigInt(BigInt *integer) {
+    limbFree(integer->limbs, integer->capacity);
+    initBigInt(integer);
+}
+
+void bigIntReserve(BigInt *integer, size_t count) {
+    if (count <= integer->capacity) {
+        return;
+    }
+    uint32_t capacity;
+    Limb *limbs = limbAlloc(count, &capacity);
+    if (integer->size) {
+        memcpy(limbs, integer->limbs, sizeof(Limb) * integer->size);
+    }
+    limbFree(integer->limbs, integer->capacity);
+    integer->limbs = limbs;
+    integer->capacity = capacity;
+}
+
+/**
+ * Set the size after trimming leading zeros, zero is made non negative.
+ */
+static void normalise(BigInt *integer, size_t size) {
+    integer->size = (uint32_t) trimLength(integer->limbs, size);
+    if (integer->size == 0) {
+        integer->negative = false;
+    }
+}
+
+void bigIntSetUint64(BigInt *result, uint64_t value) {
+    bigIntReserve(result, 2);
+    result->limbs[0] = (Limb) value;
+    result->limbs[1] = (Limb) (value >> LIMB_BITS);
+    result->negative = false;
+    normalise(result, 2);
+}
+
+void bigIntSetInt64(BigInt *result, int64_t value) {
+    bigIntSetUint64(result, value < 0 ? 0 - (uint64_t) value : (uint64_t) value);
+    result->negative = value < 0;
+}
+
+void bigIntCopy(BigInt *result, const BigInt *integer) {
+    if (result == integer) {
+        return;
+    }
+    bigIntReserve(result, integer->size);
+    if (integer->size) {
+        memcpy(result->limbs, integer->limbs, sizeof(Limb) * integer->size);
+    }
+    result->size = integer->size;
+    result->negative = integer->negative;
+}
+
+void bigIntMove(BigInt *result, BigInt *source) {
+    if (result == source) {
+        return;
+    }
+    limbFree(result->limbs, result->capacity);
+    *result = *source;
+    initBigInt(source);
+}
+
+void bigIntSwap(BigInt *a, BigInt *b) {
+    BigInt swap = *a;
+    *a = *b;
+    *b = swap;
+}
+
+bool bigIntSetDecimal(BigInt *result, const char *digits, size_t length) {
+    static const Limb powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    bool negative = length > 0 && digits[0] == '-';
+    size_t i = negative ? 1 : 0;
+    result->size = 0;
+    result->negative = false;
+    // Roughly 9.6 digits fit a limb.
+    bigIntReserve(result, length / 9 + 2);
+    while (i < length) {
+        Limb chunk = 0;
+        int count = 0;
+        for (; i < length && count < 9; i++, count++) {
+            if (digits[i] < '0' || digits[i] > '9') {
+                return false;
+            }
+            chunk = chunk * 10 + (Limb) (digits[i] - '0');
+        }
+        DoubleLimb accumulator = chunk;
+        uint32_t j;
+        for (j = 0; j < result->size; j++) {
+            accumulator += (DoubleLimb) result->limbs[j] * powers[count];
+            result->limbs[j] = (Limb) accumulator;
+            accumulator >>= LIMB_BITS;
+        }
+        if (accumulator) {
+            result->limbs[result->size++] = (Limb) accumulator;
+        }
+    }
+    result->negative = negative && result->size > 0;
+    return true;
+}
+
+bool bigIntIsZero(const BigInt *integer) {
+    return integer->size == 0;
+}
+
+bool bigIntFitsInt64(const BigInt *integer) {
+    if (integer->size <= 1) {
+        return true;
+    }
+    if (integer->size > 2) {
+        return false;
+    }
+    uint64_t magnitude = (uint64_t) integer->limbs[1] << LIMB_BITS | integer->limbs[0];
+    return integer->negative ? magnitude <= (uint64_t) 1 << 63 : magnitude < (uint64_t) 1 << 63;
+}
+
+int64_t bigIntToInt64(const BigInt *integer) {
+    uint64_t magnitude = 0;
+    if (integer->size > 0) {
+        magnitude = integer->limbs[0];
+    }
+    if (integer->size > 1) {
+        magnitude |= (uint64_t) integer->limbs[1] << LIMB_BITS;
+    }
+    return integer->negative ? (int64_t) (0 - magnitude) : (int64_t) magnitude;
+}
+
+size_t bigIntBitLength(const BigInt *integer) {
+    if (integer->size == 0) {
+        return 0;
+    }
+    return (size_t) integer->size * LIMB_BITS - countLeadingZeros(integer->limbs[integer->size - 1]);
+}
+
+bool bigIntTestBit(const BigInt *integer, size_t bit) {
+    size_t index = bit / LIMB_BITS;
+    return index < integer->size && (integer->limbs[index] >> (bit % LIMB_BITS) & 1);
+}
+
+size_t bigIntTrailingZeros(const BigInt *integer) {
+    size_t i;
+    for (i = 0; i < integer->size; i++) {
+        if (integer->limbs[i]) {
+            return i * LIMB_BITS + countTrailingZeros(integer->limbs[i]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * The 64 bits of the magnitude starting at bit.
+ */
+static uint64_t extractBits(const BigInt *integer, size_t bit) {
+    size_t index = bit / LIMB_BITS;
+    int shift = (int) (bit % LIMB_BITS);
+    uint64_t low = index < integer->size ? integer->limbs[index] : 0;
+    uint64_t middle = index + 1 < integer->size ? integer->limbs[index + 1] : 0;
+    uint64_t high = index + 2 < integer->size ? integer->limbs[index + 2] : 0;
+    uint64_t bits = (middle << LIMB_BITS | low) >> shift;
+    if (shift) {
+        bits |= high << (2 * LIMB_BITS - shift);
+    }
+    return bits;
+}
+
+double bigIntToDouble(const BigInt *integer) {
+    size_t length = bigIntBitLength(integer);
+    double value;
+    if (length <= 64) {
+        value = (double) extractBits(integer, 0);
+    } else {
+        // 64 bits plus a sticky bit round exactly like the whole magnitude.
+        size_t shift = length - 64;
+        uint64_t top = extractBits(integer, shift);
+        if (bigIntTrailingZeros(integer) < shift) {
+            top |= 1;
+        }
+        value = ldexp((double) top, shift > 4096 ? 4096 : (int) shift);
+    }
+    return integer->negative ? -value : value;
+}
+
+int bigIntCompareAbs(const BigInt *a, const BigInt *b) {
+    return compareLimbs(a->limbs, a->size, b->limbs, b->size);
+}
+
+int bigIntCompare(const BigInt *a, const BigInt *b) {
+    if (a->negative != b->negative) {
+        return a->negative ? -1 : 1;
+    }
+    int comparison = bigIntCompareAbs(a, b);
+    return a->negative ? -comparison : comparison;
+}
+
+void bigIntNegate(BigInt *result, const BigInt *integer) {
+    bigIntCopy(result, integer);
+    result->negative = result->size > 0 && !integer->negative;
+}
+
+void bigIntAbs(BigInt *result, const BigInt *integer) {
+    bigIntCopy(result, integer);
+    result->negative = false;
+}
+
+/**
+ * |result| = |a| + |b|, the sign is left to the caller.
+ */
+static void addMagnitudes(BigInt *result, const BigInt *a, const BigInt *b) {
+    if (a->size < b->size) {
+        const BigInt *swap = a;
+        a = b;
+        b = swap;
+    }
+    size_t na = a->size, nb = b->size;
+    bigIntReserve(result, na + 1);
+    Limb carry = addLimbs(result->limbs, a->limbs, na, b->limbs, nb);
+    result->limbs[na] = carry;
+    normalise(result, na + 1);
+}
+
+/**
+ * |result| = |a| - |b| where |a| >= |b|, the sign is left to the caller.
+ */
+static void subtractMagnitudes(BigInt *result, const BigInt *a, const BigInt *b) {
+    size_t na = a->size, nb = b->size;
+    bigIntReserve(result, na);
+    subtractLimbs(result->limbs, a->limbs, na, b->limbs, nb);
+    normalise(result, na);
+}
+
+/**
+ * result = a + (negateB ? -b : b).
+ */
+static void addSigned(BigInt *result, const BigInt *a, const BigInt *b, bool negateB) {
+    bool negativeA = a->negative, negativeB = b->negative != negateB;
+    if (b->size == 0) {
+        bigIntCopy(result, a);
+        return;
+    }
+    if (negativeA == negativeB) {
+        addMagnitudes(result, a, b);
+        result->negative = negativeA && result->size > 0;
+    } else if (bigIntCompareAbs(a, b) >= 0) {
+        subtractMagnitudes(result, a, b);
+        result->negative = negativeA && result->size > 0;
+    } else {
+        subtractMagnitudes(result, b, a);
+        result->negative = negativeB && result->size > 0;
+    }
+}
+
+void bigIntAdd(BigInt *result, const BigInt *a, const BigInt *b) {
+    addSigned(result, a, b, false);
+}
+
+void bigIntSubtract(BigInt *result, const BigInt *a, const BigInt *b) {
+    addSigned(result, a, b, true);
+}
+
+void bigIntMultiply(BigInt *result, const BigInt *a, const BigInt *b) {
+    if (a->size == 0 || b->size == 0) {
+        result->size = 0;
+        result->negative = false;
+        return;
+    }
+    bool negative = a->negative != b->negative;
+    if (b->size == 1 || a->size == 1) {
+        bool small = b->size == 1;
+        bigIntMultiplyLimb(result, small ? a : b, small ? b->limbs[0] : a->limbs[0]);
+        result->negative = negative;
+        return;
+    }
+    size_t size = (size_t) a->size + b->size;
+    BigInt product;
+    initBigInt(&product);
+    bigIntReserve(&product, size);
+    multiplyLimbs(product.limbs, a->limbs, a->size, b->limbs, b->size);
+    normalise(&product, size);
+    product.negative = negative;
+    bigIntMove(result, &product);
+}
+
+void bigIntAddLimb(BigInt *result, const BigInt *a, Limb value) {
+    BigInt limb = {&value, value ? 1 : 0, 0, false};
+    bigIntAdd(result, a, &limb);
+}
+
+void bigIntMultiplyLimb(BigInt *result, const BigInt *a, Limb value) {
+    size_t n = a->size;
+    bool negative = a->negative;
+    if (n == 0 || value == 0) {
+        result->size = 0;
+        result->negative = false;
+        return;
+    }
+    bigIntReserve(result, n + 1);
+    DoubleLimb carry = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        carry += (DoubleLimb) a->limbs[i] * value;
+        result->limbs[i] = (Limb) carry;
+        carry >>= LIMB_BITS;
+    }
+    result->limbs[n] = (Limb) carry;
+    result->negative = negative;
+    normalise(result, n + 1);
+}
+
+Limb bigIntDivideLimb(BigInt *quotient, const BigInt *a, Limb value) {
+    size_t n = a->size;
+    bool negative = a->negative;
+    if (quotient == NULL) {
+        return divideLimbsByLimb(NULL, a->limbs, n, value);
+    }
+    bigIntReserve(quotient, n);
+    Limb remainder = divideLimbsByLimb(quotient->limbs, a->limbs, n, value);
+    quotient->negative = negative;
+    normalise(quotient, n);
+    return remainder;
+}
+
+uint64_t bigIntModWord(const BigInt *a, uint64_t modulus) {
+    if (modulus >> LIMB_BITS == 0) {
+        return divideLimbsByLimb(NULL, a->limbs, a->size, (Limb) modulus);
+    }
+    // Horner over the limbs, remainder * 2^32 + limb reduced each step.
+    uint64_t remainder = 0;
+    size_t i = a->size;
+    while (i-- > 0) {
+#if defined(__SIZEOF_INT128__)
+        remainder = (uint64_t) (((unsigned __int128) remainder << LIMB_BITS | a->limbs[i]) % modulus);
+#else
+        int bit;
+        for (bit = 0; bit < LIMB_BITS; bit++) {
+            remainder = remainder >= modulus - remainder ? remainder - (modulus - remainder) : remainder + remainder;
+        }
+        uint64_t limb = a->limbs[i] % modulus;
+        remainder = remainder >= modulus - limb ? remainder - (modulus - limb) : remainder + limb;
+#endif
+    }
+    return remainder;
+}
+
+bool bigIntDivide(BigInt *quotient, BigInt *remainder, const BigInt *a, const BigInt *b) {
+    if (b->size == 0) {
+        return false;
+    }
+    bool negativeQuotient = a->negative != b->negative, negativeRemainder = a->negative;
+    if (bigIntCompareAbs(a, b) < 0) {
+        if (remainder != NULL) {
+            bigIntCopy(remainder, a);
+        }
+        if (quotient != NULL) {
+            quotient->size = 0;
+            quotient->negative = false;
+        }
+        return true;
+    }
+    size_t m = a->size, n = b->size;
+    BigInt q, r;
+    initBigInt(&q);
+    initBigInt(&r);
+    bigIntReserve(&q, m - n + 1);
+    if (n == 1) {
+        Limb rest = divideLimbsByLimb(q.limbs, a->limbs, m, b->limbs[0]);
+        bigIntSetUint64(&r, rest);
+    } else {
+        bigIntReserve(&r, n);
+        divideLimbs(q.limbs, remainder != NULL ? r.limbs : NULL, a->limbs, m, b->limbs, n);
+        normalise(&r, remainder != NULL ? n : 0);
+    }
+    normalise(&q, m - n + 1);
+    q.negative = negativeQuotient && q.size > 0;
+    r.negative = negativeRemainder && r.size > 0;
+    if (quotient != NULL) {
+        bigIntMove(quotient, &q);
+    }
+    if (remainder != NULL) {
+        bigIntMove(remainder, &r);
+    }
+    freeBigInt(&q);
+    freeBigInt(&r);
+    return true;
+}
+
+void bigIntDivideExact(BigInt *quotient, const BigInt *a, const BigInt *b) {
+    bigIntDivide(quotient, NULL, a, b);
+}
+
+void bigIntShiftLeft(BigInt *result, const BigInt *a, size_t bits) {
+    size_t n = a->size, limbShift = bits / LIMB_BITS, i;
+    int shift = (int) (bits % LIMB_BITS);
+    bool negative = a->negative;
+    if (n == 0) {
+        result->size = 0;
+        result->negative = false;
+        return;
+    }
+    bigIntReserve(result, n + limbShift + 1);
+    const Limb *source = a->limbs;
+    Limb *target = result->limbs;
+    // Top down, so shifting in place is safe.
+    target[n + limbShift] = (Limb) ((DoubleLimb) source[n - 1] >> (LIMB_BITS - shift));
+    for (i = n - 1; i > 0; i--) {
+        target[i + limbShift] = (Limb) (source[i] << shift | (DoubleLimb) source[i - 1] >> (LIMB_BITS - shift));
+    }
+    target[limbShift] = source[0] << shift;
+    memset(target, 0, sizeof(Limb) * limbShift);
+    result->negative = negative;
+    normalise(result, n + limbShift + 1);
+}
+
+void bigIntShiftRight(BigInt *result, const BigInt *a, size_t bits) {
+    size_t n = a->size, limbShift = bits / LIMB_BITS, i;
+    int shift = (int) (bits % LIMB_BITS);
+    bool negative = a->negative;
+    if (limbShift >= n) {
+        result->size = 0;
+        result->negative = false;
+        return;
+    }
+    size_t size = n - limbShift;
+    bigIntReserve(result, size);
+    const Limb *source = a->limbs;
+    Limb *target = result->limbs;
+    // Bottom up, so shifting in place is safe.
+    for (i = 0; i + 1 < size; i++) {
+        target[i] = (Limb) (source[i + limbShift] >> shift |
+                            (DoubleLimb) source[i + limbShift + 1] << (LIMB_BITS - shift));
+    }
+    target[size - 1] = source[n - 1] >> shift;
+    result->negative = negative;
+    normalise(result, size);
+}
+
+void bigIntPower(BigInt *result, const BigInt *base, uint64_t exponent) {
+    BigInt power, square;
+    initBigInt(&power);
+    initBigInt(&square);
+    bigIntSetUint64(&power, 1);
+    bigIntCopy(&square, base);
+    while (exponent) {
+        if (exponent & 1) {
+            bigIntMultiply(&power, &power, &square);
+        }
+        exponent >>= 1;
+        if (exponent) {
+            bigIntMultiply(&square, &square, &square);
+        }
+    }
+    bigIntMove(result, &power);
+    freeBigInt(&square);
+}
+
+static uint64_t gcdWord(uint64_t a, uint64_t b) {
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+#if defined(__GNUC__)
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    while (b) {
+        b >>= __builtin_ctzll(b);
+        if (a > b) {
+            uint64_t swap = a;
+            a = b;
+            b = swap;
+        }
+        b -= a;
+    }
+    return a << shift;
+#else
+    while (b) {
+        uint64_t rest = a % b;
+        a = b;
+        b = rest;
+    }
+    return a;
+#endif
+}
+
+/**
+ * result = |a x + b y| for word cofactors of opposite signs.
+ */
+static void linearCombination(BigInt *result, BigInt *scratch, const BigInt *x, int64_t a,
+                              const BigInt *y, int64_t b) {
+    bigIntMultiplyLimb(result, x, (Limb) (a < 0 ? -a : a));
+    bigIntMultiplyLimb(scratch, y, (Limb) (b < 0 ? -b : b));
+    bigIntSubtract(result, result, scratch);
+    result->negative = false;
+}
+
+void bigIntGcd(BigInt *result, const BigInt *a, const BigInt *b) {
+    BigInt x, y, rest, next, scratch;
+    initBigInt(&x);
+    initBigInt(&y);
+    initBigInt(&rest);
+    initBigInt(&next);
+    initBigInt(&scratch);
+    bigIntAbs(&x, a);
+    bigIntAbs(&y, b);
+    if (bigIntCompareAbs(&x, &y) < 0) {
+        bigIntSwap(&x, &y);
+    }
+    // Lehmer, run Euclid on the leading 32 bits and apply the
+    // accumulated cofactors once, until both fit a word.
+    while (y.size > 2) {
+        size_t shift = bigIntBitLength(&x) - LIMB_BITS;
+        int64_t high = (int64_t) (Limb) extractBits(&x, shift), low = (int64_t) (Limb) extractBits(&y, shift);
+        int64_t cofactorA = 1, cofactorB = 0, cofactorC = 0, cofactorD = 1;
+        while (low + cofactorC > 0 && low + cofactorD > 0) {
+            int64_t quotient = (high + cofactorA) / (low + cofactorC);
+            if (quotient != (high + cofactorB) / (low + cofactorD)) {
+                break;
+            }
+            int64_t swap = cofactorA - quotient * cofactorC;
+            cofactorA = cofactorC;
+            cofactorC = swap;
+            swap = cofactorB - quotient * cofactorD;
+            cofactorB = cofactorD;
+            cofactorD = swap;
+            swap = high - quotient * low;
+            high = low;
+            low = swap;
+        }
+        if (cofactorB == 0) { // No quotient was certain, take a full step.
+            bigIntDivide(NULL, &rest, &x, &y);
+            bigIntSwap(&x, &y);
+            bigIntSwap(&y, &rest);
+        } else {
+            linearCombination(&rest, &scratch, &x, cofactorA, &y, cofactorB);
+            linearCombination(&next, &scratch, &x, cofactorC, &y, cofactorD);
+            bigIntSwap(&x, &rest);
+            bigIntSwap(&y, &next);
+        }
+    }
+    if (y.size == 0) {
+        bigIntMove(result, &x);
+    } else {
+        uint64_t small = (uint64_t) bigIntToInt64(&y);
+        bigIntSetUint64(result, gcdWord(x.size > 2 ? bigIntModWord(&x, small) : (uint64_t) bigIntToInt64(&x), small));
+    }
+    freeBigInt(&x);
+    freeBigInt(&y);
+    freeBigInt(&rest);
+    freeBigInt(&next);
+    freeBigInt(&scratch);
+}
+
+size_t bigIntStringSize(const BigInt *integer) {
+    // A limb holds fewer than 10 decimal digits, plus the sign and terminator.
+    return (size_t) integer->size * 10 + 3;
+}
+
+char *bigIntToString(const BigInt *integer, char *buffer) {
+    char *ch = buffer;
+    if (integer->size == 0) {
+        strcpy(buffer, "0");
+        return buffer;
+    }
+    if (integer->negative) {
+        *ch++ = '-';
+    }
+    BigInt rest;
+    initBigInt(&rest);
+    bigIntAbs(&rest, integer);
+    // Peel nine digits at a time from the bottom, then reverse.
+    char *start = ch;
+    while (rest.size > 0) {
+        Limb chunk = bigIntDivideLimb(&rest, &rest, 1000000000u);
+        int i;
+        for (i = 0; i < 9 && (rest.size > 0 || chunk > 0); i++) {
+            *ch++ = (char) ('0' + chunk % 10);
+            chunk /= 10;
+        }
+    }
+    *ch = '\0';
+    char *end = ch - 1;
+    while (start < end) {
+        char swap = *start;
+        *start++ = *end;
+        *end-- = swap;
+    }
+    freeBigInt(&rest);
+    return buffer;
+}
+
+void printBigInt(const BigInt *integer, FILE *file) {
+    char small[64];
+    size_t size = bigIntStringSize(integer);
+    char *buffer = size <= sizeof(small) ? small : (char *) malloc(size);
+    fputs(bigIntToString(integer, buffer), file);
+    if (buffer != small) {
+        free(buffer);
+    }
+}
@@ -0,0 +1,150 @@
+//
+// Arbitrary precision integers on pooled limb storage.
+//
+
+#ifndef FLUXIONCORE_FLUXION_BIGINT_H
+#define FLUXIONCORE_FLUXION_BIGINT_H
+#include <stddef.h>
+#include <stdio.h>
+#include "commons.h"
+
+typedef uint32_t Limb;
+typedef uint64_t DoubleLimb;
+#define LIMB_BITS 32
+
+/**
+ * Allocate limbs from the pool, the capacity is rounded up to a size class.
+ * @param count Limbs needed.
+ * @param capacity Set to the limbs actually allocated.
+ * @return the limbs, uninitialised.
+ */
+Limb *limbAlloc(size_t count, uint32_t *capacity);
+/**
+ * Return limbs to the pool.
+ * @param limbs Limbs from limbAlloc, may be NULL.
+ * @param capacity Capacity limbAlloc returned.
+ */
+void limbFree(Limb *limbs, uint32_t capacity);
+/**
+ * Release the limbs the calling thread keeps cached. Worker threads call it
+ * before they end, the cache of a thread is not freed otherwise.
+ */
+void limbPoolTrim(void);
+
+/**
+ * A signed arbitrary precision integer, the magnitude
+ * is little endian and has no leading zero limbs.
+ * Zero has size 0 and is never negative.
+ */
+typedef struct {
+    Limb *limbs;
+    uint32_t size;
+    uint32_t capacity;
+    bool negative;
+} BigInt;
+
+/**
+ * Initialise a big integer to zero, nothing is allocated.
+ * @param integer Integer to initialise.
+ */
+void initBigInt(BigInt *integer);
+/**
+ * Free the limbs of a big integer, it is zero afterwards.
+ * @param integer Integer to free.
+ */
+void freeBigInt(BigInt *integer);
+void bigIntReserve(BigInt *integer, size_t count);
+
+void bigIntSetInt64(BigInt *result, int64_t value);
+void bigIntSetUint64(BigInt *result, uint64_t value);
+void bigIntCopy(BigInt *result, const BigInt *integer);
+/**
+ * Move an integer without copying its limbs, source is zero afterwards.
+ */
+void bigIntMove(BigInt *result, BigInt *source);
+void bigIntSwap(BigInt *a, BigInt *b);
+/**
+ * Parse decimal digits.
+ * @param result Integer to set.
+ * @param digits Start of the digits, an optional leading - is allowed.
+ * @param length Number of characters.
+ * @return false if a character is not a digit.
+ */
+bool bigIntSetDecimal(BigInt *result, const char *digits, size_t length);
+
+bool bigIntIsZero(const BigInt *integer);
+bool bigIntFitsInt64(const BigInt *integer);
+int64_t bigIntToInt64(const BigInt *integer);
+/**
+ * Convert to the nearest double, correctly rounded.
+ */
+double bigIntToDouble(const BigInt *integer);
+size_t bigIntBitLength(const BigInt *integer);
+/**
+ * Test a bit of the magnitude.
+ */
+bool bigIntTestBit(const BigInt *integer, size_t bit);
+/**
+ * Count the trailing zero bits of the magnitude, 0 for zero.
+ */
+size_t bigIntTrailingZeros(const BigInt *integer);
+
+int bigIntCompare(const BigInt *a, const BigInt *b);
+int bigIntCompareAbs(const BigInt *a, const BigInt *b);
+
+/*
+ * Arithmetic, the result may alias any operand.
+ */
+void bigIntNegate(BigInt *result, const BigInt *integer);
+void bigIntAbs(BigInt *result, const BigInt *integer);
+void bigIntAdd(BigInt *result, const BigInt *a, const BigInt *b);
+void bigIntSubtract(BigInt *result, const BigInt *a, const BigInt *b);
+/**
+ * Multiply, switching from schoolbook to Karatsuba for large operands.
+ */
+void bigIntMultiply(BigInt *result, const BigInt *a, const BigInt *b);
+void bigIntAddLimb(BigInt *result, const BigInt *a, Limb value);
+void bigIntMultiplyLimb(BigInt *result, const BigInt *a, Limb value);
+/**
+ * Divide by a limb, truncating towards zero.
+ * @return the remainder of the magnitude.
+ */
+Limb bigIntDivideLimb(BigInt *quotient, const BigInt *a, Limb value);
+/**
+ * Remainder of the magnitude by a word, quotient is not computed.
+ */
+uint64_t bigIntModWord(const BigInt *a, uint64_t modulus);
+/**
+ * Divide, truncating towards zero like C. Either output may be NULL.
+ * @return false on division by zero.
+ */
+bool bigIntDivide(BigInt *quotient, BigInt *remainder, const BigInt *a, const BigInt *b);
+/**
+ * Divide when a is known to be a multiple of b, the remainder is not kept.
+ */
+void bigIntDivideExact(BigInt *quotient, const BigInt *a, const BigInt *b);
+void bigIntShiftLeft(BigInt *result, const BigInt *a, size_t bits);
+/**
+ * Shift the magnitude right, truncating, the sign is kept.
+ */
+void bigIntShiftRight(BigInt *result, const BigInt *a, size_t bits);
+void bigIntPower(BigInt *result, const BigInt *base, uint64_t exponent);
+/**
+ * Greatest common divisor, always non negative.
+ */
+void bigIntGcd(BigInt *result, const BigInt *a, const BigInt *b);
+
+/**
+ * Number of characters bigIntToString needs, including the terminator.
+ */
+size_t bigIntStringSize(const BigInt *integer);
+/**
+ * Write the decimal representation.
+ * @param integer Integer to convert.
+ * @param buffer Buffer of at least bigIntStringSize characters.
+ * @return buffer.
+ */
+char *bigIntToString(const BigInt *integer, char *buffer);
+void printBigInt(const BigInt *integer, FILE *file);
+
+#endif //FLUXIONCORE_FLUXION_BIGINT_H
@@ -0,0 +1,307 @@
+//
+// Membership and enumeration of the sets builder tokens describe.
+//
+
+#include <math.h>
+#include <string.h>
+#include "fluxion_batch.h"
+#include "fluxion_builder.h"
+
+static const Token *unwrap(const Token *token) {
+    while (token != NULL && token->tokenType == EXPRESSION) {
+        token = ((const ExpressionToken *) token)->root;
+    }
+    return token;
+}
+
+static bool isVariable(const Token *token, const IdentifierToken *variable) {
+    token = unwrap(token);
+    return token != NULL && token->tokenType == IDENTIFIER &&
+           ((const IdentifierToken *) token)->identifierType == Variable &&
+           strcmp(((const IdentifierToken *) token)->name, variable->name) == 0;
+}
+
+/**
+ * Evaluate a tree of arithmetic on numbers.
+ * @return false if the tree refers to anything but numbers.
+ */
+static bool constantValue(const Token *token, double *value) {
+    token = unwrap(token);
+    if (token == NULL) {
+        return false;
+    }
+    if (token->tokenType == NUMBER) {
+        *value = ((const NumberToken *) token)->value;
+        return true;
+    }
+    if (token->tokenType != OPERATOR) {
+        return false;
+    }
+    const OperatorToken *operator = (const OperatorToken *) token;
+    double a = 0, b;
+    if (operator->left != NULL && !constantValue(operator->left, &a)) {
+        return false;
+    }
+    if (!constantValue(operator->right, &b)) {
+        return false;
+    }
+    switch (operator->operatorType) {
+        case PLUS:
+            *value = a + b;
+            return true;
+        case MINUS:
+            *value = a - b; // A prefix minus has no left operand, a is 0.
+            return true;
+        case MULTIPLY:
+            *value = a * b;
+            return true;
+        case DIVIDE:
+            *value = a / b;
+            return true;
+        case POWER:
+            *value = pow(a, b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static BuilderBounds unbounded(void) {
+    BuilderBounds bounds = {-INFINITY, INFINITY, false, false};
+    return bounds;
+}
+
+/**
+ * Narrow bounds to the ones both allow.
+ */
+static void intersectBounds(BuilderBounds *bounds, const BuilderBounds *other) {
+    if (other->lower > bounds->lower || (other->lower == bounds->lower && other->lowerStrict)) {
+        bounds->lower = other->lower;
+        bounds->lowerStrict = other->lowerStrict;
+    }
+    if (other->upper < bounds->upper || (other->upper == bounds->upper && other->upperStrict)) {
+        bounds->upper = other->upper;
+        bounds->upperStrict = other->upperStrict;
+    }
+}
+
+/**
+ * Widen bounds to cover the ones either allows.
+ */
+static void joinBounds(BuilderBounds *bounds, const BuilderBounds *other) {
+    if (other->lower < bounds->lower || (other->lower == bounds->lower && !other->lowerStrict)) {
+        bounds->lower = other->lower;
+        bounds->lowerStrict = other->lowerStrict;
+    }
+    if (other->upper > bounds->upper || (other->upper == bounds->upper && !other->upperStrict)) {
+        bounds->upper = other->upper;
+        bounds->upperStrict = other->upperStrict;
+    }
+}
+
+/**
+ * Bounds of variable operator constant.
+ */
+static BuilderBounds comparisonBounds(OperatorType operatorType, double constant) {
+    BuilderBounds bounds = unbounded();
+    if (isnan(constant)) {
+        return bounds;
+    }
+    switch (operatorType) {
+        case LESS:
+        case LEQ:
+            bounds.upper = constant;
+            bounds.upperStrict = operatorType == LESS;
+            break;
+        case GREATER:
+        case GEQ:
+            bounds.lower = constant;
+            bounds.lowerStrict = operatorType == GREATER;
+            break;
+        case EQUAL:
+            bounds.lower = bounds.upper = constant;
+            break;
+        default:
+            break;
+    }
+    return bounds;
+}
+
+static OperatorType mirrorComparison(OperatorType operatorType) {
+    switch (operatorType) {
+        case LESS:
+            return GREATER;
+        case GREATER:
+            return LESS;
+        case LEQ:
+            return GEQ;
+        case GEQ:
+            return LEQ;
+        default:
+            return operatorType;
+    }
+}
+
+/**
+ * Find the interval a constraint keeps its variable in. Anything but
+ * comparisons with constants and their conjunctions and disjunctions is
+ * taken to allow every value.
+ */
+static BuilderBounds findBounds(const Token *token, const IdentifierToken *variable) {
+    token = unwrap(token);
+    BuilderBounds bounds = unbounded();
+    if (token == NULL || token->tokenType != OPERATOR) {
+        return bounds;
+    }
+    const OperatorToken *operator = (const OperatorToken *) token;
+    if (operator->left == NULL || operator->right == NULL) {
+        return bounds;
+    }
+    double constant;
+    switch (operator->operatorType) {
+        case AMPERSAND: {
+            BuilderBounds right = findBounds(operator->right, variable);
+            bounds = findBounds(operator->left, variable);
+            intersectBounds(&bounds, &right);
+            return bounds;
+        }
+        case BAR: {
+            BuilderBounds right = findBounds(operator->right, variable);
+            bounds = findBounds(operator->left, variable);
+            joinBounds(&bounds, &right);
+            return bounds;
+        }
+        case LESS:
+        case GREATER:
+        case LEQ:
+        case GEQ:
+        case EQUAL:
+            if (isVariable(operator->left, variable) && constantValue(operator->right, &constant)) {
+                return comparisonBounds(operator->operatorType, constant);
+            }
+            if (isVariable(operator->right, variable) && constantValue(operator->left, &constant)) {
+                return comparisonBounds(mirrorComparison(operator->operatorType), constant);
+            }
+            return bounds;
+        default:
+            return bounds;
+    }
+}
+
+static bool withinBounds(const BuilderBounds *bounds, double value) {
+    return (value > bounds->lower || (value == bounds->lower && !bounds->lowerStrict)) &&
+           (value < bounds->upper || (value == bounds->upper && !bounds->upperStrict));
+}
+
+static bool isTrue(double value) {
+    return value != 0 && !isnan(value);
+}
+
+BuilderPredicate *initBuilderPredicate(const BuilderToken *builder) {
+    const char *names[] = {builder->variable->name};
+    Program *program = compileExpression((const Token *) builder->constraint, names, 1);
+    if (program == NULL) {
+        return NULL;
+    }
+    BuilderPredicate *predicate = (BuilderPredicate *) malloc(sizeof(BuilderPredicate));
+    predicate->program = program;
+    predicate->bounds = findBounds((const Token *) builder->constraint, builder->variable);
+    return predicate;
+}
+
+void freeBuilderPredicate(BuilderPredicate *predicate) {
+    if (predicate == NULL) {
+        return;
+    }
+    freeProgram(predicate->program);
+    free(predicate);
+}
+
+bool builderContains(const BuilderPredicate *predicate, double value) {
+    return withinBounds(&predicate->bounds, value) && isTrue(runProgram(predicate->program, &value));
+}
+
+bool builderIntegerRange(const BuilderPredicate *predicate, int64_t *first, int64_t *last) {
+    const BuilderBounds *bounds = &predicate->bounds;
+    double lower = bounds->lowerStrict ? floor(bounds->lower) + 1 : ceil(bounds->lower);
+    double upper = bounds->upperStrict ? ceil(bounds->upper) - 1 : floor(bounds->upper);
+    lower = fmax(lower, (double) -BUILDER_MAX_INTEGER);
+    upper = fmin(upper, (double) BUILDER_MAX_INTEGER);
+    if (!(lower <= upper)) {
+        return false;
+    }
+    *first = (int64_t) lower;
+    *last = (int64_t) upper;
+    return true;
+}
+
+void initBuilderStream(BuilderStream *stream, const BuilderPredicate *predicate, int64_t first, int64_t last,
+                       int threadCount) {
+    int64_t low, high;
+    stream->predicate = predicate;
+    stream->threadCount = threadCount;
+    stream->candidates = NULL;
+    stream->results = NULL;
+    stream->chunkSize = 0;
+    stream->chunkCount = 0;
+    stream->chunkPosition = 0;
+    if (!builderIntegerRange(predicate, &low, &high)) { // Nothing to evaluate.
+        stream->next = 1;
+        stream->last = 0;
+        return;
+    }
+    stream->next = first > low ? first : low;
+    stream->last = last < high ? last : high;
+}
+
+void freeBuilderStream(BuilderStream *stream) {
+    free(stream->candidates);
+    free(stream->results);
+    stream->candidates = NULL;
+    stream->results = NULL;
+}
+
+/**
+ * Evaluate the next chunk of candidates, twice as many as the last one up to BUILDER_MAX_CHUNK.
+ * @return false if the domain is exhausted.
+ */
+static bool refillStream(BuilderStream *stream) {
+    if (stream->next > stream->last) {
+        return false;
+    }
+    size_t size = stream->chunkSize ? stream->chunkSize * 2 : BUILDER_FIRST_CHUNK;
+    size = size < BUILDER_MAX_CHUNK ? size : BUILDER_MAX_CHUNK;
+    if (size != stream->chunkSize) {
+        stream->candidates = (double *) realloc(stream->candidates, sizeof(double) * size);
+        stream->results = (double *) realloc(stream->results, sizeof(double) * size);
+        stream->chunkSize = size;
+    }
+    uint64_t remaining = (uint64_t) (stream->last - stream->next) + 1;
+    size_t i, count = remaining < size ? (size_t) remaining : size;
+    for (i = 0; i < count; i++) {
+        stream->candidates[i] = (double) (stream->next + (int64_t) i);
+    }
+    const double *columns[] = {stream->candidates};
+    runProgramBatch(stream->predicate->program, columns, count, stream->results, stream->threadCount);
+    stream->next += (int64_t) count;
+    stream->chunkCount = count;
+    stream->chunkPosition = 0;
+    return true;
+}
+
+size_t streamBuilderMembers(BuilderStream *stream, int64_t *members, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        if (stream->chunkPosition == stream->chunkCount && !refillStream(stream)) {
+            break;
+        }
+        size_t i;
+        for (i = stream->chunkPosition; i < stream->chunkCount && written < count; i++) {
+            if (isTrue(stream->results[i])) {
+                members[written++] = (int64_t) stream->candidates[i];
+            }
+        }
+        stream->chunkPosition = i;
+    }
+    return written;
+}
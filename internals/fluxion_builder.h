@@ -0,0 +1,94 @@
+//
+// Membership and enumeration of the sets builder tokens describe.
+//
+
+#ifndef FLUXIONCORE_FLUXION_BUILDER_H
+#define FLUXIONCORE_FLUXION_BUILDER_H
+#include <stddef.h>
+#include "fluxion_token.h"
+#include "fluxion_vm.h"
+
+#define BUILDER_MAX_INTEGER ((int64_t) 1 << 53) // Candidates stay where doubles hold every integer.
+#define BUILDER_FIRST_CHUNK 1024 // Candidates a stream evaluates first, doubling on every refill.
+#define BUILDER_MAX_CHUNK ((size_t) 1 << 20)
+
+/**
+ * Interval a constraint confines its variable to, found from comparisons
+ * of the variable with constants joined by & and |.
+ */
+typedef struct {
+    double lower; // -INFINITY when there is no lower bound.
+    double upper; // INFINITY when there is no upper bound.
+    bool lowerStrict;
+    bool upperStrict;
+} BuilderBounds;
+
+/**
+ * The constraint of a builder compiled once, so membership costs an evaluation.
+ */
+typedef struct {
+    Program *program; // Constraint of the variable, nonzero for members.
+    BuilderBounds bounds; // Values outside are rejected without evaluating.
+} BuilderPredicate;
+
+/**
+ * Compile the constraint of a builder.
+ * @param builder Builder to compile, the predicate does not refer to it afterwards.
+ * @return the predicate, NULL after issuing an error if the constraint can not be evaluated numerically.
+ */
+BuilderPredicate *initBuilderPredicate(const BuilderToken *builder);
+void freeBuilderPredicate(BuilderPredicate *predicate);
+/**
+ * Whether a value satisfies the constraint, what x in {x | ...} is.
+ * @param predicate Predicate of the builder.
+ * @param value Value to test.
+ */
+bool builderContains(const BuilderPredicate *predicate, double value);
+/**
+ * Get the integers the bounds of the constraint allow, within BUILDER_MAX_INTEGER.
+ * @param predicate Predicate of the builder.
+ * @param first Set to the least integer allowed.
+ * @param last Set to the greatest integer allowed.
+ * @return false if no integer is allowed.
+ */
+bool builderIntegerRange(const BuilderPredicate *predicate, int64_t *first, int64_t *last);
+
+/**
+ * Integer members of a builder enumerated lazily, a chunk of candidates at a
+ * time. Each chunk is evaluated with runProgramBatch, so long streams are
+ * split across threads, and chunks grow as the stream is consumed.
+ */
+typedef struct {
+    const BuilderPredicate *predicate;
+    int64_t next; // Next candidate to evaluate.
+    int64_t last; // Last candidate of the domain.
+    int threadCount;
+    double *candidates;
+    double *results;
+    size_t chunkSize; // Capacity of candidates and results.
+    size_t chunkCount; // Candidates in the current chunk.
+    size_t chunkPosition; // Next result of the current chunk to hand out.
+} BuilderStream;
+
+/**
+ * Start enumerating the integers in [first, last] that are members,
+ * narrowed to the bounds of the constraint before anything is evaluated.
+ * @param stream Stream to initialise.
+ * @param predicate Predicate of the builder, must outlive the stream.
+ * @param first Least candidate.
+ * @param last Greatest candidate.
+ * @param threadCount Most threads to evaluate a chunk with, 0 for one per processor.
+ */
+void initBuilderStream(BuilderStream *stream, const BuilderPredicate *predicate, int64_t first, int64_t last,
+                       int threadCount);
+void freeBuilderStream(BuilderStream *stream);
+/**
+ * Write the next members in increasing order.
+ * @param stream Stream to continue.
+ * @param members Receives up to count members.
+ * @param count Number of members wanted.
+ * @return the number written, less than count only once the domain is exhausted.
+ */
+size_t streamBuilderMembers(BuilderStream *stream, int64_t *members, size_t count);
+
+#endif //FLUXIONCORE_FLUXION_BUILDER_H
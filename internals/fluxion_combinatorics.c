@@ -0,0 +1,438 @@
+//
+// Factorials, binomials and multinomials, exact and modulo a word.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "fluxion_combinatorics.h"
+#include "fluxion_modular.h"
+
+#define PRODUCT_LEAF 16 // Words multiplied one at a time, larger products are split in halves.
+#define SMALL_FACTORIAL 20 // 20! is the largest factorial in 64 bits.
+#define BINOMIAL_RANGE_RATIO 64 // Binomials with k up to n / ratio are a quotient of products rather than sieved.
+
+FactorialCache *initFactorialCache(uint32_t capacity) {
+    FactorialCache *cache = (FactorialCache *) calloc(1, sizeof(FactorialCache));
+    cache->capacity = capacity ? capacity : 1;
+    cache->entries = (FactorialEntry *) malloc(sizeof(FactorialEntry) * cache->capacity);
+    return cache;
+}
+
+void freeFactorialCache(FactorialCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    uint32_t i;
+    for (i = 0; i < cache->count; i++) {
+        freeBigInt(&cache->entries[i].value);
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+/**
+ * The primes up to a bound, by the sieve of Eratosthenes over odd numbers.
+ * @param count Set to the number of primes.
+ * @return the primes, to free.
+ */
+static uint32_t *sievePrimes(uint32_t bound, uint32_t *count) {
+    uint32_t half = bound / 2 + 1, i, j; // Index i stands for 2 i + 1.
+    uint8_t *composite = (uint8_t *) calloc(half, 1);
+    uint32_t *primes = (uint32_t *) malloc(sizeof(uint32_t) * (bound < 16 ? 8 : bound / 3 + 8));
+    *count = 0;
+    if (bound >= 2) {
+        primes[(*count)++] = 2;
+    }
+    for (i = 1; 2 * i + 1 <= bound; i++) {
+        if (composite[i]) {
+            continue;
+        }
+        uint64_t prime = 2 * i + 1;
+        primes[(*count)++] = (uint32_t) prime;
+        for (j = (uint32_t) (prime * prime / 2); prime * prime <= bound && j < half; j += (uint32_t) prime) {
+            composite[j] = 1;
+        }
+    }
+    free(composite);
+    return primes;
+}
+
+/**
+ * Factors of a product, packed so that each word is as full as 32 bits allow.
+ */
+typedef struct {
+    Limb *words;
+    size_t count;
+    size_t capacity;
+} FactorList;
+
+static void pushFactor(FactorList *list, Limb factor) {
+    if (list->count > 0 && (DoubleLimb) list->words[list->count - 1] * factor <= UINT32_MAX) {
+        list->words[list->count - 1] *= factor;
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->words = (Limb *) realloc(list->words, sizeof(Limb) * list->capacity);
+    }
+    list->words[list->count++] = factor;
+}
+
+static void pushPrimePower(FactorList *list, Limb prime, uint64_t exponent) {
+    for (; exponent > 0; exponent--) {
+        pushFactor(list, prime);
+    }
+}
+
+/**
+ * Product of words by binary splitting, so Karatsuba multiplies operands of about the same size.
+ */
+static void productOfWords(BigInt *result, const Limb *words, size_t count) {
+    size_t i;
+    if (count <= PRODUCT_LEAF) {
+        bigIntSetUint64(result, 1);
+        for (i = 0; i < count; i++) {
+            bigIntMultiplyLimb(result, result, words[i]);
+        }
+        return;
+    }
+    BigInt right;
+    initBigInt(&right);
+    productOfWords(result, words, count / 2);
+    productOfWords(&right, words + count / 2, count - count / 2);
+    bigIntMultiply(result, result, &right);
+    freeBigInt(&right);
+}
+
+static void productOfList(BigInt *result, FactorList *list) {
+    productOfWords(result, list->words, list->count);
+    free(list->words);
+    memset(list, 0, sizeof(FactorList));
+}
+
+/**
+ * Product of the integers from begin to end inclusive. Factors of 2^32 and
+ * above do not fit a word, so those ranges are split in halves instead.
+ */
+static void productOfRange(BigInt *result, uint64_t begin, uint64_t end) {
+    FactorList list = {NULL, 0, 0};
+    uint64_t i;
+    if (end > UINT32_MAX && end - begin >= PRODUCT_LEAF) {
+        uint64_t middle = begin + (end - begin) / 2;
+        BigInt right;
+        initBigInt(&right);
+        productOfRange(result, begin, middle);
+        productOfRange(&right, middle + 1, end);
+        bigIntMultiply(result, result, &right);
+        freeBigInt(&right);
+        return;
+    }
+    if (end > UINT32_MAX) {
+        BigInt factor;
+        initBigInt(&factor);
+        bigIntSetUint64(result, 1);
+        for (i = 0; i <= end - begin; i++) { // Counted from begin, end may be UINT64_MAX.
+            bigIntSetUint64(&factor, begin + i);
+            bigIntMultiply(result, result, &factor);
+        }
+        freeBigInt(&factor);
+        return;
+    }
+    for (i = begin; i <= end; i++) {
+        pushFactor(&list, (Limb) i);
+    }
+    productOfList(result, &list);
+}
+
+/**
+ * Odd part of the swing n! / (n/2)!^2, each odd prime p to the number of odd
+ * quotients n / p^i, primes past n / 2 once and those in (n / 3, n / 2] never.
+ */
+static void oddSwing(BigInt *result, uint64_t n, const uint32_t *primes, uint32_t primeCount) {
+    FactorList list = {NULL, 0, 0};
+    uint32_t i;
+    for (i = 1; i < primeCount && primes[i] <= n; i++) {
+        uint64_t quotient = n, exponent = 0;
+        while (quotient >= primes[i]) {
+            quotient /= primes[i];
+            exponent += quotient & 1;
+        }
+        pushPrimePower(&list, primes[i], exponent);
+    }
+    productOfList(result, &list);
+}
+
+/**
+ * Odd part of n!, the odd part of (n/2)! squared times that of the swing.
+ */
+static void oddFactorial(BigInt *result, uint64_t n, const uint32_t *primes, uint32_t primeCount) {
+    if (n <= SMALL_FACTORIAL) {
+        uint64_t factorial = 1, i;
+        for (i = 2; i <= n; i++) {
+            factorial *= i;
+        }
+        bigIntSetUint64(result, factorial >> __builtin_ctzll(factorial));
+        return;
+    }
+    BigInt swing;
+    initBigInt(&swing);
+    oddFactorial(result, n / 2, primes, primeCount);
+    bigIntMultiply(result, result, result);
+    oddSwing(&swing, n, primes, primeCount);
+    bigIntMultiply(result, result, &swing);
+    freeBigInt(&swing);
+}
+
+/**
+ * n! by the prime swing algorithm, without a cache.
+ */
+static void primeSwingFactorial(BigInt *result, uint64_t n) {
+    uint32_t primeCount;
+    uint32_t *primes = sievePrimes((uint32_t) n, &primeCount);
+    oddFactorial(result, n, primes, primeCount);
+    bigIntShiftLeft(result, result, n - (uint64_t) __builtin_popcountll(n)); // Legendre's formula for 2.
+    free(primes);
+}
+
+/**
+ * The cached factorial of n, or the largest one close enough below n to extend.
+ * @return the entry, NULL if there is none.
+ */
+static FactorialEntry *findFactorial(FactorialCache *cache, uint64_t n) {
+    FactorialEntry *best = NULL;
+    uint32_t i;
+    for (i = 0; i < cache->count; i++) {
+        FactorialEntry *entry = cache->entries + i;
+        if (entry->n == n) {
+            return entry;
+        }
+        if (entry->n < n && n - entry->n <= n / FACTORIAL_CACHE_REACH && (best == NULL || entry->n > best->n)) {
+            best = entry;
+        }
+    }
+    return best;
+}
+
+static void keepFactorial(FactorialCache *cache, uint64_t n, const BigInt *value) {
+    FactorialEntry *entry;
+    if (cache->count < cache->capacity) {
+        entry = cache->entries + cache->count++;
+        initBigInt(&entry->value);
+    } else {
+        entry = cache->entries + cache->next;
+        cache->next = (cache->next + 1) % cache->capacity;
+    }
+    entry->n = n;
+    bigIntCopy(&entry->value, value);
+}
+
+bool bigIntFactorial(BigInt *result, uint64_t n, FactorialCache *cache) {
+    if (n > COMBINATORICS_MAX_N) {
+        return false;
+    }
+    FactorialEntry *entry = cache != NULL && n > SMALL_FACTORIAL ? findFactorial(cache, n) : NULL;
+    if (entry != NULL && entry->n == n) {
+        cache->hits++;
+        bigIntCopy(result, &entry->value);
+        return true;
+    }
+    if (entry != NULL) {
+        BigInt range;
+        initBigInt(&range);
+        productOfRange(&range, entry->n + 1, n);
+        bigIntMultiply(result, &entry->value, &range);
+        freeBigInt(&range);
+        cache->extensions++;
+    } else {
+        primeSwingFactorial(result, n);
+    }
+    if (cache != NULL && n > SMALL_FACTORIAL) {
+        keepFactorial(cache, n, result);
+    }
+    return true;
+}
+
+bool bigIntBinomial(BigInt *result, uint64_t n, uint64_t k) {
+    if (k > n) {
+        bigIntSetUint64(result, 0);
+        return true;
+    }
+    if (k > n - k) {
+        k = n - k;
+    }
+    if (k == 0) {
+        bigIntSetUint64(result, 1);
+        return true;
+    }
+    if (n > COMBINATORICS_MAX_N || k <= n / BINOMIAL_RANGE_RATIO) { // n (n - 1) ... (n - k + 1) / k!.
+        if (k > COMBINATORICS_MAX_N) {
+            return false;
+        }
+        BigInt factorial;
+        initBigInt(&factorial);
+        productOfRange(result, n - k + 1, n);
+        bigIntFactorial(&factorial, k, NULL);
+        bigIntDivideExact(result, result, &factorial);
+        freeBigInt(&factorial);
+        return true;
+    }
+    FactorList list = {NULL, 0, 0};
+    uint32_t primeCount, i;
+    uint32_t *primes = sievePrimes((uint32_t) n, &primeCount);
+    for (i = 0; i < primeCount; i++) { // Kummer's theorem, the borrows of n - k in base p.
+        uint64_t a = n, b = k, c = n - k, exponent = 0;
+        while (a > 0) {
+            a /= primes[i];
+            b /= primes[i];
+            c /= primes[i];
+            exponent += a - b - c;
+        }
+        pushPrimePower(&list, primes[i], exponent);
+    }
+    productOfList(result, &list);
+    free(primes);
+    return true;
+}
+
+/**
+ * Exponent of a prime in m!, by Legendre's formula.
+ */
+static uint64_t legendre(uint64_t m, uint64_t prime) {
+    uint64_t exponent = 0;
+    while (m > 0) {
+        m /= prime;
+        exponent += m;
+    }
+    return exponent;
+}
+
+bool bigIntMultinomial(BigInt *result, const uint64_t *counts, size_t count) {
+    uint64_t n = 0;
+    size_t j;
+    for (j = 0; j < count; j++) {
+        if (counts[j] > COMBINATORICS_MAX_N - n) {
+            return false;
+        }
+        n += counts[j];
+    }
+    FactorList list = {NULL, 0, 0};
+    uint32_t primeCount, i;
+    uint32_t *primes = sievePrimes((uint32_t) n, &primeCount);
+    for (i = 0; i < primeCount; i++) {
+        uint64_t exponent = legendre(n, primes[i]);
+        for (j = 0; j < count; j++) {
+            exponent -= legendre(counts[j], primes[i]);
+        }
+        pushPrimePower(&list, primes[i], exponent);
+    }
+    productOfList(result, &list);
+    free(primes);
+    return true;
+}
+
+bool factorialModulo(uint64_t n, uint64_t modulus, uint64_t *result) {
+    if (modulus == 0) {
+        return false;
+    }
+    if (n >= modulus) { // The modulus is one of the factors.
+        *result = 0;
+        return true;
+    }
+    uint64_t product = 1 % modulus, i;
+    bool wilson = modulus - 1 - n < n && wordIsPrime(modulus);
+    if ((wilson ? modulus - 1 - n : n) > COMBINATORICS_MAX_N) {
+        return false;
+    }
+    if (wilson) { // n! = -1 / ((n + 1) ... (p - 1)).
+        for (i = n + 1; i < modulus; i++) {
+            product = multiplyModulo(product, i, modulus);
+        }
+        inverseModulo(product, modulus, &product);
+        *result = product ? modulus - product : 0;
+        return true;
+    }
+    for (i = 2; i <= n; i++) {
+        product = multiplyModulo(product, i, modulus);
+    }
+    *result = product;
+    return true;
+}
+
+/**
+ * a choose b modulo a prime above a, as a quotient of products of min(b, a - b) factors.
+ */
+static bool smallBinomialModulo(uint64_t a, uint64_t b, uint64_t prime, uint64_t *result) {
+    uint64_t numerator = 1, denominator = 1, i;
+    if (b > a - b) {
+        b = a - b;
+    }
+    if (b > COMBINATORICS_MAX_N) {
+        return false;
+    }
+    for (i = 0; i < b; i++) {
+        numerator = multiplyModulo(numerator, a - i, prime);
+        denominator = multiplyModulo(denominator, i + 1, prime);
+    }
+    inverseModulo(denominator, prime, &denominator);
+    *result = multiplyModulo(numerator, denominator, prime);
+    return true;
+}
+
+bool binomialModulo(uint64_t n, uint64_t k, uint64_t modulus, uint64_t *result) {
+    if (modulus == 0) {
+        return false;
+    }
+    if (k > n) {
+        *result = 0;
+        return true;
+    }
+    if (wordIsPrime(modulus)) { // Lucas, the product of the binomials of the digits.
+        uint64_t product = 1 % modulus, digit;
+        while (n > 0 && product != 0) {
+            if (k % modulus > n % modulus) {
+                product = 0;
+                break;
+            }
+            if (!smallBinomialModulo(n % modulus, k % modulus, modulus, &digit)) {
+                return false;
+            }
+            product = multiplyModulo(product, digit, modulus);
+            n /= modulus;
+            k /= modulus;
+        }
+        *result = product;
+        return true;
+    }
+    if (n > COMBINATORICS_MAX_N) {
+        return false;
+    }
+    uint32_t primeCount, i;
+    uint32_t *primes = sievePrimes((uint32_t) n, &primeCount);
+    uint64_t product = 1 % modulus;
+    for (i = 0; i < primeCount; i++) {
+        uint64_t exponent = legendre(n, primes[i]) - legendre(k, primes[i]) - legendre(n - k, primes[i]);
+        if (exponent > 0) {
+            product = multiplyModulo(product, powerModulo(primes[i] % modulus, exponent, modulus), modulus);
+        }
+    }
+    free(primes);
+    *result = product;
+    return true;
+}
+
+Number numberFactorial(Number number, FactorialCache *cache) {
+    if (numberIsError(number)) {
+        return number;
+    }
+    NumberKind kind = numberKind(number);
+    if (kind == NUMBER_RATIONAL || kind == NUMBER_FLOAT || numberSign(number) < 0) {
+        return numberError(Undefined);
+    }
+    if (kind == NUMBER_BIG || (uint64_t) numberSmallValue(number) > COMBINATORICS_MAX_N) {
+        return numberError(Overflow);
+    }
+    BigInt factorial;
+    initBigInt(&factorial);
+    bigIntFactorial(&factorial, (uint64_t) numberSmallValue(number), cache);
+    return numberFromBigInt(&factorial);
+}
@@ -0,0 +1,83 @@
+//
+// Factorials, binomials and multinomials, exact and modulo a word.
+//
+
+#ifndef FLUXIONCORE_FLUXION_COMBINATORICS_H
+#define FLUXIONCORE_FLUXION_COMBINATORICS_H
+#include "fluxion_bigint.h"
+#include "fluxion_number.h"
+
+#define COMBINATORICS_MAX_N (1u << 24) // Largest n sieved for, its factorial has 380 million bits.
+#define FACTORIAL_CACHE_REACH 4 // A cached m! is extended to n! when n - m is at most n / FACTORIAL_CACHE_REACH.
+
+typedef struct {
+    uint64_t n;
+    BigInt value;
+} FactorialEntry;
+
+/**
+ * Factorials computed before, kept to be returned again or extended to a
+ * nearby larger n by the product of the integers in between, which costs a
+ * fraction of computing it anew. Once full, entries are replaced in turn.
+ */
+typedef struct {
+    FactorialEntry *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t next; // Entry replaced next once full.
+    // Counters for profiling.
+    uint64_t hits; // Factorials found as they are.
+    uint64_t extensions; // Factorials extended from a smaller one.
+} FactorialCache;
+
+/**
+ * @param capacity Most factorials kept.
+ */
+FactorialCache *initFactorialCache(uint32_t capacity);
+void freeFactorialCache(FactorialCache *cache);
+
+/**
+ * n! by the prime swing algorithm, n! = (n/2)!^2 swing(n), where the swing is
+ * a product of prime powers found from the digits of n in each prime base,
+ * multiplied by binary splitting so the large products are of balanced operands.
+ * Powers of 2 are left out and shifted in at the end.
+ * @param cache Factorials to reuse and keep the result in, may be NULL.
+ * @return false if n is above COMBINATORICS_MAX_N.
+ */
+bool bigIntFactorial(BigInt *result, uint64_t n, FactorialCache *cache);
+/**
+ * The binomial coefficient n choose k, 0 for k > n. The exponent of each
+ * prime is the number of borrows subtracting k from n in its base, or for
+ * a k small next to n it is the product of k integers divided by k!.
+ * @return false if both n and the smaller of k and n - k are above COMBINATORICS_MAX_N.
+ */
+bool bigIntBinomial(BigInt *result, uint64_t n, uint64_t k);
+/**
+ * The multinomial coefficient (k_1 + ... + k_m)! / (k_1! ... k_m!), from the
+ * exponents of the primes by Legendre's formula.
+ * @return false if the sum is above COMBINATORICS_MAX_N.
+ */
+bool bigIntMultinomial(BigInt *result, const uint64_t *counts, size_t count);
+
+/**
+ * n! modulo a word, 0 when n reaches it. For a prime modulus and n past its
+ * half, Wilson's theorem (p - 1)! = -1 leaves the product from n + 1 to p - 1.
+ * @return false if that takes more than COMBINATORICS_MAX_N multiplications.
+ */
+bool factorialModulo(uint64_t n, uint64_t modulus, uint64_t *result);
+/**
+ * n choose k modulo a word, digit by digit with Lucas' theorem for a prime modulus,
+ * from the exponents of the primes otherwise.
+ * @return false if a digit or, for a composite modulus, n is too large.
+ */
+bool binomialModulo(uint64_t n, uint64_t k, uint64_t modulus, uint64_t *result);
+
+/**
+ * Factorial of an exact number.
+ * @param number Borrowed.
+ * @param cache Factorials to reuse, may be NULL.
+ * @return n!, Undefined for negative or fractional numbers, Overflow above COMBINATORICS_MAX_N.
+ */
+Number numberFactorial(Number number, FactorialCache *cache);
+
+#endif //FLUXIONCORE_FLUXION_COMBINATORICS_H
@@ -0,0 +1,382 @@
+//
+// Symbolic differentiation of expression nodes.
+//
+
+#include <stdlib.h>
+#include "fluxion_diff.h"
+
+static bool isNumberNode(const NodePool *pool, NodeId node) {
+    return node != NODE_NONE && nodeTag(pool, node) == NODE_NUMBER && !numberIsError(nodeNumberOf(pool, node));
+}
+
+static bool isZero(const NodePool *pool, NodeId node) {
+    return isNumberNode(pool, node) && numberIsZero(nodeNumberOf(pool, node));
+}
+
+static bool isOne(const NodePool *pool, NodeId node) {
+    return isNumberNode(pool, node) && numberCompare(nodeNumberOf(pool, node), numberFromSmall(1)) == 0;
+}
+
+static bool isNegation(const NodePool *pool, NodeId node) {
+    return node != NODE_NONE && nodeTag(pool, node) == MINUS && nodeChildCount(pool, node) == 1;
+}
+
+/**
+ * Node of a folded number.
+ * @return the node, NODE_NONE if folding gave an error, so the expression is kept as it is.
+ */
+static NodeId foldNumber(NodePool *pool, int lineCount, Number number) {
+    if (numberIsError(number)) {
+        return NODE_NONE;
+    }
+    return nodeExactNumber(pool, lineCount, number);
+}
+
+static NodeId makeNumber(NodePool *pool, int lineCount, int64_t value) {
+    return nodeExactNumber(pool, lineCount, numberFromSmall(value));
+}
+
+/**
+ * Split a term into its numeric coefficient and the rest, 3 * x is 3 and x.
+ */
+static Number termCoefficient(const NodePool *pool, NodeId node, NodeId *rest) {
+    if (nodeTag(pool, node) == MULTIPLY && nodeChildCount(pool, node) == 2 && isNumberNode(pool, nodeChild(pool, node, 0))) {
+        *rest = nodeChild(pool, node, 1);
+        return nodeNumberOf(pool, nodeChild(pool, node, 0));
+    }
+    *rest = node;
+    return numberFromSmall(1);
+}
+
+static NodeId makeProduct(NodePool *pool, int lineCount, NodeId a, NodeId b);
+static NodeId makePower(NodePool *pool, int lineCount, NodeId a, NodeId b);
+
+static NodeId makeNegation(NodePool *pool, int lineCount, NodeId a) {
+    if (a == NODE_NONE) {
+        return NODE_NONE;
+    }
+    if (isNumberNode(pool, a)) {
+        return foldNumber(pool, lineCount, numberNegate(nodeNumberOf(pool, a)));
+    }
+    if (isNegation(pool, a)) {
+        return nodeChild(pool, a, 0);
+    }
+    if (nodeTag(pool, a) == MINUS) {
+        return nodeBinary(pool, lineCount, MINUS, nodeChild(pool, a, 1), nodeChild(pool, a, 0));
+    }
+    NodeId rest;
+    Number coefficient = termCoefficient(pool, a, &rest);
+    if (rest != a) {
+        return makeProduct(pool, lineCount, foldNumber(pool, lineCount, numberNegate(coefficient)), rest);
+    }
+    return nodeUnary(pool, lineCount, MINUS, a);
+}
+
+/**
+ * a + b or a - b, collecting like terms, 2 * x + x is 3 * x.
+ */
+static NodeId makeSum(NodePool *pool, int lineCount, NodeId a, NodeId b, bool subtract) {
+    if (a == NODE_NONE || b == NODE_NONE) {
+        return NODE_NONE;
+    }
+    if (isZero(pool, b)) {
+        return a;
+    }
+    if (isZero(pool, a)) {
+        return subtract ? makeNegation(pool, lineCount, b) : b;
+    }
+    if (isNegation(pool, b)) { // a + -b is a - b.
+        return makeSum(pool, lineCount, a, nodeChild(pool, b, 0), !subtract);
+    }
+    if (isNumberNode(pool, a) && isNumberNode(pool, b)) {
+        Number numberA = nodeNumberOf(pool, a), numberB = nodeNumberOf(pool, b);
+        NodeId folded = foldNumber(pool, lineCount, subtract ? numberSubtract(numberA, numberB) : numberAdd(numberA, numberB));
+        return folded != NODE_NONE ? folded : nodeBinary(pool, lineCount, subtract ? MINUS : PLUS, a, b);
+    }
+    NodeId restA, restB;
+    Number coefficientA = termCoefficient(pool, a, &restA), coefficientB = termCoefficient(pool, b, &restB);
+    if (restA == restB) {
+        NodeId coefficient = foldNumber(pool, lineCount, subtract ? numberSubtract(coefficientA, coefficientB)
+                                                                  : numberAdd(coefficientA, coefficientB));
+        if (coefficient != NODE_NONE) {
+            return makeProduct(pool, lineCount, coefficient, restA);
+        }
+    }
+    return nodeBinary(pool, lineCount, subtract ? MINUS : PLUS, a, b);
+}
+
+/**
+ * a * b, numbers first and folded together, 2 * (3 * x) is 6 * x.
+ */
+static NodeId makeProduct(NodePool *pool, int lineCount, NodeId a, NodeId b) {
+    if (a == NODE_NONE || b == NODE_NONE) {
+        return NODE_NONE;
+    }
+    if (isZero(pool, a) || isZero(pool, b)) {
+        return makeNumber(pool, lineCount, 0);
+    }
+    if (isNumberNode(pool, b) && !isNumberNode(pool, a)) {
+        NodeId swap = a;
+        a = b;
+        b = swap;
+    }
+    if (isOne(pool, a)) {
+        return b;
+    }
+    if (isOne(pool, b)) {
+        return a;
+    }
+    if (a == b) {
+        return makePower(pool, lineCount, a, makeNumber(pool, lineCount, 2));
+    }
+    if (nodeTag(pool, b) == POWER && nodeChild(pool, b, 0) == a && isNumberNode(pool, nodeChild(pool, b, 1))) { // x x^n is x^(n + 1).
+        return makePower(pool, lineCount, a, makeSum(pool, lineCount, nodeChild(pool, b, 1), makeNumber(pool, lineCount, 1), false));
+    }
+    if (isNegation(pool, a)) {
+        return makeNegation(pool, lineCount, makeProduct(pool, lineCount, nodeChild(pool, a, 0), b));
+    }
+    if (isNegation(pool, b)) {
+        return makeNegation(pool, lineCount, makeProduct(pool, lineCount, a, nodeChild(pool, b, 0)));
+    }
+    if (isNumberNode(pool, a)) {
+        NodeId rest = NODE_NONE;
+        Number coefficient = isNumberNode(pool, b) ? nodeNumberOf(pool, b) : termCoefficient(pool, b, &rest);
+        if (rest != b) { // b is a number, or a number times the rest.
+            NodeId folded = foldNumber(pool, lineCount, numberMultiply(nodeNumberOf(pool, a), coefficient));
+            if (folded != NODE_NONE) {
+                return rest == NODE_NONE ? folded : makeProduct(pool, lineCount, folded, rest);
+            }
+        }
+        if (numberCompare(nodeNumberOf(pool, a), numberFromSmall(-1)) == 0) {
+            return makeNegation(pool, lineCount, b);
+        }
+    }
+    return nodeBinary(pool, lineCount, MULTIPLY, a, b);
+}
+
+static NodeId makeQuotient(NodePool *pool, int lineCount, NodeId a, NodeId b) {
+    if (a == NODE_NONE || b == NODE_NONE) {
+        return NODE_NONE;
+    }
+    if (isOne(pool, b)) {
+        return a;
+    }
+    if (isZero(pool, a) && !isZero(pool, b)) {
+        return a;
+    }
+    if (isNumberNode(pool, a) && isNumberNode(pool, b)) {
+        NodeId folded = foldNumber(pool, lineCount, numberDivide(nodeNumberOf(pool, a), nodeNumberOf(pool, b)));
+        if (folded != NODE_NONE) {
+            return folded;
+        }
+    }
+    return nodeBinary(pool, lineCount, DIVIDE, a, b);
+}
+
+static NodeId makePower(NodePool *pool, int lineCount, NodeId a, NodeId b) {
+    if (a == NODE_NONE || b == NODE_NONE) {
+        return NODE_NONE;
+    }
+    if (isZero(pool, b) && !isZero(pool, a)) {
+        return makeNumber(pool, lineCount, 1);
+    }
+    if (isOne(pool, b) || isOne(pool, a)) {
+        return isOne(pool, b) ? a : makeNumber(pool, lineCount, 1);
+    }
+    Number exponent = isNumberNode(pool, b) ? nodeNumberOf(pool, b) : numberFromSmall(0);
+    if (isNumberNode(pool, b) && numberIsSmall(exponent)) {
+        int64_t power = numberSmallValue(exponent);
+        if (isNumberNode(pool, a) && power >= -1024 && power <= 1024) {
+            NodeId folded = foldNumber(pool, lineCount, numberPower(nodeNumberOf(pool, a), power));
+            if (folded != NODE_NONE) {
+                return folded;
+            }
+        }
+        if (nodeTag(pool, a) == POWER && isNumberNode(pool, nodeChild(pool, a, 1))) { // (x^c)^n is x^(c n) for integer n.
+            NodeId folded = foldNumber(pool, lineCount, numberMultiply(nodeNumberOf(pool, nodeChild(pool, a, 1)), exponent));
+            if (folded != NODE_NONE) {
+                return makePower(pool, lineCount, nodeChild(pool, a, 0), folded);
+            }
+        }
+    }
+    return nodeBinary(pool, lineCount, POWER, a, b);
+}
+
+static NodeId makeCall(NodePool *pool, int lineCount, BuiltinSymbol function, NodeId argument) {
+    if (argument == NODE_NONE) {
+        return NODE_NONE;
+    }
+    return nodeCall(pool, lineCount, function, &argument, 1);
+}
+
+/**
+ * Derivative of a builtin function call f(u), given du.
+ */
+static NodeId differentiateCall(NodePool *pool, NodeId node, NodeId argument, NodeId derivative) {
+    int line = nodeLine(pool, node);
+    NodeId outer; // f'(u)
+    switch (nodeSymbolOf(pool, nodeChild(pool, node, 0))) {
+        case SYMBOL_SIN:
+            outer = makeCall(pool, line, SYMBOL_COS, argument);
+            break;
+        case SYMBOL_COS:
+            outer = makeNegation(pool, line, makeCall(pool, line, SYMBOL_SIN, argument));
+            break;
+        case SYMBOL_TAN:
+            outer = makeQuotient(pool, line, makeNumber(pool, line, 1),
+                                 makePower(pool, line, makeCall(pool, line, SYMBOL_COS, argument),
+                                           makeNumber(pool, line, 2)));
+            break;
+        case SYMBOL_EXP:
+            outer = node;
+            break;
+        case SYMBOL_LOG:
+            return makeQuotient(pool, line, derivative, argument);
+        case SYMBOL_SQRT:
+            return makeQuotient(pool, line, derivative, makeProduct(pool, line, makeNumber(pool, line, 2), node));
+        case SYMBOL_ABS:
+            outer = makeQuotient(pool, line, argument, node);
+            break;
+        default:
+            return NODE_NONE;
+    }
+    return makeProduct(pool, line, outer, derivative);
+}
+
+/**
+ * Derivative of a node, given the derivatives of its children.
+ * @param derivatives Derivative of each node of the subtree, by position.
+ */
+static NodeId differentiateStep(NodePool *pool, NodeId node, uint32_t variable, const NodeSubtree *subtree,
+                                const NodeId *derivatives) {
+    int line = nodeLine(pool, node);
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER) {
+        return makeNumber(pool, line, 0);
+    }
+    if (tag == NODE_SYMBOL) {
+        return makeNumber(pool, line, nodeSymbolOf(pool, node) == variable);
+    }
+    uint32_t count = nodeChildCount(pool, node), i;
+    bool constant = true;
+    for (i = tag == NODE_CALL; i < count; i++) {
+        constant = constant && isZero(pool, derivatives[nodeSubtreePosition(subtree, nodeChild(pool, node, i))]);
+    }
+    if (constant) {
+        return makeNumber(pool, line, 0);
+    }
+    NodeId a = nodeChild(pool, node, tag == NODE_CALL), da = derivatives[nodeSubtreePosition(subtree, a)];
+    if (tag == NODE_CALL) {
+        return count == 2 ? differentiateCall(pool, node, a, da) : NODE_NONE;
+    }
+    if (count == 1) {
+        switch ((OperatorType) tag) {
+            case PLUS:
+                return da;
+            case MINUS:
+                return makeNegation(pool, line, da);
+            case DIFF:
+                return da == NODE_NONE ? NODE_NONE : differentiateNode(pool, da, variable);
+            default:
+                return NODE_NONE;
+        }
+    }
+    NodeId b = nodeChild(pool, node, 1), db = derivatives[nodeSubtreePosition(subtree, b)];
+    switch ((OperatorType) tag) {
+        case PLUS:
+        case MINUS:
+            return makeSum(pool, line, da, db, tag == MINUS);
+        case MULTIPLY:
+            return makeSum(pool, line, makeProduct(pool, line, da, b), makeProduct(pool, line, a, db), false);
+        case DIVIDE:
+            if (isZero(pool, db)) {
+                return makeQuotient(pool, line, da, b);
+            }
+            return makeQuotient(pool, line,
+                                makeSum(pool, line, makeProduct(pool, line, da, b), makeProduct(pool, line, a, db), true),
+                                makePower(pool, line, b, makeNumber(pool, line, 2)));
+        case POWER:
+            if (isZero(pool, db)) { // b a^(b - 1) da
+                NodeId exponent = makeSum(pool, line, b, makeNumber(pool, line, 1), true);
+                return makeProduct(pool, line, makeProduct(pool, line, b, makePower(pool, line, a, exponent)), da);
+            }
+            if (isZero(pool, da)) { // a^b log(a) db
+                return makeProduct(pool, line, makeProduct(pool, line, node, makeCall(pool, line, SYMBOL_LOG, a)), db);
+            }
+            return makeProduct(pool, line, node, makeSum(pool, line,
+                                                         makeProduct(pool, line, db, makeCall(pool, line, SYMBOL_LOG, a)),
+                                                         makeQuotient(pool, line, makeProduct(pool, line, b, da), a),
+                                                         false));
+        default:
+            return NODE_NONE;
+    }
+}
+
+NodeId differentiateNode(NodePool *pool, NodeId node, uint32_t variable) {
+    if (node == NODE_NONE) {
+        return NODE_NONE;
+    }
+    NodeSubtree subtree;
+    initNodeSubtree(&subtree, pool, node, true);
+    NodeId *derivatives = (NodeId *) malloc(sizeof(NodeId) * subtree.count);
+    uint32_t i;
+    for (i = 0; i < subtree.count; i++) { // Children first, so each step finds its children differentiated.
+        derivatives[i] = differentiateStep(pool, subtree.nodes[i], variable, &subtree, derivatives);
+    }
+    NodeId derivative = derivatives[subtree.count - 1];
+    free(derivatives);
+    freeNodeSubtree(&subtree);
+    return derivative;
+}
+
+NodeId differentiateNodeTimes(NodePool *pool, NodeId node, uint32_t variable, int order) {
+    int i;
+    for (i = 0; i < order && node != NODE_NONE; i++) {
+        node = differentiateNode(pool, node, variable);
+    }
+    return node;
+}
+
+NodeId expandDerivatives(NodePool *pool, NodeId node, uint32_t variable) {
+    if (node == NODE_NONE) {
+        return NODE_NONE;
+    }
+    NodeSubtree subtree;
+    initNodeSubtree(&subtree, pool, node, true);
+    NodeId *expanded = (NodeId *) malloc(sizeof(NodeId) * subtree.count);
+    NodeId children[8];
+    uint32_t position;
+    for (position = 0; position < subtree.count; position++) {
+        NodeId id = subtree.nodes[position];
+        uint8_t tag = nodeTag(pool, id);
+        expanded[position] = id;
+        if (tag == NODE_NUMBER || tag == NODE_SYMBOL) {
+            continue;
+        }
+        uint32_t count = nodeChildCount(pool, id), i;
+        NodeId *rebuilt = count <= 8 ? children : (NodeId *) malloc(sizeof(NodeId) * count);
+        bool changed = false, failed = false;
+        for (i = 0; i < count; i++) {
+            rebuilt[i] = expanded[nodeSubtreePosition(&subtree, nodeChild(pool, id, i))];
+            changed = changed || rebuilt[i] != nodeChild(pool, id, i);
+            failed = failed || rebuilt[i] == NODE_NONE;
+        }
+        if (failed) {
+            expanded[position] = NODE_NONE;
+        } else if (tag == DIFF && count == 1) {
+            expanded[position] = differentiateNode(pool, rebuilt[0], variable);
+        } else if (changed && tag == NODE_CALL) {
+            expanded[position] = nodeCall(pool, nodeLine(pool, id), nodeSymbolOf(pool, rebuilt[0]), rebuilt + 1,
+                                          count - 1);
+        } else if (changed) {
+            expanded[position] = nodeOperator(pool, nodeLine(pool, id), (OperatorType) tag, rebuilt, count);
+        }
+        if (rebuilt != children) {
+            free(rebuilt);
+        }
+    }
+    NodeId result = expanded[subtree.count - 1];
+    free(expanded);
+    freeNodeSubtree(&subtree);
+    return result;
+}
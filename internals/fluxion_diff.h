@@ -0,0 +1,37 @@
+//
+// Symbolic differentiation of expression nodes.
+//
+
+#ifndef FLUXIONCORE_FLUXION_DIFF_H
+#define FLUXIONCORE_FLUXION_DIFF_H
+#include "fluxion_node.h"
+
+/**
+ * Differentiate a node with respect to a variable.
+ * Nodes are hash consed, so a subexpression shared anywhere under node is
+ * differentiated once, the derivatives are memoised per node of the subtree for the call.
+ * The derivative is simplified while it is built, numbers are folded and
+ * sums with 0 and products with 0 or 1 are never created.
+ * Derivatives of e' nodes are derivatives of the derivative of e.
+ * @param pool Pool the node is in, derivatives are created into it.
+ * @param node Node to differentiate.
+ * @param variable Symbol to differentiate with respect to.
+ * @return the derivative, NODE_NONE if a part depending on the variable has
+ * none, like a factorial, a comparison or a call of a function that is not builtin.
+ */
+NodeId differentiateNode(NodePool *pool, NodeId node, uint32_t variable);
+/**
+ * Differentiate a node order times.
+ * @return the derivative, the node itself for order 0, NODE_NONE if one of them has none.
+ */
+NodeId differentiateNodeTimes(NodePool *pool, NodeId node, uint32_t variable, int order);
+/**
+ * Replace every e' under a node with the derivative of e.
+ * @param pool Pool the node is in.
+ * @param node Node to expand.
+ * @param variable Symbol the derivatives are taken with respect to.
+ * @return the expanded node, node itself if it has no e', NODE_NONE if a derivative has none.
+ */
+NodeId expandDerivatives(NodePool *pool, NodeId node, uint32_t variable);
+
+#endif //FLUXIONCORE_FLUXION_DIFF_H
@@ -0,0 +1,235 @@
+//
+// Deciding whether expressions are equal, with a fingerprint fast path.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "fluxion_combinatorics.h"
+#include "fluxion_equal.h"
+#include "fluxion_gcd.h"
+#include "fluxion_modular.h"
+
+#define FINGERPRINT_UNKNOWN (UINT64_MAX - 1) // Not computed yet.
+
+EqualityChecker *initEqualityChecker(NodePool *pool, RewriteEngine *engine, uint64_t seed) {
+    EqualityChecker *checker = (EqualityChecker *) calloc(1, sizeof(EqualityChecker));
+    checker->pool = pool;
+    checker->engine = engine;
+    checker->prime = modularPrimeBelow(1ull << MODULAR_PRIME_BITS);
+    checker->random = seed * 0x9E3779B97F4A7C15ull | 1; // Never zero, xorshift would stay there.
+    return checker;
+}
+
+void freeEqualityChecker(EqualityChecker *checker) {
+    if (checker == NULL) {
+        return;
+    }
+    free(checker->points);
+    free(checker->fingerprints);
+    free(checker);
+}
+
+/**
+ * Residue of a symbol, drawn the first time it is asked for, xorshift64*.
+ */
+static uint64_t symbolPoint(EqualityChecker *checker, uint32_t symbol) {
+    if (symbol >= checker->pointCapacity) {
+        uint32_t capacity = checker->pointCapacity ? checker->pointCapacity : 64;
+        while (capacity <= symbol) {
+            capacity *= 2;
+        }
+        checker->points = (uint64_t *) realloc(checker->points, sizeof(uint64_t) * capacity);
+        memset(checker->points + checker->pointCapacity, 0, sizeof(uint64_t) * (capacity - checker->pointCapacity));
+        checker->pointCapacity = capacity;
+    }
+    while (checker->points[symbol] == 0) { // Zero would make every quotient by the symbol undefined.
+        checker->random ^= checker->random >> 12;
+        checker->random ^= checker->random << 25;
+        checker->random ^= checker->random >> 27;
+        checker->points[symbol] = checker->random * 2685821657736338717ull % checker->prime;
+    }
+    return checker->points[symbol];
+}
+
+static void reserveFingerprints(EqualityChecker *checker) {
+    uint32_t needed = checker->pool->count;
+    if (needed <= checker->fingerprintCapacity) {
+        return;
+    }
+    uint32_t capacity = checker->fingerprintCapacity ? checker->fingerprintCapacity : 64, i;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    checker->fingerprints = (uint64_t *) realloc(checker->fingerprints, sizeof(uint64_t) * capacity);
+    for (i = checker->fingerprintCapacity; i < capacity; i++) {
+        checker->fingerprints[i] = FINGERPRINT_UNKNOWN;
+    }
+    checker->fingerprintCapacity = capacity;
+}
+
+/**
+ * The integer an exponent or factorial node is, n or -n for a number n.
+ * @return false if it is not a small integer.
+ */
+static bool exponentOf(const NodePool *pool, NodeId node, int64_t *exponent) {
+    bool negate = nodeIsOperator(pool, node) && nodeTag(pool, node) == MINUS && nodeChildCount(pool, node) == 1;
+    if (negate) {
+        node = nodeChild(pool, node, 0);
+    }
+    if (nodeTag(pool, node) != NODE_NUMBER || numberKind(nodeNumberOf(pool, node)) != NUMBER_SMALL) {
+        return false;
+    }
+    *exponent = numberSmallValue(nodeNumberOf(pool, node));
+    if (negate) {
+        *exponent = -*exponent;
+    }
+    return true;
+}
+
+/**
+ * Fingerprint of an operator from those of its children, which are known
+ * already, the same operators a rational function is built from by
+ * rationalFunctionFromNode, and factorials of integers.
+ */
+static uint64_t operatorFingerprint(EqualityChecker *checker, NodeId node) {
+    const NodePool *pool = checker->pool;
+    uint8_t tag = nodeTag(pool, node);
+    uint64_t prime = checker->prime, a, b, inverse;
+    if (tag == FACTORIAL) { // Only of integers, n! mod p is found without n!, and is 0 for n >= p.
+        int64_t n;
+        return exponentOf(pool, nodeChild(pool, node, 0), &n) && n >= 0 && factorialModulo((uint64_t) n, prime, &a) ?
+               a : FINGERPRINT_NONE;
+    }
+    a = checker->fingerprints[nodeChild(pool, node, 0)];
+    if (a == FINGERPRINT_NONE) {
+        return FINGERPRINT_NONE;
+    }
+    if (nodeChildCount(pool, node) == 1) {
+        return tag == PLUS ? a : tag == MINUS ? subtractModulo(0, a, prime) : FINGERPRINT_NONE;
+    }
+    if (tag == POWER) { // Only integer exponents, the value of the exponent is needed and not its residue.
+        int64_t exponent;
+        if (!exponentOf(pool, nodeChild(pool, node, 1), &exponent)) {
+            return FINGERPRINT_NONE;
+        }
+        uint64_t magnitude = exponent < 0 ? 0 - (uint64_t) exponent : (uint64_t) exponent;
+        a = powerModulo(a, magnitude, prime);
+        return exponent >= 0 ? a : inverseModulo(a, prime, &inverse) ? inverse : FINGERPRINT_NONE;
+    }
+    b = checker->fingerprints[nodeChild(pool, node, 1)];
+    if (b == FINGERPRINT_NONE) {
+        return FINGERPRINT_NONE;
+    }
+    switch ((OperatorType) tag) {
+        case PLUS:
+            return addModulo(a, b, prime);
+        case MINUS:
+            return subtractModulo(a, b, prime);
+        case MULTIPLY:
+            return multiplyModulo(a, b, prime);
+        case DIVIDE: // None at a root of the divisor, though the quotient may be defined there.
+            return inverseModulo(b, prime, &inverse) ? multiplyModulo(a, inverse, prime) : FINGERPRINT_NONE;
+        default:
+            return FINGERPRINT_NONE;
+    }
+}
+
+/**
+ * Fingerprint of a node whose children have theirs.
+ */
+static uint64_t fingerprintStep(EqualityChecker *checker, NodeId node) {
+    const NodePool *pool = checker->pool;
+    uint64_t fingerprint;
+    switch (nodeTag(pool, node)) {
+        case NODE_NUMBER:
+            if (!numberModulo(nodeNumberOf(pool, node), checker->prime, &fingerprint)) {
+                fingerprint = FINGERPRINT_NONE;
+            }
+            break;
+        case NODE_SYMBOL:
+            fingerprint = symbolPoint(checker, nodeSymbolOf(pool, node));
+            break;
+        case NODE_CALL:
+            fingerprint = FINGERPRINT_NONE; // Identities between functions, like sin^2 + cos^2 = 1, are not seen.
+            break;
+        default:
+            fingerprint = operatorFingerprint(checker, node);
+            break;
+    }
+    return fingerprint;
+}
+
+uint64_t nodeFingerprint(EqualityChecker *checker, NodeId node) {
+    if (node == NODE_NONE) {
+        return FINGERPRINT_NONE;
+    }
+    reserveFingerprints(checker);
+    if (checker->fingerprints[node] != FINGERPRINT_UNKNOWN) {
+        return checker->fingerprints[node];
+    }
+    NodeSubtree subtree;
+    initNodeSubtree(&subtree, checker->pool, node, false);
+    uint32_t i;
+    for (i = 0; i < subtree.count; i++) { // Children first, so a step only reads fingerprints.
+        NodeId next = subtree.nodes[i];
+        if (checker->fingerprints[next] == FINGERPRINT_UNKNOWN) {
+            checker->fingerprints[next] = fingerprintStep(checker, next);
+        }
+    }
+    freeNodeSubtree(&subtree);
+    return checker->fingerprints[node];
+}
+
+/**
+ * Compare two nodes as rational functions, first by fingerprint then by whether their difference is zero.
+ */
+static Equality compareRational(EqualityChecker *checker, NodeId a, NodeId b) {
+    uint64_t fingerprintA = nodeFingerprint(checker, a), fingerprintB = nodeFingerprint(checker, b);
+    if (fingerprintA != FINGERPRINT_NONE && fingerprintB != FINGERPRINT_NONE && fingerprintA != fingerprintB) {
+        checker->rejections++;
+        return EQUALITY_DIFFERENT;
+    }
+    checker->symbolicComparisons++;
+    RationalFunction *functionA = rationalFunctionFromNode(checker->pool, a);
+    RationalFunction *functionB = functionA != NULL ? rationalFunctionFromNode(checker->pool, b) : NULL;
+    RationalFunction *difference = functionB != NULL ? rationalFunctionSubtract(functionA, functionB) : NULL;
+    Equality equality = difference == NULL ? EQUALITY_UNKNOWN :
+                        difference->numerator->count == 0 ? EQUALITY_EQUAL : EQUALITY_DIFFERENT;
+    freeRationalFunction(difference);
+    freeRationalFunction(functionB);
+    freeRationalFunction(functionA);
+    return equality;
+}
+
+Equality compareNodes(EqualityChecker *checker, NodeId a, NodeId b) {
+    if (a == NODE_NONE || b == NODE_NONE) {
+        return EQUALITY_UNKNOWN;
+    }
+    checker->comparisons++;
+    if (a == b) { // Hash consed, the same expression is the same node.
+        return EQUALITY_EQUAL;
+    }
+    Equality equality = compareRational(checker, a, b);
+    if (equality != EQUALITY_UNKNOWN || checker->engine == NULL) {
+        return equality;
+    }
+    NodeId normalA = rewriteNode(checker->engine, a), normalB = rewriteNode(checker->engine, b);
+    if (normalA == normalB) {
+        return EQUALITY_EQUAL;
+    }
+    return normalA != a || normalB != b ? compareRational(checker, normalA, normalB) : EQUALITY_UNKNOWN;
+}
+
+NodeId decideEqualityNode(EqualityChecker *checker, NodeId node) {
+    NodePool *pool = checker->pool;
+    if (node == NODE_NONE || !nodeIsOperator(pool, node) || nodeChildCount(pool, node) != 2 ||
+        (nodeTag(pool, node) != EQUAL && nodeTag(pool, node) != NEQ)) {
+        return node;
+    }
+    Equality equality = compareNodes(checker, nodeChild(pool, node, 0), nodeChild(pool, node, 1));
+    if (equality == EQUALITY_UNKNOWN) {
+        return node;
+    }
+    bool holds = (equality == EQUALITY_EQUAL) == (nodeTag(pool, node) == EQUAL);
+    return nodeExactNumber(pool, nodeLine(pool, node), numberFromSmall(holds));
+}
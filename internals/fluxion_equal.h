@@ -0,0 +1,70 @@
+//
+// Deciding whether expressions are equal, with a fingerprint fast path.
+//
+
+#ifndef FLUXIONCORE_FLUXION_EQUAL_H
+#define FLUXIONCORE_FLUXION_EQUAL_H
+#include "fluxion_rewrite.h"
+
+#define FINGERPRINT_NONE UINT64_MAX // The node has no fingerprint.
+
+typedef enum {
+    EQUALITY_UNKNOWN, // Neither could be shown.
+    EQUALITY_EQUAL,
+    EQUALITY_DIFFERENT
+} Equality;
+
+/**
+ * Compares the nodes of a pool. The fingerprint of a node is its value at a
+ * random point modulo a prime near 2^62, each symbol given its own random
+ * residue. Two rational functions that differ agree at the point with
+ * probability at most their degree over the prime (Schwartz-Zippel), so
+ * different fingerprints prove the nodes differ and most unequal pairs are
+ * decided without simplifying either. Equal fingerprints are only a hint,
+ * equality is then shown symbolically. Fingerprints are kept per node id,
+ * comparing a node again costs a lookup.
+ */
+typedef struct {
+    NodePool *pool;
+    RewriteEngine *engine; // Normal forms for nodes that are not rational functions, not owned, may be NULL.
+    uint64_t prime;
+    uint64_t random; // State of the generator of the points.
+    uint64_t *points; // Residue of each symbol, 0 if not drawn yet.
+    uint32_t pointCapacity;
+    uint64_t *fingerprints; // Of each node id, FINGERPRINT_NONE if it has none.
+    uint32_t fingerprintCapacity;
+    // Counters for profiling.
+    uint64_t comparisons;
+    uint64_t rejections; // Comparisons decided by different fingerprints.
+    uint64_t symbolicComparisons; // Comparisons the fingerprints could not decide.
+} EqualityChecker;
+
+/**
+ * Create a checker for a pool.
+ * @param pool Pool the nodes are in, not owned.
+ * @param engine Engine to normalise nodes that are not rational functions with, not owned, may be NULL.
+ * @param seed Seed of the random point, the same seed draws the same point.
+ */
+EqualityChecker *initEqualityChecker(NodePool *pool, RewriteEngine *engine, uint64_t seed);
+void freeEqualityChecker(EqualityChecker *checker);
+
+/**
+ * Fingerprint of a node, defined for sums, differences, products, quotients
+ * and integer powers of exact numbers and symbols that do not divide by zero at the point.
+ * @return the fingerprint, below the prime, FINGERPRINT_NONE if it has none.
+ */
+uint64_t nodeFingerprint(EqualityChecker *checker, NodeId node);
+/**
+ * Decide whether two nodes are equal. The same node is equal, different
+ * fingerprints differ. Otherwise rational functions are equal when their
+ * difference is zero, and other nodes when their normal forms are the same.
+ * @return whether they are equal, EQUALITY_UNKNOWN if it could not be shown either way.
+ */
+Equality compareNodes(EqualityChecker *checker, NodeId a, NodeId b);
+/**
+ * Decide an a = b or a \= b node.
+ * @return 1 or 0, node itself if it is not one or is not decided.
+ */
+NodeId decideEqualityNode(EqualityChecker *checker, NodeId node);
+
+#endif //FLUXIONCORE_FLUXION_EQUAL_H
@@ -0,0 +1,1252 @@
+//
+// Polynomial GCDs by modular algorithms, and rational functions kept in lowest terms.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "fluxion_gcd.h"
+#include "fluxion_modular.h"
+
+#ifdef FLUXION_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define GCD_LIFT_SLACK 32 // A lifted candidate this many bits below the modulus is worth a trial division.
+
+/**
+ * A polynomial modulo a prime, packed and ordered as a Polynomial.
+ */
+typedef struct {
+    size_t count;
+    size_t capacity;
+    uint64_t *monomials;
+    uint64_t *coefficients; // Never zero.
+} ModularPolynomial;
+
+/**
+ * What a gcd modulo one prime works in. Brown's algorithm removes variables
+ * from the last, so the ones after the current last variable have exponent 0
+ * and the terms that only differ in the last one are adjacent.
+ */
+typedef struct {
+    uint64_t prime;
+    uint32_t variableCount; // Of the packing.
+    uint64_t random; // State of the generator of evaluation points.
+} ModularContext;
+
+static void initModular(ModularPolynomial *polynomial) {
+    memset(polynomial, 0, sizeof(ModularPolynomial));
+}
+
+static void freeModular(ModularPolynomial *polynomial) {
+    free(polynomial->monomials);
+    free(polynomial->coefficients);
+    initModular(polynomial);
+}
+
+/**
+ * Append a term below every term so far, zero coefficients are dropped.
+ */
+static void pushModular(ModularPolynomial *polynomial, uint64_t monomial, uint64_t coefficient) {
+    if (coefficient == 0) {
+        return;
+    }
+    if (polynomial->count == polynomial->capacity) {
+        polynomial->capacity = polynomial->capacity ? 2 * polynomial->capacity : 8;
+        polynomial->monomials = (uint64_t *) realloc(polynomial->monomials, sizeof(uint64_t) * polynomial->capacity);
+        polynomial->coefficients = (uint64_t *) realloc(polynomial->coefficients,
+                                                        sizeof(uint64_t) * polynomial->capacity);
+    }
+    polynomial->monomials[polynomial->count] = monomial;
+    polynomial->coefficients[polynomial->count++] = coefficient;
+}
+
+static void makeMonic(ModularPolynomial *polynomial, uint64_t prime) {
+    uint64_t inverse;
+    size_t i;
+    if (polynomial->count == 0 || polynomial->coefficients[0] == 1) {
+        return;
+    }
+    inverseModulo(polynomial->coefficients[0], prime, &inverse);
+    uint64_t shoup = shoupFactor(inverse, prime);
+    for (i = 0; i < polynomial->count; i++) {
+        polynomial->coefficients[i] = shoupMultiply(polynomial->coefficients[i], inverse, shoup, prime);
+    }
+}
+
+static void scaleModular(ModularPolynomial *polynomial, uint64_t factor, uint64_t prime) {
+    uint64_t shoup = shoupFactor(factor, prime);
+    size_t i;
+    for (i = 0; i < polynomial->count; i++) {
+        polynomial->coefficients[i] = shoupMultiply(polynomial->coefficients[i], factor, shoup, prime);
+    }
+}
+
+/**
+ * A random evaluation point, xorshift64*.
+ */
+static uint64_t nextPoint(ModularContext *context) {
+    context->random ^= context->random >> 12;
+    context->random ^= context->random << 25;
+    context->random ^= context->random >> 27;
+    return context->random * 2685821657736338717ull % context->prime;
+}
+
+/*
+ * Dense polynomials in one variable modulo a prime, lowest degree first, with
+ * their length. The zero polynomial has length 0.
+ */
+
+static size_t denseTrim(const uint64_t *values, size_t length) {
+    while (length > 0 && values[length - 1] == 0) {
+        length--;
+    }
+    return length;
+}
+
+/**
+ * Divide x by a nonzero y, the quotient is written if asked and x is left with the remainder.
+ * @return the length of the remainder.
+ */
+static size_t denseDivide(uint64_t *quotient, uint64_t *x, size_t xLength, const uint64_t *y, size_t yLength,
+                          uint64_t prime) {
+    uint64_t inverse;
+    size_t k, i;
+    inverseModulo(y[yLength - 1], prime, &inverse);
+    for (k = xLength >= yLength ? xLength - yLength + 1 : 0; k-- > 0;) {
+        uint64_t factor = multiplyModulo(x[k + yLength - 1], inverse, prime);
+        if (quotient != NULL) {
+            quotient[k] = factor;
+        }
+        for (i = 0; factor && i < yLength; i++) {
+            x[k + i] = subtractModulo(x[k + i], multiplyModulo(factor, y[i], prime), prime);
+        }
+    }
+    return denseTrim(x, xLength < yLength ? xLength : yLength - 1);
+}
+
+/**
+ * Monic gcd by Euclid's algorithm, result may be a or b and needs the length of the shorter nonzero one.
+ * @return its length, 0 if both are zero.
+ */
+static size_t denseGcd(uint64_t *result, const uint64_t *a, size_t aLength, const uint64_t *b, size_t bLength,
+                       uint64_t prime) {
+    aLength = denseTrim(a, aLength);
+    bLength = denseTrim(b, bLength);
+    uint64_t *block = (uint64_t *) malloc(sizeof(uint64_t) * (aLength + bLength + 1)), *x = block, *y = x + aLength;
+    memcpy(x, a, sizeof(uint64_t) * aLength);
+    memcpy(y, b, sizeof(uint64_t) * bLength);
+    size_t xLength = aLength, yLength = bLength, i;
+    while (yLength > 0) {
+        xLength = denseDivide(NULL, x, xLength, y, yLength, prime);
+        uint64_t *swap = x;
+        x = y;
+        y = swap;
+        size_t swapLength = xLength;
+        xLength = yLength;
+        yLength = swapLength;
+    }
+    if (xLength > 0) {
+        uint64_t inverse;
+        inverseModulo(x[xLength - 1], prime, &inverse);
+        for (i = 0; i < xLength; i++) {
+            result[i] = multiplyModulo(x[i], inverse, prime);
+        }
+    }
+    free(block);
+    return xLength;
+}
+
+static uint64_t denseEvaluate(const uint64_t *values, size_t length, uint64_t point, uint64_t prime) {
+    uint64_t value = 0;
+    while (length-- > 0) {
+        value = addModulo(multiplyModulo(value, point, prime), values[length], prime);
+    }
+    return value;
+}
+
+/*
+ * A modular polynomial seen as a polynomial in the variables before the last
+ * one, with coefficients dense polynomials in the last one. Those are groups
+ * of adjacent terms, with the highest exponent of the last variable first.
+ */
+
+static size_t groupEnd(const ModularPolynomial *polynomial, size_t start, uint64_t mask) {
+    size_t end = start + 1;
+    while (end < polynomial->count && (polynomial->monomials[end] & ~mask) == (polynomial->monomials[start] & ~mask)) {
+        end++;
+    }
+    return end;
+}
+
+static size_t groupDense(uint64_t *values, const ModularPolynomial *polynomial, size_t start, size_t end,
+                         uint32_t shift, uint64_t mask) {
+    size_t length = (size_t) ((polynomial->monomials[start] & mask) >> shift) + 1, i;
+    memset(values, 0, sizeof(uint64_t) * length);
+    for (i = start; i < end; i++) {
+        values[(polynomial->monomials[i] & mask) >> shift] = polynomial->coefficients[i];
+    }
+    return length;
+}
+
+static void pushDense(ModularPolynomial *result, uint64_t head, const uint64_t *values, size_t length,
+                      uint32_t shift) {
+    while (length-- > 0) {
+        pushModular(result, head | (uint64_t) length << shift, values[length]);
+    }
+}
+
+static uint64_t lastDegree(const ModularPolynomial *polynomial, uint32_t shift, uint64_t mask) {
+    uint64_t degree = 0;
+    size_t i;
+    for (i = 0; i < polynomial->count; i++) {
+        uint64_t exponent = (polynomial->monomials[i] & mask) >> shift;
+        degree = exponent > degree ? exponent : degree;
+    }
+    return degree;
+}
+
+/**
+ * Monic gcd of the groups, the content in the last variable.
+ * @param content Room for the last degree + 1 values.
+ * @return its length.
+ */
+static size_t modularContent(uint64_t *content, const ModularPolynomial *polynomial, uint32_t shift, uint64_t mask,
+                             uint64_t prime) {
+    uint64_t *group = (uint64_t *) malloc(sizeof(uint64_t) * (lastDegree(polynomial, shift, mask) + 1));
+    size_t length = 0, start, end;
+    for (start = 0; start < polynomial->count && length != 1; start = end) {
+        end = groupEnd(polynomial, start, mask);
+        size_t groupLength = groupDense(group, polynomial, start, end, shift, mask);
+        length = denseGcd(content, content, length, group, groupLength, prime);
+    }
+    free(group);
+    return length;
+}
+
+/**
+ * Divide or multiply every group by a dense polynomial in the last variable, dividing exactly.
+ */
+static void mapGroups(ModularPolynomial *result, const ModularPolynomial *polynomial, const uint64_t *factor,
+                      size_t factorLength, bool divide, uint32_t shift, uint64_t mask, uint64_t prime) {
+    uint64_t degree = lastDegree(polynomial, shift, mask);
+    uint64_t *group = (uint64_t *) malloc(sizeof(uint64_t) * (2 * (degree + 1) + factorLength));
+    uint64_t *mapped = group + degree + 1;
+    size_t start, end, i, j;
+    initModular(result);
+    for (start = 0; start < polynomial->count; start = end) {
+        end = groupEnd(polynomial, start, mask);
+        size_t length = groupDense(group, polynomial, start, end, shift, mask), mappedLength;
+        if (divide) {
+            mappedLength = length - factorLength + 1;
+            denseDivide(mapped, group, length, factor, factorLength, prime);
+        } else {
+            mappedLength = length + factorLength - 1;
+            memset(mapped, 0, sizeof(uint64_t) * mappedLength);
+            for (i = 0; i < length; i++) {
+                for (j = 0; group[i] && j < factorLength; j++) {
+                    mapped[i + j] = addModulo(mapped[i + j], multiplyModulo(group[i], factor[j], prime), prime);
+                }
+            }
+        }
+        pushDense(result, polynomial->monomials[start] & ~mask, mapped, mappedLength, shift);
+    }
+    free(group);
+}
+
+/**
+ * Evaluate the last variable at a point.
+ */
+static void evaluateLast(ModularPolynomial *result, const ModularPolynomial *polynomial, uint64_t point,
+                         uint32_t shift, uint64_t mask, uint64_t prime) {
+    size_t start, end, i;
+    initModular(result);
+    for (start = 0; start < polynomial->count; start = end) {
+        end = groupEnd(polynomial, start, mask);
+        uint64_t value = 0, exponent = (polynomial->monomials[start] & mask) >> shift;
+        for (i = start; i < end; i++) { // Horner over the exponents present.
+            uint64_t next = (polynomial->monomials[i] & mask) >> shift;
+            value = multiplyModulo(value, powerModulo(point, exponent - next, prime), prime);
+            value = addModulo(value, polynomial->coefficients[i], prime);
+            exponent = next;
+        }
+        value = multiplyModulo(value, powerModulo(point, exponent, prime), prime);
+        pushModular(result, polynomial->monomials[start] & ~mask, value);
+    }
+}
+
+/**
+ * Whether b divides a, by dividing leading terms away.
+ */
+static bool modularDivides(const ModularPolynomial *a, const ModularPolynomial *b, const ModularContext *context) {
+    uint32_t count = context->variableCount, v;
+    uint64_t maxB[POLY_MAX_VARIABLES] = {0}, inverse, prime = context->prime;
+    size_t i, j;
+    for (i = 0; i < b->count; i++) {
+        for (v = 0; v < count; v++) {
+            uint64_t exponent = monomialExponent(b->monomials[i], count, v);
+            maxB[v] = exponent > maxB[v] ? exponent : maxB[v];
+        }
+    }
+    inverseModulo(b->coefficients[0], prime, &inverse);
+    ModularPolynomial remainder, next;
+    initModular(&remainder);
+    for (i = 0; i < a->count; i++) {
+        pushModular(&remainder, a->monomials[i], a->coefficients[i]);
+    }
+    bool divides = true;
+    while (remainder.count > 0 && divides) {
+        uint64_t lead = remainder.monomials[0];
+        for (v = 0; v < count && divides; v++) {
+            uint64_t exponent = monomialExponent(lead, count, v), leadB = monomialExponent(b->monomials[0], count, v);
+            divides = exponent >= leadB && exponent - leadB <= monomialFieldMax(count) - maxB[v];
+        }
+        if (!divides) {
+            break;
+        }
+        uint64_t shift = lead - b->monomials[0], factor = multiplyModulo(remainder.coefficients[0], inverse, prime);
+        initModular(&next);
+        for (i = 1, j = 1; i < remainder.count || j < b->count;) { // The leading terms cancel.
+            uint64_t monomialB = j < b->count ? b->monomials[j] + shift : 0;
+            if (j == b->count || (i < remainder.count && remainder.monomials[i] > monomialB)) {
+                pushModular(&next, remainder.monomials[i], remainder.coefficients[i]);
+                i++;
+            } else {
+                uint64_t product = multiplyModulo(factor, b->coefficients[j++], prime);
+                if (i < remainder.count && remainder.monomials[i] == monomialB) {
+                    pushModular(&next, monomialB, subtractModulo(remainder.coefficients[i++], product, prime));
+                } else {
+                    pushModular(&next, monomialB, product ? prime - product : 0);
+                }
+            }
+        }
+        freeModular(&remainder);
+        remainder = next;
+    }
+    freeModular(&remainder);
+    return divides;
+}
+
+static int compareDescending(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/**
+ * Newton interpolation of the last variable from images at distinct points, coefficient by coefficient.
+ */
+static void interpolateLast(ModularPolynomial *result, const ModularPolynomial *images, const uint64_t *points,
+                            size_t count, uint32_t shift, uint64_t prime) {
+    size_t total = 0, unique = 0, i, j, k;
+    for (k = 0; k < count; k++) {
+        total += images[k].count;
+    }
+    uint64_t *monomials = (uint64_t *) malloc(sizeof(uint64_t) * (total + 1));
+    for (k = 0; k < count; k++) {
+        memcpy(monomials + unique, images[k].monomials, sizeof(uint64_t) * images[k].count);
+        unique += images[k].count;
+    }
+    qsort(monomials, total, sizeof(uint64_t), compareDescending);
+    for (i = 0, unique = 0; i < total; i++) {
+        if (unique == 0 || monomials[unique - 1] != monomials[i]) {
+            monomials[unique++] = monomials[i];
+        }
+    }
+    // inverses[i count + j] = 1 / (points[i] - points[i - j]), the divided difference denominators.
+    uint64_t *inverses = (uint64_t *) malloc(sizeof(uint64_t) * (count * count + 3 * count + 1));
+    uint64_t *values = inverses + count * count, *dense = values + count, *cursors = dense + count + 1;
+    for (i = 0; i < count; i++) {
+        for (j = 1; j <= i; j++) {
+            inverseModulo(subtractModulo(points[i], points[i - j], prime), prime, inverses + i * count + j);
+        }
+        cursors[i] = 0;
+    }
+    initModular(result);
+    for (i = 0; i < unique; i++) {
+        for (k = 0; k < count; k++) {
+            const ModularPolynomial *image = images + k;
+            bool present = cursors[k] < image->count && image->monomials[cursors[k]] == monomials[i];
+            values[k] = present ? image->coefficients[cursors[k]++] : 0;
+        }
+        for (j = 1; j < count; j++) {
+            for (k = count - 1; k >= j; k--) {
+                values[k] = multiplyModulo(subtractModulo(values[k], values[k - 1], prime),
+                                           inverses[k * count + j], prime);
+            }
+        }
+        size_t length = 1; // From the Newton form, v_0 + (x - p_0)(v_1 + (x - p_1)(...)).
+        memset(dense, 0, sizeof(uint64_t) * (count + 1));
+        dense[0] = values[count - 1];
+        for (k = count - 1; k-- > 0; length++) {
+            for (j = length; j > 0; j--) {
+                dense[j] = subtractModulo(dense[j - 1], multiplyModulo(points[k], dense[j], prime), prime);
+            }
+            dense[0] = subtractModulo(values[k], multiplyModulo(points[k], dense[0], prime), prime);
+        }
+        pushDense(result, monomials[i], dense, length, shift);
+    }
+    free(inverses);
+    free(monomials);
+}
+
+/**
+ * Monic gcd of nonzero a and b in the variables up to last, Brown's algorithm.
+ * The contents in the last variable are taken out, then the primitive parts
+ * are evaluated at points until enough images of their gcd, scaled by the
+ * gcd of the leading coefficients so the images agree, interpolate it.
+ * Images of a higher degree come from unlucky points and are dropped, one of
+ * a lower degree means the images so far were unlucky.
+ */
+static void modularGcd(ModularPolynomial *result, const ModularPolynomial *a, const ModularPolynomial *b,
+                       uint32_t last, ModularContext *context) {
+    uint32_t shift = monomialFieldShift(context->variableCount, last);
+    uint64_t mask = monomialFieldMax(context->variableCount) << shift, prime = context->prime;
+    uint64_t degreeA = lastDegree(a, shift, mask), degreeB = lastDegree(b, shift, mask);
+    size_t longest = (size_t) (degreeA > degreeB ? degreeA : degreeB) + 1;
+    uint64_t *dense = (uint64_t *) malloc(sizeof(uint64_t) * 6 * longest);
+    uint64_t *contentA = dense, *contentB = dense + longest, *content = dense + 2 * longest;
+    uint64_t *leadA = dense + 3 * longest, *leadB = dense + 4 * longest, *gamma = dense + 5 * longest;
+    initModular(result);
+    if (last == 0) { // Univariate, Euclid.
+        size_t length = denseGcd(content, contentA, groupDense(contentA, a, 0, a->count, shift, mask),
+                                 contentB, groupDense(contentB, b, 0, b->count, shift, mask), prime);
+        pushDense(result, 0, content, length, shift);
+        free(dense);
+        return;
+    }
+    size_t lengthA = modularContent(contentA, a, shift, mask, prime);
+    size_t lengthB = modularContent(contentB, b, shift, mask, prime);
+    size_t contentLength = denseGcd(content, contentA, lengthA, contentB, lengthB, prime);
+    ModularPolynomial primitiveA, primitiveB;
+    mapGroups(&primitiveA, a, contentA, lengthA, true, shift, mask, prime);
+    mapGroups(&primitiveB, b, contentB, lengthB, true, shift, mask, prime);
+    size_t leadLengthA = groupDense(leadA, &primitiveA, 0, groupEnd(&primitiveA, 0, mask), shift, mask);
+    size_t leadLengthB = groupDense(leadB, &primitiveB, 0, groupEnd(&primitiveB, 0, mask), shift, mask);
+    size_t gammaLength = denseGcd(gamma, leadA, leadLengthA, leadB, leadLengthB, prime);
+    degreeA = lastDegree(&primitiveA, shift, mask);
+    degreeB = lastDegree(&primitiveB, shift, mask);
+    size_t needed = (size_t) (degreeA < degreeB ? degreeA : degreeB) + gammaLength; // Degree bound + 1.
+    ModularPolynomial *images = (ModularPolynomial *) malloc(sizeof(ModularPolynomial) * needed);
+    uint64_t *points = (uint64_t *) malloc(sizeof(uint64_t) * needed);
+    size_t count = 0, i;
+    while (true) {
+        uint64_t point = nextPoint(context);
+        bool used = false;
+        for (i = 0; i < count && !used; i++) {
+            used = points[i] == point;
+        }
+        if (used || denseEvaluate(leadA, leadLengthA, point, prime) == 0 ||
+            denseEvaluate(leadB, leadLengthB, point, prime) == 0) {
+            continue;
+        }
+        ModularPolynomial imageA, imageB, image;
+        evaluateLast(&imageA, &primitiveA, point, shift, mask, prime);
+        evaluateLast(&imageB, &primitiveB, point, shift, mask, prime);
+        modularGcd(&image, &imageA, &imageB, last - 1, context);
+        freeModular(&imageA);
+        freeModular(&imageB);
+        if (image.monomials[0] == 0) { // The primitive parts are coprime.
+            freeModular(&image);
+            pushDense(result, 0, content, contentLength, shift);
+            break;
+        }
+        if (count > 0 && image.monomials[0] > images[0].monomials[0]) {
+            freeModular(&image);
+            continue;
+        }
+        if (count > 0 && image.monomials[0] < images[0].monomials[0]) {
+            for (i = 0; i < count; i++) {
+                freeModular(images + i);
+            }
+            count = 0;
+        }
+        scaleModular(&image, denseEvaluate(gamma, gammaLength, point, prime), prime);
+        points[count] = point;
+        images[count++] = image;
+        if (count < needed) {
+            continue;
+        }
+        ModularPolynomial interpolated, primitive;
+        interpolateLast(&interpolated, images, points, count, shift, prime);
+        uint64_t *interpolatedContent = (uint64_t *) malloc(sizeof(uint64_t) * needed);
+        size_t interpolatedLength = modularContent(interpolatedContent, &interpolated, shift, mask, prime);
+        mapGroups(&primitive, &interpolated, interpolatedContent, interpolatedLength, true, shift, mask, prime);
+        free(interpolatedContent);
+        freeModular(&interpolated);
+        for (i = 0; i < count; i++) {
+            freeModular(images + i);
+        }
+        count = 0;
+        if (modularDivides(&primitiveA, &primitive, context) && modularDivides(&primitiveB, &primitive, context)) {
+            mapGroups(result, &primitive, content, contentLength, false, shift, mask, prime);
+            makeMonic(result, prime);
+            freeModular(&primitive);
+            break;
+        }
+        freeModular(&primitive); // Unlucky points of the same degree, start over.
+    }
+    for (i = 0; i < count; i++) {
+        freeModular(images + i);
+    }
+    free(points);
+    free(images);
+    freeModular(&primitiveB);
+    freeModular(&primitiveA);
+    free(dense);
+}
+
+/**
+ * Reduce integer coefficients modulo a prime.
+ * @return false if the leading coefficient vanishes.
+ */
+static bool reduceModular(ModularPolynomial *result, const Polynomial *polynomial, uint64_t prime) {
+    size_t i;
+    initModular(result);
+    for (i = 0; i < polynomial->count; i++) {
+        uint64_t residue = integerModulo(polynomial->coefficients + i, prime);
+        if (i == 0 && residue == 0) {
+            return false;
+        }
+        pushModular(result, polynomial->monomials[i], residue);
+    }
+    return true;
+}
+
+/**
+ * The gcd modulo one prime, a round runs several on threads.
+ */
+typedef struct {
+    const Polynomial *a;
+    const Polynomial *b;
+    uint64_t prime;
+    bool usable; // Neither leading coefficient vanishes modulo the prime.
+    ModularPolynomial image; // Monic.
+} GcdImage;
+
+static void computeImage(GcdImage *image) {
+    ModularPolynomial a, b;
+    initModular(&image->image);
+    initModular(&b);
+    image->usable = reduceModular(&a, image->a, image->prime) && reduceModular(&b, image->b, image->prime);
+    if (image->usable) {
+        ModularContext context = {image->prime, image->a->variableCount, image->prime * 0x9E3779B97F4A7C15ull | 1};
+        modularGcd(&image->image, &a, &b, image->a->variableCount - 1, &context);
+    }
+    freeModular(&b);
+    freeModular(&a);
+}
+
+typedef struct {
+    GcdImage *images;
+    size_t count;
+} GcdSlice;
+
+static void *computeSlice(void *argument) {
+    GcdSlice *slice = (GcdSlice *) argument;
+    size_t i;
+    for (i = 0; i < slice->count; i++) {
+        computeImage(slice->images + i);
+    }
+    return NULL;
+}
+
+#ifdef FLUXION_THREADS
+static void *computeSliceThread(void *argument) {
+    computeSlice(argument);
+    limbPoolTrim(); // The thread ends, its cached limbs would be lost.
+    return NULL;
+}
+#endif
+
+/**
+ * Run a round of primes, an image per thread.
+ */
+static void computeRound(GcdImage *images, int threadCount) {
+#ifdef FLUXION_THREADS
+    if (threadCount > 1) {
+        GcdSlice *slices = (GcdSlice *) malloc(sizeof(GcdSlice) * threadCount);
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * threadCount);
+        int i, started = 0;
+        for (i = 0; i < threadCount; i++) {
+            slices[i].images = images + i;
+            slices[i].count = 1;
+        }
+        for (i = 1; i < threadCount; i++) {
+            if (pthread_create(threads + i, NULL, computeSliceThread, slices + i) != 0) {
+                break;
+            }
+            started = i;
+        }
+        computeSlice(slices);
+        for (i = started + 1; i < threadCount; i++) { // Threads that could not start run here.
+            computeSlice(slices + i);
+        }
+        for (i = 1; i <= started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(slices);
+        return;
+    }
+#endif
+    GcdSlice whole = {images, (size_t) threadCount};
+    computeSlice(&whole);
+}
+
+static int resolveThreads(int threadCount, const Polynomial *a, const Polynomial *b) {
+#ifdef FLUXION_THREADS
+    if (threadCount <= 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? (int) processors : 1;
+    }
+    return a->count + b->count < GCD_THREAD_THRESHOLD ? 1 : threadCount;
+#else
+    (void) threadCount;
+    (void) a;
+    (void) b;
+    return 1;
+#endif
+}
+
+/**
+ * A polynomial with integer coefficients known modulo a growing product of primes.
+ */
+typedef struct {
+    BigInt modulus;
+    size_t count;
+    uint64_t *monomials;
+    BigInt *values; // In [0, modulus).
+} GcdReconstruction;
+
+static void initGcdReconstruction(GcdReconstruction *reconstruction) {
+    initBigInt(&reconstruction->modulus);
+    bigIntSetInt64(&reconstruction->modulus, 1);
+    reconstruction->count = 0;
+    reconstruction->monomials = NULL;
+    reconstruction->values = NULL;
+}
+
+static void freeGcdReconstruction(GcdReconstruction *reconstruction) {
+    size_t i;
+    for (i = 0; i < reconstruction->count; i++) {
+        freeBigInt(reconstruction->values + i);
+    }
+    free(reconstruction->values);
+    free(reconstruction->monomials);
+    freeBigInt(&reconstruction->modulus);
+}
+
+/**
+ * Add an image scaled by a factor, x + modulus * ((r - x) / modulus mod prime)
+ * for every monomial of either, missing coefficients being 0.
+ */
+static void foldImage(GcdReconstruction *reconstruction, const ModularPolynomial *image, uint64_t factor,
+                      uint64_t prime) {
+    size_t capacity = reconstruction->count + image->count, count = 0, i = 0, j = 0;
+    uint64_t *monomials = (uint64_t *) malloc(sizeof(uint64_t) * (capacity + 1)), inverse;
+    BigInt *values = (BigInt *) malloc(sizeof(BigInt) * (capacity + 1)), step;
+    initBigInt(&step);
+    inverseModulo(integerModulo(&reconstruction->modulus, prime), prime, &inverse);
+    uint64_t shoup = shoupFactor(inverse, prime), factorShoup = shoupFactor(factor, prime);
+    while (i < reconstruction->count || j < image->count) {
+        BigInt *value = values + count;
+        uint64_t residue = 0;
+        initBigInt(value);
+        if (j == image->count || (i < reconstruction->count && reconstruction->monomials[i] > image->monomials[j])) {
+            monomials[count] = reconstruction->monomials[i];
+            bigIntMove(value, reconstruction->values + i++);
+        } else {
+            monomials[count] = image->monomials[j];
+            residue = shoupMultiply(image->coefficients[j++], factor, factorShoup, prime);
+            if (i < reconstruction->count && reconstruction->monomials[i] == monomials[count]) {
+                bigIntMove(value, reconstruction->values + i++);
+            }
+        }
+        uint64_t difference = subtractModulo(residue, integerModulo(value, prime), prime);
+        bigIntSetUint64(&step, shoupMultiply(difference, inverse, shoup, prime));
+        bigIntMultiply(&step, &step, &reconstruction->modulus);
+        bigIntAdd(value, value, &step);
+        if (bigIntIsZero(value)) {
+            freeBigInt(value);
+        } else {
+            count++;
+        }
+    }
+    for (i = 0; i < reconstruction->count; i++) {
+        freeBigInt(reconstruction->values + i);
+    }
+    free(reconstruction->values);
+    free(reconstruction->monomials);
+    reconstruction->monomials = monomials;
+    reconstruction->values = values;
+    reconstruction->count = count;
+    bigIntSetUint64(&step, prime);
+    bigIntMultiply(&reconstruction->modulus, &reconstruction->modulus, &step);
+    freeBigInt(&step);
+}
+
+static Polynomial *constantIn(const Polynomial *polynomial, int64_t value) {
+    Polynomial *result = emptyLike(polynomial);
+    BigInt coefficient;
+    initBigInt(&coefficient);
+    bigIntSetInt64(&coefficient, value);
+    polynomialAppendTerm(result, 0, &coefficient);
+    return result;
+}
+
+static bool isConstant(const Polynomial *polynomial) {
+    return polynomial->count == 0 || (polynomial->count == 1 && polynomial->monomials[0] == 0);
+}
+
+static bool isOne(const Polynomial *polynomial) {
+    return isConstant(polynomial) && polynomial->count == 1 &&
+           bigIntCompare(polynomial->coefficients, &polynomial->denominator) == 0;
+}
+
+/**
+ * Drop the denominator and divide by the gcd of the coefficients, made positive at the leading term.
+ */
+static void makePrimitive(Polynomial *polynomial) {
+    BigInt content;
+    size_t i;
+    initBigInt(&content);
+    for (i = 0; i < polynomial->count; i++) {
+        bigIntGcd(&content, &content, polynomial->coefficients + i);
+    }
+    if (polynomial->count > 0 && polynomial->coefficients[0].negative) {
+        bigIntNegate(&content, &content);
+    }
+    for (i = 0; i < polynomial->count; i++) {
+        bigIntDivideExact(polynomial->coefficients + i, polynomial->coefficients + i, &content);
+    }
+    bigIntSetInt64(&polynomial->denominator, 1);
+    freeBigInt(&content);
+}
+
+/**
+ * Symmetric lift of a reconstruction, made primitive.
+ * @param bits Set to the bits of the largest coefficient lifted.
+ */
+static Polynomial *liftCandidate(const GcdReconstruction *reconstruction, const Polynomial *like, size_t *bits) {
+    Polynomial *candidate = emptyLike(like);
+    BigInt doubled, value;
+    size_t i;
+    initBigInt(&doubled);
+    initBigInt(&value);
+    *bits = 0;
+    for (i = 0; i < reconstruction->count; i++) {
+        bigIntCopy(&value, reconstruction->values + i);
+        bigIntShiftLeft(&doubled, &value, 1);
+        if (bigIntCompare(&doubled, &reconstruction->modulus) > 0) {
+            bigIntSubtract(&value, &value, &reconstruction->modulus);
+        }
+        *bits = bigIntBitLength(&value) > *bits ? bigIntBitLength(&value) : *bits;
+        polynomialAppendTerm(candidate, reconstruction->monomials[i], &value);
+    }
+    freeBigInt(&doubled);
+    makePrimitive(candidate);
+    return candidate;
+}
+
+/**
+ * Divide integer coefficients exactly, denominators are ignored.
+ * @return the quotient, NULL if b does not divide a.
+ */
+static Polynomial *divideIntegers(const Polynomial *a, const Polynomial *b) {
+    uint32_t count = a->variableCount, v;
+    uint64_t maxB[POLY_MAX_VARIABLES] = {0};
+    size_t i, j;
+    for (i = 0; i < b->count; i++) {
+        for (v = 0; v < count; v++) {
+            uint64_t exponent = monomialExponent(b->monomials[i], count, v);
+            maxB[v] = exponent > maxB[v] ? exponent : maxB[v];
+        }
+    }
+    Polynomial *quotient = emptyLike(a), *remainder = copyPolynomial(a);
+    BigInt factor, rest, product;
+    initBigInt(&factor);
+    initBigInt(&rest);
+    initBigInt(&product);
+    bool divides = true;
+    while (remainder->count > 0 && divides) {
+        uint64_t lead = remainder->monomials[0];
+        for (v = 0; v < count && divides; v++) {
+            uint64_t exponent = monomialExponent(lead, count, v), leadB = monomialExponent(b->monomials[0], count, v);
+            divides = exponent >= leadB && exponent - leadB <= monomialFieldMax(count) - maxB[v];
+        }
+        if (!divides || !bigIntDivide(&factor, &rest, remainder->coefficients, b->coefficients) ||
+            !bigIntIsZero(&rest)) {
+            divides = false;
+            break;
+        }
+        uint64_t shift = lead - b->monomials[0];
+        Polynomial *next = emptyLike(a);
+        for (i = 1, j = 1; i < remainder->count || j < b->count;) { // The leading terms cancel.
+            uint64_t monomialB = j < b->count ? b->monomials[j] + shift : 0;
+            if (j == b->count || (i < remainder->count && remainder->monomials[i] > monomialB)) {
+                polynomialAppendTerm(next, remainder->monomials[i], remainder->coefficients + i);
+                i++;
+            } else {
+                bigIntMultiply(&product, &factor, b->coefficients + j++);
+                if (i < remainder->count && remainder->monomials[i] == monomialB) {
+                    bigIntSubtract(&product, remainder->coefficients + i++, &product);
+                } else {
+                    bigIntNegate(&product, &product);
+                }
+                polynomialAppendTerm(next, monomialB, &product);
+            }
+        }
+        polynomialAppendTerm(quotient, shift, &factor);
+        freePolynomial(remainder);
+        remainder = next;
+    }
+    freeBigInt(&product);
+    freeBigInt(&rest);
+    freeBigInt(&factor);
+    freePolynomial(remainder);
+    if (!divides) {
+        freePolynomial(quotient);
+        return NULL;
+    }
+    return quotient;
+}
+
+static bool dividesIntegers(const Polynomial *a, const Polynomial *b) {
+    Polynomial *quotient = divideIntegers(a, b);
+    freePolynomial(quotient);
+    return quotient != NULL;
+}
+
+Polynomial *polynomialGcd(const Polynomial *a, const Polynomial *b, int threadCount) {
+    Polynomial *x, *y;
+    if (!polynomialAlign(a, b, &x, &y)) {
+        return NULL;
+    }
+    makePrimitive(x);
+    makePrimitive(y);
+    if (x->count == 0 || y->count == 0) {
+        Polynomial *zero = x->count == 0 ? x : y, *other = zero == x ? y : x;
+        freePolynomial(zero);
+        return other;
+    }
+    if (isConstant(x) || isConstant(y) || polynomialEqual(x, y)) {
+        Polynomial *result = isConstant(x) || isConstant(y) ? constantIn(x, 1) : copyPolynomial(x);
+        freePolynomial(x);
+        freePolynomial(y);
+        return result;
+    }
+    // The gcd divides both leading terms, so gamma / lc(g) g has integer coefficients
+    // and its images are gamma times the monic images.
+    BigInt gamma;
+    initBigInt(&gamma);
+    bigIntGcd(&gamma, x->coefficients, y->coefficients);
+    threadCount = resolveThreads(threadCount, x, y);
+    GcdImage *images = (GcdImage *) malloc(sizeof(GcdImage) * threadCount);
+    GcdReconstruction reconstruction;
+    initGcdReconstruction(&reconstruction);
+    Polynomial *result = NULL, *previous = NULL;
+    uint64_t prime = (uint64_t) 1 << MODULAR_PRIME_BITS, leading = 0;
+    size_t tried, bits;
+    int k;
+    for (tried = 0; result == NULL && tried < GCD_MAX_PRIMES; tried += (size_t) threadCount) {
+        for (k = 0; k < threadCount; k++) {
+            prime = modularPrimeBelow(prime);
+            images[k].a = x;
+            images[k].b = y;
+            images[k].prime = prime;
+        }
+        computeRound(images, threadCount);
+        bool coprime = false;
+        for (k = 0; k < threadCount; k++) {
+            ModularPolynomial *image = &images[k].image;
+            if (images[k].usable && !coprime) {
+                coprime = image->monomials[0] == 0;
+                if (reconstruction.count > 0 && image->monomials[0] < leading) { // Earlier primes were unlucky.
+                    freeGcdReconstruction(&reconstruction);
+                    initGcdReconstruction(&reconstruction);
+                    freePolynomial(previous);
+                    previous = NULL;
+                }
+                if (reconstruction.count == 0 || image->monomials[0] == leading) {
+                    leading = image->monomials[0];
+                    foldImage(&reconstruction, image, integerModulo(&gamma, images[k].prime), images[k].prime);
+                }
+            }
+            freeModular(image);
+        }
+        if (coprime) {
+            result = constantIn(x, 1);
+            break;
+        }
+        if (reconstruction.count == 0) {
+            continue;
+        }
+        Polynomial *candidate = liftCandidate(&reconstruction, x, &bits);
+        bool settled = (previous != NULL && polynomialEqual(candidate, previous)) ||
+                       bits + GCD_LIFT_SLACK < bigIntBitLength(&reconstruction.modulus);
+        if (settled && dividesIntegers(x, candidate) && dividesIntegers(y, candidate)) {
+            result = candidate;
+        } else {
+            freePolynomial(previous);
+            previous = candidate;
+        }
+    }
+    freePolynomial(previous);
+    freeGcdReconstruction(&reconstruction);
+    free(images);
+    freeBigInt(&gamma);
+    freePolynomial(x);
+    freePolynomial(y);
+    return result;
+}
+
+/**
+ * Multiply by an exact number, taken.
+ */
+static Polynomial *multiplyNumber(const Polynomial *polynomial, Number number) {
+    Polynomial *constant = polynomialFromNumber(number);
+    Polynomial *product = constant != NULL ? polynomialMultiply(polynomial, constant) : NULL;
+    freePolynomial(constant);
+    freeNumber(number);
+    return product;
+}
+
+Polynomial *polynomialDivideExact(const Polynomial *a, const Polynomial *b) {
+    Polynomial *x, *y;
+    if (b->count == 0 || !polynomialAlign(a, b, &x, &y)) {
+        return NULL;
+    }
+    // a = X / dx and b = c Y / dy for Y primitive, X / Y has integer coefficients if it is a polynomial.
+    BigInt numerator, denominator;
+    initBigInt(&numerator);
+    initBigInt(&denominator);
+    bigIntCopy(&numerator, &y->denominator);
+    bigIntCopy(&denominator, &x->denominator);
+    BigInt content;
+    initBigInt(&content);
+    size_t i;
+    for (i = 0; i < y->count; i++) {
+        bigIntGcd(&content, &content, y->coefficients + i);
+    }
+    bigIntMultiply(&denominator, &denominator, &content);
+    makePrimitive(y);
+    if (y->coefficients[0].negative != b->coefficients[0].negative) {
+        bigIntNegate(&numerator, &numerator);
+    }
+    freeBigInt(&content);
+    Polynomial *quotient = divideIntegers(x, y), *result = NULL;
+    if (quotient != NULL) {
+        result = multiplyNumber(quotient, numberFromRational(&numerator, &denominator));
+        freePolynomial(quotient);
+    } else {
+        freeBigInt(&numerator);
+        freeBigInt(&denominator);
+    }
+    freePolynomial(x);
+    freePolynomial(y);
+    return result;
+}
+
+/**
+ * Make the denominator primitive with a positive leading coefficient, its factor moved to the numerator.
+ * @return the function, NULL if a product does not fit.
+ */
+static RationalFunction *settleDenominator(Polynomial *numerator, Polynomial *denominator) {
+    BigInt scaleNumerator, scaleDenominator;
+    initBigInt(&scaleNumerator);
+    initBigInt(&scaleDenominator);
+    bigIntCopy(&scaleNumerator, &denominator->denominator);
+    size_t i;
+    for (i = 0; i < denominator->count; i++) {
+        bigIntGcd(&scaleDenominator, &scaleDenominator, denominator->coefficients + i);
+    }
+    if (denominator->coefficients[0].negative) {
+        bigIntNegate(&scaleDenominator, &scaleDenominator);
+    }
+    makePrimitive(denominator);
+    Polynomial *scaled = multiplyNumber(numerator, numberFromRational(&scaleNumerator, &scaleDenominator));
+    freePolynomial(numerator);
+    if (scaled == NULL) {
+        freePolynomial(denominator);
+        return NULL;
+    }
+    RationalFunction *function = (RationalFunction *) malloc(sizeof(RationalFunction));
+    function->numerator = scaled;
+    function->denominator = denominator;
+    return function;
+}
+
+/**
+ * Divide both by a common factor, unless it is a constant.
+ */
+static void cancelFactor(Polynomial **numerator, Polynomial **denominator, const Polynomial *factor) {
+    if (factor == NULL || isConstant(factor)) {
+        return;
+    }
+    Polynomial *x = polynomialDivideExact(*numerator, factor), *y = polynomialDivideExact(*denominator, factor);
+    if (x != NULL && y != NULL) {
+        freePolynomial(*numerator);
+        freePolynomial(*denominator);
+        *numerator = x;
+        *denominator = y;
+    } else {
+        freePolynomial(x);
+        freePolynomial(y);
+    }
+}
+
+RationalFunction *initRationalFunction(Polynomial *numerator, Polynomial *denominator) {
+    if (numerator == NULL || denominator == NULL || denominator->count == 0) {
+        freePolynomial(numerator);
+        freePolynomial(denominator);
+        return NULL;
+    }
+    if (numerator->count == 0) {
+        freePolynomial(denominator);
+        denominator = constantIn(numerator, 1);
+    } else if (!isConstant(denominator)) {
+        Polynomial *divisor = polynomialGcd(numerator, denominator, 0);
+        cancelFactor(&numerator, &denominator, divisor);
+        freePolynomial(divisor);
+    }
+    return settleDenominator(numerator, denominator);
+}
+
+void freeRationalFunction(RationalFunction *function) {
+    if (function == NULL) {
+        return;
+    }
+    freePolynomial(function->numerator);
+    freePolynomial(function->denominator);
+    free(function);
+}
+
+/**
+ * Product of two polynomials, NULL if either is.
+ */
+static Polynomial *multiplyOrNull(const Polynomial *a, const Polynomial *b) {
+    return a != NULL && b != NULL ? polynomialMultiply(a, b) : NULL;
+}
+
+/**
+ * a / b + c / d with g = gcd(b, d): (a d / g + c b / g) / (b d / g), whose
+ * only common factors can be those of the sum with g.
+ */
+static RationalFunction *addFunctions(const RationalFunction *a, const RationalFunction *b, bool subtract) {
+    Polynomial *divisor = polynomialGcd(a->denominator, b->denominator, 0);
+    if (divisor == NULL) {
+        return NULL;
+    }
+    Polynomial *reducedA = polynomialDivideExact(a->denominator, divisor);
+    Polynomial *reducedB = polynomialDivideExact(b->denominator, divisor);
+    Polynomial *left = multiplyOrNull(a->numerator, reducedB), *right = multiplyOrNull(b->numerator, reducedA);
+    Polynomial *sum = left != NULL && right != NULL ? subtract ? polynomialSubtract(left, right)
+                                                               : polynomialAdd(left, right) : NULL;
+    Polynomial *denominator = multiplyOrNull(a->denominator, reducedB);
+    if (sum != NULL && denominator != NULL && sum->count > 0 && !isConstant(divisor)) {
+        Polynomial *common = polynomialGcd(sum, divisor, 0);
+        cancelFactor(&sum, &denominator, common);
+        freePolynomial(common);
+    }
+    freePolynomial(left);
+    freePolynomial(right);
+    freePolynomial(reducedA);
+    freePolynomial(reducedB);
+    freePolynomial(divisor);
+    if (sum == NULL || denominator == NULL) {
+        freePolynomial(sum);
+        freePolynomial(denominator);
+        return NULL;
+    }
+    if (sum->count == 0) {
+        freePolynomial(denominator);
+        denominator = constantIn(sum, 1);
+    }
+    return settleDenominator(sum, denominator);
+}
+
+RationalFunction *rationalFunctionAdd(const RationalFunction *a, const RationalFunction *b) {
+    return addFunctions(a, b, false);
+}
+
+RationalFunction *rationalFunctionSubtract(const RationalFunction *a, const RationalFunction *b) {
+    return addFunctions(a, b, true);
+}
+
+/**
+ * (a / b) (c / d) with the gcds of a and d and of c and b taken out first.
+ * @param invert Whether to multiply by d / c instead.
+ */
+static RationalFunction *multiplyFunctions(const RationalFunction *a, const RationalFunction *b, bool invert) {
+    const Polynomial *numeratorB = invert ? b->denominator : b->numerator;
+    const Polynomial *denominatorB = invert ? b->numerator : b->denominator;
+    if (denominatorB->count == 0) {
+        return NULL;
+    }
+    Polynomial *x = copyPolynomial(a->numerator), *y = copyPolynomial(a->denominator);
+    Polynomial *z = copyPolynomial(numeratorB), *w = copyPolynomial(denominatorB);
+    Polynomial *first = polynomialGcd(x, w, 0), *second = polynomialGcd(z, y, 0);
+    cancelFactor(&x, &w, first);
+    cancelFactor(&z, &y, second);
+    freePolynomial(first);
+    freePolynomial(second);
+    Polynomial *numerator = polynomialMultiply(x, z), *denominator = polynomialMultiply(y, w);
+    freePolynomial(x);
+    freePolynomial(y);
+    freePolynomial(z);
+    freePolynomial(w);
+    if (numerator == NULL || denominator == NULL) {
+        freePolynomial(numerator);
+        freePolynomial(denominator);
+        return NULL;
+    }
+    if (numerator->count == 0) {
+        freePolynomial(denominator);
+        denominator = constantIn(numerator, 1);
+    }
+    return settleDenominator(numerator, denominator);
+}
+
+RationalFunction *rationalFunctionMultiply(const RationalFunction *a, const RationalFunction *b) {
+    return multiplyFunctions(a, b, false);
+}
+
+RationalFunction *rationalFunctionDivide(const RationalFunction *a, const RationalFunction *b) {
+    return multiplyFunctions(a, b, true);
+}
+
+RationalFunction *rationalFunctionPower(const RationalFunction *base, int64_t exponent) {
+    const Polynomial *numerator = exponent < 0 ? base->denominator : base->numerator;
+    const Polynomial *denominator = exponent < 0 ? base->numerator : base->denominator;
+    if (denominator->count == 0) {
+        return NULL;
+    }
+    uint64_t magnitude = exponent < 0 ? (uint64_t) -(exponent + 1) + 1 : (uint64_t) exponent;
+    Polynomial *x = polynomialPower(numerator, magnitude), *y = polynomialPower(denominator, magnitude);
+    if (x == NULL || y == NULL) { // Powers of coprime polynomials stay coprime.
+        freePolynomial(x);
+        freePolynomial(y);
+        return NULL;
+    }
+    return settleDenominator(x, y);
+}
+
+/**
+ * The integer value of a constant function.
+ * @return false if it is not one or is beyond limit.
+ */
+static bool constantInteger(const RationalFunction *function, int64_t limit, int64_t *value) {
+    const Polynomial *numerator = function->numerator;
+    if (!isOne(function->denominator) || !isConstant(numerator)) {
+        return false;
+    }
+    if (numerator->count == 0) {
+        *value = 0;
+        return true;
+    }
+    if (numerator->denominator.size != 1 || numerator->denominator.limbs[0] != 1 ||
+        !bigIntFitsInt64(numerator->coefficients)) {
+        return false;
+    }
+    *value = bigIntToInt64(numerator->coefficients);
+    return *value >= -limit && *value <= limit;
+}
+
+/**
+ * Rational function of a node, given the functions of its children.
+ */
+static RationalFunction *functionStep(const NodePool *pool, NodeId node, const NodeSubtree *subtree,
+                                      RationalFunction *const *values) {
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER || tag == NODE_SYMBOL) {
+        Polynomial *numerator;
+        if (tag == NODE_NUMBER) {
+            numerator = polynomialFromNumber(nodeNumberOf(pool, node));
+        } else {
+            BigInt coefficients[2];
+            initBigInt(coefficients);
+            initBigInt(coefficients + 1);
+            bigIntSetInt64(coefficients + 1, 1);
+            numerator = polynomialFromDense(nodeSymbolOf(pool, node), coefficients, 2);
+            freeBigInt(coefficients + 1);
+        }
+        return numerator != NULL ? initRationalFunction(numerator, constantIn(numerator, 1)) : NULL;
+    }
+    if (!nodeIsOperator(pool, node)) {
+        return NULL;
+    }
+    const RationalFunction *a = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 0))];
+    if (a == NULL) {
+        return NULL;
+    }
+    if (nodeChildCount(pool, node) == 1) {
+        if (tag != PLUS && tag != MINUS) {
+            return NULL;
+        }
+        Polynomial *zero = emptyLike(a->numerator);
+        Polynomial *numerator = tag == PLUS ? copyPolynomial(a->numerator) : polynomialSubtract(zero, a->numerator);
+        freePolynomial(zero);
+        return initRationalFunction(numerator, copyPolynomial(a->denominator));
+    }
+    const RationalFunction *b = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 1))];
+    if (b == NULL) {
+        return NULL;
+    }
+    int64_t exponent;
+    switch ((OperatorType) tag) {
+        case PLUS:
+            return rationalFunctionAdd(a, b);
+        case MINUS:
+            return rationalFunctionSubtract(a, b);
+        case MULTIPLY:
+            return rationalFunctionMultiply(a, b);
+        case DIVIDE:
+            return rationalFunctionDivide(a, b);
+        case POWER:
+            if (!constantInteger(b, POLY_MAX_DENSE, &exponent)) {
+                return NULL;
+            }
+            return rationalFunctionPower(a, exponent);
+        default:
+            return NULL;
+    }
+}
+
+RationalFunction *rationalFunctionFromNode(const NodePool *pool, NodeId node) {
+    if (node == NODE_NONE) {
+        return NULL;
+    }
+    NodeSubtree subtree; // Children before their parents, so each is converted after its children.
+    initNodeSubtree(&subtree, pool, node, false);
+    RationalFunction **values = (RationalFunction **) malloc(sizeof(RationalFunction *) * subtree.count);
+    RationalFunction *result = NULL; // The root, which comes last.
+    uint32_t i;
+    for (i = 0; i < subtree.count; i++) {
+        result = values[i] = functionStep(pool, subtree.nodes[i], &subtree, values);
+    }
+    for (i = 0; i + 1 < subtree.count; i++) {
+        freeRationalFunction(values[i]);
+    }
+    free(values);
+    freeNodeSubtree(&subtree);
+    return result;
+}
+
+NodeId rationalFunctionToNode(NodePool *pool, const RationalFunction *function, int lineCount) {
+    NodeId numerator = polynomialToNode(pool, function->numerator, lineCount);
+    if (isOne(function->denominator)) {
+        return numerator;
+    }
+    return nodeBinary(pool, lineCount, DIVIDE, numerator, polynomialToNode(pool, function->denominator, lineCount));
+}
+
+NodeId simplifyRationalNode(NodePool *pool, NodeId node) {
+    RationalFunction *function = rationalFunctionFromNode(pool, node);
+    if (function == NULL) {
+        return node;
+    }
+    NodeId simplified = rationalFunctionToNode(pool, function, nodeLine(pool, node));
+    freeRationalFunction(function);
+    return simplified;
+}
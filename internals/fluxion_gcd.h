@@ -0,0 +1,75 @@
+//
+// Polynomial GCDs by modular algorithms, and rational functions kept in lowest terms.
+//
+
+#ifndef FLUXIONCORE_FLUXION_GCD_H
+#define FLUXIONCORE_FLUXION_GCD_H
+#include "fluxion_poly.h"
+
+#define GCD_THREAD_THRESHOLD 64 // Terms of both inputs below which the primes of a round stay on one thread.
+#define GCD_MAX_PRIMES 1024 // Primes tried before giving up, only reached when exponents do not fit.
+
+/**
+ * Greatest common divisor. The inputs are made primitive over the integers,
+ * then their gcd is computed modulo word primes, several at once on threads,
+ * and joined by the CRT until the candidate divides both. Modulo a prime,
+ * Brown's algorithm evaluates the last variable at points, recurses and
+ * interpolates the images, down to Euclid's algorithm in the first variable.
+ * No coefficient grows beyond those of the result.
+ * @param threadCount Threads for the primes of a round, 0 for one per processor.
+ * @return the gcd, with integer coefficients, primitive and a positive leading
+ * coefficient, zero if both are zero, NULL if the variables or exponents do not fit.
+ */
+Polynomial *polynomialGcd(const Polynomial *a, const Polynomial *b, int threadCount);
+/**
+ * Divide when the quotient is a polynomial.
+ * @return the quotient, NULL if b does not divide a or is zero.
+ */
+Polynomial *polynomialDivideExact(const Polynomial *a, const Polynomial *b);
+
+/**
+ * A quotient of polynomials in lowest terms, every operation keeps it so.
+ * Sums only take the gcd of the denominators and of the sum with it, and
+ * products the gcds across numerators and denominators, as Henrici's
+ * algorithms do, which are smaller than the gcd of the unreduced result.
+ */
+typedef struct {
+    Polynomial *numerator; // Holds the rational content.
+    Polynomial *denominator; // Integer coefficients, primitive, with a positive leading coefficient.
+} RationalFunction;
+
+/**
+ * Create a rational function, reduced to lowest terms.
+ * @param numerator Taken.
+ * @param denominator Taken.
+ * @return the function, NULL if the denominator is zero or a gcd does not fit.
+ */
+RationalFunction *initRationalFunction(Polynomial *numerator, Polynomial *denominator);
+void freeRationalFunction(RationalFunction *function);
+
+/*
+ * Arithmetic, the result is a new rational function, NULL on division by zero or if an exponent does not fit.
+ */
+RationalFunction *rationalFunctionAdd(const RationalFunction *a, const RationalFunction *b);
+RationalFunction *rationalFunctionSubtract(const RationalFunction *a, const RationalFunction *b);
+RationalFunction *rationalFunctionMultiply(const RationalFunction *a, const RationalFunction *b);
+RationalFunction *rationalFunctionDivide(const RationalFunction *a, const RationalFunction *b);
+RationalFunction *rationalFunctionPower(const RationalFunction *base, int64_t exponent);
+
+/**
+ * Convert an expression to a rational function. Sums, differences, products,
+ * quotients and powers to integer numbers of exact numbers and symbols are.
+ * @return the function, NULL if the expression is not one.
+ */
+RationalFunction *rationalFunctionFromNode(const NodePool *pool, NodeId node);
+/**
+ * Convert a rational function back to an expression, the numerator over the denominator.
+ */
+NodeId rationalFunctionToNode(NodePool *pool, const RationalFunction *function, int lineCount);
+/**
+ * Bring an expression that is a rational function to lowest terms.
+ * @return the simplified node, node itself if it is not a rational function.
+ */
+NodeId simplifyRationalNode(NodePool *pool, NodeId node);
+
+#endif //FLUXIONCORE_FLUXION_GCD_H
@@ -0,0 +1,248 @@
+//
+// Single pass, table driven lexer.
+//
+
+#include <string.h>
+#include "fluxion_lexer.h"
+#include "fluxion_scan.h"
+
+/**
+ * Character classes, the lexer dispatches on these once per token.
+ */
+typedef enum {
+    CLASS_INVALID,
+    CLASS_END,
+    CLASS_WHITESPACE,
+    CLASS_NEWLINE,
+    CLASS_DIGIT,
+    CLASS_LETTER,
+    CLASS_OPERATOR,
+    CLASS_PUNCTUATION,
+    CLASS_SEMICOLON
+} CharClass;
+
+#define LETTER(c) [c] = CLASS_LETTER
+#define HIGH_BYTES_16(b) [b] = CLASS_LETTER, [b + 1] = CLASS_LETTER, [b + 2] = CLASS_LETTER, [b + 3] = CLASS_LETTER, \
+    [b + 4] = CLASS_LETTER, [b + 5] = CLASS_LETTER, [b + 6] = CLASS_LETTER, [b + 7] = CLASS_LETTER, \
+    [b + 8] = CLASS_LETTER, [b + 9] = CLASS_LETTER, [b + 10] = CLASS_LETTER, [b + 11] = CLASS_LETTER, \
+    [b + 12] = CLASS_LETTER, [b + 13] = CLASS_LETTER, [b + 14] = CLASS_LETTER, [b + 15] = CLASS_LETTER
+
+static const uint8_t charClasses[256] = {
+        ['\0'] = CLASS_END,
+        [' '] = CLASS_WHITESPACE, ['\t'] = CLASS_WHITESPACE, ['\r'] = CLASS_WHITESPACE,
+        ['\n'] = CLASS_NEWLINE,
+        ['0'] = CLASS_DIGIT, ['1'] = CLASS_DIGIT, ['2'] = CLASS_DIGIT, ['3'] = CLASS_DIGIT, ['4'] = CLASS_DIGIT,
+        ['5'] = CLASS_DIGIT, ['6'] = CLASS_DIGIT, ['7'] = CLASS_DIGIT, ['8'] = CLASS_DIGIT, ['9'] = CLASS_DIGIT,
+        LETTER('a'), LETTER('b'), LETTER('c'), LETTER('d'), LETTER('e'),
+        LETTER('f'), LETTER('g'), LETTER('h'), LETTER('i'), LETTER('j'),
+        LETTER('k'), LETTER('l'), LETTER('m'), LETTER('n'), LETTER('o'),
+        LETTER('p'), LETTER('q'), LETTER('r'), LETTER('s'), LETTER('t'),
+        LETTER('u'), LETTER('v'), LETTER('w'), LETTER('x'), LETTER('y'),
+        LETTER('z'),
+        LETTER('A'), LETTER('B'), LETTER('C'), LETTER('D'), LETTER('E'),
+        LETTER('F'), LETTER('G'), LETTER('H'), LETTER('I'), LETTER('J'),
+        LETTER('K'), LETTER('L'), LETTER('M'), LETTER('N'), LETTER('O'),
+        LETTER('P'), LETTER('Q'), LETTER('R'), LETTER('S'), LETTER('T'),
+        LETTER('U'), LETTER('V'), LETTER('W'), LETTER('X'), LETTER('Y'),
+        LETTER('Z'),
+        // Every byte of a multibyte UTF-8 sequence is a letter, so names like α work.
+        HIGH_BYTES_16(0x80), HIGH_BYTES_16(0x90), HIGH_BYTES_16(0xA0), HIGH_BYTES_16(0xB0),
+        HIGH_BYTES_16(0xC0), HIGH_BYTES_16(0xD0), HIGH_BYTES_16(0xE0), HIGH_BYTES_16(0xF0),
+        ['+'] = CLASS_OPERATOR, ['-'] = CLASS_OPERATOR, ['*'] = CLASS_OPERATOR, ['/'] = CLASS_OPERATOR,
+        ['^'] = CLASS_OPERATOR, ['!'] = CLASS_OPERATOR, ['_'] = CLASS_OPERATOR, ['\''] = CLASS_OPERATOR,
+        ['&'] = CLASS_OPERATOR, ['|'] = CLASS_OPERATOR, ['='] = CLASS_OPERATOR, ['<'] = CLASS_OPERATOR,
+        ['>'] = CLASS_OPERATOR, [':'] = CLASS_OPERATOR, ['\\'] = CLASS_OPERATOR,
+        ['('] = CLASS_PUNCTUATION, [')'] = CLASS_PUNCTUATION, ['{'] = CLASS_PUNCTUATION,
+        ['}'] = CLASS_PUNCTUATION, ['['] = CLASS_PUNCTUATION, [']'] = CLASS_PUNCTUATION,
+        [','] = CLASS_PUNCTUATION,
+        [';'] = CLASS_SEMICOLON
+};
+
+static const uint8_t punctuationKinds[128] = {
+        ['('] = LEX_LEFT_PAREN, [')'] = LEX_RIGHT_PAREN, ['{'] = LEX_LEFT_BRACE, ['}'] = LEX_RIGHT_BRACE,
+        ['['] = LEX_LEFT_BRACKET, [']'] = LEX_RIGHT_BRACKET, [','] = LEX_COMMA
+};
+
+#define NO_OPERATOR 0xFF
+
+/**
+ * Operator DFA, state 0 is the start state, the others are the states
+ * after a character that may begin a two character operator.
+ * Accepting states map to OperatorType, NO_OPERATOR if the state rejects.
+ */
+typedef enum {
+    STATE_START,
+    STATE_MINUS, // - or ->
+    STATE_LESS, // < or <=
+    STATE_GREATER, // > or >=
+    STATE_BACKSLASH, // \ or \= or \\ (line continuation)
+    STATE_COLON, // :: or :=
+    STATE_COUNT
+} OperatorState;
+
+#define STATE_CONTINUATION 0xFE // Accepting value of \\.
+
+static const uint8_t operatorStarts[128] = {
+        ['+'] = PLUS + 1, ['*'] = MULTIPLY + 1, ['/'] = DIVIDE + 1, ['^'] = POWER + 1,
+        ['!'] = FACTORIAL + 1, ['_'] = GET + 1, ['\''] = DIFF + 1, ['&'] = AMPERSAND + 1,
+        ['|'] = BAR + 1, ['='] = EQUAL + 1
+};
+
+static const uint8_t operatorStates[128] = {
+        ['-'] = STATE_MINUS, ['<'] = STATE_LESS, ['>'] = STATE_GREATER,
+        ['\\'] = STATE_BACKSLASH, [':'] = STATE_COLON
+};
+
+// What a state accepts when the next character does not continue it.
+static const uint8_t stateAccepts[STATE_COUNT] = {
+        [STATE_START] = NO_OPERATOR, [STATE_MINUS] = MINUS, [STATE_LESS] = LESS,
+        [STATE_GREATER] = GREATER, [STATE_BACKSLASH] = NOT, [STATE_COLON] = NO_OPERATOR
+};
+
+// What a state accepts when the next character continues it, 0 if it does not.
+static const uint8_t stateTransitions[STATE_COUNT][128] = {
+        [STATE_MINUS] = {['>'] = LIMIT + 1},
+        [STATE_LESS] = {['='] = LEQ + 1},
+        [STATE_GREATER] = {['='] = GEQ + 1},
+        [STATE_BACKSLASH] = {['='] = NEQ + 1, ['\\'] = STATE_CONTINUATION},
+        [STATE_COLON] = {[':'] = SCOPE + 1, ['='] = ASSIGN + 1}
+};
+
+static void pushToken(LexBuffer *buffer, LexKind kind, uint8_t operatorType, uint16_t flags,
+                      uint32_t offset, uint32_t length, int lineCount) {
+    if (buffer->count >= buffer->capacity) {
+        buffer->capacity *= 2;
+        buffer->tokens = (LexToken *) realloc(buffer->tokens, sizeof(LexToken) * buffer->capacity);
+    }
+    LexToken *token = buffer->tokens + buffer->count++;
+    token->kind = (uint8_t) kind;
+    token->operatorType = operatorType;
+    token->flags = flags;
+    token->offset = offset;
+    token->length = length;
+    token->lineCount = lineCount;
+}
+
+static void pushError(LexBuffer *buffer, const char *message, uint32_t offset, int lineCount) {
+    if (buffer->errorMessage == NULL) {
+        buffer->errorMessage = message;
+    }
+    pushToken(buffer, LEX_ERROR, 0, 0, offset, 1, lineCount);
+}
+
+LexBuffer *lexSource(const char *source) {
+    size_t sourceLength = strlen(source);
+    LexBuffer *buffer = (LexBuffer *) malloc(sizeof(LexBuffer));
+    buffer->capacity = (uint32_t) (sourceLength / 4) + 16; // Tokens are rarely shorter on average.
+    buffer->tokens = (LexToken *) malloc(sizeof(LexToken) * buffer->capacity);
+    buffer->count = 0;
+    buffer->errorMessage = NULL;
+
+    const uint8_t *start = (const uint8_t *) source;
+    const uint8_t *end = start + sourceLength;
+    const uint8_t *ch = start;
+    int lineCount = 1;
+    uint16_t flags = 0;
+    bool continuation = false; // Seen \\, the next new line is ignored.
+    while (true) {
+        const uint8_t *tokenStart = ch;
+        uint32_t offset = (uint32_t) (ch - start);
+        switch (charClasses[*ch]) {
+            case CLASS_END:
+                pushToken(buffer, LEX_EOF, 0, flags, offset, 0, lineCount);
+                return buffer;
+            case CLASS_WHITESPACE:
+                ch = scanWhitespace(ch + 1, end);
+                flags |= LEX_FLAG_SPACE_BEFORE;
+                continue;
+            case CLASS_NEWLINE:
+                ch++;
+                if (continuation) {
+                    continuation = false;
+                    flags |= LEX_FLAG_SPACE_BEFORE;
+                } else {
+                    pushToken(buffer, LEX_EOL, 0, flags, offset, 1, lineCount);
+                    flags = 0;
+                }
+                lineCount++;
+                continue;
+            case CLASS_DIGIT:
+                while (charClasses[*ch] == CLASS_DIGIT) {
+                    ch++;
+                }
+                if (*ch == '.' && charClasses[ch[1]] == CLASS_DIGIT) {
+                    ch++;
+                    while (charClasses[*ch] == CLASS_DIGIT) {
+                        ch++;
+                    }
+                }
+                pushToken(buffer, LEX_NUMBER, 0, flags, offset, (uint32_t) (ch - tokenStart), lineCount);
+                break;
+            case CLASS_LETTER:
+                ch = scanIdentifier(ch + 1, end);
+                if (ch - tokenStart == 2 && tokenStart[0] == 'i' && tokenStart[1] == 'n') {
+                    pushToken(buffer, LEX_OPERATOR, IN, flags, offset, 2, lineCount);
+                } else {
+                    pushToken(buffer, LEX_IDENTIFIER, 0, flags, offset, (uint32_t) (ch - tokenStart), lineCount);
+                }
+                break;
+            case CLASS_OPERATOR: {
+                uint8_t first = *ch++;
+                if (operatorStarts[first]) {
+                    pushToken(buffer, LEX_OPERATOR, operatorStarts[first] - 1, flags, offset, 1, lineCount);
+                    break;
+                }
+                uint8_t state = operatorStates[first];
+                uint8_t next = *ch < 128 ? stateTransitions[state][*ch] : 0;
+                if (next == STATE_CONTINUATION) {
+                    ch++;
+                    continuation = true;
+                    flags |= LEX_FLAG_SPACE_BEFORE;
+                    continue;
+                } else if (next) {
+                    ch++;
+                    pushToken(buffer, LEX_OPERATOR, next - 1, flags, offset, 2, lineCount);
+                } else if (stateAccepts[state] != NO_OPERATOR) {
+                    pushToken(buffer, LEX_OPERATOR, stateAccepts[state], flags, offset, 1, lineCount);
+                } else {
+                    pushError(buffer, ": operator is not defined on any type.", offset, lineCount);
+                }
+                break;
+            }
+            case CLASS_PUNCTUATION:
+                pushToken(buffer, (LexKind) punctuationKinds[*ch++], 0, flags, offset, 1, lineCount);
+                break;
+            case CLASS_SEMICOLON:
+                if (ch[1] == ';') { // Single line comment, the new line is kept.
+                    ch = scanNewline(ch + 2, end);
+                } else if (ch[1] == '*') { // Multi line comment, ends with *;
+                    ch = scanCommentEnd(ch + 2, end, &lineCount);
+                    if (ch == end) {
+                        pushError(buffer, "Unterminated comment, expected *;", offset, lineCount);
+                        continue;
+                    }
+                    ch += 2;
+                } else {
+                    ch++;
+                    pushError(buffer, "Expected ; or *", offset, lineCount);
+                    break;
+                }
+                flags |= LEX_FLAG_SPACE_BEFORE;
+                continue;
+            default:
+                ch++;
+                pushError(buffer, "Unexpected character.", offset, lineCount);
+                break;
+        }
+        flags = 0;
+        if (continuation) { // Only whitespace and comments may follow a \\.
+            pushError(buffer, "Expected new line.", offset, lineCount);
+            continuation = false;
+        }
+    }
+}
+
+void freeLexBuffer(LexBuffer *buffer) {
+    free(buffer->tokens);
+    free(buffer);
+}
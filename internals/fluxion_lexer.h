@@ -0,0 +1,65 @@
+//
+// Single pass, table driven lexer.
+//
+
+#ifndef FLUXIONCORE_FLUXION_LEXER_H
+#define FLUXIONCORE_FLUXION_LEXER_H
+#include "commons.h"
+
+/**
+ * Kind of a lexical token.
+ */
+typedef enum {
+    LEX_IDENTIFIER,
+    LEX_NUMBER,
+    LEX_OPERATOR,
+    LEX_LEFT_PAREN,
+    LEX_RIGHT_PAREN,
+    LEX_LEFT_BRACE,
+    LEX_RIGHT_BRACE,
+    LEX_LEFT_BRACKET,
+    LEX_RIGHT_BRACKET,
+    LEX_COMMA,
+    LEX_EOL,
+    LEX_EOF,
+    LEX_ERROR
+} LexKind;
+
+#define LEX_FLAG_SPACE_BEFORE 1 // Whitespace or a comment precedes the token.
+
+/**
+ * A compact token, identifiers and numbers are
+ * spans into the source rather than copies.
+ */
+typedef struct {
+    uint8_t kind; // LexKind
+    uint8_t operatorType; // OperatorType, if kind is LEX_OPERATOR.
+    uint16_t flags;
+    uint32_t offset; // Byte offset into the source.
+    uint32_t length; // Length in bytes.
+    int32_t lineCount;
+} LexToken;
+
+/**
+ * A contiguous buffer of tokens, always terminated by LEX_EOF.
+ */
+typedef struct {
+    LexToken *tokens;
+    uint32_t count;
+    uint32_t capacity;
+    const char *errorMessage; // Message for the first LEX_ERROR, NULL if there is none.
+} LexBuffer;
+
+/**
+ * Lex a whole source in one pass.
+ * @param source Null terminated source, must outlive the buffer.
+ * @return the token buffer.
+ */
+LexBuffer *lexSource(const char *source);
+/**
+ * Free a token buffer.
+ * @param buffer Buffer to free.
+ */
+void freeLexBuffer(LexBuffer *buffer);
+
+#endif //FLUXIONCORE_FLUXION_LEXER_H
@@ -0,0 +1,786 @@
+//
+// Exact linear algebra on matrices of integers and fractions.
+//
+
+#include <math.h>
+#include <string.h>
+#include "fluxion_linear.h"
+#include "fluxion_modular.h"
+#include "fluxion_sparse.h"
+
+#ifdef FLUXION_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LINEAR_VECTOR 1
+#define LANES 4
+typedef double VectorDouble __attribute__((vector_size(32)));
+typedef int64_t VectorLong __attribute__((vector_size(32)));
+#define KERNEL static inline __attribute__((always_inline))
+#pragma GCC diagnostic ignored "-Wpsabi" // Vectors only cross inlined calls, the ABI never matters.
+#if defined(__x86_64__) || defined(__i386__)
+#define LINEAR_HAS_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define KERNEL static inline
+#endif
+
+#define ROUNDING 6755399441055744.0 // 1.5 * 2^52, adding and subtracting it rounds a double to an integer.
+
+/**
+ * A matrix [a | b] with every row scaled to integers.
+ */
+typedef struct {
+    BigInt *values; // Element (i, j) is at values[i * columns + j].
+    int64_t *small; // The same elements when they all fit a word, NULL otherwise.
+    size_t rows;
+    size_t columns;
+    size_t pivotColumns; // Columns of a, the rest are right hand sides.
+    BigInt scale; // Product of the factors the rows were scaled by.
+} IntegerMatrix;
+
+ExactMatrix *initExactMatrix(size_t rows, size_t columns) {
+    ExactMatrix *matrix = (ExactMatrix *) malloc(sizeof(ExactMatrix));
+    size_t i;
+    matrix->rows = rows;
+    matrix->columns = columns;
+    matrix->values = (Number *) malloc(sizeof(Number) * rows * columns);
+    for (i = 0; i < rows * columns; i++) {
+        matrix->values[i] = numberFromSmall(0);
+    }
+    return matrix;
+}
+
+void freeExactMatrix(ExactMatrix *matrix) {
+    if (matrix == NULL) {
+        return;
+    }
+    size_t i;
+    for (i = 0; i < matrix->rows * matrix->columns; i++) {
+        freeNumber(matrix->values[i]);
+    }
+    free(matrix->values);
+    free(matrix);
+}
+
+static bool isExact(Number number) {
+    NumberKind kind = numberKind(number);
+    return kind == NUMBER_SMALL || kind == NUMBER_BIG || kind == NUMBER_RATIONAL;
+}
+
+/**
+ * The integer an integral double holds, exactly, from its mantissa and exponent.
+ */
+static Number integerFromDouble(double value) {
+    if (fabs(value) <= 9007199254740992.0) {
+        return numberFromSmall((int64_t) value);
+    }
+    int exponent;
+    double fraction = frexp(value, &exponent); // Past 2^53, so exponent > 53.
+    BigInt integer;
+    initBigInt(&integer);
+    bigIntSetInt64(&integer, (int64_t) ldexp(fraction, 53));
+    bigIntShiftLeft(&integer, &integer, (size_t) exponent - 53);
+    return numberFromBigInt(&integer);
+}
+
+ExactMatrix *exactMatrixFromToken(const MatrixToken *token) {
+    ExactMatrix *matrix = initExactMatrix((size_t) token->rowSize, (size_t) token->columnSize);
+    size_t i;
+    if (token->sparse != NULL) { // Doubles keep no kind, so integral ones are read as the integers they are.
+        const SparseMatrix *sparse = token->sparse;
+        for (i = 0; i < matrix->rows * matrix->columns; i++) {
+            double value = sparseMatrixGet(sparse, i / matrix->columns, i % matrix->columns);
+            if (!isfinite(value) || value != floor(value)) {
+                freeExactMatrix(matrix);
+                return NULL;
+            }
+            freeNumber(matrix->values[i]);
+            matrix->values[i] = integerFromDouble(value);
+        }
+        return matrix;
+    }
+    for (i = 0; i < matrix->rows * matrix->columns; i++) {
+        const Token *member = token->members[i];
+        while (member != NULL && member->tokenType == EXPRESSION) {
+            member = ((const ExpressionToken *) member)->root;
+        }
+        if (member == NULL || member->tokenType != NUMBER || !isExact(((const NumberToken *) member)->number)) {
+            freeExactMatrix(matrix);
+            return NULL;
+        }
+        matrix->values[i] = copyNumber(((const NumberToken *) member)->number);
+    }
+    return matrix;
+}
+
+MatrixToken *exactMatrixToToken(Arena *arena, const ExactMatrix *matrix) {
+    MatrixToken *token = initMatrixToken(arena, 0);
+    size_t i;
+    token->rowSize = (int) matrix->rows;
+    token->columnSize = (int) matrix->columns;
+    mallocMatrixTokenArr(token, 0);
+    for (i = 0; i < matrix->rows * matrix->columns; i++) {
+        token->members[i] = (Token *) initNumberTokenNumber(arena, 0, copyNumber(matrix->values[i]));
+    }
+    return token;
+}
+
+/**
+ * Copy the numerator and denominator of an integer or fraction.
+ */
+static void numberParts(Number number, BigInt *numerator, BigInt *denominator) {
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            bigIntSetInt64(numerator, numberSmallValue(number));
+            bigIntSetInt64(denominator, 1);
+            break;
+        case NUMBER_BIG:
+            bigIntCopy(numerator, &numberObject(number)->as.integer);
+            bigIntSetInt64(denominator, 1);
+            break;
+        default:
+            bigIntCopy(numerator, &numberObject(number)->as.rational.numerator);
+            bigIntCopy(denominator, &numberObject(number)->as.rational.denominator);
+            break;
+    }
+}
+
+/**
+ * Build [a | b], b may be NULL, multiplying every row by the least common
+ * multiple of its denominators. Scaling a row of a system leaves its solutions alone.
+ */
+static void initIntegerMatrix(IntegerMatrix *matrix, const ExactMatrix *a, const ExactMatrix *b) {
+    size_t i, j, extra = b != NULL ? b->columns : 0;
+    BigInt multiple, denominator, divisor;
+    matrix->rows = a->rows;
+    matrix->pivotColumns = a->columns;
+    matrix->columns = a->columns + extra;
+    matrix->values = (BigInt *) malloc(sizeof(BigInt) * matrix->rows * matrix->columns);
+    initBigInt(&matrix->scale);
+    initBigInt(&multiple);
+    initBigInt(&denominator);
+    initBigInt(&divisor);
+    bigIntSetInt64(&matrix->scale, 1);
+    bool fits = true;
+    for (i = 0; i < matrix->rows; i++) {
+        BigInt *row = matrix->values + i * matrix->columns;
+        bigIntSetInt64(&multiple, 1);
+        for (j = 0; j < matrix->columns; j++) {
+            Number number = j < a->columns ? a->values[i * a->columns + j] : b->values[i * extra + j - a->columns];
+            initBigInt(row + j);
+            numberParts(number, row + j, &denominator);
+            bigIntGcd(&divisor, &multiple, &denominator);
+            bigIntDivideExact(&denominator, &denominator, &divisor);
+            bigIntMultiply(&multiple, &multiple, &denominator);
+        }
+        for (j = 0; j < matrix->columns && !(multiple.size == 1 && multiple.limbs[0] == 1); j++) {
+            Number number = j < a->columns ? a->values[i * a->columns + j] : b->values[i * extra + j - a->columns];
+            if (numberKind(number) == NUMBER_RATIONAL) {
+                bigIntDivideExact(&divisor, &multiple, &numberObject(number)->as.rational.denominator);
+                bigIntMultiply(row + j, row + j, &divisor);
+            } else {
+                bigIntMultiply(row + j, row + j, &multiple);
+            }
+        }
+        bigIntMultiply(&matrix->scale, &matrix->scale, &multiple);
+        for (j = 0; j < matrix->columns; j++) {
+            fits = fits && bigIntFitsInt64(row + j);
+        }
+    }
+    matrix->small = NULL;
+    if (fits) {
+        matrix->small = (int64_t *) malloc(sizeof(int64_t) * matrix->rows * matrix->columns);
+        for (i = 0; i < matrix->rows * matrix->columns; i++) {
+            matrix->small[i] = bigIntToInt64(matrix->values + i);
+        }
+    }
+    freeBigInt(&divisor);
+    freeBigInt(&denominator);
+    freeBigInt(&multiple);
+}
+
+static void freeIntegerMatrix(IntegerMatrix *matrix) {
+    size_t i;
+    for (i = 0; i < matrix->rows * matrix->columns; i++) {
+        freeBigInt(matrix->values + i);
+    }
+    free(matrix->values);
+    free(matrix->small);
+    freeBigInt(&matrix->scale);
+}
+
+/**
+ * Bareiss elimination over the pivot columns. After the step for a pivot every
+ * element below it is a minor of the original matrix, so the division by the
+ * previous pivot is exact. Gauss Jordan elimination eliminates above the
+ * pivots the same way and leaves the last pivot, the determinant up to sign,
+ * on the whole diagonal.
+ * @param matrix Matrix to eliminate in place.
+ * @param jordan Whether to eliminate above the pivots as well.
+ * @param sign Set to -1 if an odd number of rows were swapped, 1 otherwise.
+ * @param pivot Set to the last pivot, 1 if there is none.
+ * @return the rank.
+ */
+static size_t bareiss(IntegerMatrix *matrix, bool jordan, int *sign, BigInt *pivot) {
+    size_t rank = 0, column, i, j, columns = matrix->columns;
+    size_t *pivotColumns = (size_t *) malloc(sizeof(size_t) * matrix->rows);
+    BigInt product, other;
+    BigInt *m = matrix->values;
+    initBigInt(&product);
+    initBigInt(&other);
+    bigIntSetInt64(pivot, 1);
+    *sign = 1;
+    for (column = 0; column < matrix->pivotColumns && rank < matrix->rows; column++) {
+        for (i = rank; i < matrix->rows && bigIntIsZero(m + i * columns + column); i++);
+        if (i == matrix->rows) {
+            continue;
+        }
+        if (i != rank) {
+            for (j = 0; j < columns; j++) {
+                bigIntSwap(m + i * columns + j, m + rank * columns + j);
+            }
+            *sign = -*sign;
+        }
+        const BigInt *current = m + rank * columns + column;
+        for (i = jordan ? 0 : rank + 1; i < matrix->rows; i++) {
+            if (i == rank) {
+                continue;
+            }
+            BigInt *row = m + i * columns;
+            for (j = column + 1; j < columns; j++) {
+                bigIntMultiply(&product, current, row + j);
+                bigIntMultiply(&other, row + column, m + rank * columns + j);
+                bigIntSubtract(&product, &product, &other);
+                bigIntDivideExact(row + j, &product, pivot);
+            }
+            if (i < rank) { // The earlier pivot becomes this one.
+                bigIntMultiply(&product, current, row + pivotColumns[i]);
+                bigIntDivideExact(row + pivotColumns[i], &product, pivot);
+            }
+            bigIntSetInt64(row + column, 0);
+        }
+        bigIntCopy(pivot, current);
+        pivotColumns[rank++] = column;
+    }
+    freeBigInt(&other);
+    freeBigInt(&product);
+    free(pivotColumns);
+    return rank;
+}
+
+/**
+ * What one prime says about a matrix.
+ */
+typedef struct {
+    uint64_t prime;
+    uint64_t determinant; // Of a square matrix.
+    size_t rank;
+    uint64_t *solution; // det * x for the right hand sides, when the matrix is square and invertible.
+    double *work; // The matrix reduced, rows * columns.
+} ModularResult;
+
+typedef void (*EliminationKernel)(const IntegerMatrix *matrix, ModularResult *result);
+
+/**
+ * Reduce an integer below 2^52 in magnitude, inverse is 1 / prime.
+ */
+KERNEL double reduceModulo(double x, double prime, double inverse) {
+    double quotient = (x * inverse + ROUNDING) - ROUNDING; // Nearest, so x ends up within about prime / 2 of 0.
+    x -= quotient * prime;
+    return x < 0 ? x + prime : x;
+}
+
+#ifdef LINEAR_VECTOR
+KERNEL VectorDouble loadVector(const double *pointer) {
+    VectorDouble vector;
+    memcpy(&vector, pointer, sizeof(VectorDouble));
+    return vector;
+}
+
+KERNEL void storeVector(double *pointer, VectorDouble vector) {
+    memcpy(pointer, &vector, sizeof(VectorDouble));
+}
+
+KERNEL VectorDouble broadcast(double value) {
+    VectorDouble vector = {value, value, value, value};
+    return vector;
+}
+#endif
+
+/**
+ * row = (row - factor * pivotRow) modulo prime over a range of columns, with
+ * factor zero and the subtraction skipped when only scaling. The loop every
+ * step of the elimination spends its time in.
+ */
+KERNEL void updateRow(double *restrict row, const double *restrict pivotRow, size_t begin, size_t end, double scale,
+                      double factor, double prime, double inverse) {
+    size_t j = begin;
+#ifdef LINEAR_VECTOR
+    VectorDouble scales = broadcast(scale), factors = broadcast(factor), primes = broadcast(prime);
+    VectorDouble inverses = broadcast(inverse), rounding = broadcast(ROUNDING);
+    for (; j + LANES <= end; j += LANES) {
+        VectorDouble x = scales * loadVector(row + j);
+        if (pivotRow != NULL) {
+            x -= factors * loadVector(pivotRow + j);
+        }
+        VectorDouble quotient = (x * inverses + rounding) - rounding;
+        x -= quotient * primes;
+        storeVector(row + j, x + (VectorDouble) ((VectorLong) primes & (x < 0)));
+    }
+#endif
+    for (; j < end; j++) {
+        row[j] = reduceModulo(scale * row[j] - (pivotRow != NULL ? factor * pivotRow[j] : 0), prime, inverse);
+    }
+}
+
+/**
+ * Gaussian elimination modulo the prime of result, then back substitution
+ * for the right hand sides when the pivot columns are invertible.
+ */
+KERNEL void eliminateBody(const IntegerMatrix *matrix, ModularResult *result) {
+    uint64_t prime = result->prime, determinant = 1, pivot, inverse;
+    size_t rows = matrix->rows, columns = matrix->columns, rank = 0, column, i, j;
+    double *m = result->work, reciprocal = 1.0 / (double) prime;
+    for (i = 0; i < rows * columns; i++) {
+        m[i] = (double) (matrix->small != NULL ? int64Modulo(matrix->small[i], prime) :
+                         integerModulo(matrix->values + i, prime));
+    }
+    for (column = 0; column < matrix->pivotColumns && rank < rows; column++) {
+        for (i = rank; i < rows && m[i * columns + column] == 0; i++);
+        if (i == rows) {
+            determinant = 0;
+            continue;
+        }
+        if (i != rank) {
+            for (j = column; j < columns; j++) {
+                double swap = m[i * columns + j];
+                m[i * columns + j] = m[rank * columns + j];
+                m[rank * columns + j] = swap;
+            }
+            determinant = subtractModulo(0, determinant, prime);
+        }
+        const double *pivotRow = m + rank * columns;
+        pivot = (uint64_t) pivotRow[column];
+        determinant = multiplyModulo(determinant, pivot, prime);
+        inverseModulo(pivot, prime, &inverse);
+        for (i = rank + 1; i < rows; i++) {
+            double *row = m + i * columns;
+            if (row[column] != 0) {
+                double factor = (double) multiplyModulo((uint64_t) row[column], inverse, prime);
+                updateRow(row, pivotRow, column + 1, columns, 1, factor, (double) prime, reciprocal);
+                row[column] = 0;
+            }
+        }
+        rank++;
+    }
+    result->rank = rank;
+    result->determinant = rank == rows ? determinant : 0;
+    if (result->solution == NULL || rank != rows || rows != matrix->pivotColumns) {
+        return;
+    }
+    for (column = rows; column-- > 0;) { // The pivots are on the diagonal, columns go last to first.
+        double *pivotRow = m + column * columns;
+        inverseModulo((uint64_t) pivotRow[column], prime, &inverse);
+        updateRow(pivotRow, NULL, rows, columns, (double) inverse, 0, (double) prime, reciprocal);
+        for (i = 0; i < column; i++) {
+            double *row = m + i * columns;
+            if (row[column] != 0) {
+                updateRow(row, pivotRow, rows, columns, 1, row[column], (double) prime, reciprocal);
+            }
+        }
+    }
+    size_t sides = columns - rows;
+    for (i = 0; i < rows; i++) {
+        updateRow(m + i * columns, NULL, rows, columns, (double) determinant, 0, (double) prime, reciprocal);
+        for (j = 0; j < sides; j++) {
+            result->solution[i * sides + j] = (uint64_t) m[i * columns + rows + j];
+        }
+    }
+}
+
+static void eliminateBaseline(const IntegerMatrix *matrix, ModularResult *result) {
+    eliminateBody(matrix, result);
+}
+
+#ifdef LINEAR_HAS_AVX2
+TARGET_AVX2 static void eliminateAvx2(const IntegerMatrix *matrix, ModularResult *result) {
+    eliminateBody(matrix, result);
+}
+#endif
+
+static EliminationKernel selectKernel(void) {
+#ifdef LINEAR_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return eliminateAvx2;
+    }
+#endif
+    return eliminateBaseline;
+}
+
+/**
+ * Primes a thread eliminates modulo.
+ */
+typedef struct {
+    const IntegerMatrix *matrix;
+    ModularResult *results;
+    size_t count;
+    EliminationKernel kernel;
+} ModularSlice;
+
+static void *eliminateSlice(void *argument) {
+    ModularSlice *slice = (ModularSlice *) argument;
+    size_t i;
+    for (i = 0; i < slice->count; i++) {
+        slice->kernel(slice->matrix, slice->results + i);
+    }
+    return NULL;
+}
+
+#ifdef FLUXION_THREADS
+static void *eliminateSliceThread(void *argument) {
+    eliminateSlice(argument);
+    limbPoolTrim(); // The thread ends, its cached limbs would be lost.
+    return NULL;
+}
+#endif
+
+/**
+ * Run a round of primes, a result per thread.
+ */
+static void eliminateRound(const IntegerMatrix *matrix, ModularResult *results, int threadCount,
+                           EliminationKernel kernel) {
+#ifdef FLUXION_THREADS
+    if (threadCount > 1) {
+        ModularSlice *slices = (ModularSlice *) malloc(sizeof(ModularSlice) * threadCount);
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * threadCount);
+        int i, started = 0;
+        for (i = 0; i < threadCount; i++) {
+            slices[i].matrix = matrix;
+            slices[i].results = results + i;
+            slices[i].count = 1;
+            slices[i].kernel = kernel;
+        }
+        for (i = 1; i < threadCount; i++) {
+            if (pthread_create(threads + i, NULL, eliminateSliceThread, slices + i) != 0) {
+                break;
+            }
+            started = i;
+        }
+        eliminateSlice(slices);
+        for (i = started + 1; i < threadCount; i++) { // Threads that could not start run here.
+            eliminateSlice(slices + i);
+        }
+        for (i = 1; i <= started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(slices);
+        return;
+    }
+#endif
+    ModularSlice whole = {matrix, results, (size_t) threadCount, kernel};
+    eliminateSlice(&whole);
+}
+
+/**
+ * Integers known modulo a growing product of primes, combined one prime at a time.
+ */
+typedef struct {
+    BigInt modulus;
+    BigInt *values; // In [0, modulus).
+    size_t count;
+    double bits; // log2 of the modulus.
+} Reconstruction;
+
+static void initReconstruction(Reconstruction *reconstruction, size_t count) {
+    size_t i;
+    initBigInt(&reconstruction->modulus);
+    bigIntSetInt64(&reconstruction->modulus, 1);
+    reconstruction->values = (BigInt *) malloc(sizeof(BigInt) * count);
+    for (i = 0; i < count; i++) {
+        initBigInt(reconstruction->values + i);
+    }
+    reconstruction->count = count;
+    reconstruction->bits = 0;
+}
+
+static void freeReconstruction(Reconstruction *reconstruction) {
+    size_t i;
+    for (i = 0; i < reconstruction->count; i++) {
+        freeBigInt(reconstruction->values + i);
+    }
+    free(reconstruction->values);
+    freeBigInt(&reconstruction->modulus);
+}
+
+/**
+ * Add a prime: x + modulus * ((r - x) / modulus mod prime) agrees with every residue so far.
+ */
+static void foldResidues(Reconstruction *reconstruction, const uint64_t *residues, uint64_t prime) {
+    uint64_t inverse;
+    size_t i;
+    BigInt step;
+    initBigInt(&step);
+    inverseModulo(integerModulo(&reconstruction->modulus, prime), prime, &inverse);
+    uint64_t shoup = shoupFactor(inverse, prime);
+    for (i = 0; i < reconstruction->count; i++) {
+        BigInt *value = reconstruction->values + i;
+        uint64_t difference = subtractModulo(residues[i], integerModulo(value, prime), prime);
+        bigIntSetUint64(&step, shoupMultiply(difference, inverse, shoup, prime));
+        bigIntMultiply(&step, &step, &reconstruction->modulus);
+        bigIntAdd(value, value, &step);
+    }
+    bigIntSetUint64(&step, prime);
+    bigIntMultiply(&reconstruction->modulus, &reconstruction->modulus, &step);
+    reconstruction->bits += log2((double) prime);
+    freeBigInt(&step);
+}
+
+/**
+ * Move a value to the symmetric range, (-modulus / 2, modulus / 2].
+ */
+static void symmetricValue(const Reconstruction *reconstruction, BigInt *value) {
+    BigInt doubled;
+    initBigInt(&doubled);
+    bigIntShiftLeft(&doubled, value, 1);
+    if (bigIntCompare(&doubled, &reconstruction->modulus) > 0) {
+        bigIntSubtract(value, value, &reconstruction->modulus);
+    }
+    freeBigInt(&doubled);
+}
+
+/**
+ * log2 of the product of the Euclidean norms of the nonzero rows over the
+ * first columns, which bounds every minor of those columns, by Hadamard's inequality.
+ */
+static double hadamardBits(const IntegerMatrix *matrix, size_t columns) {
+    double bits = 0;
+    size_t i, j;
+    for (i = 0; i < matrix->rows; i++) {
+        const BigInt *row = matrix->values + i * matrix->columns;
+        size_t exponent = 0;
+        double sum = 0;
+        for (j = 0; j < columns; j++) {
+            size_t length = bigIntBitLength(row + j);
+            exponent = length > exponent ? length : exponent;
+        }
+        if (exponent == 0) {
+            continue;
+        }
+        for (j = 0; j < columns; j++) { // Scaled by 2^-exponent, words exactly and big ones by 2^bits.
+            double scaled = matrix->small != NULL ? ldexp(fabs((double) matrix->small[i * matrix->columns + j]),
+                                                          -(int) exponent) :
+                            ldexp(1.0, (int) bigIntBitLength(row + j) - (int) exponent);
+            sum += scaled * scaled;
+        }
+        bits += exponent + 0.5 * log2(sum);
+    }
+    return bits + 1e-6 * matrix->rows + 1; // Over any rounding of the logarithms.
+}
+
+static int resolveThreads(int threadCount, const IntegerMatrix *matrix) {
+#ifdef FLUXION_THREADS
+    if (threadCount <= 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? (int) processors : 1;
+    }
+    return matrix->rows < LINEAR_MODULAR_THRESHOLD ? 1 : threadCount;
+#else
+    (void) threadCount;
+    (void) matrix;
+    return 1;
+#endif
+}
+
+typedef struct {
+    size_t rank;
+    bool singular;
+    BigInt determinant; // Of the scaled matrix, when square.
+    Reconstruction solution; // det * x, when solving.
+} ModularOutcome;
+
+/**
+ * Eliminate modulo primes until the results are certain.
+ * @param solve Whether to reconstruct det * x for the right hand sides.
+ * @param rankOnly Whether only the rank is wanted.
+ */
+static void eliminateMultiModular(const IntegerMatrix *matrix, bool solve, bool rankOnly, int threadCount,
+                                  ModularOutcome *outcome) {
+    size_t sides = matrix->columns - matrix->pivotColumns, i, rows = matrix->rows;
+    size_t fullRank = rows < matrix->pivotColumns ? rows : matrix->pivotColumns;
+    double bound = hadamardBits(matrix, rankOnly ? matrix->pivotColumns : matrix->columns);
+    ModularResult *results = (ModularResult *) malloc(sizeof(ModularResult) * threadCount);
+    EliminationKernel kernel = selectKernel();
+    Reconstruction determinant;
+    uint64_t prime = (uint64_t) 1 << LINEAR_PRIME_BITS;
+    int k;
+    initReconstruction(&determinant, 1);
+    initReconstruction(&outcome->solution, solve ? rows * sides : 0);
+    initBigInt(&outcome->determinant);
+    outcome->rank = 0;
+    outcome->singular = false;
+    for (k = 0; k < threadCount; k++) {
+        results[k].work = (double *) malloc(sizeof(double) * rows * matrix->columns);
+        results[k].solution = solve ? (uint64_t *) malloc(sizeof(uint64_t) * rows * sides) : NULL;
+    }
+    bool determinantKnown = false;
+    double primeBits = 0;
+    while (true) {
+        for (k = 0; k < threadCount; k++) {
+            prime = modularPrimeBelow(prime);
+            results[k].prime = prime;
+        }
+        eliminateRound(matrix, results, threadCount, kernel);
+        for (k = 0; k < threadCount; k++) {
+            outcome->rank = results[k].rank > outcome->rank ? results[k].rank : outcome->rank;
+            primeBits += log2((double) results[k].prime);
+            if (!determinantKnown && !rankOnly) {
+                foldResidues(&determinant, &results[k].determinant, results[k].prime);
+            }
+            if (solve && results[k].rank == rows) {
+                foldResidues(&outcome->solution, results[k].solution, results[k].prime);
+            }
+        }
+        if (rankOnly) { // A nonzero minor of the rank is not a multiple of all the primes.
+            if (outcome->rank == fullRank || primeBits > bound) {
+                break;
+            }
+            continue;
+        }
+        if (!determinantKnown && determinant.bits > bound + 1) {
+            determinantKnown = true;
+            bigIntCopy(&outcome->determinant, determinant.values);
+            symmetricValue(&determinant, &outcome->determinant);
+            if (bigIntIsZero(&outcome->determinant)) {
+                outcome->singular = true;
+                break;
+            }
+        }
+        if (determinantKnown && (!solve || outcome->solution.bits > bound + 1)) {
+            break;
+        }
+    }
+    for (i = 0; i < outcome->solution.count; i++) {
+        symmetricValue(&outcome->solution, outcome->solution.values + i);
+    }
+    for (k = 0; k < threadCount; k++) {
+        free(results[k].work);
+        free(results[k].solution);
+    }
+    free(results);
+    freeReconstruction(&determinant);
+}
+
+Number exactMatrixDeterminant(const ExactMatrix *matrix, int threadCount) {
+    if (matrix->rows != matrix->columns) {
+        return numberError(Undefined);
+    }
+    IntegerMatrix integers;
+    BigInt determinant;
+    initIntegerMatrix(&integers, matrix, NULL);
+    initBigInt(&determinant);
+    if (integers.rows < LINEAR_MODULAR_THRESHOLD) {
+        int sign;
+        if (bareiss(&integers, false, &sign, &determinant) == integers.rows) {
+            if (sign < 0) {
+                bigIntNegate(&determinant, &determinant);
+            }
+        } else {
+            bigIntSetInt64(&determinant, 0);
+        }
+    } else {
+        ModularOutcome outcome;
+        eliminateMultiModular(&integers, false, false, resolveThreads(threadCount, &integers), &outcome);
+        bigIntMove(&determinant, &outcome.determinant);
+        freeReconstruction(&outcome.solution);
+    }
+    Number result = numberFromRational(&determinant, &integers.scale);
+    freeIntegerMatrix(&integers);
+    return result;
+}
+
+size_t exactMatrixRank(const ExactMatrix *matrix, int threadCount) {
+    IntegerMatrix integers;
+    size_t rank;
+    initIntegerMatrix(&integers, matrix, NULL);
+    if (integers.rows < LINEAR_MODULAR_THRESHOLD) {
+        BigInt pivot;
+        int sign;
+        initBigInt(&pivot);
+        rank = bareiss(&integers, false, &sign, &pivot);
+        freeBigInt(&pivot);
+    } else {
+        ModularOutcome outcome;
+        eliminateMultiModular(&integers, false, true, resolveThreads(threadCount, &integers), &outcome);
+        rank = outcome.rank;
+        freeBigInt(&outcome.determinant);
+        freeReconstruction(&outcome.solution);
+    }
+    freeIntegerMatrix(&integers);
+    return rank;
+}
+
+ExactMatrix *exactMatrixSolve(const ExactMatrix *a, const ExactMatrix *b, int threadCount) {
+    if (a->rows != a->columns || b->rows != a->rows) {
+        return NULL;
+    }
+    IntegerMatrix integers;
+    ExactMatrix *solution = NULL;
+    size_t n = a->rows, sides = b->columns, i, j;
+    BigInt numerator, denominator;
+    initIntegerMatrix(&integers, a, b);
+    initBigInt(&numerator);
+    initBigInt(&denominator);
+    if (n < LINEAR_MODULAR_THRESHOLD) {
+        int sign;
+        BigInt pivot;
+        initBigInt(&pivot);
+        if (bareiss(&integers, true, &sign, &pivot) == n) { // pivot * x is on the right.
+            solution = initExactMatrix(n, sides);
+            for (i = 0; i < n; i++) {
+                for (j = 0; j < sides; j++) {
+                    bigIntMove(&numerator, integers.values + i * integers.columns + n + j);
+                    bigIntCopy(&denominator, &pivot);
+                    solution->values[i * sides + j] = numberFromRational(&numerator, &denominator);
+                }
+            }
+        }
+        freeBigInt(&pivot);
+    } else {
+        ModularOutcome outcome;
+        eliminateMultiModular(&integers, true, false, resolveThreads(threadCount, &integers), &outcome);
+        if (!outcome.singular) {
+            solution = initExactMatrix(n, sides);
+            for (i = 0; i < n * sides; i++) {
+                bigIntMove(&numerator, outcome.solution.values + i);
+                bigIntCopy(&denominator, &outcome.determinant);
+                solution->values[i] = numberFromRational(&numerator, &denominator);
+            }
+        }
+        freeBigInt(&outcome.determinant);
+        freeReconstruction(&outcome.solution);
+    }
+    freeBigInt(&denominator);
+    freeBigInt(&numerator);
+    freeIntegerMatrix(&integers);
+    return solution;
+}
+
+ExactMatrix *exactMatrixInverse(const ExactMatrix *matrix, int threadCount) {
+    if (matrix->rows != matrix->columns) {
+        return NULL;
+    }
+    ExactMatrix *identity = initExactMatrix(matrix->rows, matrix->rows);
+    size_t i;
+    for (i = 0; i < matrix->rows; i++) {
+        identity->values[i * matrix->rows + i] = numberFromSmall(1);
+    }
+    ExactMatrix *inverse = exactMatrixSolve(matrix, identity, threadCount);
+    freeExactMatrix(identity);
+    return inverse;
+}
@@ -0,0 +1,74 @@
+//
+// Exact linear algebra on matrices of integers and fractions.
+//
+
+#ifndef FLUXIONCORE_FLUXION_LINEAR_H
+#define FLUXIONCORE_FLUXION_LINEAR_H
+#include <stddef.h>
+#include "fluxion_number.h"
+#include "fluxion_token.h"
+
+#define LINEAR_MODULAR_THRESHOLD 24 // Matrices with at least this many rows are eliminated modulo primes.
+#define LINEAR_PRIME_BITS 26 // Those primes stay below 2^26, so row updates are exact in vectors of doubles.
+
+/**
+ * A row major matrix of exact numbers.
+ */
+typedef struct {
+    Number *values; // Element (i, j) is at values[i * columns + j], owned.
+    size_t rows;
+    size_t columns;
+} ExactMatrix;
+
+/**
+ * Allocate a matrix of zeros.
+ * @param rows Number of rows.
+ * @param columns Number of columns.
+ */
+ExactMatrix *initExactMatrix(size_t rows, size_t columns);
+void freeExactMatrix(ExactMatrix *matrix);
+/**
+ * Convert a matrix token whose members are all integers or fractions.
+ * A compressed token holds doubles, the integral ones are read as the
+ * integers they are and any other makes the conversion fail.
+ * @param token Matrix to convert.
+ * @return the matrix, NULL if a member is missing, not a number or a float.
+ */
+ExactMatrix *exactMatrixFromToken(const MatrixToken *token);
+/**
+ * Convert back to a matrix of number tokens.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param matrix Matrix to convert.
+ */
+MatrixToken *exactMatrixToToken(Arena *arena, const ExactMatrix *matrix);
+
+/*
+ * Rows are first scaled to integers. Matrices with fewer than
+ * LINEAR_MODULAR_THRESHOLD rows then run Bareiss fraction free elimination,
+ * where every intermediate is a minor, so nothing grows past the result.
+ * Larger ones are eliminated modulo enough 26 bit primes to cover the Hadamard
+ * bound of the result, split across threadCount threads (0 for one per
+ * processor), and reconstructed with the Chinese remainder theorem.
+ * Either way the results are exact.
+ */
+
+/**
+ * Determinant.
+ * @return the determinant, Undefined if the matrix is not square.
+ */
+Number exactMatrixDeterminant(const ExactMatrix *matrix, int threadCount);
+size_t exactMatrixRank(const ExactMatrix *matrix, int threadCount);
+/**
+ * Solve a x = b for x.
+ * @param a Square matrix.
+ * @param b Right hand sides, a column each, as many rows as a.
+ * @return x, NULL if a is singular or the shapes do not agree.
+ */
+ExactMatrix *exactMatrixSolve(const ExactMatrix *a, const ExactMatrix *b, int threadCount);
+/**
+ * Inverse.
+ * @return the inverse, NULL if the matrix is singular or not square.
+ */
+ExactMatrix *exactMatrixInverse(const ExactMatrix *matrix, int threadCount);
+
+#endif //FLUXIONCORE_FLUXION_LINEAR_H
@@ -0,0 +1,425 @@
+//
+// Dense matrices of doubles, the numeric fast path for matrix tokens.
+//
+
+#include <string.h>
+#include "fluxion_matrix.h"
+#include "fluxion_sparse.h"
+
+#ifdef FLUXION_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MATRIX_VECTOR 1
+#define LANES 4
+typedef double VectorDouble __attribute__((vector_size(32)));
+#define KERNEL static inline __attribute__((always_inline))
+#pragma GCC diagnostic ignored "-Wpsabi" // Vectors only cross inlined calls, the ABI never matters.
+#if defined(__x86_64__) || defined(__i386__)
+#define MATRIX_HAS_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define LANES 1
+#define KERNEL static inline
+#endif
+
+#define GEMM_MR 4 // Rows of the product the kernel keeps in registers.
+#define GEMM_NR 8 // Columns of the product the kernel keeps in registers, two vectors.
+#define GEMM_KC 256 // Depth of the packed panels, a panel of b stays in L1.
+#define GEMM_MC 128 // Rows of a packed block of a, which stays in L2.
+#define GEMM_NC 1024 // Columns of a packed block of b.
+#define TRANSPOSE_BLOCK 32
+
+/**
+ * Adds the product of a packed panel of a, depth by GEMM_MR, and a packed
+ * panel of b, depth by GEMM_NR, to the rows by columns block of c at c.
+ */
+typedef void (*PanelKernel)(size_t depth, const double *a, const double *b, double *c, size_t stride,
+                            size_t rows, size_t columns);
+
+static size_t minSize(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+DenseMatrix *initDenseMatrix(size_t rows, size_t columns) {
+    DenseMatrix *matrix = (DenseMatrix *) malloc(sizeof(DenseMatrix));
+    matrix->rows = rows;
+    matrix->columns = columns;
+    matrix->stride = (columns + LANES - 1) / LANES * LANES;
+    size_t size = rows * matrix->stride;
+    matrix->values = (double *) calloc(size ? size : 1, sizeof(double));
+    return matrix;
+}
+
+void freeDenseMatrix(DenseMatrix *matrix) {
+    if (matrix == NULL) {
+        return;
+    }
+    free(matrix->values);
+    free(matrix);
+}
+
+DenseMatrix *denseMatrixFromToken(const MatrixToken *token) {
+    if (token->sparse != NULL) {
+        return sparseMatrixToDense(token->sparse);
+    }
+    DenseMatrix *matrix = initDenseMatrix((size_t) token->rowSize, (size_t) token->columnSize);
+    int i, j;
+    for (i = 0; i < token->rowSize; i++) {
+        for (j = 0; j < token->columnSize; j++) {
+            const Token *member = token->members[i * token->columnSize + j];
+            while (member != NULL && member->tokenType == EXPRESSION) {
+                member = ((const ExpressionToken *) member)->root;
+            }
+            if (member == NULL || member->tokenType != NUMBER) {
+                freeDenseMatrix(matrix);
+                return NULL;
+            }
+            denseMatrixSet(matrix, i, j, ((const NumberToken *) member)->value);
+        }
+    }
+    return matrix;
+}
+
+MatrixToken *denseMatrixToToken(Arena *arena, const DenseMatrix *matrix) {
+    MatrixToken *token = initMatrixToken(arena, 0);
+    size_t i, j;
+    token->rowSize = (int) matrix->rows;
+    token->columnSize = (int) matrix->columns;
+    mallocMatrixTokenArr(token, 0);
+    for (i = 0; i < matrix->rows; i++) {
+        for (j = 0; j < matrix->columns; j++) {
+            token->members[i * matrix->columns + j] = (Token *) initNumberToken(arena, 0, denseMatrixGet(matrix, i, j));
+        }
+    }
+    return token;
+}
+
+#ifdef MATRIX_VECTOR
+KERNEL VectorDouble loadVector(const double *pointer) {
+    VectorDouble vector;
+    memcpy(&vector, pointer, sizeof(VectorDouble));
+    return vector;
+}
+
+KERNEL void storeVector(double *pointer, VectorDouble vector) {
+    memcpy(pointer, &vector, sizeof(VectorDouble));
+}
+
+KERNEL VectorDouble broadcast(double value) {
+    VectorDouble vector = {value, value, value, value};
+    return vector;
+}
+
+KERNEL void multiplyPanelsBody(size_t depth, const double *a, const double *b, double *c, size_t stride,
+                               size_t rows, size_t columns) {
+    VectorDouble c00 = broadcast(0), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    size_t p, i, j;
+    for (p = 0; p < depth; p++, a += GEMM_MR, b += GEMM_NR) {
+        VectorDouble b0 = loadVector(b), b1 = loadVector(b + LANES), x;
+        x = broadcast(a[0]);
+        c00 += x * b0;
+        c01 += x * b1;
+        x = broadcast(a[1]);
+        c10 += x * b0;
+        c11 += x * b1;
+        x = broadcast(a[2]);
+        c20 += x * b0;
+        c21 += x * b1;
+        x = broadcast(a[3]);
+        c30 += x * b0;
+        c31 += x * b1;
+    }
+    VectorDouble block[GEMM_MR][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}};
+    if (rows == GEMM_MR && columns == GEMM_NR) {
+        for (i = 0; i < GEMM_MR; i++, c += stride) {
+            storeVector(c, loadVector(c) + block[i][0]);
+            storeVector(c + LANES, loadVector(c + LANES) + block[i][1]);
+        }
+        return;
+    }
+    double tile[GEMM_MR * GEMM_NR];
+    memcpy(tile, block, sizeof(tile));
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < columns; j++) {
+            c[i * stride + j] += tile[i * GEMM_NR + j];
+        }
+    }
+}
+#else
+KERNEL void multiplyPanelsBody(size_t depth, const double *a, const double *b, double *c, size_t stride,
+                               size_t rows, size_t columns) {
+    double tile[GEMM_MR * GEMM_NR] = {0};
+    size_t p, i, j;
+    for (p = 0; p < depth; p++, a += GEMM_MR, b += GEMM_NR) {
+        for (i = 0; i < GEMM_MR; i++) {
+            for (j = 0; j < GEMM_NR; j++) {
+                tile[i * GEMM_NR + j] += a[i] * b[j];
+            }
+        }
+    }
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < columns; j++) {
+            c[i * stride + j] += tile[i * GEMM_NR + j];
+        }
+    }
+}
+#endif
+
+static void multiplyPanelsBaseline(size_t depth, const double *a, const double *b, double *c, size_t stride,
+                                   size_t rows, size_t columns) {
+    multiplyPanelsBody(depth, a, b, c, stride, rows, columns);
+}
+
+#ifdef MATRIX_HAS_AVX2
+TARGET_AVX2 static void multiplyPanelsAvx2(size_t depth, const double *a, const double *b, double *c, size_t stride,
+                                           size_t rows, size_t columns) {
+    multiplyPanelsBody(depth, a, b, c, stride, rows, columns);
+}
+#endif
+
+static PanelKernel selectKernel(void) {
+#ifdef MATRIX_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return multiplyPanelsAvx2;
+    }
+#endif
+    return multiplyPanelsBaseline;
+}
+
+/**
+ * Copy rows [row, row + rows) of columns [column, column + depth) of a into
+ * panels of GEMM_MR rows, stored column by column and padded with zeros.
+ */
+static void packRows(const DenseMatrix *a, size_t row, size_t rows, size_t column, size_t depth, double *packed) {
+    size_t i, p, panel;
+    for (panel = 0; panel < rows; panel += GEMM_MR) {
+        size_t height = minSize(GEMM_MR, rows - panel);
+        for (p = 0; p < depth; p++, packed += GEMM_MR) {
+            for (i = 0; i < GEMM_MR; i++) {
+                packed[i] = i < height ? denseMatrixGet(a, row + panel + i, column + p) : 0;
+            }
+        }
+    }
+}
+
+/**
+ * Copy rows [row, row + depth) of columns [column, column + columns) of b into
+ * panels of GEMM_NR columns, stored row by row and padded with zeros.
+ */
+static void packColumns(const DenseMatrix *b, size_t row, size_t depth, size_t column, size_t columns,
+                        double *packed) {
+    size_t j, p, panel;
+    for (panel = 0; panel < columns; panel += GEMM_NR) {
+        size_t width = minSize(GEMM_NR, columns - panel);
+        for (p = 0; p < depth; p++, packed += GEMM_NR) {
+            const double *source = b->values + (row + p) * b->stride + column + panel;
+            for (j = 0; j < GEMM_NR; j++) {
+                packed[j] = j < width ? source[j] : 0;
+            }
+        }
+    }
+}
+
+/**
+ * Rows of a product a thread computes.
+ */
+typedef struct {
+    const DenseMatrix *a;
+    const DenseMatrix *b;
+    DenseMatrix *product;
+    size_t begin;
+    size_t end;
+    PanelKernel kernel;
+} ProductSlice;
+
+static void multiplySlice(ProductSlice *slice) {
+    const DenseMatrix *a = slice->a, *b = slice->b;
+    DenseMatrix *product = slice->product;
+    double *packedA = (double *) malloc(sizeof(double) * GEMM_MC * GEMM_KC);
+    double *packedB = (double *) malloc(sizeof(double) * GEMM_KC * GEMM_NC);
+    size_t column, depth, row, panelColumn, panelRow;
+    for (column = 0; column < b->columns; column += GEMM_NC) {
+        size_t columns = minSize(GEMM_NC, b->columns - column);
+        for (depth = 0; depth < a->columns; depth += GEMM_KC) {
+            size_t depthCount = minSize(GEMM_KC, a->columns - depth);
+            packColumns(b, depth, depthCount, column, columns, packedB);
+            for (row = slice->begin; row < slice->end; row += GEMM_MC) {
+                size_t rows = minSize(GEMM_MC, slice->end - row);
+                packRows(a, row, rows, depth, depthCount, packedA);
+                for (panelColumn = 0; panelColumn < columns; panelColumn += GEMM_NR) {
+                    for (panelRow = 0; panelRow < rows; panelRow += GEMM_MR) {
+                        slice->kernel(depthCount, packedA + panelRow * depthCount, packedB + panelColumn * depthCount,
+                                      product->values + (row + panelRow) * product->stride + column + panelColumn,
+                                      product->stride, minSize(GEMM_MR, rows - panelRow),
+                                      minSize(GEMM_NR, columns - panelColumn));
+                    }
+                }
+            }
+        }
+    }
+    free(packedB);
+    free(packedA);
+}
+
+#ifdef FLUXION_THREADS
+static void *multiplySliceThread(void *slice) {
+    multiplySlice((ProductSlice *) slice);
+    return NULL;
+}
+#endif
+
+DenseMatrix *denseMatrixMultiply(const DenseMatrix *a, const DenseMatrix *b, int threadCount) {
+    static PanelKernel kernel = NULL;
+    if (a->columns != b->rows) {
+        return NULL;
+    }
+    if (kernel == NULL) {
+        kernel = selectKernel();
+    }
+    DenseMatrix *product = initDenseMatrix(a->rows, b->columns);
+    ProductSlice whole = {a, b, product, 0, a->rows, kernel};
+#ifdef FLUXION_THREADS
+    if (threadCount <= 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? (int) processors : 1;
+    }
+    size_t panels = (a->rows + GEMM_MR - 1) / GEMM_MR;
+    if (a->rows * a->columns * b->columns < MATRIX_THREAD_THRESHOLD) {
+        threadCount = 1;
+    } else if ((size_t) threadCount > panels) {
+        threadCount = (int) panels;
+    }
+    if (threadCount > 1) {
+        ProductSlice *slices = (ProductSlice *) malloc(sizeof(ProductSlice) * threadCount);
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * threadCount);
+        int i, started = 0;
+        for (i = 0; i < threadCount; i++) { // Whole panels per thread.
+            slices[i] = whole;
+            slices[i].begin = panels * i / threadCount * GEMM_MR;
+            slices[i].end = i == threadCount - 1 ? a->rows : panels * (i + 1) / threadCount * GEMM_MR;
+        }
+        for (i = 1; i < threadCount; i++) {
+            if (pthread_create(threads + i, NULL, multiplySliceThread, slices + i) != 0) {
+                break;
+            }
+            started = i;
+        }
+        multiplySlice(slices);
+        for (i = started + 1; i < threadCount; i++) { // Threads that could not start run here.
+            multiplySlice(slices + i);
+        }
+        for (i = 1; i <= started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(slices);
+        return product;
+    }
+#else
+    (void) threadCount;
+#endif
+    multiplySlice(&whole);
+    return product;
+}
+
+/**
+ * Elementwise operations run over the padded rows as one array.
+ */
+typedef enum {
+    ELEMENT_ADD,
+    ELEMENT_SUBTRACT,
+    ELEMENT_SCALE,
+    ELEMENT_ADD_SCALAR
+} ElementOperation;
+
+static DenseMatrix *mapElements(const DenseMatrix *a, const DenseMatrix *b, double scalar, ElementOperation operation) {
+    if (b != NULL && (a->rows != b->rows || a->columns != b->columns)) {
+        return NULL;
+    }
+    DenseMatrix *result = initDenseMatrix(a->rows, a->columns);
+    size_t i, length = a->rows * a->stride;
+    double *t = result->values;
+    const double *x = a->values, *y = b != NULL ? b->values : NULL;
+#ifdef MATRIX_VECTOR
+    VectorDouble s = broadcast(scalar);
+    switch (operation) {
+        case ELEMENT_ADD:
+            for (i = 0; i < length; i += LANES) {
+                storeVector(t + i, loadVector(x + i) + loadVector(y + i));
+            }
+            break;
+        case ELEMENT_SUBTRACT:
+            for (i = 0; i < length; i += LANES) {
+                storeVector(t + i, loadVector(x + i) - loadVector(y + i));
+            }
+            break;
+        case ELEMENT_SCALE:
+            for (i = 0; i < length; i += LANES) {
+                storeVector(t + i, loadVector(x + i) * s);
+            }
+            break;
+        case ELEMENT_ADD_SCALAR:
+            for (i = 0; i < length; i += LANES) {
+                storeVector(t + i, loadVector(x + i) + s);
+            }
+            break;
+    }
+#else
+    for (i = 0; i < length; i++) {
+        switch (operation) {
+            case ELEMENT_ADD:
+                t[i] = x[i] + y[i];
+                break;
+            case ELEMENT_SUBTRACT:
+                t[i] = x[i] - y[i];
+                break;
+            case ELEMENT_SCALE:
+                t[i] = x[i] * scalar;
+                break;
+            case ELEMENT_ADD_SCALAR:
+                t[i] = x[i] + scalar;
+                break;
+        }
+    }
+#endif
+    return result;
+}
+
+DenseMatrix *denseMatrixAdd(const DenseMatrix *a, const DenseMatrix *b) {
+    return mapElements(a, b, 0, ELEMENT_ADD);
+}
+
+DenseMatrix *denseMatrixSubtract(const DenseMatrix *a, const DenseMatrix *b) {
+    return mapElements(a, b, 0, ELEMENT_SUBTRACT);
+}
+
+DenseMatrix *denseMatrixScale(const DenseMatrix *matrix, double factor) {
+    return mapElements(matrix, NULL, factor, ELEMENT_SCALE);
+}
+
+DenseMatrix *denseMatrixAddScalar(const DenseMatrix *matrix, double value) {
+    return mapElements(matrix, NULL, value, ELEMENT_ADD_SCALAR);
+}
+
+DenseMatrix *denseMatrixTranspose(const DenseMatrix *matrix) {
+    DenseMatrix *result = initDenseMatrix(matrix->columns, matrix->rows);
+    size_t blockRow, blockColumn, i, j;
+    // Blocks small enough that the rows read and the rows written both stay in L1.
+    for (blockRow = 0; blockRow < matrix->rows; blockRow += TRANSPOSE_BLOCK) {
+        size_t rowEnd = minSize(blockRow + TRANSPOSE_BLOCK, matrix->rows);
+        for (blockColumn = 0; blockColumn < matrix->columns; blockColumn += TRANSPOSE_BLOCK) {
+            size_t columnEnd = minSize(blockColumn + TRANSPOSE_BLOCK, matrix->columns);
+            for (i = blockRow; i < rowEnd; i++) {
+                for (j = blockColumn; j < columnEnd; j++) {
+                    result->values[j * result->stride + i] = matrix->values[i * matrix->stride + j];
+                }
+            }
+        }
+    }
+    return result;
+}
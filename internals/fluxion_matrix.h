@@ -0,0 +1,83 @@
+//
+// Dense matrices of doubles, the numeric fast path for matrix tokens.
+//
+
+#ifndef FLUXIONCORE_FLUXION_MATRIX_H
+#define FLUXIONCORE_FLUXION_MATRIX_H
+#include <stddef.h>
+#include "fluxion_token.h"
+
+#define MATRIX_THREAD_THRESHOLD ((size_t) 1 << 21) // Multiply-adds below which a product stays on one thread.
+
+/**
+ * A row major matrix of doubles. Rows are padded to a whole number of
+ * vectors, so elementwise operations never need a scalar tail.
+ * The padding holds unspecified values.
+ */
+typedef struct {
+    double *values; // Element (i, j) is at values[i * stride + j].
+    size_t rows;
+    size_t columns;
+    size_t stride; // Doubles from one row to the next, at least columns.
+} DenseMatrix;
+
+/**
+ * Allocate a matrix of zeros.
+ * @param rows Number of rows.
+ * @param columns Number of columns.
+ */
+DenseMatrix *initDenseMatrix(size_t rows, size_t columns);
+void freeDenseMatrix(DenseMatrix *matrix);
+
+static inline double denseMatrixGet(const DenseMatrix *matrix, size_t row, size_t column) {
+    return matrix->values[row * matrix->stride + column];
+}
+
+static inline void denseMatrixSet(DenseMatrix *matrix, size_t row, size_t column, double value) {
+    matrix->values[row * matrix->stride + column] = value;
+}
+
+/**
+ * Convert a matrix token whose members are all numbers.
+ * @param token Matrix to convert.
+ * @return the matrix, NULL if a member is missing or not a number, those stay tokens.
+ */
+DenseMatrix *denseMatrixFromToken(const MatrixToken *token);
+/**
+ * Convert back to a matrix of number tokens.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param matrix Matrix to convert.
+ */
+MatrixToken *denseMatrixToToken(Arena *arena, const DenseMatrix *matrix);
+
+/**
+ * Elementwise a + b.
+ * @return the sum, NULL if the shapes differ.
+ */
+DenseMatrix *denseMatrixAdd(const DenseMatrix *a, const DenseMatrix *b);
+/**
+ * Elementwise a - b.
+ * @return the difference, NULL if the shapes differ.
+ */
+DenseMatrix *denseMatrixSubtract(const DenseMatrix *a, const DenseMatrix *b);
+/**
+ * Every element multiplied by factor.
+ */
+DenseMatrix *denseMatrixScale(const DenseMatrix *matrix, double factor);
+/**
+ * Every element plus value.
+ */
+DenseMatrix *denseMatrixAddScalar(const DenseMatrix *matrix, double value);
+DenseMatrix *denseMatrixTranspose(const DenseMatrix *matrix);
+/**
+ * Matrix product, blocked for the caches with a vector kernel. Products of
+ * at least MATRIX_THREAD_THRESHOLD multiply-adds split their rows across threads.
+ * Sums may round differently from a plain loop, the kernel uses fused multiply-adds where it can.
+ * @param a Left matrix.
+ * @param b Right matrix, with as many rows as a has columns.
+ * @param threadCount Most threads to use, 0 for one per processor.
+ * @return the product, NULL if the shapes do not agree.
+ */
+DenseMatrix *denseMatrixMultiply(const DenseMatrix *a, const DenseMatrix *b, int threadCount);
+
+#endif //FLUXIONCORE_FLUXION_MATRIX_H
@@ -0,0 +1,70 @@
+//
+// Arithmetic modulo a word, shared by everything that computes modulo primes.
+//
+
+#include "fluxion_modular.h"
+
+bool numberModulo(Number number, uint64_t modulus, uint64_t *result) {
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            *result = int64Modulo(numberSmallValue(number), modulus);
+            return true;
+        case NUMBER_BIG:
+            *result = integerModulo(&numberObject(number)->as.integer, modulus);
+            return true;
+        case NUMBER_RATIONAL: {
+            uint64_t inverse;
+            if (!inverseModulo(integerModulo(&numberObject(number)->as.rational.denominator, modulus),
+                               modulus, &inverse)) {
+                return false;
+            }
+            *result = multiplyModulo(integerModulo(&numberObject(number)->as.rational.numerator, modulus),
+                                     inverse, modulus);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool wordIsPrime(uint64_t value) {
+    static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}; // Enough for every word.
+    size_t i, round;
+    if (value < 2) {
+        return false;
+    }
+    for (i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        if (value % bases[i] == 0) {
+            return value == bases[i];
+        }
+    }
+    uint64_t odd = value - 1;
+    int twos = 0;
+    while (!(odd & 1)) {
+        odd >>= 1;
+        twos++;
+    }
+    for (i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t x = powerModulo(bases[i], odd, value);
+        if (x == 1 || x == value - 1) {
+            continue;
+        }
+        for (round = 1; round < (size_t) twos && x != value - 1; round++) {
+            x = multiplyModulo(x, x, value);
+        }
+        if (x != value - 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t modularPrimeBelow(uint64_t bound) {
+    uint64_t candidate;
+    for (candidate = bound - 1; candidate >= 2; candidate--) {
+        if (wordIsPrime(candidate)) {
+            return candidate;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+//
+// Arithmetic modulo a word, shared by everything that computes modulo primes.
+//
+
+#ifndef FLUXIONCORE_FLUXION_MODULAR_H
+#define FLUXIONCORE_FLUXION_MODULAR_H
+#include "fluxion_bigint.h"
+#include "fluxion_number.h"
+
+#define MODULAR_PRIME_BITS 62 // Primes from modularPrimeBelow stay below 2^62, so sums of two never overflow.
+
+static inline uint64_t addModulo(uint64_t a, uint64_t b, uint64_t modulus) {
+    return a >= modulus - b ? a - (modulus - b) : a + b;
+}
+
+static inline uint64_t subtractModulo(uint64_t a, uint64_t b, uint64_t modulus) {
+    return a >= b ? a - b : a + (modulus - b);
+}
+
+static inline uint64_t multiplyModulo(uint64_t a, uint64_t b, uint64_t modulus) {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t) ((unsigned __int128) a * b % modulus);
+#else
+    uint64_t result = 0;
+    while (b) {
+        if (b & 1) {
+            result = addModulo(result, a, modulus);
+        }
+        a = addModulo(a, a, modulus);
+        b >>= 1;
+    }
+    return result;
+#endif
+}
+
+static inline uint64_t powerModulo(uint64_t base, uint64_t exponent, uint64_t modulus) {
+    uint64_t result = 1 % modulus;
+    while (exponent) {
+        if (exponent & 1) {
+            result = multiplyModulo(result, base, modulus);
+        }
+        base = multiplyModulo(base, base, modulus);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+/**
+ * Inverse with the extended Euclidean algorithm, the coefficient is tracked modulo modulus.
+ * @return false if value and modulus are not coprime.
+ */
+static inline bool inverseModulo(uint64_t value, uint64_t modulus, uint64_t *inverse) {
+    uint64_t r0 = modulus, r1 = value % modulus, t0 = 0, t1 = 1 % modulus;
+    while (r1) {
+        uint64_t quotient = r0 / r1, next = r0 - quotient * r1;
+        r0 = r1;
+        r1 = next;
+        next = subtractModulo(t0, multiplyModulo(quotient % modulus, t1, modulus), modulus);
+        t0 = t1;
+        t1 = next;
+    }
+    *inverse = t0;
+    return r0 == 1 || modulus == 1;
+}
+
+static inline uint64_t integerModulo(const BigInt *integer, uint64_t modulus) {
+    uint64_t remainder = bigIntModWord(integer, modulus);
+    return integer->negative && remainder ? modulus - remainder : remainder;
+}
+
+static inline uint64_t int64Modulo(int64_t value, uint64_t modulus) {
+    uint64_t remainder = (value < 0 ? (uint64_t) -(value + 1) + 1 : (uint64_t) value) % modulus;
+    return value < 0 && remainder ? modulus - remainder : remainder;
+}
+
+#if defined(__SIZEOF_INT128__)
+/**
+ * Precompute floor(factor * 2^64 / modulus), so multiplying by a fixed factor
+ * takes no division. The modulus must be below 2^63.
+ */
+static inline uint64_t shoupFactor(uint64_t factor, uint64_t modulus) {
+    return (uint64_t) (((unsigned __int128) factor << 64) / modulus);
+}
+
+/**
+ * a * factor modulo modulus, with shoup the shoupFactor of factor.
+ */
+static inline uint64_t shoupMultiply(uint64_t a, uint64_t factor, uint64_t shoup, uint64_t modulus) {
+    uint64_t quotient = (uint64_t) (((unsigned __int128) a * shoup) >> 64);
+    uint64_t result = a * factor - quotient * modulus; // In [0, 2 modulus).
+    return result >= modulus ? result - modulus : result;
+}
+#else
+static inline uint64_t shoupFactor(uint64_t factor, uint64_t modulus) {
+    (void) modulus;
+    return factor;
+}
+
+static inline uint64_t shoupMultiply(uint64_t a, uint64_t factor, uint64_t shoup, uint64_t modulus) {
+    (void) shoup;
+    return multiplyModulo(a, factor, modulus);
+}
+#endif
+
+/**
+ * Reduce an exact number, fractions by inverting their denominator.
+ * @return false for floats, errors and denominators not coprime with modulus.
+ */
+bool numberModulo(Number number, uint64_t modulus, uint64_t *result);
+/**
+ * Deterministic Miller-Rabin for words.
+ */
+bool wordIsPrime(uint64_t value);
+/**
+ * Find the largest prime below a bound, for walking down a list of primes.
+ * @param bound Exclusive bound, at most 2^MODULAR_PRIME_BITS.
+ * @return the prime, 0 if there is none.
+ */
+uint64_t modularPrimeBelow(uint64_t bound);
+
+#endif //FLUXIONCORE_FLUXION_MODULAR_H
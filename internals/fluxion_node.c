@@ -0,0 +1,703 @@
+//
+// Compact, index based expression nodes.
+//
+
+#include <math.h>
+#include <string.h>
+#include "fluxion_node.h"
+
+static const char *builtinSymbolNames[BUILTIN_SYMBOL_COUNT] = {
+        "sin", "cos", "tan", "exp", "log", "sqrt", "abs", "lim", "series"
+};
+
+/**
+ * Make sure an array has room for needed elements, doubling its capacity.
+ * @param array Pointer to the array.
+ * @param capacity Pointer to the capacity, in elements.
+ * @param needed Elements needed.
+ * @param elementSize Size of an element.
+ */
+static void reserveArray(void **array, uint32_t *capacity, uint32_t needed, size_t elementSize) {
+    if (needed <= *capacity) {
+        return;
+    }
+    uint32_t newCapacity = *capacity ? *capacity : 16;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    *array = realloc(*array, elementSize * newCapacity);
+    *capacity = newCapacity;
+}
+
+static uint64_t mixHash(uint64_t hash) {
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+static uint64_t combineHash(uint64_t hash, uint64_t value) {
+    return mixHash(hash * 0x9E3779B97F4A7C15ull + value);
+}
+
+static uint32_t hashName(const char *name, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+NodePool *initNodePool(void) {
+    NodePool *pool = (NodePool *) calloc(1, sizeof(NodePool));
+    int i;
+    for (i = 0; i < BUILTIN_SYMBOL_COUNT; i++) {
+        internSymbol(pool, builtinSymbolNames[i], strlen(builtinSymbolNames[i]));
+    }
+    return pool;
+}
+
+void freeNodePool(NodePool *pool) {
+    free(pool->tags);
+    free(pool->operands);
+    free(pool->lines);
+    free(pool->children);
+    uint32_t i;
+    for (i = 0; i < pool->numberCount; i++) {
+        freeNumber(pool->numbers[i]);
+    }
+    free(pool->numbers);
+    free(pool->numberValues);
+    free(pool->symbolChars);
+    free(pool->symbolOffsets);
+    free(pool->symbolIndex);
+    free(pool->hashes);
+    free(pool->nodeIndex);
+    free(pool);
+}
+
+static void rehashSymbols(NodePool *pool) {
+    uint32_t capacity = pool->symbolIndexCapacity ? pool->symbolIndexCapacity * 2 : 64;
+    uint32_t *index = (uint32_t *) calloc(capacity, sizeof(uint32_t));
+    uint32_t symbol;
+    for (symbol = 0; symbol < pool->symbolCount; symbol++) {
+        const char *name = symbolName(pool, symbol);
+        uint32_t slot = hashName(name, strlen(name)) & (capacity - 1);
+        while (index[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        index[slot] = symbol + 1;
+    }
+    free(pool->symbolIndex);
+    pool->symbolIndex = index;
+    pool->symbolIndexCapacity = capacity;
+}
+
+uint32_t internSymbol(NodePool *pool, const char *name, size_t length) {
+    if ((pool->symbolCount + 1) * 2 > pool->symbolIndexCapacity) { // Keep the load under a half.
+        rehashSymbols(pool);
+    }
+    uint32_t mask = pool->symbolIndexCapacity - 1;
+    uint32_t slot = hashName(name, length) & mask;
+    while (pool->symbolIndex[slot] != 0) {
+        uint32_t symbol = pool->symbolIndex[slot] - 1;
+        const char *existing = symbolName(pool, symbol);
+        if (strncmp(existing, name, length) == 0 && existing[length] == '\0') {
+            return symbol;
+        }
+        slot = (slot + 1) & mask;
+    }
+    uint32_t symbol = pool->symbolCount++;
+    reserveArray((void **) &pool->symbolOffsets, &pool->symbolCapacity, pool->symbolCount, sizeof(uint32_t));
+    reserveArray((void **) &pool->symbolChars, &pool->symbolCharCapacity,
+                 pool->symbolCharCount + (uint32_t) length + 1, sizeof(char));
+    pool->symbolOffsets[symbol] = pool->symbolCharCount;
+    memcpy(pool->symbolChars + pool->symbolCharCount, name, length);
+    pool->symbolChars[pool->symbolCharCount + length] = '\0';
+    pool->symbolCharCount += (uint32_t) length + 1;
+    pool->symbolIndex[slot] = symbol + 1;
+    return symbol;
+}
+
+static void rehashNodes(NodePool *pool) {
+    uint32_t capacity = pool->nodeIndexCapacity ? pool->nodeIndexCapacity * 2 : 64;
+    uint32_t *index = (uint32_t *) calloc(capacity, sizeof(uint32_t));
+    NodeId node;
+    for (node = 0; node < pool->count; node++) {
+        uint32_t slot = (uint32_t) pool->hashes[node] & (capacity - 1);
+        while (index[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        index[slot] = node + 1;
+    }
+    free(pool->nodeIndex);
+    pool->nodeIndex = index;
+    pool->nodeIndexCapacity = capacity;
+}
+
+/**
+ * Whether two number nodes would hold the same number.
+ */
+static bool sameNumber(Number a, Number b) {
+    if (numberKind(a) != numberKind(b)) {
+        return false;
+    }
+    return numberIsError(a) ? a.bits == b.bits : numberCompare(a, b) == 0;
+}
+
+/**
+ * Whether a node is the one a key describes. Operators and calls are keyed
+ * by their children, numbers by their value and symbols by their index.
+ */
+static bool nodeMatches(const NodePool *pool, NodeId node, uint8_t tag, uint32_t symbol, Number number,
+                        const NodeId *children, uint32_t count) {
+    if (pool->tags[node] != tag) {
+        return false;
+    }
+    switch (tag) {
+        case NODE_NUMBER:
+            return sameNumber(nodeNumberOf(pool, node), number);
+        case NODE_SYMBOL:
+            return pool->operands[node] == symbol;
+        default:
+            return nodeChildCount(pool, node) == count &&
+                   memcmp(pool->children + pool->operands[node] + 1, children, count * sizeof(NodeId)) == 0;
+    }
+}
+
+/**
+ * Find a node in the index.
+ * @return the node, NODE_NONE if there is none.
+ */
+static NodeId findNode(const NodePool *pool, uint64_t hash, uint8_t tag, uint32_t symbol, Number number,
+                       const NodeId *children, uint32_t count) {
+    if (pool->nodeIndexCapacity == 0) {
+        return NODE_NONE;
+    }
+    uint32_t mask = pool->nodeIndexCapacity - 1, slot = (uint32_t) hash & mask;
+    while (pool->nodeIndex[slot] != 0) {
+        NodeId node = pool->nodeIndex[slot] - 1;
+        if (pool->hashes[node] == hash && nodeMatches(pool, node, tag, symbol, number, children, count)) {
+            return node;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NODE_NONE;
+}
+
+/**
+ * Append a node to the pool and index it.
+ * @param pool Pool to append to.
+ * @param tag Tag of the node.
+ * @param operand Operand of the node.
+ * @param lineCount Line of the node.
+ * @param hash Structural hash of the node.
+ * @return the new node.
+ */
+static NodeId appendNode(NodePool *pool, uint8_t tag, uint32_t operand, int lineCount, uint64_t hash) {
+    if (pool->count >= pool->capacity) {
+        uint32_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+        pool->tags = (uint8_t *) realloc(pool->tags, capacity * sizeof(uint8_t));
+        pool->operands = (uint32_t *) realloc(pool->operands, capacity * sizeof(uint32_t));
+        pool->lines = (int32_t *) realloc(pool->lines, capacity * sizeof(int32_t));
+        pool->hashes = (uint64_t *) realloc(pool->hashes, capacity * sizeof(uint64_t));
+        pool->capacity = capacity;
+    }
+    NodeId node = pool->count++;
+    pool->tags[node] = tag;
+    pool->operands[node] = operand;
+    pool->lines[node] = lineCount;
+    pool->hashes[node] = hash;
+    if (pool->count * 2 > pool->nodeIndexCapacity) { // Keep the load under a half, the new node is indexed here.
+        rehashNodes(pool);
+        return node;
+    }
+    uint32_t mask = pool->nodeIndexCapacity - 1, slot = (uint32_t) hash & mask;
+    while (pool->nodeIndex[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    pool->nodeIndex[slot] = node + 1;
+    return node;
+}
+
+/**
+ * Append a child list, prefixed with its length.
+ * @return offset of the list in children.
+ */
+static uint32_t appendChildren(NodePool *pool, const NodeId *children, uint32_t count) {
+    uint32_t offset = pool->childCount;
+    reserveArray((void **) &pool->children, &pool->childCapacity, offset + count + 1, sizeof(NodeId));
+    pool->children[offset] = count;
+    memcpy(pool->children + offset + 1, children, count * sizeof(NodeId));
+    pool->childCount = offset + count + 1;
+    return offset;
+}
+
+/**
+ * Find or append a number with its rounded value.
+ */
+static NodeId internNumber(NodePool *pool, int lineCount, Number number, double value) {
+    uint64_t bits;
+    double normalised = value + 0.0; // -0 to 0.
+    memcpy(&bits, &normalised, sizeof(bits));
+    uint64_t hash = combineHash(combineHash(NODE_NUMBER, numberKind(number)),
+                                numberIsError(number) ? number.bits : bits);
+    NodeId node = findNode(pool, hash, NODE_NUMBER, 0, number, NULL, 0);
+    if (node != NODE_NONE) {
+        freeNumber(number);
+        return node;
+    }
+    uint32_t capacity = pool->numberCapacity;
+    reserveArray((void **) &pool->numbers, &pool->numberCapacity, pool->numberCount + 1, sizeof(Number));
+    reserveArray((void **) &pool->numberValues, &capacity, pool->numberCount + 1, sizeof(double));
+    pool->numbers[pool->numberCount] = number;
+    pool->numberValues[pool->numberCount] = value;
+    return appendNode(pool, NODE_NUMBER, pool->numberCount++, lineCount, hash);
+}
+
+/**
+ * Find or append an operator or a call.
+ */
+static NodeId internParent(NodePool *pool, int lineCount, uint8_t tag, const NodeId *children, uint32_t count) {
+    uint64_t hash = combineHash(tag, count);
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        hash = combineHash(hash, pool->hashes[children[i]]);
+    }
+    NodeId node = findNode(pool, hash, tag, 0, numberFromSmall(0), children, count);
+    if (node != NODE_NONE) {
+        return node;
+    }
+    return appendNode(pool, tag, appendChildren(pool, children, count), lineCount, hash);
+}
+
+NodeId nodeNumber(NodePool *pool, int lineCount, double value) {
+    return internNumber(pool, lineCount, numberFromDouble(value), value);
+}
+
+NodeId nodeExactNumber(NodePool *pool, int lineCount, Number number) {
+    return internNumber(pool, lineCount, number, numberToDouble(number));
+}
+
+NodeId nodeSymbol(NodePool *pool, int lineCount, const char *name, size_t length) {
+    return nodeSymbolIndex(pool, lineCount, internSymbol(pool, name, length));
+}
+
+NodeId nodeSymbolIndex(NodePool *pool, int lineCount, uint32_t symbol) {
+    const char *name = symbolName(pool, symbol);
+    uint64_t hash = combineHash(NODE_SYMBOL, hashName(name, strlen(name)));
+    NodeId node = findNode(pool, hash, NODE_SYMBOL, symbol, numberFromSmall(0), NULL, 0);
+    return node != NODE_NONE ? node : appendNode(pool, NODE_SYMBOL, symbol, lineCount, hash);
+}
+
+NodeId nodeOperator(NodePool *pool, int lineCount, OperatorType operatorType, const NodeId *children, uint32_t count) {
+    return internParent(pool, lineCount, (uint8_t) operatorType, children, count);
+}
+
+NodeId nodeUnary(NodePool *pool, int lineCount, OperatorType operatorType, NodeId child) {
+    return nodeOperator(pool, lineCount, operatorType, &child, 1);
+}
+
+NodeId nodeBinary(NodePool *pool, int lineCount, OperatorType operatorType, NodeId left, NodeId right) {
+    NodeId children[2] = {left, right};
+    return nodeOperator(pool, lineCount, operatorType, children, 2);
+}
+
+NodeId nodeCall(NodePool *pool, int lineCount, uint32_t symbol, const NodeId *args, uint32_t count) {
+    NodeId stack[8];
+    NodeId *children = count < 8 ? stack : (NodeId *) malloc(sizeof(NodeId) * (count + 1));
+    children[0] = nodeSymbolIndex(pool, lineCount, symbol);
+    memcpy(children + 1, args, count * sizeof(NodeId));
+    NodeId node = internParent(pool, lineCount, NODE_CALL, children, count + 1);
+    if (children != stack) {
+        free(children);
+    }
+    return node;
+}
+
+static const Token *skipExpressions(const Token *token) {
+    while (token != NULL && token->tokenType == EXPRESSION) {
+        token = ((const ExpressionToken *) token)->root;
+    }
+    return token;
+}
+
+/**
+ * Number of children a token is converted with, 0 for leaves.
+ */
+static uint32_t tokenChildCount(const Token *token) {
+    if (token->tokenType == IDENTIFIER && ((const IdentifierToken *) token)->identifierType != Variable) {
+        return (uint32_t) ((const FunctionToken *) token)->current;
+    }
+    if (token->tokenType == OPERATOR) {
+        const OperatorToken *operator = (const OperatorToken *) token;
+        return (operator->left != NULL) + (operator->right != NULL);
+    }
+    return 0;
+}
+
+static const Token *tokenChild(const Token *token, uint32_t index) {
+    if (token->tokenType == IDENTIFIER) {
+        return ((const FunctionToken *) token)->args[index];
+    }
+    const OperatorToken *operator = (const OperatorToken *) token;
+    return index == 0 && operator->left != NULL ? operator->left : operator->right;
+}
+
+typedef struct {
+    const Token *token;
+    uint32_t next; // Child converted next.
+} TokenFrame;
+
+NodeId nodeFromToken(NodePool *pool, const Token *token) {
+    // Children are converted first onto a stack of nodes, a parent then takes its count off the top.
+    uint32_t stackCount = 0, stackCapacity = 64, nodeCount = 0, nodeCapacity = 64;
+    TokenFrame *stack = (TokenFrame *) malloc(sizeof(TokenFrame) * stackCapacity);
+    NodeId *nodes = (NodeId *) malloc(sizeof(NodeId) * nodeCapacity);
+    NodeId result = NODE_NONE;
+    stack[stackCount++] = (TokenFrame) {skipExpressions(token), 0};
+    while (stackCount > 0) {
+        TokenFrame *frame = stack + stackCount - 1;
+        const Token *current = frame->token;
+        if (current == NULL) {
+            break;
+        }
+        uint32_t count = tokenChildCount(current);
+        if (frame->next < count) {
+            const Token *child = skipExpressions(tokenChild(current, frame->next++));
+            if (stackCount == stackCapacity) {
+                stackCapacity *= 2;
+                stack = (TokenFrame *) realloc(stack, sizeof(TokenFrame) * stackCapacity);
+            }
+            stack[stackCount++] = (TokenFrame) {child, 0};
+            continue;
+        }
+        NodeId node = NODE_NONE;
+        nodeCount -= count;
+        switch (current->tokenType) {
+            case NUMBER:
+                node = nodeExactNumber(pool, current->lineCount, copyNumber(((const NumberToken *) current)->number));
+                break;
+            case IDENTIFIER: {
+                const IdentifierToken *identifier = (const IdentifierToken *) current;
+                size_t length = strlen(identifier->name);
+                node = identifier->identifierType == Variable ?
+                       nodeSymbol(pool, current->lineCount, identifier->name, length) :
+                       nodeCall(pool, current->lineCount, internSymbol(pool, identifier->name, length),
+                                nodes + nodeCount, count);
+                break;
+            }
+            case OPERATOR:
+                node = count == 0 ? NODE_NONE : nodeOperator(pool, current->lineCount,
+                                                             ((const OperatorToken *) current)->operatorType,
+                                                             nodes + nodeCount, count);
+                break;
+            default:
+                break;
+        }
+        if (node == NODE_NONE) { // Nothing above converts either.
+            break;
+        }
+        if (nodeCount == nodeCapacity) {
+            nodeCapacity *= 2;
+            nodes = (NodeId *) realloc(nodes, sizeof(NodeId) * nodeCapacity);
+        }
+        nodes[nodeCount++] = node;
+        if (--stackCount == 0) {
+            result = node;
+        }
+    }
+    free(stack);
+    free(nodes);
+    return result;
+}
+
+static double evaluateCall(const NodePool *pool, NodeId node, const double *symbolValues) {
+    if (nodeChildCount(pool, node) != 2) {
+        return NAN; // Every builtin is unary.
+    }
+    double x = evaluateNode(pool, nodeChild(pool, node, 1), symbolValues);
+    switch (nodeSymbolOf(pool, nodeChild(pool, node, 0))) {
+        case SYMBOL_SIN:
+            return sin(x);
+        case SYMBOL_COS:
+            return cos(x);
+        case SYMBOL_TAN:
+            return tan(x);
+        case SYMBOL_EXP:
+            return exp(x);
+        case SYMBOL_LOG:
+            return log(x);
+        case SYMBOL_SQRT:
+            return sqrt(x);
+        case SYMBOL_ABS:
+            return fabs(x);
+        default:
+            return NAN;
+    }
+}
+
+/**
+ * Slot of a node in the table of a subtree, the empty slot it would go in if it is not there.
+ */
+static uint32_t subtreeSlot(const NodeId *keys, uint32_t capacity, NodeId node) {
+    uint32_t slot = (uint32_t) mixHash(node) & (capacity - 1);
+    while (keys[slot] != NODE_NONE && keys[slot] != node) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return slot;
+}
+
+static void growSubtree(NodeSubtree *subtree) {
+    uint32_t capacity = subtree->capacity * 2, i;
+    NodeId *keys = (NodeId *) malloc(sizeof(NodeId) * capacity);
+    uint32_t *positions = (uint32_t *) malloc(sizeof(uint32_t) * capacity);
+    memset(keys, 0xFF, sizeof(NodeId) * capacity);
+    for (i = 0; i < subtree->capacity; i++) {
+        if (subtree->keys[i] != NODE_NONE) {
+            uint32_t slot = subtreeSlot(keys, capacity, subtree->keys[i]);
+            keys[slot] = subtree->keys[i];
+            positions[slot] = subtree->positions[i];
+        }
+    }
+    free(subtree->keys);
+    free(subtree->positions);
+    subtree->keys = keys;
+    subtree->positions = positions;
+    subtree->capacity = capacity;
+    subtree->nodes = (NodeId *) realloc(subtree->nodes, sizeof(NodeId) * (capacity / 2));
+}
+
+typedef struct {
+    NodeId node;
+    uint32_t next; // Child visited next.
+} SubtreeFrame;
+
+void initNodeSubtree(NodeSubtree *subtree, const NodePool *pool, NodeId root, bool intoCalls) {
+    // Nodes met are at most half the table, so nodes never holds more than that.
+    subtree->capacity = 64;
+    subtree->count = 0;
+    subtree->keys = (NodeId *) malloc(sizeof(NodeId) * subtree->capacity);
+    subtree->positions = (uint32_t *) malloc(sizeof(uint32_t) * subtree->capacity);
+    subtree->nodes = (NodeId *) malloc(sizeof(NodeId) * (subtree->capacity / 2));
+    memset(subtree->keys, 0xFF, sizeof(NodeId) * subtree->capacity);
+    uint32_t met = 1, stackCount = 1, stackCapacity = 64;
+    SubtreeFrame *stack = (SubtreeFrame *) malloc(sizeof(SubtreeFrame) * stackCapacity);
+    subtree->keys[subtreeSlot(subtree->keys, subtree->capacity, root)] = root;
+    stack[0] = (SubtreeFrame) {root, 0};
+    while (stackCount > 0) {
+        SubtreeFrame *frame = stack + stackCount - 1;
+        uint8_t tag = pool->tags[frame->node];
+        bool walked = tag < NODE_NUMBER || (intoCalls && tag == NODE_CALL);
+        if (walked && frame->next < nodeChildCount(pool, frame->node)) {
+            NodeId child = nodeChild(pool, frame->node, frame->next++);
+            uint32_t slot = subtreeSlot(subtree->keys, subtree->capacity, child);
+            if (subtree->keys[slot] != NODE_NONE) {
+                continue;
+            }
+            if (++met * 2 > subtree->capacity) {
+                growSubtree(subtree);
+                slot = subtreeSlot(subtree->keys, subtree->capacity, child);
+            }
+            subtree->keys[slot] = child;
+            if (stackCount == stackCapacity) {
+                stackCapacity *= 2;
+                stack = (SubtreeFrame *) realloc(stack, sizeof(SubtreeFrame) * stackCapacity);
+            }
+            stack[stackCount++] = (SubtreeFrame) {child, 0};
+            continue;
+        }
+        subtree->positions[subtreeSlot(subtree->keys, subtree->capacity, frame->node)] = subtree->count;
+        subtree->nodes[subtree->count++] = frame->node;
+        stackCount--;
+    }
+    free(stack);
+}
+
+void freeNodeSubtree(NodeSubtree *subtree) {
+    free(subtree->nodes);
+    free(subtree->keys);
+    free(subtree->positions);
+}
+
+uint32_t nodeSubtreePosition(const NodeSubtree *subtree, NodeId node) {
+    uint32_t slot = subtreeSlot(subtree->keys, subtree->capacity, node);
+    return subtree->keys[slot] == node ? subtree->positions[slot] : UINT32_MAX;
+}
+
+double evaluateNode(const NodePool *pool, NodeId node, const double *symbolValues) {
+    uint8_t tag = nodeTag(pool, node);
+    switch (tag) {
+        case NODE_NUMBER:
+            return nodeNumberValue(pool, node);
+        case NODE_SYMBOL:
+            return symbolValues ? symbolValues[nodeSymbolOf(pool, node)] : NAN;
+        case NODE_CALL:
+            return evaluateCall(pool, node, symbolValues);
+        default:
+            break;
+    }
+    double a = evaluateNode(pool, nodeChild(pool, node, 0), symbolValues);
+    if (nodeChildCount(pool, node) == 1) {
+        switch ((OperatorType) tag) {
+            case MINUS:
+                return -a;
+            case NOT:
+                return !a;
+            case FACTORIAL:
+                return tgamma(a + 1);
+            default:
+                return NAN;
+        }
+    }
+    double b = evaluateNode(pool, nodeChild(pool, node, 1), symbolValues);
+    switch ((OperatorType) tag) {
+        case PLUS:
+            return a + b;
+        case MINUS:
+            return a - b;
+        case MULTIPLY:
+            return a * b;
+        case DIVIDE:
+            return a / b;
+        case POWER:
+            return pow(a, b);
+        case LESS:
+            return a < b;
+        case GREATER:
+            return a > b;
+        case LEQ:
+            return a <= b;
+        case GEQ:
+            return a >= b;
+        case EQUAL:
+            return a == b;
+        case NEQ:
+            return a != b;
+        case AMPERSAND:
+            return a && b;
+        case BAR:
+            return a || b;
+        default:
+            return NAN; // Symbolic only operators.
+    }
+}
+
+/**
+ * Precedence of an operator when printing, higher binds tighter.
+ */
+static int printPrecedence(const NodePool *pool, NodeId node) {
+    if (nodeTag(pool, node) == NODE_NUMBER) { // Fractions print as a division, negatives as a prefix minus.
+        Number number = nodeNumberOf(pool, node);
+        return numberKind(number) == NUMBER_RATIONAL ? 8 : numberSign(number) < 0 ? 9 : 100;
+    }
+    if (!nodeIsOperator(pool, node)) {
+        return 100;
+    }
+    OperatorType operatorType = (OperatorType) nodeTag(pool, node);
+    if (nodeChildCount(pool, node) == 1) {
+        return operatorType == FACTORIAL || operatorType == DIFF ? 11 : 9;
+    }
+    switch (operatorType) {
+        case SCOPE:
+        case ASSIGN:
+            return 1;
+        case BAR:
+            return 2;
+        case AMPERSAND:
+            return 3;
+        case IN:
+            return 5;
+        case LIMIT:
+            return 6;
+        case PLUS:
+        case MINUS:
+            return 7;
+        case MULTIPLY:
+        case DIVIDE:
+            return 8;
+        case POWER:
+            return 10;
+        case GET:
+            return 12;
+        default: // Comparisons.
+            return 4;
+    }
+}
+
+static bool isRightAssociative(OperatorType operatorType) {
+    return operatorType == POWER || operatorType == ASSIGN || operatorType == SCOPE || operatorType == LIMIT;
+}
+
+static void printChild(const NodePool *pool, NodeId child, bool parenthesise, FILE *file) {
+    if (parenthesise) {
+        fputc('(', file);
+    }
+    printNode(pool, child, file);
+    if (parenthesise) {
+        fputc(')', file);
+    }
+}
+
+void printNode(const NodePool *pool, NodeId node, FILE *file) {
+    uint8_t tag = nodeTag(pool, node);
+    uint32_t i;
+    switch (tag) {
+        case NODE_NUMBER: {
+            Number number = nodeNumberOf(pool, node);
+            if (numberKind(number) != NUMBER_FLOAT) { // Exact, print every digit.
+                printNumber(number, file);
+                return;
+            }
+            double value = nodeNumberValue(pool, node);
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.15g", value);
+            if (strtod(buffer, NULL) != value) {
+                snprintf(buffer, sizeof(buffer), "%.17g", value);
+            }
+            fputs(buffer, file);
+            return;
+        }
+        case NODE_SYMBOL:
+            fputs(symbolName(pool, nodeSymbolOf(pool, node)), file);
+            return;
+        case NODE_CALL:
+            printNode(pool, nodeChild(pool, node, 0), file);
+            fputc('(', file);
+            for (i = 1; i < nodeChildCount(pool, node); i++) {
+                if (i > 1) {
+                    fputs(", ", file);
+                }
+                printNode(pool, nodeChild(pool, node, i), file);
+            }
+            fputc(')', file);
+            return;
+        default:
+            break;
+    }
+    OperatorType operatorType = (OperatorType) tag;
+    int precedence = printPrecedence(pool, node);
+    NodeId left = nodeChild(pool, node, 0);
+    if (nodeChildCount(pool, node) == 1) {
+        bool postfix = operatorType == FACTORIAL || operatorType == DIFF;
+        if (!postfix) {
+            fputs(getOperatorSymbol(operatorType), file);
+        }
+        printChild(pool, left, printPrecedence(pool, left) <= precedence, file);
+        if (postfix) {
+            fputs(getOperatorSymbol(operatorType), file);
+        }
+        return;
+    }
+    NodeId right = nodeChild(pool, node, 1);
+    bool rightAssociative = isRightAssociative(operatorType);
+    int leftPrecedence = printPrecedence(pool, left);
+    int rightPrecedence = printPrecedence(pool, right);
+    printChild(pool, left, leftPrecedence < precedence || (leftPrecedence == precedence && rightAssociative), file);
+    if (operatorType == GET || operatorType == POWER) {
+        fputs(getOperatorSymbol(operatorType), file);
+    } else {
+        fprintf(file, " %s ", getOperatorSymbol(operatorType));
+    }
+    printChild(pool, right, rightPrecedence < precedence || (rightPrecedence == precedence && !rightAssociative), file);
+}
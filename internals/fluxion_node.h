@@ -0,0 +1,232 @@
+//
+// Compact, index based expression nodes.
+//
+
+#ifndef FLUXIONCORE_FLUXION_NODE_H
+#define FLUXIONCORE_FLUXION_NODE_H
+#include <stdio.h>
+#include "commons.h"
+#include "fluxion_number.h"
+#include "fluxion_token.h"
+
+/**
+ * Index of a node inside its pool.
+ */
+typedef uint32_t NodeId;
+
+#define NODE_NONE ((NodeId) 0xFFFFFFFFu)
+
+/**
+ * Tag of a node, operators are tagged with
+ * their OperatorType, every other kind comes after them.
+ */
+typedef enum {
+    NODE_NUMBER = 32, // operand indexes numbers.
+    NODE_SYMBOL, // operand indexes the symbol table.
+    NODE_CALL // operand indexes children, first child is the function symbol.
+} NodeTag;
+
+/**
+ * Symbols every pool interns on creation, in this order,
+ * so passes can recognise them by index.
+ */
+typedef enum {
+    SYMBOL_SIN,
+    SYMBOL_COS,
+    SYMBOL_TAN,
+    SYMBOL_EXP,
+    SYMBOL_LOG,
+    SYMBOL_SQRT,
+    SYMBOL_ABS,
+    SYMBOL_LIM, // lim(e, x -> a)
+    SYMBOL_SERIES, // series(e, x -> a, n)
+    BUILTIN_SYMBOL_COUNT
+} BuiltinSymbol;
+
+/**
+ * A struct of arrays node pool, node i is described
+ * by tags[i], operands[i] and lines[i]. For operators and calls
+ * children[operands[i]] holds the child count, followed by the children.
+ * Children are always created before their parents.
+ *
+ * Nodes are hash consed, creating a node structurally equal to one in the
+ * pool returns that one. Equal subtrees are a single node, so equality is
+ * comparing ids and passes can memoise on ids. A shared node keeps the
+ * line it was first created on. The pool owns every node and frees them
+ * all at once, so sharing never frees anything twice.
+ */
+typedef struct {
+    uint8_t *tags;
+    uint32_t *operands;
+    int32_t *lines;
+    uint32_t count;
+    uint32_t capacity;
+
+    NodeId *children;
+    uint32_t childCount;
+    uint32_t childCapacity;
+
+    Number *numbers; // Exact values, owned by the pool.
+    double *numberValues; // numbers[i] rounded, for evaluation.
+    uint32_t numberCount;
+    uint32_t numberCapacity;
+
+    char *symbolChars; // Null terminated names, back to back.
+    uint32_t *symbolOffsets;
+    uint32_t symbolCount;
+    uint32_t symbolCapacity;
+    uint32_t symbolCharCount;
+    uint32_t symbolCharCapacity;
+    uint32_t *symbolIndex; // Open addressing table of symbol + 1, 0 is empty.
+    uint32_t symbolIndexCapacity;
+
+    uint64_t *hashes; // Structural hash of each node, the same across pools.
+    uint32_t *nodeIndex; // Open addressing table of node + 1, 0 is empty.
+    uint32_t nodeIndexCapacity;
+} NodePool;
+
+/**
+ * Initialise an empty node pool.
+ * @return the newly created pool.
+ */
+NodePool *initNodePool(void);
+/**
+ * Free the pool and every node in it.
+ * @param pool Pool to free.
+ */
+void freeNodePool(NodePool *pool);
+
+/**
+ * Intern a symbol name.
+ * @param pool Pool to intern into.
+ * @param name Start of the name, does not need to be null terminated.
+ * @param length Length of the name.
+ * @return index of the symbol.
+ */
+uint32_t internSymbol(NodePool *pool, const char *name, size_t length);
+
+NodeId nodeNumber(NodePool *pool, int lineCount, double value);
+/**
+ * Create a number node holding an exact number. Numbers are the same
+ * node when they are of the same kind and equal, so 1/2 and 0.5 are not.
+ * @param pool Pool to create into.
+ * @param lineCount Line the number appears in.
+ * @param number Number to take ownership of, freed if the node exists.
+ * @return the node.
+ */
+NodeId nodeExactNumber(NodePool *pool, int lineCount, Number number);
+NodeId nodeSymbol(NodePool *pool, int lineCount, const char *name, size_t length);
+NodeId nodeSymbolIndex(NodePool *pool, int lineCount, uint32_t symbol);
+/**
+ * Create an operator node.
+ * @param pool Pool to create into.
+ * @param lineCount Line the operator appears in.
+ * @param operatorType Type of the operator, which is the tag.
+ * @param children Operands of the operator.
+ * @param count Operand count, 1 for prefix and postfix operators.
+ * @return the new node.
+ */
+NodeId nodeOperator(NodePool *pool, int lineCount, OperatorType operatorType, const NodeId *children, uint32_t count);
+NodeId nodeUnary(NodePool *pool, int lineCount, OperatorType operatorType, NodeId child);
+NodeId nodeBinary(NodePool *pool, int lineCount, OperatorType operatorType, NodeId left, NodeId right);
+/**
+ * Create a function call node.
+ * @param pool Pool to create into.
+ * @param lineCount Line the call appears in.
+ * @param symbol Symbol index of the function name.
+ * @param args Arguments of the call.
+ * @param count Argument count.
+ * @return the new node.
+ */
+NodeId nodeCall(NodePool *pool, int lineCount, uint32_t symbol, const NodeId *args, uint32_t count);
+
+static inline uint8_t nodeTag(const NodePool *pool, NodeId node) {
+    return pool->tags[node];
+}
+
+static inline bool nodeIsOperator(const NodePool *pool, NodeId node) {
+    return pool->tags[node] < NODE_NUMBER;
+}
+
+static inline int nodeLine(const NodePool *pool, NodeId node) {
+    return pool->lines[node];
+}
+
+static inline uint32_t nodeChildCount(const NodePool *pool, NodeId node) {
+    return pool->children[pool->operands[node]];
+}
+
+static inline NodeId nodeChild(const NodePool *pool, NodeId node, uint32_t index) {
+    return pool->children[pool->operands[node] + 1 + index];
+}
+
+static inline double nodeNumberValue(const NodePool *pool, NodeId node) {
+    return pool->numberValues[pool->operands[node]];
+}
+
+static inline Number nodeNumberOf(const NodePool *pool, NodeId node) {
+    return pool->numbers[pool->operands[node]];
+}
+
+static inline uint32_t nodeSymbolOf(const NodePool *pool, NodeId node) {
+    return pool->operands[node];
+}
+
+static inline uint64_t nodeHash(const NodePool *pool, NodeId node) {
+    return pool->hashes[node];
+}
+
+static inline const char *symbolName(const NodePool *pool, uint32_t symbol) {
+    return pool->symbolChars + pool->symbolOffsets[symbol];
+}
+
+/**
+ * The distinct nodes under a root, children before their parents, found by a
+ * walk from the root. Passes that keep a value per node index them by position,
+ * so they cost the size of the expression rather than that of the pool.
+ */
+typedef struct {
+    NodeId *nodes; // The root last.
+    uint32_t count;
+    NodeId *keys; // Open addressing table of the nodes met, NODE_NONE is empty.
+    uint32_t *positions; // Position in nodes of each key.
+    uint32_t capacity; // Of the table, a power of two.
+} NodeSubtree;
+
+/**
+ * Collect the nodes under a root, without recursing.
+ * @param intoCalls Whether the arguments of calls are collected too, operands of operators always are.
+ */
+void initNodeSubtree(NodeSubtree *subtree, const NodePool *pool, NodeId root, bool intoCalls);
+void freeNodeSubtree(NodeSubtree *subtree);
+/**
+ * Position of a node in a subtree.
+ * @return the position, UINT32_MAX if the node is not in it.
+ */
+uint32_t nodeSubtreePosition(const NodeSubtree *subtree, NodeId node);
+
+/**
+ * Intern an expression token and everything under it.
+ * @param pool Pool to intern into.
+ * @param token Expression, operator, identifier, function or number token.
+ * @return the node, NODE_NONE if the token or one under it is of another kind, like a set.
+ */
+NodeId nodeFromToken(NodePool *pool, const Token *token);
+
+/**
+ * Evaluate a node numerically.
+ * @param pool Pool the node is in.
+ * @param node Node to evaluate.
+ * @param symbolValues Values of the variables, indexed by symbol, may be NULL.
+ * @return the value, NaN if it is not defined.
+ */
+double evaluateNode(const NodePool *pool, NodeId node, const double *symbolValues);
+/**
+ * Print a node in Fluxion syntax, with the minimum parentheses.
+ * @param pool Pool the node is in.
+ * @param node Node to print.
+ * @param file File to print to.
+ */
+void printNode(const NodePool *pool, NodeId node, FILE *file);
+
+#endif //FLUXIONCORE_FLUXION_NODE_H
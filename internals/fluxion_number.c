@@ -0,0 +1,920 @@
+//
+// The numeric tower, immediate integers promote to big integers,
+// rationals and arbitrary precision floats.
+//
+
+#include <string.h>
+#include <math.h>
+#include "fluxion_number.h"
+
+#define NUMBER_OBJECT_POOL_DEPTH 256
+#define WORD_DECIMAL_MAX_SCALE 19 // 10^19 is the largest power of ten in a word.
+
+static FLUXION_THREAD_LOCAL NumberObject *objectPool[NUMBER_OBJECT_POOL_DEPTH];
+static FLUXION_THREAD_LOCAL int objectPoolCount;
+
+static Limb oneLimb[1] = {1};
+static const BigInt bigIntOne = {oneLimb, 1, 0, false};
+
+typedef enum {
+    ARITHMETIC_ADD,
+    ARITHMETIC_SUBTRACT,
+    ARITHMETIC_MULTIPLY,
+    ARITHMETIC_DIVIDE
+} Arithmetic;
+
+static NumberObject *allocObject(NumberKind kind) {
+    NumberObject *object = objectPoolCount > 0 ? objectPool[--objectPoolCount]
+                                               : (NumberObject *) malloc(sizeof(NumberObject));
+    object->kind = kind;
+    object->references = 1;
+    return object;
+}
+
+static Number wrapObject(NumberObject *object) {
+    Number number = {(uint64_t) (uintptr_t) object};
+    return number;
+}
+
+NumberKind numberKind(Number number) {
+    switch (number.bits & NUMBER_TAG_MASK) {
+        case NUMBER_TAG_SMALL:
+            return NUMBER_SMALL;
+        case NUMBER_TAG_ERROR:
+            return NUMBER_ERROR;
+        default:
+            return (NumberKind) numberObject(number)->kind;
+    }
+}
+
+void releaseNumberObject(NumberObject *object) {
+    switch (object->kind) {
+        case NUMBER_BIG:
+            freeBigInt(&object->as.integer);
+            break;
+        case NUMBER_RATIONAL:
+            freeBigInt(&object->as.rational.numerator);
+            freeBigInt(&object->as.rational.denominator);
+            break;
+        default:
+            freeBigInt(&object->as.real.mantissa);
+            break;
+    }
+    if (objectPoolCount < NUMBER_OBJECT_POOL_DEPTH) {
+        objectPool[objectPoolCount++] = object;
+    } else {
+        free(object);
+    }
+}
+
+Number numberFromBigInt(BigInt *integer) {
+    if (bigIntFitsInt64(integer)) {
+        int64_t value = bigIntToInt64(integer);
+        if (value >= NUMBER_SMALL_MIN && value <= NUMBER_SMALL_MAX) {
+            freeBigInt(integer);
+            return numberFromSmall(value);
+        }
+    }
+    NumberObject *object = allocObject(NUMBER_BIG);
+    initBigInt(&object->as.integer);
+    bigIntMove(&object->as.integer, integer);
+    return wrapObject(object);
+}
+
+Number numberFromInt64(int64_t value) {
+    if (value >= NUMBER_SMALL_MIN && value <= NUMBER_SMALL_MAX) {
+        return numberFromSmall(value);
+    }
+    BigInt integer;
+    initBigInt(&integer);
+    bigIntSetInt64(&integer, value);
+    return numberFromBigInt(&integer);
+}
+
+Number numberFromRational(BigInt *numerator, BigInt *denominator) {
+    if (bigIntIsZero(denominator)) {
+        bool indeterminate = bigIntIsZero(numerator);
+        freeBigInt(numerator);
+        freeBigInt(denominator);
+        return numberError(indeterminate ? Indeterminate : Undefined);
+    }
+    if (denominator->negative) {
+        bigIntNegate(numerator, numerator);
+        bigIntNegate(denominator, denominator);
+    }
+    BigInt divisor;
+    initBigInt(&divisor);
+    bigIntGcd(&divisor, numerator, denominator);
+    if (bigIntCompareAbs(&divisor, &bigIntOne) != 0) {
+        bigIntDivideExact(numerator, numerator, &divisor);
+        bigIntDivideExact(denominator, denominator, &divisor);
+    }
+    freeBigInt(&divisor);
+    if (bigIntCompareAbs(denominator, &bigIntOne) == 0) {
+        freeBigInt(denominator);
+        return numberFromBigInt(numerator);
+    }
+    NumberObject *object = allocObject(NUMBER_RATIONAL);
+    initBigInt(&object->as.rational.numerator);
+    initBigInt(&object->as.rational.denominator);
+    bigIntMove(&object->as.rational.numerator, numerator);
+    bigIntMove(&object->as.rational.denominator, denominator);
+    return wrapObject(object);
+}
+
+/*
+ * Views, read only big integers over any exact number without copying.
+ */
+
+static const BigInt *integerView(Number number, BigInt *storage, Limb limbs[2]) {
+    if (!numberIsSmall(number)) {
+        return &numberObject(number)->as.integer;
+    }
+    int64_t value = numberSmallValue(number);
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+    limbs[0] = (Limb) magnitude;
+    limbs[1] = (Limb) (magnitude >> LIMB_BITS);
+    storage->limbs = limbs;
+    storage->size = limbs[1] ? 2 : limbs[0] ? 1 : 0;
+    storage->capacity = 0;
+    storage->negative = value < 0;
+    return storage;
+}
+
+static void rationalView(Number number, BigInt *storage, Limb limbs[2],
+                         const BigInt **numerator, const BigInt **denominator) {
+    if (numberKind(number) == NUMBER_RATIONAL) {
+        *numerator = &numberObject(number)->as.rational.numerator;
+        *denominator = &numberObject(number)->as.rational.denominator;
+    } else {
+        *numerator = integerView(number, storage, limbs);
+        *denominator = &bigIntOne;
+    }
+}
+
+/*
+ * Floats, mantissa * 2^exponent.
+ */
+
+/**
+ * Round the mantissa to precision bits, to nearest with ties to even,
+ * then strip its trailing zeros.
+ */
+static void roundFloat(BigInt *mantissa, int64_t *exponent, uint32_t precision) {
+    size_t length = bigIntBitLength(mantissa);
+    if (length > precision) {
+        size_t shift = length - precision;
+        bool half = bigIntTestBit(mantissa, shift - 1);
+        bool sticky = bigIntTrailingZeros(mantissa) < shift - 1;
+        bool negative = mantissa->negative;
+        mantissa->negative = false;
+        bigIntShiftRight(mantissa, mantissa, shift);
+        if (half && (sticky || bigIntTestBit(mantissa, 0))) {
+            bigIntAddLimb(mantissa, mantissa, 1);
+        }
+        mantissa->negative = negative;
+        *exponent += (int64_t) shift;
+    }
+    if (bigIntIsZero(mantissa)) {
+        *exponent = 0;
+        return;
+    }
+    size_t zeros = bigIntTrailingZeros(mantissa);
+    if (zeros) {
+        bigIntShiftRight(mantissa, mantissa, zeros);
+        *exponent += (int64_t) zeros;
+    }
+}
+
+/**
+ * Round and wrap a float.
+ * @param mantissa Mantissa to take, it is zero afterwards.
+ */
+static Number makeFloat(BigInt *mantissa, int64_t exponent, uint32_t precision) {
+    roundFloat(mantissa, &exponent, precision);
+    NumberObject *object = allocObject(NUMBER_FLOAT);
+    initBigInt(&object->as.real.mantissa);
+    bigIntMove(&object->as.real.mantissa, mantissa);
+    object->as.real.exponent = exponent;
+    object->as.real.precision = precision;
+    return wrapObject(object);
+}
+
+/**
+ * mantissa * 2^exponent = a / b rounded to precision bits.
+ * @return false if b is zero.
+ */
+static bool floatDivide(BigInt *mantissa, int64_t *exponent, const BigInt *a, int64_t exponentA,
+                        const BigInt *b, int64_t exponentB, uint32_t precision) {
+    if (bigIntIsZero(b)) {
+        return false;
+    }
+    // Shift so the quotient has at least precision + 1 bits, a sticky bit records any remainder.
+    int64_t shift = (int64_t) precision + 2 + (int64_t) bigIntBitLength(b) - (int64_t) bigIntBitLength(a);
+    shift = shift < 0 ? 0 : shift;
+    BigInt scaled, remainder;
+    initBigInt(&scaled);
+    initBigInt(&remainder);
+    bigIntShiftLeft(&scaled, a, (size_t) shift);
+    bigIntDivide(mantissa, &remainder, &scaled, b);
+    *exponent = exponentA - exponentB - shift;
+    if (!bigIntIsZero(&remainder)) {
+        bool negative = mantissa->negative;
+        mantissa->negative = false;
+        bigIntShiftLeft(mantissa, mantissa, 1);
+        bigIntAddLimb(mantissa, mantissa, 1);
+        mantissa->negative = negative;
+        *exponent -= 1;
+    }
+    freeBigInt(&scaled);
+    freeBigInt(&remainder);
+    roundFloat(mantissa, exponent, precision);
+    return true;
+}
+
+/**
+ * The value of any non error number as a float of precision bits.
+ */
+static void floatParts(Number number, uint32_t precision, BigInt *mantissa, int64_t *exponent) {
+    BigInt storage;
+    Limb limbs[2];
+    const BigInt *numerator, *denominator;
+    switch (numberKind(number)) {
+        case NUMBER_FLOAT:
+            bigIntCopy(mantissa, &numberObject(number)->as.real.mantissa);
+            *exponent = numberObject(number)->as.real.exponent;
+            roundFloat(mantissa, exponent, precision);
+            break;
+        case NUMBER_RATIONAL:
+            rationalView(number, &storage, limbs, &numerator, &denominator);
+            floatDivide(mantissa, exponent, numerator, 0, denominator, 0, precision);
+            break;
+        default:
+            bigIntCopy(mantissa, integerView(number, &storage, limbs));
+            *exponent = 0;
+            roundFloat(mantissa, exponent, precision);
+            break;
+    }
+}
+
+static uint32_t floatPrecision(Number number) {
+    return numberKind(number) == NUMBER_FLOAT ? numberObject(number)->as.real.precision : 0;
+}
+
+/**
+ * A float view of a number, borrowed when it already fits precision bits
+ * and rounded into owned otherwise.
+ */
+static const BigInt *floatView(Number number, uint32_t precision, BigInt *storage, Limb limbs[2],
+                               BigInt *owned, int64_t *exponent) {
+    NumberKind kind = numberKind(number);
+    if (kind == NUMBER_FLOAT && numberObject(number)->as.real.precision <= precision) {
+        *exponent = numberObject(number)->as.real.exponent;
+        return &numberObject(number)->as.real.mantissa;
+    }
+    if (kind == NUMBER_SMALL) {
+        const BigInt *view = integerView(number, storage, limbs);
+        if (bigIntBitLength(view) <= precision) {
+            *exponent = 0;
+            return view;
+        }
+    }
+    floatParts(number, precision, owned, exponent);
+    return owned;
+}
+
+static Number floatArithmetic(Number a, Number b, Arithmetic operation) {
+    uint32_t precision = floatPrecision(a) > floatPrecision(b) ? floatPrecision(a) : floatPrecision(b);
+    BigInt storageX, storageY, ownedX, ownedY, result;
+    Limb limbsX[2], limbsY[2];
+    int64_t exponentX, exponentY, exponent = 0;
+    initBigInt(&ownedX);
+    initBigInt(&ownedY);
+    initBigInt(&result);
+    const BigInt *x = floatView(a, precision, &storageX, limbsX, &ownedX, &exponentX);
+    const BigInt *y = floatView(b, precision, &storageY, limbsY, &ownedY, &exponentY);
+    switch (operation) {
+        case ARITHMETIC_ADD:
+        case ARITHMETIC_SUBTRACT: {
+            bool subtract = operation == ARITHMETIC_SUBTRACT;
+            int64_t topX = (int64_t) bigIntBitLength(x) + exponentX;
+            int64_t topY = (int64_t) bigIntBitLength(y) + exponentY;
+            if (bigIntIsZero(y) || (!bigIntIsZero(x) && topX - topY > (int64_t) precision + 2)) {
+                // y is below half an ulp of x.
+                bigIntCopy(&result, x);
+                exponent = exponentX;
+            } else if (bigIntIsZero(x) || topY - topX > (int64_t) precision + 2) {
+                if (subtract) {
+                    bigIntNegate(&result, y);
+                } else {
+                    bigIntCopy(&result, y);
+                }
+                exponent = exponentY;
+            } else if (exponentX >= exponentY) {
+                bigIntShiftLeft(&result, x, (size_t) (exponentX - exponentY));
+                if (subtract) {
+                    bigIntSubtract(&result, &result, y);
+                } else {
+                    bigIntAdd(&result, &result, y);
+                }
+                exponent = exponentY;
+            } else {
+                bigIntShiftLeft(&result, y, (size_t) (exponentY - exponentX));
+                if (subtract) {
+                    bigIntSubtract(&result, x, &result);
+                } else {
+                    bigIntAdd(&result, x, &result);
+                }
+                exponent = exponentX;
+            }
+            break;
+        }
+        case ARITHMETIC_MULTIPLY:
+            bigIntMultiply(&result, x, y);
+            exponent = exponentX + exponentY;
+            break;
+        case ARITHMETIC_DIVIDE:
+            if (!floatDivide(&result, &exponent, x, exponentX, y, exponentY, precision)) {
+                bool indeterminate = bigIntIsZero(x);
+                freeBigInt(&ownedX);
+                freeBigInt(&ownedY);
+                return numberError(indeterminate ? Indeterminate : Undefined);
+            }
+            break;
+    }
+    freeBigInt(&ownedX);
+    freeBigInt(&ownedY);
+    return makeFloat(&result, exponent, precision);
+}
+
+static Number integerArithmetic(Number a, Number b, Arithmetic operation) {
+    BigInt storageA, storageB, result;
+    Limb limbsA[2], limbsB[2];
+    const BigInt *x = integerView(a, &storageA, limbsA), *y = integerView(b, &storageB, limbsB);
+    initBigInt(&result);
+    switch (operation) {
+        case ARITHMETIC_ADD:
+            bigIntAdd(&result, x, y);
+            break;
+        case ARITHMETIC_SUBTRACT:
+            bigIntSubtract(&result, x, y);
+            break;
+        default:
+            if (bigIntBitLength(x) + bigIntBitLength(y) > NUMBER_MAX_BITS) {
+                return numberError(Overflow);
+            }
+            bigIntMultiply(&result, x, y);
+            break;
+    }
+    return numberFromBigInt(&result);
+}
+
+static Number rationalArithmetic(Number a, Number b, Arithmetic operation) {
+    BigInt storageA, storageB, numerator, denominator, product;
+    Limb limbsA[2], limbsB[2];
+    const BigInt *numeratorA, *denominatorA, *numeratorB, *denominatorB;
+    rationalView(a, &storageA, limbsA, &numeratorA, &denominatorA);
+    rationalView(b, &storageB, limbsB, &numeratorB, &denominatorB);
+    if (bigIntBitLength(numeratorA) + bigIntBitLength(denominatorA) +
+        bigIntBitLength(numeratorB) + bigIntBitLength(denominatorB) > NUMBER_MAX_BITS) {
+        return numberError(Overflow);
+    }
+    initBigInt(&numerator);
+    initBigInt(&denominator);
+    initBigInt(&product);
+    switch (operation) {
+        case ARITHMETIC_ADD:
+        case ARITHMETIC_SUBTRACT:
+            bigIntMultiply(&numerator, numeratorA, denominatorB);
+            bigIntMultiply(&product, numeratorB, denominatorA);
+            if (operation == ARITHMETIC_ADD) {
+                bigIntAdd(&numerator, &numerator, &product);
+            } else {
+                bigIntSubtract(&numerator, &numerator, &product);
+            }
+            bigIntMultiply(&denominator, denominatorA, denominatorB);
+            break;
+        case ARITHMETIC_MULTIPLY:
+            bigIntMultiply(&numerator, numeratorA, numeratorB);
+            bigIntMultiply(&denominator, denominatorA, denominatorB);
+            break;
+        case ARITHMETIC_DIVIDE:
+            bigIntMultiply(&numerator, numeratorA, denominatorB);
+            bigIntMultiply(&denominator, denominatorA, numeratorB);
+            break;
+    }
+    freeBigInt(&product);
+    return numberFromRational(&numerator, &denominator);
+}
+
+static Number arithmetic(Number a, Number b, Arithmetic operation) {
+    if (numberIsError(a)) {
+        return a;
+    }
+    if (numberIsError(b)) {
+        return b;
+    }
+    NumberKind kindA = numberKind(a), kindB = numberKind(b);
+    if (kindA == NUMBER_FLOAT || kindB == NUMBER_FLOAT) {
+        return floatArithmetic(a, b, operation);
+    }
+    if (kindA <= NUMBER_BIG && kindB <= NUMBER_BIG && operation != ARITHMETIC_DIVIDE) {
+        return integerArithmetic(a, b, operation);
+    }
+    return rationalArithmetic(a, b, operation);
+}
+
+Number numberAddSlow(Number a, Number b) {
+    return arithmetic(a, b, ARITHMETIC_ADD);
+}
+
+Number numberSubtractSlow(Number a, Number b) {
+    return arithmetic(a, b, ARITHMETIC_SUBTRACT);
+}
+
+Number numberMultiplySlow(Number a, Number b) {
+    return arithmetic(a, b, ARITHMETIC_MULTIPLY);
+}
+
+Number numberDivide(Number a, Number b) {
+    return arithmetic(a, b, ARITHMETIC_DIVIDE);
+}
+
+Number numberNegate(Number number) {
+    BigInt result;
+    initBigInt(&result);
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            return numberFromInt64(-numberSmallValue(number));
+        case NUMBER_ERROR:
+            return number;
+        case NUMBER_BIG:
+            bigIntNegate(&result, &numberObject(number)->as.integer);
+            return numberFromBigInt(&result);
+        case NUMBER_RATIONAL: {
+            NumberObject *object = allocObject(NUMBER_RATIONAL);
+            NumberObject *source = numberObject(number);
+            initBigInt(&object->as.rational.numerator);
+            initBigInt(&object->as.rational.denominator);
+            bigIntNegate(&object->as.rational.numerator, &source->as.rational.numerator);
+            bigIntCopy(&object->as.rational.denominator, &source->as.rational.denominator);
+            return wrapObject(object);
+        }
+        default:
+            bigIntNegate(&result, &numberObject(number)->as.real.mantissa);
+            return makeFloat(&result, numberObject(number)->as.real.exponent,
+                             numberObject(number)->as.real.precision);
+    }
+}
+
+Number numberPower(Number base, int64_t exponent) {
+    if (numberIsError(base)) {
+        return base;
+    }
+    uint64_t magnitude = exponent < 0 ? 0 - (uint64_t) exponent : (uint64_t) exponent;
+    if (numberIsZero(base)) {
+        return exponent == 0 ? numberError(Indeterminate) : exponent < 0 ? numberError(Undefined) : copyNumber(base);
+    }
+    NumberKind kind = numberKind(base);
+    Number result;
+    if (kind == NUMBER_FLOAT) {
+        NumberObject *object = numberObject(base);
+        uint32_t precision = object->as.real.precision;
+        int64_t top = object->as.real.exponent + (int64_t) bigIntBitLength(&object->as.real.mantissa);
+        if (magnitude > 0 && (uint64_t) (top < 0 ? -top : top) + 1 > ((uint64_t) 1 << 62) / magnitude) {
+            return numberError(Overflow);
+        }
+        BigInt power, square;
+        int64_t powerExponent = 0, squareExponent = object->as.real.exponent;
+        initBigInt(&power);
+        initBigInt(&square);
+        bigIntSetUint64(&power, 1);
+        bigIntCopy(&square, &object->as.real.mantissa);
+        while (magnitude) {
+            if (magnitude & 1) {
+                bigIntMultiply(&power, &power, &square);
+                powerExponent += squareExponent;
+                roundFloat(&power, &powerExponent, precision);
+            }
+            magnitude >>= 1;
+            if (magnitude) {
+                bigIntMultiply(&square, &square, &square);
+                squareExponent *= 2;
+                roundFloat(&square, &squareExponent, precision);
+            }
+        }
+        freeBigInt(&square);
+        result = makeFloat(&power, powerExponent, precision);
+    } else {
+        BigInt storage, numerator, denominator;
+        Limb limbs[2];
+        const BigInt *baseNumerator, *baseDenominator;
+        rationalView(base, &storage, limbs, &baseNumerator, &baseDenominator);
+        if (kind != NUMBER_RATIONAL && bigIntCompareAbs(baseNumerator, &bigIntOne) == 0) {
+            result = numberFromSmall(baseNumerator->negative && (magnitude & 1) ? -1 : 1);
+        } else {
+            size_t bits = bigIntBitLength(baseNumerator) + bigIntBitLength(baseDenominator);
+            if (magnitude > NUMBER_MAX_BITS || bits * magnitude > NUMBER_MAX_BITS) {
+                return numberError(Overflow);
+            }
+            initBigInt(&numerator);
+            bigIntPower(&numerator, baseNumerator, magnitude);
+            if (kind == NUMBER_RATIONAL) {
+                // Powers of coprime integers stay coprime, no need to reduce.
+                NumberObject *object = allocObject(NUMBER_RATIONAL);
+                initBigInt(&object->as.rational.numerator);
+                initBigInt(&denominator);
+                bigIntPower(&denominator, baseDenominator, magnitude);
+                bigIntMove(&object->as.rational.numerator, &numerator);
+                object->as.rational.denominator = denominator;
+                result = wrapObject(object);
+            } else {
+                result = numberFromBigInt(&numerator);
+            }
+        }
+    }
+    if (exponent < 0) {
+        Number reciprocal = numberDivide(numberFromSmall(1), result);
+        freeNumber(result);
+        return reciprocal;
+    }
+    return result;
+}
+
+/**
+ * The exact value of a non error number as numerator / denominator,
+ * floats are dyadic fractions.
+ */
+static void exactParts(Number number, BigInt *numerator, BigInt *denominator) {
+    if (numberKind(number) == NUMBER_FLOAT) {
+        NumberObject *object = numberObject(number);
+        bigIntSetUint64(denominator, 1);
+        if (object->as.real.exponent >= 0) {
+            bigIntShiftLeft(numerator, &object->as.real.mantissa, (size_t) object->as.real.exponent);
+        } else {
+            bigIntCopy(numerator, &object->as.real.mantissa);
+            bigIntShiftLeft(denominator, denominator, (size_t) -object->as.real.exponent);
+        }
+        return;
+    }
+    BigInt storage;
+    Limb limbs[2];
+    const BigInt *viewNumerator, *viewDenominator;
+    rationalView(number, &storage, limbs, &viewNumerator, &viewDenominator);
+    bigIntCopy(numerator, viewNumerator);
+    bigIntCopy(denominator, viewDenominator);
+}
+
+int numberCompare(Number a, Number b) {
+    if (numberIsSmall(a) && numberIsSmall(b)) {
+        int64_t x = numberSmallValue(a), y = numberSmallValue(b);
+        return x < y ? -1 : x > y;
+    }
+    if (numberIsError(a) || numberIsError(b)) {
+        return 0;
+    }
+    int signA = numberSign(a), signB = numberSign(b);
+    if (signA != signB) {
+        return signA < signB ? -1 : 1;
+    }
+    BigInt numeratorA, denominatorA, numeratorB, denominatorB;
+    initBigInt(&numeratorA);
+    initBigInt(&denominatorA);
+    initBigInt(&numeratorB);
+    initBigInt(&denominatorB);
+    exactParts(a, &numeratorA, &denominatorA);
+    exactParts(b, &numeratorB, &denominatorB);
+    bigIntMultiply(&numeratorA, &numeratorA, &denominatorB);
+    bigIntMultiply(&numeratorB, &numeratorB, &denominatorA);
+    int comparison = bigIntCompare(&numeratorA, &numeratorB);
+    freeBigInt(&numeratorA);
+    freeBigInt(&denominatorA);
+    freeBigInt(&numeratorB);
+    freeBigInt(&denominatorB);
+    return comparison;
+}
+
+bool numberIsZero(Number number) {
+    if (numberIsSmall(number)) {
+        return numberSmallValue(number) == 0;
+    }
+    return numberKind(number) == NUMBER_FLOAT && bigIntIsZero(&numberObject(number)->as.real.mantissa);
+}
+
+bool numberIsInteger(Number number) {
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+        case NUMBER_BIG:
+            return true;
+        case NUMBER_FLOAT:
+            return numberObject(number)->as.real.exponent >= 0;
+        default:
+            return false;
+    }
+}
+
+int numberSign(Number number) {
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            return numberSmallValue(number) < 0 ? -1 : numberSmallValue(number) > 0;
+        case NUMBER_BIG:
+            return numberObject(number)->as.integer.negative ? -1 : 1;
+        case NUMBER_RATIONAL:
+            return numberObject(number)->as.rational.numerator.negative ? -1 : 1;
+        case NUMBER_FLOAT:
+            return bigIntIsZero(&numberObject(number)->as.real.mantissa) ? 0 :
+                   numberObject(number)->as.real.mantissa.negative ? -1 : 1;
+        default:
+            return 0;
+    }
+}
+
+static double scaleDouble(double value, int64_t exponent) {
+    exponent = exponent < -4096 ? -4096 : exponent > 4096 ? 4096 : exponent;
+    return ldexp(value, (int) exponent);
+}
+
+double numberToDouble(Number number) {
+    BigInt mantissa;
+    int64_t exponent;
+    double value;
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            return (double) numberSmallValue(number);
+        case NUMBER_BIG:
+            return bigIntToDouble(&numberObject(number)->as.integer);
+        case NUMBER_ERROR:
+            return NAN;
+        default:
+            initBigInt(&mantissa);
+            floatParts(number, 53, &mantissa, &exponent);
+            value = scaleDouble((double) bigIntToInt64(&mantissa), exponent);
+            freeBigInt(&mantissa);
+            return value;
+    }
+}
+
+Number numberFromDouble(double value) {
+    if (isnan(value)) {
+        return numberError(Undefined);
+    }
+    if (isinf(value)) {
+        return numberError(Overflow);
+    }
+    if (value == floor(value) && fabs(value) <= 9007199254740992.0) {
+        return numberFromSmall((int64_t) value);
+    }
+    int exponent;
+    double fraction = frexp(value, &exponent);
+    BigInt mantissa;
+    initBigInt(&mantissa);
+    bigIntSetInt64(&mantissa, (int64_t) ldexp(fraction, 53));
+    return makeFloat(&mantissa, (int64_t) exponent - 53, 53);
+}
+
+/**
+ * numerator / 10^scale.
+ */
+static Number decimalFraction(BigInt *numerator, uint32_t scale) {
+    if (scale == 0) {
+        return numberFromBigInt(numerator);
+    }
+    BigInt denominator, ten;
+    initBigInt(&denominator);
+    initBigInt(&ten);
+    bigIntSetUint64(&ten, 10);
+    bigIntPower(&denominator, &ten, scale);
+    freeBigInt(&ten);
+    return numberFromRational(numerator, &denominator);
+}
+
+/**
+ * mantissa / 10^scale in lowest terms with word arithmetic, the only common
+ * factors are the twos and fives of the denominator.
+ */
+static Number wordDecimal(uint64_t mantissa, uint32_t scale) {
+    uint32_t twos = scale, fives = scale;
+    uint64_t denominator = 1;
+    BigInt numerator;
+    while (mantissa != 0 && twos > 0 && mantissa % 2 == 0) {
+        mantissa /= 2;
+        twos--;
+    }
+    while (mantissa != 0 && fives > 0 && mantissa % 5 == 0) {
+        mantissa /= 5;
+        fives--;
+    }
+    initBigInt(&numerator);
+    bigIntSetUint64(&numerator, mantissa);
+    if (mantissa == 0 || (twos == 0 && fives == 0)) {
+        return numberFromBigInt(&numerator);
+    }
+    while (fives-- > 0) {
+        denominator *= 5;
+    }
+    NumberObject *object = allocObject(NUMBER_RATIONAL);
+    initBigInt(&object->as.rational.numerator);
+    initBigInt(&object->as.rational.denominator);
+    bigIntMove(&object->as.rational.numerator, &numerator);
+    bigIntSetUint64(&object->as.rational.denominator, denominator << twos);
+    return wrapObject(object);
+}
+
+Number numberFromLiteral(const NumberLiteral *literal) {
+    BigInt mantissa;
+    switch (literal->kind) {
+        case LITERAL_INTEGER:
+            if (literal->mantissa <= (uint64_t) NUMBER_SMALL_MAX) {
+                return numberFromSmall((int64_t) literal->mantissa);
+            }
+            // Fall through.
+        case LITERAL_DECIMAL:
+            if (literal->kind == LITERAL_DECIMAL && literal->scale <= WORD_DECIMAL_MAX_SCALE) {
+                return wordDecimal(literal->mantissa, (uint32_t) literal->scale);
+            }
+            initBigInt(&mantissa);
+            bigIntSetUint64(&mantissa, literal->mantissa);
+            return decimalFraction(&mantissa, literal->kind == LITERAL_DECIMAL ? (uint32_t) literal->scale : 0);
+        default:
+            return numberFromDouble(literal->value);
+    }
+}
+
+Number numberFromDecimal(const char *start, size_t length) {
+    char small[64];
+    char *digits = length <= sizeof(small) ? small : (char *) malloc(length);
+    size_t count = 0, i;
+    uint32_t scale = 0;
+    bool point = false;
+    for (i = 0; i < length; i++) {
+        if (start[i] == '.' && !point) {
+            point = true;
+        } else {
+            digits[count++] = start[i];
+            scale += point;
+        }
+    }
+    BigInt mantissa;
+    initBigInt(&mantissa);
+    bool valid = count > 0 && digits[0] != '-' && bigIntSetDecimal(&mantissa, digits, count);
+    if (digits != small) {
+        free(digits);
+    }
+    if (!valid) {
+        freeBigInt(&mantissa);
+        return numberError(Undefined);
+    }
+    return decimalFraction(&mantissa, scale);
+}
+
+Number numberToFloat(Number number, uint32_t precision) {
+    if (numberIsError(number)) {
+        return number;
+    }
+    BigInt mantissa;
+    int64_t exponent;
+    initBigInt(&mantissa);
+    floatParts(number, precision, &mantissa, &exponent);
+    return makeFloat(&mantissa, exponent, precision);
+}
+
+/**
+ * Significant decimal digits that round trip a precision in bits.
+ */
+static size_t floatDigits(uint32_t precision) {
+    return (size_t) precision * 30103 / 100000 + 2;
+}
+
+size_t numberStringSize(Number number) {
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+        case NUMBER_ERROR:
+            return 24;
+        case NUMBER_BIG:
+            return bigIntStringSize(&numberObject(number)->as.integer);
+        case NUMBER_RATIONAL:
+            return bigIntStringSize(&numberObject(number)->as.rational.numerator) +
+                   bigIntStringSize(&numberObject(number)->as.rational.denominator);
+        default:
+            return floatDigits(numberObject(number)->as.real.precision) + 32;
+    }
+}
+
+/**
+ * Write a float with the digits its precision holds, positional
+ * when the exponent is modest and scientific otherwise.
+ */
+static char *floatToString(const NumberObject *object, char *buffer) {
+    const BigInt *mantissa = &object->as.real.mantissa;
+    int64_t exponent = object->as.real.exponent;
+    char *ch = buffer;
+    if (bigIntIsZero(mantissa)) {
+        strcpy(buffer, "0.0");
+        return buffer;
+    }
+    if (mantissa->negative) {
+        *ch++ = '-';
+    }
+    // digits = round(|mantissa| 2^exponent 10^scale) has about floatDigits digits.
+    int64_t digitCount = (int64_t) floatDigits(object->as.real.precision);
+    int64_t top = (int64_t) bigIntBitLength(mantissa) + exponent - 1;
+    int64_t scale = digitCount - 1 - (int64_t) floor((double) top * 0.30102999566398120);
+    BigInt numerator, denominator, power;
+    initBigInt(&numerator);
+    initBigInt(&denominator);
+    initBigInt(&power);
+    bigIntAbs(&numerator, mantissa);
+    bigIntSetUint64(&denominator, 1);
+    if (exponent > 0) {
+        bigIntShiftLeft(&numerator, &numerator, (size_t) exponent);
+    } else {
+        bigIntShiftLeft(&denominator, &denominator, (size_t) -exponent);
+    }
+    bigIntSetUint64(&power, 10);
+    bigIntPower(&power, &power, (uint64_t) (scale < 0 ? -scale : scale));
+    bigIntMultiply(scale > 0 ? &numerator : &denominator, scale > 0 ? &numerator : &denominator, &power);
+    // Round half up, (2n + d) / 2d.
+    bigIntShiftLeft(&numerator, &numerator, 1);
+    bigIntAdd(&numerator, &numerator, &denominator);
+    bigIntShiftLeft(&denominator, &denominator, 1);
+    bigIntDivide(&numerator, NULL, &numerator, &denominator);
+
+    char *digits = (char *) malloc(bigIntStringSize(&numerator));
+    bigIntToString(&numerator, digits);
+    int64_t length = (int64_t) strlen(digits);
+    int64_t decimalExponent = length - 1 - scale;
+    while (length > 1 && digits[length - 1] == '0') {
+        length--;
+    }
+    int64_t i;
+    if (decimalExponent >= -5 && decimalExponent < digitCount) {
+        if (decimalExponent < 0) {
+            *ch++ = '0';
+            *ch++ = '.';
+            for (i = 0; i < -decimalExponent - 1; i++) {
+                *ch++ = '0';
+            }
+            memcpy(ch, digits, (size_t) length);
+            ch += length;
+        } else {
+            for (i = 0; i <= decimalExponent; i++) {
+                *ch++ = i < length ? digits[i] : '0';
+            }
+            *ch++ = '.';
+            if (length > decimalExponent + 1) {
+                memcpy(ch, digits + decimalExponent + 1, (size_t) (length - decimalExponent - 1));
+                ch += length - decimalExponent - 1;
+            } else {
+                *ch++ = '0';
+            }
+        }
+        *ch = '\0';
+    } else {
+        *ch++ = digits[0];
+        *ch++ = '.';
+        if (length > 1) {
+            memcpy(ch, digits + 1, (size_t) (length - 1));
+            ch += length - 1;
+        } else {
+            *ch++ = '0';
+        }
+        sprintf(ch, "e%+lld", (long long) decimalExponent);
+    }
+    free(digits);
+    freeBigInt(&numerator);
+    freeBigInt(&denominator);
+    freeBigInt(&power);
+    return buffer;
+}
+
+char *numberToString(Number number, char *buffer) {
+    NumberObject *object;
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            sprintf(buffer, "%lld", (long long) numberSmallValue(number));
+            return buffer;
+        case NUMBER_ERROR:
+            strcpy(buffer, getLiteralName(numberErrorLiteral(number)));
+            return buffer;
+        case NUMBER_BIG:
+            return bigIntToString(&numberObject(number)->as.integer, buffer);
+        case NUMBER_RATIONAL:
+            object = numberObject(number);
+            bigIntToString(&object->as.rational.numerator, buffer);
+            strcat(buffer, "/");
+            bigIntToString(&object->as.rational.denominator, buffer + strlen(buffer));
+            return buffer;
+        default:
+            return floatToString(numberObject(number), buffer);
+    }
+}
+
+void printNumber(Number number, FILE *file) {
+    char small[64];
+    size_t size = numberStringSize(number);
+    char *buffer = size <= sizeof(small) ? small : (char *) malloc(size);
+    fputs(numberToString(number, buffer), file);
+    if (buffer != small) {
+        free(buffer);
+    }
+}
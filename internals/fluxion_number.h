@@ -0,0 +1,258 @@
+//
+// The numeric tower, immediate integers promote to big integers,
+// rationals and arbitrary precision floats.
+//
+
+#ifndef FLUXIONCORE_FLUXION_NUMBER_H
+#define FLUXIONCORE_FLUXION_NUMBER_H
+#include <stdio.h>
+#include "commons.h"
+#include "fluxion_bigint.h"
+#include "fluxion_number_scan.h"
+
+/**
+ * Where a number is in the tower.
+ */
+typedef enum {
+    NUMBER_SMALL, // Immediate 62 bit integer.
+    NUMBER_BIG, // Integer that does not fit an immediate.
+    NUMBER_RATIONAL, // Exact fraction in lowest terms, denominator > 1.
+    NUMBER_FLOAT, // mantissa * 2^exponent rounded to a precision in bits.
+    NUMBER_ERROR // Immediate ErrorLiteral, the result of an undefined operation.
+} NumberKind;
+
+/**
+ * A tagged word. The low two bits select the representation,
+ * 01 an immediate integer in the upper 62 bits, 10 an ErrorLiteral,
+ * 00 a pointer to a reference counted NumberObject.
+ * Numbers are not thread safe, a number must only be used by one thread.
+ */
+typedef struct {
+    uint64_t bits;
+} Number;
+
+#define NUMBER_TAG_MASK 3u
+#define NUMBER_TAG_OBJECT 0u
+#define NUMBER_TAG_SMALL 1u
+#define NUMBER_TAG_ERROR 2u
+#define NUMBER_SMALL_MAX (((int64_t) 1 << 61) - 1)
+#define NUMBER_SMALL_MIN (-((int64_t) 1 << 61))
+#define NUMBER_MAX_BITS ((size_t) 1 << 31) // Results longer than this are an Overflow.
+
+/**
+ * Heap part of a number.
+ */
+typedef struct {
+    uint32_t kind; // NUMBER_BIG, NUMBER_RATIONAL or NUMBER_FLOAT.
+    uint32_t references;
+    union {
+        BigInt integer;
+        struct {
+            BigInt numerator; // Carries the sign.
+            BigInt denominator;
+        } rational;
+        struct {
+            BigInt mantissa; // Odd, or zero.
+            int64_t exponent;
+            uint32_t precision; // Bits, |mantissa| < 2^precision.
+        } real;
+    } as;
+} NumberObject;
+
+static inline bool numberIsSmall(Number number) {
+    return (number.bits & NUMBER_TAG_MASK) == NUMBER_TAG_SMALL;
+}
+
+static inline bool numberIsError(Number number) {
+    return (number.bits & NUMBER_TAG_MASK) == NUMBER_TAG_ERROR;
+}
+
+/**
+ * Whether the number owns nothing, immediates need not be freed.
+ */
+static inline bool numberIsImmediate(Number number) {
+    return (number.bits & NUMBER_TAG_MASK) != NUMBER_TAG_OBJECT;
+}
+
+static inline int64_t numberSmallValue(Number number) {
+    return (int64_t) number.bits >> 2;
+}
+
+static inline NumberObject *numberObject(Number number) {
+    return (NumberObject *) (uintptr_t) number.bits;
+}
+
+/**
+ * Make an immediate, value must be within NUMBER_SMALL_MIN and NUMBER_SMALL_MAX.
+ */
+static inline Number numberFromSmall(int64_t value) {
+    Number number = {(uint64_t) value << 2 | NUMBER_TAG_SMALL};
+    return number;
+}
+
+static inline Number numberError(ErrorLiteral literal) {
+    Number number = {(uint64_t) literal << 2 | NUMBER_TAG_ERROR};
+    return number;
+}
+
+static inline ErrorLiteral numberErrorLiteral(Number number) {
+    return (ErrorLiteral) (number.bits >> 2);
+}
+
+NumberKind numberKind(Number number);
+
+/**
+ * Make an integer, promoting to a big integer if needed.
+ */
+Number numberFromInt64(int64_t value);
+/**
+ * Make an integer from a big integer.
+ * @param integer Integer to take, it is zero afterwards.
+ */
+Number numberFromBigInt(BigInt *integer);
+/**
+ * Make the fraction numerator / denominator in lowest terms.
+ * @param numerator Numerator to take, it is zero afterwards.
+ * @param denominator Denominator to take, it is zero afterwards.
+ * @return the fraction, an integer if it divides, an error if the denominator is zero.
+ */
+Number numberFromRational(BigInt *numerator, BigInt *denominator);
+/**
+ * Make a number from a double. Integers below 2^53 are exact,
+ * everything else becomes a 53 bit float. Infinities are an Overflow,
+ * NaN is Undefined.
+ */
+Number numberFromDouble(double value);
+/**
+ * Make a number from a scanned literal, exactly unless the literal is LITERAL_FLOAT.
+ */
+Number numberFromLiteral(const NumberLiteral *literal);
+/**
+ * Make a number from the exact value of a literal of the form digits or digits.digits.
+ * @param start Start of the literal, does not need to be null terminated.
+ * @param length Length of the literal.
+ * @return the number, Undefined if the span is not a literal.
+ */
+Number numberFromDecimal(const char *start, size_t length);
+/**
+ * Round a number to a float.
+ * @param number Number to convert, not freed.
+ * @param precision Precision in bits.
+ */
+Number numberToFloat(Number number, uint32_t precision);
+
+/**
+ * Release a number object whose last reference went away.
+ * @param object Object to release.
+ */
+void releaseNumberObject(NumberObject *object);
+
+/**
+ * Take another reference to a number.
+ * @return number.
+ */
+static inline Number copyNumber(Number number) {
+    if (!numberIsImmediate(number)) {
+        numberObject(number)->references++;
+    }
+    return number;
+}
+
+/**
+ * Release a reference to a number.
+ * @param number Number to release.
+ */
+static inline void freeNumber(Number number) {
+    if (!numberIsImmediate(number) && --numberObject(number)->references == 0) {
+        releaseNumberObject(numberObject(number));
+    }
+}
+
+/*
+ * Arithmetic, the operands are borrowed and the result is owned by the caller.
+ * Exact operands give exact results, a float operand makes the result a float
+ * with the largest precision among the float operands. An error operand is returned as is.
+ */
+Number numberAddSlow(Number a, Number b);
+Number numberSubtractSlow(Number a, Number b);
+Number numberMultiplySlow(Number a, Number b);
+Number numberNegate(Number number);
+/**
+ * Divide, dividing integers gives a rational.
+ * @return Undefined for x / 0, Indeterminate for 0 / 0.
+ */
+Number numberDivide(Number a, Number b);
+/**
+ * Raise to an integer power, a negative exponent takes the reciprocal.
+ * @return Indeterminate for 0^0, Undefined for 0^-n, Overflow if the result is too large.
+ */
+Number numberPower(Number base, int64_t exponent);
+
+static inline Number numberAdd(Number a, Number b) {
+    if (numberIsSmall(a) && numberIsSmall(b)) {
+        // Immediates are 62 bits so the sum cannot overflow 64.
+        int64_t sum = numberSmallValue(a) + numberSmallValue(b);
+        if (sum >= NUMBER_SMALL_MIN && sum <= NUMBER_SMALL_MAX) {
+            return numberFromSmall(sum);
+        }
+    }
+    return numberAddSlow(a, b);
+}
+
+static inline Number numberSubtract(Number a, Number b) {
+    if (numberIsSmall(a) && numberIsSmall(b)) {
+        int64_t difference = numberSmallValue(a) - numberSmallValue(b);
+        if (difference >= NUMBER_SMALL_MIN && difference <= NUMBER_SMALL_MAX) {
+            return numberFromSmall(difference);
+        }
+    }
+    return numberSubtractSlow(a, b);
+}
+
+static inline Number numberMultiply(Number a, Number b) {
+    if (numberIsSmall(a) && numberIsSmall(b)) {
+        int64_t product;
+#if defined(__GNUC__)
+        if (!__builtin_mul_overflow(numberSmallValue(a), numberSmallValue(b), &product) &&
+            product >= NUMBER_SMALL_MIN && product <= NUMBER_SMALL_MAX) {
+            return numberFromSmall(product);
+        }
+#else
+        int64_t x = numberSmallValue(a), y = numberSmallValue(b);
+        if (x > -((int64_t) 1 << 30) && x < (int64_t) 1 << 30 && y > -((int64_t) 1 << 30) && y < (int64_t) 1 << 30) {
+            product = x * y;
+            return numberFromSmall(product);
+        }
+#endif
+    }
+    return numberMultiplySlow(a, b);
+}
+
+/**
+ * Compare two numbers exactly.
+ * @return -1, 0 or 1, errors compare equal to everything.
+ */
+int numberCompare(Number a, Number b);
+bool numberIsZero(Number number);
+bool numberIsInteger(Number number);
+int numberSign(Number number);
+/**
+ * Nearest double, correctly rounded for exact numbers.
+ */
+double numberToDouble(Number number);
+
+/**
+ * Number of characters numberToString needs, including the terminator.
+ */
+size_t numberStringSize(Number number);
+/**
+ * Write a number, integers and fractions exactly and floats
+ * with as many digits as their precision holds.
+ * @param number Number to write.
+ * @param buffer Buffer of at least numberStringSize characters.
+ * @return buffer.
+ */
+char *numberToString(Number number, char *buffer);
+void printNumber(Number number, FILE *file);
+
+#endif //FLUXIONCORE_FLUXION_NUMBER_H
@@ -0,0 +1,349 @@
+//
+// Number literal scanner, parses literals straight from source spans.
+//
+
+#include <string.h>
+#include "fluxion_number_scan.h"
+
+#define POWERS_MIN_EXPONENT (-348)
+#define POWERS_MAX_EXPONENT 347
+#define POWERS_COUNT (POWERS_MAX_EXPONENT - POWERS_MIN_EXPONENT + 1)
+#define MAX_SIGNIFICANT_DIGITS 19 // Always fit in 64 bits.
+
+/**
+ * 128 bit mantissas of the powers of ten, rounded down
+ * and normalised so the top bit is set. {low, high}.
+ */
+static uint64_t powersOfTen[POWERS_COUNT][2];
+static bool powersReady = false;
+
+static const double exactPowersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int leadingZeros64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int count = 0;
+    while (!(x & 0x8000000000000000ull)) {
+        x <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static void multiply64(uint64_t a, uint64_t b, uint64_t *high, uint64_t *low) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128) a * b;
+    *high = (uint64_t) (product >> 64);
+    *low = (uint64_t) product;
+#else
+    uint64_t aLow = (uint32_t) a, aHigh = a >> 32, bLow = (uint32_t) b, bHigh = b >> 32;
+    uint64_t lowLow = aLow * bLow, highLow = aHigh * bLow, lowHigh = aLow * bHigh, highHigh = aHigh * bHigh;
+    uint64_t middle = (lowLow >> 32) + (uint32_t) highLow + lowHigh;
+    *low = (middle << 32) | (uint32_t) lowLow;
+    *high = highHigh + (highLow >> 32) + (middle >> 32);
+#endif
+}
+
+/**
+ * Extract the top 128 bits of a little endian 32 bit limb array, rounding down.
+ */
+static void topBits(const uint32_t *limbs, int count, uint64_t *high, uint64_t *low) {
+    while (count > 1 && limbs[count - 1] == 0) {
+        count--;
+    }
+    int length = (count - 1) * 32;
+    uint32_t top = limbs[count - 1];
+    while (top) {
+        length++;
+        top >>= 1;
+    }
+    *high = 0;
+    *low = 0;
+    int i;
+    for (i = 0; i < 128; i++) {
+        int position = length - 1 - i;
+        uint64_t bit = position >= 0 ? (limbs[position / 32] >> (position % 32)) & 1u : 0;
+        *high = (*high << 1) | (*low >> 63);
+        *low = (*low << 1) | bit;
+    }
+}
+
+/**
+ * Build the table of powers of ten. 10^e and 5^e share a mantissa, positive
+ * powers are exact powers of five, negative ones are floor(2^1024 / 5^-e)
+ * which has more than 128 significant bits over the whole range.
+ */
+static void initPowersOfTen(void) {
+    uint32_t limbs[40];
+    int count = 1;
+    int exponent, i;
+    memset(limbs, 0, sizeof(limbs));
+    limbs[0] = 1;
+    for (exponent = 0; exponent <= POWERS_MAX_EXPONENT; exponent++) {
+        uint64_t *entry = powersOfTen[exponent - POWERS_MIN_EXPONENT];
+        topBits(limbs, count, &entry[1], &entry[0]);
+        uint64_t carry = 0;
+        for (i = 0; i < count; i++) {
+            uint64_t product = (uint64_t) limbs[i] * 5 + carry;
+            limbs[i] = (uint32_t) product;
+            carry = product >> 32;
+        }
+        if (carry) {
+            limbs[count++] = (uint32_t) carry;
+        }
+    }
+    memset(limbs, 0, sizeof(limbs));
+    count = 33;
+    limbs[32] = 1; // 2^1024
+    for (exponent = -1; exponent >= POWERS_MIN_EXPONENT; exponent--) {
+        uint64_t remainder = 0;
+        for (i = count - 1; i >= 0; i--) { // Floor division composes, floor(floor(x / 5) / 5) = floor(x / 25).
+            uint64_t current = (remainder << 32) | limbs[i];
+            limbs[i] = (uint32_t) (current / 5);
+            remainder = current % 5;
+        }
+        uint64_t *entry = powersOfTen[exponent - POWERS_MIN_EXPONENT];
+        topBits(limbs, count, &entry[1], &entry[0]);
+    }
+    powersReady = true;
+}
+
+/**
+ * floor(value / 2^16) for negative values too.
+ */
+static int64_t floorShift16(int64_t value) {
+    return value >= 0 ? value >> 16 : -((-value + 65535) >> 16);
+}
+
+bool eiselLemire(uint64_t w, int exponent, double *result) {
+    if (w == 0) {
+        *result = 0;
+        return true;
+    }
+    if (exponent < POWERS_MIN_EXPONENT || exponent > POWERS_MAX_EXPONENT) {
+        return false;
+    }
+    if (!powersReady) {
+        initPowersOfTen();
+    }
+    const uint64_t *power = powersOfTen[exponent - POWERS_MIN_EXPONENT];
+    int shift = leadingZeros64(w);
+    w <<= shift;
+    // 217706 / 2^16 approximates log2(10).
+    uint64_t resultExponent = (uint64_t) (floorShift16(217706 * (int64_t) exponent) + 64 + 1023) - (uint64_t) shift;
+
+    uint64_t high, low;
+    multiply64(w, power[1], &high, &low);
+    if ((high & 0x1FF) == 0x1FF && low + w < w) { // The truncated table may be off, widen the product.
+        uint64_t wideHigh, wideLow;
+        multiply64(w, power[0], &wideHigh, &wideLow);
+        uint64_t mergedHigh = high, mergedLow = low + wideHigh;
+        if (mergedLow < low) {
+            mergedHigh++;
+        }
+        if ((mergedHigh & 0x1FF) == 0x1FF && mergedLow + 1 == 0 && wideLow + w < w) {
+            return false;
+        }
+        high = mergedHigh;
+        low = mergedLow;
+    }
+
+    uint64_t topBit = high >> 63;
+    uint64_t mantissa = high >> (topBit + 9);
+    resultExponent -= 1 ^ topBit;
+    if (low == 0 && (high & 0x1FF) == 0 && (mantissa & 3) == 1) { // Exactly half way, can not tell.
+        return false;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >> 53) {
+        mantissa >>= 1;
+        resultExponent++;
+    }
+    if (resultExponent - 1 >= 0x7FF - 1) { // Subnormal or infinite.
+        return false;
+    }
+    uint64_t bits = resultExponent << 52 | (mantissa & 0x000FFFFFFFFFFFFFull);
+    memcpy(result, &bits, sizeof(double));
+    return true;
+}
+
+/**
+ * Round with strtod, for the rare cases the fast paths reject.
+ */
+static double slowRound(const char *start, size_t length) {
+    char buffer[128];
+    char *copy = length < sizeof(buffer) ? buffer : (char *) malloc(length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    double value = strtod(copy, NULL);
+    if (copy != buffer) {
+        free(copy);
+    }
+    return value;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || defined(_M_X64) || defined(_M_IX86)
+#define SCAN_SWAR 1
+
+/**
+ * Check that all eight bytes of a little endian word are digits.
+ */
+static bool isEightDigits(uint64_t word) {
+    return ((word & 0xF0F0F0F0F0F0F0F0ull) |
+            (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+/**
+ * Convert eight ASCII digits in a little endian word, with three multiplications.
+ */
+static uint32_t parseEightDigits(uint64_t word) {
+    word -= 0x3030303030303030ull;
+    word = (word * 10) + (word >> 8);
+    return (uint32_t) (((word & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+                        ((word >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32);
+}
+#endif
+
+/**
+ * Accumulate a run of digits into w.
+ * @return the first character that is not a digit.
+ */
+static const char *scanDigits(const char *ch, const char *end, uint64_t *w) {
+    uint64_t value = *w;
+#ifdef SCAN_SWAR
+    while (end - ch >= 8) {
+        uint64_t word;
+        memcpy(&word, ch, sizeof(word));
+        if (!isEightDigits(word)) {
+            break;
+        }
+        value = value * 100000000 + parseEightDigits(word);
+        ch += 8;
+    }
+#endif
+    while (ch < end && *ch >= '0' && *ch <= '9') {
+        value = value * 10 + (unsigned) (*ch++ - '0');
+    }
+    *w = value;
+    return ch;
+}
+
+/**
+ * Round an exact w * 10^exponent, or set the value with the slow path.
+ */
+static void roundLiteral(const char *start, size_t length, uint64_t w, int exponent, bool truncated,
+                         NumberLiteral *literal) {
+    // Clinger's fast path, both operands are exact doubles so one rounding is correct.
+    if (!truncated && w <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        literal->value = exponent >= 0 ? (double) w * exactPowersOfTen[exponent]
+                                       : (double) w / exactPowersOfTen[-exponent];
+        return;
+    }
+    double value, upper;
+    if (eiselLemire(w, exponent, &value)) {
+        // With truncated digits the value lies between w and w + 1, both must round alike.
+        if (!truncated || (eiselLemire(w + 1, exponent, &upper) && upper == value)) {
+            literal->value = value;
+            return;
+        }
+    }
+    literal->value = slowRound(start, length);
+}
+
+bool scanNumberLiteral(const char *start, size_t length, NumberLiteral *literal) {
+    const char *ch = start;
+    const char *end = start + length;
+    if (length <= MAX_SIGNIFICANT_DIGITS) { // Short literals never truncate, the common case.
+        uint64_t w = 0;
+        if (ch == end || *ch < '0' || *ch > '9') {
+            return false;
+        }
+        ch = scanDigits(ch, end, &w);
+        int scale = 0;
+        if (ch < end && *ch == '.') {
+            const char *fraction = ++ch;
+            ch = scanDigits(ch, end, &w);
+            scale = (int) (ch - fraction);
+            if (scale == 0) {
+                return false;
+            }
+        }
+        if (ch != end) {
+            return false;
+        }
+        literal->kind = scale ? LITERAL_DECIMAL : LITERAL_INTEGER;
+        literal->mantissa = w;
+        literal->scale = scale;
+        roundLiteral(start, length, w, -scale, false, literal);
+        return true;
+    }
+
+    uint64_t w = 0;
+    int significant = 0; // Digits in w, not counting leading zeros.
+    int exponent = 0; // value = w * 10^exponent, if nothing was truncated.
+    int scale = 0;
+    bool truncated = false; // A non zero digit did not fit in w.
+    if (ch == end || *ch < '0' || *ch > '9') {
+        return false;
+    }
+    while (ch < end && *ch >= '0' && *ch <= '9') {
+        unsigned digit = (unsigned) (*ch++ - '0');
+        if (significant < MAX_SIGNIFICANT_DIGITS) {
+            w = w * 10 + digit;
+            significant += w != 0;
+        } else {
+            exponent++;
+            truncated |= digit != 0;
+        }
+    }
+    if (ch < end && *ch == '.') {
+        ch++;
+        if (ch == end || *ch < '0' || *ch > '9') {
+            return false;
+        }
+        while (ch < end && *ch >= '0' && *ch <= '9') {
+            unsigned digit = (unsigned) (*ch++ - '0');
+            scale++;
+            if (significant < MAX_SIGNIFICANT_DIGITS) {
+                w = w * 10 + digit;
+                significant += w != 0;
+                exponent--;
+            } else {
+                truncated |= digit != 0;
+            }
+        }
+    }
+    if (ch != end) {
+        return false;
+    }
+
+    literal->mantissa = w;
+    literal->scale = 0;
+    literal->kind = LITERAL_FLOAT;
+    if (!truncated) {
+        if (exponent < 0) {
+            literal->kind = LITERAL_DECIMAL;
+            literal->scale = -exponent;
+        } else if (scale == 0) {
+            // Dropped integer digits were zeros, it is exact if it still fits.
+            uint64_t value = w;
+            int i;
+            for (i = 0; i < exponent && value <= UINT64_MAX / 10; i++) {
+                value *= 10;
+            }
+            if (i == exponent) {
+                literal->kind = LITERAL_INTEGER;
+                literal->mantissa = value;
+            }
+        }
+    }
+
+    roundLiteral(start, length, w, exponent, truncated, literal);
+    return true;
+}
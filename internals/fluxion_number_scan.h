@@ -0,0 +1,47 @@
+//
+// Number literal scanner, parses literals straight from source spans.
+//
+
+#ifndef FLUXIONCORE_FLUXION_NUMBER_SCAN_H
+#define FLUXIONCORE_FLUXION_NUMBER_SCAN_H
+#include <stddef.h>
+#include "commons.h"
+
+/**
+ * How exactly a literal is known.
+ */
+typedef enum {
+    LITERAL_INTEGER, // mantissa is the exact value.
+    LITERAL_DECIMAL, // mantissa / 10^scale is the exact value.
+    LITERAL_FLOAT // Too many digits to be held exactly, only value is set.
+} LiteralKind;
+
+/**
+ * A scanned number literal.
+ */
+typedef struct {
+    LiteralKind kind;
+    uint64_t mantissa;
+    int32_t scale; // Digits after the decimal point.
+    double value; // Correctly rounded nearest double, always set.
+} NumberLiteral;
+
+/**
+ * Scan a literal of the form digits or digits.digits.
+ * @param start Start of the literal, does not need to be null terminated.
+ * @param length Length of the literal.
+ * @param literal Literal to fill.
+ * @return false if the span is not a number literal.
+ */
+bool scanNumberLiteral(const char *start, size_t length, NumberLiteral *literal);
+
+/**
+ * Correctly round w * 10^exponent to a double using the Eisel-Lemire algorithm.
+ * @param w Decimal significand.
+ * @param exponent Decimal exponent.
+ * @param result Rounded value, set on success.
+ * @return false if the case is ambiguous and needs a slower algorithm.
+ */
+bool eiselLemire(uint64_t w, int exponent, double *result);
+
+#endif //FLUXIONCORE_FLUXION_NUMBER_SCAN_H
@@ -3,6 +3,7 @@
 //
 
 #include "fluxion_parser.h"
+#include "fluxion_set.h"
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
@@ -11,7 +12,7 @@ TokenStack *initTokenStack() {
     TokenStack  *stack = (TokenStack *) malloc(sizeof(TokenStack));
     stack->current = 0;
     stack->capacity = 8;
-    stack->tokens = (Token**) malloc(sizeof(Token) * stack->capacity);
+    stack->tokens = (Token**) malloc(sizeof(Token*) * stack->capacity);
     return stack;
 }
 
@@ -28,279 +29,352 @@ Token *StackPop(TokenStack *stack, Token *token) {
     if (stack->current == 0) {
         return NULL;
     } else {
-        return stack->tokens[stack->current--];
+        return stack->tokens[--stack->current];
     }
 }
 
 void parserConsume(Parser *parser) {
-    if (parser->ch_ != 0)
-        parser->ch_++;
+    if (parser->lexBuffer->tokens[parser->position].kind != LEX_EOF) {
+        parser->position++;
+    }
 }
 
-char parserPeek(Parser *parser) {
-    return *parser->ch_;
-}
-char parserPop(Parser *parser) {
-    char c = parserPeek(parser);
-    parser->ch_++;
-    return c;
+const LexToken *parserPeek(Parser *parser) {
+    return parser->lexBuffer->tokens + parser->position;
 }
 
-char parserDoublePeek(Parser *parser) {
-    if (*parser->ch_ != 0) {
-        return *(parser->ch_ + 1);
-    } else {
-        return 0;
-    }
+const LexToken *parserPop(Parser *parser) {
+    const LexToken *token = parserPeek(parser);
+    parserConsume(parser);
+    return token;
 }
-void parserRewind(Parser *parser) {
-    parser->ch_--;
+
+const LexToken *parserDoublePeek(Parser *parser) {
+    const LexToken *token = parserPeek(parser);
+    return token->kind == LEX_EOF ? token : token + 1;
 }
 
 void issueParserError(Parser *parser, ErrorLiteral literal, const char *message) {
-    char *str = NULL;
-    sprintf(str, "at line %i, %s", parser->lineCount, message);
+    char str[256];
+    snprintf(str, sizeof(str), "at line %i, %s\n", parserPeek(parser)->lineCount, message);
     Error newError = {literal, str};
     issueError(&newError);
+    parser->errorCount++;
 }
 
-bool isDigit(Parser *parser) {
-    return isdigit(parserPeek(parser)) == 1;
+NumberToken *parseNumber(Parser *parser) {
+    const LexToken *lexToken = parserPop(parser);
+    NumberLiteral literal;
+    const char *start = parser->source + lexToken->offset;
+    scanNumberLiteral(start, lexToken->length, &literal); // The lexer checked the form.
+    if (literal.kind == LITERAL_FLOAT) { // Too long for the literal, read the exact value from the source.
+        NumberToken *token = initNumberTokenNumber(parser->arena, lexToken->lineCount,
+                                                   numberFromDecimal(start, lexToken->length));
+        token->value = literal.value;
+        return token;
+    }
+    return initNumberTokenLiteral(parser->arena, lexToken->lineCount, &literal);
 }
 
-bool isWhitespace(Parser *parser) {
-    return parserPeek(parser) == ' ' || parserPeek(parser) == '\t';
-}
+/**
+ * Binding powers of an operator, higher binds tighter and 0 means
+ * the operator has no such form. Powers are even so a right associative
+ * operator can parse its right operand one below its own power.
+ */
+typedef struct {
+    uint8_t infix; // Left binding power of the infix form.
+    uint8_t prefix; // Power the operand of the prefix form is parsed with.
+    uint8_t postfix; // Left binding power of the postfix form.
+    bool rightAssociative;
+} BindingPower;
+
+static const BindingPower bindingPowers[] = {
+        [SCOPE] = {2, 0, 0, true},
+        [ASSIGN] = {2, 0, 0, true},
+        [BAR] = {4, 0, 0, false},
+        [AMPERSAND] = {6, 0, 0, false},
+        [LESS] = {8, 0, 0, false},
+        [GREATER] = {8, 0, 0, false},
+        [LEQ] = {8, 0, 0, false},
+        [GEQ] = {8, 0, 0, false},
+        [EQUAL] = {8, 0, 0, false},
+        [NEQ] = {8, 0, 0, false},
+        [IN] = {10, 0, 0, false},
+        [LIMIT] = {12, 0, 0, true},
+        [PLUS] = {14, 18, 0, false},
+        [MINUS] = {14, 18, 0, false},
+        [MULTIPLY] = {16, 0, 0, false},
+        [DIVIDE] = {16, 0, 0, false},
+        [NOT] = {0, 18, 0, false},
+        [POWER] = {20, 0, 0, true},
+        [FACTORIAL] = {0, 0, 22, false},
+        [DIFF] = {0, 0, 22, false},
+        [GET] = {24, 0, 0, false}
+};
+
+static Token *parseInfix(Parser *parser, Token *left, int minPower);
+static Token *parseTree(Parser *parser, int minPower);
 
-bool isEOL(Parser *parser) {
-    return parserPeek(parser) == '\n' && !parser->ignoreEOL;
+static void expectClosing(Parser *parser, LexKind kind, const char *message) {
+    if (parserPeek(parser)->kind == kind) {
+        parserConsume(parser);
+    } else {
+        issueParserError(parser, Undefined, message);
+    }
 }
 
-bool isCharTerminator(char c) {
-    return c == ' ' || c == '\t' || c == '\n' || c == '\0';
+static bool isVariable(const Token *token) {
+    return token != NULL && token->tokenType == IDENTIFIER &&
+           ((const IdentifierToken *) token)->identifierType == Variable;
 }
 
-bool isCharInStr(char c, const char *str) {
-    char *ptr = str;
-    while (*ptr) {
-        if (c == *ptr) {
-            return true;
+/**
+ * Parse the arguments of a function call, starting after the (.
+ * @param parser Parser pointer.
+ * @param functionToken Function to add the arguments to.
+ */
+void parseFunctionArgs(Parser *parser, FunctionToken *functionToken) {
+    if (parserPeek(parser)->kind == LEX_RIGHT_PAREN) {
+        parserConsume(parser);
+        return;
+    }
+    while (true) {
+        Token *arg = parseTree(parser, 0);
+        if (arg != NULL) {
+            addArgument(functionToken, arg);
+        }
+        switch (parserPeek(parser)->kind) {
+            case LEX_COMMA:
+                parserConsume(parser);
+                break;
+            case LEX_RIGHT_PAREN:
+                parserConsume(parser);
+                return;
+            default:
+                issueParserError(parser, Undefined, "Expected ).");
+                return;
         }
-        ptr++;
     }
-    return false;
 }
 
-NumberToken *parseNumber(Parser *parser) {
-    char *number = "";
-    while (!isEOL(parser) && !isWhitespace(parser) && (isDigit(parser) || parserPeek(parser) == '.')) {
-        strncat(number, parser->ch_, 1);
-        parserConsume(parser);
+/**
+ * Parse the rest of a sequence declaration, {1, 1} x_n -> x_{n - 1} + x_{n - 2},
+ * starting after the prelist.
+ * @param parser Parser pointer.
+ * @param prelist The already parsed initial terms.
+ * @return the sequence, or the prelist if the declaration is malformed.
+ */
+static Token *parseSequence(Parser *parser, FiniteToken *prelist) {
+    int lineCount = parserPeek(parser)->lineCount;
+    OperatorToken *term = (OperatorToken *) parseTree(parser, bindingPowers[LIMIT].infix);
+    if (term == NULL || term->token.tokenType != OPERATOR || term->operatorType != GET ||
+        !isVariable(term->left) || !isVariable(term->right)) {
+        issueParserError(parser, Undefined, "Expected a sequence term of the form x_n.");
+        return (Token *) prelist;
     }
-    return initNumberToken(parser->lineCount, strtod(number, NULL));
+    const LexToken *lexToken = parserPeek(parser);
+    if (lexToken->kind != LEX_OPERATOR || lexToken->operatorType != LIMIT) {
+        issueParserError(parser, Undefined, "Expected ->.");
+        return (Token *) prelist;
+    }
+    parserConsume(parser);
+    Token *rule = parseTree(parser, bindingPowers[LIMIT].infix - 1);
+    return (Token *) initSequenceToken(parser->arena, lineCount, prelist,
+                                       (IdentifierToken *) term->left, (IdentifierToken *) term->right,
+                                       initExpressionToken(parser->arena, lexToken->lineCount, rule));
 }
 
-OperatorToken *parseOperator(Parser *parser) {
-    char firstCharacter = parserPop(parser); // Some operators take two! we need to check.
-    char nextCharacter = parserPeek(parser);
-    OperatorToken *opToken;
-    switch (firstCharacter) { // The operator trie.
-        case '+':
-            return initOperatorToken(parser->lineCount, PLUS);
-        case '-':
-            if (nextCharacter == '>') {
-                parserConsume(parser);
-                return initOperatorToken(parser->lineCount, LIMIT);
-            }
-            return initOperatorToken(parser->lineCount, MINUS);
-        case '\\':
-            if (nextCharacter == '=') {
-                parserConsume(parser);
-                opToken = initOperatorToken(parser->lineCount, NEQ);
+/**
+ * Parse a braced literal, a finite set {1, 2}, a builder {x | x > 2},
+ * or a sequence {1, 1} x_n -> x_{n - 1} + x_{n - 2}.
+ * @param parser Parser pointer, at the {.
+ */
+static Token *parseBraces(Parser *parser) {
+    int lineCount = parserPop(parser)->lineCount;
+    FiniteToken *finite = initFiniteToken(parser->arena, lineCount);
+    if (parserPeek(parser)->kind != LEX_RIGHT_BRACE) {
+        // Stop before a |, so a leading x | can be told apart from an or.
+        Token *first = parseTree(parser, bindingPowers[BAR].infix);
+        const LexToken *lexToken = parserPeek(parser);
+        if (isVariable(first) && lexToken->kind == LEX_OPERATOR && lexToken->operatorType == BAR) {
+            parserConsume(parser);
+            Token *constraint = parseTree(parser, 0);
+            expectClosing(parser, LEX_RIGHT_BRACE, "Expected }.");
+            return (Token *) initBuilderToken(parser->arena, lineCount, (IdentifierToken *) first,
+                                              initExpressionToken(parser->arena, lexToken->lineCount, constraint));
+        }
+        Token *element = parseInfix(parser, first, 0);
+        while (true) {
+            if (element != NULL) {
+                finiteAddElement(finite, element);
             }
-            return initOperatorToken(parser->lineCount, NOT);
-        case '*':
-            return initOperatorToken(parser->lineCount, MULTIPLY);
-        case '/':
-            return initOperatorToken(parser->lineCount, DIVIDE);
-        case '&':
-            return initOperatorToken(parser->lineCount, AMPERSAND);
-        case '<':
-            if (nextCharacter == '=') {
-                parserConsume(parser);
-                return initOperatorToken(parser->lineCount, LEQ);
+            if (parserPeek(parser)->kind != LEX_COMMA) {
+                break;
             }
-            return initOperatorToken(parser->lineCount, LESS);
-        case '>':
-            if (nextCharacter == '=') {
+            parserConsume(parser);
+            element = parseTree(parser, 0);
+        }
+    }
+    expectClosing(parser, LEX_RIGHT_BRACE, "Expected }.");
+    finaliseFiniteToken(finite);
+    if (parserPeek(parser)->kind == LEX_IDENTIFIER) { // A set followed by a term starts a sequence.
+        return parseSequence(parser, finite);
+    }
+    canonicaliseFiniteToken(finite); // Prelists keep their duplicates, sets do not.
+    return (Token *) finite;
+}
+
+/**
+ * Parse an operand, a literal, an identifier, a call,
+ * a parenthesised expression or a prefix operator and its operand.
+ * @param parser Parser pointer.
+ * @return the operand, NULL after an error.
+ */
+static Token *parseOperand(Parser *parser) {
+    const LexToken *lexToken = parserPeek(parser);
+    switch ((LexKind) lexToken->kind) {
+        case LEX_NUMBER:
+            return (Token *) parseNumber(parser);
+        case LEX_IDENTIFIER: {
+            const LexToken *next = parserDoublePeek(parser);
+            parserConsume(parser);
+            if (next->kind == LEX_LEFT_PAREN && !(next->flags & LEX_FLAG_SPACE_BEFORE)) { // A call.
                 parserConsume(parser);
-                return initOperatorToken(parser->lineCount, GEQ);
+                FunctionToken *function = initFunctionTokenSpan(parser->arena, lexToken->lineCount,
+                                                                parser->source + lexToken->offset,
+                                                                lexToken->length);
+                parseFunctionArgs(parser, function);
+                finaliseFunctionToken(function);
+                return (Token *) function;
             }
-            return initOperatorToken(parser->lineCount, GREATER);
-        case 'i':
-            if (nextCharacter == 'n' && isCharTerminator(parserDoublePeek(parser))) { // By the way, this line
-                // Turns the parser into a 2 lookahead parser... So that's a huge performance issue but anyway...
-                return initOperatorToken(parser->lineCount, IN);
-            } else { // We now need to put the i back.
-                parserRewind(parser);
-                return NULL; // And return null.
-            }
-        case '=':
-            return initOperatorToken(parser->lineCount, EQUAL);
-        case ':':
-            switch (nextCharacter) {
-                case ':':
-                    parserConsume(parser);
-                    return initOperatorToken(parser->lineCount, SCOPE);
-                case '=':
-                    parserConsume(parser);
-                    return initOperatorToken(parser->lineCount, ASSIGN);
-                default: // We need to error out! This is a reserved but invalid token!
-                    issueParserError(parser, Undefined, ": operator is not defined on any type.");
-                    return NULL;
+            return (Token *) initIdentifierTokenSpan(parser->arena, lexToken->lineCount,
+                                                     parser->source + lexToken->offset, lexToken->length);
+        }
+        case LEX_OPERATOR: {
+            OperatorType operatorType = (OperatorType) lexToken->operatorType;
+            parserConsume(parser);
+            if (bindingPowers[operatorType].prefix == 0) {
+                issueParserError(parser, Undefined, "Expected an operand.");
+                return NULL;
             }
-        case '!':
-            return initOperatorToken(parser->lineCount, FACTORIAL);
-        case '_':
-            return initOperatorToken(parser->lineCount, GET);
-        case '^':
-            return initOperatorToken(parser->lineCount, POWER);
+            Token *operand = parseTree(parser, bindingPowers[operatorType].prefix);
+            return (Token *) initOperatorToken(parser->arena, lexToken->lineCount, operatorType, NULL, operand);
+        }
+        case LEX_LEFT_PAREN: {
+            parserConsume(parser);
+            Token *inner = parseTree(parser, 0);
+            expectClosing(parser, LEX_RIGHT_PAREN, "Expected ).");
+            return inner;
+        }
+        case LEX_LEFT_BRACE:
+            return parseBraces(parser);
+        case LEX_ERROR:
+            issueParserError(parser, Undefined, parser->lexBuffer->errorMessage);
+            parserConsume(parser);
+            return NULL;
+        case LEX_LEFT_BRACKET:
+            issueParserError(parser, Undefined, "Unexpected token.");
+            parserConsume(parser);
+            return NULL;
+        default: // A closing token, left for the caller to match.
+            issueParserError(parser, Undefined, "Expected an operand.");
+            return NULL;
     }
 }
 
 /**
- * Consume a singleline comment, discard it.
+ * Extend an already parsed left operand with every infix and postfix
+ * operator that binds tighter than minPower.
  * @param parser Parser pointer.
+ * @param left Parsed left operand.
+ * @param minPower Operators binding this loosely or looser end the tree.
+ * @return root of the tree.
  */
-void consumeComment(Parser *parser) {
-    while (parserPeek(parser) != '\n') {
+static Token *parseInfix(Parser *parser, Token *left, int minPower) {
+    while (true) {
+        const LexToken *lexToken = parserPeek(parser);
+        if (lexToken->kind != LEX_OPERATOR) {
+            return left;
+        }
+        OperatorType operatorType = (OperatorType) lexToken->operatorType;
+        const BindingPower *power = bindingPowers + operatorType;
+        if (power->postfix > minPower) {
+            parserConsume(parser);
+            left = (Token *) initOperatorToken(parser->arena, lexToken->lineCount, operatorType, left, NULL);
+            continue;
+        }
+        if (power->infix <= minPower) {
+            return left;
+        }
         parserConsume(parser);
-    }
-}
-
-void consumeMultilineComment(Parser *parser) {
-    do {
-        char c = parserPop(parser);
-        if (c == '*' && parserPeek(parser) == ';') {
+        Token *right;
+        if (operatorType == GET && parserPeek(parser)->kind == LEX_LEFT_BRACE) { // x_{n - 1} groups the index.
             parserConsume(parser);
-            break;
+            right = parseTree(parser, 0);
+            expectClosing(parser, LEX_RIGHT_BRACE, "Expected }.");
+        } else {
+            right = parseTree(parser, power->rightAssociative ? power->infix - 1 : power->infix);
         }
-    } while (true);
+        left = (Token *) initOperatorToken(parser->arena, lexToken->lineCount, operatorType, left, right);
+    }
 }
 
-void parseFunctionArgs(Parser *parser, FunctionToken *functionToken) {
-    while (parserPeek(parser) != ')') {
-        if (parser->ignoreEOL && parserPeek(parser) != '\n') {
-            issueParserError(parser, Undefined, "Expected new line.");
-        }
-        switch (parserPeek(parser)) {
-            case '\0':
-                issueParserError(parser, Undefined, "Expected ).");
-            case '\\':
-                if (parserDoublePeek(parser) == '\\') { // Might be line converter.
-                    parser->ignoreEOL = true;
-                    parserConsume(parser);
-                    parserConsume(parser);
-                } else {
-                    addArgument(functionToken, (Token *) parseExpression(parser, ",)")); // Might be start of not.
-                }
-                break;
-            case ';':
-                parserConsume(parser);
-                switch (parserDoublePeek(parser)) {
-                    case ';':
-                        parserConsume(parser);
-                        consumeComment(parser);
-                        break;
-                    case '*':
-                        parserConsume(parser);
-                        consumeMultilineComment(parser);
-                        break;
-                    default:
-                        issueParserError(parser, Undefined, "Expected ; or *");
-                        break;
-                }
-                break;
-            case '\n':
-                if (parser->ignoreEOL) {
-                    parser->ignoreEOL = false;
-                    parserConsume(parser);
-                } else {
-                    issueParserError(parser, Undefined, "Expected )");
-                }
-                break;
-            default:
-                addArgument(functionToken, (Token *) parseExpression(parser, ",)"));
-        }
+static Token *parseTree(Parser *parser, int minPower) {
+    return parseInfix(parser, parseOperand(parser), minPower);
+}
 
+ExpressionToken *parseExpression(Parser *parser, uint32_t terminals) {
+    int lineCount = parserPeek(parser)->lineCount;
+    Token *root = NULL;
+    terminals |= LEX_MASK(LEX_EOF);
+    if (!(terminals & LEX_MASK(parserPeek(parser)->kind))) {
+        root = parseTree(parser, 0);
     }
+    if (!(terminals & LEX_MASK(parserPeek(parser)->kind))) {
+        issueParserError(parser, Undefined, parserPeek(parser)->kind == LEX_ERROR ?
+                                            parser->lexBuffer->errorMessage : "Unexpected token.");
+        do { // Skip the rest of the line.
+            parserConsume(parser);
+        } while (!(terminals & LEX_MASK(parserPeek(parser)->kind)) && parserPeek(parser)->kind != LEX_EOL);
+    }
+    return initExpressionToken(parser->arena, lineCount, root);
 }
 
-ExpressionToken *parseExpression(Parser *parser, const char *terminals) {
-    TokenStack *tokenStack = initTokenStack(); // A stack just for this expression.
-    Token *token = NULL; // Traversing token pointer;
-    while (isCharInStr(parserPeek(parser), terminals)) {
-        char ch = parserPeek(parser);
-        if (isWhitespace(parser)) {
-            if (token != NULL && token->tokenType == IDENTIFIER) {//If identifier
-                if (((IdentifierToken *) token)->identifierType == Function) {
-                    finaliseFunctionToken((FunctionToken*) token);
-                }
-                StackPush(tokenStack, token);
-                token = NULL; // We finalised the identifier.
-            }
-            continue; // Whitespaces not caught by another rule is cast aside.
-        } else if (parser->ignoreEOL && ch != '\n') {
-            issueParserError(parser, Undefined, "Expected new line.");
-        }
-        switch (ch) {
-            case '+':
-            case '-':
-            case '\\':
-                if (parserDoublePeek(parser) == '\\') {
-                    if (parser->ignoreEOL) {
-                        issueParserError(parser, Undefined, "Expected new line.");
-                    }
-                    parser->ignoreEOL = true;
-                    break;
-                }
-            case '*':
-            case '/':
-            case '&':
-            case '<':
-            case '>':
-            case 'i':
-            case '=':
-            case ':':
-            case '!':
-            case '\'':
-            case '_':
-            case '^':
-                ; // In C, a case cannot immediately have a definition.
-                token = (Token*) parseOperator(parser);
-                break;
-            case '(':
-                if (token == NULL) {
-                    parserConsume(parser); // Consume (.
-                    token = (Token *) parseExpression(parser, ")");
-                } else { // Otherwise, call list for function.
-                    // First, convert the identifer to a Function.
-                    FunctionToken *newFunc = initFunctionToken(token->lineCount, ((IdentifierToken*) token)->name);
-                    freeToken(token);
-                    parseFunctionArgs(parser, newFunc);
-                    token = (Token *) newFunc;
-                }
-                break;
-            default: // Identifier
-                if (token == NULL) {
-                    token = (Token*) initIdentifierToken(parser->lineCount, "");
-                }
-                strncpy(((IdentifierToken*) token)->name, parser->ch_, 1);
-                continue;
+Parser *parse(const char *source) {
+    Parser *parser = (Parser *) malloc(sizeof(Parser));
+    parser->source = source;
+    parser->lexBuffer = lexSource(source);
+    parser->position = 0;
+    parser->lineCount = 1;
+    parser->errorCount = 0;
+    parser->arena = initArena(0);
+    parser->stack = initTokenStack();
+    while (parserPeek(parser)->kind != LEX_EOF) {
+        if (parserPeek(parser)->kind == LEX_EOL) {
+            parserConsume(parser);
+            continue;
         }
-        if (token != NULL) {
-            StackPush(tokenStack, (Token*) token);
-            token = NULL;
+        parser->lineCount = parserPeek(parser)->lineCount;
+        ExpressionToken *expression = parseExpression(parser, LEX_MASK(LEX_EOL));
+        if (expression->root != NULL) {
+            StackPush(parser->stack, (Token *) expression);
         }
     }
-}
\ No newline at end of file
+    return parser;
+}
+
+void freeParser(Parser *parser) {
+    free(parser->stack->tokens);
+    free(parser->stack);
+    freeLexBuffer(parser->lexBuffer);
+    freeArena(parser->arena); // Releases every token parsed at once.
+    free(parser);
+}
+
+Token **getTokens(Parser *parser) {
+    return parser->stack->tokens;
+}
+
+int getTokenCount(Parser *parser) {
+    return parser->stack->current;
+}
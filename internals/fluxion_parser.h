@@ -5,6 +5,7 @@
 #ifndef FLUXIONCORE_FLUXION_PARSER_H
 #define FLUXIONCORE_FLUXION_PARSER_H
 #include "fluxion_token.h"
+#include "fluxion_lexer.h"
 
 
 typedef struct {
@@ -19,33 +20,46 @@ Token *StackPop(TokenStack *stack, Token *token);
 
 typedef struct {
     const char *source;
-    char *ch_;
-    bool ignoreEOL;
+    LexBuffer *lexBuffer; // Tokens of the source, lexed up front.
+    uint32_t position; // Index of the current token.
     int lineCount;
     TokenStack *stack;
+    Arena *arena; // Every token of the parse is allocated here.
+    int errorCount; // Errors issued while parsing.
 } Parser;
 
+/**
+ * Mask of a LexKind, used to pass sets of terminals.
+ */
+#define LEX_MASK(kind) (1u << (kind))
 
 void parserConsume(Parser *parser);
-char parserPeek(Parser *parser);
-char parserPop(Parser *parser);
-char parserDoublePeek(Parser *parser);
-void parserRewind(Parser *parser);
+const LexToken *parserPeek(Parser *parser);
+const LexToken *parserPop(Parser *parser);
+const LexToken *parserDoublePeek(Parser *parser);
 
 void issueParserError(Parser *parser, ErrorLiteral literal, const char *message);
 
-bool isDigit(Parser *parser);
-bool isWhitespace(Parser *parser);
-bool isEOL(Parser *Parser);
-
 /**
- * Parse an expression.
- * Push it to the token stack.
+ * Parse an expression into a tree in one pass, operators
+ * are associated by their binding powers as they are read.
  * @param parser
- * @param terminal Character the expression will end on.
+ * @param terminals Mask of the token kinds the expression will end on.
+ */
+ExpressionToken *parseExpression(Parser *parser, uint32_t terminals);
+/**
+ * Parse a source, every token is allocated in an arena
+ * owned by the returned parser. Use copyToken with a NULL
+ * arena to keep a token after the parser is freed.
+ * @param source Source to parse.
+ * @return the parser holding the parsed expressions.
  */
-ExpressionToken *parseExpression(Parser *parser, const char *terminal);
 Parser *parse(const char *source);
+/**
+ * Free the parser, its arena and every token allocated in it.
+ * @param parser Parser to free.
+ */
+void freeParser(Parser *parser);
 Token **getTokens(Parser *parser);
 int getTokenCount(Parser *parser);
 #endif //FLUXIONCORE_FLUXION_PARSER_H
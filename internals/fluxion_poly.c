@@ -0,0 +1,1137 @@
+//
+// Polynomials with rational coefficients in packed form, and fast multiplication.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "fluxion_poly.h"
+#include "fluxion_modular.h"
+
+#define NTT_PRIME_BITS 61 // NTT primes are c 2^32 + 1 with c of 30 bits, so above 2^61.
+#define NTT_MAX_LOG 32 // Transforms up to 2^32 long.
+
+static BigInt *newIntegers(size_t count) {
+    BigInt *integers = (BigInt *) malloc(sizeof(BigInt) * (count ? count : 1));
+    size_t i;
+    for (i = 0; i < count; i++) {
+        initBigInt(integers + i);
+    }
+    return integers;
+}
+
+static void freeIntegers(BigInt *integers, size_t count) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        freeBigInt(integers + i);
+    }
+    free(integers);
+}
+
+static size_t maxBits(const BigInt *values, size_t count) {
+    size_t bits = 0, i;
+    for (i = 0; i < count; i++) {
+        size_t length = bigIntBitLength(values + i);
+        bits = length > bits ? length : bits;
+    }
+    return bits;
+}
+
+static size_t countBits(size_t count) {
+    size_t bits = 0;
+    while (count) {
+        bits++;
+        count >>= 1;
+    }
+    return bits;
+}
+
+#if defined(__SIZEOF_INT128__)
+static void setInt128(BigInt *result, __int128 value) {
+    unsigned __int128 magnitude = value < 0 ? -(unsigned __int128) value : (unsigned __int128) value;
+    bigIntSetUint64(result, (uint64_t) (magnitude >> 64));
+    if (magnitude >> 64) {
+        BigInt low;
+        initBigInt(&low);
+        bigIntSetUint64(&low, (uint64_t) magnitude);
+        bigIntShiftLeft(result, result, 64);
+        bigIntAdd(result, result, &low);
+        freeBigInt(&low);
+    } else {
+        bigIntSetUint64(result, (uint64_t) magnitude);
+    }
+    if (value < 0) {
+        bigIntNegate(result, result);
+    }
+}
+#endif
+
+static void schoolbook(BigInt *result, const BigInt *a, size_t aCount, const BigInt *b, size_t bCount) {
+    size_t count = aCount + bCount - 1, i, j;
+#if defined(__SIZEOF_INT128__)
+    size_t bitsA = maxBits(a, aCount), bitsB = maxBits(b, bCount);
+    if (bitsA < 64 && bitsB < 64 && bitsA + bitsB + countBits(aCount < bCount ? aCount : bCount) < 127) {
+        int64_t *small = (int64_t *) malloc(sizeof(int64_t) * (aCount + bCount));
+        __int128 *sums = (__int128 *) calloc(count, sizeof(__int128));
+        for (i = 0; i < aCount; i++) {
+            small[i] = bigIntToInt64(a + i);
+        }
+        for (j = 0; j < bCount; j++) {
+            small[aCount + j] = bigIntToInt64(b + j);
+        }
+        for (i = 0; i < aCount; i++) {
+            __int128 x = small[i];
+            if (x == 0) {
+                continue;
+            }
+            for (j = 0; j < bCount; j++) {
+                sums[i + j] += x * small[aCount + j];
+            }
+        }
+        for (i = 0; i < count; i++) {
+            setInt128(result + i, sums[i]);
+        }
+        free(sums);
+        free(small);
+        return;
+    }
+#endif
+    BigInt product;
+    initBigInt(&product);
+    for (i = 0; i < count; i++) {
+        bigIntSetInt64(result + i, 0);
+    }
+    for (i = 0; i < aCount; i++) {
+        if (bigIntIsZero(a + i)) {
+            continue;
+        }
+        for (j = 0; j < bCount; j++) {
+            bigIntMultiply(&product, a + i, b + j);
+            bigIntAdd(result + i + j, result + i + j, &product);
+        }
+    }
+    freeBigInt(&product);
+}
+
+static void karatsuba(BigInt *result, const BigInt *a, size_t aCount, const BigInt *b, size_t bCount) {
+    if (aCount < bCount) {
+        const BigInt *swap = a;
+        a = b;
+        b = swap;
+        size_t swapCount = aCount;
+        aCount = bCount;
+        bCount = swapCount;
+    }
+    size_t count = aCount + bCount - 1, i;
+    if (bCount < POLY_KARATSUBA_THRESHOLD) {
+        schoolbook(result, a, aCount, b, bCount);
+        return;
+    }
+    if (aCount > bCount) { // Unbalanced, multiply b by chunks of a as long as b.
+        BigInt *chunk = newIntegers(2 * bCount - 1);
+        size_t offset;
+        for (i = 0; i < count; i++) {
+            bigIntSetInt64(result + i, 0);
+        }
+        for (offset = 0; offset < aCount; offset += bCount) {
+            size_t length = aCount - offset < bCount ? aCount - offset : bCount;
+            karatsuba(chunk, a + offset, length, b, bCount);
+            for (i = 0; i < length + bCount - 1; i++) {
+                bigIntAdd(result + offset + i, result + offset + i, chunk + i);
+            }
+        }
+        freeIntegers(chunk, 2 * bCount - 1);
+        return;
+    }
+    // a = a0 + x^m a1, b = b0 + x^m b1, a b = z0 + x^m ((a0 + a1)(b0 + b1) - z0 - z2) + x^2m z2.
+    size_t m = aCount / 2, high = aCount - m;
+    BigInt *z0 = newIntegers(2 * m - 1), *z1 = newIntegers(2 * high - 1), *z2 = newIntegers(2 * high - 1);
+    BigInt *sums = newIntegers(2 * high);
+    karatsuba(z0, a, m, b, m);
+    karatsuba(z2, a + m, high, b + m, high);
+    for (i = 0; i < high; i++) {
+        if (i < m) {
+            bigIntAdd(sums + i, a + i, a + m + i);
+            bigIntAdd(sums + high + i, b + i, b + m + i);
+        } else {
+            bigIntCopy(sums + i, a + m + i);
+            bigIntCopy(sums + high + i, b + m + i);
+        }
+    }
+    karatsuba(z1, sums, high, sums + high, high);
+    for (i = 0; i < 2 * high - 1; i++) {
+        if (i < 2 * m - 1) {
+            bigIntSubtract(z1 + i, z1 + i, z0 + i);
+        }
+        bigIntSubtract(z1 + i, z1 + i, z2 + i);
+    }
+    for (i = 0; i < count; i++) {
+        bigIntSetInt64(result + i, 0);
+    }
+    for (i = 0; i < 2 * m - 1; i++) {
+        bigIntMove(result + i, z0 + i);
+    }
+    for (i = 0; i < 2 * high - 1; i++) {
+        bigIntMove(result + 2 * m + i, z2 + i);
+    }
+    for (i = 0; i < 2 * high - 1; i++) {
+        bigIntAdd(result + m + i, result + m + i, z1 + i);
+    }
+    freeIntegers(sums, 2 * high);
+    freeIntegers(z2, 2 * high - 1);
+    freeIntegers(z1, 2 * high - 1);
+    freeIntegers(z0, 2 * m - 1);
+}
+
+typedef struct {
+    uint64_t prime;
+    uint64_t root; // Of order 2^NTT_MAX_LOG.
+} NttPrime;
+
+static NttPrime nttPrimes[POLY_NTT_MAX_PRIMES];
+static size_t nttPrimeCount;
+static uint64_t nttNextMultiplier = ((uint64_t) 1 << 30) - 1;
+
+/**
+ * The first count primes c 2^32 + 1, found once and kept.
+ */
+static const NttPrime *getNttPrimes(size_t count) {
+    while (nttPrimeCount < count) {
+        uint64_t multiplier = nttNextMultiplier--, prime = multiplier << NTT_MAX_LOG | 1, generator;
+        if (!wordIsPrime(prime)) {
+            continue;
+        }
+        for (generator = 3; powerModulo(generator, (prime - 1) / 2, prime) != prime - 1; generator++);
+        // A non residue to the power c has order exactly 2^32.
+        nttPrimes[nttPrimeCount].prime = prime;
+        nttPrimes[nttPrimeCount++].root = powerModulo(generator, multiplier, prime);
+    }
+    return nttPrimes;
+}
+
+/**
+ * Powers of a root with their Shoup factors, roots[i] = root^i for i < half.
+ */
+static void rootTable(uint64_t *roots, uint64_t *shoups, size_t half, uint64_t root, uint64_t prime) {
+    uint64_t power = 1;
+    size_t i;
+    for (i = 0; i < half; i++) {
+        roots[i] = power;
+        shoups[i] = shoupFactor(power, prime);
+        power = multiplyModulo(power, root, prime);
+    }
+}
+
+/**
+ * Decimation in frequency, natural order in and bit reversed order out.
+ */
+static void forwardTransform(uint64_t *values, size_t n, const uint64_t *roots, const uint64_t *shoups,
+                             uint64_t prime) {
+    size_t length, start, j;
+    for (length = n; length >= 2; length >>= 1) {
+        size_t half = length / 2, step = n / length;
+        for (start = 0; start < n; start += length) {
+            uint64_t *low = values + start, *high = low + half;
+            for (j = 0; j < half; j++) {
+                uint64_t u = low[j], v = high[j];
+                low[j] = addModulo(u, v, prime);
+                high[j] = shoupMultiply(subtractModulo(u, v, prime), roots[j * step], shoups[j * step], prime);
+            }
+        }
+    }
+}
+
+/**
+ * Decimation in time, bit reversed order in and natural order out, unscaled.
+ */
+static void inverseTransform(uint64_t *values, size_t n, const uint64_t *roots, const uint64_t *shoups,
+                             uint64_t prime) {
+    size_t length, start, j;
+    for (length = 2; length <= n; length <<= 1) {
+        size_t half = length / 2, step = n / length;
+        for (start = 0; start < n; start += length) {
+            uint64_t *low = values + start, *high = low + half;
+            for (j = 0; j < half; j++) {
+                uint64_t u = low[j], v = shoupMultiply(high[j], roots[j * step], shoups[j * step], prime);
+                low[j] = addModulo(u, v, prime);
+                high[j] = subtractModulo(u, v, prime);
+            }
+        }
+    }
+}
+
+static size_t maxLimbs(const BigInt *values, size_t count) {
+    size_t limbs = 0, i;
+    for (i = 0; i < count; i++) {
+        limbs = values[i].size > limbs ? values[i].size : limbs;
+    }
+    return limbs;
+}
+
+/**
+ * Residues of integers, zero padded to n.
+ * @param powers 2^(32 l) modulo prime for every limb l.
+ */
+static void residues(uint64_t *values, const BigInt *integers, size_t count, size_t n, uint64_t prime,
+                     const uint64_t *powers) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        const BigInt *integer = integers + i;
+#if defined(__SIZEOF_INT128__)
+        // Products of a limb and a power are below 2^94, so the sum of all of them fits.
+        unsigned __int128 sum = 0;
+        uint32_t limb;
+        for (limb = 0; limb < integer->size; limb++) {
+            sum += (unsigned __int128) integer->limbs[limb] * powers[limb];
+        }
+        uint64_t remainder = (uint64_t) (sum % prime);
+        values[i] = integer->negative && remainder ? prime - remainder : remainder;
+#else
+        (void) powers;
+        values[i] = integerModulo(integer, prime);
+#endif
+    }
+    memset(values + count, 0, sizeof(uint64_t) * (n - count));
+}
+
+/**
+ * result = result * word + addend, for result non negative.
+ */
+static void multiplyAddWord(BigInt *result, uint64_t word, uint64_t addend, BigInt *scratch) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 carry = addend;
+    uint32_t limb;
+    (void) scratch;
+    bigIntReserve(result, (size_t) result->size + 4);
+    for (limb = 0; limb < result->size; limb++) {
+        carry += (unsigned __int128) result->limbs[limb] * word;
+        result->limbs[limb] = (Limb) carry;
+        carry >>= 32;
+    }
+    for (; carry; carry >>= 32) {
+        result->limbs[result->size++] = (Limb) carry;
+    }
+#else
+    bigIntMultiplyLimb(scratch, result, (Limb) (word >> 32));
+    bigIntShiftLeft(scratch, scratch, 32);
+    bigIntMultiplyLimb(result, result, (Limb) word);
+    bigIntAdd(result, result, scratch);
+    bigIntSetUint64(scratch, addend);
+    bigIntAdd(result, result, scratch);
+#endif
+}
+
+/**
+ * Multiply modulo primeCount NTT primes, then join the residues of each
+ * coefficient with Garner's algorithm into the symmetric range.
+ */
+static void nttMultiply(BigInt *result, const BigInt *a, size_t aCount, const BigInt *b, size_t bCount,
+                        size_t primeCount) {
+    size_t count = aCount + bCount - 1, n = 1, i, j, k;
+    while (n < count) {
+        n <<= 1;
+    }
+    const NttPrime *primes = getNttPrimes(primeCount);
+    bool square = a == b && aCount == bCount;
+    uint64_t *fa = (uint64_t *) malloc(sizeof(uint64_t) * n);
+    uint64_t *fb = square ? fa : (uint64_t *) malloc(sizeof(uint64_t) * n);
+    uint64_t *tables = (uint64_t *) malloc(sizeof(uint64_t) * 2 * n); // Roots and their Shoup factors.
+    uint64_t *products = (uint64_t *) malloc(sizeof(uint64_t) * primeCount * count);
+    size_t limbCount = maxLimbs(a, aCount) > maxLimbs(b, bCount) ? maxLimbs(a, aCount) : maxLimbs(b, bCount);
+    uint64_t *powers = (uint64_t *) malloc(sizeof(uint64_t) * (limbCount ? limbCount : 1));
+    for (k = 0; k < primeCount; k++) {
+        uint64_t prime = primes[k].prime, inverse;
+        uint64_t root = powerModulo(primes[k].root, ((uint64_t) 1 << NTT_MAX_LOG) / n, prime);
+        for (i = 0; i < limbCount; i++) {
+            powers[i] = i == 0 ? 1 : multiplyModulo(powers[i - 1], (uint64_t) 1 << 32, prime);
+        }
+        residues(fa, a, aCount, n, prime, powers);
+        rootTable(tables, tables + n / 2 + 1, n / 2 + 1, root, prime);
+        forwardTransform(fa, n, tables, tables + n / 2 + 1, prime);
+        if (!square) {
+            residues(fb, b, bCount, n, prime, powers);
+            forwardTransform(fb, n, tables, tables + n / 2 + 1, prime);
+        }
+        for (i = 0; i < n; i++) {
+            fa[i] = multiplyModulo(fa[i], fb[i], prime);
+        }
+        inverseModulo(root, prime, &root);
+        rootTable(tables, tables + n / 2 + 1, n / 2 + 1, root, prime);
+        inverseTransform(fa, n, tables, tables + n / 2 + 1, prime);
+        inverseModulo(n % prime, prime, &inverse);
+        uint64_t shoup = shoupFactor(inverse, prime);
+        for (i = 0; i < count; i++) {
+            products[k * count + i] = shoupMultiply(fa[i], inverse, shoup, prime);
+        }
+    }
+    if (primeCount == 1) {
+        uint64_t prime = primes[0].prime;
+        for (i = 0; i < count; i++) {
+            uint64_t value = products[i];
+            bigIntSetInt64(result + i, value > prime / 2 ? -(int64_t) (prime - value) : (int64_t) value);
+        }
+    } else {
+        // Inverses of p_j modulo p_k for j < k, with their Shoup factors.
+        uint64_t *inverses = (uint64_t *) malloc(sizeof(uint64_t) * primeCount * (2 * primeCount + 1));
+        uint64_t *shoups = inverses + primeCount * primeCount, *digits = shoups + primeCount * primeCount;
+        BigInt modulus, half, scratch;
+        initBigInt(&modulus);
+        initBigInt(&half);
+        initBigInt(&scratch);
+        bigIntSetInt64(&modulus, 1);
+        for (k = 0; k < primeCount; k++) {
+            for (j = 0; j < k; j++) {
+                inverseModulo(primes[j].prime % primes[k].prime, primes[k].prime, inverses + k * primeCount + j);
+                shoups[k * primeCount + j] = shoupFactor(inverses[k * primeCount + j], primes[k].prime);
+            }
+            multiplyAddWord(&modulus, primes[k].prime, 0, &scratch);
+        }
+        bigIntShiftRight(&half, &modulus, 1);
+        for (i = 0; i < count; i++) {
+            for (k = 0; k < primeCount; k++) { // Mixed radix digits, value = d0 + p0 (d1 + p1 (d2 + ...)).
+                uint64_t prime = primes[k].prime, digit = products[k * count + i];
+                for (j = 0; j < k; j++) {
+                    // Every prime is between 2^61 and 2^62, so one subtraction reduces a digit.
+                    uint64_t reduced = digits[j] >= prime ? digits[j] - prime : digits[j];
+                    digit = shoupMultiply(subtractModulo(digit, reduced, prime), inverses[k * primeCount + j],
+                                          shoups[k * primeCount + j], prime);
+                }
+                digits[k] = digit;
+            }
+            bigIntSetUint64(result + i, digits[primeCount - 1]);
+            for (k = primeCount - 1; k-- > 0;) {
+                multiplyAddWord(result + i, primes[k].prime, digits[k], &scratch);
+            }
+            if (bigIntCompare(result + i, &half) > 0) {
+                bigIntSubtract(result + i, result + i, &modulus);
+            }
+        }
+        freeBigInt(&scratch);
+        freeBigInt(&half);
+        freeBigInt(&modulus);
+        free(inverses);
+    }
+    free(powers);
+    free(products);
+    free(tables);
+    if (!square) {
+        free(fb);
+    }
+    free(fa);
+}
+
+void polyMultiplyDense(BigInt *result, const BigInt *a, size_t aCount, const BigInt *b, size_t bCount,
+                       PolyMultiplyAlgorithm algorithm) {
+    if (aCount == 0 || bCount == 0) {
+        return;
+    }
+    size_t shorter = aCount < bCount ? aCount : bCount, bitsA = maxBits(a, aCount), bitsB = maxBits(b, bCount);
+    size_t bits = bitsA + bitsB + countBits(shorter);
+    size_t primeCount = (bits + 1 + NTT_PRIME_BITS - 1) / NTT_PRIME_BITS; // The modulus covers twice the bound.
+    if (algorithm == POLY_MULTIPLY_AUTO) {
+        // Schoolbook on word coefficients accumulates in 128 bits, and stays fast for longer.
+        size_t nttThreshold = bitsA < 64 && bitsB < 64 ? POLY_NTT_THRESHOLD : POLY_KARATSUBA_THRESHOLD;
+        if (primeCount <= POLY_NTT_MAX_PRIMES) {
+            algorithm = shorter >= nttThreshold ? POLY_MULTIPLY_NTT : POLY_MULTIPLY_SCHOOLBOOK;
+        } else {
+            algorithm = shorter >= POLY_KARATSUBA_THRESHOLD ? POLY_MULTIPLY_KARATSUBA : POLY_MULTIPLY_SCHOOLBOOK;
+        }
+    }
+    if (algorithm == POLY_MULTIPLY_NTT && primeCount > POLY_NTT_MAX_PRIMES) {
+        algorithm = POLY_MULTIPLY_KARATSUBA;
+    }
+    switch (algorithm) {
+        case POLY_MULTIPLY_NTT:
+            nttMultiply(result, a, aCount, b, bCount, primeCount ? primeCount : 1);
+            break;
+        case POLY_MULTIPLY_KARATSUBA:
+            karatsuba(result, a, aCount, b, bCount);
+            break;
+        default:
+            schoolbook(result, a, aCount, b, bCount);
+            break;
+    }
+}
+
+/**
+ * Pack exponents.
+ * @return false if one does not fit its field.
+ */
+static bool packMonomial(const uint64_t *exponents, uint32_t count, uint64_t *monomial) {
+    uint64_t packed = 0;
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        if (exponents[i] > monomialFieldMax(count)) {
+            return false;
+        }
+        packed = count > 1 ? packed << monomialFieldBits(count) | exponents[i] : exponents[i];
+    }
+    *monomial = packed;
+    return true;
+}
+
+static void reserveTerms(Polynomial *polynomial, size_t count) {
+    if (count <= polynomial->capacity) {
+        return;
+    }
+    size_t capacity = polynomial->capacity ? polynomial->capacity : 8;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    polynomial->monomials = (uint64_t *) realloc(polynomial->monomials, sizeof(uint64_t) * capacity);
+    polynomial->coefficients = (BigInt *) realloc(polynomial->coefficients, sizeof(BigInt) * capacity);
+    polynomial->capacity = capacity;
+}
+
+void polynomialAppendTerm(Polynomial *polynomial, uint64_t monomial, BigInt *coefficient) {
+    if (bigIntIsZero(coefficient)) {
+        freeBigInt(coefficient);
+        return;
+    }
+    reserveTerms(polynomial, polynomial->count + 1);
+    polynomial->monomials[polynomial->count] = monomial;
+    initBigInt(polynomial->coefficients + polynomial->count);
+    bigIntMove(polynomial->coefficients + polynomial->count++, coefficient);
+}
+
+Polynomial *initPolynomial(void) {
+    Polynomial *polynomial = (Polynomial *) calloc(1, sizeof(Polynomial));
+    initBigInt(&polynomial->denominator);
+    bigIntSetInt64(&polynomial->denominator, 1);
+    return polynomial;
+}
+
+void freePolynomial(Polynomial *polynomial) {
+    if (polynomial == NULL) {
+        return;
+    }
+    size_t i;
+    for (i = 0; i < polynomial->count; i++) {
+        freeBigInt(polynomial->coefficients + i);
+    }
+    free(polynomial->coefficients);
+    free(polynomial->monomials);
+    freeBigInt(&polynomial->denominator);
+    free(polynomial);
+}
+
+Polynomial *emptyLike(const Polynomial *polynomial) {
+    Polynomial *result = initPolynomial();
+    result->variableCount = polynomial->variableCount;
+    memcpy(result->variables, polynomial->variables, sizeof(uint32_t) * polynomial->variableCount);
+    return result;
+}
+
+Polynomial *copyPolynomial(const Polynomial *polynomial) {
+    Polynomial *copy = emptyLike(polynomial);
+    size_t i;
+    reserveTerms(copy, polynomial->count);
+    for (i = 0; i < polynomial->count; i++) {
+        copy->monomials[i] = polynomial->monomials[i];
+        initBigInt(copy->coefficients + i);
+        bigIntCopy(copy->coefficients + i, polynomial->coefficients + i);
+    }
+    copy->count = polynomial->count;
+    bigIntCopy(&copy->denominator, &polynomial->denominator);
+    return copy;
+}
+
+Polynomial *polynomialFromDense(uint32_t variable, const BigInt *coefficients, size_t count) {
+    Polynomial *polynomial = initPolynomial();
+    BigInt coefficient;
+    initBigInt(&coefficient);
+    polynomial->variableCount = 1;
+    polynomial->variables[0] = variable;
+    while (count-- > 0) {
+        bigIntCopy(&coefficient, coefficients + count);
+        polynomialAppendTerm(polynomial, count, &coefficient);
+    }
+    return polynomial;
+}
+
+static int32_t variableIndex(const Polynomial *polynomial, uint32_t variable) {
+    uint32_t i;
+    for (i = 0; i < polynomial->variableCount; i++) {
+        if (polynomial->variables[i] == variable) {
+            return (int32_t) i;
+        }
+    }
+    return -1;
+}
+
+uint32_t polynomialExponent(const Polynomial *polynomial, size_t term, uint32_t variable) {
+    int32_t index = variableIndex(polynomial, variable);
+    return index < 0 ? 0 : (uint32_t) monomialExponent(polynomial->monomials[term], polynomial->variableCount,
+                                                      (uint32_t) index);
+}
+
+int64_t polynomialDegree(const Polynomial *polynomial, uint32_t variable) {
+    if (polynomial->count == 0) {
+        return -1;
+    }
+    int32_t index = variableIndex(polynomial, variable);
+    uint64_t degree = 0;
+    size_t i;
+    if (index == 0) { // Terms are ordered by the first variable.
+        return (int64_t) monomialExponent(polynomial->monomials[0], polynomial->variableCount, 0);
+    }
+    for (i = 0; index > 0 && i < polynomial->count; i++) {
+        uint64_t exponent = monomialExponent(polynomial->monomials[i], polynomial->variableCount, (uint32_t) index);
+        degree = exponent > degree ? exponent : degree;
+    }
+    return (int64_t) degree;
+}
+
+/**
+ * Highest exponent of every variable.
+ */
+static void maxExponents(const Polynomial *polynomial, uint64_t *degrees) {
+    size_t i;
+    uint32_t v;
+    memset(degrees, 0, sizeof(uint64_t) * polynomial->variableCount);
+    for (i = 0; i < polynomial->count; i++) {
+        for (v = 0; v < polynomial->variableCount; v++) {
+            uint64_t exponent = monomialExponent(polynomial->monomials[i], polynomial->variableCount, v);
+            degrees[v] = exponent > degrees[v] ? exponent : degrees[v];
+        }
+    }
+}
+
+/**
+ * Copy a polynomial into a superset of its variables.
+ * @return the copy, NULL if an exponent does not fit the narrower fields.
+ */
+static Polynomial *repack(const Polynomial *polynomial, const uint32_t *variables, uint32_t count) {
+    Polynomial *result = initPolynomial();
+    uint64_t exponents[POLY_MAX_VARIABLES];
+    uint32_t map[POLY_MAX_VARIABLES], v;
+    size_t i;
+    result->variableCount = count;
+    memcpy(result->variables, variables, sizeof(uint32_t) * count);
+    for (v = 0; v < polynomial->variableCount; v++) {
+        map[v] = (uint32_t) variableIndex(result, polynomial->variables[v]);
+    }
+    reserveTerms(result, polynomial->count);
+    for (i = 0; i < polynomial->count; i++) {
+        memset(exponents, 0, sizeof(exponents));
+        for (v = 0; v < polynomial->variableCount; v++) {
+            exponents[map[v]] = monomialExponent(polynomial->monomials[i], polynomial->variableCount, v);
+        }
+        if (!packMonomial(exponents, count, result->monomials + i)) {
+            result->count = i;
+            freePolynomial(result);
+            return NULL;
+        }
+        initBigInt(result->coefficients + i);
+        bigIntCopy(result->coefficients + i, polynomial->coefficients + i);
+        result->count = i + 1;
+    }
+    bigIntCopy(&result->denominator, &polynomial->denominator);
+    return result;
+}
+
+/**
+ * Bring two polynomials to the union of their variables, copying only the ones that need it.
+ * @return false if there are too many variables or an exponent does not fit.
+ */
+static bool alignVariables(const Polynomial *a, const Polynomial *b, const Polynomial **alignedA,
+                           const Polynomial **alignedB, Polynomial **copies) {
+    uint32_t variables[2 * POLY_MAX_VARIABLES], count = 0, i = 0, j = 0;
+    while (i < a->variableCount || j < b->variableCount) {
+        if (j == b->variableCount || (i < a->variableCount && a->variables[i] < b->variables[j])) {
+            variables[count++] = a->variables[i++];
+        } else if (i == a->variableCount || b->variables[j] < a->variables[i]) {
+            variables[count++] = b->variables[j++];
+        } else {
+            variables[count++] = a->variables[i++];
+            j++;
+        }
+    }
+    copies[0] = copies[1] = NULL;
+    if (count > POLY_MAX_VARIABLES) {
+        return false;
+    }
+    *alignedA = a;
+    *alignedB = b;
+    if (a->variableCount != count) {
+        *alignedA = copies[0] = repack(a, variables, count);
+    }
+    if (b->variableCount != count) {
+        *alignedB = copies[1] = repack(b, variables, count);
+    }
+    return *alignedA != NULL && *alignedB != NULL;
+}
+
+static bool isUnit(const BigInt *integer) {
+    return integer->size == 1 && integer->limbs[0] == 1;
+}
+
+bool polynomialAlign(const Polynomial *a, const Polynomial *b, Polynomial **alignedA, Polynomial **alignedB) {
+    const Polynomial *x, *y;
+    Polynomial *copies[2];
+    if (!alignVariables(a, b, &x, &y, copies)) {
+        freePolynomial(copies[0]);
+        freePolynomial(copies[1]);
+        return false;
+    }
+    *alignedA = copies[0] != NULL ? copies[0] : copyPolynomial(a);
+    *alignedB = copies[1] != NULL ? copies[1] : copyPolynomial(b);
+    return true;
+}
+
+/**
+ * Divide the coefficients and the denominator by their common factor.
+ */
+static void normaliseContent(Polynomial *polynomial) {
+    if (isUnit(&polynomial->denominator)) {
+        return;
+    }
+    BigInt divisor;
+    initBigInt(&divisor);
+    bigIntCopy(&divisor, &polynomial->denominator);
+    size_t i;
+    for (i = 0; i < polynomial->count && !isUnit(&divisor); i++) {
+        bigIntGcd(&divisor, &divisor, polynomial->coefficients + i);
+    }
+    if (!isUnit(&divisor)) {
+        for (i = 0; i < polynomial->count; i++) {
+            bigIntDivideExact(polynomial->coefficients + i, polynomial->coefficients + i, &divisor);
+        }
+        bigIntDivideExact(&polynomial->denominator, &polynomial->denominator, &divisor);
+    }
+    freeBigInt(&divisor);
+}
+
+static Polynomial *addScaled(const Polynomial *a, const Polynomial *b, bool subtract) {
+    const Polynomial *x, *y;
+    Polynomial *copies[2];
+    if (!alignVariables(a, b, &x, &y, copies)) {
+        freePolynomial(copies[0]);
+        freePolynomial(copies[1]);
+        return NULL;
+    }
+    Polynomial *result = emptyLike(x);
+    BigInt scaleX, scaleY, term, divisor;
+    initBigInt(&scaleX);
+    initBigInt(&scaleY);
+    initBigInt(&term);
+    initBigInt(&divisor);
+    bigIntGcd(&divisor, &x->denominator, &y->denominator); // Over the least common multiple.
+    bigIntDivideExact(&scaleX, &y->denominator, &divisor);
+    bigIntDivideExact(&scaleY, &x->denominator, &divisor);
+    bigIntMultiply(&result->denominator, &x->denominator, &scaleX);
+    if (subtract) {
+        bigIntNegate(&scaleY, &scaleY);
+    }
+    size_t i = 0, j = 0;
+    reserveTerms(result, x->count + y->count);
+    while (i < x->count || j < y->count) {
+        if (j == y->count || (i < x->count && x->monomials[i] > y->monomials[j])) {
+            bigIntMultiply(&term, x->coefficients + i, &scaleX);
+            polynomialAppendTerm(result, x->monomials[i++], &term);
+        } else if (i == x->count || y->monomials[j] > x->monomials[i]) {
+            bigIntMultiply(&term, y->coefficients + j, &scaleY);
+            polynomialAppendTerm(result, y->monomials[j++], &term);
+        } else {
+            bigIntMultiply(&term, x->coefficients + i, &scaleX);
+            bigIntMultiply(&divisor, y->coefficients + j++, &scaleY);
+            bigIntAdd(&term, &term, &divisor);
+            polynomialAppendTerm(result, x->monomials[i++], &term);
+        }
+    }
+    normaliseContent(result); // Equal denominators may share a factor with the sums too.
+    freeBigInt(&divisor);
+    freeBigInt(&term);
+    freeBigInt(&scaleY);
+    freeBigInt(&scaleX);
+    freePolynomial(copies[0]);
+    freePolynomial(copies[1]);
+    return result;
+}
+
+Polynomial *polynomialAdd(const Polynomial *a, const Polynomial *b) {
+    return addScaled(a, b, false);
+}
+
+Polynomial *polynomialSubtract(const Polynomial *a, const Polynomial *b) {
+    return addScaled(a, b, true);
+}
+
+/**
+ * Multiply term by term, merging the rows a_i b by a heap on their next monomial, Johnson's algorithm.
+ */
+static void multiplySparse(Polynomial *result, const Polynomial *a, const Polynomial *b) {
+    size_t *heap = (size_t *) malloc(sizeof(size_t) * a->count), *next = (size_t *) calloc(a->count, sizeof(size_t));
+    size_t heapCount = 0, i;
+    BigInt sum, product;
+    initBigInt(&sum);
+    initBigInt(&product);
+#define HEAP_KEY(row) (a->monomials[row] + b->monomials[next[row]])
+    for (i = 0; i < a->count; i++) { // Rows start sorted by their first monomial, a valid heap.
+        heap[heapCount++] = i;
+    }
+    uint64_t current = 0;
+    bool started = false;
+    while (heapCount > 0) {
+        size_t row = heap[0];
+        uint64_t key = HEAP_KEY(row);
+        if (started && key != current) {
+            polynomialAppendTerm(result, current, &sum);
+        }
+        current = key;
+        started = true;
+        bigIntMultiply(&product, a->coefficients + row, b->coefficients + next[row]);
+        bigIntAdd(&sum, &sum, &product);
+        if (++next[row] == b->count) {
+            heap[0] = heap[--heapCount];
+        }
+        size_t parent = 0;
+        while (heapCount > 0) { // Sift down.
+            size_t child = 2 * parent + 1, largest = parent;
+            if (child < heapCount && HEAP_KEY(heap[child]) > HEAP_KEY(heap[largest])) {
+                largest = child;
+            }
+            if (child + 1 < heapCount && HEAP_KEY(heap[child + 1]) > HEAP_KEY(heap[largest])) {
+                largest = child + 1;
+            }
+            if (largest == parent) {
+                break;
+            }
+            size_t swap = heap[parent];
+            heap[parent] = heap[largest];
+            heap[largest] = swap;
+            parent = largest;
+        }
+    }
+#undef HEAP_KEY
+    if (started) {
+        polynomialAppendTerm(result, current, &sum);
+    }
+    freeBigInt(&product);
+    freeBigInt(&sum);
+    free(next);
+    free(heap);
+}
+
+/**
+ * Multiply as coefficient arrays, a monomial maps to the index
+ * sum e_v stride_v, so the map is a ring homomorphism for the product.
+ */
+static void multiplyDense(Polynomial *result, const Polynomial *a, const Polynomial *b, const uint64_t *strides) {
+    uint32_t count = a->variableCount, v;
+    size_t aLength = 0, bLength = 0, i;
+    size_t *aIndices = (size_t *) malloc(sizeof(size_t) * (a->count + b->count)), *bIndices = aIndices + a->count;
+    for (i = 0; i < a->count + b->count; i++) {
+        const Polynomial *p = i < a->count ? a : b;
+        uint64_t monomial = p->monomials[i < a->count ? i : i - a->count], index = 0;
+        for (v = 0; v < count; v++) {
+            index += monomialExponent(monomial, count, v) * strides[v];
+        }
+        aIndices[i] = (size_t) index;
+    }
+    aLength = a->count ? aIndices[0] + 1 : 0; // The first term has the largest index.
+    bLength = b->count ? bIndices[0] + 1 : 0;
+    BigInt *x = (BigInt *) calloc(aLength + bLength, sizeof(BigInt)), *y = x + aLength;
+    for (i = 0; i < a->count; i++) {
+        x[aIndices[i]] = a->coefficients[i]; // Borrowed, the kernel only reads them.
+    }
+    for (i = 0; i < b->count; i++) {
+        y[bIndices[i]] = b->coefficients[i];
+    }
+    size_t productLength = aLength + bLength - 1;
+    BigInt *product = newIntegers(productLength);
+    polyMultiplyDense(product, x, aLength, a == b ? x : y, a == b ? aLength : bLength, POLY_MULTIPLY_AUTO);
+    uint64_t exponents[POLY_MAX_VARIABLES], monomial = 0;
+    for (i = productLength; i-- > 0;) {
+        if (bigIntIsZero(product + i)) {
+            continue;
+        }
+        size_t index = i;
+        for (v = 0; v < count; v++) {
+            exponents[v] = index / strides[v];
+            index %= strides[v];
+        }
+        packMonomial(exponents, count, &monomial);
+        polynomialAppendTerm(result, monomial, product + i);
+    }
+    freeIntegers(product, productLength);
+    free(x);
+    free(aIndices);
+}
+
+Polynomial *polynomialMultiply(const Polynomial *a, const Polynomial *b) {
+    const Polynomial *x, *y;
+    Polynomial *copies[2];
+    if (!alignVariables(a, b, &x, &y, copies)) {
+        freePolynomial(copies[0]);
+        freePolynomial(copies[1]);
+        return NULL;
+    }
+    if (a == b) {
+        y = x;
+    }
+    uint32_t count = x->variableCount, v;
+    uint64_t degreesX[POLY_MAX_VARIABLES], degreesY[POLY_MAX_VARIABLES], strides[POLY_MAX_VARIABLES];
+    maxExponents(x, degreesX);
+    maxExponents(y, degreesY);
+    double length = 1; // Of the dense product, as a double so it cannot overflow.
+    for (v = count; v-- > 0;) {
+        if (degreesX[v] > monomialFieldMax(count) - degreesY[v] || degreesX[v] + degreesY[v] >= POLY_MAX_DENSE * 64ull) {
+            freePolynomial(copies[0]);
+            freePolynomial(copies[1]);
+            return NULL;
+        }
+        strides[v] = (uint64_t) length;
+        length *= (double) (degreesX[v] + degreesY[v] + 1);
+    }
+    Polynomial *result = emptyLike(x);
+    bigIntMultiply(&result->denominator, &x->denominator, &y->denominator);
+    if (x->count > 0 && y->count > 0) {
+        if (length <= POLY_MAX_DENSE && length <= 64 + 8.0 * (double) (x->count + y->count)) {
+            multiplyDense(result, x, y, strides);
+        } else {
+            multiplySparse(result, x, y);
+        }
+    }
+    normaliseContent(result);
+    freePolynomial(copies[0]);
+    freePolynomial(copies[1]);
+    return result;
+}
+
+Polynomial *polynomialPower(const Polynomial *base, uint64_t exponent) {
+    Polynomial *result = emptyLike(base), *square = NULL;
+    BigInt one;
+    initBigInt(&one);
+    bigIntSetInt64(&one, 1);
+    polynomialAppendTerm(result, 0, &one);
+    const Polynomial *current = base;
+    while (exponent > 0 && result != NULL) {
+        if (exponent & 1) {
+            Polynomial *product = polynomialMultiply(result, current);
+            freePolynomial(result);
+            result = product;
+        }
+        exponent >>= 1;
+        if (exponent > 0 && result != NULL) {
+            Polynomial *next = polynomialMultiply(current, current);
+            freePolynomial(square);
+            current = square = next;
+            if (next == NULL) {
+                freePolynomial(result);
+                result = NULL;
+            }
+        }
+    }
+    freePolynomial(square);
+    return result;
+}
+
+bool polynomialEqual(const Polynomial *a, const Polynomial *b) {
+    const Polynomial *x, *y;
+    Polynomial *copies[2];
+    bool equal = alignVariables(a, b, &x, &y, copies) && x->count == y->count &&
+                 bigIntCompare(&x->denominator, &y->denominator) == 0;
+    size_t i;
+    for (i = 0; equal && i < x->count; i++) {
+        equal = x->monomials[i] == y->monomials[i] && bigIntCompare(x->coefficients + i, y->coefficients + i) == 0;
+    }
+    freePolynomial(copies[0]);
+    freePolynomial(copies[1]);
+    return equal;
+}
+
+Polynomial *polynomialFromNumber(Number number) {
+    Polynomial *polynomial = initPolynomial();
+    BigInt value;
+    initBigInt(&value);
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            bigIntSetInt64(&value, numberSmallValue(number));
+            break;
+        case NUMBER_BIG:
+            bigIntCopy(&value, &numberObject(number)->as.integer);
+            break;
+        case NUMBER_RATIONAL:
+            bigIntCopy(&value, &numberObject(number)->as.rational.numerator);
+            bigIntCopy(&polynomial->denominator, &numberObject(number)->as.rational.denominator);
+            break;
+        default:
+            freePolynomial(polynomial);
+            return NULL;
+    }
+    polynomialAppendTerm(polynomial, 0, &value);
+    return polynomial;
+}
+
+/**
+ * The value of a constant polynomial as a non negative integer.
+ * @return false if it is not one or is above limit.
+ */
+static bool constantExponent(const Polynomial *polynomial, uint64_t limit, uint64_t *exponent) {
+    if (polynomial->count == 0) {
+        *exponent = 0;
+        return true;
+    }
+    if (polynomial->count != 1 || polynomial->monomials[0] != 0 || !isUnit(&polynomial->denominator) ||
+        polynomial->coefficients[0].negative || !bigIntFitsInt64(polynomial->coefficients)) {
+        return false;
+    }
+    *exponent = (uint64_t) bigIntToInt64(polynomial->coefficients);
+    return *exponent <= limit;
+}
+
+static bool isConstant(const Polynomial *polynomial) {
+    return polynomial->count == 0 || (polynomial->count == 1 && polynomial->monomials[0] == 0);
+}
+
+/**
+ * Polynomial of an operator node, given the polynomials of its children.
+ */
+static Polynomial *polynomialStep(const NodePool *pool, NodeId node, const NodeSubtree *subtree,
+                                  Polynomial *const *values) {
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER) {
+        return polynomialFromNumber(nodeNumberOf(pool, node));
+    }
+    if (tag == NODE_SYMBOL) {
+        Polynomial *polynomial = initPolynomial();
+        BigInt one;
+        initBigInt(&one);
+        bigIntSetInt64(&one, 1);
+        polynomial->variableCount = 1;
+        polynomial->variables[0] = nodeSymbolOf(pool, node);
+        polynomialAppendTerm(polynomial, 1, &one);
+        return polynomial;
+    }
+    if (!nodeIsOperator(pool, node)) {
+        return NULL;
+    }
+    const Polynomial *a = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 0))];
+    if (a == NULL) {
+        return NULL;
+    }
+    if (nodeChildCount(pool, node) == 1) {
+        if (tag == PLUS) {
+            return copyPolynomial(a);
+        }
+        if (tag == MINUS) {
+            Polynomial *zero = emptyLike(a), *negated = polynomialSubtract(zero, a);
+            freePolynomial(zero);
+            return negated;
+        }
+        return NULL;
+    }
+    const Polynomial *b = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 1))];
+    if (b == NULL) {
+        return NULL;
+    }
+    uint64_t exponent;
+    switch ((OperatorType) tag) {
+        case PLUS:
+            return polynomialAdd(a, b);
+        case MINUS:
+            return polynomialSubtract(a, b);
+        case MULTIPLY:
+            return polynomialMultiply(a, b);
+        case DIVIDE: {
+            if (!isConstant(b) || b->count == 0) {
+                return NULL;
+            }
+            Polynomial *reciprocal = initPolynomial();
+            BigInt numerator;
+            initBigInt(&numerator);
+            bigIntCopy(&numerator, &b->denominator);
+            bigIntAbs(&reciprocal->denominator, b->coefficients);
+            if (b->coefficients[0].negative) {
+                bigIntNegate(&numerator, &numerator);
+            }
+            polynomialAppendTerm(reciprocal, 0, &numerator);
+            Polynomial *quotient = polynomialMultiply(a, reciprocal);
+            freePolynomial(reciprocal);
+            return quotient;
+        }
+        case POWER:
+            if (!constantExponent(b, POLY_MAX_DENSE, &exponent)) {
+                return NULL;
+            }
+            return polynomialPower(a, exponent);
+        default:
+            return NULL;
+    }
+}
+
+Polynomial *polynomialFromNode(const NodePool *pool, NodeId node) {
+    if (node == NODE_NONE) {
+        return NULL;
+    }
+    NodeSubtree subtree; // Children before their parents, so each is converted after its children.
+    initNodeSubtree(&subtree, pool, node, false);
+    Polynomial **values = (Polynomial **) malloc(sizeof(Polynomial *) * subtree.count);
+    Polynomial *result = NULL; // The root, which comes last.
+    uint32_t i;
+    for (i = 0; i < subtree.count; i++) {
+        result = values[i] = polynomialStep(pool, subtree.nodes[i], &subtree, values);
+    }
+    for (i = 0; i + 1 < subtree.count; i++) {
+        freePolynomial(values[i]);
+    }
+    free(values);
+    freeNodeSubtree(&subtree);
+    return result;
+}
+
+NodeId polynomialToNode(NodePool *pool, const Polynomial *polynomial, int lineCount) {
+    if (polynomial->count == 0) {
+        return nodeExactNumber(pool, lineCount, numberFromSmall(0));
+    }
+    NodeId sum = NODE_NONE;
+    BigInt numerator, denominator;
+    initBigInt(&numerator);
+    initBigInt(&denominator);
+    size_t i;
+    for (i = 0; i < polynomial->count; i++) {
+        NodeId term = NODE_NONE;
+        uint32_t v;
+        for (v = 0; v < polynomial->variableCount; v++) {
+            uint64_t exponent = monomialExponent(polynomial->monomials[i], polynomial->variableCount, v);
+            if (exponent == 0) {
+                continue;
+            }
+            NodeId factor = nodeSymbolIndex(pool, lineCount, polynomial->variables[v]);
+            if (exponent > 1) {
+                NodeId power = nodeExactNumber(pool, lineCount, numberFromInt64((int64_t) exponent));
+                factor = nodeBinary(pool, lineCount, POWER, factor, power);
+            }
+            term = term == NODE_NONE ? factor : nodeBinary(pool, lineCount, MULTIPLY, term, factor);
+        }
+        bool negative = polynomial->coefficients[i].negative && sum != NODE_NONE; // The first term keeps its sign.
+        if (negative) {
+            bigIntNegate(&numerator, polynomial->coefficients + i);
+        } else {
+            bigIntCopy(&numerator, polynomial->coefficients + i);
+        }
+        bigIntCopy(&denominator, &polynomial->denominator);
+        Number coefficient = numberFromRational(&numerator, &denominator);
+        if (term == NODE_NONE) {
+            term = nodeExactNumber(pool, lineCount, coefficient);
+        } else if (numberCompare(coefficient, numberFromSmall(-1)) == 0) {
+            term = nodeUnary(pool, lineCount, MINUS, term);
+        } else if (numberCompare(coefficient, numberFromSmall(1)) != 0) {
+            term = nodeBinary(pool, lineCount, MULTIPLY, nodeExactNumber(pool, lineCount, coefficient), term);
+        }
+        sum = sum == NODE_NONE ? term : nodeBinary(pool, lineCount, negative ? MINUS : PLUS, sum, term);
+    }
+    freeBigInt(&denominator);
+    freeBigInt(&numerator);
+    return sum;
+}
+
+NodeId expandPolynomialNode(NodePool *pool, NodeId node) {
+    Polynomial *polynomial = polynomialFromNode(pool, node);
+    if (polynomial == NULL) {
+        return node;
+    }
+    NodeId expanded = polynomialToNode(pool, polynomial, nodeLine(pool, node));
+    freePolynomial(polynomial);
+    return expanded;
+}
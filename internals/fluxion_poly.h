@@ -0,0 +1,140 @@
+//
+// Polynomials with rational coefficients in packed form, and fast multiplication.
+//
+
+#ifndef FLUXIONCORE_FLUXION_POLY_H
+#define FLUXIONCORE_FLUXION_POLY_H
+#include "fluxion_bigint.h"
+#include "fluxion_node.h"
+
+#define POLY_MAX_VARIABLES 8
+#define POLY_MAX_DENSE 67108864 // Longest coefficient array the dense kernels are given.
+#define POLY_KARATSUBA_THRESHOLD 24 // Shorter operands are multiplied by schoolbook, longer above a word by NTT.
+#define POLY_NTT_THRESHOLD 64 // Operands of word coefficients at least this long are multiplied by NTT.
+#define POLY_NTT_MAX_PRIMES 256 // Karatsuba is used when the product needs more primes, above 15000 bits.
+
+/**
+ * Multiplication algorithms of the dense kernel.
+ */
+typedef enum {
+    POLY_MULTIPLY_AUTO, // Chosen by length and coefficient size.
+    POLY_MULTIPLY_SCHOOLBOOK,
+    POLY_MULTIPLY_KARATSUBA,
+    POLY_MULTIPLY_NTT // Number theoretic transforms modulo primes below 2^62, joined by the CRT.
+} PolyMultiplyAlgorithm;
+
+/**
+ * Multiply dense coefficient arrays, lowest degree first.
+ * @param result aCount + bCount - 1 initialised integers, overwritten. Must not overlap a or b.
+ * @param algorithm Algorithm to use, POLY_MULTIPLY_AUTO to choose.
+ */
+void polyMultiplyDense(BigInt *result, const BigInt *a, size_t aCount, const BigInt *b, size_t bCount,
+                       PolyMultiplyAlgorithm algorithm);
+
+/**
+ * A polynomial in up to POLY_MAX_VARIABLES variables with rational coefficients,
+ * stored as integer coefficients over a common denominator.
+ * A term's exponents are packed into a word, the first variable in the
+ * highest bits, so comparing words orders terms lexicographically and
+ * multiplying terms adds words. Terms are in decreasing order.
+ */
+typedef struct {
+    uint32_t variableCount;
+    uint32_t variables[POLY_MAX_VARIABLES]; // Symbols of the node pool, increasing.
+    size_t count; // Terms.
+    size_t capacity;
+    uint64_t *monomials; // Packed exponents of each term.
+    BigInt *coefficients; // Never zero.
+    BigInt denominator; // Positive and coprime with the coefficients together.
+} Polynomial;
+
+/**
+ * Bits of an exponent field when packing count variables.
+ */
+static inline uint32_t monomialFieldBits(uint32_t count) {
+    return count > 1 ? 64 / count : 64;
+}
+
+static inline uint64_t monomialFieldMax(uint32_t count) {
+    return count > 1 ? ((uint64_t) 1 << monomialFieldBits(count)) - 1 : UINT64_MAX;
+}
+
+/**
+ * Shift of the field of the variable at index, the first variable is in the highest bits.
+ */
+static inline uint32_t monomialFieldShift(uint32_t count, uint32_t index) {
+    return count > 1 ? (count - 1 - index) * monomialFieldBits(count) : 0;
+}
+
+static inline uint64_t monomialExponent(uint64_t monomial, uint32_t count, uint32_t index) {
+    return monomial >> monomialFieldShift(count, index) & monomialFieldMax(count);
+}
+
+/**
+ * Create the zero polynomial.
+ */
+Polynomial *initPolynomial(void);
+/**
+ * An empty polynomial in the variables of another.
+ */
+Polynomial *emptyLike(const Polynomial *polynomial);
+void freePolynomial(Polynomial *polynomial);
+Polynomial *copyPolynomial(const Polynomial *polynomial);
+/**
+ * Append a term below every term so far, taking its coefficient. Zero coefficients are freed and dropped.
+ */
+void polynomialAppendTerm(Polynomial *polynomial, uint64_t monomial, BigInt *coefficient);
+/**
+ * Create a polynomial in one variable from dense integer coefficients, lowest degree first.
+ * @param variable Symbol of the variable.
+ */
+Polynomial *polynomialFromDense(uint32_t variable, const BigInt *coefficients, size_t count);
+/**
+ * Create a constant polynomial.
+ * @return the polynomial, NULL for floats and errors.
+ */
+Polynomial *polynomialFromNumber(Number number);
+/**
+ * Exponent of a variable in a term.
+ */
+uint32_t polynomialExponent(const Polynomial *polynomial, size_t term, uint32_t variable);
+/**
+ * Highest exponent of a variable, 0 if it does not occur, -1 for the zero polynomial.
+ */
+int64_t polynomialDegree(const Polynomial *polynomial, uint32_t variable);
+bool polynomialEqual(const Polynomial *a, const Polynomial *b);
+/**
+ * Copy two polynomials into the union of their variables.
+ * @return false if there are too many variables or an exponent does not fit, nothing is created then.
+ */
+bool polynomialAlign(const Polynomial *a, const Polynomial *b, Polynomial **alignedA, Polynomial **alignedB);
+
+/*
+ * Arithmetic, the result is a new polynomial, NULL if an exponent grows past what a term can pack.
+ */
+Polynomial *polynomialAdd(const Polynomial *a, const Polynomial *b);
+Polynomial *polynomialSubtract(const Polynomial *a, const Polynomial *b);
+/**
+ * Multiply. Products that are dense enough are multiplied as coefficient arrays,
+ * several variables by Kronecker substitution, sparse ones term by term with a heap.
+ */
+Polynomial *polynomialMultiply(const Polynomial *a, const Polynomial *b);
+Polynomial *polynomialPower(const Polynomial *base, uint64_t exponent);
+
+/**
+ * Convert an expression to a polynomial. Sums, differences, products, division
+ * by numbers and powers to integer numbers of exact numbers and symbols are.
+ * @return the polynomial, NULL if the expression is not one.
+ */
+Polynomial *polynomialFromNode(const NodePool *pool, NodeId node);
+/**
+ * Convert a polynomial back to an expression, a sum of terms in decreasing order.
+ */
+NodeId polynomialToNode(NodePool *pool, const Polynomial *polynomial, int lineCount);
+/**
+ * Expand an expression that is a polynomial.
+ * @return the expanded node, node itself if it is not a polynomial.
+ */
+NodeId expandPolynomialNode(NodePool *pool, NodeId node);
+
+#endif //FLUXIONCORE_FLUXION_POLY_H
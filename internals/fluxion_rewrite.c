@@ -0,0 +1,697 @@
+//
+// Term rewriting of expression nodes, rules are dispatched by a discrimination tree.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "fluxion_rewrite.h"
+#include "fluxion_parser.h"
+
+#define TREE_NONE UINT32_MAX
+#define NORMAL_PENDING (NODE_NONE - 1) // Normal form being looked for, seeing it again means the rules cycle.
+
+#define KEY_WILDCARD 0 // A pattern variable, matches any subexpression.
+#define KEY_ATOM 1 // A number or a symbol, keyed by node id since nodes are hash consed.
+#define KEY_OPERATOR 2
+#define KEY_CALL 3
+
+static const char *builtinRules =
+        "x + 0 = x\n"
+        "0 + x = x\n"
+        "x - 0 = x\n"
+        "0 - x = -x\n"
+        "x - x = 0\n"
+        "x * 1 = x\n"
+        "1 * x = x\n"
+        "x * 0 = 0\n"
+        "0 * x = 0\n"
+        "x / 1 = x\n"
+        "x ^ 1 = x\n"
+        "x ^ 0 = 1\n"
+        "1 ^ x = 1\n"
+        "-(-x) = x\n"
+        "x + -y = x - y\n"
+        "x - -y = x + y\n"
+        "x + x = 2 * x\n"
+        "x * x = x ^ 2\n"
+        "x * x ^ n = x ^ (n + 1)\n"
+        "x ^ n * x = x ^ (n + 1)\n"
+        "x ^ m * x ^ n = x ^ (m + n)\n"
+        "exp(x) * exp(y) = exp(x + y)\n"
+        "log(exp(x)) = x\n"
+        "sqrt(x ^ 2) = abs(x)\n"
+        "sin(x) ^ 2 + cos(x) ^ 2 = 1\n"
+        "sin(0) = 0\n"
+        "cos(0) = 1\n"
+        "exp(0) = 1\n"
+        "log(1) = 0\n";
+
+static uint64_t makeKey(uint64_t kind, uint32_t count, uint32_t value) {
+    return kind << 56 | (uint64_t) count << 32 | value;
+}
+
+/**
+ * Key of a node as the tree sees it, calls are keyed by their function and
+ * argument count, the function symbol is not a child of its own.
+ */
+static uint64_t termKey(const NodePool *pool, NodeId node) {
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER || tag == NODE_SYMBOL) {
+        return makeKey(KEY_ATOM, 0, node);
+    }
+    if (tag == NODE_CALL) {
+        return makeKey(KEY_CALL, nodeChildCount(pool, node) - 1, nodeSymbolOf(pool, nodeChild(pool, node, 0)));
+    }
+    return makeKey(KEY_OPERATOR, nodeChildCount(pool, node), tag);
+}
+
+/**
+ * Children the tree descends into, [first, end). Atoms have none.
+ */
+static uint32_t childrenOf(const NodePool *pool, NodeId node, uint32_t *first) {
+    uint8_t tag = nodeTag(pool, node);
+    *first = tag == NODE_CALL;
+    return tag == NODE_NUMBER || tag == NODE_SYMBOL ? 0 : nodeChildCount(pool, node);
+}
+
+static bool isPatternVariable(const NodePool *pool, NodeId node) {
+    return nodeTag(pool, node) == NODE_SYMBOL && nodeSymbolOf(pool, node) >= BUILTIN_SYMBOL_COUNT;
+}
+
+/**
+ * Slot of a pattern variable in a rule, UINT32_MAX if it is not one.
+ */
+static uint32_t variableSlot(const RewriteRule *rule, uint32_t symbol) {
+    uint32_t i;
+    for (i = 0; i < rule->variableCount; i++) {
+        if (rule->variables[i] == symbol) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+static RewriteEngine *createEngine(NodePool *pool) {
+    RewriteEngine *engine = (RewriteEngine *) calloc(1, sizeof(RewriteEngine));
+    engine->pool = pool;
+    engine->treeCapacity = 64;
+    engine->tree = (RewriteTreeNode *) malloc(sizeof(RewriteTreeNode) * engine->treeCapacity);
+    engine->tree[0] = (RewriteTreeNode) {KEY_WILDCARD, TREE_NONE, TREE_NONE, TREE_NONE};
+    engine->treeCount = 1;
+    return engine;
+}
+
+RewriteEngine *initEmptyRewriteEngine(NodePool *pool) {
+    return createEngine(pool);
+}
+
+RewriteEngine *initRewriteEngine(NodePool *pool) {
+    RewriteEngine *engine = createEngine(pool);
+    addRewriteRules(engine, builtinRules);
+    return engine;
+}
+
+void freeRewriteEngine(RewriteEngine *engine) {
+    free(engine->rules);
+    free(engine->tree);
+    free(engine->treeIndex);
+    free(engine->normalForms);
+    free(engine->candidateBuffer);
+    free(engine->pending);
+    free(engine->frames);
+    freeFactorialCache(engine->factorials);
+    free(engine);
+}
+
+/**
+ * Flatten the left side of a rule in preorder, numbering its pattern variables.
+ * @return false if it has too many nodes or variables.
+ */
+static bool flattenPattern(const NodePool *pool, NodeId node, RewriteRule *rule, uint64_t *keys, uint32_t *count) {
+    if (*count == REWRITE_MAX_PATTERN) {
+        return false;
+    }
+    if (isPatternVariable(pool, node)) {
+        uint32_t symbol = nodeSymbolOf(pool, node);
+        if (variableSlot(rule, symbol) == UINT32_MAX) {
+            if (rule->variableCount == REWRITE_MAX_VARIABLES) {
+                return false;
+            }
+            rule->variables[rule->variableCount++] = symbol;
+        }
+        keys[(*count)++] = KEY_WILDCARD;
+        return true;
+    }
+    keys[(*count)++] = termKey(pool, node);
+    uint32_t first, end = childrenOf(pool, node, &first), i;
+    for (i = first; i < end; i++) {
+        if (!flattenPattern(pool, nodeChild(pool, node, i), rule, keys, count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t treeSlot(uint32_t parent, uint64_t key, uint32_t capacity) {
+    uint64_t hash = (key ^ (uint64_t) parent * 0x9E3779B97F4A7C15ull) * 0xBF58476D1CE4E5B9ull;
+    return (uint32_t) (hash >> 32) & (capacity - 1);
+}
+
+/**
+ * Keyed child of a tree node.
+ * @return the child, TREE_NONE if there is none.
+ */
+static uint32_t findTreeChild(const RewriteEngine *engine, uint32_t parent, uint64_t key) {
+    if (engine->treeIndexCapacity == 0) {
+        return TREE_NONE;
+    }
+    uint32_t mask = engine->treeIndexCapacity - 1, slot = treeSlot(parent, key, engine->treeIndexCapacity);
+    while (engine->treeIndex[slot] != 0) {
+        const RewriteTreeNode *child = engine->tree + engine->treeIndex[slot] - 1;
+        if (child->parent == parent && child->key == key) {
+            return engine->treeIndex[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return TREE_NONE;
+}
+
+static void indexTreeNode(uint32_t *index, uint32_t capacity, const RewriteTreeNode *tree, uint32_t node) {
+    uint32_t slot = treeSlot(tree[node].parent, tree[node].key, capacity);
+    while (index[slot] != 0) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    index[slot] = node + 1;
+}
+
+/**
+ * Child of a tree node with a key, created if there is none.
+ */
+static uint32_t treeChild(RewriteEngine *engine, uint32_t parent, uint64_t key) {
+    uint32_t child = key == KEY_WILDCARD ? engine->tree[parent].wildcard : findTreeChild(engine, parent, key);
+    if (child != TREE_NONE) {
+        return child;
+    }
+    if (engine->treeCount == engine->treeCapacity) {
+        engine->treeCapacity *= 2;
+        engine->tree = (RewriteTreeNode *) realloc(engine->tree, sizeof(RewriteTreeNode) * engine->treeCapacity);
+    }
+    child = engine->treeCount++;
+    engine->tree[child] = (RewriteTreeNode) {key, parent, TREE_NONE, TREE_NONE};
+    if (key == KEY_WILDCARD) {
+        engine->tree[parent].wildcard = child;
+        return child;
+    }
+    if (engine->treeCount * 2 > engine->treeIndexCapacity) { // Keep the load under a half.
+        uint32_t capacity = engine->treeIndexCapacity ? engine->treeIndexCapacity * 2 : 64, node;
+        free(engine->treeIndex);
+        engine->treeIndex = (uint32_t *) calloc(capacity, sizeof(uint32_t));
+        engine->treeIndexCapacity = capacity;
+        for (node = 1; node < engine->treeCount; node++) {
+            if (engine->tree[node].key != KEY_WILDCARD) {
+                indexTreeNode(engine->treeIndex, capacity, engine->tree, node);
+            }
+        }
+    } else {
+        indexTreeNode(engine->treeIndex, engine->treeIndexCapacity, engine->tree, child);
+    }
+    return child;
+}
+
+uint32_t addRewriteRule(RewriteEngine *engine, NodeId left, NodeId right) {
+    if (left == NODE_NONE || right == NODE_NONE || isPatternVariable(engine->pool, left)) {
+        return UINT32_MAX;
+    }
+    RewriteRule rule = {left, right, {0}, 0, TREE_NONE, 0, 0};
+    uint64_t keys[REWRITE_MAX_PATTERN];
+    uint32_t count = 0, i;
+    if (!flattenPattern(engine->pool, left, &rule, keys, &count)) {
+        return UINT32_MAX;
+    }
+    if (engine->ruleCount == engine->ruleCapacity) {
+        engine->ruleCapacity = engine->ruleCapacity ? engine->ruleCapacity * 2 : 32;
+        engine->rules = (RewriteRule *) realloc(engine->rules, sizeof(RewriteRule) * engine->ruleCapacity);
+    }
+    uint32_t index = engine->ruleCount++, leaf = 0;
+    engine->rules[index] = rule;
+    for (i = 0; i < count; i++) {
+        leaf = treeChild(engine, leaf, keys[i]);
+    }
+    uint32_t *last = &engine->tree[leaf].rules; // Keep the rules of a leaf in the order they were added.
+    while (*last != TREE_NONE) {
+        last = &engine->rules[*last].next;
+    }
+    *last = index;
+    if (engine->normalForms != NULL) { // Normal forms may not be normal under the new rule.
+        memset(engine->normalForms, 0xFF, sizeof(NodeId) * engine->normalCapacity);
+    }
+    return index;
+}
+
+uint32_t addRewriteRuleToken(RewriteEngine *engine, const Token *token) {
+    while (token != NULL && token->tokenType == EXPRESSION) {
+        token = ((const ExpressionToken *) token)->root;
+    }
+    if (token == NULL || token->tokenType != OPERATOR) {
+        return UINT32_MAX;
+    }
+    const OperatorToken *operator = (const OperatorToken *) token;
+    if ((operator->operatorType != EQUAL && operator->operatorType != ASSIGN) ||
+        operator->left == NULL || operator->right == NULL) {
+        return UINT32_MAX;
+    }
+    NodeId left = nodeFromToken(engine->pool, operator->left);
+    return addRewriteRule(engine, left, nodeFromToken(engine->pool, operator->right));
+}
+
+uint32_t addRewriteRules(RewriteEngine *engine, const char *source) {
+    Parser *parser = parse(source);
+    Token **tokens = getTokens(parser);
+    uint32_t added = 0;
+    int i;
+    for (i = 0; i < getTokenCount(parser); i++) {
+        added += addRewriteRuleToken(engine, tokens[i]) != UINT32_MAX;
+    }
+    freeParser(parser);
+    return added;
+}
+
+/**
+ * Collect the rules whose left side may match the pending subexpressions,
+ * following both the exact key and the wildcard down the tree, into the
+ * engine's candidate buffer.
+ * @param pending Subexpressions left to match, the next on top.
+ * @param candidateCount Candidates in the buffer, updated.
+ */
+static void collectCandidates(RewriteEngine *engine, uint32_t treeNode, const NodeId *pending,
+                              uint32_t pendingCount, uint32_t *candidateCount) {
+    const NodePool *pool = engine->pool;
+    if (pendingCount == 0) {
+        uint32_t rule;
+        for (rule = engine->tree[treeNode].rules; rule != TREE_NONE; rule = engine->rules[rule].next) {
+            if (*candidateCount == engine->candidateCapacity) {
+                engine->candidateCapacity = engine->candidateCapacity ? engine->candidateCapacity * 2 : 64;
+                engine->candidateBuffer = (uint32_t *) realloc(engine->candidateBuffer,
+                                                               sizeof(uint32_t) * engine->candidateCapacity);
+            }
+            engine->candidateBuffer[(*candidateCount)++] = rule;
+        }
+        return;
+    }
+    uint32_t wildcard = engine->tree[treeNode].wildcard;
+    if (wildcard != TREE_NONE) {
+        collectCandidates(engine, wildcard, pending, pendingCount - 1, candidateCount);
+    }
+    NodeId term = pending[pendingCount - 1];
+    uint32_t child = findTreeChild(engine, treeNode, termKey(pool, term));
+    if (child == TREE_NONE) {
+        return;
+    }
+    NodeId next[REWRITE_MAX_PATTERN + 1];
+    uint32_t first, count = childrenOf(pool, term, &first), nextCount = pendingCount - 1, i;
+    if (nextCount + (count > first ? count - first : 0) > REWRITE_MAX_PATTERN) {
+        return; // Longer than any left side.
+    }
+    memcpy(next, pending, sizeof(NodeId) * nextCount);
+    for (i = count; i-- > first;) {
+        next[nextCount++] = nodeChild(pool, term, i);
+    }
+    collectCandidates(engine, child, next, nextCount, candidateCount);
+}
+
+static int compareRuleIndexes(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Match a left side in full, binding its variables.
+ */
+static bool matchPattern(const NodePool *pool, const RewriteRule *rule, NodeId pattern, NodeId term, NodeId *bindings) {
+    if (isPatternVariable(pool, pattern)) {
+        uint32_t slot = variableSlot(rule, nodeSymbolOf(pool, pattern));
+        if (bindings[slot] == NODE_NONE) {
+            bindings[slot] = term;
+        }
+        return bindings[slot] == term; // Hash consed, equal subexpressions are the same node.
+    }
+    if (termKey(pool, pattern) != termKey(pool, term)) {
+        return false;
+    }
+    uint32_t first, end = childrenOf(pool, pattern, &first), i;
+    for (i = first; i < end; i++) {
+        if (!matchPattern(pool, rule, nodeChild(pool, pattern, i), nodeChild(pool, term, i), bindings)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * The right side of a rule with its variables replaced by their bindings.
+ */
+static NodeId instantiate(NodePool *pool, const RewriteRule *rule, NodeId node, const NodeId *bindings, int lineCount) {
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER) {
+        return node;
+    }
+    if (tag == NODE_SYMBOL) {
+        uint32_t slot = isPatternVariable(pool, node) ? variableSlot(rule, nodeSymbolOf(pool, node)) : UINT32_MAX;
+        return slot == UINT32_MAX ? node : bindings[slot];
+    }
+    uint32_t count = nodeChildCount(pool, node), first = tag == NODE_CALL, i;
+    NodeId stack[8];
+    NodeId *children = count <= 8 ? stack : (NodeId *) malloc(sizeof(NodeId) * count);
+    for (i = first; i < count; i++) {
+        children[i] = instantiate(pool, rule, nodeChild(pool, node, i), bindings, lineCount);
+    }
+    NodeId result = tag == NODE_CALL ? nodeCall(pool, lineCount, nodeSymbolOf(pool, nodeChild(pool, node, 0)),
+                                                children + 1, count - 1)
+                                     : nodeOperator(pool, lineCount, (OperatorType) tag, children, count);
+    if (children != stack) {
+        free(children);
+    }
+    return result;
+}
+
+/**
+ * Fold an operator whose operands are all numbers.
+ * @return the number, NODE_NONE if it is not one or folding gives an error.
+ */
+static NodeId foldNumbers(RewriteEngine *engine, NodeId node) {
+    NodePool *pool = engine->pool;
+    uint8_t tag = nodeTag(pool, node);
+    if (!nodeIsOperator(pool, node)) {
+        return NODE_NONE;
+    }
+    uint32_t count = nodeChildCount(pool, node), i;
+    for (i = 0; i < count; i++) {
+        NodeId child = nodeChild(pool, node, i);
+        if (nodeTag(pool, child) != NODE_NUMBER || numberIsError(nodeNumberOf(pool, child))) {
+            return NODE_NONE;
+        }
+    }
+    Number a = nodeNumberOf(pool, nodeChild(pool, node, 0)), result;
+    if (count == 1) {
+        if (tag == MINUS) {
+            result = numberNegate(a);
+        } else if (tag == FACTORIAL && numberIsSmall(a) && numberSmallValue(a) <= REWRITE_MAX_FACTORIAL) {
+            if (engine->factorials == NULL) {
+                engine->factorials = initFactorialCache(REWRITE_FACTORIAL_CACHE);
+            }
+            result = numberFactorial(a, engine->factorials);
+        } else {
+            return NODE_NONE;
+        }
+    } else {
+        Number b = nodeNumberOf(pool, nodeChild(pool, node, 1));
+        switch ((OperatorType) tag) {
+            case PLUS:
+                result = numberAdd(a, b);
+                break;
+            case MINUS:
+                result = numberSubtract(a, b);
+                break;
+            case MULTIPLY:
+                result = numberMultiply(a, b);
+                break;
+            case DIVIDE:
+                result = numberDivide(a, b);
+                break;
+            case POWER:
+                if (!numberIsSmall(b) || numberSmallValue(b) < -1024 || numberSmallValue(b) > 1024) {
+                    return NODE_NONE;
+                }
+                result = numberPower(a, numberSmallValue(b));
+                break;
+            default:
+                return NODE_NONE;
+        }
+    }
+    if (numberIsError(result)) {
+        return NODE_NONE;
+    }
+    return nodeExactNumber(pool, nodeLine(pool, node), result);
+}
+
+/**
+ * Rewrite a node whose children are in normal form once, at its root.
+ * @return the rewritten node, NODE_NONE if no rule applies.
+ */
+static NodeId rewriteRoot(RewriteEngine *engine, NodeId node) {
+    NodeId folded = foldNumbers(engine, node);
+    if (folded != NODE_NONE) {
+        engine->folds++;
+        return folded;
+    }
+    uint32_t candidateCount = 0, i, j;
+    collectCandidates(engine, 0, &node, 1, &candidateCount);
+    uint32_t *candidates = engine->candidateBuffer;
+    engine->candidates += candidateCount;
+    if (candidateCount > 1) { // Earlier rules first.
+        qsort(candidates, candidateCount, sizeof(uint32_t), compareRuleIndexes);
+    }
+    for (i = 0; i < candidateCount; i++) {
+        RewriteRule *rule = engine->rules + candidates[i];
+        NodeId bindings[REWRITE_MAX_VARIABLES];
+        for (j = 0; j < rule->variableCount; j++) {
+            bindings[j] = NODE_NONE;
+        }
+        rule->attempts++;
+        if (matchPattern(engine->pool, rule, rule->left, node, bindings)) {
+            rule->applications++;
+            return instantiate(engine->pool, rule, rule->right, bindings, nodeLine(engine->pool, node));
+        }
+    }
+    return NODE_NONE;
+}
+
+static void reserveNormalForms(RewriteEngine *engine) {
+    uint32_t needed = engine->pool->count;
+    if (needed <= engine->normalCapacity) {
+        return;
+    }
+    uint32_t capacity = engine->normalCapacity ? engine->normalCapacity : 64;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    engine->normalForms = (NodeId *) realloc(engine->normalForms, sizeof(NodeId) * capacity);
+    memset(engine->normalForms + engine->normalCapacity, 0xFF, sizeof(NodeId) * (capacity - engine->normalCapacity));
+    engine->normalCapacity = capacity;
+}
+
+/**
+ * Make room for count more pending nodes.
+ * @return the index of the first.
+ */
+static uint32_t reservePending(RewriteEngine *engine, uint32_t count) {
+    uint32_t first = engine->pendingCount;
+    if (first + count > engine->pendingCapacity) {
+        uint32_t capacity = engine->pendingCapacity ? engine->pendingCapacity : 64;
+        while (capacity < first + count) {
+            capacity *= 2;
+        }
+        engine->pending = (NodeId *) realloc(engine->pending, sizeof(NodeId) * capacity);
+        engine->pendingCapacity = capacity;
+    }
+    engine->pendingCount += count;
+    return first;
+}
+
+/**
+ * The normal form of a node if it is known, the node itself if it is pending.
+ * @return NODE_NONE if it has to be normalised.
+ */
+static NodeId knownNormalForm(RewriteEngine *engine, NodeId node) {
+    reserveNormalForms(engine);
+    NodeId normal = engine->normalForms[node];
+    if (normal == NORMAL_PENDING) {
+        return node;
+    }
+    if (normal != NODE_NONE) {
+        engine->skips++;
+    }
+    return normal;
+}
+
+/**
+ * Continue a frame at a node met on the way to the normal form, marking it pending.
+ * @param childrenNormal Whether its children are in normal form already.
+ */
+static void beginNode(RewriteEngine *engine, RewriteFrame *frame, NodeId node, bool childrenNormal) {
+    NodePool *pool = engine->pool;
+    uint8_t tag = nodeTag(pool, node);
+    uint32_t index = reservePending(engine, 1);
+    engine->pending[index] = node;
+    engine->normalForms[node] = NORMAL_PENDING;
+    frame->current = node;
+    frame->children = UINT32_MAX;
+    if (!childrenNormal && tag != NODE_NUMBER && tag != NODE_SYMBOL) {
+        frame->children = reservePending(engine, nodeChildCount(pool, node));
+        frame->nextChild = tag == NODE_CALL;
+    }
+}
+
+/**
+ * Start normalising a node whose normal form is not known on a new frame.
+ */
+static void pushFrame(RewriteEngine *engine, NodeId node) {
+    if (engine->frameCount == engine->frameCapacity) {
+        engine->frameCapacity = engine->frameCapacity ? engine->frameCapacity * 2 : 64;
+        engine->frames = (RewriteFrame *) realloc(engine->frames, sizeof(RewriteFrame) * engine->frameCapacity);
+    }
+    RewriteFrame *frame = engine->frames + engine->frameCount++;
+    engine->visits++;
+    frame->path = engine->pendingCount;
+    beginNode(engine, frame, node, false);
+}
+
+/**
+ * Rebuild the current node of a frame from the normal forms of its children,
+ * then rewrite at its root. Either gives the normal form or continues the
+ * frame at the node found.
+ * @return the normal form, NODE_NONE if the frame continues.
+ */
+static NodeId stepFrame(RewriteEngine *engine, RewriteFrame *frame) {
+    NodePool *pool = engine->pool;
+    NodeId current = frame->current, rebuilt = current, known;
+    if (frame->children != UINT32_MAX) {
+        uint8_t tag = nodeTag(pool, current);
+        uint32_t count = nodeChildCount(pool, current), i;
+        NodeId *normal = engine->pending + frame->children;
+        bool changed = false;
+        for (i = tag == NODE_CALL; i < count; i++) {
+            changed = changed || normal[i] != nodeChild(pool, current, i);
+        }
+        if (changed) {
+            rebuilt = tag == NODE_CALL ? nodeCall(pool, nodeLine(pool, current),
+                                                  nodeSymbolOf(pool, nodeChild(pool, current, 0)), normal + 1, count - 1)
+                                       : nodeOperator(pool, nodeLine(pool, current), (OperatorType) tag, normal, count);
+            reserveNormalForms(engine);
+        }
+        engine->pendingCount = frame->children;
+    }
+    if (rebuilt != current) {
+        known = engine->normalForms[rebuilt];
+        if (known != NODE_NONE) {
+            return known == NORMAL_PENDING ? rebuilt : known;
+        }
+        beginNode(engine, frame, rebuilt, true);
+        return NODE_NONE;
+    }
+    NodeId next = engine->steps < REWRITE_MAX_STEPS ? rewriteRoot(engine, current) : NODE_NONE;
+    if (next == NODE_NONE) {
+        return current;
+    }
+    engine->steps++;
+    reserveNormalForms(engine);
+    known = engine->normalForms[next];
+    if (known != NODE_NONE) {
+        return known == NORMAL_PENDING ? next : known;
+    }
+    beginNode(engine, frame, next, false);
+    return NODE_NONE;
+}
+
+/**
+ * Normalise the children of a node, then rewrite at its root while a rule
+ * applies, normalising the children of each rewritten node again. The walk
+ * keeps a frame per node on the engine rather than recursing, so deep
+ * expressions are fine. Every node on the way is pending until the normal
+ * form is found, meeting one again means the rules cycle, and the normal form
+ * is taken to be that node.
+ */
+static NodeId normalise(RewriteEngine *engine, NodeId node) {
+    NodePool *pool = engine->pool;
+    NodeId normal = knownNormalForm(engine, node);
+    uint32_t base = engine->frameCount, i;
+    if (normal != NODE_NONE) {
+        return normal;
+    }
+    pushFrame(engine, node);
+    for (;;) {
+        RewriteFrame *frame = engine->frames + engine->frameCount - 1;
+        if (frame->children != UINT32_MAX && frame->nextChild < nodeChildCount(pool, frame->current)) {
+            NodeId child = nodeChild(pool, frame->current, frame->nextChild);
+            normal = knownNormalForm(engine, child);
+            if (normal == NODE_NONE) {
+                pushFrame(engine, child);
+            } else {
+                engine->pending[frame->children + frame->nextChild++] = normal;
+            }
+            continue;
+        }
+        normal = stepFrame(engine, frame);
+        if (normal == NODE_NONE) {
+            continue;
+        }
+        for (i = frame->path; i < engine->pendingCount; i++) {
+            engine->normalForms[engine->pending[i]] = normal;
+        }
+        engine->pendingCount = frame->path;
+        if (engine->normalForms[normal] == NODE_NONE) {
+            engine->normalForms[normal] = normal; // Normalised, skipped from now on.
+        }
+        if (--engine->frameCount == base) {
+            return normal;
+        }
+        frame = engine->frames + engine->frameCount - 1;
+        engine->pending[frame->children + frame->nextChild++] = normal;
+    }
+}
+
+NodeId rewriteNode(RewriteEngine *engine, NodeId node) {
+    if (node == NODE_NONE) {
+        return NODE_NONE;
+    }
+    engine->steps = 0;
+    return normalise(engine, node);
+}
+
+static void printRuleCounters(const RewriteEngine *engine, const RewriteRule *rule, FILE *file) {
+    fprintf(file, "%10llu applied %10llu tried  ", (unsigned long long) rule->applications,
+            (unsigned long long) rule->attempts);
+    printNode(engine->pool, rule->left, file);
+    fprintf(file, " = ");
+    printNode(engine->pool, rule->right, file);
+    fprintf(file, "\n");
+}
+
+void printRewriteCounters(const RewriteEngine *engine, FILE *file, uint32_t limit) {
+    fprintf(file, "%llu nodes normalised, %llu skipped, %llu candidates, %llu folds\n",
+            (unsigned long long) engine->visits, (unsigned long long) engine->skips,
+            (unsigned long long) engine->candidates, (unsigned long long) engine->folds);
+    uint32_t i, tried = 0;
+    if (limit == 0) {
+        for (i = 0; i < engine->ruleCount; i++) {
+            if (engine->rules[i].attempts != 0) {
+                printRuleCounters(engine, engine->rules + i, file);
+            }
+        }
+        return;
+    }
+    // The most tried so far, kept in order by insertion, limit is meant to be a few.
+    uint32_t *top = (uint32_t *) malloc(sizeof(uint32_t) * limit), count = 0, j;
+    for (i = 0; i < engine->ruleCount; i++) {
+        uint64_t attempts = engine->rules[i].attempts;
+        if (attempts == 0) {
+            continue;
+        }
+        tried++;
+        if (count == limit && engine->rules[top[count - 1]].attempts >= attempts) {
+            continue;
+        }
+        j = count < limit ? count++ : count - 1;
+        for (; j > 0 && engine->rules[top[j - 1]].attempts < attempts; j--) {
+            top[j] = top[j - 1];
+        }
+        top[j] = i;
+    }
+    for (j = 0; j < count; j++) {
+        printRuleCounters(engine, engine->rules + top[j], file);
+    }
+    if (tried > count) {
+        fprintf(file, "%u more rules tried\n", tried - count);
+    }
+    free(top);
+}
@@ -0,0 +1,128 @@
+//
+// Term rewriting of expression nodes, rules are dispatched by a discrimination tree.
+//
+
+#ifndef FLUXIONCORE_FLUXION_REWRITE_H
+#define FLUXIONCORE_FLUXION_REWRITE_H
+#include <stdio.h>
+#include "fluxion_combinatorics.h"
+#include "fluxion_node.h"
+
+#define REWRITE_MAX_VARIABLES 16 // Pattern variables a rule may have.
+#define REWRITE_MAX_PATTERN 64 // Nodes the left side of a rule may have.
+#define REWRITE_MAX_STEPS 100000 // Rule applications a single normalisation may make.
+#define REWRITE_MAX_FACTORIAL 100000 // Largest n! folded to a number.
+#define REWRITE_FACTORIAL_CACHE 16 // Factorials the engine keeps to fold nearby ones from.
+
+/**
+ * A rule lhs = rhs. Symbols on the left side are pattern variables that match
+ * any subexpression, a variable repeated must match the same subexpression.
+ * Numbers match themselves and calls match calls of the same function.
+ */
+typedef struct {
+    NodeId left;
+    NodeId right;
+    uint32_t variables[REWRITE_MAX_VARIABLES]; // Symbol of each pattern variable.
+    uint32_t variableCount;
+    uint32_t next; // Next rule ending at the same tree leaf, UINT32_MAX for none.
+    uint64_t attempts; // Times the tree gave it as a candidate and its left side was matched in full.
+    uint64_t applications; // Times it matched and was applied.
+} RewriteRule;
+
+/**
+ * A node of the discrimination tree. A path from the root spells the left
+ * side of rules in preorder, each step the key of a node or a wildcard for
+ * a pattern variable. Children by key are found through the engine's tree
+ * index, so a node with many children, like the root, is not scanned.
+ */
+typedef struct {
+    uint64_t key;
+    uint32_t parent;
+    uint32_t wildcard; // Child for a pattern variable, UINT32_MAX for none.
+    uint32_t rules; // First rule whose left side ends here, UINT32_MAX for none.
+} RewriteTreeNode;
+
+/**
+ * A node being normalised, with the node it is rewritten to so far.
+ */
+typedef struct {
+    NodeId current;
+    uint32_t path; // First pending entry of the nodes met on the way to the normal form.
+    uint32_t children; // First pending entry of the normal forms of the children, UINT32_MAX if done.
+    uint32_t nextChild; // Child of current normalised next.
+} RewriteFrame;
+
+/**
+ * Rewrites the nodes of a pool to normal form. Rewriting is bottom up, the
+ * children of a node are normalised first, then rules are tried at the node
+ * until none applies. Each normal form found is kept per node id, so a
+ * subtree seen again, in the same or a later call, is not normalised again.
+ * Adding a rule forgets them.
+ */
+typedef struct {
+    NodePool *pool;
+    RewriteRule *rules;
+    uint32_t ruleCount;
+    uint32_t ruleCapacity;
+    RewriteTreeNode *tree; // Node 0 is the root.
+    uint32_t treeCount;
+    uint32_t treeCapacity;
+    uint32_t *treeIndex; // Open addressing table of the keyed children, node + 1, 0 is empty.
+    uint32_t treeIndexCapacity;
+    NodeId *normalForms; // Normal form of each node id, NODE_NONE if not known yet.
+    uint32_t normalCapacity;
+    FactorialCache *factorials; // Created by the first factorial folded.
+    uint32_t *candidateBuffer; // Rules that may match at the node being rewritten, grown as needed.
+    uint32_t candidateCapacity;
+    NodeId *pending; // Nodes on the way to a normal form and children being normalised, grown as needed.
+    uint32_t pendingCount;
+    uint32_t pendingCapacity;
+    RewriteFrame *frames; // Nodes being normalised, innermost last, so deep expressions use no C stack.
+    uint32_t frameCount;
+    uint32_t frameCapacity;
+    // Counters for profiling.
+    uint64_t visits; // Nodes normalised.
+    uint64_t skips; // Nodes whose normal form was known already.
+    uint64_t candidates; // Rules the tree returned as candidates.
+    uint64_t folds; // Operators on numbers folded to a number.
+    uint64_t steps; // Rule applications and folds in the current normalisation.
+} RewriteEngine;
+
+/**
+ * Create an engine for a pool with the builtin algebraic rules.
+ * @param pool Pool to rewrite in, not owned.
+ */
+RewriteEngine *initRewriteEngine(NodePool *pool);
+/**
+ * Create an engine for a pool with no rules, only folding numbers.
+ */
+RewriteEngine *initEmptyRewriteEngine(NodePool *pool);
+void freeRewriteEngine(RewriteEngine *engine);
+/**
+ * Add a rule.
+ * @return the index of the rule, UINT32_MAX if the left side is a pattern variable or too large.
+ */
+uint32_t addRewriteRule(RewriteEngine *engine, NodeId left, NodeId right);
+/**
+ * Add a rule from a token of the form lhs = rhs or lhs := rhs.
+ * @return the index of the rule, UINT32_MAX if the token is not a rule.
+ */
+uint32_t addRewriteRuleToken(RewriteEngine *engine, const Token *token);
+/**
+ * Add every rule of a source, one lhs = rhs or lhs := rhs per line.
+ * @return the number of rules added.
+ */
+uint32_t addRewriteRules(RewriteEngine *engine, const char *source);
+/**
+ * Rewrite a node to normal form. Rules that cycle, like a + b = b + a, stop
+ * at the first node met again, rules that never stop at REWRITE_MAX_STEPS.
+ * @return the normal form, node itself if no rule applies anywhere under it.
+ */
+NodeId rewriteNode(RewriteEngine *engine, NodeId node);
+/**
+ * Print the rule application counters, rules that were never a candidate are left out.
+ * @param limit Most tried rules to print, 0 for every rule in the order they were added.
+ */
+void printRewriteCounters(const RewriteEngine *engine, FILE *file, uint32_t limit);
+
+#endif //FLUXIONCORE_FLUXION_REWRITE_H
@@ -0,0 +1,330 @@
+//
+// Vectorised scanning kernels used by the lexer.
+//
+
+#include "fluxion_scan.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SCAN_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SCAN_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_HAS_AVX2 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define firstSetBit(mask) __builtin_ctz(mask)
+#define bitCount(mask) __builtin_popcount(mask)
+#else
+static int firstSetBit(uint32_t mask) {
+    int index = 0;
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+}
+
+static int bitCount(uint32_t mask) {
+    int count = 0;
+    while (mask) {
+        mask &= mask - 1;
+        count++;
+    }
+    return count;
+}
+#endif
+
+typedef struct {
+    const uint8_t *(*newline)(const uint8_t *, const uint8_t *);
+    const uint8_t *(*commentEnd)(const uint8_t *, const uint8_t *, int *);
+    const uint8_t *(*whitespace)(const uint8_t *, const uint8_t *);
+    const uint8_t *(*identifier)(const uint8_t *, const uint8_t *);
+} ScanKernels;
+
+/*
+ * Scalar kernels, also used for the tails of the vector ones.
+ */
+
+static bool isIdentifierChar(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static const uint8_t *scalarNewline(const uint8_t *ch, const uint8_t *end) {
+    while (ch < end && *ch != '\n') {
+        ch++;
+    }
+    return ch;
+}
+
+static const uint8_t *scalarCommentEnd(const uint8_t *ch, const uint8_t *end, int *newlines) {
+    while (ch < end) {
+        if (ch[0] == '*' && ch[1] == ';') { // ch[1] is at most the terminator.
+            return ch;
+        }
+        *newlines += *ch == '\n';
+        ch++;
+    }
+    return end;
+}
+
+static const uint8_t *scalarWhitespace(const uint8_t *ch, const uint8_t *end) {
+    while (ch < end && (*ch == ' ' || *ch == '\t' || *ch == '\r')) {
+        ch++;
+    }
+    return ch;
+}
+
+static const uint8_t *scalarIdentifier(const uint8_t *ch, const uint8_t *end) {
+    while (ch < end && isIdentifierChar(*ch)) {
+        ch++;
+    }
+    return ch;
+}
+
+#ifdef SCAN_HAS_SSE2
+/*
+ * SSE2 kernels, 16 bytes at a time. Blocks are only loaded while they are
+ * entirely before end, the remainder is left to the scalar kernels.
+ */
+
+static const uint8_t *sse2Newline(const uint8_t *ch, const uint8_t *end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (ch + 16 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i *) ch);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask) {
+            return ch + firstSetBit(mask);
+        }
+        ch += 16;
+    }
+    return scalarNewline(ch, end);
+}
+
+static const uint8_t *sse2CommentEnd(const uint8_t *ch, const uint8_t *end, int *newlines) {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (ch + 16 <= end) { // The shifted load reads at most the terminator.
+        __m128i block = _mm_loadu_si128((const __m128i *) ch);
+        __m128i shifted = _mm_loadu_si128((const __m128i *) (ch + 1));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block, star),
+                                                                   _mm_cmpeq_epi8(shifted, semicolon)));
+        unsigned lines = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask) {
+            int index = firstSetBit(mask);
+            *newlines += bitCount(lines & ((1u << index) - 1));
+            return ch + index;
+        }
+        *newlines += bitCount(lines);
+        ch += 16;
+    }
+    return scalarCommentEnd(ch, end, newlines);
+}
+
+static const uint8_t *sse2Whitespace(const uint8_t *ch, const uint8_t *end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    while (ch + 16 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i *) ch);
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)),
+                                     _mm_cmpeq_epi8(block, carriage));
+        unsigned mask = ~(unsigned) _mm_movemask_epi8(match) & 0xFFFFu;
+        if (mask) {
+            return ch + firstSetBit(mask);
+        }
+        ch += 16;
+    }
+    return scalarWhitespace(ch, end);
+}
+
+static const uint8_t *sse2Identifier(const uint8_t *ch, const uint8_t *end) {
+    // Signed compares, bytes >= 0x80 are negative and caught by the sign test.
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i beforeA = _mm_set1_epi8('a' - 1);
+    const __m128i afterZ = _mm_set1_epi8('z' + 1);
+    const __m128i beforeZero = _mm_set1_epi8('0' - 1);
+    const __m128i afterNine = _mm_set1_epi8('9' + 1);
+    const __m128i zero = _mm_setzero_si128();
+    while (ch + 16 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i *) ch);
+        __m128i lower = _mm_or_si128(block, caseBit);
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, beforeA), _mm_cmplt_epi8(lower, afterZ));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, beforeZero), _mm_cmplt_epi8(block, afterNine));
+        __m128i match = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmplt_epi8(block, zero));
+        unsigned mask = ~(unsigned) _mm_movemask_epi8(match) & 0xFFFFu;
+        if (mask) {
+            return ch + firstSetBit(mask);
+        }
+        ch += 16;
+    }
+    return scalarIdentifier(ch, end);
+}
+#endif
+
+#ifdef SCAN_HAS_AVX2
+/*
+ * AVX2 kernels, 32 bytes at a time, the tails go through SSE2.
+ */
+
+TARGET_AVX2 static const uint8_t *avx2Newline(const uint8_t *ch, const uint8_t *end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (ch + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) ch);
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        if (mask) {
+            return ch + firstSetBit(mask);
+        }
+        ch += 32;
+    }
+    _mm256_zeroupper(); // The compiler may tail call without it, leaving SSE code after us slow.
+    return sse2Newline(ch, end);
+}
+
+TARGET_AVX2 static const uint8_t *avx2CommentEnd(const uint8_t *ch, const uint8_t *end, int *newlines) {
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i semicolon = _mm256_set1_epi8(';');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (ch + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) ch);
+        __m256i shifted = _mm256_loadu_si256((const __m256i *) (ch + 1));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block, star),
+                                                                         _mm256_cmpeq_epi8(shifted, semicolon)));
+        unsigned lines = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        if (mask) {
+            int index = firstSetBit(mask);
+            *newlines += bitCount(lines & ((1u << index) - 1));
+            return ch + index;
+        }
+        *newlines += bitCount(lines);
+        ch += 32;
+    }
+    _mm256_zeroupper();
+    return sse2CommentEnd(ch, end, newlines);
+}
+
+TARGET_AVX2 static const uint8_t *avx2Whitespace(const uint8_t *ch, const uint8_t *end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i carriage = _mm256_set1_epi8('\r');
+    while (ch + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) ch);
+        __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+                                                         _mm256_cmpeq_epi8(block, tab)),
+                                         _mm256_cmpeq_epi8(block, carriage));
+        unsigned mask = ~(unsigned) _mm256_movemask_epi8(match);
+        if (mask) {
+            return ch + firstSetBit(mask);
+        }
+        ch += 32;
+    }
+    _mm256_zeroupper();
+    return sse2Whitespace(ch, end);
+}
+
+TARGET_AVX2 static const uint8_t *avx2Identifier(const uint8_t *ch, const uint8_t *end) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i beforeA = _mm256_set1_epi8('a' - 1);
+    const __m256i afterZ = _mm256_set1_epi8('z' + 1);
+    const __m256i beforeZero = _mm256_set1_epi8('0' - 1);
+    const __m256i afterNine = _mm256_set1_epi8('9' + 1);
+    const __m256i zero = _mm256_setzero_si256();
+    while (ch + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) ch);
+        __m256i lower = _mm256_or_si256(block, caseBit);
+        __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, beforeA), _mm256_cmpgt_epi8(afterZ, lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, beforeZero), _mm256_cmpgt_epi8(afterNine, block));
+        __m256i match = _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpgt_epi8(zero, block));
+        unsigned mask = ~(unsigned) _mm256_movemask_epi8(match);
+        if (mask) {
+            return ch + firstSetBit(mask);
+        }
+        ch += 32;
+    }
+    _mm256_zeroupper();
+    return sse2Identifier(ch, end);
+}
+#endif
+
+static const ScanKernels scalarKernels = {scalarNewline, scalarCommentEnd, scalarWhitespace, scalarIdentifier};
+#ifdef SCAN_HAS_SSE2
+static const ScanKernels sse2Kernels = {sse2Newline, sse2CommentEnd, sse2Whitespace, sse2Identifier};
+#endif
+#ifdef SCAN_HAS_AVX2
+static const ScanKernels avx2Kernels = {avx2Newline, avx2CommentEnd, avx2Whitespace, avx2Identifier};
+#endif
+
+static const ScanKernels *kernels = NULL;
+static ScanLevel currentLevel = SCAN_SCALAR;
+
+ScanLevel scanBestLevel(void) {
+#ifdef SCAN_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SCAN_AVX2;
+    }
+#endif
+#ifdef SCAN_HAS_SSE2
+    return SCAN_SSE2;
+#else
+    return SCAN_SCALAR;
+#endif
+}
+
+void scanSetLevel(ScanLevel level) {
+    ScanLevel best = scanBestLevel();
+    if (level > best) {
+        level = best;
+    }
+    switch (level) {
+#ifdef SCAN_HAS_AVX2
+        case SCAN_AVX2:
+            kernels = &avx2Kernels;
+            break;
+#endif
+#ifdef SCAN_HAS_SSE2
+        case SCAN_SSE2:
+            kernels = &sse2Kernels;
+            break;
+#endif
+        default:
+            kernels = &scalarKernels;
+            break;
+    }
+    currentLevel = level;
+}
+
+/**
+ * Select the kernels on first use, racing threads pick the same ones.
+ */
+static const ScanKernels *getKernels(void) {
+    if (kernels == NULL) {
+        scanSetLevel(scanBestLevel());
+    }
+    return kernels;
+}
+
+ScanLevel scanGetLevel(void) {
+    getKernels();
+    return currentLevel;
+}
+
+const uint8_t *scanNewline(const uint8_t *ch, const uint8_t *end) {
+    return getKernels()->newline(ch, end);
+}
+
+const uint8_t *scanCommentEnd(const uint8_t *ch, const uint8_t *end, int *newlines) {
+    return getKernels()->commentEnd(ch, end, newlines);
+}
+
+const uint8_t *scanWhitespace(const uint8_t *ch, const uint8_t *end) {
+    return getKernels()->whitespace(ch, end);
+}
+
+const uint8_t *scanIdentifier(const uint8_t *ch, const uint8_t *end) {
+    return getKernels()->identifier(ch, end);
+}
@@ -0,0 +1,63 @@
+//
+// Vectorised scanning kernels used by the lexer.
+//
+
+#ifndef FLUXIONCORE_FLUXION_SCAN_H
+#define FLUXIONCORE_FLUXION_SCAN_H
+#include "commons.h"
+
+/**
+ * Instruction set level of the kernels.
+ */
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} ScanLevel;
+
+/**
+ * Get the best level supported by the running CPU.
+ */
+ScanLevel scanBestLevel(void);
+/**
+ * Get the level currently in use, selected on first use.
+ */
+ScanLevel scanGetLevel(void);
+/**
+ * Force the kernels of a level, used by benchmarks.
+ * Levels the CPU does not support fall back to the best supported one.
+ * @param level Level to use.
+ */
+void scanSetLevel(ScanLevel level);
+
+/**
+ * Find the next new line.
+ * @param ch Where to start.
+ * @param end End of the source, must point to its null terminator.
+ * @return pointer to the new line, or end.
+ */
+const uint8_t *scanNewline(const uint8_t *ch, const uint8_t *end);
+/**
+ * Find the *; terminating a multi line comment.
+ * @param ch Where to start, after the opening ;*.
+ * @param end End of the source, must point to its null terminator.
+ * @param newlines Incremented by the new lines skipped.
+ * @return pointer to the *, or end.
+ */
+const uint8_t *scanCommentEnd(const uint8_t *ch, const uint8_t *end, int *newlines);
+/**
+ * Skip a run of spaces, tabs and carriage returns.
+ * @param ch Where to start.
+ * @param end End of the source, must point to its null terminator.
+ * @return pointer to the first other character.
+ */
+const uint8_t *scanWhitespace(const uint8_t *ch, const uint8_t *end);
+/**
+ * Skip a run of identifier characters, letters, digits and non ASCII bytes.
+ * @param ch Where to start.
+ * @param end End of the source, must point to its null terminator.
+ * @return pointer to the first other character.
+ */
+const uint8_t *scanIdentifier(const uint8_t *ch, const uint8_t *end);
+
+#endif //FLUXIONCORE_FLUXION_SCAN_H
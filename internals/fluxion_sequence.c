@@ -0,0 +1,1103 @@
+//
+// Evaluation of the recurrences sequence tokens declare.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "fluxion_arena.h"
+#include "fluxion_modular.h"
+#include "fluxion_sequence.h"
+
+#define SEQUENCE_MAX_ORDER 4096
+#define TERM_NAME_SIZE 16
+
+/**
+ * Growing arrays a rule is compiled into.
+ */
+typedef struct {
+    SequenceStep *steps;
+    uint32_t stepCount;
+    uint32_t stepCapacity;
+    Number *constants;
+    uint32_t constantCount;
+    uint32_t constantCapacity;
+} StepBuilder;
+
+static void sequenceError(const Token *token, const char *message) {
+    char str[256];
+    snprintf(str, sizeof(str), "at line %i, %s\n", token->lineCount, message);
+    Error newError = {Undefined, str};
+    issueError(&newError);
+}
+
+static const Token *unwrap(const Token *token) {
+    while (token != NULL && token->tokenType == EXPRESSION) {
+        token = ((const ExpressionToken *) token)->root;
+    }
+    return token;
+}
+
+static bool isNamed(const Token *token, const IdentifierToken *identifier) {
+    return token != NULL && token->tokenType == IDENTIFIER &&
+           ((const IdentifierToken *) token)->identifierType == Variable &&
+           strcmp(((const IdentifierToken *) token)->name, identifier->name) == 0;
+}
+
+/**
+ * Whether a token is a term of the sequence, x_ anything.
+ */
+static bool isTerm(const Token *token, const SequenceToken *sequence) {
+    return token->tokenType == OPERATOR && ((const OperatorToken *) token)->operatorType == GET &&
+           isNamed(unwrap(((const OperatorToken *) token)->left), sequence->variable);
+}
+
+/**
+ * Offset of a term x_{n - c}.
+ * @return c, 0 if the index is not of that form with c a positive integer.
+ */
+static int32_t termOffset(const OperatorToken *term, const SequenceToken *sequence) {
+    const Token *index = unwrap(term->right);
+    if (index == NULL || index->tokenType != OPERATOR) {
+        return 0;
+    }
+    const OperatorToken *difference = (const OperatorToken *) index;
+    const Token *offset = unwrap(difference->right);
+    if (difference->operatorType != MINUS || !isNamed(unwrap(difference->left), sequence->numerical) ||
+        offset == NULL || offset->tokenType != NUMBER) {
+        return 0;
+    }
+    Number number = ((const NumberToken *) offset)->number;
+    if (!numberIsSmall(number) || numberSmallValue(number) <= 0 || numberSmallValue(number) > INT32_MAX) {
+        return 0;
+    }
+    return (int32_t) numberSmallValue(number);
+}
+
+/**
+ * Find the order of a rule, the largest offset among its terms.
+ * @return the order, -1 after issuing an error.
+ */
+static int findOrder(const Token *token, const SequenceToken *sequence) {
+    int i, order = 0;
+    if (token == NULL) {
+        return 0;
+    }
+    switch (token->tokenType) {
+        case EXPRESSION:
+            return findOrder(((const ExpressionToken *) token)->root, sequence);
+        case OPERATOR: {
+            const OperatorToken *operator = (const OperatorToken *) token;
+            if (isTerm(token, sequence)) {
+                int32_t offset = termOffset(operator, sequence);
+                if (offset == 0) {
+                    sequenceError(token, "Sequence terms must be of the form x_{n - c}, c a positive integer.");
+                    return -1;
+                }
+                if (offset > SEQUENCE_MAX_ORDER) {
+                    sequenceError(token, "Sequence order is too large.");
+                    return -1;
+                }
+                return offset;
+            }
+            int left = findOrder(operator->left, sequence);
+            int right = left < 0 ? -1 : findOrder(operator->right, sequence);
+            if (right < 0) {
+                return -1;
+            }
+            return left > right ? left : right;
+        }
+        case IDENTIFIER:
+            if (((const IdentifierToken *) token)->identifierType == Function) {
+                const FunctionToken *function = (const FunctionToken *) token;
+                for (i = 0; i < function->current; i++) {
+                    int argument = findOrder(function->args[i], sequence);
+                    if (argument < 0) {
+                        return -1;
+                    }
+                    order = argument > order ? argument : order;
+                }
+            }
+            return order;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Copy the operators and calls of a rule, replacing every x_{n - c} with a
+ * variable named _c so the rule compiles like any expression.
+ * Other tokens are shared with the rule.
+ */
+static Token *substituteTerms(Arena *arena, Token *token, const SequenceToken *sequence) {
+    int i;
+    if (token == NULL) {
+        return NULL;
+    }
+    switch (token->tokenType) {
+        case EXPRESSION:
+            return substituteTerms(arena, ((ExpressionToken *) token)->root, sequence);
+        case OPERATOR: {
+            OperatorToken *operator = (OperatorToken *) token;
+            if (isTerm(token, sequence)) {
+                char name[TERM_NAME_SIZE];
+                snprintf(name, sizeof(name), "_%i", (int) termOffset(operator, sequence));
+                return (Token *) initIdentifierToken(arena, token->lineCount, name);
+            }
+            return (Token *) initOperatorToken(arena, token->lineCount, operator->operatorType,
+                                               substituteTerms(arena, operator->left, sequence),
+                                               substituteTerms(arena, operator->right, sequence));
+        }
+        case IDENTIFIER: {
+            if (((IdentifierToken *) token)->identifierType != Function) {
+                return token;
+            }
+            FunctionToken *function = (FunctionToken *) token;
+            FunctionToken *copy = initFunctionToken(arena, token->lineCount, function->identifier.name);
+            for (i = 0; i < function->current; i++) {
+                addArgument(copy, substituteTerms(arena, function->args[i], sequence));
+            }
+            return (Token *) copy;
+        }
+        default:
+            return token;
+    }
+}
+
+/**
+ * Compile the rule for double evaluation, the variables are n then _1 to _order.
+ * @return the program, NULL after issuing an error.
+ */
+static Program *compileRule(const SequenceToken *sequence, int order) {
+    Arena *arena = initArena(0);
+    char *storage = (char *) arenaAlloc(arena, (size_t) (order + 1) * TERM_NAME_SIZE);
+    const char **names = (const char **) arenaAlloc(arena, sizeof(char *) * (order + 1));
+    int c;
+    names[0] = sequence->numerical->name;
+    for (c = 1; c <= order; c++) {
+        snprintf(storage + c * TERM_NAME_SIZE, TERM_NAME_SIZE, "_%i", c);
+        names[c] = storage + c * TERM_NAME_SIZE;
+    }
+    Token *rule = substituteTerms(arena, (Token *) sequence->rule, sequence);
+    Program *program = compileExpression(rule, names, order + 1);
+    freeArena(arena);
+    return program;
+}
+
+static void addStep(StepBuilder *builder, SequenceStepKind kind, int32_t operand) {
+    if (builder->stepCount >= builder->stepCapacity) {
+        builder->stepCapacity = builder->stepCapacity ? builder->stepCapacity * 2 : 16;
+        builder->steps = (SequenceStep *) realloc(builder->steps, sizeof(SequenceStep) * builder->stepCapacity);
+    }
+    builder->steps[builder->stepCount].kind = (uint32_t) kind;
+    builder->steps[builder->stepCount++].operand = operand;
+}
+
+static void addConstantStep(StepBuilder *builder, Number number) {
+    if (builder->constantCount >= builder->constantCapacity) {
+        builder->constantCapacity = builder->constantCapacity ? builder->constantCapacity * 2 : 8;
+        builder->constants = (Number *) realloc(builder->constants, sizeof(Number) * builder->constantCapacity);
+    }
+    builder->constants[builder->constantCount] = copyNumber(number);
+    addStep(builder, STEP_CONSTANT, (int32_t) builder->constantCount++);
+}
+
+static void freeStepBuilder(StepBuilder *builder) {
+    uint32_t i;
+    for (i = 0; i < builder->constantCount; i++) {
+        freeNumber(builder->constants[i]);
+    }
+    free(builder->constants);
+    free(builder->steps);
+}
+
+/**
+ * Compile a rule to steps for exact evaluation, only rational operations can be.
+ * @return false if the rule has anything else.
+ */
+static bool compileSteps(StepBuilder *builder, const Token *token, const SequenceToken *sequence) {
+    if (token == NULL) {
+        return false;
+    }
+    switch (token->tokenType) {
+        case EXPRESSION:
+            return compileSteps(builder, ((const ExpressionToken *) token)->root, sequence);
+        case NUMBER:
+            addConstantStep(builder, ((const NumberToken *) token)->number);
+            return true;
+        case IDENTIFIER:
+            if (isNamed(token, sequence->numerical)) {
+                addStep(builder, STEP_INDEX, 0);
+                return true;
+            }
+            return false;
+        case OPERATOR: {
+            const OperatorToken *operator = (const OperatorToken *) token;
+            SequenceStepKind kind;
+            if (isTerm(token, sequence)) {
+                addStep(builder, STEP_TERM, termOffset(operator, sequence));
+                return true;
+            }
+            if (operator->left == NULL) {
+                if (operator->operatorType == PLUS) {
+                    return compileSteps(builder, operator->right, sequence);
+                }
+                if (operator->operatorType == MINUS && compileSteps(builder, operator->right, sequence)) {
+                    addStep(builder, STEP_NEGATE, 0);
+                    return true;
+                }
+                return false;
+            }
+            if (operator->right == NULL) {
+                return false;
+            }
+            const Token *exponent = unwrap(operator->right);
+            if (operator->operatorType == POWER && exponent != NULL && exponent->tokenType == NUMBER) {
+                Number number = ((const NumberToken *) exponent)->number;
+                if (numberIsSmall(number) && numberSmallValue(number) >= -INT32_MAX &&
+                    numberSmallValue(number) <= INT32_MAX) {
+                    if (!compileSteps(builder, operator->left, sequence)) {
+                        return false;
+                    }
+                    addStep(builder, STEP_POWER_INTEGER, (int32_t) numberSmallValue(number));
+                    return true;
+                }
+            }
+            switch (operator->operatorType) {
+                case PLUS:
+                    kind = STEP_ADD;
+                    break;
+                case MINUS:
+                    kind = STEP_SUBTRACT;
+                    break;
+                case MULTIPLY:
+                    kind = STEP_MULTIPLY;
+                    break;
+                case DIVIDE:
+                    kind = STEP_DIVIDE;
+                    break;
+                case POWER:
+                    kind = STEP_POWER;
+                    break;
+                default:
+                    return false;
+            }
+            if (!compileSteps(builder, operator->left, sequence) || !compileSteps(builder, operator->right, sequence)) {
+                return false;
+            }
+            addStep(builder, kind, 0);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Most operands the steps have on the stack at once.
+ */
+static uint32_t stepStackSize(const SequenceStep *steps, uint32_t stepCount) {
+    uint32_t i, top = 0, size = 1;
+    for (i = 0; i < stepCount; i++) {
+        switch ((SequenceStepKind) steps[i].kind) {
+            case STEP_CONSTANT:
+            case STEP_INDEX:
+            case STEP_TERM:
+                top++;
+                size = top > size ? top : size;
+                break;
+            case STEP_NEGATE:
+            case STEP_POWER_INTEGER:
+                break;
+            default:
+                top--;
+                break;
+        }
+    }
+    return size;
+}
+
+static void replaceNumber(Number *slot, Number value) {
+    freeNumber(*slot);
+    *slot = value;
+}
+
+static Number numberFromIndex(uint64_t index) {
+    if (index <= INT64_MAX) {
+        return numberFromInt64((int64_t) index);
+    }
+    BigInt integer;
+    initBigInt(&integer);
+    bigIntSetUint64(&integer, index);
+    return numberFromBigInt(&integer);
+}
+
+/**
+ * Raise to any power, through doubles unless the exponent is an integer.
+ */
+static Number powerNumbers(Number base, Number exponent) {
+    if (numberIsError(base)) {
+        return base;
+    }
+    if (numberIsError(exponent)) {
+        return exponent;
+    }
+    if (numberIsSmall(exponent)) {
+        return numberPower(base, numberSmallValue(exponent));
+    }
+    return numberFromDouble(pow(numberToDouble(base), numberToDouble(exponent)));
+}
+
+/**
+ * Evaluate the rule exactly for a term, the window holding the terms before it.
+ * @return the term, owned by the caller.
+ */
+static Number runSteps(const SequenceEngine *engine, uint64_t index) {
+    Number *stack = engine->stack;
+    uint32_t i, top = 0;
+    for (i = 0; i < engine->stepCount; i++) {
+        const SequenceStep *step = engine->steps + i;
+        Number a, b, result;
+        switch ((SequenceStepKind) step->kind) {
+            case STEP_CONSTANT:
+                stack[top++] = copyNumber(engine->constants[step->operand]);
+                continue;
+            case STEP_INDEX:
+                stack[top++] = numberFromIndex(index);
+                continue;
+            case STEP_TERM:
+                stack[top++] = copyNumber(engine->window[(index - step->operand) % engine->order]);
+                continue;
+            case STEP_NEGATE:
+                replaceNumber(stack + top - 1, numberNegate(stack[top - 1]));
+                continue;
+            case STEP_POWER_INTEGER:
+                replaceNumber(stack + top - 1, numberPower(stack[top - 1], step->operand));
+                continue;
+            default:
+                break;
+        }
+        b = stack[--top];
+        a = stack[top - 1];
+        switch ((SequenceStepKind) step->kind) {
+            case STEP_ADD:
+                result = numberAdd(a, b);
+                break;
+            case STEP_SUBTRACT:
+                result = numberSubtract(a, b);
+                break;
+            case STEP_MULTIPLY:
+                result = numberMultiply(a, b);
+                break;
+            case STEP_DIVIDE:
+                result = numberDivide(a, b);
+                break;
+            default:
+                result = powerNumbers(a, b);
+                break;
+        }
+        freeNumber(a);
+        freeNumber(b);
+        stack[top - 1] = result;
+    }
+    return stack[0];
+}
+
+static bool isConstantForm(const Number *form, int order) {
+    int c;
+    for (c = 1; c <= order; c++) {
+        if (!numberIsZero(form[c])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Find the coefficients of a linear rule by running its steps on
+ * vectors of coefficients, a constant term then one per term, instead of numbers.
+ * @return order + 1 coefficients, NULL unless the rule is linear in its terms with constant coefficients.
+ */
+static Number *findCoefficients(const SequenceEngine *engine) {
+    size_t width = (size_t) engine->order + 1, j, count = engine->stackSize * width;
+    Number *stack = (Number *) malloc(sizeof(Number) * count);
+    Number *coefficients = NULL;
+    uint32_t i, top = 0;
+    bool linear = true;
+    for (j = 0; j < count; j++) {
+        stack[j] = numberFromSmall(0);
+    }
+    for (i = 0; i < engine->stepCount && linear; i++) {
+        const SequenceStep *step = engine->steps + i;
+        Number *b = stack + top * width, *a = top ? b - width : NULL; // Slot of a push and the top.
+        switch ((SequenceStepKind) step->kind) {
+            case STEP_CONSTANT:
+                b[0] = copyNumber(engine->constants[step->operand]);
+                top++;
+                continue;
+            case STEP_TERM:
+                b[step->operand] = numberFromSmall(1);
+                top++;
+                continue;
+            case STEP_INDEX:
+                linear = false;
+                continue;
+            case STEP_NEGATE:
+                for (j = 0; j < width; j++) {
+                    replaceNumber(a + j, numberNegate(a[j]));
+                }
+                continue;
+            case STEP_POWER_INTEGER:
+                if (isConstantForm(a, engine->order)) {
+                    replaceNumber(a, numberPower(a[0], step->operand));
+                } else {
+                    linear = step->operand == 1;
+                }
+                continue;
+            default:
+                break;
+        }
+        b = a;
+        a -= width;
+        switch ((SequenceStepKind) step->kind) {
+            case STEP_ADD:
+            case STEP_SUBTRACT:
+                for (j = 0; j < width; j++) {
+                    replaceNumber(a + j, step->kind == STEP_ADD ? numberAdd(a[j], b[j]) : numberSubtract(a[j], b[j]));
+                }
+                break;
+            case STEP_MULTIPLY:
+                if (isConstantForm(a, engine->order)) {
+                    for (j = 0; j < width; j++) {
+                        replaceNumber(b + j, numberMultiply(a[0], b[j]));
+                    }
+                    for (j = 0; j < width; j++) {
+                        Number swap = a[j];
+                        a[j] = b[j];
+                        b[j] = swap;
+                    }
+                } else if (isConstantForm(b, engine->order)) {
+                    for (j = 0; j < width; j++) {
+                        replaceNumber(a + j, numberMultiply(a[j], b[0]));
+                    }
+                } else {
+                    linear = false;
+                }
+                break;
+            case STEP_DIVIDE:
+                if (isConstantForm(b, engine->order)) {
+                    for (j = 0; j < width; j++) {
+                        replaceNumber(a + j, numberDivide(a[j], b[0]));
+                    }
+                } else {
+                    linear = false;
+                }
+                break;
+            default:
+                if (isConstantForm(a, engine->order) && isConstantForm(b, engine->order)) {
+                    replaceNumber(a, powerNumbers(a[0], b[0]));
+                } else {
+                    linear = false;
+                }
+                break;
+        }
+        for (j = 0; j < width; j++) {
+            replaceNumber(b + j, numberFromSmall(0));
+        }
+        top--;
+    }
+    for (j = 0; linear && j < width; j++) {
+        linear = !numberIsError(stack[j]);
+    }
+    if (linear) {
+        coefficients = (Number *) malloc(sizeof(Number) * width);
+        memcpy(coefficients, stack, sizeof(Number) * width);
+        for (j = 0; j < width; j++) {
+            stack[j] = numberFromSmall(0);
+        }
+    }
+    for (j = 0; j < count; j++) {
+        freeNumber(stack[j]);
+    }
+    free(stack);
+    return coefficients;
+}
+
+/*
+ * Linear recurrences move their state, the terms x_{m - 1} down to
+ * x_{m - order} followed by 1, a term forward by multiplying it with the
+ * companion matrix. Its first row holds the coefficients and the constant
+ * term, the rows below shift the terms down and the last keeps the 1.
+ * Raising it to a power by squaring jumps any number of terms in
+ * logarithmic time, in each of the arithmetics below.
+ */
+
+/**
+ * result = a b, a is size by size and b size by columns. result must not alias a or b.
+ */
+static void multiplyNumberMatrices(Number *result, const Number *a, const Number *b, size_t size, size_t columns) {
+    size_t i, j, l;
+    for (i = 0; i < size; i++) {
+        for (j = 0; j < columns; j++) {
+            Number sum = numberFromSmall(0);
+            for (l = 0; l < size; l++) {
+                if (numberIsZero(a[i * size + l]) || numberIsZero(b[l * columns + j])) {
+                    continue;
+                }
+                Number product = numberMultiply(a[i * size + l], b[l * columns + j]);
+                Number next = numberAdd(sum, product);
+                freeNumber(product);
+                freeNumber(sum);
+                sum = next;
+            }
+            replaceNumber(result + i * columns + j, sum);
+        }
+    }
+}
+
+/**
+ * Move a state steps terms forward.
+ * @param state order + 1 numbers, replaced with the later state.
+ */
+static void jumpNumbers(const SequenceEngine *engine, Number *state, uint64_t steps) {
+    size_t size = (size_t) engine->order + 1, i, count = size * size;
+    Number *power = (Number *) malloc(sizeof(Number) * (2 * count + size));
+    Number *scratch = power + count, *vector = scratch + count;
+    for (i = 0; i < 2 * count + size; i++) {
+        power[i] = numberFromSmall(0);
+    }
+    for (i = 1; i <= (size_t) engine->order; i++) {
+        power[i - 1] = copyNumber(engine->coefficients[i]);
+    }
+    power[size - 1] = copyNumber(engine->coefficients[0]);
+    for (i = 1; i < size; i++) { // Shift the terms down, the last row keeps the 1.
+        power[i * size + i - (i < size - 1)] = numberFromSmall(1);
+    }
+    while (steps) {
+        if (steps & 1) {
+            multiplyNumberMatrices(vector, power, state, size, 1);
+            for (i = 0; i < size; i++) {
+                Number swap = state[i];
+                state[i] = vector[i];
+                vector[i] = swap;
+            }
+        }
+        steps >>= 1;
+        if (steps) {
+            multiplyNumberMatrices(scratch, power, power, size, size);
+            for (i = 0; i < count; i++) {
+                Number swap = power[i];
+                power[i] = scratch[i];
+                scratch[i] = swap;
+            }
+        }
+    }
+    for (i = 0; i < 2 * count + size; i++) {
+        freeNumber(power[i]);
+    }
+    free(power);
+}
+
+static void jumpDoubles(const SequenceEngine *engine, double *state, uint64_t steps) {
+    size_t size = (size_t) engine->order + 1, i, j, l, count = size * size;
+    double *power = (double *) calloc(2 * count + size, sizeof(double));
+    double *scratch = power + count, *vector = scratch + count;
+    for (i = 1; i <= (size_t) engine->order; i++) {
+        power[i - 1] = numberToDouble(engine->coefficients[i]);
+    }
+    power[size - 1] = numberToDouble(engine->coefficients[0]);
+    for (i = 1; i < size; i++) {
+        power[i * size + i - (i < size - 1)] = 1;
+    }
+    while (steps) {
+        if (steps & 1) {
+            for (i = 0; i < size; i++) {
+                double sum = 0;
+                for (l = 0; l < size; l++) {
+                    sum += power[i * size + l] * state[l];
+                }
+                vector[i] = sum;
+            }
+            memcpy(state, vector, sizeof(double) * size);
+        }
+        steps >>= 1;
+        if (steps) {
+            for (i = 0; i < size; i++) {
+                for (j = 0; j < size; j++) {
+                    double sum = 0;
+                    for (l = 0; l < size; l++) {
+                        sum += power[i * size + l] * power[l * size + j];
+                    }
+                    scratch[i * size + j] = sum;
+                }
+            }
+            memcpy(power, scratch, sizeof(double) * count);
+        }
+    }
+    free(power);
+}
+
+static void jumpModulo(const uint64_t *coefficients, int order, uint64_t *state, uint64_t steps, uint64_t modulus) {
+    size_t size = (size_t) order + 1, i, j, l, count = size * size;
+    uint64_t *power = (uint64_t *) calloc(2 * count + size, sizeof(uint64_t));
+    uint64_t *scratch = power + count, *vector = scratch + count;
+    for (i = 1; i <= (size_t) order; i++) {
+        power[i - 1] = coefficients[i];
+    }
+    power[size - 1] = coefficients[0];
+    for (i = 1; i < size; i++) {
+        power[i * size + i - (i < size - 1)] = 1 % modulus;
+    }
+    while (steps) {
+        if (steps & 1) {
+            for (i = 0; i < size; i++) {
+                uint64_t sum = 0;
+                for (l = 0; l < size; l++) {
+                    sum = addModulo(sum, multiplyModulo(power[i * size + l], state[l], modulus), modulus);
+                }
+                vector[i] = sum;
+            }
+            memcpy(state, vector, sizeof(uint64_t) * size);
+        }
+        steps >>= 1;
+        if (steps) {
+            for (i = 0; i < size; i++) {
+                for (j = 0; j < size; j++) {
+                    uint64_t sum = 0;
+                    for (l = 0; l < size; l++) {
+                        sum = addModulo(sum, multiplyModulo(power[i * size + l], power[l * size + j], modulus), modulus);
+                    }
+                    scratch[i * size + j] = sum;
+                }
+            }
+            memcpy(power, scratch, sizeof(uint64_t) * count);
+        }
+    }
+    free(power);
+}
+
+/**
+ * Evaluate the rule modulo modulus, window[i % order] holding x_i for the terms before index.
+ * @return false if a division has no inverse.
+ */
+static bool runStepsModulo(const SequenceEngine *engine, const uint64_t *constants, const uint64_t *window,
+                           uint64_t *stack, uint64_t index, uint64_t modulus, uint64_t *result) {
+    uint32_t i, top = 0;
+    uint64_t inverse;
+    for (i = 0; i < engine->stepCount; i++) {
+        const SequenceStep *step = engine->steps + i;
+        uint64_t *a = stack + top - 1, b;
+        switch ((SequenceStepKind) step->kind) {
+            case STEP_CONSTANT:
+                stack[top++] = constants[step->operand];
+                continue;
+            case STEP_INDEX:
+                stack[top++] = index % modulus;
+                continue;
+            case STEP_TERM:
+                stack[top++] = window[(index - step->operand) % engine->order];
+                continue;
+            case STEP_NEGATE:
+                *a = subtractModulo(0, *a, modulus);
+                continue;
+            case STEP_POWER_INTEGER:
+                if (step->operand < 0 && !inverseModulo(*a, modulus, a)) {
+                    return false;
+                }
+                *a = powerModulo(*a, step->operand < 0 ? 0u - (uint64_t) (int64_t) step->operand :
+                                     (uint64_t) step->operand, modulus);
+                continue;
+            default:
+                break;
+        }
+        b = stack[--top];
+        a = stack + top - 1;
+        switch ((SequenceStepKind) step->kind) {
+            case STEP_ADD:
+                *a = addModulo(*a, b, modulus);
+                break;
+            case STEP_SUBTRACT:
+                *a = subtractModulo(*a, b, modulus);
+                break;
+            case STEP_MULTIPLY:
+                *a = multiplyModulo(*a, b, modulus);
+                break;
+            case STEP_DIVIDE:
+                if (!inverseModulo(b, modulus, &inverse)) {
+                    return false;
+                }
+                *a = multiplyModulo(*a, inverse, modulus);
+                break;
+            default: // A power with a variable exponent has no residue.
+                return false;
+        }
+    }
+    *result = stack[0];
+    return true;
+}
+
+/**
+ * Evaluate an initial term, exactly when it is rational.
+ * @return false after issuing an error if it is not a number.
+ */
+static bool evaluateInitial(const Token *token, const SequenceToken *sequence, Number *value) {
+    StepBuilder builder;
+    uint32_t i;
+    bool constant;
+    memset(&builder, 0, sizeof(StepBuilder));
+    constant = compileSteps(&builder, token, sequence);
+    for (i = 0; constant && i < builder.stepCount; i++) {
+        constant = builder.steps[i].kind != STEP_INDEX && builder.steps[i].kind != STEP_TERM;
+    }
+    if (constant) {
+        SequenceEngine scratch;
+        memset(&scratch, 0, sizeof(SequenceEngine));
+        scratch.steps = builder.steps;
+        scratch.stepCount = builder.stepCount;
+        scratch.constants = builder.constants;
+        scratch.stack = (Number *) malloc(sizeof(Number) * stepStackSize(builder.steps, builder.stepCount));
+        *value = runSteps(&scratch, 0);
+        free(scratch.stack);
+        freeStepBuilder(&builder);
+        return true;
+    }
+    freeStepBuilder(&builder);
+    Program *program = compileExpression(token, NULL, 0);
+    if (program == NULL) {
+        return false;
+    }
+    *value = numberFromDouble(runProgram(program, NULL));
+    freeProgram(program);
+    return true;
+}
+
+/**
+ * Load the last order initial terms into the exact window.
+ */
+static void resetExact(SequenceEngine *engine) {
+    uint64_t i;
+    for (i = (uint64_t) (engine->initialCount - engine->order); i < (uint64_t) engine->initialCount; i++) {
+        replaceNumber(engine->window + i % engine->order, copyNumber(engine->initial[i]));
+    }
+    engine->position = (uint64_t) engine->initialCount;
+}
+
+static void resetDouble(SequenceEngine *engine) {
+    double *terms = engine->registers + engine->program->constantCount;
+    int c;
+    for (c = 1; c <= engine->order; c++) {
+        terms[c] = numberToDouble(engine->initial[engine->initialCount - c]);
+    }
+    engine->doublePosition = (uint64_t) engine->initialCount;
+}
+
+SequenceEngine *initSequenceEngine(const SequenceToken *sequence) {
+    int order = findOrder((const Token *) sequence->rule, sequence);
+    int initialCount = sequence->prelist ? sequence->prelist->current : 0;
+    int i;
+    if (order < 0) {
+        return NULL;
+    }
+    if (initialCount < order) {
+        sequenceError(&sequence->token, "A sequence needs at least as many initial terms as its order.");
+        return NULL;
+    }
+    Program *program = compileRule(sequence, order);
+    if (program == NULL) {
+        return NULL;
+    }
+    SequenceEngine *engine = (SequenceEngine *) calloc(1, sizeof(SequenceEngine));
+    engine->order = order;
+    engine->program = program;
+    engine->initial = (Number *) malloc(sizeof(Number) * (initialCount ? initialCount : 1));
+    for (i = 0; i < initialCount; i++) {
+        if (!evaluateInitial(sequence->prelist->members[i], sequence, engine->initial + i)) {
+            freeSequenceEngine(engine);
+            return NULL;
+        }
+        engine->initialCount = i + 1;
+    }
+    StepBuilder builder;
+    memset(&builder, 0, sizeof(StepBuilder));
+    engine->exact = compileSteps(&builder, (const Token *) sequence->rule, sequence);
+    if (!engine->exact) {
+        freeStepBuilder(&builder);
+        memset(&builder, 0, sizeof(StepBuilder));
+    }
+    engine->steps = builder.steps;
+    engine->stepCount = builder.stepCount;
+    engine->constants = builder.constants;
+    engine->constantCount = builder.constantCount;
+    engine->stackSize = stepStackSize(builder.steps, builder.stepCount);
+    engine->stack = (Number *) malloc(sizeof(Number) * engine->stackSize);
+    engine->coefficients = engine->exact && order > 0 ? findCoefficients(engine) : NULL;
+    engine->window = (Number *) malloc(sizeof(Number) * (order ? order : 1));
+    for (i = 0; i < order; i++) {
+        engine->window[i] = numberFromSmall(0);
+    }
+    resetExact(engine);
+    engine->registers = (double *) malloc(sizeof(double) * program->registerCount);
+    loadProgramConstants(program, engine->registers);
+    resetDouble(engine);
+    return engine;
+}
+
+void freeSequenceEngine(SequenceEngine *engine) {
+    int i;
+    uint32_t j;
+    for (i = 0; i < engine->initialCount; i++) {
+        freeNumber(engine->initial[i]);
+    }
+    for (j = 0; j < engine->constantCount; j++) {
+        freeNumber(engine->constants[j]);
+    }
+    if (engine->window != NULL) {
+        for (i = 0; i < engine->order; i++) {
+            freeNumber(engine->window[i]);
+        }
+    }
+    if (engine->coefficients != NULL) {
+        for (i = 0; i <= engine->order; i++) {
+            freeNumber(engine->coefficients[i]);
+        }
+    }
+    free(engine->initial);
+    free(engine->steps);
+    free(engine->constants);
+    free(engine->stack);
+    free(engine->coefficients);
+    free(engine->window);
+    free(engine->registers);
+    freeProgram(engine->program);
+    free(engine);
+}
+
+/**
+ * Compute the exact term at position and slide the window over it.
+ */
+static void stepExact(SequenceEngine *engine) {
+    replaceNumber(engine->window + engine->position % engine->order, runSteps(engine, engine->position));
+    engine->position++;
+}
+
+/**
+ * Move the exact window so the next term is index, jumping when the rule is linear and index is far.
+ * @param index Index at least initialCount.
+ */
+static void seekExact(SequenceEngine *engine, uint64_t index) {
+    int c;
+    if (index < engine->position) {
+        resetExact(engine);
+    }
+    if (engine->coefficients != NULL && index - engine->position >= SEQUENCE_JUMP_THRESHOLD) {
+        Number *state = (Number *) malloc(sizeof(Number) * (engine->order + 1));
+        for (c = 0; c < engine->order; c++) {
+            state[c] = copyNumber(engine->window[(engine->position - 1 - c) % engine->order]);
+        }
+        state[engine->order] = numberFromSmall(1);
+        jumpNumbers(engine, state, index - engine->position);
+        for (c = 0; c < engine->order; c++) { // The state is now x_{index - 1} down to x_{index - order}.
+            replaceNumber(engine->window + (index - 1 - c) % engine->order, state[c]);
+        }
+        freeNumber(state[engine->order]);
+        free(state);
+        engine->position = index;
+    }
+    while (engine->position < index) {
+        stepExact(engine);
+    }
+}
+
+/**
+ * Compute the double term at doublePosition and slide the window over it.
+ * @return the term.
+ */
+static double stepDouble(SequenceEngine *engine) {
+    double *terms = engine->registers + engine->program->constantCount;
+    int c;
+    terms[0] = (double) engine->doublePosition;
+    double term = runProgramRegisters(engine->program, engine->registers);
+    for (c = engine->order; c > 1; c--) {
+        terms[c] = terms[c - 1];
+    }
+    terms[1] = term;
+    engine->doublePosition++;
+    return term;
+}
+
+static void seekDouble(SequenceEngine *engine, uint64_t index) {
+    double *terms = engine->registers + engine->program->constantCount;
+    if (index < engine->doublePosition) {
+        resetDouble(engine);
+    }
+    if (engine->coefficients != NULL && index - engine->doublePosition >= SEQUENCE_JUMP_THRESHOLD) {
+        double *state = (double *) malloc(sizeof(double) * (engine->order + 1));
+        memcpy(state, terms + 1, sizeof(double) * engine->order); // Already x_{m - 1} down to x_{m - order}.
+        state[engine->order] = 1;
+        jumpDoubles(engine, state, index - engine->doublePosition);
+        memcpy(terms + 1, state, sizeof(double) * engine->order);
+        free(state);
+        engine->doublePosition = index;
+    }
+    while (engine->doublePosition < index) {
+        stepDouble(engine);
+    }
+}
+
+Number sequenceTerm(SequenceEngine *engine, uint64_t index) {
+    if (index < (uint64_t) engine->initialCount) {
+        return copyNumber(engine->initial[index]);
+    }
+    if (!engine->exact) {
+        return numberFromDouble(sequenceTermDouble(engine, index));
+    }
+    if (engine->order == 0) {
+        return runSteps(engine, index);
+    }
+    if (index >= engine->position || index + engine->order < engine->position) {
+        seekExact(engine, index);
+        stepExact(engine);
+    }
+    return copyNumber(engine->window[index % engine->order]);
+}
+
+double sequenceTermDouble(SequenceEngine *engine, uint64_t index) {
+    double *terms = engine->registers + engine->program->constantCount;
+    if (index < (uint64_t) engine->initialCount) {
+        return numberToDouble(engine->initial[index]);
+    }
+    if (engine->order == 0) {
+        terms[0] = (double) index;
+        return runProgramRegisters(engine->program, engine->registers);
+    }
+    if (index >= engine->doublePosition || index + engine->order < engine->doublePosition) {
+        seekDouble(engine, index);
+        stepDouble(engine);
+    }
+    return terms[engine->doublePosition - index];
+}
+
+bool sequenceTermModulo(SequenceEngine *engine, uint64_t index, uint64_t modulus, uint64_t *term) {
+    int order = engine->order, c;
+    uint64_t i;
+    uint32_t j;
+    bool defined = true;
+    if (modulus == 0 || !engine->exact) {
+        return false;
+    }
+    if (index < (uint64_t) engine->initialCount) {
+        return numberModulo(engine->initial[index], modulus, term);
+    }
+    // One block for the coefficients or constants, the window, the state and the stack.
+    size_t width = (size_t) order + 1 > engine->constantCount ? (size_t) order + 1 : engine->constantCount;
+    uint64_t *values = (uint64_t *) malloc(sizeof(uint64_t) * (width + 2 * ((size_t) order + 1) + engine->stackSize));
+    uint64_t *window = values + width, *state = window + order + 1, *stack = state + order + 1;
+    for (i = (uint64_t) (engine->initialCount - order); defined && i < (uint64_t) engine->initialCount; i++) {
+        defined = numberModulo(engine->initial[i], modulus, window + i % order);
+    }
+    if (defined && engine->coefficients != NULL) {
+        for (c = 0; defined && c <= order; c++) {
+            defined = numberModulo(engine->coefficients[c], modulus, values + c);
+        }
+        for (c = 0; c < order; c++) {
+            state[c] = window[(engine->initialCount - 1 - c) % order];
+        }
+        state[order] = 1 % modulus;
+        if (defined) {
+            jumpModulo(values, order, state, index + 1 - engine->initialCount, modulus);
+            *term = state[0];
+        }
+    } else if (defined) {
+        for (j = 0; defined && j < engine->constantCount; j++) {
+            defined = numberModulo(engine->constants[j], modulus, values + j);
+        }
+        if (order == 0) {
+            defined = defined && runStepsModulo(engine, values, window, stack, index, modulus, term);
+        }
+        for (i = (uint64_t) engine->initialCount; defined && order > 0 && i <= index; i++) {
+            defined = runStepsModulo(engine, values, window, stack, i, modulus, window + i % order);
+        }
+        if (defined && order > 0) {
+            *term = window[index % order];
+        }
+    }
+    free(values);
+    return defined;
+}
+
+void initSequenceStream(SequenceStream *stream, SequenceEngine *engine, uint64_t start) {
+    stream->engine = engine;
+    stream->index = start;
+}
+
+size_t streamSequenceDoubles(SequenceStream *stream, double *terms, size_t count) {
+    SequenceEngine *engine = stream->engine;
+    double *variables = engine->registers + engine->program->constantCount;
+    size_t i;
+    for (i = 0; i < count && stream->index < (uint64_t) engine->initialCount; i++) {
+        terms[i] = numberToDouble(engine->initial[stream->index++]);
+    }
+    if (i < count && engine->order == 0) {
+        for (; i < count; i++) {
+            variables[0] = (double) stream->index++;
+            terms[i] = runProgramRegisters(engine->program, engine->registers);
+        }
+    }
+    if (i < count) {
+        if (engine->doublePosition != stream->index) { // Another stream or lookup moved the window.
+            seekDouble(engine, stream->index);
+        }
+        for (; i < count; i++) {
+            terms[i] = stepDouble(engine);
+        }
+        stream->index = engine->doublePosition;
+    }
+    return count;
+}
+
+/**
+ * Convert an integer that fits, without allocating.
+ */
+static bool numberToInt64(Number number, int64_t *value) {
+    if (numberIsSmall(number)) {
+        *value = numberSmallValue(number);
+        return true;
+    }
+    if (numberKind(number) == NUMBER_BIG && bigIntFitsInt64(&numberObject(number)->as.integer)) {
+        *value = bigIntToInt64(&numberObject(number)->as.integer);
+        return true;
+    }
+    return false;
+}
+
+size_t streamSequenceIntegers(SequenceStream *stream, int64_t *terms, size_t count) {
+    SequenceEngine *engine = stream->engine;
+    uint64_t index;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        bool integer;
+        index = stream->index;
+        if (index < (uint64_t) engine->initialCount) {
+            integer = numberToInt64(engine->initial[index], terms + i);
+        } else if (!engine->exact) {
+            double value = sequenceTermDouble(engine, index);
+            integer = value == floor(value) && value >= -9223372036854775808.0 && value < 9223372036854775808.0;
+            terms[i] = integer ? (int64_t) value : 0;
+        } else if (engine->order == 0) {
+            Number term = runSteps(engine, index);
+            integer = numberToInt64(term, terms + i);
+            freeNumber(term);
+        } else {
+            if (index >= engine->position || index + engine->order < engine->position) {
+                seekExact(engine, index);
+                stepExact(engine);
+            }
+            integer = numberToInt64(engine->window[index % engine->order], terms + i);
+        }
+        if (!integer) {
+            break;
+        }
+        stream->index++;
+    }
+    return i;
+}
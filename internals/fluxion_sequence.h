@@ -0,0 +1,126 @@
+//
+// Evaluation of the recurrences sequence tokens declare.
+//
+
+#ifndef FLUXIONCORE_FLUXION_SEQUENCE_H
+#define FLUXIONCORE_FLUXION_SEQUENCE_H
+#include "fluxion_number.h"
+#include "fluxion_token.h"
+#include "fluxion_vm.h"
+
+#define SEQUENCE_JUMP_THRESHOLD 64 // Linear recurrences jump with a matrix power when the term is further ahead.
+
+/**
+ * Operations of a rule compiled for exact evaluation, run on a stack.
+ */
+typedef enum {
+    STEP_CONSTANT, // Push constant operand.
+    STEP_INDEX, // Push n.
+    STEP_TERM, // Push x_{n - operand}.
+    STEP_ADD,
+    STEP_SUBTRACT,
+    STEP_MULTIPLY,
+    STEP_DIVIDE,
+    STEP_NEGATE,
+    STEP_POWER_INTEGER, // Raise to the integer operand.
+    STEP_POWER
+} SequenceStepKind;
+
+typedef struct {
+    uint32_t kind;
+    int32_t operand;
+} SequenceStep;
+
+/**
+ * A recurrence prepared for evaluation. Terms are indexed from 0, the initial
+ * terms come first and every later term is computed by the rule from the
+ * order terms before it, x_{n - 1} to x_{n - order}.
+ * Only the last order terms computed are kept, in a ring buffer, so asking
+ * for the terms in increasing index costs a step each.
+ */
+typedef struct {
+    int order;
+    int initialCount;
+    Number *initial; // Initial terms, owned.
+    bool exact; // Whether the rule can be evaluated exactly, otherwise terms are rounded doubles.
+    SequenceStep *steps; // Rule in postfix, when exact.
+    uint32_t stepCount;
+    uint32_t stackSize;
+    Number *constants;
+    uint32_t constantCount;
+    Number *stack; // stackSize numbers the steps run on.
+    Number *coefficients; // For linear rules, order + 1 coefficients, the constant term then the one of x_{n - c} at c. NULL otherwise.
+    Number *window; // The order terms before position, term i at i % order.
+    uint64_t position; // Index of the next exact term.
+    Program *program; // Rule for double evaluation, the variables are n then x_{n - 1} to x_{n - order}.
+    double *registers;
+    uint64_t doublePosition; // Index of the next double term, the registers hold the ones before it.
+} SequenceEngine;
+
+/**
+ * Prepare a sequence for evaluation, finding its order from the
+ * x_{n - c} terms of its rule.
+ * @param sequence Sequence to evaluate, the engine does not refer to it afterwards.
+ * @return the engine, NULL after issuing an error if the sequence can not be evaluated.
+ */
+SequenceEngine *initSequenceEngine(const SequenceToken *sequence);
+void freeSequenceEngine(SequenceEngine *engine);
+/**
+ * Get a term exactly, or as a float if the rule is not rational.
+ * @param engine Engine of the sequence.
+ * @param index Index of the term.
+ * @return the term, owned by the caller.
+ */
+Number sequenceTerm(SequenceEngine *engine, uint64_t index);
+/**
+ * Get a term, computing in doubles.
+ * @param engine Engine of the sequence.
+ * @param index Index of the term.
+ * @return the term, NaN where it is not defined.
+ */
+double sequenceTermDouble(SequenceEngine *engine, uint64_t index);
+/**
+ * Get a term modulo an integer. Linear rules take logarithmic time,
+ * other rules made of ring operations step through every term.
+ * @param engine Engine of the sequence.
+ * @param index Index of the term.
+ * @param modulus Modulus, at least 1.
+ * @param term Set to the term, in [0, modulus).
+ * @return false if the sequence has no value modulo modulus, like a denominator that is not invertible.
+ */
+bool sequenceTermModulo(SequenceEngine *engine, uint64_t index, uint64_t modulus, uint64_t *term);
+
+/**
+ * A position terms of a sequence are streamed from. Streams share the window
+ * of their engine, a stream that finds it elsewhere moves it back first.
+ */
+typedef struct {
+    SequenceEngine *engine;
+    uint64_t index; // Index of the next term.
+} SequenceStream;
+
+/**
+ * Start a stream.
+ * @param stream Stream to initialise.
+ * @param engine Engine of the sequence.
+ * @param start Index of the first term.
+ */
+void initSequenceStream(SequenceStream *stream, SequenceEngine *engine, uint64_t start);
+/**
+ * Write the next terms, computing in doubles.
+ * @param stream Stream to continue.
+ * @param terms Receives count terms.
+ * @param count Number of terms.
+ * @return count.
+ */
+size_t streamSequenceDoubles(SequenceStream *stream, double *terms, size_t count);
+/**
+ * Write the next terms exactly, stopping before a term that is not an integer or does not fit.
+ * @param stream Stream to continue.
+ * @param terms Receives up to count terms.
+ * @param count Number of terms.
+ * @return the number of terms written, the stream stays at the first one that was not.
+ */
+size_t streamSequenceIntegers(SequenceStream *stream, int64_t *terms, size_t count);
+
+#endif //FLUXIONCORE_FLUXION_SEQUENCE_H
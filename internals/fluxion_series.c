@@ -0,0 +1,1037 @@
+//
+// Lazy truncated power series, and limits and series expansions built on them.
+//
+
+#include <string.h>
+#include "fluxion_series.h"
+#include "fluxion_poly.h"
+
+#define SERIES_NONE UINT32_MAX
+
+/*
+ * Kernels on truncated power series, arrays of n exact numbers lowest degree
+ * first. Their arguments are borrowed and their results newly allocated.
+ */
+
+static Number *zeroNumbers(uint32_t count) {
+    Number *numbers = (Number *) malloc(sizeof(Number) * (count ? count : 1));
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        numbers[i] = numberFromSmall(0);
+    }
+    return numbers;
+}
+
+static void freeNumbers(Number *numbers, uint32_t count) {
+    uint32_t i;
+    if (numbers == NULL) {
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        freeNumber(numbers[i]);
+    }
+    free(numbers);
+}
+
+/**
+ * Replace *number with its product by factor.
+ */
+static void scaleNumber(Number *number, Number factor) {
+    Number product = numberMultiply(*number, factor);
+    freeNumber(*number);
+    *number = product;
+}
+
+/**
+ * Numerator and denominator of an exact number, the denominator positive.
+ */
+static void fractionParts(Number number, BigInt *numerator, BigInt *denominator) {
+    switch (numberKind(number)) {
+        case NUMBER_SMALL:
+            bigIntSetInt64(numerator, numberSmallValue(number));
+            bigIntSetInt64(denominator, 1);
+            break;
+        case NUMBER_BIG:
+            bigIntCopy(numerator, &numberObject(number)->as.integer);
+            bigIntSetInt64(denominator, 1);
+            break;
+        default:
+            bigIntCopy(numerator, &numberObject(number)->as.rational.numerator);
+            bigIntCopy(denominator, &numberObject(number)->as.rational.denominator);
+            break;
+    }
+}
+
+/**
+ * Scale fractions to integers by the lcm of their denominators.
+ * @param integers count initialised integers, set to the scaled numerators.
+ * @param scale Set to the lcm.
+ */
+static void toIntegers(const Number *numbers, uint32_t count, BigInt *integers, BigInt *scale) {
+    BigInt denominator, divisor;
+    initBigInt(&denominator);
+    initBigInt(&divisor);
+    bigIntSetInt64(scale, 1);
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        fractionParts(numbers[i], integers + i, &denominator);
+        bigIntGcd(&divisor, scale, &denominator);
+        bigIntDivideExact(&denominator, &denominator, &divisor);
+        bigIntMultiply(scale, scale, &denominator);
+    }
+    for (i = 0; i < count; i++) {
+        fractionParts(numbers[i], &divisor, &denominator);
+        bigIntDivideExact(&denominator, scale, &denominator);
+        bigIntMultiply(integers + i, integers + i, &denominator);
+    }
+    freeBigInt(&denominator);
+    freeBigInt(&divisor);
+}
+
+/**
+ * Product of a and b truncated to n terms. Short products are schoolbook over
+ * fractions, long ones scale both to integers and go through polyMultiplyDense,
+ * which picks Karatsuba or the NTT.
+ */
+static Number *multiplyTruncated(const Number *a, const Number *b, uint32_t n) {
+    uint32_t i, k;
+    if (n < SERIES_FAST_THRESHOLD) {
+        Number *result = zeroNumbers(n);
+        for (i = 0; i < n; i++) {
+            if (numberIsZero(a[i])) {
+                continue;
+            }
+            for (k = 0; i + k < n; k++) {
+                if (!numberIsZero(b[k])) {
+                    Number product = numberMultiply(a[i], b[k]), sum = numberAdd(result[i + k], product);
+                    freeNumber(product);
+                    freeNumber(result[i + k]);
+                    result[i + k] = sum;
+                }
+            }
+        }
+        return result;
+    }
+    BigInt *integers = (BigInt *) malloc(sizeof(BigInt) * (4 * (size_t) n + 2));
+    BigInt *scaleA = integers + 4 * (size_t) n - 1, *scaleB = scaleA + 1, *scale = scaleB + 1;
+    for (i = 0; i < 4 * n + 2; i++) {
+        initBigInt(integers + i);
+    }
+    toIntegers(a, n, integers, scaleA);
+    toIntegers(b, n, integers + n, scaleB);
+    polyMultiplyDense(integers + 2 * n, integers, n, integers + n, n, POLY_MULTIPLY_AUTO);
+    bigIntMultiply(scale, scaleA, scaleB);
+    Number *result = (Number *) malloc(sizeof(Number) * n);
+    for (i = 0; i < n; i++) {
+        BigInt denominator;
+        initBigInt(&denominator);
+        bigIntCopy(&denominator, scale);
+        result[i] = numberFromRational(integers + 2 * n + i, &denominator);
+    }
+    for (i = 0; i < 4 * n + 2; i++) {
+        freeBigInt(integers + i);
+    }
+    free(integers);
+    return result;
+}
+
+/**
+ * 1 / a to n terms by Newton's iteration g <- g (2 - a g), doubling the terms each step.
+ * The constant term of a must not be zero.
+ */
+static Number *inverseTruncated(const Number *a, uint32_t n) {
+    Number *inverse = zeroNumbers(n), one = numberFromSmall(1), two = numberFromSmall(2);
+    freeNumber(inverse[0]);
+    inverse[0] = numberDivide(one, a[0]);
+    uint32_t known = 1, i;
+    while (known < n) {
+        uint32_t next = known * 2 < n ? known * 2 : n;
+        Number *error = multiplyTruncated(a, inverse, next);
+        for (i = 0; i < next; i++) {
+            Number negated = numberNegate(error[i]);
+            freeNumber(error[i]);
+            error[i] = negated;
+        }
+        Number corrected = numberAdd(error[0], two);
+        freeNumber(error[0]);
+        error[0] = corrected;
+        Number *product = multiplyTruncated(inverse, error, next);
+        for (i = 0; i < next; i++) {
+            freeNumber(inverse[i]);
+            inverse[i] = product[i];
+        }
+        free(product);
+        freeNumbers(error, next);
+        known = next;
+    }
+    return inverse;
+}
+
+/**
+ * log a to n terms as the integral of a' / a, the constant term of a must be 1.
+ */
+static Number *logTruncated(const Number *a, uint32_t n) {
+    Number *result = zeroNumbers(n);
+    if (n <= 1) { // No derivative terms, n - 1 would wrap for 0.
+        return result;
+    }
+    Number *derivative = (Number *) malloc(sizeof(Number) * (n - 1));
+    uint32_t i;
+    for (i = 0; i + 1 < n; i++) {
+        Number degree = numberFromSmall(i + 1);
+        derivative[i] = numberMultiply(a[i + 1], degree);
+    }
+    Number *inverse = inverseTruncated(a, n - 1), *quotient = multiplyTruncated(derivative, inverse, n - 1);
+    for (i = 0; i + 1 < n; i++) {
+        Number degree = numberFromSmall(i + 1);
+        freeNumber(result[i + 1]);
+        result[i + 1] = numberDivide(quotient[i], degree);
+    }
+    freeNumbers(quotient, n - 1);
+    freeNumbers(inverse, n - 1);
+    freeNumbers(derivative, n - 1);
+    return result;
+}
+
+/**
+ * exp a to n terms by Newton's iteration g <- g (1 + a - log g), the constant term of a must be 0.
+ */
+static Number *expTruncated(const Number *a, uint32_t n) {
+    Number *exponential = zeroNumbers(n), one = numberFromSmall(1);
+    exponential[0] = one;
+    uint32_t known = 1, i;
+    while (known < n) {
+        uint32_t next = known * 2 < n ? known * 2 : n;
+        Number *correction = logTruncated(exponential, next);
+        for (i = 0; i < next; i++) {
+            Number difference = numberSubtract(a[i], correction[i]);
+            freeNumber(correction[i]);
+            correction[i] = difference;
+        }
+        Number corrected = numberAdd(correction[0], one);
+        freeNumber(correction[0]);
+        correction[0] = corrected;
+        Number *product = multiplyTruncated(exponential, correction, next);
+        for (i = 0; i < next; i++) {
+            freeNumber(exponential[i]);
+            exponential[i] = product[i];
+        }
+        free(product);
+        freeNumbers(correction, next);
+        known = next;
+    }
+    return exponential;
+}
+
+/**
+ * sin a and cos a to n terms, the constant term of a must be 0. Over the
+ * rationals exp(i a) is not available, so they come from s' = c a' and
+ * c' = -s a' term by term, which is quadratic in n.
+ */
+static void sinCosTruncated(const Number *a, uint32_t n, Number **sine, Number **cosine) {
+    Number *s = zeroNumbers(n), *c = zeroNumbers(n);
+    freeNumber(c[0]);
+    c[0] = numberFromSmall(1);
+    uint32_t k, j;
+    for (k = 1; k < n; k++) {
+        Number sumS = numberFromSmall(0), sumC = numberFromSmall(0);
+        for (j = 1; j <= k; j++) {
+            if (numberIsZero(a[j])) {
+                continue;
+            }
+            Number degree = numberFromSmall(j), weighted = numberMultiply(a[j], degree);
+            Number termS = numberMultiply(weighted, c[k - j]), termC = numberMultiply(weighted, s[k - j]);
+            Number nextS = numberAdd(sumS, termS), nextC = numberAdd(sumC, termC);
+            freeNumber(sumS);
+            freeNumber(sumC);
+            freeNumber(termS);
+            freeNumber(termC);
+            freeNumber(weighted);
+            sumS = nextS;
+            sumC = nextC;
+        }
+        Number degree = numberFromSmall(k), negated = numberNegate(sumC);
+        freeNumber(s[k]);
+        freeNumber(c[k]);
+        s[k] = numberDivide(sumS, degree);
+        c[k] = numberDivide(negated, degree);
+        freeNumber(negated);
+        freeNumber(sumS);
+        freeNumber(sumC);
+    }
+    *sine = s;
+    *cosine = c;
+}
+
+/**
+ * outer(inner) to n terms by Horner's rule, the constant term of inner must be 0.
+ */
+static Number *composeTruncated(const Number *outer, const Number *inner, uint32_t n) {
+    Number *result = zeroNumbers(n);
+    freeNumber(result[0]);
+    result[0] = copyNumber(outer[n - 1]);
+    uint32_t k;
+    for (k = n - 1; k-- > 0;) {
+        Number *product = multiplyTruncated(result, inner, n);
+        Number sum = numberAdd(product[0], outer[k]);
+        freeNumber(product[0]);
+        product[0] = sum;
+        freeNumbers(result, n);
+        result = product;
+    }
+    return result;
+}
+
+/**
+ * Integer degree-th root of a non negative integer.
+ * @return false if value is not a perfect power.
+ */
+static bool integerRoot(BigInt *root, const BigInt *value, uint64_t degree) {
+    if (bigIntIsZero(value) || degree == 1) {
+        bigIntCopy(root, value);
+        return true;
+    }
+    BigInt power, quotient, remainder, next;
+    initBigInt(&power);
+    initBigInt(&quotient);
+    initBigInt(&remainder);
+    initBigInt(&next);
+    bigIntSetInt64(root, 1);
+    bigIntShiftLeft(root, root, (bigIntBitLength(value) + degree - 1) / degree); // Above the root.
+    while (true) { // Newton's iteration decreases to the floor of the root.
+        bigIntPower(&power, root, degree - 1);
+        bigIntDivide(&quotient, &remainder, value, &power);
+        bigIntMultiplyLimb(&next, root, (Limb) (degree - 1));
+        bigIntAdd(&next, &next, &quotient);
+        bigIntDivideLimb(&next, &next, (Limb) degree);
+        if (bigIntCompare(&next, root) >= 0) {
+            break;
+        }
+        bigIntSwap(&next, root);
+    }
+    bigIntPower(&power, root, degree);
+    bool exact = bigIntCompare(&power, value) == 0;
+    freeBigInt(&power);
+    freeBigInt(&quotient);
+    freeBigInt(&remainder);
+    freeBigInt(&next);
+    return exact;
+}
+
+/**
+ * number^(numerator / denominator) when it is rational.
+ * @return false if it is not.
+ */
+static bool rationalPower(Number number, int64_t numerator, int64_t denominator, Number *result) {
+    BigInt parts[2], roots[2];
+    int i;
+    for (i = 0; i < 2; i++) {
+        initBigInt(parts + i);
+        initBigInt(roots + i);
+    }
+    fractionParts(number, parts, parts + 1);
+    bool negative = parts[0].negative, exact = !negative || denominator % 2 != 0;
+    bigIntAbs(parts, parts);
+    for (i = 0; i < 2 && exact; i++) {
+        exact = integerRoot(roots + i, parts + i, (uint64_t) denominator);
+    }
+    if (exact) {
+        if (negative) {
+            bigIntNegate(roots, roots);
+        }
+        Number root = numberFromRational(roots, roots + 1);
+        *result = numberPower(root, numerator);
+        freeNumber(root);
+        exact = !numberIsError(*result);
+    }
+    for (i = 0; i < 2; i++) {
+        freeBigInt(parts + i);
+        freeBigInt(roots + i);
+    }
+    return exact;
+}
+
+/*
+ * Lazy series.
+ */
+
+SeriesEngine *initSeriesEngine(void) {
+    return (SeriesEngine *) calloc(1, sizeof(SeriesEngine));
+}
+
+void freeSeriesEngine(SeriesEngine *engine) {
+    if (engine == NULL) {
+        return;
+    }
+    uint32_t i;
+    for (i = 0; i < engine->count; i++) {
+        freeNumber(engine->series[i].parameter);
+        freeNumber(engine->series[i].factor);
+        freeNumbers(engine->series[i].coefficients, engine->series[i].count);
+    }
+    free(engine->series);
+    free(engine);
+}
+
+static SeriesId newSeries(SeriesEngine *engine, SeriesKind kind, SeriesId a, SeriesId b) {
+    if (engine->count == engine->capacity) {
+        engine->capacity = engine->capacity ? engine->capacity * 2 : 64;
+        engine->series = (Series *) realloc(engine->series, sizeof(Series) * engine->capacity);
+    }
+    Series *series = engine->series + engine->count;
+    memset(series, 0, sizeof(Series));
+    series->kind = kind;
+    series->operands[0] = a;
+    series->operands[1] = b;
+    series->parameter = numberFromSmall(0);
+    series->factor = numberFromSmall(0);
+    series->failed = (a != SERIES_NONE && engine->series[a].failed) || (b != SERIES_NONE && engine->series[b].failed);
+    return engine->count++;
+}
+
+static bool extendSeries(SeriesEngine *engine, SeriesId id, uint32_t count);
+
+/**
+ * Coefficients of t^from to t^(from + count - 1) of a series, extending it as needed.
+ * @return the coefficients, NULL if it failed or would need too many terms.
+ */
+static Number *seriesWindow(SeriesEngine *engine, SeriesId id, int32_t from, uint32_t count) {
+    int64_t needed = (int64_t) from + count - engine->series[id].valuation;
+    if (needed > 0 && !extendSeries(engine, id, (uint32_t) needed)) {
+        return NULL;
+    }
+    const Series *series = engine->series + id;
+    Number *window = (Number *) malloc(sizeof(Number) * (count ? count : 1));
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        int64_t index = (int64_t) from + i - series->valuation;
+        window[i] = index < 0 ? numberFromSmall(0) : copyNumber(series->coefficients[index]);
+    }
+    return window;
+}
+
+/**
+ * Terms of a result whose computed prefix starts at t^base, kept from t^from on.
+ * @param computed length coefficients from t^base, taken.
+ */
+static Number *placeWindow(int32_t from, uint32_t count, int32_t base, Number *computed, int64_t length) {
+    Number *window = zeroNumbers(count);
+    int64_t i;
+    for (i = 0; i < length; i++) {
+        int64_t index = base + i - (int64_t) from;
+        if (index >= 0 && index < count) {
+            freeNumber(window[index]);
+            window[index] = computed[i];
+        } else {
+            freeNumber(computed[i]);
+        }
+    }
+    free(computed);
+    return window;
+}
+
+/**
+ * Compute count coefficients of a series from t^from on, from those of its operands.
+ * @return the coefficients, NULL if an operand could not give enough.
+ */
+static Number *computeWindow(SeriesEngine *engine, SeriesId id, int32_t from, uint32_t count) {
+    Series series = engine->series[id];
+    SeriesId a = series.operands[0], b = series.operands[1];
+    int32_t validA = a != SERIES_NONE ? engine->series[a].valuation : 0;
+    int32_t validB = b != SERIES_NONE ? engine->series[b].valuation : 0;
+    Number *window = NULL, *first = NULL, *second = NULL, *computed = NULL, *other;
+    int32_t base;
+    uint32_t i;
+    switch ((SeriesKind) series.kind) {
+        case SERIES_CONSTANT:
+        case SERIES_VARIABLE:
+            window = zeroNumbers(count);
+            base = series.kind == SERIES_CONSTANT ? 0 : 1;
+            if (base >= from && base - from < (int64_t) count) {
+                freeNumber(window[base - from]);
+                window[base - from] = series.kind == SERIES_CONSTANT ? copyNumber(series.parameter) :
+                                      numberFromSmall(1);
+            }
+            return window;
+        case SERIES_ADD:
+        case SERIES_SUBTRACT:
+            first = seriesWindow(engine, a, from, count);
+            second = first != NULL ? seriesWindow(engine, b, from, count) : NULL;
+            if (second != NULL) {
+                window = (Number *) malloc(sizeof(Number) * count);
+                for (i = 0; i < count; i++) {
+                    window[i] = series.kind == SERIES_ADD ? numberAdd(first[i], second[i]) :
+                                numberSubtract(first[i], second[i]);
+                }
+            }
+            freeNumbers(first, first != NULL ? count : 0);
+            freeNumbers(second, second != NULL ? count : 0);
+            return window;
+        case SERIES_MULTIPLY:
+        case SERIES_DIVIDE:
+        case SERIES_POWER:
+        case SERIES_ABS:
+            // Products start at the sum of the valuations, quotients at their difference, b is normalised.
+            base = series.kind == SERIES_MULTIPLY ? validA + validB : series.kind == SERIES_DIVIDE ? validA - validB :
+                   series.kind == SERIES_POWER ? series.valuation : validA;
+            break;
+        default: // Functions of a power series with a rational constant term.
+            base = 0;
+            break;
+    }
+    int64_t length = (int64_t) from + count - base;
+    if (length <= 0) {
+        return zeroNumbers(count);
+    }
+    if (length > SERIES_MAX_TERMS) {
+        return NULL;
+    }
+    uint32_t n = (uint32_t) length;
+    bool fromValuation = series.kind == SERIES_MULTIPLY || series.kind == SERIES_DIVIDE ||
+                         series.kind == SERIES_POWER || series.kind == SERIES_ABS;
+    first = seriesWindow(engine, a, fromValuation ? validA : 0, n);
+    if (first == NULL) {
+        return NULL;
+    }
+    if (series.kind == SERIES_MULTIPLY || series.kind == SERIES_DIVIDE || series.kind == SERIES_COMPOSE) {
+        second = seriesWindow(engine, b, series.kind == SERIES_COMPOSE ? 0 : validB, n);
+        if (second == NULL) {
+            freeNumbers(first, n);
+            return NULL;
+        }
+    }
+    switch ((SeriesKind) series.kind) {
+        case SERIES_MULTIPLY:
+            computed = multiplyTruncated(first, second, n);
+            break;
+        case SERIES_DIVIDE:
+            other = inverseTruncated(second, n);
+            computed = multiplyTruncated(first, other, n);
+            freeNumbers(other, n);
+            break;
+        case SERIES_POWER: // c^r (a / c)^r, a / c starts with 1 so the power is exp(r log(a / c)).
+            other = inverseTruncated(first, 1);
+            for (i = 0; i < n; i++) {
+                scaleNumber(first + i, other[0]);
+            }
+            freeNumbers(other, 1);
+            other = logTruncated(first, n);
+            for (i = 0; i < n; i++) {
+                scaleNumber(other + i, series.parameter);
+            }
+            computed = expTruncated(other, n);
+            freeNumbers(other, n);
+            for (i = 0; i < n; i++) {
+                scaleNumber(computed + i, series.factor);
+            }
+            break;
+        case SERIES_EXP:
+            computed = expTruncated(first, n);
+            break;
+        case SERIES_LOG:
+            computed = logTruncated(first, n);
+            break;
+        case SERIES_SIN:
+        case SERIES_COS:
+            sinCosTruncated(first, n, &computed, &other);
+            if (series.kind == SERIES_COS) {
+                Number *swap = computed;
+                computed = other;
+                other = swap;
+            }
+            freeNumbers(other, n);
+            break;
+        case SERIES_ABS:
+            computed = first;
+            first = NULL;
+            for (i = 0; i < n; i++) {
+                scaleNumber(computed + i, series.parameter);
+            }
+            break;
+        default:
+            computed = composeTruncated(first, second, n);
+            break;
+    }
+    freeNumbers(first, first != NULL ? n : 0);
+    freeNumbers(second, second != NULL ? n : 0);
+    return placeWindow(from, count, base, computed, n);
+}
+
+/**
+ * Make sure a series knows its first count coefficients, at least doubling the known ones.
+ * @return false if it failed or would need more than SERIES_MAX_TERMS.
+ */
+static bool extendSeries(SeriesEngine *engine, SeriesId id, uint32_t count) {
+    Series *series = engine->series + id;
+    if (series->failed || count > SERIES_MAX_TERMS) {
+        return false;
+    }
+    if (count <= series->count) {
+        return true;
+    }
+    uint32_t target = series->count * 2 > count ? series->count * 2 : count;
+    target = target < SERIES_MAX_TERMS ? target : SERIES_MAX_TERMS;
+    Number *coefficients = computeWindow(engine, id, series->valuation, target);
+    if (coefficients == NULL) {
+        return false;
+    }
+    series = engine->series + id;
+    engine->computed += target - series->count;
+    freeNumbers(series->coefficients, series->count);
+    series->coefficients = coefficients;
+    series->count = target;
+    series->capacity = target;
+    return true;
+}
+
+bool seriesCoefficient(SeriesEngine *engine, SeriesId series, int32_t exponent, Number *coefficient) {
+    int64_t index = (int64_t) exponent - engine->series[series].valuation;
+    if (engine->series[series].failed || index >= SERIES_MAX_TERMS) {
+        return false;
+    }
+    if (index < 0) {
+        *coefficient = numberFromSmall(0);
+        return true;
+    }
+    if (!extendSeries(engine, series, (uint32_t) index + 1)) {
+        return false;
+    }
+    *coefficient = copyNumber(engine->series[series].coefficients[index]);
+    return true;
+}
+
+bool seriesLeadingTerm(SeriesEngine *engine, SeriesId series, int32_t *exponent, Number *coefficient) {
+    uint32_t index;
+    for (index = 0; index <= SERIES_MAX_ZEROS; index++) {
+        if (!extendSeries(engine, series, index + 1)) {
+            return false;
+        }
+        Series *found = engine->series + series;
+        if (numberIsZero(found->coefficients[index])) {
+            continue;
+        }
+        if (index > 0) { // Raise the valuation past the zeros, the leading coefficient comes first from now on.
+            uint32_t i;
+            for (i = 0; i < index; i++) {
+                freeNumber(found->coefficients[i]);
+            }
+            memmove(found->coefficients, found->coefficients + index, sizeof(Number) * (found->count - index));
+            found->count -= index;
+            found->valuation += (int32_t) index;
+        }
+        *exponent = found->valuation;
+        if (coefficient != NULL) {
+            *coefficient = copyNumber(found->coefficients[0]);
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Check the coefficients of t^exponent for every exponent up to 0 are zero,
+ * so the series is a power series vanishing at 0.
+ */
+static bool vanishes(SeriesEngine *engine, SeriesId series, int32_t last) {
+    int32_t exponent;
+    for (exponent = engine->series[series].valuation; exponent <= last; exponent++) {
+        Number coefficient;
+        if (!seriesCoefficient(engine, series, exponent, &coefficient)) {
+            return false;
+        }
+        bool zero = numberIsZero(coefficient);
+        freeNumber(coefficient);
+        if (!zero) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SeriesId seriesConstant(SeriesEngine *engine, Number value) {
+    SeriesId id = newSeries(engine, SERIES_CONSTANT, SERIES_NONE, SERIES_NONE);
+    engine->series[id].parameter = value;
+    engine->series[id].failed = numberIsError(value) || numberKind(value) == NUMBER_FLOAT;
+    return id;
+}
+
+SeriesId seriesVariable(SeriesEngine *engine) {
+    SeriesId id = newSeries(engine, SERIES_VARIABLE, SERIES_NONE, SERIES_NONE);
+    engine->series[id].valuation = 1;
+    return id;
+}
+
+SeriesId seriesAdd(SeriesEngine *engine, SeriesId a, SeriesId b) {
+    SeriesId id = newSeries(engine, SERIES_ADD, a, b);
+    int32_t validA = engine->series[a].valuation, validB = engine->series[b].valuation;
+    engine->series[id].valuation = validA < validB ? validA : validB;
+    return id;
+}
+
+SeriesId seriesSubtract(SeriesEngine *engine, SeriesId a, SeriesId b) {
+    SeriesId id = seriesAdd(engine, a, b);
+    engine->series[id].kind = SERIES_SUBTRACT;
+    return id;
+}
+
+SeriesId seriesMultiply(SeriesEngine *engine, SeriesId a, SeriesId b) {
+    SeriesId id = newSeries(engine, SERIES_MULTIPLY, a, b);
+    engine->series[id].valuation = engine->series[a].valuation + engine->series[b].valuation;
+    return id;
+}
+
+SeriesId seriesDivide(SeriesEngine *engine, SeriesId a, SeriesId b) {
+    int32_t exponent = 0;
+    bool found = !engine->series[a].failed && seriesLeadingTerm(engine, b, &exponent, NULL);
+    SeriesId id = newSeries(engine, SERIES_DIVIDE, a, b);
+    engine->series[id].valuation = engine->series[a].valuation - exponent;
+    engine->series[id].failed = !found;
+    return id;
+}
+
+SeriesId seriesPower(SeriesEngine *engine, SeriesId base, Number exponent) {
+    BigInt numerator, denominator;
+    initBigInt(&numerator);
+    initBigInt(&denominator);
+    int32_t valuation = 0;
+    Number leading = numberFromSmall(0), factor = numberFromSmall(0);
+    bool fits = !numberIsError(exponent) && numberKind(exponent) != NUMBER_FLOAT;
+    if (fits) {
+        fractionParts(exponent, &numerator, &denominator);
+        fits = bigIntFitsInt64(&numerator) && bigIntFitsInt64(&denominator);
+    }
+    if (fits && seriesLeadingTerm(engine, base, &valuation, &leading)) {
+        int64_t p = bigIntToInt64(&numerator), q = bigIntToInt64(&denominator), shifted = (int64_t) valuation * p;
+        // An even root of t^k is |t|^(k / q), it is t^(k / q) on both sides only for even k and k p / q.
+        fits = p > -SERIES_MAX_TERMS && p < SERIES_MAX_TERMS && q < SERIES_MAX_TERMS && shifted % q == 0 &&
+               shifted / q > -SERIES_MAX_TERMS && shifted / q < SERIES_MAX_TERMS &&
+               (q % 2 != 0 || (valuation % 2 == 0 && shifted / q % 2 == 0)) && rationalPower(leading, p, q, &factor);
+        valuation = fits ? (int32_t) (shifted / q) : 0;
+    } else {
+        fits = false;
+    }
+    SeriesId id = newSeries(engine, SERIES_POWER, base, SERIES_NONE);
+    Series *series = engine->series + id;
+    freeNumber(series->parameter);
+    freeNumber(series->factor);
+    series->parameter = exponent;
+    series->factor = factor;
+    series->valuation = valuation;
+    series->failed = !fits;
+    freeNumber(leading);
+    freeBigInt(&numerator);
+    freeBigInt(&denominator);
+    return id;
+}
+
+/**
+ * exp, sin or cos of a series, which has to vanish at 0.
+ */
+static SeriesId seriesOfVanishing(SeriesEngine *engine, SeriesKind kind, SeriesId argument) {
+    bool valid = vanishes(engine, argument, 0);
+    SeriesId id = newSeries(engine, kind, argument, SERIES_NONE);
+    engine->series[id].failed = !valid;
+    return id;
+}
+
+SeriesId seriesExp(SeriesEngine *engine, SeriesId argument) {
+    return seriesOfVanishing(engine, SERIES_EXP, argument);
+}
+
+SeriesId seriesSin(SeriesEngine *engine, SeriesId argument) {
+    return seriesOfVanishing(engine, SERIES_SIN, argument);
+}
+
+SeriesId seriesCos(SeriesEngine *engine, SeriesId argument) {
+    return seriesOfVanishing(engine, SERIES_COS, argument);
+}
+
+SeriesId seriesLog(SeriesEngine *engine, SeriesId argument) {
+    int32_t exponent;
+    Number leading = numberFromSmall(0), one = numberFromSmall(1);
+    bool valid = seriesLeadingTerm(engine, argument, &exponent, &leading) && exponent == 0 &&
+                 numberCompare(leading, one) == 0;
+    freeNumber(leading);
+    SeriesId id = newSeries(engine, SERIES_LOG, argument, SERIES_NONE);
+    engine->series[id].failed = !valid;
+    return id;
+}
+
+SeriesId seriesAbs(SeriesEngine *engine, SeriesId argument) {
+    int32_t exponent = 0;
+    Number leading = numberFromSmall(0);
+    bool valid = seriesLeadingTerm(engine, argument, &exponent, &leading) && exponent % 2 == 0;
+    SeriesId id = newSeries(engine, SERIES_ABS, argument, SERIES_NONE);
+    engine->series[id].parameter = numberFromSmall(numberSign(leading) < 0 ? -1 : 1);
+    engine->series[id].valuation = exponent;
+    engine->series[id].failed = !valid;
+    freeNumber(leading);
+    return id;
+}
+
+SeriesId seriesCompose(SeriesEngine *engine, SeriesId outer, SeriesId inner) {
+    bool valid = vanishes(engine, inner, 0) && vanishes(engine, outer, -1);
+    SeriesId id = newSeries(engine, SERIES_COMPOSE, outer, inner);
+    engine->series[id].failed = !valid;
+    return id;
+}
+
+/*
+ * Expressions.
+ */
+
+/**
+ * Value of a node made of exact numbers and arithmetic on them.
+ * @return false if it is not one.
+ */
+static bool constantOf(const NodePool *pool, NodeId node, Number *value) {
+    uint8_t tag = nodeTag(pool, node);
+    if (tag == NODE_NUMBER) {
+        *value = copyNumber(nodeNumberOf(pool, node));
+        return numberKind(*value) != NUMBER_FLOAT && !numberIsError(*value);
+    }
+    if (!nodeIsOperator(pool, node) || (tag != PLUS && tag != MINUS && tag != MULTIPLY && tag != DIVIDE)) {
+        return false;
+    }
+    Number a, b;
+    if (!constantOf(pool, nodeChild(pool, node, 0), &a)) {
+        return false;
+    }
+    if (nodeChildCount(pool, node) == 1) {
+        *value = tag == MINUS ? numberNegate(a) : copyNumber(a);
+        freeNumber(a);
+        return true;
+    }
+    if (!constantOf(pool, nodeChild(pool, node, 1), &b)) {
+        freeNumber(a);
+        return false;
+    }
+    *value = tag == PLUS ? numberAdd(a, b) : tag == MINUS ? numberSubtract(a, b) :
+             tag == MULTIPLY ? numberMultiply(a, b) : numberDivide(a, b);
+    freeNumber(a);
+    freeNumber(b);
+    return !numberIsError(*value);
+}
+
+/**
+ * Series of a node, given the series of its children.
+ */
+static SeriesId seriesStep(SeriesEngine *engine, const NodePool *pool, NodeId node, const NodeSubtree *subtree,
+                           const SeriesId *values, uint32_t variable, Number point) {
+    uint8_t tag = nodeTag(pool, node);
+    Number exponent;
+    switch (tag) {
+        case NODE_NUMBER:
+            return seriesConstant(engine, copyNumber(nodeNumberOf(pool, node)));
+        case NODE_SYMBOL:
+            if (nodeSymbolOf(pool, node) != variable) {
+                break;
+            }
+            return seriesAdd(engine, seriesConstant(engine, copyNumber(point)), seriesVariable(engine));
+        case NODE_CALL:
+            if (nodeChildCount(pool, node) != 2) {
+                break;
+            }
+            SeriesId argument = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 1))];
+            switch (nodeSymbolOf(pool, nodeChild(pool, node, 0))) {
+                case SYMBOL_SIN:
+                    return seriesSin(engine, argument);
+                case SYMBOL_COS:
+                    return seriesCos(engine, argument);
+                case SYMBOL_TAN:
+                    return seriesDivide(engine, seriesSin(engine, argument), seriesCos(engine, argument));
+                case SYMBOL_EXP:
+                    return seriesExp(engine, argument);
+                case SYMBOL_LOG:
+                    return seriesLog(engine, argument);
+                case SYMBOL_SQRT:
+                    return seriesPower(engine, argument, numberDivide(numberFromSmall(1), numberFromSmall(2)));
+                case SYMBOL_ABS:
+                    return seriesAbs(engine, argument);
+                default:
+                    break;
+            }
+            break;
+        default:
+            if (tag >= NODE_NUMBER) {
+                break;
+            }
+            SeriesId a = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 0))];
+            if (nodeChildCount(pool, node) == 1) {
+                if (tag == PLUS) {
+                    return a;
+                }
+                if (tag == MINUS) {
+                    return seriesSubtract(engine, seriesConstant(engine, numberFromSmall(0)), a);
+                }
+                break;
+            }
+            SeriesId b = values[nodeSubtreePosition(subtree, nodeChild(pool, node, 1))];
+            switch ((OperatorType) tag) {
+                case PLUS:
+                    return seriesAdd(engine, a, b);
+                case MINUS:
+                    return seriesSubtract(engine, a, b);
+                case MULTIPLY:
+                    return seriesMultiply(engine, a, b);
+                case DIVIDE:
+                    return seriesDivide(engine, a, b);
+                case POWER:
+                    if (constantOf(pool, nodeChild(pool, node, 1), &exponent)) {
+                        return seriesPower(engine, a, exponent);
+                    }
+                    return seriesExp(engine, seriesMultiply(engine, b, seriesLog(engine, a))); // a^b = exp(b log a).
+                default:
+                    break;
+            }
+            break;
+    }
+    return seriesConstant(engine, numberError(Undefined));
+}
+
+SeriesId seriesFromNode(SeriesEngine *engine, const NodePool *pool, NodeId node, uint32_t variable, Number point) {
+    if (node == NODE_NONE) {
+        return seriesConstant(engine, numberError(Undefined));
+    }
+    NodeSubtree subtree; // Children before their parents, so each is converted after its children.
+    initNodeSubtree(&subtree, pool, node, true);
+    SeriesId *values = (SeriesId *) malloc(sizeof(SeriesId) * subtree.count);
+    uint32_t i;
+    for (i = 0; i < subtree.count; i++) {
+        values[i] = seriesStep(engine, pool, subtree.nodes[i], &subtree, values, variable, point);
+    }
+    SeriesId result = values[subtree.count - 1];
+    free(values);
+    freeNodeSubtree(&subtree);
+    return result;
+}
+
+NodeId limitNode(NodePool *pool, NodeId node, uint32_t variable, Number point) {
+    SeriesEngine *engine = initSeriesEngine();
+    SeriesId series = seriesFromNode(engine, pool, node, variable, point);
+    Number limit = numberFromSmall(0);
+    // Finite when every negative power vanishes, the limit is then the constant term.
+    bool finite = !engine->series[series].failed && vanishes(engine, series, -1) &&
+                  seriesCoefficient(engine, series, 0, &limit);
+    freeSeriesEngine(engine);
+    return finite ? nodeExactNumber(pool, nodeLine(pool, node), limit) : NODE_NONE;
+}
+
+NodeId seriesNode(NodePool *pool, NodeId node, uint32_t variable, Number point, int32_t order) {
+    SeriesEngine *engine = initSeriesEngine();
+    SeriesId series = seriesFromNode(engine, pool, node, variable, point);
+    int line = nodeLine(pool, node);
+    NodeId sum = NODE_NONE, base = nodeSymbolIndex(pool, line, variable);
+    if (!numberIsZero(point)) {
+        base = nodeBinary(pool, line, MINUS, base, nodeExactNumber(pool, line, copyNumber(point)));
+    }
+    int32_t exponent;
+    bool failed = engine->series[series].failed;
+    for (exponent = engine->series[series].valuation; exponent <= order && !failed; exponent++) {
+        Number coefficient;
+        if (!seriesCoefficient(engine, series, exponent, &coefficient)) {
+            failed = true;
+            break;
+        }
+        if (numberIsZero(coefficient)) {
+            freeNumber(coefficient);
+            continue;
+        }
+        bool subtract = sum != NODE_NONE && numberSign(coefficient) < 0;
+        if (subtract) {
+            Number negated = numberNegate(coefficient);
+            freeNumber(coefficient);
+            coefficient = negated;
+        }
+        NodeId term = base;
+        if (exponent != 1 && exponent != 0) {
+            term = nodeBinary(pool, line, POWER, base, nodeExactNumber(pool, line, numberFromSmall(exponent)));
+        }
+        Number one = numberFromSmall(1);
+        if (exponent == 0) {
+            term = nodeExactNumber(pool, line, coefficient);
+        } else if (numberCompare(coefficient, one) == 0) {
+            freeNumber(coefficient);
+        } else {
+            term = nodeBinary(pool, line, MULTIPLY, nodeExactNumber(pool, line, coefficient), term);
+        }
+        sum = sum == NODE_NONE ? term : nodeBinary(pool, line, subtract ? MINUS : PLUS, sum, term);
+    }
+    freeSeriesEngine(engine);
+    if (failed) {
+        return NODE_NONE;
+    }
+    return sum != NODE_NONE ? sum : nodeExactNumber(pool, line, numberFromSmall(0));
+}
+
+/**
+ * Value of a lim or series call, given its arguments.
+ * @return the value, NODE_NONE if it is malformed or has none.
+ */
+static NodeId expandCall(NodePool *pool, uint32_t function, const NodeId *arguments, uint32_t count) {
+    NodeId approach = arguments[1];
+    if (count != (function == SYMBOL_LIM ? 2u : 3u) || !nodeIsOperator(pool, approach) ||
+        nodeTag(pool, approach) != LIMIT || nodeChildCount(pool, approach) != 2 ||
+        nodeTag(pool, nodeChild(pool, approach, 0)) != NODE_SYMBOL) {
+        return NODE_NONE;
+    }
+    uint32_t variable = nodeSymbolOf(pool, nodeChild(pool, approach, 0));
+    Number point, order = numberFromSmall(0);
+    if (!constantOf(pool, nodeChild(pool, approach, 1), &point)) {
+        return NODE_NONE;
+    }
+    NodeId result = NODE_NONE;
+    if (function == SYMBOL_LIM) {
+        result = limitNode(pool, arguments[0], variable, point);
+    } else if (constantOf(pool, arguments[2], &order) && numberKind(order) == NUMBER_SMALL &&
+               numberSmallValue(order) >= 0 && numberSmallValue(order) < SERIES_MAX_TERMS) {
+        result = seriesNode(pool, arguments[0], variable, point, (int32_t) numberSmallValue(order));
+    }
+    freeNumber(order);
+    freeNumber(point);
+    return result;
+}
+
+NodeId expandLimits(NodePool *pool, NodeId node) {
+    if (node == NODE_NONE) {
+        return NODE_NONE;
+    }
+    NodeSubtree subtree;
+    initNodeSubtree(&subtree, pool, node, true);
+    NodeId *expanded = (NodeId *) malloc(sizeof(NodeId) * subtree.count);
+    NodeId children[8];
+    uint32_t position;
+    for (position = 0; position < subtree.count; position++) {
+        NodeId id = subtree.nodes[position];
+        uint8_t tag = nodeTag(pool, id);
+        expanded[position] = id;
+        if (tag == NODE_NUMBER || tag == NODE_SYMBOL) {
+            continue;
+        }
+        uint32_t count = nodeChildCount(pool, id), i;
+        NodeId *rebuilt = count <= 8 ? children : (NodeId *) malloc(sizeof(NodeId) * count);
+        bool changed = false, failed = false;
+        for (i = 0; i < count; i++) {
+            rebuilt[i] = expanded[nodeSubtreePosition(&subtree, nodeChild(pool, id, i))];
+            changed = changed || rebuilt[i] != nodeChild(pool, id, i);
+            failed = failed || rebuilt[i] == NODE_NONE;
+        }
+        uint32_t function = tag == NODE_CALL ? nodeSymbolOf(pool, rebuilt[0]) : 0;
+        if (failed) {
+            expanded[position] = NODE_NONE;
+        } else if (tag == NODE_CALL && (function == SYMBOL_LIM || function == SYMBOL_SERIES)) {
+            expanded[position] = expandCall(pool, function, rebuilt + 1, count - 1);
+        } else if (changed && tag == NODE_CALL) {
+            expanded[position] = nodeCall(pool, nodeLine(pool, id), function, rebuilt + 1, count - 1);
+        } else if (changed) {
+            expanded[position] = nodeOperator(pool, nodeLine(pool, id), (OperatorType) tag, rebuilt, count);
+        }
+        if (rebuilt != children) {
+            free(rebuilt);
+        }
+    }
+    NodeId result = expanded[subtree.count - 1];
+    free(expanded);
+    freeNodeSubtree(&subtree);
+    return result;
+}
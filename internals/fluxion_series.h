@@ -0,0 +1,146 @@
+//
+// Lazy truncated power series, and limits and series expansions built on them.
+//
+
+#ifndef FLUXIONCORE_FLUXION_SERIES_H
+#define FLUXIONCORE_FLUXION_SERIES_H
+#include "fluxion_node.h"
+
+#define SERIES_MAX_TERMS 4096 // Coefficients a series computes at most.
+#define SERIES_MAX_ZEROS 64 // Zero coefficients looked past for a leading term before giving up.
+#define SERIES_FAST_THRESHOLD 24 // Terms from which products go through the integer polynomial kernels.
+
+/**
+ * Index of a series inside its engine.
+ */
+typedef uint32_t SeriesId;
+
+typedef enum {
+    SERIES_CONSTANT, // parameter.
+    SERIES_VARIABLE, // t.
+    SERIES_ADD,
+    SERIES_SUBTRACT,
+    SERIES_MULTIPLY,
+    SERIES_DIVIDE,
+    SERIES_POWER, // To the rational parameter, factor is the leading coefficient to it.
+    SERIES_EXP,
+    SERIES_LOG,
+    SERIES_SIN,
+    SERIES_COS,
+    SERIES_ABS,
+    SERIES_COMPOSE // The first operand of the second.
+} SeriesKind;
+
+/**
+ * A Laurent series in t with rational coefficients, coefficients[i] is the
+ * coefficient of t^(valuation + i). No coefficient is computed before it is
+ * asked for, asking for one computes the cached prefix up to it, at least
+ * doubling it, so the products and Newton iterations the prefixes are made
+ * of run on long blocks through the fast polynomial kernels. The valuation
+ * is a lower bound, raised once the leading term is looked for.
+ */
+typedef struct {
+    uint8_t kind;
+    bool failed; // The series has a coefficient that is not rational, or a leading term was not found.
+    int32_t valuation;
+    SeriesId operands[2];
+    Number parameter;
+    Number factor;
+    Number *coefficients;
+    uint32_t count;
+    uint32_t capacity;
+} Series;
+
+/**
+ * Owns series and frees them all at once, like a node pool. Series are
+ * built from their operands, which are created first and never change.
+ */
+typedef struct {
+    Series *series;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t computed; // Coefficients computed, for profiling.
+} SeriesEngine;
+
+SeriesEngine *initSeriesEngine(void);
+void freeSeriesEngine(SeriesEngine *engine);
+
+/**
+ * A constant series.
+ * @param value Exact number to take.
+ */
+SeriesId seriesConstant(SeriesEngine *engine, Number value);
+/**
+ * The series t.
+ */
+SeriesId seriesVariable(SeriesEngine *engine);
+/*
+ * Arithmetic, a failed operand or a division by a series whose leading term is not found fails the result.
+ */
+SeriesId seriesAdd(SeriesEngine *engine, SeriesId a, SeriesId b);
+SeriesId seriesSubtract(SeriesEngine *engine, SeriesId a, SeriesId b);
+SeriesId seriesMultiply(SeriesEngine *engine, SeriesId a, SeriesId b);
+SeriesId seriesDivide(SeriesEngine *engine, SeriesId a, SeriesId b);
+/**
+ * Raise to a rational power c t^v (1 + ...) -> c^r t^(v r) (1 + ...)^r.
+ * @param exponent Exact number to take.
+ * @return the power, failed if v r is not an integer or c^r is not rational, or for an
+ * even root unless v and v r are even, since it is |t|^(v r) otherwise.
+ */
+SeriesId seriesPower(SeriesEngine *engine, SeriesId base, Number exponent);
+/*
+ * Elementary functions. Their value at t = 0 has to be rational, so the
+ * argument of exp, sin and cos has to vanish at 0 and that of log be 1 there,
+ * the result fails otherwise. abs needs a leading term of even degree.
+ */
+SeriesId seriesExp(SeriesEngine *engine, SeriesId argument);
+SeriesId seriesLog(SeriesEngine *engine, SeriesId argument);
+SeriesId seriesSin(SeriesEngine *engine, SeriesId argument);
+SeriesId seriesCos(SeriesEngine *engine, SeriesId argument);
+SeriesId seriesAbs(SeriesEngine *engine, SeriesId argument);
+/**
+ * Compose, outer(inner(t)), by Horner's rule on truncated prefixes.
+ * @return the composition, failed if inner does not vanish at 0 or outer has negative powers.
+ */
+SeriesId seriesCompose(SeriesEngine *engine, SeriesId outer, SeriesId inner);
+
+/**
+ * Coefficient of t^exponent, computing it if it is not known yet.
+ * @param coefficient Set to the coefficient, owned by the caller.
+ * @return false if the series failed or exponent is beyond SERIES_MAX_TERMS.
+ */
+bool seriesCoefficient(SeriesEngine *engine, SeriesId series, int32_t exponent, Number *coefficient);
+/**
+ * Find the first nonzero coefficient, looking past at most SERIES_MAX_ZEROS zeros.
+ * @param coefficient Set to the coefficient, owned by the caller, may be NULL.
+ * @return false if the series failed or none was found, it may be zero.
+ */
+bool seriesLeadingTerm(SeriesEngine *engine, SeriesId series, int32_t *exponent, Number *coefficient);
+
+/**
+ * Series of an expression in t = variable - point. Exact numbers, the
+ * variable, arithmetic, powers and the builtin functions are supported.
+ * Expressions are hash consed, a subtree shared anywhere is converted once.
+ * @param point Exact number, borrowed.
+ * @return the series, failed if the expression has other symbols, floats or calls.
+ */
+SeriesId seriesFromNode(SeriesEngine *engine, const NodePool *pool, NodeId node, uint32_t variable, Number point);
+/**
+ * The limit of an expression as variable tends to point, from both sides.
+ * Only coefficients up to t^0 of the series are computed.
+ * @return the limit, NODE_NONE if it is not finite or not rational, or the series failed.
+ */
+NodeId limitNode(NodePool *pool, NodeId node, uint32_t variable, Number point);
+/**
+ * The series of an expression around point up to (variable - point)^order, as an expression.
+ * @return the expansion, NODE_NONE if the series failed.
+ */
+NodeId seriesNode(NodePool *pool, NodeId node, uint32_t variable, Number point, int32_t order);
+/**
+ * Replace every lim(e, x -> a) and series(e, x -> a, n) call under a node by
+ * its value, a and n being exact numbers.
+ * @return the expanded node, node itself if it has none, NODE_NONE if one has no value.
+ */
+NodeId expandLimits(NodePool *pool, NodeId node);
+
+#endif //FLUXIONCORE_FLUXION_SERIES_H
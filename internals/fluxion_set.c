@@ -0,0 +1,288 @@
+//
+// Canonical finite sets, deduplicated and indexed for membership.
+//
+
+#include <string.h>
+#include "fluxion_set.h"
+
+typedef enum {
+    SET_UNION,
+    SET_INTERSECTION,
+    SET_DIFFERENCE
+} SetOperation;
+
+static void *setAlloc(Arena *arena, size_t size) {
+    return arena ? arenaAlloc(arena, size) : malloc(size);
+}
+
+static void *setZeroAlloc(Arena *arena, size_t size) {
+    if (arena == NULL) {
+        return calloc(size ? size : 1, 1);
+    }
+    void *memory = arenaAlloc(arena, size);
+    memset(memory, 0, size);
+    return memory;
+}
+
+/**
+ * Get the value of a token that is an integer small enough to be immediate.
+ * 2.0 counts, as it equals 2.
+ * @param token Token to look at.
+ * @param value Set to the integer.
+ * @return whether the token is such an integer.
+ */
+static bool smallInteger(const Token *token, int64_t *value) {
+    while (token != NULL && token->tokenType == EXPRESSION) {
+        token = ((const ExpressionToken *) token)->root;
+    }
+    if (token == NULL || token->tokenType != NUMBER) {
+        return false;
+    }
+    Number number = ((const NumberToken *) token)->number;
+    if (numberIsSmall(number)) {
+        *value = numberSmallValue(number);
+        return true;
+    }
+    if (numberIsError(number) || !numberIsInteger(number)) {
+        return false;
+    }
+    double nearest = numberToDouble(number);
+    if (!(nearest >= NUMBER_SMALL_MIN && nearest <= NUMBER_SMALL_MAX) ||
+        numberCompare(number, numberFromSmall((int64_t) nearest)) != 0) {
+        return false;
+    }
+    *value = (int64_t) nearest;
+    return true;
+}
+
+/**
+ * Find the range of members that are all small integers.
+ * @return false if a member is not one.
+ */
+static bool integerRange(Token *const *members, int count, int64_t *low, int64_t *high) {
+    int i;
+    int64_t value;
+    *low = 0;
+    *high = -1;
+    for (i = 0; i < count; i++) {
+        if (!smallInteger(members[i], &value)) {
+            return false;
+        }
+        if (i == 0 || value < *low) {
+            *low = value;
+        }
+        if (i == 0 || value > *high) {
+            *high = value;
+        }
+    }
+    return true;
+}
+
+static bool isDense(uint64_t span, int count) {
+    return span <= (uint64_t) FINITE_DENSE_RATIO * (uint64_t) count;
+}
+
+static bool bitsetContains(const FiniteIndex *index, int64_t value) {
+    uint64_t bit = (uint64_t) (value - index->base);
+    return value >= index->base && bit < index->wordCount * 64 && (index->bits[bit >> 6] >> (bit & 63) & 1);
+}
+
+/**
+ * Probe for an element.
+ * @return the slot holding a member equal to it, or the empty slot ending the probe.
+ */
+static uint32_t findSlot(const FiniteIndex *index, Token *const *members, const Token *element, uint64_t hash) {
+    uint32_t slot = (uint32_t) hash & index->mask, member;
+    while ((member = index->slots[slot]) != 0) {
+        if (index->hashes[member - 1] == hash && tokensEqual(members[member - 1], element)) {
+            break;
+        }
+        slot = (slot + 1) & index->mask;
+    }
+    return slot;
+}
+
+/**
+ * Index a set of integers in [low, low + span) as a bitset, dropping duplicates.
+ */
+static void buildBitset(FiniteToken *token, FiniteIndex *index, int64_t low, uint64_t span) {
+    int i, kept = 0;
+    int64_t value;
+    index->dense = true;
+    index->base = low;
+    index->wordCount = (span + 63) / 64;
+    index->bits = (uint64_t *) setZeroAlloc(token->token.arena, sizeof(uint64_t) * index->wordCount);
+    for (i = 0; i < token->current; i++) {
+        smallInteger(token->members[i], &value);
+        uint64_t bit = (uint64_t) (value - low), mask = (uint64_t) 1 << (bit & 63);
+        if (!(index->bits[bit >> 6] & mask)) {
+            index->bits[bit >> 6] |= mask;
+            token->members[kept++] = token->members[i];
+        }
+    }
+    token->current = kept;
+}
+
+/**
+ * Index any set in a hash table at most half full, dropping duplicates.
+ */
+static void buildTable(FiniteToken *token, FiniteIndex *index) {
+    int i, kept = 0;
+    uint32_t slotCount = 8;
+    while (slotCount < 2 * (uint32_t) token->current) {
+        slotCount *= 2;
+    }
+    index->dense = false;
+    index->mask = slotCount - 1;
+    index->slots = (uint32_t *) setZeroAlloc(token->token.arena, sizeof(uint32_t) * slotCount);
+    index->hashes = (uint64_t *) setAlloc(token->token.arena, sizeof(uint64_t) * (token->current ? token->current : 1));
+    for (i = 0; i < token->current; i++) {
+        Token *member = token->members[i];
+        uint64_t hash = hashToken(member);
+        uint32_t slot = findSlot(index, token->members, member, hash);
+        if (index->slots[slot] == 0) {
+            token->members[kept] = member;
+            index->hashes[kept] = hash;
+            index->slots[slot] = ++kept;
+        }
+    }
+    token->current = kept;
+}
+
+void canonicaliseFiniteToken(FiniteToken *token) {
+    if (token->index != NULL) {
+        return;
+    }
+    FiniteIndex *index = (FiniteIndex *) setZeroAlloc(token->token.arena, sizeof(FiniteIndex));
+    int64_t low, high;
+    if (integerRange(token->members, token->current, &low, &high) &&
+        isDense((uint64_t) (high - low) + 1, token->current)) {
+        buildBitset(token, index, low, (uint64_t) (high - low) + 1);
+    } else {
+        buildTable(token, index);
+    }
+    token->index = index;
+}
+
+void freeFiniteIndex(FiniteIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    free(index->slots);
+    free(index->hashes);
+    free(index->bits);
+    free(index);
+}
+
+bool finiteContains(const FiniteToken *set, const Token *element) {
+    const FiniteIndex *index = set->index;
+    int i;
+    if (index == NULL) {
+        for (i = 0; i < set->current; i++) {
+            if (tokensEqual(set->members[i], element)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (index->dense) {
+        int64_t value;
+        return smallInteger(element, &value) && bitsetContains(index, value);
+    }
+    return index->slots[findSlot(index, set->members, element, hashToken(element))] != 0;
+}
+
+/**
+ * The 64 bits of a bitset for the integers from position on,
+ * shifting across the word boundary when they are not aligned.
+ */
+static uint64_t bitsetWord(const FiniteIndex *index, int64_t position) {
+    int64_t offset = position - index->base;
+    if (index->wordCount == 0 || offset <= -64 || offset >= (int64_t) (index->wordCount * 64)) {
+        return 0;
+    }
+    if (offset < 0) {
+        return index->bits[0] << -offset;
+    }
+    size_t word = (size_t) offset >> 6;
+    unsigned shift = (unsigned) offset & 63;
+    uint64_t bits = index->bits[word] >> shift;
+    if (shift != 0 && word + 1 < index->wordCount) {
+        bits |= index->bits[word + 1] << (64 - shift);
+    }
+    return bits;
+}
+
+/**
+ * Index the result of an operation on two bitsets a word at a time.
+ * @param result Result, with its members already gathered.
+ * @return false if the result is too sparse for a bitset.
+ */
+static bool combineBitsets(FiniteToken *result, const FiniteIndex *a, const FiniteIndex *b, SetOperation operation) {
+    int64_t low = a->base, high = a->base + (int64_t) (a->wordCount * 64);
+    int64_t highB = b->base + (int64_t) (b->wordCount * 64);
+    if (operation == SET_UNION && b->wordCount != 0) {
+        low = a->wordCount == 0 || b->base < low ? b->base : low;
+        high = a->wordCount == 0 || highB > high ? highB : high;
+    } else if (operation == SET_INTERSECTION) {
+        low = b->base > low ? b->base : low;
+        high = highB < high ? highB : high;
+    }
+    if (result->current == 0 || high <= low) {
+        low = high = 0;
+    }
+    if (!isDense((uint64_t) (high - low), result->current)) {
+        return false;
+    }
+    FiniteIndex *index = (FiniteIndex *) setZeroAlloc(result->token.arena, sizeof(FiniteIndex));
+    size_t i;
+    index->dense = true;
+    index->base = low;
+    index->wordCount = (size_t) ((uint64_t) (high - low) + 63) / 64;
+    index->bits = (uint64_t *) setAlloc(result->token.arena, sizeof(uint64_t) * (index->wordCount ? index->wordCount : 1));
+    for (i = 0; i < index->wordCount; i++) {
+        int64_t position = low + (int64_t) i * 64;
+        uint64_t x = bitsetWord(a, position), y = bitsetWord(b, position);
+        index->bits[i] = operation == SET_UNION ? x | y : operation == SET_INTERSECTION ? x & y : x & ~y;
+    }
+    result->index = index;
+    return true;
+}
+
+static FiniteToken *combineSets(Arena *arena, const FiniteToken *a, const FiniteToken *b, SetOperation operation) {
+    FiniteToken *result = initFiniteToken(arena, a->token.lineCount);
+    int i;
+    finiteReserve(result, operation == SET_UNION ? a->current + b->current : a->current);
+    for (i = 0; i < a->current; i++) {
+        if (operation == SET_UNION || finiteContains(b, a->members[i]) == (operation == SET_INTERSECTION)) {
+            result->members[result->current++] = a->members[i];
+        }
+    }
+    if (operation == SET_UNION) {
+        for (i = 0; i < b->current; i++) {
+            if (!finiteContains(a, b->members[i])) {
+                result->members[result->current++] = b->members[i];
+            }
+        }
+    }
+    finaliseFiniteToken(result);
+    // Members of canonical bitsets are already distinct, only the index is left to combine.
+    if (a->index != NULL && a->index->dense && b->index != NULL && b->index->dense &&
+        combineBitsets(result, a->index, b->index, operation)) {
+        return result;
+    }
+    canonicaliseFiniteToken(result);
+    return result;
+}
+
+FiniteToken *finiteUnion(Arena *arena, const FiniteToken *a, const FiniteToken *b) {
+    return combineSets(arena, a, b, SET_UNION);
+}
+
+FiniteToken *finiteIntersection(Arena *arena, const FiniteToken *a, const FiniteToken *b) {
+    return combineSets(arena, a, b, SET_INTERSECTION);
+}
+
+FiniteToken *finiteDifference(Arena *arena, const FiniteToken *a, const FiniteToken *b) {
+    return combineSets(arena, a, b, SET_DIFFERENCE);
+}
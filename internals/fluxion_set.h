@@ -0,0 +1,64 @@
+//
+// Canonical finite sets, deduplicated and indexed for membership.
+//
+
+#ifndef FLUXIONCORE_FLUXION_SET_H
+#define FLUXIONCORE_FLUXION_SET_H
+#include "fluxion_token.h"
+
+#define FINITE_DENSE_RATIO 32 // Integer sets become bitsets when their range is at most this many times their size.
+
+/**
+ * Membership index of a canonical set. Sets of small integers whose range is
+ * dense are kept as a bitset, any other set as an open addressing table of
+ * member indexes. Either way the members stay in the order they first appeared.
+ */
+typedef struct FiniteIndex {
+    bool dense; // Whether bits is used, otherwise slots.
+    uint32_t *slots; // Member index + 1 per slot, 0 for an empty one.
+    uint32_t mask; // Slot count - 1, the count is a power of two.
+    uint64_t *hashes; // hashToken of every member.
+    uint64_t *bits; // Bit i is set when base + i is a member.
+    int64_t base;
+    size_t wordCount;
+} FiniteIndex;
+
+/**
+ * Turn a list into a set, dropping every member equal to an earlier one
+ * and building its index. A no-op for sets already canonical.
+ * Members must not be added afterwards.
+ * @param token List to canonicalise.
+ */
+void canonicaliseFiniteToken(FiniteToken *token);
+/**
+ * Free a heap allocated index, a no-op for NULL.
+ */
+void freeFiniteIndex(FiniteIndex *index);
+/**
+ * Whether a set has a member equal to element, by tokensEqual.
+ * Lists that are not canonical are scanned.
+ * @param set Set to look in.
+ * @param element Token to look for.
+ */
+bool finiteContains(const FiniteToken *set, const Token *element);
+/**
+ * Members of a then the members of b that are not in a.
+ * The result is canonical and shares the member tokens of a and b.
+ * @param arena Arena to allocate the result from, NULL for the heap.
+ * @param a First set.
+ * @param b Second set.
+ * @return the union, free with freeFiniteToken.
+ */
+FiniteToken *finiteUnion(Arena *arena, const FiniteToken *a, const FiniteToken *b);
+/**
+ * Members of a that are in b, in the order of a.
+ * @see finiteUnion
+ */
+FiniteToken *finiteIntersection(Arena *arena, const FiniteToken *a, const FiniteToken *b);
+/**
+ * Members of a that are not in b, in the order of a.
+ * @see finiteUnion
+ */
+FiniteToken *finiteDifference(Arena *arena, const FiniteToken *a, const FiniteToken *b);
+
+#endif //FLUXIONCORE_FLUXION_SET_H
@@ -0,0 +1,645 @@
+//
+// Compressed sparse matrices of doubles, for matrix tokens that are mostly zeros.
+//
+
+#include <string.h>
+#include "fluxion_sparse.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SPARSE_VECTOR 1
+#define LANES 4
+typedef double VectorDouble __attribute__((vector_size(32)));
+#define KERNEL static inline __attribute__((always_inline))
+#pragma GCC diagnostic ignored "-Wpsabi" // Vectors only cross inlined calls, the ABI never matters.
+#if defined(__x86_64__) || defined(__i386__)
+#define SPARSE_HAS_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define LANES 1
+#define KERNEL static inline
+#endif
+
+/**
+ * Adds the product of a and b to the rows by b->columns dense c.
+ */
+typedef void (*ProductKernel)(const SparseMatrix *a, const DenseMatrix *b, DenseMatrix *c);
+
+/**
+ * Lines of a matrix, rows or columns by its layout.
+ */
+static size_t lineCount(const SparseMatrix *matrix) {
+    return matrix->layout == SPARSE_ROWS ? matrix->rows : matrix->columns;
+}
+
+/**
+ * The same entries read as the transpose, sharing the arrays. Never freed.
+ */
+static SparseMatrix transposedView(const SparseMatrix *matrix) {
+    SparseMatrix view = *matrix;
+    view.layout = matrix->layout == SPARSE_ROWS ? SPARSE_COLUMNS : SPARSE_ROWS;
+    view.rows = matrix->columns;
+    view.columns = matrix->rows;
+    return view;
+}
+
+SparseMatrix *initSparseMatrix(SparseLayout layout, size_t rows, size_t columns, size_t count) {
+    SparseMatrix *matrix = (SparseMatrix *) malloc(sizeof(SparseMatrix));
+    matrix->layout = layout;
+    matrix->rows = rows;
+    matrix->columns = columns;
+    matrix->offsets = (size_t *) calloc(lineCount(matrix) + 1, sizeof(size_t));
+    matrix->indices = (uint32_t *) malloc(sizeof(uint32_t) * (count ? count : 1));
+    matrix->values = (double *) malloc(sizeof(double) * (count ? count : 1));
+    matrix->count = 0;
+    return matrix;
+}
+
+void freeSparseMatrix(SparseMatrix *matrix) {
+    if (matrix == NULL) {
+        return;
+    }
+    free(matrix->offsets);
+    free(matrix->indices);
+    free(matrix->values);
+    free(matrix);
+}
+
+SparseMatrix *copySparseMatrix(const SparseMatrix *matrix) {
+    SparseMatrix *copy = initSparseMatrix(matrix->layout, matrix->rows, matrix->columns, matrix->count);
+    memcpy(copy->offsets, matrix->offsets, sizeof(size_t) * (lineCount(matrix) + 1));
+    memcpy(copy->indices, matrix->indices, sizeof(uint32_t) * matrix->count);
+    memcpy(copy->values, matrix->values, sizeof(double) * matrix->count);
+    copy->count = matrix->count;
+    return copy;
+}
+
+SparseMatrix *sparseMatrixFromTriplets(SparseLayout layout, size_t rows, size_t columns, const size_t *rowIndices,
+                                       const size_t *columnIndices, const double *values, size_t count) {
+    const size_t *lines = layout == SPARSE_ROWS ? rowIndices : columnIndices;
+    const size_t *indices = layout == SPARSE_ROWS ? columnIndices : rowIndices;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (rowIndices[i] >= rows || columnIndices[i] >= columns) {
+            return NULL;
+        }
+    }
+    // Gather the triplets compressed the other way, then convert, two stable
+    // counting sorts leave every line sorted with its duplicates adjacent.
+    SparseMatrix *gathered = initSparseMatrix(layout == SPARSE_ROWS ? SPARSE_COLUMNS : SPARSE_ROWS, rows, columns,
+                                              count);
+    size_t gatheredLines = lineCount(gathered);
+    for (i = 0; i < count; i++) {
+        gathered->offsets[indices[i] + 1]++;
+    }
+    for (i = 0; i < gatheredLines; i++) {
+        gathered->offsets[i + 1] += gathered->offsets[i];
+    }
+    size_t *next = (size_t *) malloc(sizeof(size_t) * (gatheredLines ? gatheredLines : 1));
+    memcpy(next, gathered->offsets, sizeof(size_t) * gatheredLines);
+    for (i = 0; i < count; i++) {
+        size_t position = next[indices[i]]++;
+        gathered->indices[position] = (uint32_t) lines[i];
+        gathered->values[position] = values[i];
+    }
+    free(next);
+    gathered->count = count;
+    SparseMatrix *matrix = sparseMatrixConvert(gathered, layout);
+    freeSparseMatrix(gathered);
+    size_t line, k, written = 0;
+    for (line = 0; line < lineCount(matrix); line++) { // Sum duplicates and drop zeros in place.
+        size_t begin = matrix->offsets[line], end = matrix->offsets[line + 1];
+        matrix->offsets[line] = written;
+        for (k = begin; k < end;) {
+            uint32_t index = matrix->indices[k];
+            double sum = 0;
+            for (; k < end && matrix->indices[k] == index; k++) {
+                sum += matrix->values[k];
+            }
+            if (sum != 0) {
+                matrix->indices[written] = index;
+                matrix->values[written++] = sum;
+            }
+        }
+    }
+    matrix->offsets[lineCount(matrix)] = written;
+    matrix->count = written;
+    return matrix;
+}
+
+SparseMatrix *sparseMatrixFromDense(const DenseMatrix *matrix, SparseLayout layout) {
+    size_t count = 0, i, j;
+    for (i = 0; i < matrix->rows; i++) {
+        for (j = 0; j < matrix->columns; j++) {
+            count += denseMatrixGet(matrix, i, j) != 0;
+        }
+    }
+    SparseMatrix *rows = initSparseMatrix(SPARSE_ROWS, matrix->rows, matrix->columns, count);
+    for (i = 0; i < matrix->rows; i++) {
+        for (j = 0; j < matrix->columns; j++) {
+            double value = denseMatrixGet(matrix, i, j);
+            if (value != 0) {
+                rows->indices[rows->count] = (uint32_t) j;
+                rows->values[rows->count++] = value;
+            }
+        }
+        rows->offsets[i + 1] = rows->count;
+    }
+    if (layout == SPARSE_ROWS) {
+        return rows;
+    }
+    SparseMatrix *columns = sparseMatrixConvert(rows, SPARSE_COLUMNS);
+    freeSparseMatrix(rows);
+    return columns;
+}
+
+DenseMatrix *sparseMatrixToDense(const SparseMatrix *matrix) {
+    DenseMatrix *dense = initDenseMatrix(matrix->rows, matrix->columns);
+    size_t line, k;
+    for (line = 0; line < lineCount(matrix); line++) {
+        for (k = matrix->offsets[line]; k < matrix->offsets[line + 1]; k++) {
+            if (matrix->layout == SPARSE_ROWS) {
+                denseMatrixSet(dense, line, matrix->indices[k], matrix->values[k]);
+            } else {
+                denseMatrixSet(dense, matrix->indices[k], line, matrix->values[k]);
+            }
+        }
+    }
+    return dense;
+}
+
+SparseMatrix *sparseMatrixConvert(const SparseMatrix *matrix, SparseLayout layout) {
+    if (matrix->layout == layout) {
+        return copySparseMatrix(matrix);
+    }
+    SparseMatrix *result = initSparseMatrix(layout, matrix->rows, matrix->columns, matrix->count);
+    size_t lines = lineCount(result), line, k;
+    for (k = 0; k < matrix->count; k++) {
+        result->offsets[matrix->indices[k] + 1]++;
+    }
+    for (line = 0; line < lines; line++) {
+        result->offsets[line + 1] += result->offsets[line];
+    }
+    size_t *next = (size_t *) malloc(sizeof(size_t) * (lines ? lines : 1));
+    memcpy(next, result->offsets, sizeof(size_t) * lines);
+    for (line = 0; line < lineCount(matrix); line++) { // Lines in order keep every new line sorted.
+        for (k = matrix->offsets[line]; k < matrix->offsets[line + 1]; k++) {
+            size_t position = next[matrix->indices[k]]++;
+            result->indices[position] = (uint32_t) line;
+            result->values[position] = matrix->values[k];
+        }
+    }
+    free(next);
+    result->count = matrix->count;
+    return result;
+}
+
+/**
+ * First entry of a line at or past an index, by binary search.
+ */
+static size_t lowerEntry(const SparseMatrix *matrix, size_t line, uint32_t index) {
+    size_t low = matrix->offsets[line], high = matrix->offsets[line + 1];
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (matrix->indices[middle] < index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+size_t sparseMatrixFind(const SparseMatrix *matrix, size_t row, size_t column) {
+    size_t line = matrix->layout == SPARSE_ROWS ? row : column;
+    uint32_t index = (uint32_t) (matrix->layout == SPARSE_ROWS ? column : row);
+    size_t entry = lowerEntry(matrix, line, index);
+    return entry < matrix->offsets[line + 1] && matrix->indices[entry] == index ? entry : SIZE_MAX;
+}
+
+double sparseMatrixGet(const SparseMatrix *matrix, size_t row, size_t column) {
+    size_t entry = sparseMatrixFind(matrix, row, column);
+    return entry != SIZE_MAX ? matrix->values[entry] : 0;
+}
+
+bool sparseMatrixEqual(const SparseMatrix *a, const SparseMatrix *b) {
+    if (a->rows != b->rows || a->columns != b->columns || a->count != b->count) {
+        return false;
+    }
+    SparseMatrix *converted = b->layout == a->layout ? NULL : sparseMatrixConvert(b, a->layout);
+    const SparseMatrix *other = converted != NULL ? converted : b;
+    bool equal = memcmp(a->offsets, other->offsets, sizeof(size_t) * (lineCount(a) + 1)) == 0 &&
+                 memcmp(a->indices, other->indices, sizeof(uint32_t) * a->count) == 0;
+    size_t k;
+    for (k = 0; equal && k < a->count; k++) {
+        equal = a->values[k] == other->values[k];
+    }
+    freeSparseMatrix(converted);
+    return equal;
+}
+
+SparseMatrix *sparseMatrixTranspose(const SparseMatrix *matrix) {
+    SparseMatrix view = transposedView(matrix);
+    return copySparseMatrix(&view);
+}
+
+void sparseMatrixVector(const SparseMatrix *matrix, const double *x, double *y) {
+    size_t line, k;
+    if (matrix->layout == SPARSE_ROWS) {
+        for (line = 0; line < matrix->rows; line++) {
+            double sum = 0;
+            for (k = matrix->offsets[line]; k < matrix->offsets[line + 1]; k++) {
+                sum += matrix->values[k] * x[matrix->indices[k]];
+            }
+            y[line] = sum;
+        }
+        return;
+    }
+    memset(y, 0, sizeof(double) * matrix->rows);
+    for (line = 0; line < matrix->columns; line++) { // Scatter each column, scaled by its x.
+        double factor = x[line];
+        if (factor == 0) {
+            continue;
+        }
+        for (k = matrix->offsets[line]; k < matrix->offsets[line + 1]; k++) {
+            y[matrix->indices[k]] += matrix->values[k] * factor;
+        }
+    }
+}
+
+#ifdef SPARSE_VECTOR
+KERNEL VectorDouble loadVector(const double *pointer) {
+    VectorDouble vector;
+    memcpy(&vector, pointer, sizeof(VectorDouble));
+    return vector;
+}
+
+KERNEL void storeVector(double *pointer, VectorDouble vector) {
+    memcpy(pointer, &vector, sizeof(VectorDouble));
+}
+
+KERNEL VectorDouble broadcast(double value) {
+    VectorDouble vector = {value, value, value, value};
+    return vector;
+}
+#endif
+
+/**
+ * target += factor * source over a whole padded row, stride is a multiple of LANES.
+ */
+KERNEL void addScaledRow(double *target, const double *source, double factor, size_t stride) {
+    size_t j;
+#ifdef SPARSE_VECTOR
+    VectorDouble factors = broadcast(factor);
+    for (j = 0; j < stride; j += LANES) {
+        storeVector(target + j, loadVector(target + j) + factors * loadVector(source + j));
+    }
+#else
+    for (j = 0; j < stride; j++) {
+        target[j] += factor * source[j];
+    }
+#endif
+}
+
+KERNEL void multiplyDenseBody(const SparseMatrix *a, const DenseMatrix *b, DenseMatrix *c) {
+    size_t line, k;
+    for (line = 0; line < lineCount(a); line++) {
+        for (k = a->offsets[line]; k < a->offsets[line + 1]; k++) { // Entry (i, p) adds a(i, p) b(p, :) to c(i, :).
+            size_t row = a->layout == SPARSE_ROWS ? line : a->indices[k];
+            size_t inner = a->layout == SPARSE_ROWS ? a->indices[k] : line;
+            addScaledRow(c->values + row * c->stride, b->values + inner * b->stride, a->values[k], c->stride);
+        }
+    }
+}
+
+static void multiplyDenseBaseline(const SparseMatrix *a, const DenseMatrix *b, DenseMatrix *c) {
+    multiplyDenseBody(a, b, c);
+}
+
+#ifdef SPARSE_HAS_AVX2
+TARGET_AVX2 static void multiplyDenseAvx2(const SparseMatrix *a, const DenseMatrix *b, DenseMatrix *c) {
+    multiplyDenseBody(a, b, c);
+}
+#endif
+
+static ProductKernel selectKernel(void) {
+#ifdef SPARSE_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return multiplyDenseAvx2;
+    }
+#endif
+    return multiplyDenseBaseline;
+}
+
+DenseMatrix *sparseMatrixMultiplyDense(const SparseMatrix *a, const DenseMatrix *b) {
+    if (a->columns != b->rows) {
+        return NULL;
+    }
+    static ProductKernel kernel = NULL;
+    if (kernel == NULL) {
+        kernel = selectKernel();
+    }
+    DenseMatrix *c = initDenseMatrix(a->rows, b->columns);
+    kernel(a, b, c); // The padding of c picks up b's, which is unspecified anyway.
+    return c;
+}
+
+/**
+ * Gustavson's algorithm on row compressed a and b. The positions a row of
+ * the product touches are marked with that row, so the accumulator is
+ * never cleared, and only those positions are sorted and gathered.
+ */
+static SparseMatrix *multiplyRows(const SparseMatrix *a, const SparseMatrix *b) {
+    size_t capacity = a->count + b->count + 1, row, k, l, j;
+    SparseMatrix *c = initSparseMatrix(SPARSE_ROWS, a->rows, b->columns, capacity);
+    double *accumulator = (double *) malloc(sizeof(double) * (b->columns ? b->columns : 1));
+    size_t *marker = (size_t *) malloc(sizeof(size_t) * (b->columns ? b->columns : 1));
+    uint32_t *touched = (uint32_t *) malloc(sizeof(uint32_t) * (b->columns ? b->columns : 1));
+    for (j = 0; j < b->columns; j++) {
+        marker[j] = SIZE_MAX;
+    }
+    for (row = 0; row < a->rows; row++) {
+        size_t touchedCount = 0;
+        for (k = a->offsets[row]; k < a->offsets[row + 1]; k++) {
+            double factor = a->values[k];
+            uint32_t inner = a->indices[k];
+            for (l = b->offsets[inner]; l < b->offsets[inner + 1]; l++) {
+                uint32_t column = b->indices[l];
+                if (marker[column] != row) {
+                    marker[column] = row;
+                    accumulator[column] = 0;
+                    touched[touchedCount++] = column;
+                }
+                accumulator[column] += factor * b->values[l];
+            }
+        }
+        if (touchedCount * 8 < b->columns) { // Sort the few touched, or sweep them all when there are many.
+            for (k = 1; k < touchedCount; k++) {
+                uint32_t column = touched[k];
+                for (l = k; l > 0 && touched[l - 1] > column; l--) {
+                    touched[l] = touched[l - 1];
+                }
+                touched[l] = column;
+            }
+        } else {
+            touchedCount = 0;
+            for (j = 0; j < b->columns; j++) {
+                if (marker[j] == row) {
+                    touched[touchedCount++] = (uint32_t) j;
+                }
+            }
+        }
+        if (c->count + touchedCount > capacity) {
+            capacity = (c->count + touchedCount) * 2;
+            c->indices = (uint32_t *) realloc(c->indices, sizeof(uint32_t) * capacity);
+            c->values = (double *) realloc(c->values, sizeof(double) * capacity);
+        }
+        for (k = 0; k < touchedCount; k++) {
+            double value = accumulator[touched[k]];
+            if (value != 0) { // Cancellation can leave a zero.
+                c->indices[c->count] = touched[k];
+                c->values[c->count++] = value;
+            }
+        }
+        c->offsets[row + 1] = c->count;
+    }
+    free(touched);
+    free(marker);
+    free(accumulator);
+    return c;
+}
+
+SparseMatrix *sparseMatrixMultiply(const SparseMatrix *a, const SparseMatrix *b) {
+    if (a->columns != b->rows) {
+        return NULL;
+    }
+    SparseMatrix *converted = b->layout == a->layout ? NULL : sparseMatrixConvert(b, a->layout);
+    const SparseMatrix *right = converted != NULL ? converted : b;
+    SparseMatrix *product;
+    if (a->layout == SPARSE_ROWS) {
+        product = multiplyRows(a, right);
+    } else { // The columns of a b are the rows of b^T a^T, whose factors are row compressed as they are.
+        SparseMatrix left = transposedView(right), other = transposedView(a);
+        SparseMatrix *transposed = multiplyRows(&left, &other);
+        SparseMatrix view = transposedView(transposed);
+        *transposed = view; // Same arrays, read as the product.
+        product = transposed;
+    }
+    freeSparseMatrix(converted);
+    return product;
+}
+
+/**
+ * The number a member holds, looking through expressions.
+ * @return false if the member is missing or not a number.
+ */
+static bool memberValue(const Token *member, double *value, Number *number) {
+    while (member != NULL && member->tokenType == EXPRESSION) {
+        member = ((const ExpressionToken *) member)->root;
+    }
+    if (member == NULL || member->tokenType != NUMBER) {
+        return false;
+    }
+    *value = ((const NumberToken *) member)->value;
+    *number = ((const NumberToken *) member)->number;
+    return true;
+}
+
+/**
+ * Walk the members of a dense matrix token in the order of a layout, setting the offsets.
+ * @param store Whether to store the entries too, the matrix has room for them.
+ * @return the non-zero count, SIZE_MAX if a member is not a number.
+ */
+static size_t fillFromMembers(const MatrixToken *token, SparseMatrix *matrix, bool store) {
+    size_t rows = (size_t) token->rowSize, columns = (size_t) token->columnSize;
+    size_t lines = matrix->layout == SPARSE_ROWS ? rows : columns, width = matrix->layout == SPARSE_ROWS ? columns : rows;
+    size_t line, index, count = 0;
+    for (line = 0; line < lines; line++) {
+        for (index = 0; index < width; index++) {
+            size_t row = matrix->layout == SPARSE_ROWS ? line : index, column = matrix->layout == SPARSE_ROWS ? index : line;
+            double value;
+            Number number;
+            if (!memberValue(token->members[row * columns + column], &value, &number)) {
+                return SIZE_MAX;
+            }
+            if (value != 0) {
+                if (store) {
+                    matrix->indices[count] = (uint32_t) index;
+                    matrix->values[count] = value;
+                }
+                count++;
+            }
+        }
+        matrix->offsets[line + 1] = count;
+    }
+    matrix->count = count;
+    return count;
+}
+
+SparseMatrix *sparseMatrixFromToken(const MatrixToken *token) {
+    if (token->sparse != NULL) {
+        return copySparseMatrix(token->sparse);
+    }
+    SparseMatrix *matrix = initSparseMatrix(SPARSE_ROWS, (size_t) token->rowSize, (size_t) token->columnSize, 0);
+    size_t count = fillFromMembers(token, matrix, false);
+    if (count == SIZE_MAX) {
+        freeSparseMatrix(matrix);
+        return NULL;
+    }
+    matrix->indices = (uint32_t *) realloc(matrix->indices, sizeof(uint32_t) * (count ? count : 1));
+    matrix->values = (double *) realloc(matrix->values, sizeof(double) * (count ? count : 1));
+    fillFromMembers(token, matrix, true);
+    return matrix;
+}
+
+MatrixToken *initSparseMatrixToken(Arena *arena, int lineCount, SparseMatrix *matrix) {
+    MatrixToken *token = initMatrixToken(arena, lineCount);
+    token->rowSize = (int) matrix->rows;
+    token->columnSize = (int) matrix->columns;
+    token->sparse = matrix;
+    return token;
+}
+
+/**
+ * Whether a double holds a number exactly, so compressing it loses nothing.
+ */
+static bool exactDouble(Number number, double value) {
+    if (numberIsSmall(number)) {
+        return (double) numberSmallValue(number) == value && value <= 9007199254740992.0 &&
+               value >= -9007199254740992.0;
+    }
+    if (numberKind(number) != NUMBER_FLOAT) {
+        return false;
+    }
+    Number rounded = numberFromDouble(value);
+    bool exact = numberCompare(rounded, number) == 0;
+    freeNumber(rounded);
+    return exact;
+}
+
+bool compactMatrixToken(MatrixToken *token) {
+    if (token->sparse != NULL) {
+        return true;
+    }
+    size_t rows = (size_t) token->rowSize, columns = (size_t) token->columnSize, count = 0, i;
+    if (token->members == NULL) {
+        return false;
+    }
+    for (i = 0; i < rows * columns; i++) {
+        double value;
+        Number number;
+        if (!memberValue(token->members[i], &value, &number) || !exactDouble(number, value)) {
+            return false;
+        }
+        count += value != 0;
+    }
+    if ((double) count > SPARSE_MAX_DENSITY * (double) (rows * columns)) {
+        return false;
+    }
+    SparseMatrix *matrix = initSparseMatrix(rows <= columns ? SPARSE_ROWS : SPARSE_COLUMNS, rows, columns, count);
+    fillFromMembers(token, matrix, true);
+    if (token->token.arena == NULL) {
+        free(token->members);
+    }
+    token->members = NULL;
+    token->memberCapacity = 0;
+    token->sparse = matrix;
+    return true;
+}
+
+/**
+ * Grow a compressed matrix token to hold a position, new lines are empty.
+ */
+static void growCompressed(MatrixToken *token, size_t row, size_t column) {
+    SparseMatrix *matrix = token->sparse;
+    size_t lines = lineCount(matrix), line;
+    matrix->rows = row >= matrix->rows ? row + 1 : matrix->rows;
+    matrix->columns = column >= matrix->columns ? column + 1 : matrix->columns;
+    if (lineCount(matrix) > lines) {
+        matrix->offsets = (size_t *) realloc(matrix->offsets, sizeof(size_t) * (lineCount(matrix) + 1));
+        for (line = lines + 1; line <= lineCount(matrix); line++) {
+            matrix->offsets[line] = matrix->count;
+        }
+    }
+    token->rowSize = (int) matrix->rows;
+    token->columnSize = (int) matrix->columns;
+}
+
+bool setCompressedMember(MatrixToken *token, size_t row, size_t column, const Token *element) {
+    double value;
+    Number number;
+    if (!memberValue(element, &value, &number) || !exactDouble(number, value)) {
+        return false;
+    }
+    growCompressed(token, row, column);
+    SparseMatrix *matrix = token->sparse;
+    size_t line = matrix->layout == SPARSE_ROWS ? row : column, next;
+    uint32_t index = (uint32_t) (matrix->layout == SPARSE_ROWS ? column : row);
+    size_t entry = lowerEntry(matrix, line, index);
+    bool stored = entry < matrix->offsets[line + 1] && matrix->indices[entry] == index;
+    if (stored && value != 0) { // A token read before keeps the old value, the entry gets a new one.
+        matrix->values[entry] = value;
+        if (token->reads != NULL) {
+            token->reads[entry] = NULL;
+        }
+    } else if (stored) {
+        size_t after = matrix->count - entry - 1;
+        memmove(matrix->indices + entry, matrix->indices + entry + 1, sizeof(uint32_t) * after);
+        memmove(matrix->values + entry, matrix->values + entry + 1, sizeof(double) * after);
+        if (token->reads != NULL) {
+            memmove(token->reads + entry, token->reads + entry + 1, sizeof(Token *) * after);
+        }
+        for (next = line + 1; next <= lineCount(matrix); next++) {
+            matrix->offsets[next]--;
+        }
+        matrix->count--;
+    } else if (value != 0) {
+        size_t after = matrix->count - entry;
+        matrix->indices = (uint32_t *) realloc(matrix->indices, sizeof(uint32_t) * (matrix->count + 1));
+        matrix->values = (double *) realloc(matrix->values, sizeof(double) * (matrix->count + 1));
+        memmove(matrix->indices + entry + 1, matrix->indices + entry, sizeof(uint32_t) * after);
+        memmove(matrix->values + entry + 1, matrix->values + entry, sizeof(double) * after);
+        matrix->indices[entry] = index;
+        matrix->values[entry] = value;
+        if (token->reads != NULL) {
+            token->reads = (Token **) realloc(token->reads, sizeof(Token *) * (matrix->count + 1));
+            memmove(token->reads + entry + 1, token->reads + entry, sizeof(Token *) * after);
+            token->reads[entry] = NULL;
+        }
+        for (next = line + 1; next <= lineCount(matrix); next++) {
+            matrix->offsets[next]++;
+        }
+        matrix->count++;
+    }
+    return true;
+}
+
+void expandMatrixToken(MatrixToken *token) {
+    SparseMatrix *matrix = token->sparse;
+    if (matrix == NULL) {
+        return;
+    }
+    Arena *arena = matrixMadeArena(token);
+    size_t line, k, i, size = matrix->rows * matrix->columns;
+    if (token->zero == NULL) {
+        token->zero = (Token *) initNumberToken(arena, token->token.lineCount, 0);
+    }
+    token->sparse = NULL;
+    mallocMatrixTokenArr(token, 0);
+    for (i = 0; i < size; i++) {
+        token->members[i] = token->zero;
+    }
+    for (line = 0; line < lineCount(matrix); line++) {
+        for (k = matrix->offsets[line]; k < matrix->offsets[line + 1]; k++) {
+            size_t row = matrix->layout == SPARSE_ROWS ? line : matrix->indices[k];
+            size_t column = matrix->layout == SPARSE_ROWS ? matrix->indices[k] : line;
+            Token *member = token->reads != NULL ? token->reads[k] : NULL;
+            token->members[row * matrix->columns + column] = member != NULL ? member :
+                    (Token *) initNumberToken(arena, token->token.lineCount, matrix->values[k]);
+        }
+    }
+    free(token->reads);
+    token->reads = NULL;
+    freeSparseMatrix(matrix);
+}
@@ -0,0 +1,127 @@
+//
+// Compressed sparse matrices of doubles, for matrix tokens that are mostly zeros.
+//
+
+#ifndef FLUXIONCORE_FLUXION_SPARSE_H
+#define FLUXIONCORE_FLUXION_SPARSE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "fluxion_matrix.h"
+#include "fluxion_token.h"
+
+#define SPARSE_MAX_DENSITY 0.1 // Matrix tokens with at most this fraction of non-zeros are stored compressed.
+
+typedef enum {
+    SPARSE_ROWS, // Compressed sparse rows, CSR.
+    SPARSE_COLUMNS // Compressed sparse columns, CSC.
+} SparseLayout;
+
+/**
+ * A matrix storing only its non-zeros, compressed by rows or by columns.
+ * A line is a row or a column depending on the layout. Memory is
+ * proportional to the non-zeros plus the number of lines.
+ */
+typedef struct SparseMatrix {
+    SparseLayout layout;
+    size_t rows;
+    size_t columns;
+    size_t *offsets; // Entries of line i are [offsets[i], offsets[i + 1]).
+    uint32_t *indices; // Column, or row, of each entry, increasing within a line.
+    double *values; // Never zero.
+    size_t count; // Non-zeros.
+} SparseMatrix;
+
+/**
+ * Allocate a matrix with room for count entries and every line empty.
+ * @param layout Whether lines are rows or columns.
+ * @param rows Number of rows.
+ * @param columns Number of columns.
+ * @param count Entries to allocate, count stays 0 until they are filled in.
+ */
+SparseMatrix *initSparseMatrix(SparseLayout layout, size_t rows, size_t columns, size_t count);
+void freeSparseMatrix(SparseMatrix *matrix);
+SparseMatrix *copySparseMatrix(const SparseMatrix *matrix);
+/**
+ * Build a matrix from (row, column, value) triplets in any order.
+ * Duplicates are summed and zeros dropped.
+ * @return the matrix, NULL if a position is outside it.
+ */
+SparseMatrix *sparseMatrixFromTriplets(SparseLayout layout, size_t rows, size_t columns, const size_t *rowIndices,
+                                       const size_t *columnIndices, const double *values, size_t count);
+SparseMatrix *sparseMatrixFromDense(const DenseMatrix *matrix, SparseLayout layout);
+DenseMatrix *sparseMatrixToDense(const SparseMatrix *matrix);
+/**
+ * Copy a matrix into a layout, by a counting sort of its entries.
+ */
+SparseMatrix *sparseMatrixConvert(const SparseMatrix *matrix, SparseLayout layout);
+/**
+ * Entry at a position, by binary search within its line.
+ * @return the index of the entry in indices and values, SIZE_MAX if the element is zero.
+ */
+size_t sparseMatrixFind(const SparseMatrix *matrix, size_t row, size_t column);
+/**
+ * Element at a position, by binary search within its line.
+ */
+double sparseMatrixGet(const SparseMatrix *matrix, size_t row, size_t column);
+/**
+ * Whether two matrices hold the same values, whatever their layouts.
+ */
+bool sparseMatrixEqual(const SparseMatrix *a, const SparseMatrix *b);
+
+/**
+ * Transpose. The rows of a matrix are the columns of its transpose, so the
+ * entries are copied as they are and the layout flips, CSR to CSC.
+ */
+SparseMatrix *sparseMatrixTranspose(const SparseMatrix *matrix);
+/**
+ * y = matrix x.
+ * @param x As many values as the matrix has columns.
+ * @param y As many values as the matrix has rows, overwritten.
+ */
+void sparseMatrixVector(const SparseMatrix *matrix, const double *x, double *y);
+/**
+ * Product with a dense matrix, a row of b scaled and added per non-zero of a.
+ * @return the product, NULL if the shapes do not agree.
+ */
+DenseMatrix *sparseMatrixMultiplyDense(const SparseMatrix *a, const DenseMatrix *b);
+/**
+ * Product of sparse matrices by Gustavson's algorithm, row by row with a
+ * dense accumulator, so the work is proportional to the multiply-adds.
+ * The product is in the layout of a, b is converted first if it differs.
+ * @return the product, NULL if the shapes do not agree.
+ */
+SparseMatrix *sparseMatrixMultiply(const SparseMatrix *a, const SparseMatrix *b);
+
+/**
+ * Convert a matrix token whose members are all numbers.
+ * @return the matrix, NULL if a member is missing or not a number.
+ */
+SparseMatrix *sparseMatrixFromToken(const MatrixToken *token);
+/**
+ * Make a matrix token that holds a sparse matrix without ever allocating its members.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param matrix Matrix to take.
+ */
+MatrixToken *initSparseMatrixToken(Arena *arena, int lineCount, SparseMatrix *matrix);
+/**
+ * Store a matrix token compressed if its members are all numbers a double
+ * holds exactly and at most SPARSE_MAX_DENSITY of them are non-zero. The
+ * layout has the fewer lines. The members array is dropped, the member
+ * tokens themselves are left to their owner.
+ * @return whether the token is compressed now.
+ */
+bool compactMatrixToken(MatrixToken *token);
+/**
+ * Set an element of a compressed matrix token in place, growing it if the
+ * position is outside. The element is only read, it stays with its owner.
+ * @return whether it was set, not if the element is not a number a double holds exactly.
+ */
+bool setCompressedMember(MatrixToken *token, size_t row, size_t column, const Token *element);
+/**
+ * Give a compressed matrix token its members back, as number tokens made in
+ * matrixMadeArena. The tokens already read are reused and every zero shares
+ * one, so the tokens made are at most the non-zeros plus one.
+ */
+void expandMatrixToken(MatrixToken *token);
+
+#endif //FLUXIONCORE_FLUXION_SPARSE_H
@@ -3,57 +3,105 @@
 //
 
 
+#include <stdio.h>
 #include <string.h>
 #include "fluxion_token.h"
+#include "fluxion_set.h"
+#include "fluxion_sparse.h"
+
+#define MATRIX_MADE_BLOCK_SIZE 4096 // Blocks of the arena a heap matrix makes its tokens in.
+
+/**
+ * Allocate token memory from the arena, or the heap if there is none.
+ * @param arena Arena to allocate from, may be NULL.
+ * @param size Size in bytes.
+ */
+static void *tokenAlloc(Arena *arena, size_t size) {
+    return arena ? arenaAlloc(arena, size) : malloc(size);
+}
+
+/**
+ * Resize token memory allocated by tokenAlloc.
+ * @param arena Arena the memory came from, may be NULL.
+ * @param ptr Previous memory.
+ * @param oldSize Previous size in bytes.
+ * @param newSize New size in bytes.
+ */
+static void *tokenRealloc(Arena *arena, void *ptr, size_t oldSize, size_t newSize) {
+    return arena ? arenaRealloc(arena, ptr, oldSize, newSize) : realloc(ptr, newSize);
+}
 
 /**
- * Initialise a base token given
- * @param token the newly allocated token.
+ * Free token memory allocated by tokenAlloc, a no-op for arena memory.
+ * @param arena Arena the memory came from, may be NULL.
+ * @param ptr Memory to free.
+ */
+static void tokenFree(Arena *arena, void *ptr) {
+    if (arena == NULL) {
+        free(ptr);
+    }
+}
+
+/**
+ * Initialise the base token embedded in a token, given
+ * @param token the embedded base token.
+ * @param arena the arena the token is allocated from, may be NULL.
  * @param lineCount line the token appears in.
  * @param tokenType type of the token.
  */
-Token *initToken(int lineCount, TokenType tokenType) {
-    Token *token = (Token*) malloc(sizeof(Token));
+void initToken(Token *token, Arena *arena, int lineCount, TokenType tokenType) {
     token->lineCount = lineCount;
     token->tokenType = tokenType;
-    return token;
+    token->arena = arena;
 }
 
 /**
- * Free the base token, given
- * @param token Token to free.
+ * Initialise the identifier part of a token in place.
+ * @param token Identifier to initialise.
+ * @param storage Memory for the name, at least length + 1 bytes.
  */
-void freeBaseToken(Token *token) {
-    free(token);
+static void initIdentifierHeader(IdentifierToken *token, Arena *arena, int lineCount,
+                                 const char *name, size_t length, char *storage) {
+    initToken(&token->token, arena, lineCount, IDENTIFIER);
+    memcpy(storage, name, length);
+    storage[length] = '\0';
+    token->name = storage;
+    token->identifierType = Variable;
 }
 
-IdentifierToken *initIdentifierToken(int lineCount, const char *name) {
-    IdentifierToken* token = (IdentifierToken*) malloc(sizeof(IdentifierToken));
-    token->token = initToken(lineCount, IDENTIFIER);
-    token->name = name; // You should probably copy this via strcpy.
-    token->identifierType = Variable;
+IdentifierToken *initIdentifierToken(Arena *arena, int lineCount, const char *name) {
+    return initIdentifierTokenSpan(arena, lineCount, name, strlen(name));
+}
+
+IdentifierToken *initIdentifierTokenSpan(Arena *arena, int lineCount, const char *name, size_t length) {
+    // The name is stored right after the token, in the same allocation.
+    IdentifierToken* token = (IdentifierToken*) tokenAlloc(arena, sizeof(IdentifierToken) + length + 1);
+    initIdentifierHeader(token, arena, lineCount, name, length, (char *) (token + 1));
     return token;
 }
 
 void freeIdentifierToken(IdentifierToken *token) {
-    freeBaseToken(token->token);
-    free(token->name); // This will probably went terribly wrong, have you fixed line 24 yet?
-    token->name = NULL;
-    free(token);
-    // Surely this will not segfault
+    tokenFree(token->token.arena, token); // The name shares the allocation.
+}
+
+FunctionToken *initFunctionToken(Arena *arena, int lineCount, const char *name) {
+    return initFunctionTokenSpan(arena, lineCount, name, strlen(name));
 }
 
-FunctionToken *initFunctionToken(int lineCount, const char *name) {
-    FunctionToken *token = malloc(sizeof(FunctionToken));
-    token->identifier = initIdentifierToken(lineCount, name);
+FunctionToken *initFunctionTokenSpan(Arena *arena, int lineCount, const char *name, size_t length) {
+    FunctionToken *token = (FunctionToken *) tokenAlloc(arena, sizeof(FunctionToken) + length + 1);
+    initIdentifierHeader(&token->identifier, arena, lineCount, name, length, (char *) (token + 1));
+    token->identifier.identifierType = Function;
     token->current = 0;
     token->arity = 1;
-    token->args = (Token **) malloc(token->arity * sizeof(Token*));
+    token->args = (Token **) tokenAlloc(arena, token->arity * sizeof(Token*));
     return token;
 }
 
 void freeFunctionToken(FunctionToken *token) {
-    freeIdentifierToken(token->identifier);
+    if (token->identifier.token.arena != NULL) {
+        return;
+    }
     free(token->args);
     token->args = NULL;
     free(token);
@@ -61,132 +109,265 @@ void freeFunctionToken(FunctionToken *token) {
 
 void addArgument(FunctionToken *token, Token *arg) {
     if (token->current >= token->arity) {
+        Arena *arena = token->identifier.token.arena;
+        token->args = (Token **) tokenRealloc(arena, token->args, sizeof(Token*) * token->arity,
+                                              sizeof(Token*) * token->arity * 2);
         token->arity *= 2;
-        token->args = (Token **) realloc(token->args, sizeof(Token*) * token->arity);
-
     }
     token->args[token->current++] = arg;
 }
 
 void finaliseFunctionToken(FunctionToken *token) {
-    if (token->current != token->arity) {
+    if (token->current != token->arity && token->identifier.token.arena == NULL) {
         token->arity = token->current; // Shrink to current size.
         token->args = realloc(token->args, sizeof(Token*) * token->arity);
     }
 }
 
-NumberToken *initNumberToken(int lineCount, double value) {
-    NumberToken *token = (NumberToken*) malloc(sizeof(NumberToken));
-    token->token = initToken(lineCount, NUMBER);
+/**
+ * Arena cleanup releasing the number of a number token.
+ * @param data The number token.
+ */
+static void releaseNumberToken(void *data) {
+    freeNumber(((NumberToken *) data)->number);
+}
+
+/**
+ * A number token whose double is known already, so the number is never rounded.
+ */
+static NumberToken *initNumberTokenValue(Arena *arena, int lineCount, Number number, double value) {
+    NumberToken *token = (NumberToken*) tokenAlloc(arena, sizeof(NumberToken));
+    initToken(&token->token, arena, lineCount, NUMBER);
     token->value = value;
+    token->number = number;
+    if (arena != NULL && !numberIsImmediate(number)) {
+        arenaAddCleanup(arena, releaseNumberToken, token);
+    }
     return token;
 }
 
+NumberToken *initNumberTokenNumber(Arena *arena, int lineCount, Number number) {
+    return initNumberTokenValue(arena, lineCount, number, numberToDouble(number));
+}
+
+NumberToken *initNumberToken(Arena *arena, int lineCount, double value) {
+    return initNumberTokenValue(arena, lineCount, numberFromDouble(value), value);
+}
+
+NumberToken *initNumberTokenLiteral(Arena *arena, int lineCount, const NumberLiteral *literal) {
+    return initNumberTokenValue(arena, lineCount, numberFromLiteral(literal), literal->value);
+}
+
 void freeNumberToken(NumberToken *token) {
-    freeBaseToken(token->token);
+    if (token->token.arena != NULL) {
+        return;
+    }
+    freeNumber(token->number);
     free(token);
 }
 
-void mallocMatrixTokenArr(MatrixToken *matrix) {
-    int arrSize = matrix->rowSize * matrix->columnSize;
-    if (matrix->members == NULL) { // Not malloc'ed, yet.
-        matrix->members = (Token **) malloc(sizeof(Token*) * arrSize);
-    } else { // Enlarging an allocated array.
-        matrix->members = (Token **) realloc(matrix->members, sizeof(Token *) * arrSize);
-    }
+void mallocMatrixTokenArr(MatrixToken *matrix, int oldSize) {
+    size_t arrSize = (size_t) matrix->rowSize * (size_t) matrix->columnSize;
+    Arena *arena = matrix->token.arena;
+    matrix->members = (Token **) tokenRealloc(arena, matrix->members, sizeof(Token *) * (size_t) oldSize,
+                                              sizeof(Token *) * arrSize);
+    matrix->memberCapacity = arrSize;
 }
 
-MatrixToken *initMatrixToken(int lineCount) {
-    MatrixToken  *token = (MatrixToken *) malloc(sizeof(Token));
-    token->token = initToken(lineCount, MATRIX);
+/**
+ * Arena cleanup releasing the compressed members of a matrix token.
+ * @param data The matrix token.
+ */
+static void releaseMatrixToken(void *data) {
+    freeSparseMatrix(((MatrixToken *) data)->sparse);
+    free(((MatrixToken *) data)->reads);
+}
+
+MatrixToken *initMatrixToken(Arena *arena, int lineCount) {
+    MatrixToken  *token = (MatrixToken *) tokenAlloc(arena, sizeof(MatrixToken));
+    initToken(&token->token, arena, lineCount, MATRIX);
     token->columnSize = 0;
     token->rowSize = 0;
     token->members = NULL; // Means empty matrix
+    token->memberCapacity = 0;
+    token->sparse = NULL;
+    token->reads = NULL;
+    token->zero = NULL;
+    token->made = NULL;
+    if (arena != NULL) {
+        arenaAddCleanup(arena, releaseMatrixToken, token);
+    }
     return token;
 }
 
 void freeMatrixToken(MatrixToken *token) {
+    if (token->token.arena != NULL) {
+        return;
+    }
     free(token->members);
     token->members = NULL;
-    freeBaseToken(token->token);
-    token->token = NULL;
+    freeSparseMatrix(token->sparse);
+    free(token->reads);
+    if (token->made != NULL) {
+        freeArena(token->made);
+    }
     free(token);
 }
 
 void matrixAddMember(MatrixToken *token, int row, int col, Token *element) {
-    if ((row + 1) > token->rowSize || (col + 1) > token->columnSize) {
-        token->rowSize = row ? row > token->rowSize : token->rowSize;
-        token->columnSize = col ? col > token->columnSize : token->columnSize;
-        mallocMatrixTokenArr(token);
+    if (row < 0 || col < 0) {
+        char str[64];
+        snprintf(str, sizeof(str), "at line %i, Negative matrix index.\n", token->token.lineCount);
+        Error newError = {Undefined, str};
+        issueError(&newError);
+        return;
+    }
+    if (token->sparse != NULL && setCompressedMember(token, (size_t) row, (size_t) col, element)) {
+        return;
+    }
+    expandMatrixToken(token);
+    if (row >= token->rowSize || col >= token->columnSize) { // Grow, moving members to the new stride.
+        size_t oldRows = (size_t) token->rowSize, oldColumns = (size_t) token->columnSize;
+        size_t rows = row >= token->rowSize ? (size_t) row + 1 : oldRows;
+        size_t columns = col >= token->columnSize ? (size_t) col + 1 : oldColumns;
+        size_t i, j;
+        if (rows * columns > token->memberCapacity) { // Geometrically, so filling cell by cell is linear.
+            size_t capacity = token->memberCapacity ? token->memberCapacity : 4;
+            while (capacity < rows * columns) {
+                capacity *= 2;
+            }
+            token->members = (Token **) tokenRealloc(token->token.arena, token->members,
+                                                     sizeof(Token *) * token->memberCapacity,
+                                                     sizeof(Token *) * capacity);
+            token->memberCapacity = capacity;
+        }
+        for (i = rows; i-- > 0;) { // From the end, as the new stride is at least the old one.
+            for (j = columns; j-- > 0;) {
+                token->members[i * columns + j] = i < oldRows && j < oldColumns ?
+                                                  token->members[i * oldColumns + j] : NULL;
+            }
+            if (columns == oldColumns && i == oldRows) {
+                break; // Rows before the new ones stay where they are.
+            }
+        }
+        token->rowSize = (int) rows;
+        token->columnSize = (int) columns;
     }
-    token->members[row * col] = element; // Assign the value.
+    token->members[row * token->columnSize + col] = element;
+}
+
+Arena *matrixMadeArena(MatrixToken *token) {
+    if (token->token.arena != NULL) {
+        return token->token.arena;
+    }
+    if (token->made == NULL) {
+        token->made = initArena(MATRIX_MADE_BLOCK_SIZE);
+    }
+    return token->made;
 }
 
 Token *matrixGetMember(MatrixToken *token, int row, int col) {
-    return * (token->members + (row*col));
+    if (row < 0 || col < 0 || row >= token->rowSize || col >= token->columnSize) {
+        return NULL;
+    }
+    if (token->sparse == NULL) {
+        return token->members[row * token->columnSize + col];
+    }
+    size_t entry = sparseMatrixFind(token->sparse, (size_t) row, (size_t) col);
+    if (entry == SIZE_MAX) {
+        if (token->zero == NULL) {
+            token->zero = (Token *) initNumberToken(matrixMadeArena(token), token->token.lineCount, 0);
+        }
+        return token->zero;
+    }
+    if (token->reads == NULL) {
+        token->reads = (Token **) calloc(token->sparse->count, sizeof(Token *));
+    }
+    if (token->reads[entry] == NULL) {
+        token->reads[entry] = (Token *) initNumberToken(matrixMadeArena(token), token->token.lineCount,
+                                                        token->sparse->values[entry]);
+    }
+    return token->reads[entry];
 }
 
-FiniteToken *initFiniteToken(int lineCount) {
-    FiniteToken *token = (FiniteToken *) malloc(sizeof(FiniteToken));
-    token->token = initToken(lineCount, FINITE);
+FiniteToken *initFiniteToken(Arena *arena, int lineCount) {
+    FiniteToken *token = (FiniteToken *) tokenAlloc(arena, sizeof(FiniteToken));
+    initToken(&token->token, arena, lineCount, FINITE);
     token->memberCount = 4;
     token->current = 0;
-    token->members = (Token**) malloc(sizeof(Token*) * token->memberCount);
+    token->members = (Token**) tokenAlloc(arena, sizeof(Token*) * token->memberCount);
+    token->index = NULL;
     return token;
 }
 
 void freeFiniteToken(FiniteToken *token) {
-    freeBaseToken(token->token);
-    token->token = NULL;
+    if (token->token.arena != NULL) {
+        return;
+    }
     free(token->members);
     token->members = NULL;
+    freeFiniteIndex(token->index);
     free(token);
 }
 
 void finaliseFiniteToken(FiniteToken *token) {
-    if (token->memberCount > token->current) {
+    if (token->memberCount > token->current && token->token.arena == NULL) {
         token->memberCount = token->current;
         token->members = (Token**) realloc(token->members, sizeof(Token*) * token->memberCount);
     }
 }
 void finiteAddElement(FiniteToken *token, Token *element) {
     if (token->current >= token->memberCount) {
+        token->members = (Token**) tokenRealloc(token->token.arena, token->members,
+                                                sizeof(Token*) * token->memberCount,
+                                                sizeof(Token*) * token->memberCount * 2); // Double.
         token->memberCount *= 2;
-        token->members = (Token**) realloc(token->members, sizeof(Token*) * token->memberCount); // Double.
     }
     token->members[token->current++] = element;
 }
 
-OperatorToken *initOperatorToken(int lineCount, OperatorType operatorType) {
-    OperatorToken *token = (OperatorToken*) malloc(sizeof(OperatorToken));
-    token->token = initToken(lineCount, OPERATOR);
+void finiteReserve(FiniteToken *token, int capacity) {
+    if (capacity > token->memberCount) {
+        token->members = (Token**) tokenRealloc(token->token.arena, token->members,
+                                                sizeof(Token*) * token->memberCount, sizeof(Token*) * capacity);
+        token->memberCount = capacity;
+    }
+}
+
+OperatorToken *initOperatorToken(Arena *arena, int lineCount, OperatorType operatorType, Token *left, Token *right) {
+    OperatorToken *token = (OperatorToken*) tokenAlloc(arena, sizeof(OperatorToken));
+    initToken(&token->token, arena, lineCount, OPERATOR);
     token->operatorType = operatorType;
+    token->left = left;
+    token->right = right;
     return token;
 }
 
 void freeOperatorToken(OperatorToken *token) {
-    freeBaseToken(token->token);
-    token->token = NULL;
+    if (token->token.arena != NULL) {
+        return;
+    }
     free(token);
 }
 
-BuilderToken *initBuilderToken(int lineCount, IdentifierToken *variable, ExpressionToken *constraint) {
-    BuilderToken *token = (BuilderToken*) malloc(sizeof(BuilderToken));
-    token->token = initToken(lineCount, BUILDER);
+BuilderToken *initBuilderToken(Arena *arena, int lineCount, IdentifierToken *variable, ExpressionToken *constraint) {
+    BuilderToken *token = (BuilderToken*) tokenAlloc(arena, sizeof(BuilderToken));
+    initToken(&token->token, arena, lineCount, BUILDER);
     token->variable = variable;
     token->constraint = constraint;
     return token;
 }
 
 void freeBuilderToken(BuilderToken *token) {
-    freeBaseToken(token->token);
-    token->token = NULL;
+    if (token->token.arena != NULL) {
+        return;
+    }
     free(token);
 }
 
-SequenceToken *initSequenceToken(int lineCount, FiniteToken* prelist, IdentifierToken* variable, IdentifierToken* numerical, ExpressionToken* rule) {
-    SequenceToken *token = (SequenceToken*) malloc(sizeof(SequenceToken));
-    token->token = initToken(lineCount, SEQUENCE);
+SequenceToken *initSequenceToken(Arena *arena, int lineCount, FiniteToken* prelist, IdentifierToken* variable, IdentifierToken* numerical, ExpressionToken* rule) {
+    SequenceToken *token = (SequenceToken*) tokenAlloc(arena, sizeof(SequenceToken));
+    initToken(&token->token, arena, lineCount, SEQUENCE);
     token->prelist = prelist;
     token->variable = variable;
     token->numerical = numerical;
@@ -195,43 +376,30 @@ SequenceToken *initSequenceToken(int lineCount, FiniteToken* prelist, Identifier
 }
 
 void freeSequenceToken(SequenceToken *token) {
-    freeBaseToken(token->token);
+    if (token->token.arena != NULL) {
+        return;
+    }
     free(token);
 }
 
-ExpressionToken *initExpressionToken(int lineCount) {
-    ExpressionToken *token = (ExpressionToken *) malloc(sizeof(ExpressionToken));
-    token->token = initToken(lineCount, EXPRESSION);
-    token->tokenCount = 1;
-    token->current = 0;
-    token->tokens = (Token**) malloc(sizeof(Token*) * token->tokenCount);
+ExpressionToken *initExpressionToken(Arena *arena, int lineCount, Token *root) {
+    ExpressionToken *token = (ExpressionToken *) tokenAlloc(arena, sizeof(ExpressionToken));
+    initToken(&token->token, arena, lineCount, EXPRESSION);
+    token->root = root;
     return token;
 }
 
 void freeExpressionToken(ExpressionToken *token) {
-    free(token->tokens);
-    token->tokens = NULL;
-    freeBaseToken(token->token);
-    token->token = NULL;
-    free(token);
-}
-
-void ExpressionAddToken(ExpressionToken *token, Token *t) {
-    if (token->current >= token->tokenCount) {
-        token->tokenCount *= 2;
-        token->tokens = (Token **) malloc(sizeof(Token*) * token->tokenCount);
-    }
-    token->tokens[token->current++] = t;
-}
-
-void finaliseExpressionToken(ExpressionToken *token) {
-    if (token->tokenCount >= token->current) {
-        token->tokenCount = token->current;
-        token->tokens = (Token**) realloc(token->tokens, sizeof(Token*) * token->tokenCount);
+    if (token->token.arena != NULL) {
+        return;
     }
+    free(token);
 }
 
 void freeToken(Token *token) {
+    if (token->arena != NULL) {
+        return; // The whole arena is released at once.
+    }
     switch (token->tokenType) {
         case NUMBER:
             freeNumberToken((NumberToken *) token);
@@ -267,4 +435,401 @@ void freeToken(Token *token) {
     }
 }
 
+void freeTokenTree(Token *token) {
+    if (token == NULL || token->arena != NULL) {
+        return;
+    }
+    int i;
+    switch (token->tokenType) {
+        case FINITE: {
+            FiniteToken *finite = (FiniteToken *) token;
+            for (i = 0; i < finite->current; i++) {
+                freeTokenTree(finite->members[i]);
+            }
+            break;
+        }
+        case BUILDER:
+            freeTokenTree((Token *) ((BuilderToken *) token)->variable);
+            freeTokenTree((Token *) ((BuilderToken *) token)->constraint);
+            break;
+        case MATRIX: {
+            MatrixToken *matrix = (MatrixToken *) token;
+            for (i = 0; matrix->members != NULL && i < matrix->rowSize * matrix->columnSize; i++) {
+                freeTokenTree(matrix->members[i]);
+            }
+            break;
+        }
+        case SEQUENCE: {
+            SequenceToken *sequence = (SequenceToken *) token;
+            freeTokenTree((Token *) sequence->prelist);
+            freeTokenTree((Token *) sequence->variable);
+            freeTokenTree((Token *) sequence->numerical);
+            freeTokenTree((Token *) sequence->rule);
+            break;
+        }
+        case EXPRESSION:
+            freeTokenTree(((ExpressionToken *) token)->root);
+            break;
+        case OPERATOR:
+            freeTokenTree(((OperatorToken *) token)->left);
+            freeTokenTree(((OperatorToken *) token)->right);
+            break;
+        case IDENTIFIER:
+            if (((IdentifierToken *) token)->identifierType == Function) {
+                FunctionToken *function = (FunctionToken *) token;
+                for (i = 0; i < function->current; i++) {
+                    freeTokenTree(function->args[i]);
+                }
+            }
+            break;
+        case NUMBER:
+            break;
+    }
+    freeToken(token);
+}
+
+static IdentifierToken *copyIdentifierToken(Arena *arena, IdentifierToken *token) {
+    if (token == NULL) {
+        return NULL;
+    }
+    IdentifierToken *copy = initIdentifierToken(arena, token->token.lineCount, token->name);
+    copy->identifierType = token->identifierType;
+    return copy;
+}
+
+Token *copyToken(Arena *arena, Token *token) {
+    if (token == NULL) {
+        return NULL;
+    }
+    int i;
+    switch (token->tokenType) {
+        case NUMBER: {
+            NumberToken *source = (NumberToken *) token;
+            return (Token *) initNumberTokenValue(arena, token->lineCount, copyNumber(source->number), source->value);
+        }
+        case FINITE: {
+            FiniteToken *source = (FiniteToken *) token;
+            FiniteToken *copy = initFiniteToken(arena, token->lineCount);
+            finiteReserve(copy, source->current);
+            for (i = 0; i < source->current; i++) {
+                finiteAddElement(copy, copyToken(arena, source->members[i]));
+            }
+            finaliseFiniteToken(copy);
+            if (source->index != NULL) {
+                canonicaliseFiniteToken(copy);
+            }
+            return (Token *) copy;
+        }
+        case BUILDER: {
+            BuilderToken *source = (BuilderToken *) token;
+            return (Token *) initBuilderToken(arena, token->lineCount,
+                                              copyIdentifierToken(arena, source->variable),
+                                              (ExpressionToken *) copyToken(arena, (Token *) source->constraint));
+        }
+        case MATRIX: {
+            MatrixToken *source = (MatrixToken *) token;
+            MatrixToken *copy = initMatrixToken(arena, token->lineCount);
+            int size = source->rowSize * source->columnSize;
+            copy->rowSize = source->rowSize;
+            copy->columnSize = source->columnSize;
+            if (source->sparse != NULL) {
+                copy->sparse = copySparseMatrix(source->sparse);
+                return (Token *) copy;
+            }
+            mallocMatrixTokenArr(copy, 0);
+            for (i = 0; i < size; i++) {
+                copy->members[i] = copyToken(arena, source->members[i]);
+            }
+            return (Token *) copy;
+        }
+        case SEQUENCE: {
+            SequenceToken *source = (SequenceToken *) token;
+            return (Token *) initSequenceToken(arena, token->lineCount,
+                                               (FiniteToken *) copyToken(arena, (Token *) source->prelist),
+                                               copyIdentifierToken(arena, source->variable),
+                                               copyIdentifierToken(arena, source->numerical),
+                                               (ExpressionToken *) copyToken(arena, (Token *) source->rule));
+        }
+        case EXPRESSION: {
+            ExpressionToken *source = (ExpressionToken *) token;
+            return (Token *) initExpressionToken(arena, token->lineCount, copyToken(arena, source->root));
+        }
+        case OPERATOR: {
+            OperatorToken *source = (OperatorToken *) token;
+            return (Token *) initOperatorToken(arena, token->lineCount, source->operatorType,
+                                               copyToken(arena, source->left), copyToken(arena, source->right));
+        }
+        case IDENTIFIER:
+            if (((IdentifierToken *) token)->identifierType == Function) {
+                FunctionToken *source = (FunctionToken *) token;
+                FunctionToken *copy = initFunctionToken(arena, token->lineCount, source->identifier.name);
+                for (i = 0; i < source->current; i++) {
+                    addArgument(copy, copyToken(arena, source->args[i]));
+                }
+                finaliseFunctionToken(copy);
+                return (Token *) copy;
+            }
+            return (Token *) copyIdentifierToken(arena, (IdentifierToken *) token);
+    }
+    return NULL;
+}
+
+/**
+ * Scramble the bits of a hash, the finaliser of splitmix64.
+ */
+static uint64_t mixHash(uint64_t hash) {
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+static uint64_t combineHash(uint64_t hash, uint64_t value) {
+    return mixHash(hash * 0x9E3779B97F4A7C15ull + value);
+}
+
+static uint64_t hashString(const char *string) {
+    uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a.
+    while (*string) {
+        hash = (hash ^ (unsigned char) *string++) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/**
+ * Hash a number by its nearest double, equal numbers of any kind round to the same one.
+ */
+static uint64_t hashDouble(double value) {
+    uint64_t bits;
+    value += 0.0; // -0 to 0.
+    memcpy(&bits, &value, sizeof(bits));
+    return mixHash(bits);
+}
+
+/**
+ * Hash a number token by its double, which is the number rounded, so it is not rounded again.
+ */
+static uint64_t hashNumber(const NumberToken *token) {
+    if (numberIsError(token->number)) {
+        return mixHash(token->number.bits);
+    }
+    return hashDouble(token->value);
+}
+
+/**
+ * Whether a member is the number zero, which a compressed matrix does not store.
+ */
+static bool isZeroMember(const Token *member) {
+    while (member != NULL && member->tokenType == EXPRESSION) {
+        member = ((const ExpressionToken *) member)->root;
+    }
+    return member != NULL && member->tokenType == NUMBER && ((const NumberToken *) member)->value == 0;
+}
+
+/**
+ * Hash a matrix over its non-zero members and their positions, in any
+ * order, so compressed and plain storage of the same matrix agree.
+ */
+static uint64_t hashMatrix(const MatrixToken *matrix) {
+    uint64_t hash = combineHash(combineHash(MATRIX, matrix->rowSize), matrix->columnSize), sum = 0;
+    const SparseMatrix *sparse = matrix->sparse;
+    size_t line, k;
+    int i;
+    if (sparse == NULL) {
+        for (i = 0; i < matrix->rowSize * matrix->columnSize; i++) {
+            if (!isZeroMember(matrix->members[i])) {
+                sum += mixHash(combineHash((uint64_t) i, hashToken(matrix->members[i])));
+            }
+        }
+        return combineHash(hash, sum);
+    }
+    for (line = 0; line < (sparse->layout == SPARSE_ROWS ? sparse->rows : sparse->columns); line++) {
+        for (k = sparse->offsets[line]; k < sparse->offsets[line + 1]; k++) {
+            size_t position = sparse->layout == SPARSE_ROWS ? line * sparse->columns + sparse->indices[k] :
+                              sparse->indices[k] * sparse->columns + line;
+            sum += mixHash(combineHash((uint64_t) position, hashDouble(sparse->values[k])));
+        }
+    }
+    return combineHash(hash, sum);
+}
 
+/**
+ * Compare a plain matrix with a compressed one member by member.
+ */
+static bool sparseMembersEqual(const MatrixToken *plain, const SparseMatrix *sparse) {
+    int i, j;
+    for (i = 0; i < plain->rowSize; i++) {
+        for (j = 0; j < plain->columnSize; j++) {
+            const Token *member = plain->members[i * plain->columnSize + j];
+            while (member != NULL && member->tokenType == EXPRESSION) {
+                member = ((const ExpressionToken *) member)->root;
+            }
+            if (member == NULL || member->tokenType != NUMBER) {
+                return false;
+            }
+            Number value = numberFromDouble(sparseMatrixGet(sparse, (size_t) i, (size_t) j));
+            bool equal = numberCompare(((const NumberToken *) member)->number, value) == 0;
+            freeNumber(value);
+            if (!equal) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static uint64_t hashMembers(uint64_t hash, Token *const *members, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        hash = combineHash(hash, hashToken(members[i]));
+    }
+    return hash;
+}
+
+uint64_t hashToken(const Token *token) {
+    while (token != NULL && token->tokenType == EXPRESSION) {
+        token = ((const ExpressionToken *) token)->root;
+    }
+    if (token == NULL) {
+        return 0;
+    }
+    uint64_t hash = token->tokenType;
+    int i;
+    switch (token->tokenType) {
+        case NUMBER:
+            return hashNumber((const NumberToken *) token);
+        case FINITE: {
+            const FiniteToken *finite = (const FiniteToken *) token;
+            if (finite->index == NULL) {
+                return hashMembers(hash, finite->members, finite->current);
+            }
+            uint64_t sum = 0; // Order independent.
+            for (i = 0; i < finite->current; i++) {
+                sum += mixHash(hashToken(finite->members[i]));
+            }
+            return combineHash(hash + 1, sum);
+        }
+        case BUILDER: {
+            const BuilderToken *builder = (const BuilderToken *) token;
+            return combineHash(combineHash(hash, hashToken((const Token *) builder->variable)),
+                               hashToken((const Token *) builder->constraint));
+        }
+        case MATRIX:
+            return hashMatrix((const MatrixToken *) token);
+        case SEQUENCE: {
+            const SequenceToken *sequence = (const SequenceToken *) token;
+            hash = combineHash(hash, hashToken((const Token *) sequence->prelist));
+            hash = combineHash(hash, hashToken((const Token *) sequence->variable));
+            hash = combineHash(hash, hashToken((const Token *) sequence->numerical));
+            return combineHash(hash, hashToken((const Token *) sequence->rule));
+        }
+        case OPERATOR: {
+            const OperatorToken *operator = (const OperatorToken *) token;
+            hash = combineHash(hash, operator->operatorType);
+            return combineHash(combineHash(hash, hashToken(operator->left)), hashToken(operator->right));
+        }
+        case IDENTIFIER: {
+            const IdentifierToken *identifier = (const IdentifierToken *) token;
+            hash = combineHash(hash, hashString(identifier->name) + identifier->identifierType);
+            if (identifier->identifierType == Function) {
+                const FunctionToken *function = (const FunctionToken *) token;
+                hash = hashMembers(hash, function->args, function->current);
+            }
+            return hash;
+        }
+        default:
+            return hash;
+    }
+}
+
+static bool membersEqual(Token *const *a, Token *const *b, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        if (!tokensEqual(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool tokensEqual(const Token *a, const Token *b) {
+    while (a != NULL && a->tokenType == EXPRESSION) {
+        a = ((const ExpressionToken *) a)->root;
+    }
+    while (b != NULL && b->tokenType == EXPRESSION) {
+        b = ((const ExpressionToken *) b)->root;
+    }
+    if (a == b) {
+        return true;
+    }
+    if (a == NULL || b == NULL || a->tokenType != b->tokenType) {
+        return false;
+    }
+    int i;
+    switch (a->tokenType) {
+        case NUMBER: {
+            Number x = ((const NumberToken *) a)->number, y = ((const NumberToken *) b)->number;
+            if (numberIsError(x) || numberIsError(y)) { // Errors compare equal to every number otherwise.
+                return x.bits == y.bits;
+            }
+            return x.bits == y.bits || numberCompare(x, y) == 0;
+        }
+        case FINITE: {
+            const FiniteToken *x = (const FiniteToken *) a, *y = (const FiniteToken *) b;
+            if ((x->index == NULL) != (y->index == NULL) || x->current != y->current) {
+                return false;
+            }
+            if (x->index == NULL) {
+                return membersEqual(x->members, y->members, x->current);
+            }
+            for (i = 0; i < x->current; i++) {
+                if (!finiteContains(y, x->members[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case BUILDER: {
+            const BuilderToken *x = (const BuilderToken *) a, *y = (const BuilderToken *) b;
+            return tokensEqual((const Token *) x->variable, (const Token *) y->variable) &&
+                   tokensEqual((const Token *) x->constraint, (const Token *) y->constraint);
+        }
+        case MATRIX: {
+            const MatrixToken *x = (const MatrixToken *) a, *y = (const MatrixToken *) b;
+            if (x->rowSize != y->rowSize || x->columnSize != y->columnSize) {
+                return false;
+            }
+            if (x->sparse != NULL && y->sparse != NULL) {
+                return sparseMatrixEqual(x->sparse, y->sparse);
+            }
+            if (x->sparse != NULL || y->sparse != NULL) {
+                return x->sparse != NULL ? sparseMembersEqual(y, x->sparse) : sparseMembersEqual(x, y->sparse);
+            }
+            return membersEqual(x->members, y->members, x->rowSize * x->columnSize);
+        }
+        case SEQUENCE: {
+            const SequenceToken *x = (const SequenceToken *) a, *y = (const SequenceToken *) b;
+            return tokensEqual((const Token *) x->prelist, (const Token *) y->prelist) &&
+                   tokensEqual((const Token *) x->variable, (const Token *) y->variable) &&
+                   tokensEqual((const Token *) x->numerical, (const Token *) y->numerical) &&
+                   tokensEqual((const Token *) x->rule, (const Token *) y->rule);
+        }
+        case OPERATOR: {
+            const OperatorToken *x = (const OperatorToken *) a, *y = (const OperatorToken *) b;
+            return x->operatorType == y->operatorType && tokensEqual(x->left, y->left) &&
+                   tokensEqual(x->right, y->right);
+        }
+        case IDENTIFIER: {
+            const IdentifierToken *x = (const IdentifierToken *) a, *y = (const IdentifierToken *) b;
+            if (x->identifierType != y->identifierType || strcmp(x->name, y->name) != 0) {
+                return false;
+            }
+            if (x->identifierType == Function) {
+                const FunctionToken *f = (const FunctionToken *) a, *g = (const FunctionToken *) b;
+                return f->current == g->current && membersEqual(f->args, g->args, f->current);
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
@@ -6,6 +6,8 @@
 #define FLUXIONCORE_FLUXION_TOKEN_H
 
 #include "commons.h"
+#include "fluxion_arena.h"
+#include "fluxion_number.h"
 
 /**
  * Enum for token type.
@@ -23,27 +25,38 @@ typedef enum {
 
 /**
  * General, base struct for all tokens.
+ * Every token type embeds it as its first member, so
+ * a pointer to any token can be used as a Token pointer.
  */
 typedef struct {
     int lineCount;
     TokenType tokenType;
+    Arena *arena; // Arena the token lives in, NULL if heap allocated.
 } Token;
 
 /**
  * Represent any identifier.
  */
 typedef struct {
-    Token *token;
+    Token token;
     char *name;
     IdentifierType identifierType;
 } IdentifierToken;
 
 /**
  * Initialise an identifier.
- * @param token Token to init.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
  * @param name Name of the identifier.
  */
-IdentifierToken *initIdentifierToken(int lineCount, const char *name);
+IdentifierToken *initIdentifierToken(Arena *arena, int lineCount, const char *name);
+/**
+ * Initialise an identifier from the first length characters of name.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param lineCount Line the token appeared in.
+ * @param name Start of the name, does not need to be null terminated.
+ * @param length Length of the name.
+ */
+IdentifierToken *initIdentifierTokenSpan(Arena *arena, int lineCount, const char *name, size_t length);
 
 /**
  * Free the identifier.
@@ -55,7 +68,7 @@ void freeIdentifierToken(IdentifierToken *token);
  * Represent any Function
  */
 typedef struct {
-    IdentifierToken *identifier;
+    IdentifierToken identifier; // Shares the identifier header, identifierType is Function.
     Token **args;
     int current;
     int arity;
@@ -63,11 +76,21 @@ typedef struct {
 
 /**
  * Initialise the function token, given
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
  * @param lineCount Line the token appeared in.
  * @param name Name of the identifier.
  * @return the pointer to the newly created function
  */
-FunctionToken *initFunctionToken(int lineCount, const char *name);
+FunctionToken *initFunctionToken(Arena *arena, int lineCount, const char *name);
+/**
+ * Initialise the function token from the first length characters of name.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param lineCount Line the token appeared in.
+ * @param name Start of the name, does not need to be null terminated.
+ * @param length Length of the name.
+ * @return the pointer to the newly created function
+ */
+FunctionToken *initFunctionTokenSpan(Arena *arena, int lineCount, const char *name, size_t length);
 /**
  * Free the function token.
  * @param token Token to free.
@@ -89,17 +112,32 @@ void finaliseFunctionToken(FunctionToken *token);
  * A struct to hold numbers.
  */
 typedef struct {
-    Token *token;
-    double value;
+    Token token;
+    double value; // Nearest double, always set.
+    Number number; // Exact value, owned by the token.
 } NumberToken;
 
 /**
  * Initialise a number token, given.
- * @param token the newly allocated pointer to the token.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
  * @param lineCount the line the token appears in.
  * @param value Value of the transaction.
  */
-NumberToken *initNumberToken(int lineCount, double value);
+NumberToken *initNumberToken(Arena *arena, int lineCount, double value);
+/**
+ * Initialise a number token from a number.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param lineCount the line the token appears in.
+ * @param number Number to take ownership of.
+ */
+NumberToken *initNumberTokenNumber(Arena *arena, int lineCount, Number number);
+/**
+ * Initialise a number token from a scanned literal, keeping it exact if it can be.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param lineCount the line the token appears in.
+ * @param literal Scanned literal.
+ */
+NumberToken *initNumberTokenLiteral(Arena *arena, int lineCount, const NumberLiteral *literal);
 /**
  * Free the memory allocated to number token.
  * @param token Token to free.
@@ -108,33 +146,62 @@ void freeNumberToken(NumberToken *token);
 
 /**
  * Represents a matrix. Dynamically allocated.
+ * A matrix of numbers that are mostly zeros can be stored compressed instead,
+ * see compactMatrixToken, then members is NULL until a member is added.
  */
 typedef struct {
-    Token *token;
-    Token** members; // Flattened for higher performance.
+    Token token;
+    Token** members; // Row major, the member at row i and column j is at i * columnSize + j.
     int rowSize;
     int columnSize;
+    size_t memberCapacity; // Members allocated, grown geometrically as members are added.
+    struct SparseMatrix *sparse; // The members when compressed, NULL otherwise.
+    Token **reads; // Number token of each stored entry read while compressed, NULL until its first read.
+    Token *zero; // The number token every zero read while compressed shares.
+    Arena *made; // Holds the tokens a heap matrix makes itself, NULL until one is made.
 } MatrixToken;
 
 /**
  * Initialise a matrix token.
- * @param token to initialise.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
  * @param lineCount the token appears in.
  */
-MatrixToken *initMatrixToken(int lineCount);
+MatrixToken *initMatrixToken(Arena *arena, int lineCount);
 /**
  * Free the matrix token.
  * @param token Token to free.
  */
 void freeMatrixToken(MatrixToken *token);
 /**
- * Add an element to the matrix.
+ * Allocate the members of a matrix for its current size, keeping the first oldSize.
+ * @param matrix Matrix whose rowSize and columnSize are set.
+ * @param oldSize Number of members allocated before.
+ */
+void mallocMatrixTokenArr(MatrixToken *matrix, int oldSize);
+/**
+ * Add an element to the matrix, growing it if the position is outside.
+ * Members of the grown part that are not added yet are NULL. A compressed matrix stays compressed
+ * when the element is a number a double holds exactly, the element is then only read and stays
+ * with its owner, it is expanded first otherwise.
+ * Issues an error and adds nothing if the position is negative.
  * @param token Matrix to add to.
  * @param row Row to add the element to.
  * @param col Col to add the element to.
  * @param element Element to add.
  */
 void matrixAddMember(MatrixToken *token, int row, int col, Token *element);
+/**
+ * Arena for the tokens a matrix makes itself, the arena of the matrix or,
+ * on the heap, one it owns, so such tokens are never freed on their own.
+ */
+Arena *matrixMadeArena(MatrixToken *token);
+/**
+ * Get an element of the matrix. A compressed matrix is read in place, a
+ * stored entry gets a number token on its first read and every zero shares
+ * one, so the tokens made are at most the non-zeros plus one. They are
+ * owned by the matrix and kept until it is freed.
+ * @return the element, NULL if the position is outside the matrix or negative.
+ */
 Token *matrixGetMember(MatrixToken *token, int row, int col);
 
 /**
@@ -142,17 +209,19 @@ Token *matrixGetMember(MatrixToken *token, int row, int col);
  * Is dynamically allocated.
  */
 typedef struct {
-    Token *token;
+    Token token;
     Token **members;
     int memberCount;
     int current;
+    struct FiniteIndex *index; // Membership index once canonicalised as a set, NULL for plain lists like prelists.
 } FiniteToken;
 
 /**
  * Initialise the token.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
  * @param lineCount The line the token was in.
  */
-FiniteToken *initFiniteToken(int lineCount);
+FiniteToken *initFiniteToken(Arena *arena, int lineCount);
 /**
  * Free the previously initialised token.
  * @param token to free.
@@ -170,22 +239,33 @@ void finaliseFiniteToken(FiniteToken *token);
  * @param element element to add to.
  */
 void finiteAddElement(FiniteToken *token, Token *element);
+/**
+ * Make room for members up front.
+ * @param token Token to grow.
+ * @param capacity Number of members it should hold without growing.
+ */
+void finiteReserve(FiniteToken *token, int capacity);
 
 /**
- * A typedef that holds operators.
+ * A typedef that holds operators, together with their operands.
  */
 typedef struct {
-    Token *token;
+    Token token;
     OperatorType operatorType;
+    Token *left; // Left operand, NULL for prefix operators.
+    Token *right; // Right operand, NULL for postfix operators.
 } OperatorToken;
 
 /**
  * Initialise a new operator token.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
  * @param lineCount Line the operator appears in.
  * @param operatorType Type of the operator.
+ * @param left Left operand, NULL for prefix operators.
+ * @param right Right operand, NULL for postfix operators.
  * @return Pointer to the newly created operator token.
  */
-OperatorToken *initOperatorToken(int lineCount, OperatorType operatorType);
+OperatorToken *initOperatorToken(Arena *arena, int lineCount, OperatorType operatorType, Token *left, Token *right);
 /**
  * Free the operator token.
  * @param token
@@ -193,19 +273,22 @@ OperatorToken *initOperatorToken(int lineCount, OperatorType operatorType);
 void freeOperatorToken(OperatorToken *token);
 
 /**
- * Represents an expression.
+ * Represents an expression, the root of a tree of
+ * operator tokens whose leaves are the operands.
  */
 typedef struct {
-    Token *token;
-    Token **tokens;
-    int current;
-    int tokenCount;
+    Token token;
+    Token *root; // NULL for an empty expression.
 } ExpressionToken;
 
-ExpressionToken *initExpressionToken(int lineCount);
+/**
+ * Initialise an expression.
+ * @param arena Arena to allocate from, NULL to allocate on the heap.
+ * @param lineCount Line the expression starts in.
+ * @param root Root of the expression tree.
+ */
+ExpressionToken *initExpressionToken(Arena *arena, int lineCount, Token *root);
 void freeExpressionToken(ExpressionToken *token);
-void ExpressionAddToken(ExpressionToken *token, Token *t);
-void finaliseExpressionToken(ExpressionToken *token);
 
 /**
  * A typedef that represents a
@@ -213,12 +296,12 @@ void finaliseExpressionToken(ExpressionToken *token);
  * builder notation.
  */
 typedef struct {
-    Token *token;
+    Token token;
     IdentifierToken *variable; // Part before the |
     ExpressionToken *constraint; // Part after the |
 } BuilderToken;
 
-BuilderToken *initBuilderToken(int lineCount, IdentifierToken *variable, ExpressionToken *constraint);
+BuilderToken *initBuilderToken(Arena *arena, int lineCount, IdentifierToken *variable, ExpressionToken *constraint);
 void freeBuilderToken(BuilderToken *token);
 
 /**
@@ -227,20 +310,50 @@ void freeBuilderToken(BuilderToken *token);
  * {1, 1} x_n -> x_{n - 1} + x_{n - 2}
  */
 typedef struct {
-    Token *token;
+    Token token;
     FiniteToken *prelist; // The before part.
     IdentifierToken *variable; // x of the x_n
     IdentifierToken *numerical; //n of the x_n
     ExpressionToken  *rule; // The actual generation rule.
 } SequenceToken;
 
-SequenceToken *initSequenceToken(int lineCount, FiniteToken* prelist, IdentifierToken* variable, IdentifierToken* numerical, ExpressionToken* rule);
+SequenceToken *initSequenceToken(Arena *arena, int lineCount, FiniteToken* prelist, IdentifierToken* variable, IdentifierToken* numerical, ExpressionToken* rule);
 void freeSequenceToken(SequenceToken *token);
 
 /**
  * Free a token, with respect to its Token type.
+ * Tokens that live in an arena are left alone, they
+ * are released together when the arena is freed.
  * @param token Token to free.
  */
 void freeToken(Token *token);
+/**
+ * Free a heap token and every token it refers to, as copyToken(NULL, ...) makes them.
+ * Tokens that live in an arena are left alone, along with what they refer to.
+ * @param token Token to free, may be NULL.
+ */
+void freeTokenTree(Token *token);
+
+/**
+ * Deep copy a token and everything it refers to.
+ * Used to let a token outlive the arena it was parsed into.
+ * @param arena Arena to copy into, NULL to copy onto the heap.
+ * @param token Token to copy.
+ * @return the copied token.
+ */
+Token *copyToken(Arena *arena, Token *token);
+
+/**
+ * Hash a token by its structure, tokens tokensEqual finds equal hash the same.
+ * Expressions hash as their roots and canonical sets ignore member order.
+ * @param token Token to hash, may be NULL.
+ */
+uint64_t hashToken(const Token *token);
+/**
+ * Whether two tokens are structurally equal. Numbers compare by value,
+ * so 2 and 2.0 are equal, canonical sets compare as sets and
+ * everything else member by member.
+ */
+bool tokensEqual(const Token *a, const Token *b);
 
 #endif //FLUXIONCORE_FLUXION_TOKEN_H
@@ -0,0 +1,623 @@
+//
+// Register based bytecode for numeric evaluation of expression trees.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "fluxion_autodiff.h"
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+#define POWER_CHAIN_LIMIT 32 // Larger integer exponents go through pow.
+#define LOCAL_REGISTERS 64
+
+/*
+ * While compiling, operands are tagged with the kind of register they
+ * name, since the size of the constant pool is only known at the end.
+ */
+#define OPERAND_CONSTANT 0u
+#define OPERAND_VARIABLE (1u << 30)
+#define OPERAND_TEMPORARY (2u << 30)
+#define OPERAND_KIND (3u << 30)
+
+typedef struct {
+    const char *name;
+    double (*function)(double);
+} Builtin;
+
+static const Builtin builtins[BUILTIN_COUNT] = {
+        [BUILTIN_SIN] = {"sin", sin}, [BUILTIN_COS] = {"cos", cos}, [BUILTIN_TAN] = {"tan", tan},
+        [BUILTIN_EXP] = {"exp", exp}, [BUILTIN_LOG] = {"log", log}, [BUILTIN_SQRT] = {"sqrt", sqrt},
+        [BUILTIN_ABS] = {"abs", fabs}
+};
+
+typedef struct {
+    uint16_t opcode;
+    uint32_t target;
+    uint32_t a;
+    uint32_t b;
+} PendingInstruction;
+
+typedef struct {
+    PendingInstruction *code;
+    uint32_t codeCount;
+    uint32_t codeCapacity;
+    double *constants;
+    uint32_t constantCount;
+    uint32_t constantCapacity;
+    const char *const *variables;
+    int variableCount;
+    uint32_t temporaries; // Temporaries in use, they are freed in the reverse order.
+    uint32_t maxTemporaries;
+    ProgramDerivative *derivatives;
+    uint32_t derivativeCount;
+    uint32_t derivativeCapacity;
+    bool failed;
+} Compiler;
+
+static void compileError(Compiler *compiler, const Token *token, const char *message) {
+    char str[256];
+    snprintf(str, sizeof(str), "at line %i, %s\n", token ? token->lineCount : 0, message);
+    Error newError = {Undefined, str};
+    issueError(&newError);
+    compiler->failed = true;
+}
+
+static uint32_t addConstant(Compiler *compiler, double value) {
+    uint32_t i;
+    for (i = 0; i < compiler->constantCount; i++) {
+        if (memcmp(compiler->constants + i, &value, sizeof(double)) == 0) {
+            return OPERAND_CONSTANT | i;
+        }
+    }
+    if (compiler->constantCount >= compiler->constantCapacity) {
+        compiler->constantCapacity = compiler->constantCapacity ? compiler->constantCapacity * 2 : 8;
+        compiler->constants = (double *) realloc(compiler->constants, sizeof(double) * compiler->constantCapacity);
+    }
+    compiler->constants[compiler->constantCount] = value;
+    return OPERAND_CONSTANT | compiler->constantCount++;
+}
+
+static bool isConstant(uint32_t operand) {
+    return (operand & OPERAND_KIND) == OPERAND_CONSTANT;
+}
+
+static double constantValue(const Compiler *compiler, uint32_t operand) {
+    return compiler->constants[operand & ~OPERAND_KIND];
+}
+
+static void releaseOperand(Compiler *compiler, uint32_t operand) {
+    if ((operand & OPERAND_KIND) == OPERAND_TEMPORARY) {
+        compiler->temporaries--;
+    }
+}
+
+static uint32_t allocateTemporary(Compiler *compiler) {
+    uint32_t temporary = compiler->temporaries++;
+    if (compiler->temporaries > compiler->maxTemporaries) {
+        compiler->maxTemporaries = compiler->temporaries;
+    }
+    return OPERAND_TEMPORARY | temporary;
+}
+
+static void emitInto(Compiler *compiler, Opcode opcode, uint32_t target, uint32_t a, uint32_t b) {
+    if (compiler->codeCount >= compiler->codeCapacity) {
+        compiler->codeCapacity = compiler->codeCapacity ? compiler->codeCapacity * 2 : 16;
+        compiler->code = (PendingInstruction *) realloc(compiler->code,
+                                                        sizeof(PendingInstruction) * compiler->codeCapacity);
+    }
+    PendingInstruction *instruction = compiler->code + compiler->codeCount++;
+    instruction->opcode = (uint16_t) opcode;
+    instruction->target = target;
+    instruction->a = a;
+    instruction->b = b;
+}
+
+/**
+ * Release the operands and emit target = a op b into a fresh temporary,
+ * which reuses the slot of a released operand when it can.
+ * @return the target.
+ */
+static uint32_t emit(Compiler *compiler, Opcode opcode, uint32_t a, uint32_t b, bool bIsRegister) {
+    if (bIsRegister) {
+        releaseOperand(compiler, b);
+    }
+    releaseOperand(compiler, a);
+    uint32_t target = allocateTemporary(compiler);
+    emitInto(compiler, opcode, target, a, b);
+    return target;
+}
+
+/**
+ * Raise to a small integer power with a chain of multiplications,
+ * squaring for every bit of the exponent below the top one.
+ * @return the result, in the slot of base if base is a temporary.
+ */
+static uint32_t compilePowerChain(Compiler *compiler, uint32_t base, int exponent) {
+    unsigned remaining = exponent < 0 ? 0u - (unsigned) exponent : (unsigned) exponent;
+    if (remaining == 0) {
+        releaseOperand(compiler, base);
+        return addConstant(compiler, 1);
+    }
+    int bit = 0;
+    while (remaining >> (bit + 1)) {
+        bit++;
+    }
+    uint32_t result = base;
+    if (bit > 0) { // base stays alive while the chain runs, so the chain gets its own slot.
+        uint32_t chain = allocateTemporary(compiler);
+        for (bit--; bit >= 0; bit--) {
+            emitInto(compiler, OP_MULTIPLY, chain, result, result);
+            result = chain;
+            if (remaining >> bit & 1) {
+                emitInto(compiler, OP_MULTIPLY, chain, chain, base);
+            }
+        }
+        releaseOperand(compiler, chain);
+        if ((base & OPERAND_KIND) == OPERAND_TEMPORARY) { // Finish in the slot of base and free the chain's.
+            compiler->code[compiler->codeCount - 1].target = base;
+            result = base;
+        } else {
+            result = allocateTemporary(compiler);
+        }
+    }
+    if (exponent < 0) {
+        return emit(compiler, OP_DIVIDE, addConstant(compiler, 1), result, true);
+    }
+    return result;
+}
+
+/**
+ * Value of an instruction with constant operands, used to fold constants.
+ */
+static double foldConstant(Opcode opcode, double a, double b, uint32_t immediate) {
+    switch (opcode) {
+        case OP_ADD:
+            return a + b;
+        case OP_SUBTRACT:
+            return a - b;
+        case OP_MULTIPLY:
+            return a * b;
+        case OP_DIVIDE:
+            return a / b;
+        case OP_POWER:
+            return pow(a, b);
+        case OP_NEGATE:
+            return -a;
+        case OP_NOT:
+            return !a;
+        case OP_FACTORIAL:
+            return tgamma(a + 1);
+        case OP_LESS:
+            return a < b;
+        case OP_GREATER:
+            return a > b;
+        case OP_LEQ:
+            return a <= b;
+        case OP_GEQ:
+            return a >= b;
+        case OP_EQUAL:
+            return a == b;
+        case OP_NEQ:
+            return a != b;
+        case OP_AND:
+            return a && b;
+        case OP_OR:
+            return a || b;
+        case OP_CALL:
+            return builtins[immediate].function(a);
+        default:
+            return NAN;
+    }
+}
+
+static Opcode binaryOpcode(OperatorType operatorType) {
+    switch (operatorType) {
+        case PLUS:
+            return OP_ADD;
+        case MINUS:
+            return OP_SUBTRACT;
+        case MULTIPLY:
+            return OP_MULTIPLY;
+        case DIVIDE:
+            return OP_DIVIDE;
+        case POWER:
+            return OP_POWER;
+        case LESS:
+            return OP_LESS;
+        case GREATER:
+            return OP_GREATER;
+        case LEQ:
+            return OP_LEQ;
+        case GEQ:
+            return OP_GEQ;
+        case EQUAL:
+            return OP_EQUAL;
+        case NEQ:
+            return OP_NEQ;
+        case AMPERSAND:
+            return OP_AND;
+        case BAR:
+            return OP_OR;
+        default:
+            return OPCODE_COUNT; // Symbolic only.
+    }
+}
+
+static uint32_t compileNode(Compiler *compiler, const Token *token);
+
+/**
+ * Compile e' into an OP_DERIVATIVE, the primes of e'' are taken together.
+ */
+static uint32_t compileDiff(Compiler *compiler, const OperatorToken *token) {
+    int order;
+    Program *program = compileDerivative(&token->token, compiler->variables, compiler->variableCount, &order);
+    if (program == NULL) {
+        compiler->failed = true;
+        return 0;
+    }
+    if (program->codeCount == 1 && program->code[0].a < program->constantCount) { // e is a constant.
+        freeProgram(program);
+        return addConstant(compiler, 0);
+    }
+    if (order > AUTODIFF_MAX_ORDER || compiler->derivativeCount >= PROGRAM_MAX_DERIVATIVES) {
+        freeProgram(program);
+        compileError(compiler, &token->token, order > AUTODIFF_MAX_ORDER ? "Derivative order is too high." :
+                                              "Expression is too large to compile.");
+        return 0;
+    }
+    if (compiler->derivativeCount >= compiler->derivativeCapacity) {
+        compiler->derivativeCapacity = compiler->derivativeCapacity ? compiler->derivativeCapacity * 2 : 4;
+        compiler->derivatives = (ProgramDerivative *) realloc(compiler->derivatives, sizeof(ProgramDerivative) *
+                                                                                     compiler->derivativeCapacity);
+    }
+    compiler->derivatives[compiler->derivativeCount] = (ProgramDerivative) {program, order};
+    uint32_t target = allocateTemporary(compiler);
+    emitInto(compiler, OP_DERIVATIVE, target, compiler->derivativeCount++, 0);
+    return target;
+}
+
+static uint32_t compileUnary(Compiler *compiler, Opcode opcode, uint32_t operand, uint32_t immediate) {
+    if (compiler->failed) {
+        return 0;
+    }
+    if (isConstant(operand)) {
+        return addConstant(compiler, foldConstant(opcode, constantValue(compiler, operand), 0, immediate));
+    }
+    return emit(compiler, opcode, operand, immediate, false);
+}
+
+static uint32_t compileOperator(Compiler *compiler, const OperatorToken *token) {
+    if (token->left == NULL || token->right == NULL) {
+        const Token *operand = token->left ? token->left : token->right;
+        Opcode opcode;
+        switch (token->operatorType) {
+            case PLUS:
+                return compileNode(compiler, operand);
+            case MINUS:
+                opcode = OP_NEGATE;
+                break;
+            case NOT:
+                opcode = OP_NOT;
+                break;
+            case FACTORIAL:
+                opcode = OP_FACTORIAL;
+                break;
+            case DIFF:
+                return compileDiff(compiler, token);
+            default:
+                compileError(compiler, &token->token, "Operator can not be evaluated numerically.");
+                return 0;
+        }
+        return compileUnary(compiler, opcode, compileNode(compiler, operand), 0);
+    }
+    Opcode opcode = binaryOpcode(token->operatorType);
+    if (opcode == OPCODE_COUNT) {
+        compileError(compiler, &token->token, "Operator can not be evaluated numerically.");
+        return 0;
+    }
+    uint32_t a = compileNode(compiler, token->left);
+    uint32_t b = compileNode(compiler, token->right);
+    if (compiler->failed) {
+        return 0;
+    }
+    if (isConstant(a) && isConstant(b)) {
+        return addConstant(compiler, foldConstant(opcode, constantValue(compiler, a), constantValue(compiler, b), 0));
+    }
+    if (opcode == OP_POWER && isConstant(b)) { // Small integer powers become multiplications.
+        double exponent = constantValue(compiler, b);
+        if (exponent == floor(exponent) && fabs(exponent) <= POWER_CHAIN_LIMIT) {
+            return compilePowerChain(compiler, a, (int) exponent);
+        }
+    }
+    return emit(compiler, opcode, a, b, true);
+}
+
+static uint32_t compileNode(Compiler *compiler, const Token *token) {
+    if (compiler->failed) {
+        return 0;
+    }
+    if (token == NULL) {
+        compileError(compiler, NULL, "Missing operand.");
+        return 0;
+    }
+    switch (token->tokenType) {
+        case NUMBER:
+            return addConstant(compiler, ((const NumberToken *) token)->value);
+        case EXPRESSION:
+            return compileNode(compiler, ((const ExpressionToken *) token)->root);
+        case OPERATOR:
+            return compileOperator(compiler, (const OperatorToken *) token);
+        case IDENTIFIER: {
+            const IdentifierToken *identifier = (const IdentifierToken *) token;
+            int i;
+            if (identifier->identifierType == Variable) {
+                for (i = 0; i < compiler->variableCount; i++) {
+                    if (strcmp(compiler->variables[i], identifier->name) == 0) {
+                        return OPERAND_VARIABLE | (uint32_t) i;
+                    }
+                }
+                compileError(compiler, token, "Unknown variable.");
+                return 0;
+            }
+            const FunctionToken *function = (const FunctionToken *) token;
+            for (i = 0; i < (int) BUILTIN_COUNT; i++) {
+                if (strcmp(builtins[i].name, identifier->name) == 0) {
+                    break;
+                }
+            }
+            if (i == (int) BUILTIN_COUNT || function->current != 1) {
+                compileError(compiler, token, "Unknown function.");
+                return 0;
+            }
+            return compileUnary(compiler, OP_CALL, compileNode(compiler, function->args[0]), (uint32_t) i);
+        }
+        default:
+            compileError(compiler, token, "Expression can not be evaluated numerically.");
+            return 0;
+    }
+}
+
+static void markConstant(uint32_t *remap, uint32_t operand) {
+    if (isConstant(operand)) {
+        remap[operand] = 1;
+    }
+}
+
+static uint32_t remapConstant(const uint32_t *remap, uint32_t operand) {
+    return isConstant(operand) ? remap[operand] : operand;
+}
+
+/**
+ * Drop the constants folding consumed, so evaluations do not copy them.
+ * @param compiler Compiler to compact.
+ * @param result Result operand, updated in place.
+ */
+static void compactConstants(Compiler *compiler, uint32_t *result) {
+    if (compiler->constantCount == 0) {
+        return;
+    }
+    uint32_t *remap = (uint32_t *) calloc(compiler->constantCount, sizeof(uint32_t));
+    uint32_t i, used = 0;
+    for (i = 0; i < compiler->codeCount; i++) {
+        if (opcodeUsesRegisterA(compiler->code[i].opcode)) {
+            markConstant(remap, compiler->code[i].a);
+        }
+        if (opcodeUsesRegisterB(compiler->code[i].opcode)) {
+            markConstant(remap, compiler->code[i].b);
+        }
+    }
+    markConstant(remap, *result);
+    for (i = 0; i < compiler->constantCount; i++) {
+        if (remap[i]) {
+            compiler->constants[used] = compiler->constants[i];
+            remap[i] = used++;
+        }
+    }
+    for (i = 0; i < compiler->codeCount; i++) {
+        if (opcodeUsesRegisterA(compiler->code[i].opcode)) {
+            compiler->code[i].a = remapConstant(remap, compiler->code[i].a);
+        }
+        if (opcodeUsesRegisterB(compiler->code[i].opcode)) {
+            compiler->code[i].b = remapConstant(remap, compiler->code[i].b);
+        }
+    }
+    *result = remapConstant(remap, *result);
+    compiler->constantCount = used;
+    free(remap);
+}
+
+static uint16_t relocate(const Program *program, uint32_t operand) {
+    uint32_t index = operand & ~OPERAND_KIND;
+    switch (operand & OPERAND_KIND) {
+        case OPERAND_VARIABLE:
+            return (uint16_t) (program->constantCount + index);
+        case OPERAND_TEMPORARY:
+            return (uint16_t) (program->constantCount + program->variableCount + index);
+        default:
+            return (uint16_t) index;
+    }
+}
+
+static void freeDerivatives(ProgramDerivative *derivatives, uint32_t count) {
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        freeProgram(derivatives[i].program);
+    }
+    free(derivatives);
+}
+
+Program *compileExpression(const Token *root, const char *const *variables, int variableCount) {
+    Compiler compiler;
+    memset(&compiler, 0, sizeof(Compiler));
+    compiler.variables = variables;
+    compiler.variableCount = variableCount;
+    uint32_t result = compileNode(&compiler, root);
+    if (!compiler.failed) {
+        compactConstants(&compiler, &result);
+    }
+    size_t registerCount = (size_t) compiler.constantCount + variableCount + compiler.maxTemporaries;
+    if (!compiler.failed && registerCount > PROGRAM_MAX_REGISTERS) {
+        compileError(&compiler, root, "Expression is too large to compile.");
+    }
+    if (compiler.failed) {
+        free(compiler.code);
+        free(compiler.constants);
+        freeDerivatives(compiler.derivatives, compiler.derivativeCount);
+        return NULL;
+    }
+    Program *program = (Program *) malloc(sizeof(Program));
+    program->constantCount = (uint16_t) compiler.constantCount;
+    program->variableCount = (uint16_t) variableCount;
+    program->registerCount = (uint16_t) registerCount;
+    program->constants = compiler.constants;
+    program->derivatives = compiler.derivatives;
+    program->derivativeCount = (uint16_t) compiler.derivativeCount;
+    program->codeCount = compiler.codeCount + 1;
+    program->code = (Instruction *) malloc(sizeof(Instruction) * program->codeCount);
+    uint32_t i;
+    for (i = 0; i < compiler.codeCount; i++) {
+        const PendingInstruction *pending = compiler.code + i;
+        Instruction *instruction = program->code + i;
+        instruction->opcode = pending->opcode;
+        instruction->target = relocate(program, pending->target);
+        instruction->a = opcodeUsesRegisterA(pending->opcode) ? relocate(program, pending->a) : (uint16_t) pending->a;
+        instruction->b = opcodeUsesRegisterB(pending->opcode) ? relocate(program, pending->b) : (uint16_t) pending->b;
+    }
+    Instruction *ret = program->code + compiler.codeCount;
+    ret->opcode = OP_RETURN;
+    ret->target = 0;
+    ret->a = relocate(program, result);
+    ret->b = 0;
+    free(compiler.code);
+    return program;
+}
+
+void freeProgram(Program *program) {
+    freeDerivatives(program->derivatives, program->derivativeCount);
+    free(program->code);
+    free(program->constants);
+    free(program);
+}
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_CASE(opcode) label_##opcode
+#define VM_DISPATCH() goto *dispatch[ip->opcode]
+#else
+#define VM_CASE(opcode) case opcode
+#define VM_DISPATCH() continue
+#endif
+#define VM_NEXT() ip++; VM_DISPATCH()
+#define R registers
+
+double runProgramRegisters(const Program *program, double *registers) {
+    const Instruction *ip = program->code;
+#ifdef VM_COMPUTED_GOTO
+    static const void *dispatch[OPCODE_COUNT] = {
+            [OP_ADD] = &&label_OP_ADD, [OP_SUBTRACT] = &&label_OP_SUBTRACT,
+            [OP_MULTIPLY] = &&label_OP_MULTIPLY, [OP_DIVIDE] = &&label_OP_DIVIDE,
+            [OP_POWER] = &&label_OP_POWER, [OP_NEGATE] = &&label_OP_NEGATE,
+            [OP_NOT] = &&label_OP_NOT, [OP_FACTORIAL] = &&label_OP_FACTORIAL,
+            [OP_LESS] = &&label_OP_LESS,
+            [OP_GREATER] = &&label_OP_GREATER, [OP_LEQ] = &&label_OP_LEQ,
+            [OP_GEQ] = &&label_OP_GEQ, [OP_EQUAL] = &&label_OP_EQUAL,
+            [OP_NEQ] = &&label_OP_NEQ, [OP_AND] = &&label_OP_AND,
+            [OP_OR] = &&label_OP_OR, [OP_CALL] = &&label_OP_CALL,
+            [OP_DERIVATIVE] = &&label_OP_DERIVATIVE, [OP_RETURN] = &&label_OP_RETURN
+    };
+    VM_DISPATCH();
+#else
+    for (;;) switch ((Opcode) ip->opcode) {
+#endif
+    VM_CASE(OP_ADD):
+        R[ip->target] = R[ip->a] + R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_SUBTRACT):
+        R[ip->target] = R[ip->a] - R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_MULTIPLY):
+        R[ip->target] = R[ip->a] * R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_DIVIDE):
+        R[ip->target] = R[ip->a] / R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_POWER):
+        R[ip->target] = pow(R[ip->a], R[ip->b]);
+        VM_NEXT();
+    VM_CASE(OP_NEGATE):
+        R[ip->target] = -R[ip->a];
+        VM_NEXT();
+    VM_CASE(OP_NOT):
+        R[ip->target] = !R[ip->a];
+        VM_NEXT();
+    VM_CASE(OP_FACTORIAL):
+        R[ip->target] = tgamma(R[ip->a] + 1);
+        VM_NEXT();
+    VM_CASE(OP_LESS):
+        R[ip->target] = R[ip->a] < R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_GREATER):
+        R[ip->target] = R[ip->a] > R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_LEQ):
+        R[ip->target] = R[ip->a] <= R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_GEQ):
+        R[ip->target] = R[ip->a] >= R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_EQUAL):
+        R[ip->target] = R[ip->a] == R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_NEQ):
+        R[ip->target] = R[ip->a] != R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_AND):
+        R[ip->target] = R[ip->a] && R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_OR):
+        R[ip->target] = R[ip->a] || R[ip->b];
+        VM_NEXT();
+    VM_CASE(OP_CALL):
+        R[ip->target] = builtins[ip->b].function(R[ip->a]);
+        VM_NEXT();
+    VM_CASE(OP_DERIVATIVE):
+        R[ip->target] = evaluateDerivative(program->derivatives + ip->a, R + program->constantCount);
+        VM_NEXT();
+    VM_CASE(OP_RETURN):
+        return R[ip->a];
+#ifndef VM_COMPUTED_GOTO
+        default:
+            return NAN;
+    }
+#endif
+}
+
+#undef R
+
+void loadProgramConstants(const Program *program, double *registers) {
+    if (program->constantCount > 0) {
+        memcpy(registers, program->constants, sizeof(double) * program->constantCount);
+    }
+}
+
+double callBuiltin(BuiltinFunction function, double argument) {
+    return function < BUILTIN_COUNT ? builtins[function].function(argument) : NAN;
+}
+
+double runProgram(const Program *program, const double *arguments) {
+    double local[LOCAL_REGISTERS];
+    double *registers = program->registerCount <= LOCAL_REGISTERS ?
+                        local : (double *) malloc(sizeof(double) * program->registerCount);
+    loadProgramConstants(program, registers);
+    if (program->variableCount > 0) {
+        memcpy(registers + program->constantCount, arguments, sizeof(double) * program->variableCount);
+    }
+    double value = runProgramRegisters(program, registers);
+    if (registers != local) {
+        free(registers);
+    }
+    return value;
+}
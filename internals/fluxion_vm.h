@@ -0,0 +1,145 @@
+//
+// Register based bytecode for numeric evaluation of expression trees.
+//
+
+#ifndef FLUXIONCORE_FLUXION_VM_H
+#define FLUXIONCORE_FLUXION_VM_H
+#include "commons.h"
+#include "fluxion_token.h"
+
+/**
+ * Opcodes, one family per evaluable OperatorType plus calls.
+ * Operands are register indexes unless noted otherwise.
+ */
+typedef enum {
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_POWER,
+    OP_NEGATE,
+    OP_NOT,
+    OP_FACTORIAL,
+    OP_LESS,
+    OP_GREATER,
+    OP_LEQ,
+    OP_GEQ,
+    OP_EQUAL,
+    OP_NEQ,
+    OP_AND,
+    OP_OR,
+    OP_CALL, // b is a BuiltinFunction.
+    OP_DERIVATIVE, // a is an index into the derivatives of the program.
+    OP_RETURN, // Returns register a.
+    OPCODE_COUNT
+} Opcode;
+
+/**
+ * Functions calls can be compiled to.
+ */
+typedef enum {
+    BUILTIN_SIN,
+    BUILTIN_COS,
+    BUILTIN_TAN,
+    BUILTIN_EXP,
+    BUILTIN_LOG,
+    BUILTIN_SQRT,
+    BUILTIN_ABS,
+    BUILTIN_COUNT
+} BuiltinFunction;
+
+/**
+ * Whether the a operand of an opcode is a register, rather than an immediate.
+ */
+static inline bool opcodeUsesRegisterA(uint16_t opcode) {
+    return opcode != OP_DERIVATIVE;
+}
+
+/**
+ * Whether the b operand of an opcode is a register, rather than unused or an immediate.
+ */
+static inline bool opcodeUsesRegisterB(uint16_t opcode) {
+    return opcode != OP_CALL && opcode != OP_NEGATE && opcode != OP_NOT && opcode != OP_FACTORIAL &&
+           opcode != OP_DERIVATIVE;
+}
+
+/**
+ * A single instruction, target = a op b.
+ */
+typedef struct {
+    uint16_t opcode;
+    uint16_t target;
+    uint16_t a;
+    uint16_t b;
+} Instruction;
+
+#define PROGRAM_MAX_REGISTERS 0xFFFF
+#define PROGRAM_MAX_DERIVATIVES 0xFFFF
+
+typedef struct ProgramDerivative ProgramDerivative;
+
+/**
+ * A compiled expression. Registers are laid out as the constant
+ * pool, then the variables, then the temporaries, so an evaluation
+ * copies the constants and arguments in and runs the code.
+ */
+typedef struct {
+    Instruction *code;
+    uint32_t codeCount;
+    double *constants;
+    uint16_t constantCount;
+    uint16_t variableCount;
+    uint16_t registerCount;
+    ProgramDerivative *derivatives; // Taken by the OP_DERIVATIVE instructions, NULL if there are none.
+    uint16_t derivativeCount;
+} Program;
+
+/**
+ * An e' inside an expression, the derivative of e with respect to the first
+ * variable at the values the variables have when the instruction runs.
+ */
+struct ProgramDerivative {
+    Program *program; // Of e, compiled with the same variables.
+    int order;
+};
+
+/**
+ * Compile an expression tree for numeric evaluation. Each e' in it is taken
+ * with respect to the first variable, by forward mode differentiation of e.
+ * @param root Root of the tree, an ExpressionToken is unwrapped.
+ * @param variables Names of the variables, in argument order.
+ * @param variableCount Number of variables.
+ * @return the program, NULL after issuing an error if the tree can not be evaluated numerically.
+ */
+Program *compileExpression(const Token *root, const char *const *variables, int variableCount);
+void freeProgram(Program *program);
+/**
+ * Evaluate a program.
+ * @param program Program to run.
+ * @param arguments Values of the variables, in the order they were compiled with.
+ * @return the value, NaN where it is not defined.
+ */
+double runProgram(const Program *program, const double *arguments);
+/**
+ * Copy the constant pool into a register file, so it can be reused
+ * across evaluations with runProgramRegisters.
+ * @param program Program the registers are for.
+ * @param registers At least registerCount registers.
+ */
+void loadProgramConstants(const Program *program, double *registers);
+/**
+ * Evaluate a program in a caller provided register file. Loops that feed
+ * results back into the arguments should prefer it over runProgram,
+ * since nothing has to be copied per evaluation.
+ * @param program Program to run.
+ * @param registers Register file with the constants loaded and the
+ * variables stored from index constantCount on.
+ * @return the value, NaN where it is not defined.
+ */
+double runProgramRegisters(const Program *program, double *registers);
+/**
+ * Apply a builtin function to a value, as OP_CALL does.
+ */
+double callBuiltin(BuiltinFunction function, double argument);
+
+#endif //FLUXIONCORE_FLUXION_VM_H